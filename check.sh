@@ -47,5 +47,7 @@ check_file sm3.c wolfcrypt/src
 check_file sm3_asm.S wolfcrypt/src
 check_file sm4.h wolfssl/wolfcrypt
 check_file sm4.c wolfcrypt/src
+check_file sm_batch.h wolfssl/wolfcrypt
+check_file sm_batch.c wolfcrypt/src
 echo "Done"
 
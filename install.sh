@@ -39,5 +39,7 @@ cp sm3.c $WOLFSSL_DIR/wolfcrypt/src/
 cp sm3_asm.S $WOLFSSL_DIR/wolfcrypt/src/
 cp sm4.h $WOLFSSL_DIR/wolfssl/wolfcrypt/
 cp sm4.c $WOLFSSL_DIR/wolfcrypt/src/
+cp sm_batch.h $WOLFSSL_DIR/wolfssl/wolfcrypt/
+cp sm_batch.c $WOLFSSL_DIR/wolfcrypt/src/
 echo "Done"
 
@@ -0,0 +1,419 @@
+# bitslice.rb
+#
+# Copyright (C) 2006-2024 wolfSSL Inc.
+#
+# This file is part of wolfSSL.
+#
+# wolfSSL is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# wolfSSL is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+#
+
+# Generates a boolean circuit of the SM4 S-box for bitsliced implementations.
+#
+# The SM4 S-box is: S(x) = A.I(A.x + C) + C
+#   I is inversion in GF(2^8) with polynomial x^8+x^7+x^6+x^5+x^4+x^2+1.
+#   A is a circulant matrix and C is 0xD3.
+# Inversion is done in the tower field GF(((2^2)^2)^2) where it only needs
+# 36 ANDs. Field isomorphism and affine transformations are merged into the
+# linear layers. Common XORs are found with Paar's greedy algorithm.
+#
+# Usage: ruby scripts/sm4/bitslice.rb
+
+SBOX = [
+    0xD6, 0x90, 0xE9, 0xFE, 0xCC, 0xE1, 0x3D, 0xB7,
+    0x16, 0xB6, 0x14, 0xC2, 0x28, 0xFB, 0x2C, 0x05,
+    0x2B, 0x67, 0x9A, 0x76, 0x2A, 0xBE, 0x04, 0xC3,
+    0xAA, 0x44, 0x13, 0x26, 0x49, 0x86, 0x06, 0x99,
+    0x9C, 0x42, 0x50, 0xF4, 0x91, 0xEF, 0x98, 0x7A,
+    0x33, 0x54, 0x0B, 0x43, 0xED, 0xCF, 0xAC, 0x62,
+    0xE4, 0xB3, 0x1C, 0xA9, 0xC9, 0x08, 0xE8, 0x95,
+    0x80, 0xDF, 0x94, 0xFA, 0x75, 0x8F, 0x3F, 0xA6,
+    0x47, 0x07, 0xA7, 0xFC, 0xF3, 0x73, 0x17, 0xBA,
+    0x83, 0x59, 0x3C, 0x19, 0xE6, 0x85, 0x4F, 0xA8,
+    0x68, 0x6B, 0x81, 0xB2, 0x71, 0x64, 0xDA, 0x8B,
+    0xF8, 0xEB, 0x0F, 0x4B, 0x70, 0x56, 0x9D, 0x35,
+    0x1E, 0x24, 0x0E, 0x5E, 0x63, 0x58, 0xD1, 0xA2,
+    0x25, 0x22, 0x7C, 0x3B, 0x01, 0x21, 0x78, 0x87,
+    0xD4, 0x00, 0x46, 0x57, 0x9F, 0xD3, 0x27, 0x52,
+    0x4C, 0x36, 0x02, 0xE7, 0xA0, 0xC4, 0xC8, 0x9E,
+    0xEA, 0xBF, 0x8A, 0xD2, 0x40, 0xC7, 0x38, 0xB5,
+    0xA3, 0xF7, 0xF2, 0xCE, 0xF9, 0x61, 0x15, 0xA1,
+    0xE0, 0xAE, 0x5D, 0xA4, 0x9B, 0x34, 0x1A, 0x55,
+    0xAD, 0x93, 0x32, 0x30, 0xF5, 0x8C, 0xB1, 0xE3,
+    0x1D, 0xF6, 0xE2, 0x2E, 0x82, 0x66, 0xCA, 0x60,
+    0xC0, 0x29, 0x23, 0xAB, 0x0D, 0x53, 0x4E, 0x6F,
+    0xD5, 0xDB, 0x37, 0x45, 0xDE, 0xFD, 0x8E, 0x2F,
+    0x03, 0xFF, 0x6A, 0x72, 0x6D, 0x6C, 0x5B, 0x51,
+    0x8D, 0x1B, 0xAF, 0x92, 0xBB, 0xDD, 0xBC, 0x7F,
+    0x11, 0xD9, 0x5C, 0x41, 0x1F, 0x10, 0x5A, 0xD8,
+    0x0A, 0xC1, 0x31, 0x88, 0xA5, 0xCD, 0x7B, 0xBD,
+    0x2D, 0x74, 0xD0, 0x12, 0xB8, 0xE5, 0xB4, 0xB0,
+    0x89, 0x69, 0x97, 0x4A, 0x0C, 0x96, 0x77, 0x7E,
+    0x65, 0xB9, 0xF1, 0x09, 0xC5, 0x6E, 0xC6, 0x84,
+    0x18, 0xF0, 0x7D, 0xEC, 0x3A, 0xDC, 0x4D, 0x20,
+    0x79, 0xEE, 0x5F, 0x3E, 0xD7, 0xCB, 0x39, 0x48
+]
+
+# Field polynomial of SM4 S-box inversion.
+POLY = 0x1F5
+# Affine constant.
+AFF_C = 0xD3
+# Rows of affine matrix - row i is for output bit 7-i.
+AFF_A = [ 0xD3, 0xE9, 0xF4, 0x7A, 0x3D, 0x9E, 0x4F, 0xA7 ]
+
+def parity(v)
+  v.to_s(2).count("1") & 1
+end
+
+def affine(x)
+  y = 0
+  AFF_A.each_with_index { |r, i| y |= parity(r & x) << (7 - i) }
+  y
+end
+
+def gmul(a, b)
+  r = 0
+  while b != 0
+    r ^= a if (b & 1) == 1
+    b >>= 1
+    a <<= 1
+    a ^= POLY if (a & 0x100) != 0
+  end
+  r
+end
+
+def ginv(a)
+  return 0 if a == 0
+  (1..255).find { |b| gmul(a, b) == 1 }
+end
+
+# Check structure of S-box.
+0.upto(255) do |x|
+  raise "S-box structure" if affine(ginv(affine(x) ^ AFF_C)) ^ AFF_C != SBOX[x]
+end
+
+# Tower field arithmetic on integers.
+# GF(2^2):  h.W + l,  W^2 = W + 1
+# GF(2^4):  H.Z + L,  Z^2 = Z + mu
+# GF(2^8):  A.Y + B,  Y^2 = Y + lambda
+def mul4(p, q)
+  a, b, c, d = p >> 1, p & 1, q >> 1, q & 1
+  ((a & c ^ a & d ^ b & c) << 1) | (a & c ^ b & d)
+end
+
+def mul16(p, q, mu)
+  a, b, c, d = p >> 2, p & 3, q >> 2, q & 3
+  ac = mul4(a, c)
+  ((ac ^ mul4(a, d) ^ mul4(b, c)) << 2) | (mul4(ac, mu) ^ mul4(b, d))
+end
+
+def mul256(p, q, mu, lam)
+  a, b, c, d = p >> 4, p & 15, q >> 4, q & 15
+  ac = mul16(a, c, mu)
+  ((ac ^ mul16(a, d, mu) ^ mul16(b, c, mu)) << 4) |
+    (mul16(ac, lam, mu) ^ mul16(b, d, mu))
+end
+
+# Circuit under construction.
+class Circuit
+  attr_reader :ands, :nvars
+
+  # Variable 0 is the constant 1, variables 1-8 are the input bits.
+  def initialize
+    @nvars = 9
+    @ands = []
+  end
+
+  def one
+    1
+  end
+
+  def input(i)
+    1 << (i + 1)
+  end
+
+  # AND of two linear forms creates a new variable.
+  def and(f, g)
+    v = @nvars
+    @nvars += 1
+    @ands << [v, f, g]
+    1 << v
+  end
+end
+
+# Apply a linear function, given as a function on integers, to signals.
+def lin(sig, bits)
+  out = Array.new(bits, 0)
+  0.upto(bits - 1) do |i|
+    img = yield(1 << i)
+    0.upto(bits - 1) { |j| out[j] ^= sig[i] if ((img >> j) & 1) == 1 }
+  end
+  out
+end
+
+def xor_sig(p, q)
+  p.zip(q).map { |a, b| a ^ b }
+end
+
+def sym_mul4(c, p, q)
+  ac = c.and(p[1], q[1])
+  bd = c.and(p[0], q[0])
+  e = c.and(p[1] ^ p[0], q[1] ^ q[0])
+  [ac ^ bd, e ^ bd]
+end
+
+def sym_mul16(c, p, q, mu)
+  ac = sym_mul4(c, p[2..3], q[2..3])
+  bd = sym_mul4(c, p[0..1], q[0..1])
+  e = sym_mul4(c, xor_sig(p[2..3], p[0..1]), xor_sig(q[2..3], q[0..1]))
+  lin(ac, 2) { |v| mul4(v, mu) }.zip(bd).map { |a, b| a ^ b } +
+    xor_sig(e, bd)
+end
+
+def sym_inv16(c, p, mu)
+  a, b = p[2..3], p[0..1]
+  ab = sym_mul4(c, a, b)
+  # a^2.mu + b^2 is linear.
+  sq = lin(p, 4) { |v| mul4(mul4(v >> 2, v >> 2), mu) ^ mul4(v & 3, v & 3) }
+  d = xor_sig(ab, sq)
+  # Inverse in GF(2^2) is squaring - linear.
+  di = lin(d, 2) { |v| mul4(v, v) }
+  sym_mul4(c, xor_sig(a, b), di) + sym_mul4(c, a, di)
+end
+
+def sym_inv256(c, p, mu, lam)
+  a, b = p[4..7], p[0..3]
+  ab = sym_mul16(c, a, b, mu)
+  sq = lin(p, 8) do |v|
+    ah, bl = v >> 4, v & 15
+    mul16(mul16(ah, ah, mu), lam, mu) ^ mul16(bl, bl, mu)
+  end
+  d = xor_sig(ab, sq)
+  di = sym_inv16(c, d, mu)
+  sym_mul16(c, xor_sig(a, b), di, mu) + sym_mul16(c, a, di, mu)
+end
+
+# Paar's greedy algorithm: compute all forms with few XORs.
+# Gates are added to code as [name, op, left, right] and memo maps each form
+# to the name holding it.
+class Linear
+  def initialize(code, memo)
+    @code = code
+    @memo = memo
+  end
+
+  def compute(forms, tn)
+    todo = forms.uniq.reject { |f| @memo.key?(f) }
+    rows = todo.map do |f|
+      bits = []
+      0.upto(f.bit_length - 1) { |i| bits << (1 << i) if ((f >> i) & 1) == 1 }
+      bits
+    end
+    loop do
+      count = Hash.new(0)
+      rows.each do |r|
+        r.combination(2).each { |p| count[p.sort] += 1 }
+      end
+      best = count.max_by { |p, n| [n, -p[0], -p[1]] }
+      break if best.nil? || best[1] < 2
+      x, y = best[0]
+      f = x ^ y
+      emit(f, x, y, tn)
+      rows.each do |r|
+        if r.include?(x) && r.include?(y)
+          r.delete(x)
+          r.delete(y)
+          r << f
+        end
+      end
+    end
+    rows.each_with_index do |r, i|
+      f = r[0]
+      r[1..].each do |g|
+        h = f ^ g
+        emit(h, f, g, tn)
+        f = h
+      end
+      raise "form" if f != todo[i]
+    end
+  end
+
+  def emit(f, x, y, tn)
+    return if @memo.key?(f)
+    name = tn.call
+    @memo[f] = name
+    @code << [name, "xor", @memo[x], @memo[y]]
+  end
+end
+
+def build(mu, lam, beta)
+  # Isomorphism: x^i -> beta^i.
+  iso = Array.new(8, 0)
+  pw = 1
+  0.upto(7) do |i|
+    iso[i] = pw
+    pw = mul256(pw, beta, mu, lam)
+  end
+  to_tower = lambda do |v|
+    r = 0
+    0.upto(7) { |i| r ^= iso[i] if ((v >> i) & 1) == 1 }
+    r
+  end
+  from_tower = {}
+  0.upto(255) { |v| from_tower[to_tower.call(v)] = v }
+
+  c = Circuit.new
+  x = (0..7).map { |i| c.input(i) }
+  # Top linear layer: tower(A.x + C).
+  t = lin(x, 8) { |v| to_tower.call(affine(v)) }
+  cst = to_tower.call(AFF_C)
+  0.upto(7) { |i| t[i] ^= c.one if ((cst >> i) & 1) == 1 }
+  inv = sym_inv256(c, t, mu, lam)
+  # Bottom linear layer: A.untower(inv) + C.
+  out = lin(inv, 8) { |v| affine(from_tower[v]) }
+  0.upto(7) { |i| out[i] ^= c.one if ((AFF_C >> i) & 1) == 1 }
+
+  # Levels of AND gates.
+  level = { 0 => 0 }
+  0.upto(7) { |i| level[i + 1] = 0 }
+  lvl_of = lambda do |f|
+    l = 0
+    0.upto(f.bit_length - 1) do |i|
+      l = [l, level[i]].max if ((f >> i) & 1) == 1
+    end
+    l
+  end
+  c.ands.each { |v, f, g| level[v] = [lvl_of.call(f), lvl_of.call(g)].max + 1 }
+
+  memo = { 1 => "one" }
+  0.upto(7) { |i| memo[1 << (i + 1)] = "s[#{7 - i}]" }
+  code = []
+  linear = Linear.new(code, memo)
+  n = 0
+  tn = lambda { n += 1; "t#{n}" }
+  maxl = level.values.max
+  1.upto(maxl) do |l|
+    gates = c.ands.select { |v, f, g| level[v] == l }
+    linear.compute(gates.map { |v, f, g| [f, g] }.flatten, tn)
+    gates.each do |v, f, g|
+      name = tn.call
+      memo[1 << v] = name
+      code << [name, "and", memo[f], memo[g]]
+    end
+  end
+  linear.compute(out, tn)
+  [code, out.map { |f| memo[f] }]
+end
+
+# Evaluate circuit on all 256 inputs at once - bit j of each value is input j.
+def evaluate(code, outs)
+  vals = { "one" => (1 << 256) - 1 }
+  0.upto(7) do |i|
+    v = 0
+    0.upto(255) { |j| v |= ((j >> i) & 1) << j }
+    vals["s[#{7 - i}]"] = v
+  end
+  code.each do |n, op, a, b|
+    vals[n] = op == "and" ? vals[a] & vals[b] : vals[a] ^ vals[b]
+  end
+  res = Array.new(256, 0)
+  outs.each_with_index do |o, i|
+    0.upto(255) { |j| res[j] |= ((vals[o] >> j) & 1) << i }
+  end
+  res
+end
+
+# Find smallest circuit over choices of tower constants and isomorphism.
+best = nil
+1.upto(3) do |mu|
+  # Z^2 + Z + mu irreducible over GF(2^2).
+  next if (0..3).any? { |z| mul4(z, z) ^ z == mu }
+  1.upto(15) do |lam|
+    next if (0..15).any? { |y| mul16(y, y, mu) ^ y == lam }
+    1.upto(255) do |beta|
+      # beta must be a root of the field polynomial.
+      pw = 1
+      acc = 0
+      0.upto(8) do |i|
+        acc ^= pw if ((POLY >> i) & 1) == 1
+        pw = mul256(pw, beta, mu, lam)
+      end
+      next if acc != 0
+      code, outs = build(mu, lam, beta)
+      if best.nil? || code.length < best[0].length
+        best = [code, outs]
+      end
+    end
+  end
+end
+code, outs = best
+raise "circuit" if evaluate(code, outs) != SBOX
+
+# Allocate temporaries - reuse once last use has passed.
+last = {}
+code.each_with_index do |(n, op, a, b), i|
+  last[a] = i
+  last[b] = i
+end
+outs.each { |o| last[o] = code.length }
+free = []
+names = {}
+ntmp = 0
+lines = []
+code.each_with_index do |(n, op, a, b), i|
+  a = names[a] || a
+  b = names[b] || b
+  if free.empty?
+    ntmp += 1
+    names[n] = "t#{ntmp - 1}"
+  else
+    names[n] = free.shift
+  end
+  if b == "one"
+    lines << "    #{names[n]} = ~#{a};"
+  elsif a == "one"
+    lines << "    #{names[n]} = ~#{b};"
+  else
+    lines << "    #{names[n]} = #{a} #{op == "and" ? "&" : "^"} #{b};"
+  end
+  # Free temporaries whose last use was this gate.
+  [code[i][2], code[i][3]].uniq.each do |u|
+    free << names[u] if names.key?(u) && last[u] == i
+  end
+  free.sort_by! { |t| t[1..].to_i }
+end
+
+nand = code.count { |g| g[1] == "and" }
+puts "/* SM4 S-box as a boolean circuit applied to 64 bitsliced values."
+puts " *"
+puts " * #{nand} AND and #{code.length - nand} XOR/NOT operations."
+puts " *"
+puts " * Generated using script: ruby scripts/sm4/bitslice.rb"
+puts " *"
+puts " * @param [in, out] s  Bits of byte, most significant first. S-box value on"
+puts " *                    output."
+puts " */"
+puts "static void sm4_bs_sbox(word64* s)"
+puts "{"
+0.step(ntmp - 1, 8) do |i|
+  last_i = [i + 7, ntmp - 1].min
+  puts "    word64 " + (i..last_i).map { |j| "t#{j}" }.join(", ") + ";"
+end
+puts
+lines.each { |l| puts l }
+puts
+outs.each_with_index.reverse_each do |o, i|
+  puts "    s[#{7 - i}] = #{names[o]};"
+end
+puts "}"
@@ -120,13 +120,14 @@ module Ecc_SM2
  *
  * hash     Hash to sign.
  * hashLen  Length of the hash data.
- * rng      Random number generator.
+ * rng      Random number generator. May be NULL when km is set.
  * priv     Private part of key - scalar.
  * rm       First part of result as an mp_int.
  * sm       Sirst part of result as an mp_int.
+ * km       k to use. May be NULL.
  * heap     Heap to use for allocation.
- * returns RNG failures, MEMORY_E when memory allocation fails and
- * MP_OKAY on success.
+ * returns RNG failures, MEMORY_E when memory allocation fails,
+ * MP_ZERO_E when km is not usable and rng is NULL, and MP_OKAY on success.
  */
 int sp_ecc_sign_#{@namef}#{total}(const byte* hash, word32 hashLen, WC_RNG* rng,
     const mp_int* priv, mp_int* rm, mp_int* sm, mp_int* km, void* heap)
@@ -198,7 +199,11 @@ EOF
         sp_#{@total}_from_mp(x, #{@words}, priv);
 
         /* New random point. */
-        if (km == NULL || mp_iszero(km)) {
+        if ((km == NULL || mp_iszero(km)) && (rng == NULL)) {
+            /* k passed in not usable - caller to generate another. */
+            err = MP_ZERO_E;
+        }
+        else if (km == NULL || mp_iszero(km)) {
             err = sp_#{@total}_ecc_gen_k_#{@namef}#{@words}(rng, k);
         }
         else {
@@ -609,11 +614,130 @@ EOF
 }
 #endif /* HAVE_ECC_VERIFY */
 
+EOF
+  end
+
+  # Square root exponent for the SM2 prime is (p + 1) / 4 which, from the top
+  # bit, is: 31 ones, a zero, 128 ones, 31 zeros, a one and 62 zeros.
+  # Addition chain: 254 squares and 13 multiplies.
+  def sqrt_chain_sm2(cpu, words, total)
+    f = "#{cpu}#{@namef}#{words}"
+    mm = "#{@cname}_mod, #{@cname}_mp_mod"
+    puts <<EOF
+        sp_digit* t1 = t;
+        sp_digit* t2 = t + 2 * #{words};
+        sp_digit* t3 = t + 4 * #{words};
+        int i;
+
+        /* t1 = y ^ (2^2 - 1) */
+        sp_#{total}_mont_sqr_#{f}(t1, y, #{mm});
+        sp_#{total}_mont_mul_#{f}(t1, t1, y, #{mm});
+        /* t2 = y ^ (2^3 - 1) */
+        sp_#{total}_mont_sqr_#{f}(t2, t1, #{mm});
+        sp_#{total}_mont_mul_#{f}(t2, t2, y, #{mm});
+        /* t3 = y ^ (2^6 - 1) */
+        sp_#{total}_mont_sqr_n_#{f}(t3, t2, 3, #{mm});
+        sp_#{total}_mont_mul_#{f}(t3, t3, t2, #{mm});
+        /* t1 = y ^ (2^12 - 1) */
+        sp_#{total}_mont_sqr_n_#{f}(t1, t3, 6, #{mm});
+        sp_#{total}_mont_mul_#{f}(t1, t1, t3, #{mm});
+        /* t1 = y ^ (2^15 - 1) */
+        sp_#{total}_mont_sqr_n_#{f}(t1, t1, 3, #{mm});
+        sp_#{total}_mont_mul_#{f}(t1, t1, t2, #{mm});
+        /* t3 = y ^ (2^30 - 1) */
+        sp_#{total}_mont_sqr_n_#{f}(t3, t1, 15, #{mm});
+        sp_#{total}_mont_mul_#{f}(t3, t3, t1, #{mm});
+        /* t1 = y ^ (2^31 - 1) */
+        sp_#{total}_mont_sqr_#{f}(t1, t3, #{mm});
+        sp_#{total}_mont_mul_#{f}(t1, t1, y, #{mm});
+        /* t2 = y ^ (2^32 - 1) */
+        sp_#{total}_mont_sqr_#{f}(t2, t1, #{mm});
+        sp_#{total}_mont_mul_#{f}(t2, t2, y, #{mm});
+        /* t1 = y ^ ((2^31 - 1) << 1) */
+        sp_#{total}_mont_sqr_#{f}(t1, t1, #{mm});
+        /* t1 = y ^ (((2^31 - 1) << 129) | (2^128 - 1)) */
+        for (i = 0; i < 4; i++) {
+            sp_#{total}_mont_sqr_n_#{f}(t1, t1, 32, #{mm});
+            sp_#{total}_mont_mul_#{f}(t1, t1, t2, #{mm});
+        }
+        /* t1 = y ^ (((2^31 - 1) << 161) | ((2^128 - 1) << 32) | 1) */
+        sp_#{total}_mont_sqr_n_#{f}(t1, t1, 32, #{mm});
+        sp_#{total}_mont_mul_#{f}(t1, t1, y, #{mm});
+        /* y = y ^ ((p + 1) / 4) */
+        sp_#{total}_mont_sqr_n_#{f}(y, t1, 62, #{mm});
+EOF
+  end
+
+  def sqrt_loop_sm2(cpu, words, total)
+    f = "#{cpu}#{@namef}#{words}"
+    mm = "#{@cname}_mod, #{@cname}_mp_mod"
+    dbits = (words == 4 || words == 5) ? 64 : 32
+    puts <<EOF
+        int i;
+
+        XMEMCPY(t, y, sizeof(sp_digit) * #{words});
+        for (i=252; i>=0; i--) {
+            sp_#{total}_mont_sqr_#{f}(t, t, #{mm});
+            if (#{@cname}_sqrt_power[i / #{dbits}] & ((sp_digit)1 << (i % #{dbits})))
+                sp_#{total}_mont_mul_#{f}(t, t, y, #{mm});
+        }
+        XMEMCPY(y, t, sizeof(sp_digit) * #{words});
 EOF
   end
 
   def sqrt_y_ct_sm2(words, total, sqrt_power)
     puts <<EOF
+/* Find the square root of a number mod the prime of the curve.
+ *
+ * y  The number to operate on and the result.
+ * t  Temporary data - 6 * #{@words} digits.
+ */
+static void sp_#{total}_mont_sqrt_tmp_#{@namef}#{words}(sp_digit* y, sp_digit* t)
+{
+EOF
+    if @cpus.length > 0
+      puts <<EOF
+#ifdef HAVE_INTEL_AVX2
+    word32 cpuid_flags = cpuid_get_flags();
+#endif
+
+EOF
+    end
+    puts <<EOF
+#ifndef WOLFSSL_SP_SMALL
+    /* Square root power only used by the small implementation. */
+    (void)#{@cname}_sqrt_power;
+
+#endif
+EOF
+    cpus = []
+    cpus << @cpus[0] + "_" if @cpus.length > 0
+    cpus << ""
+    cpus.each do |cpu|
+      if cpu != ""
+        puts <<EOF
+#ifdef HAVE_INTEL_AVX2
+    if (IS_INTEL_BMI2(cpuid_flags) && IS_INTEL_ADX(cpuid_flags)) {
+EOF
+      else
+        puts "    {"
+      end
+      puts "#ifdef WOLFSSL_SP_SMALL"
+      sqrt_loop_sm2(cpu, words, total)
+      puts "#else"
+      sqrt_chain_sm2(cpu, words, total)
+      puts "#endif /* WOLFSSL_SP_SMALL */"
+      puts "    }"
+      if cpu != ""
+        puts <<EOF
+    else
+#endif
+EOF
+      end
+    end
+    puts <<EOF
+}
+
 /* Find the square root of a number mod the prime of the curve.
  *
  * y  The number to operate on and the result.
@@ -624,51 +748,1060 @@ static int sp_#{total}_mont_sqrt_#{@namef}#{words}(sp_digit* y)
 #ifdef WOLFSSL_SP_SMALL_STACK
     sp_digit* t = NULL;
 #else
-    sp_digit t[2 * #{@words}];
+    sp_digit t[6 * #{@words}];
 #endif
     int err = MP_OKAY;
+
+#ifdef WOLFSSL_SP_SMALL_STACK
+    t = (sp_digit*)XMALLOC(sizeof(sp_digit) * 6 * #{@words}, NULL, DYNAMIC_TYPE_ECC);
+    if (t == NULL)
+        err = MEMORY_E;
+#endif
+
+    if (err == MP_OKAY) {
+        sp_#{total}_mont_sqrt_tmp_#{@namef}#{words}(y, t);
+    }
+
+#ifdef WOLFSSL_SP_SMALL_STACK
+    if (t != NULL)
+        XFREE(t, NULL, DYNAMIC_TYPE_ECC);
+#endif
+
+    return err;
+}
+
 EOF
+  end
+
+  # Preprocessor condition for using the co-Z ladder in shared secret
+  # generation. Windowed implementations with assembly are faster on x86_64.
+  # Batch key generation: scalars from one block of random data and a single
+  # field inversion for converting all the public points to affine.
+  def sp_ecc_make_key_batch_sm2(words, total)
+    f = "#{@namef}#{words}"
+    mm = "p256_sm2_mod, p256_sm2_mp_mod"
+    sint = (@bits > 32) ? "sp_int64" : "sp_int32"
     if @cpus.length > 0
-      puts <<EOF
+      base_call = <<EOF
 #ifdef HAVE_INTEL_AVX2
-    word32 cpuid_flags = cpuid_get_flags();
+            if (IS_INTEL_BMI2(cpuid_flags) && IS_INTEL_ADX(cpuid_flags) &&
+                    IS_INTEL_AVX2(cpuid_flags)) {
+                err = sp_#{total}_ecc_mulmod_base_avx2_#{f}(point + j,
+                    k + j * #{words}, 0, 1, heap);
+            }
+            else
+#endif
+                err = sp_#{total}_ecc_mulmod_base_#{f}(point + j,
+                    k + j * #{words}, 0, 1, heap);
+EOF
+      order_call = <<EOF
+#ifdef HAVE_INTEL_AVX2
+            if (IS_INTEL_BMI2(cpuid_flags) && IS_INTEL_ADX(cpuid_flags) &&
+                    IS_INTEL_AVX2(cpuid_flags)) {
+                err = sp_#{total}_ecc_mulmod_avx2_#{f}(infinity, point + j,
+                    p256_sm2_order, 1, 1, heap);
+            }
+            else
 #endif
+                err = sp_#{total}_ecc_mulmod_#{f}(infinity, point + j,
+                    p256_sm2_order, 1, 1, heap);
 EOF
+      cpuid_decl = "#ifdef HAVE_INTEL_AVX2\n    word32 cpuid_flags = cpuid_get_flags();\n#endif\n"
+    else
+      base_call = <<EOF
+            err = sp_#{total}_ecc_mulmod_base_#{f}(point + j, k + j * #{words},
+                0, 1, heap);
+EOF
+      order_call = <<EOF
+            err = sp_#{total}_ecc_mulmod_#{f}(infinity, point + j,
+                p256_sm2_order, 1, 1, heap);
+EOF
+      cpuid_decl = ""
     end
     puts <<EOF
+/* Map the Montgomery form projective coordinate point to an affine point
+ * using the already calculated inverse of z.
+ *
+ * r   Montgomery form projective coordinate point to map.
+ * zi  Inverse of z ordinate of point in Montgomery form.
+ * t   Temporary ordinate data.
+ */
+static void sp_#{total}_map_inv_#{f}(sp_point_#{total}* r, const sp_digit* zi,
+    sp_digit* t)
+{
+    sp_digit* t1 = t;
+    sp_digit* t2 = t + 2*#{words};
+    #{sint} n;
+
+    sp_#{total}_mont_sqr_#{f}(t2, zi, #{mm});
+    sp_#{total}_mont_mul_#{f}(t1, t2, zi, #{mm});
+
+    /* x /= z^2 */
+    sp_#{total}_mont_mul_#{f}(r->x, r->x, t2, #{mm});
+    XMEMSET(r->x + #{words}, 0, sizeof(sp_digit) * #{words}U);
+    sp_#{total}_mont_reduce_#{f}(r->x, #{mm});
+    /* Reduce x to less than modulus */
+    n = sp_#{total}_cmp_#{f}(r->x, p256_sm2_mod);
+    sp_#{total}_cond_sub_#{f}(r->x, r->x, p256_sm2_mod, (sp_digit)~(n >> #{@bits - 1}));
+    sp_#{total}_norm_#{words}(r->x);
+
+    /* y /= z^3 */
+    sp_#{total}_mont_mul_#{f}(r->y, r->y, t1, #{mm});
+    XMEMSET(r->y + #{words}, 0, sizeof(sp_digit) * #{words}U);
+    sp_#{total}_mont_reduce_#{f}(r->y, #{mm});
+    /* Reduce y to less than modulus */
+    n = sp_#{total}_cmp_#{f}(r->y, p256_sm2_mod);
+    sp_#{total}_cond_sub_#{f}(r->y, r->y, p256_sm2_mod, (sp_digit)~(n >> #{@bits - 1}));
+    sp_#{total}_norm_#{words}(r->y);
+
+    XMEMSET(r->z, 0, sizeof(r->z) / 2);
+    r->z[0] = 1;
+}
+
+/* Generates a number of scalars that are in the range 1..order-1.
+ * Scalars are generated from one block of random data. Rejected values are
+ * replaced with newly generated scalars.
+ *
+ * rng  Random number generator.
+ * k    Scalar values.
+ * n    Number of scalars to generate.
+ * buf  Buffer to hold random data. n * #{total/8} bytes in size.
+ * returns RNG failures and MP_OKAY on success.
+ */
+static int sp_#{total}_ecc_gen_k_batch_#{f}(WC_RNG* rng, sp_digit* k, int n,
+    byte* buf)
+{
+#ifndef WC_NO_RNG
+    int err;
+    int j;
+
+    err = wc_RNG_GenerateBlock(rng, buf, (word32)n * #{total/8});
+    for (j = 0; (err == 0) && (j < n); j++) {
+        sp_#{total}_from_bin(k + j * #{words}, #{words}, buf + j * #{total/8},
+            #{total/8});
+        if (sp_#{total}_cmp_#{f}(k + j * #{words}, p256_sm2_order2) <= 0) {
+            sp_#{total}_add_one_#{f}(k + j * #{words});
+        }
+        else {
+            err = sp_#{total}_ecc_gen_k_#{f}(rng, k + j * #{words});
+        }
+    }
+    ForceZero(buf, (word32)n * #{total/8});
+
+    return err;
+#else
+    (void)rng;
+    (void)k;
+    (void)n;
+    (void)buf;
+    return NOT_COMPILED_IN;
+#endif
+}
+
+#ifndef SP_#{total}_SM2_KEY_BATCH
+/* Number of keys to generate at one time. */
+#define SP_#{total}_SM2_KEY_BATCH     8
+#endif
 
+/* Makes a number of random EC key pairs.
+ *
+ * Public points are converted to affine together using Montgomery's trick -
+ * one field inversion for each batch of SP_#{total}_SM2_KEY_BATCH keys.
+ *
+ * rng   Random number generator.
+ * cnt   Number of key pairs to make.
+ * priv  Array of generated private values.
+ * pub   Array of generated public points.
+ * heap  Heap to use for allocation.
+ * returns ECC_INF_E when the point does not have the correct order, RNG
+ * failures, MEMORY_E when memory allocation fails and MP_OKAY on success.
+ */
+int sp_ecc_make_key_batch_sm2_#{total}(WC_RNG* rng, word32 cnt, mp_int** priv,
+    ecc_point** pub, void* heap)
+{
 #ifdef WOLFSSL_SP_SMALL_STACK
-    t = (sp_digit*)XMALLOC(sizeof(sp_digit) * 2 * #{@words}, NULL, DYNAMIC_TYPE_ECC);
-    if (t == NULL)
+    sp_point_#{total}* point = NULL;
+    sp_digit* k = NULL;
+#else
+    #ifdef WOLFSSL_VALIDATE_ECC_KEYGEN
+    sp_point_#{total} point[SP_#{total}_SM2_KEY_BATCH + 1];
+    #else
+    sp_point_#{total} point[SP_#{total}_SM2_KEY_BATCH];
+    #endif
+    sp_digit k[#{words} * SP_#{total}_SM2_KEY_BATCH +
+               2 * #{words} * (SP_#{total}_SM2_KEY_BATCH + 7)];
+#endif
+#ifdef WOLFSSL_VALIDATE_ECC_KEYGEN
+    sp_point_#{total}* infinity = NULL;
+#endif
+    sp_digit* acc = NULL;
+    sp_digit* inv = NULL;
+    sp_digit* zi = NULL;
+    sp_digit* t = NULL;
+    word32 i;
+    int n = 0;
+    int j;
+    int err = MP_OKAY;
+#{cpuid_decl}
+    (void)heap;
+
+#ifdef WOLFSSL_SP_SMALL_STACK
+    #ifdef WOLFSSL_VALIDATE_ECC_KEYGEN
+    point = (sp_point_#{total}*)XMALLOC(sizeof(sp_point_#{total}) *
+        (SP_#{total}_SM2_KEY_BATCH + 1), heap, DYNAMIC_TYPE_ECC);
+    #else
+    point = (sp_point_#{total}*)XMALLOC(sizeof(sp_point_#{total}) *
+        SP_#{total}_SM2_KEY_BATCH, heap, DYNAMIC_TYPE_ECC);
+    #endif
+    if (point == NULL)
         err = MEMORY_E;
+    if (err == MP_OKAY) {
+        k = (sp_digit*)XMALLOC(sizeof(sp_digit) *
+            (#{words} * SP_#{total}_SM2_KEY_BATCH +
+             2 * #{words} * (SP_#{total}_SM2_KEY_BATCH + 7)), heap,
+            DYNAMIC_TYPE_ECC);
+        if (k == NULL)
+            err = MEMORY_E;
+    }
 #endif
 
     if (err == MP_OKAY) {
+    #ifdef WOLFSSL_VALIDATE_ECC_KEYGEN
+        infinity = point + SP_#{total}_SM2_KEY_BATCH;
+    #endif
+        /* Products of z ordinates - random data is generated in here. */
+        acc = k + #{words} * SP_#{total}_SM2_KEY_BATCH;
+        inv = acc + 2 * #{words} * SP_#{total}_SM2_KEY_BATCH;
+        zi = inv + 2 * #{words};
+        t = zi + 2 * #{words};
+    }
+
+    for (i = 0; (err == MP_OKAY) && (i < cnt); i += (word32)n) {
+        n = ((cnt - i) < SP_#{total}_SM2_KEY_BATCH) ? (int)(cnt - i) :
+                                                 SP_#{total}_SM2_KEY_BATCH;
+
+        err = sp_#{total}_ecc_gen_k_batch_#{f}(rng, k, n, (byte*)acc);
+        for (j = 0; (err == MP_OKAY) && (j < n); j++) {
+#{base_call.chomp}
+        }
+        if (err == MP_OKAY) {
+            /* acc[j] = z[0] * ... * z[j] */
+            XMEMCPY(acc, point[0].z, sizeof(sp_digit) * #{words});
+            for (j = 1; j < n; j++) {
+                sp_#{total}_mont_mul_#{f}(acc + j * 2 * #{words},
+                    acc + (j - 1) * 2 * #{words}, point[j].z,
+                    #{mm});
+            }
+            /* inv = 1 / (z[0] * ... * z[n-1]) */
+            sp_#{total}_mont_inv_#{f}(inv, acc + (n - 1) * 2 * #{words}, t);
+            for (j = n - 1; j > 0; j--) {
+                /* zi = 1 / z[j] */
+                sp_#{total}_mont_mul_#{f}(zi, inv, acc + (j - 1) * 2 * #{words},
+                    #{mm});
+                /* inv = 1 / (z[0] * ... * z[j-1]) */
+                sp_#{total}_mont_mul_#{f}(inv, inv, point[j].z,
+                    #{mm});
+                sp_#{total}_map_inv_#{f}(point + j, zi, t);
+            }
+            sp_#{total}_map_inv_#{f}(point, inv, t);
+        }
+
+#ifdef WOLFSSL_VALIDATE_ECC_KEYGEN
+        for (j = 0; (err == MP_OKAY) && (j < n); j++) {
+#{order_call.chomp}
+            if ((err == MP_OKAY) && (sp_#{total}_iszero_#{words}(point[j].x) ||
+                    sp_#{total}_iszero_#{words}(point[j].y))) {
+                err = ECC_INF_E;
+            }
+        }
+#endif
+
+        for (j = 0; (err == MP_OKAY) && (j < n); j++) {
+            err = sp_#{total}_to_mp(k + j * #{words}, priv[i + (word32)j]);
+            if (err == MP_OKAY) {
+                err = sp_#{total}_point_to_ecc_point_#{words}(point + j,
+                    pub[i + (word32)j]);
+            }
+        }
+    }
+
+#ifdef WOLFSSL_SP_SMALL_STACK
+    if (k != NULL)
+#endif
+    {
+        ForceZero(k, sizeof(sp_digit) * #{words} * SP_#{total}_SM2_KEY_BATCH);
+    #ifdef WOLFSSL_SP_SMALL_STACK
+        XFREE(k, heap, DYNAMIC_TYPE_ECC);
+    #endif
+    }
+#ifdef WOLFSSL_SP_SMALL_STACK
+    /* point is not sensitive, so no need to zeroize */
+    XFREE(point, heap, DYNAMIC_TYPE_ECC);
+#endif
+
+    return err;
+}
 
 EOF
+  end
+
+  def ecc_mulmod_x_cond_sm2()
     if @cpus.length > 0
+      "defined(WOLFSSL_SP_SM2_COZ_LADDER)"
+    else
+      "defined(WOLFSSL_SP_SMALL) || defined(WOLFSSL_SP_SM2_COZ_LADDER)"
+    end
+  end
+
+  # Co-Z Montgomery ladder calculating only the x ordinate of a scalar
+  # multiplication. Used by the shared secret generation.
+  def ecc_mulmod_x_sm2(words, total)
+    order_bin = (0...total/8).map { |i| (@order >> (total - 8 - 8*i)) & 0xff }
+    puts <<EOF
+#if #{ecc_mulmod_x_cond_sm2()}
+/* The order of the curve P#{total} as big-endian bytes. */
+static const byte #{@cname}_order_bin[#{total/8}] = {
+EOF
+    order_bin.each_slice(8).with_index do |row, i|
+      line = "    " + row.map { |b| "0x%02x" % b }.join(", ")
+      line += "," if i < total/64 - 1
+      puts line
+    end
+    puts <<EOF
+};
+
+/* Conditionally swap two numbers in constant time.
+ *
+ * a  First number.
+ * b  Second number.
+ * m  Mask value to apply: all ones to swap, zero to leave unchanged.
+ */
+static void sp_#{total}_cond_swap_#{@namef}#{words}(sp_digit* a, sp_digit* b, sp_digit m)
+{
+    sp_digit t;
+    int i;
+
+    for (i = 0; i < #{words}; i++) {
+        t = (a[i] ^ b[i]) & m;
+        a[i] ^= t;
+        b[i] ^= t;
+    }
+}
+
+EOF
+    ecc_mulmod_x_cpu_sm2(words, total, "")
+    if @cpus.length > 0
+      puts "#ifdef HAVE_INTEL_AVX2"
+      ecc_mulmod_x_cpu_sm2(words, total, @cpus[0] + "_")
+      puts "#endif /* HAVE_INTEL_AVX2 */"
+    end
+    puts "#endif /* #{ecc_mulmod_x_cond_sm2().gsub("defined(", "").gsub(")", "")} */"
+    puts
+  end
+
+  def ecc_mulmod_x_cpu_sm2(words, total, cpu)
+    f = "#{@namef}#{words}"
+    mm = "p256_sm2_mod, p256_sm2_mp_mod"
+    puts <<EOF
+/* Co-Z addition with update: P2 = P1 + P2 and P1 is updated to have the same
+ * Z ordinate as the result. Points have the same, implicit, Z ordinate.
+ * All ordinates are in Montgomery form.
+ *
+ * x1  X ordinate of P1.
+ * y1  Y ordinate of P1.
+ * x2  X ordinate of P2.
+ * y2  Y ordinate of P2.
+ * t   Temporary ordinate data.
+ */
+static void sp_#{total}_proj_point_add_coz_#{cpu}#{f}(sp_digit* x1,
+    sp_digit* y1, sp_digit* x2, sp_digit* y2, sp_digit* t)
+{
+    sp_digit* t1 = t;
+    sp_digit* t2 = t + 2*#{words};
+    sp_digit* t3 = t + 4*#{words};
+
+    /* C = (X1 - X2)^2 */
+    sp_#{total}_mont_sub_#{cpu}#{f}(t1, x1, x2, p256_sm2_mod);
+    sp_#{total}_mont_sqr_#{cpu}#{f}(t1, t1, #{mm});
+    /* W2 = X2 * C, W1 = X1 * C */
+    sp_#{total}_mont_mul_#{cpu}#{f}(t2, x2, t1, #{mm});
+    sp_#{total}_mont_mul_#{cpu}#{f}(x1, x1, t1, #{mm});
+    /* D = (Y1 - Y2)^2 */
+    sp_#{total}_mont_sub_#{cpu}#{f}(t1, y1, y2, p256_sm2_mod);
+    sp_#{total}_mont_sqr_#{cpu}#{f}(t3, t1, #{mm});
+    /* X2 = D - W1 - W2 */
+    sp_#{total}_mont_sub_#{cpu}#{f}(x2, t3, x1, p256_sm2_mod);
+    sp_#{total}_mont_sub_#{cpu}#{f}(x2, x2, t2, p256_sm2_mod);
+    /* Y1 = Y1 * (W1 - W2) */
+    sp_#{total}_mont_sub_#{cpu}#{f}(t2, x1, t2, p256_sm2_mod);
+    sp_#{total}_mont_mul_#{cpu}#{f}(y1, y1, t2, #{mm});
+    /* Y2 = (Y1 - Y2) * (W1 - X2) - Y1 */
+    sp_#{total}_mont_sub_#{cpu}#{f}(t2, x1, x2, p256_sm2_mod);
+    sp_#{total}_mont_mul_#{cpu}#{f}(t1, t1, t2, #{mm});
+    sp_#{total}_mont_sub_#{cpu}#{f}(y2, t1, y1, p256_sm2_mod);
+}
+
+/* Co-Z conjugate addition: P2 = P1 + P2 and P1 = P1 - P2.
+ * Points have the same, implicit, Z ordinate as do the results.
+ * All ordinates are in Montgomery form.
+ *
+ * x1  X ordinate of P1.
+ * y1  Y ordinate of P1.
+ * x2  X ordinate of P2.
+ * y2  Y ordinate of P2.
+ * t   Temporary ordinate data.
+ */
+static void sp_#{total}_proj_point_add_conj_coz_#{cpu}#{f}(sp_digit* x1,
+    sp_digit* y1, sp_digit* x2, sp_digit* y2, sp_digit* t)
+{
+    sp_digit* t1 = t;
+    sp_digit* t2 = t + 2*#{words};
+    sp_digit* t3 = t + 4*#{words};
+    sp_digit* t4 = t + 6*#{words};
+    sp_digit* t5 = t + 8*#{words};
+
+    /* C = (X1 - X2)^2 */
+    sp_#{total}_mont_sub_#{cpu}#{f}(t1, x1, x2, p256_sm2_mod);
+    sp_#{total}_mont_sqr_#{cpu}#{f}(t1, t1, #{mm});
+    /* W2 = X2 * C, W1 = X1 * C */
+    sp_#{total}_mont_mul_#{cpu}#{f}(t2, x2, t1, #{mm});
+    sp_#{total}_mont_mul_#{cpu}#{f}(t3, x1, t1, #{mm});
+    /* X2 = (Y1 - Y2)^2 - W1 - W2 */
+    sp_#{total}_mont_sub_#{cpu}#{f}(t4, y1, y2, p256_sm2_mod);
+    sp_#{total}_mont_sqr_#{cpu}#{f}(t5, t4, #{mm});
+    sp_#{total}_mont_sub_#{cpu}#{f}(x2, t5, t3, p256_sm2_mod);
+    sp_#{total}_mont_sub_#{cpu}#{f}(x2, x2, t2, p256_sm2_mod);
+    /* X1 = (Y1 + Y2)^2 - W1 - W2 */
+    sp_#{total}_mont_add_#{cpu}#{f}(t1, y1, y2, p256_sm2_mod);
+    sp_#{total}_mont_sqr_#{cpu}#{f}(t5, t1, #{mm});
+    sp_#{total}_mont_sub_#{cpu}#{f}(x1, t5, t3, p256_sm2_mod);
+    sp_#{total}_mont_sub_#{cpu}#{f}(x1, x1, t2, p256_sm2_mod);
+    /* A = Y1 * (W1 - W2) */
+    sp_#{total}_mont_sub_#{cpu}#{f}(t2, t3, t2, p256_sm2_mod);
+    sp_#{total}_mont_mul_#{cpu}#{f}(t2, y1, t2, #{mm});
+    /* Y2 = (Y1 - Y2) * (W1 - X2) - A */
+    sp_#{total}_mont_sub_#{cpu}#{f}(t5, t3, x2, p256_sm2_mod);
+    sp_#{total}_mont_mul_#{cpu}#{f}(t4, t4, t5, #{mm});
+    sp_#{total}_mont_sub_#{cpu}#{f}(y2, t4, t2, p256_sm2_mod);
+    /* Y1 = (Y1 + Y2) * (W1 - X1) - A */
+    sp_#{total}_mont_sub_#{cpu}#{f}(t5, t3, x1, p256_sm2_mod);
+    sp_#{total}_mont_mul_#{cpu}#{f}(t1, t1, t5, #{mm});
+    sp_#{total}_mont_sub_#{cpu}#{f}(y1, t1, t2, p256_sm2_mod);
+}
+
+/* Multiply the affine point by the scalar calculating only the x ordinate.
+ *
+ * Co-Z Montgomery ladder with (X, Y)-only conjugate addition and addition.
+ * The Z ordinate is recovered at the end from the difference of the ladder
+ * points, which is always the input point, so only one inversion is needed.
+ * The scalar is recoded to k + n or k + 2n so that the top bit, 2^#{total}, is
+ * always set and the number of iterations is fixed.
+ * No table of points is used.
+ * The ladder fails for the scalars 1, (n-1)/2, n-2 and n-1. Without
+ * branching, the ladder is performed with k - 1 for these and the x ordinate
+ * of R1 is used instead. For 1 and n-1, x(k.P) = x(P) is selected at the end.
+ * Private keys that are zero or not less than the order, and points not in
+ * affine form, are not valid for the ladder and use the general
+ * implementation.
+ *
+ * r     Resulting point. Only the x ordinate is calculated.
+ * g     Point to multiply.
+ * k     Scalar to multiply by.
+ * heap  Heap to use for allocation.
+ * returns MEMORY_E when memory allocation fails and MP_OKAY on success.
+ */
+static int sp_#{total}_ecc_mulmod_x_#{cpu}#{f}(sp_point_#{total}* r,
+        const sp_point_#{total}* g, const sp_digit* k, void* heap)
+{
+#ifdef WOLFSSL_SP_SMALL_STACK
+    sp_digit* tmp = NULL;
+#else
+    sp_digit tmp[2 * #{words} * 17];
+#endif
+    sp_digit* t;
+    sp_digit* xa;
+    sp_digit* ya;
+    sp_digit* xb;
+    sp_digit* yb;
+    sp_digit* xp;
+    sp_digit* yp;
+    sp_digit* xg;
+    sp_digit* t1;
+    sp_digit* t2;
+    sp_digit* t3;
+    byte kb[#{total/8}];
+    byte kr[#{total/8}];
+    byte t8[#{total/8}];
+    sp_digit z;
+    sp_digit m;
+    sp_digit m1;
+    sp_digit mx;
+    word32 c;
+    word32 d;
+    word32 h;
+    word32 e1;
+    word32 eh;
+    word32 en1;
+    word32 en2;
+    int b;
+    int s;
+    int i;
+    int invalid = 1;
+    int err = MP_OKAY;
+
+    (void)heap;
+
+    /* Ladder requires an affine point. */
+    z = g->z[0] ^ 1;
+    for (i = 1; i < #{words}; i++) {
+        z |= g->z[i];
+    }
+
+#ifdef WOLFSSL_SP_SMALL_STACK
+    tmp = (sp_digit*)XMALLOC(sizeof(sp_digit) * 2 * #{words} * 17, heap,
+                             DYNAMIC_TYPE_ECC);
+    if (tmp == NULL)
+        err = MEMORY_E;
+#endif
+
+    if (err == MP_OKAY) {
+        t = tmp;
+        xa = tmp + 2 * #{words} * 10;
+        ya = tmp + 2 * #{words} * 11;
+        xb = tmp + 2 * #{words} * 12;
+        yb = tmp + 2 * #{words} * 13;
+        xp = tmp + 2 * #{words} * 14;
+        yp = tmp + 2 * #{words} * 15;
+        xg = tmp + 2 * #{words} * 16;
+
+        XMEMCPY(t, k, sizeof(sp_digit) * #{words});
+        sp_#{total}_to_bin_#{words}(t, kb);
+
+        /* Check for private keys that are not valid: k = 0 and k >= n. */
+        d = 0;
+        c = 0;
+        for (i = #{total/8 - 1}; i >= 0; i--) {
+            d |= kb[i];
+            c += (word32)kb[i] - #{@cname}_order_bin[i];
+            c = (word32)((sp_int32)c >> 8);
+        }
+        invalid = (z != 0) || (d == 0) || (c == 0);
+        if (invalid) {
+            err = sp_#{total}_ecc_mulmod_#{cpu}#{f}(r, g, k, 1, 1, heap);
+        }
+    }
+
+    if ((err == MP_OKAY) && (!invalid)) {
+        /* Check for scalars that are special cases of the ladder:
+         * k = 1, k = (n - 1) / 2, k = n - 2 and k = n - 1. */
+        e1 = kb[#{total/8 - 1}] ^ 1;
+        h = kb[0] ^ (#{@cname}_order_bin[0] >> 1);
+        d = 0;
+        for (i = 0; i < #{total/8 - 1}; i++) {
+            e1 |= kb[i];
+            h |= kb[i + 1] ^ (byte)((#{@cname}_order_bin[i + 1] >> 1) |
+                                    (#{@cname}_order_bin[i] << 7));
+            d |= kb[i] ^ #{@cname}_order_bin[i];
+        }
+        en1 = d | (kb[#{total/8 - 1}] ^ (byte)(#{@cname}_order_bin[#{total/8 - 1}] - 1));
+        en2 = d | (kb[#{total/8 - 1}] ^ (byte)(#{@cname}_order_bin[#{total/8 - 1}] - 2));
+        /* Each is 1 when equal and 0 otherwise. */
+        e1 = (e1 - 1) >> 31;
+        eh = (h - 1) >> 31;
+        en1 = (en1 - 1) >> 31;
+        en2 = (en2 - 1) >> 31;
+        m1 = (sp_digit)0 - (sp_digit)(e1 | eh | en1 | en2);
+        mx = (sp_digit)0 - (sp_digit)(e1 | en1);
+
+        /* Special cases use k - 1 and the x ordinate of R1. */
+        c = e1 | eh | en1 | en2;
+        for (i = #{total/8 - 1}; i >= 0; i--) {
+            c = (word32)kb[i] - c;
+            kb[i] = (byte)c;
+            c = (c >> 8) & 1;
+        }
+
+        /* Recode scalar: kr = k + n when it overflows, otherwise k + 2n.
+         * Bit #{total} is set in both cases. */
+        c = 0;
+        for (i = #{total/8 - 1}; i >= 0; i--) {
+            c += (word32)kb[i] + #{@cname}_order_bin[i];
+            t8[i] = (byte)c;
+            c >>= 8;
+        }
+        m = (sp_digit)0 - (sp_digit)c;
+        c = 0;
+        for (i = #{total/8 - 1}; i >= 0; i--) {
+            c += (word32)t8[i] + #{@cname}_order_bin[i];
+            kr[i] = (byte)c;
+            c >>= 8;
+        }
+        for (i = 0; i < #{total/8}; i++) {
+            kr[i] ^= (kr[i] ^ t8[i]) & (byte)m;
+        }
+
+        /* Keep x(P) as r may be the same as g. */
+        XMEMCPY(xg, g->x, sizeof(sp_digit) * #{words});
+        err = sp_#{total}_mod_mul_norm_#{cpu}#{f}(xp, g->x, p256_sm2_mod);
+    }
+    if ((err == MP_OKAY) && (!invalid))
+        err = sp_#{total}_mod_mul_norm_#{cpu}#{f}(yp, g->y, p256_sm2_mod);
+    if ((err == MP_OKAY) && (!invalid))
+        err = sp_#{total}_mod_mul_norm_#{cpu}#{f}(xa, g->z, p256_sm2_mod);
+    if ((err == MP_OKAY) && (!invalid)) {
+        /* R1 = 2.P */
+        XMEMCPY(r->x, xp, sizeof(sp_digit) * #{words});
+        XMEMCPY(r->y, yp, sizeof(sp_digit) * #{words});
+        XMEMCPY(r->z, xa, sizeof(sp_digit) * #{words});
+        r->infinity = 0;
+        sp_#{total}_proj_point_dbl_#{cpu}#{f}(r, r, t);
+        XMEMCPY(xb, r->x, sizeof(sp_digit) * #{words});
+        XMEMCPY(yb, r->y, sizeof(sp_digit) * #{words});
+        /* R0 = P with the same Z ordinate as R1. */
+        sp_#{total}_mont_sqr_#{cpu}#{f}(t, r->z, #{mm});
+        sp_#{total}_mont_mul_#{cpu}#{f}(xa, xp, t, #{mm});
+        sp_#{total}_mont_mul_#{cpu}#{f}(t, t, r->z, #{mm});
+        sp_#{total}_mont_mul_#{cpu}#{f}(ya, yp, t, #{mm});
+
+        /* A is R[b] and B is R[1-b] for the current bit b. */
+        s = 0;
+        for (i = #{total - 1}; i >= 0; i--) {
+            b = (kr[#{total/8 - 1} - (i >> 3)] >> (i & 7)) & 1;
+            m = (sp_digit)0 - (sp_digit)(b ^ s);
+            sp_#{total}_cond_swap_#{f}(xa, xb, m);
+            sp_#{total}_cond_swap_#{f}(ya, yb, m);
+            s = b;
+
+            /* R[1-b] = R[b] + R[1-b], R[b] = R[b] - R[1-b] */
+            sp_#{total}_proj_point_add_conj_coz_#{cpu}#{f}(xa, ya, xb, yb, t);
+            /* R[b] = R[1-b] + R[b] */
+            sp_#{total}_proj_point_add_coz_#{cpu}#{f}(xb, yb, xa, ya, t);
+        }
+        /* A is R0 and B is R1. */
+        m = (sp_digit)0 - (sp_digit)s;
+        sp_#{total}_cond_swap_#{f}(xa, xb, m);
+        sp_#{total}_cond_swap_#{f}(ya, yb, m);
+
+        /* Calculate P = R1 - R0 = (X', Y') with Z' = Z.(X1 - X0) and change
+         * R0 to have Z'. */
+        t1 = t;
+        t2 = t + 2 * #{words};
+        t3 = t + 4 * #{words};
+        sp_#{total}_mont_sub_#{cpu}#{f}(t1, xb, xa, p256_sm2_mod);
+        sp_#{total}_mont_sqr_#{cpu}#{f}(t1, t1, #{mm});
+        sp_#{total}_mont_mul_#{cpu}#{f}(xa, xa, t1, #{mm});
+        sp_#{total}_mont_mul_#{cpu}#{f}(xb, xb, t1, #{mm});
+        /* X' = (Y1 + Y0)^2 - W1 - W0 */
+        sp_#{total}_mont_add_#{cpu}#{f}(t2, yb, ya, p256_sm2_mod);
+        sp_#{total}_mont_sqr_#{cpu}#{f}(t3, t2, #{mm});
+        sp_#{total}_mont_sub_#{cpu}#{f}(t3, t3, xb, p256_sm2_mod);
+        sp_#{total}_mont_sub_#{cpu}#{f}(t3, t3, xa, p256_sm2_mod);
+        /* Y' = (Y1 + Y0) * (W1 - X') - Y1 * (W1 - W0) */
+        sp_#{total}_mont_sub_#{cpu}#{f}(t1, xb, xa, p256_sm2_mod);
+        sp_#{total}_mont_mul_#{cpu}#{f}(yb, yb, t1, #{mm});
+        sp_#{total}_mont_sub_#{cpu}#{f}(t1, xb, t3, p256_sm2_mod);
+        sp_#{total}_mont_mul_#{cpu}#{f}(t2, t2, t1, #{mm});
+        sp_#{total}_mont_sub_#{cpu}#{f}(t2, t2, yb, p256_sm2_mod);
+
+        /* 1/Z' = (y.X') / (x.Y') as P is (x, y) in affine.
+         * x(R0) = W0 / Z'^2 = (W0.(y.X')^2) / (x.Y')^2
+         * Use W1 instead of W0 for x(R1) with special cases. */
+        sp_#{total}_cond_swap_#{f}(xa, xb, m1);
+        sp_#{total}_mont_mul_#{cpu}#{f}(r->z, xp, t2, #{mm});
+        sp_#{total}_mont_mul_#{cpu}#{f}(t1, yp, t3, #{mm});
+        sp_#{total}_mont_sqr_#{cpu}#{f}(t1, t1, #{mm});
+        sp_#{total}_mont_mul_#{cpu}#{f}(r->x, xa, t1, #{mm});
+        sp_#{total}_map_#{cpu}#{f}(r, r, t);
+        /* x(k.P) = x(P) when k = 1 or k = n - 1. */
+        for (i = 0; i < #{words}; i++) {
+            r->x[i] ^= (r->x[i] ^ xg[i]) & mx;
+        }
+    }
+
+#ifdef WOLFSSL_SP_SMALL_STACK
+    if (tmp != NULL)
+#endif
+    {
+        ForceZero(tmp, sizeof(sp_digit) * 2 * #{words} * 17);
+    #ifdef WOLFSSL_SP_SMALL_STACK
+        XFREE(tmp, heap, DYNAMIC_TYPE_ECC);
+    #endif
+    }
+    ForceZero(kb, sizeof(kb));
+    ForceZero(kr, sizeof(kr));
+    ForceZero(t8, sizeof(t8));
+
+    return err;
+}
+
+EOF
+  end
+
+  # SM2 key exchange: U = t.(P + x.R) where x is a public 128-bit scalar.
+  # P + x.R is calculated in variable time with half the doublings, then one
+  # constant time multiplication by the secret t.
+  def sp_ecc_mulmod_kap_sm2(words, total)
+    f = "#{@namef}#{words}"
+    cpus = [ "" ]
+    cpus << @cpus[0] + "_" if @cpus.length > 0
+    cpus.each do |cpu|
+      puts "#ifdef HAVE_INTEL_AVX2" if cpu != ""
       puts <<EOF
+/* Multiply the point by a public scalar of at most 128 bits and add a point.
+ * Not constant time - only use with public scalars and points.
+ *
+ * r    Resulting point in Montgomery form. Must not be the same as a.
+ * t    Table of 16 points. Entry 1 is the point to multiply in Montgomery
+ *      form.
+ * k    Scalar to multiply by.
+ * a    Point to add in Montgomery form.
+ * tmp  Temporary ordinate data.
+ */
+static void sp_#{total}_ecc_mulmod_add_half_vt_#{cpu}#{f}(sp_point_#{total}* r,
+    sp_point_#{total}* t, const sp_digit* k, const sp_point_#{total}* a,
+    sp_digit* tmp)
+{
+    int i;
+    int j;
+    int y;
+
+    /* t[0] = infinity, t[2..15] = 2..15 times point */
+    XMEMSET(&t[0], 0, sizeof(t[0]));
+    t[0].infinity = 1;
+    for (i = 2; i < 16; i += 2) {
+        sp_#{total}_proj_point_dbl_#{cpu}#{f}(&t[i], &t[i / 2], tmp);
+        sp_#{total}_proj_point_add_#{cpu}#{f}(&t[i + 1], &t[i], &t[1], tmp);
+    }
+
+    XMEMCPY(r, &t[0], sizeof(sp_point_#{total}));
+    for (i = 124; i >= 0; i -= 4) {
+        y = 0;
+        for (j = 3; j >= 0; j--) {
+            y = (y << 1) | (int)((k[(i + j) / #{@bits}] >> ((i + j) % #{@bits})) & 1);
+        }
+        for (j = 0; (j < 4) && (!r->infinity); j++) {
+            sp_#{total}_proj_point_dbl_#{cpu}#{f}(r, r, tmp);
+        }
+        if (y != 0) {
+            sp_#{total}_proj_point_add_#{cpu}#{f}(r, r, &t[y], tmp);
+        }
+    }
+    sp_#{total}_proj_point_add_#{cpu}#{f}(r, r, a, tmp);
+}
+
+EOF
+      puts "#endif /* HAVE_INTEL_AVX2 */" if cpu != ""
+    end
+
+    if @cpus.length > 0
+      avx2_cond = <<EOF
 #ifdef HAVE_INTEL_AVX2
-        if (IS_INTEL_BMI2(cpuid_flags) && IS_INTEL_ADX(cpuid_flags)) {
+        if (IS_INTEL_BMI2(cpuid_flags) && IS_INTEL_ADX(cpuid_flags) &&
+                IS_INTEL_AVX2(cpuid_flags)) {
+EOF
+      cpuid_decl = "#ifdef HAVE_INTEL_AVX2\n    word32 cpuid_flags = cpuid_get_flags();\n#endif\n"
+    else
+      cpuid_decl = ""
+    end
+    calls = lambda do |cpu|
+      <<EOF
+            sp_#{total}_ecc_mulmod_add_half_vt_#{cpu}#{f}(u, t, x, q, tmp);
+            if (sp_#{total}_iszero_#{words}(u->z)) {
+                err = ECC_INF_E;
+            }
+            else {
+                sp_#{total}_map_#{cpu}#{f}(u, u, tmp);
+                err = sp_#{total}_ecc_mulmod_#{cpu}#{f}(u, u, k, 1, 1, heap);
+            }
 EOF
-      sqrt_y_ct(@cpus[0] + "_", sqrt_power)
+    end
+    puts <<EOF
+/* Calculate the SM2 key exchange point: U = t.(P + x.R)
+ * x is public and at most 128 bits. t is secret.
+ * Result is in affine coordinates.
+ *
+ * Q = P + x.R is calculated in variable time. P is the peer's static public
+ * key, R the peer's ephemeral public key and x is taken from the x ordinate of
+ * R. All are sent in the clear, so the timing reveals only what an
+ * eavesdropper can calculate for themselves. The secret t is only used in the
+ * constant time multiplication of Q.
+ *
+ * tm    Secret scalar t.
+ * xm    Public scalar x.
+ * pm    Peer's public key point P.
+ * rm    Peer's ephemeral point R.
+ * r     Resulting point U.
+ * heap  Heap to use for allocation.
+ * returns MEMORY_E when memory allocation fails, ECC_INF_E when P + x.R is the
+ * point at infinity, MP_VAL when x is too big and MP_OKAY on success.
+ */
+int sp_ecc_mulmod_kap_sm2_#{total}(const mp_int* tm, const mp_int* xm,
+    const ecc_point* pm, const ecc_point* rm, ecc_point* r, void* heap)
+{
+#ifdef WOLFSSL_SP_SMALL_STACK
+    sp_point_#{total}* t = NULL;
+    sp_digit* k = NULL;
+#else
+    sp_point_#{total} t[16 + 2];
+    sp_digit k[2 * #{words} + 2 * #{words} * 6];
+#endif
+    sp_point_#{total}* q = NULL;
+    sp_point_#{total}* u = NULL;
+    sp_digit* x = NULL;
+    sp_digit* tmp = NULL;
+    int err = MP_OKAY;
+#{cpuid_decl}
+    if (mp_count_bits(xm) > 128) {
+        err = MP_VAL;
+    }
+
+#ifdef WOLFSSL_SP_SMALL_STACK
+    if (err == MP_OKAY) {
+        t = (sp_point_#{total}*)XMALLOC(sizeof(sp_point_#{total}) * (16 + 2),
+            heap, DYNAMIC_TYPE_ECC);
+        if (t == NULL)
+            err = MEMORY_E;
+    }
+    if (err == MP_OKAY) {
+        k = (sp_digit*)XMALLOC(sizeof(sp_digit) *
+            (2 * #{words} + 2 * #{words} * 6), heap, DYNAMIC_TYPE_ECC);
+        if (k == NULL)
+            err = MEMORY_E;
+    }
+#endif
+
+    if (err == MP_OKAY) {
+        q = t + 16;
+        u = t + 17;
+        x = k + #{words};
+        tmp = k + 2 * #{words};
+
+        sp_#{total}_from_mp(k, #{words}, tm);
+        sp_#{total}_from_mp(x, #{words}, xm);
+        sp_#{total}_point_from_ecc_point_#{words}(&t[1], rm);
+        sp_#{total}_point_from_ecc_point_#{words}(q, pm);
+        err = sp_#{total}_mod_mul_norm_#{f}(t[1].x, t[1].x, p#{total}_sm2_mod);
+    }
+    if (err == MP_OKAY) {
+        err = sp_#{total}_mod_mul_norm_#{f}(t[1].y, t[1].y, p#{total}_sm2_mod);
+    }
+    if (err == MP_OKAY) {
+        err = sp_#{total}_mod_mul_norm_#{f}(t[1].z, t[1].z, p#{total}_sm2_mod);
+    }
+    if (err == MP_OKAY) {
+        err = sp_#{total}_mod_mul_norm_#{f}(q->x, q->x, p#{total}_sm2_mod);
+    }
+    if (err == MP_OKAY) {
+        err = sp_#{total}_mod_mul_norm_#{f}(q->y, q->y, p#{total}_sm2_mod);
+    }
+    if (err == MP_OKAY) {
+        err = sp_#{total}_mod_mul_norm_#{f}(q->z, q->z, p#{total}_sm2_mod);
+    }
+    if (err == MP_OKAY) {
+        /* Q = P + x.R - public values. U = t.Q - constant time. */
+EOF
+    if @cpus.length > 0
+      puts avx2_cond
+      puts calls.call(@cpus[0] + "_")
       puts <<EOF
         }
         else
 #endif
+        {
 EOF
+      puts calls.call("")
+      puts "        }"
+    else
+      puts calls.call("").gsub(/^            /, "        ")
     end
     puts <<EOF
-        {
+    }
+    if (err == MP_OKAY) {
+        err = sp_#{total}_point_to_ecc_point_#{words}(u, r);
+    }
+
+#ifdef WOLFSSL_SP_SMALL_STACK
+    if (k != NULL)
+#endif
+    {
+        ForceZero(k, sizeof(sp_digit) * #{words});
+    #ifdef WOLFSSL_SP_SMALL_STACK
+        XFREE(k, heap, DYNAMIC_TYPE_ECC);
+    #endif
+    }
+#ifdef WOLFSSL_SP_SMALL_STACK
+    XFREE(t, heap, DYNAMIC_TYPE_ECC);
+#endif
+
+    return err;
+}
+
+EOF
+  end
+
+  def sp_ecc_uncompress_batch_sm2(words, total)
+    f = "#{@namef}#{words}"
+    mm = "p#{total}_sm2_mod, p#{total}_sm2_mp_mod"
+    sint = (@bits > 32) ? "sp_int64" : "sp_int32"
+    if @cpus.length > 0
+      cpuid_decl = "#ifdef HAVE_INTEL_AVX2\n    word32 cpuid_flags = cpuid_get_flags();\n#endif\n"
+    else
+      cpuid_decl = ""
+    end
+    # Emit code with a dispatch to the AVX2 implementation when available.
+    dispatch = lambda do |code|
+      if @cpus.length > 0
+        avx2 = code.gsub("_#{f}(", "_#{@cpus[0]}_#{f}(")
+        <<EOF
+#ifdef HAVE_INTEL_AVX2
+            if (IS_INTEL_BMI2(cpuid_flags) && IS_INTEL_ADX(cpuid_flags) &&
+                    IS_INTEL_AVX2(cpuid_flags)) {
+#{avx2.gsub(/^/, "                ")}
+            }
+            else
+#endif
+            {
+#{code.gsub(/^/, "                ")}
+            }
+EOF
+      else
+        code.gsub(/^/, "            ") + "\n"
+      end
+    end
+    puts <<EOF
+/* Uncompress many points encoded as a byte indicating whether the Y ordinate
+ * is odd followed by the X ordinate.
+ * Constants are converted and temporaries, including those of the square
+ * root, allocated once for all points.
+ *
+ * cnt    Number of points.
+ * in     Encoded points - cnt * #{1 + total / 8} bytes.
+ * r      Array of points to set. Z ordinate is set to one.
+ * check  Whether to check that X is less than the prime and that the point is
+ *        on the curve.
+ * heap   Heap to use for allocation.
+ * returns MEMORY_E if dynamic memory allocation fails, MP_VAL when an encoding
+ * is invalid or, when checking, a point is not on the curve and MP_OKAY
+ * otherwise.
+ */
+int sp_ecc_uncompress_batch_sm2_#{total}(word32 cnt, const byte* in,
+    ecc_point** r, int check, void* heap)
+{
+#ifdef WOLFSSL_SP_SMALL_STACK
+    sp_digit* x = NULL;
+#else
+    sp_digit x[14 * #{words}];
+#endif
+    sp_digit* y = NULL;
+    sp_digit* z = NULL;
+    sp_digit* b = NULL;
+    sp_digit* t = NULL;
+    const byte* pt;
+    #{sint} n;
+    word32 i;
+    int err = MP_OKAY;
+#{cpuid_decl}
+    (void)heap;
+
+#ifdef WOLFSSL_SP_SMALL_STACK
+    x = (sp_digit*)XMALLOC(sizeof(sp_digit) * 14 * #{words}, heap,
+        DYNAMIC_TYPE_ECC);
+    if (x == NULL)
+        err = MEMORY_E;
+#endif
+
+    if (err == MP_OKAY) {
+        y = x + 2 * #{words};
+        z = x + 4 * #{words};
+        b = x + 6 * #{words};
+        t = x + 8 * #{words};
+
+        /* b in Montgomery form is used for all points. */
+        err = sp_#{total}_mod_mul_norm_#{f}(b, p#{total}_sm2_b, p#{total}_sm2_mod);
+    }
+    for (i = 0; (err == MP_OKAY) && (i < cnt); i++) {
+        pt = in + i * #{1 + total / 8};
+
+        if ((pt[0] != ECC_POINT_COMP_EVEN) && (pt[0] != ECC_POINT_COMP_ODD)) {
+            err = MP_VAL;
+        }
+        if (err == MP_OKAY) {
+            sp_#{total}_from_bin(x, #{words}, pt + 1, #{total / 8});
+            if (check && (sp_#{total}_cmp_#{f}(x, p#{total}_sm2_mod) >= 0)) {
+                err = MP_VAL;
+            }
+        }
+        if (err == MP_OKAY) {
+            err = sp_#{total}_to_mp(x, r[i]->x);
+        }
+        if (err == MP_OKAY) {
+            err = sp_#{total}_mod_mul_norm_#{f}(x, x, p#{total}_sm2_mod);
+        }
+        if (err == MP_OKAY) {
+            /* y = x^3 */
+EOF
+    puts dispatch.call(<<EOF.chomp)
+sp_#{total}_mont_sqr_#{f}(y, x, #{mm});
+sp_#{total}_mont_mul_#{f}(y, y, x, #{mm});
 EOF
-      sqrt_y_ct("", sqrt_power)
     puts <<EOF
+            /* y = x^3 - 3x + b */
+            sp_#{total}_mont_sub_#{f}(y, y, x, p#{total}_sm2_mod);
+            sp_#{total}_mont_sub_#{f}(y, y, x, p#{total}_sm2_mod);
+            sp_#{total}_mont_sub_#{f}(y, y, x, p#{total}_sm2_mod);
+            sp_#{total}_mont_add_#{f}(y, y, b, p#{total}_sm2_mod);
+            if (check) {
+                /* z = x^3 - 3x + b - not in Montgomery form */
+                XMEMCPY(z, y, #{words}U * sizeof(sp_digit));
+                XMEMSET(z + #{words}, 0, #{words}U * sizeof(sp_digit));
+                sp_#{total}_mont_reduce_#{f}(z, #{mm});
+                /* Reduce z to less than modulus */
+                n = sp_#{total}_cmp_#{f}(z, p#{total}_sm2_mod);
+                sp_#{total}_cond_sub_#{f}(z, z, p#{total}_sm2_mod, (sp_digit)~(n >> #{@bits - 1}));
+                sp_#{total}_norm_#{words}(z);
+            }
+            /* y = sqrt(x^3 - 3x + b) */
+            sp_#{total}_mont_sqrt_tmp_#{f}(y, t);
+        }
+        if ((err == MP_OKAY) && check) {
+            /* Point is on the curve when y^2 = x^3 - 3x + b */
+EOF
+    puts dispatch.call(<<EOF.chomp)
+sp_#{total}_mont_sqr_#{f}(x, y, #{mm});
+EOF
+    puts <<EOF
+            XMEMSET(x + #{words}, 0, #{words}U * sizeof(sp_digit));
+            sp_#{total}_mont_reduce_#{f}(x, #{mm});
+            /* Reduce x to less than modulus */
+            n = sp_#{total}_cmp_#{f}(x, p#{total}_sm2_mod);
+            sp_#{total}_cond_sub_#{f}(x, x, p#{total}_sm2_mod, (sp_digit)~(n >> #{@bits - 1}));
+            sp_#{total}_norm_#{words}(x);
+            if (sp_#{total}_cmp_#{f}(x, z) != 0) {
+                err = MP_VAL;
+            }
+        }
+        if (err == MP_OKAY) {
+            XMEMSET(y + #{words}, 0, #{words}U * sizeof(sp_digit));
+            sp_#{total}_mont_reduce_#{f}(y, #{mm});
+            /* Reduce y to less than modulus */
+            n = sp_#{total}_cmp_#{f}(y, p#{total}_sm2_mod);
+            sp_#{total}_cond_sub_#{f}(y, y, p#{total}_sm2_mod, (sp_digit)~(n >> #{@bits - 1}));
+            sp_#{total}_norm_#{words}(y);
+            if ((((word32)y[0] ^ (word32)pt[0]) & 1U) != 0U) {
+                sp_#{total}_mont_sub_#{f}(y, p#{total}_sm2_mod, y, p#{total}_sm2_mod);
+            }
+
+            err = sp_#{total}_to_mp(y, r[i]->y);
+        }
+        if (err == MP_OKAY) {
+            XMEMSET(x, 0, #{words}U * sizeof(sp_digit));
+            x[0] = 1;
+            err = sp_#{total}_to_mp(x, r[i]->z);
         }
     }
 
 #ifdef WOLFSSL_SP_SMALL_STACK
-    if (t != NULL)
-        XFREE(t, NULL, DYNAMIC_TYPE_ECC);
+    XFREE(x, heap, DYNAMIC_TYPE_ECC);
 #endif
 
     return err;
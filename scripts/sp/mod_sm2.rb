@@ -21,8 +21,85 @@
 # Implementation by Sean Parkinson
 
 module ModMulNormC_SM2
+  # Signed powers of 2 making up the prime:
+  #   p = 2^256 - 2^224 - 2^96 + 2^64 - 1
+  SM2_P256_TERMS = [ [ -1, 0 ], [ 1, 64 ], [ -1, 96 ], [ -1, 224 ], [ 1, 256 ] ]
+
   def div_sm2(words, words_full)
     div_full(words, words_full)
   end
+
+  # Lines of code adding the prime multiplied by the word b into r starting at
+  # word i, where the word -b is not added.
+  def mul_add_p_lines_sm2(r, i, b, indent)
+    adds = []
+    SM2_P256_TERMS.each do |sign, pos|
+      next if pos == 0
+      k = i + pos / @bits
+      s = pos % @bits
+      lo = (1 << (@bits - s)) - 1
+      adds << [ k    , sign, "((#{b} & 0x#{lo.to_s(16)}L) << #{s})" ]
+      adds << [ k + 1, sign, "(#{b} >> #{@bits - s})" ]
+    end
+
+    lines = []
+    adds.map { |k, _, _| k }.uniq.sort.each do |k|
+      terms = adds.select { |j, _, _| j == k }
+      neg = terms[0][1] < 0
+      line = "#{indent}#{r}[#{k.to_s.rjust(2)}] #{neg ? "-" : "+"}= #{terms[0][2]}"
+      terms[1..-1].each do |_, sign, e|
+        line += ((sign < 0) != neg ? " - " : " + ") + e
+      end
+      line = line.sub(/= \((.*)\)$/, '= \\1') if terms.length == 1
+      lines << line + ";"
+    end
+    lines
+  end
+
+  # Multiply the prime by a word and add into a number using only shifts,
+  # additions and subtractions.
+  def mul_add_p_sm2(words)
+    puts <<EOF
+#ifdef WOLFSSL_SP_SMALL
+/* Mul the modulus (prime) by scalar b and add into r. (r += m * b)
+ * Uses the special form of the modulus: 2^256 - 2^224 - 2^96 + 2^64 - 1
+ * Words of the result may be negative.
+ *
+ * r  A single precision integer.
+ * b  A scalar less than 2^#{@bits}.
+ */
+static void sp_#{@total}_mul_add_p_#{@namef}#{words}(sp_digit* r, const sp_digit b)
+{
+    r[ 0] -= b;
+EOF
+    puts mul_add_p_lines_sm2("r", 0, "b", "    ")
+    puts <<EOF
+}
+#endif /* WOLFSSL_SP_SMALL */
+
+EOF
+  end
+
+  # Montgomery reduction steps for the prime, unrolled, using the special form
+  # of the prime.
+  # Top words are normalized so that they are not negative.
+  def mont_red_p_sm2(words, himask)
+    puts "        /* Low words are shifted out - only subtract mu from top. */"
+    0.upto(words-1) do |i|
+      mask = (i < words - 1) ? @mask : "0x#{himask.to_s(16)}L"
+      ai = "a[#{i.to_s.rjust(2)}]"
+      ai1 = "a[#{(i+1).to_s.rjust(2)}]"
+      puts "        mu = #{ai} & #{mask};"
+      puts mul_add_p_lines_sm2("a", i, "mu", "        ")
+      puts "        #{ai} -= mu;" if i == words - 1
+      puts "        #{ai1} += #{ai} >> #{@bits};"
+    end
+    puts "        a[#{(words-1).to_s.rjust(2)}] &= #{@mask};"
+    words.upto(2*words-2) do |i|
+      ai = "a[#{i.to_s.rjust(2)}]"
+      ai1 = "a[#{(i+1).to_s.rjust(2)}]"
+      puts "        #{ai1} += #{ai} >> #{@bits}; #{ai} &= #{@mask};"
+    end
+  end
 end
 
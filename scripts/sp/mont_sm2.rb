@@ -21,6 +21,10 @@
 # Implementation by Sean Parkinson
 
 module MontC_SM2
+  # Reduce modulo the prime using the special form of the prime rather than
+  # multiplying by the words of the prime.
+  attr_accessor :sm2_special_red
+
   def mont_red_sm2_256(words, total)
     over = @bits - (total % @bits)
     himask = (1 << (total % @bits)) - 1
@@ -34,6 +38,7 @@ module MontC_SM2
     cmp(words)
     sub_cond(words)
     mul_add(words, 256)
+    mul_add_p_sm2(words) if @sm2_special_red
     norm(words, @total)
     mont_shift(words, over, total)
 
@@ -71,6 +76,30 @@ EOF
         a[i] &= #{@mask};
     }
     else {
+EOF
+    if @sm2_special_red
+      puts <<EOF
+#ifdef WOLFSSL_SP_SMALL
+        for (i=0; i<#{words-1}; i++) {
+            mu = a[i] & #{@mask};
+            sp_#{@total}_mul_add_p_#{@namef}#{words}(a+i, mu);
+            a[i+1] += a[i] >> #{@bits};
+        }
+        mu = a[i] & 0x#{himask.to_s(16)}L;
+        sp_#{@total}_mul_add_p_#{@namef}#{words}(a+i, mu);
+        a[i+1] += a[i] >> #{@bits};
+        a[i] &= #{@mask};
+        /* Top words may be negative - normalize before shifting down. */
+        for (i++; i<#{2*words-1}; i++) {
+            a[i+1] += a[i] >> #{@bits};
+            a[i] &= #{@mask};
+        }
+#else
+EOF
+      mont_red_p_sm2(words, himask)
+      puts "#endif /* WOLFSSL_SP_SMALL */"
+    else
+      puts <<EOF
         for (i=0; i<#{words-1}; i++) {
             mu = a[i] & #{@mask};
             sp_#{@total}_mul_add_#{@namef}#{words}(a+i, #{@cname}_mod, mu);
@@ -80,6 +109,9 @@ EOF
         sp_#{@total}_mul_add_#{@namef}#{words}(a+i, #{@cname}_mod, mu);
         a[i+1] += a[i] >> #{@bits};
         a[i] &= #{@mask};
+EOF
+    end
+    puts <<EOF
     }
 
     sp_#{@total}_mont_shift_#{words}(a, a);
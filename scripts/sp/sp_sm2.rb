@@ -81,6 +81,7 @@ def generate_sm2(platform, out_file)
   case platform
     when "32"
       sp32 = SinglePrecisionC_SM2.new(32)
+      sp32.sm2_special_red = true
       sp32.header()
       sp32.ifndef("WOLFSSL_SP_ASM")
       sp32.ifs("SP_WORD_SIZE == 32")
@@ -95,6 +96,7 @@ def generate_sm2(platform, out_file)
       sp32.trailer()
     when "64"
       sp64 = SinglePrecisionC_SM2.new(64)
+      sp64.sm2_special_red = true
       sp64.header()
       sp64.ifndef("WOLFSSL_SP_ASM")
       sp64.ifs("SP_WORD_SIZE == 64")
@@ -44,6 +44,119 @@
 
 /* Maximum number of signature generations to attempt before giving up. */
 #define ECC_SM2_MAX_SIG_GEN     64
+/* Maximum number of keys to pass to the optimised batch key generation. */
+#define ECC_SM2_KEY_BATCH       16
+
+#ifdef WOLFSSL_SM2_WORKSPACE
+/* The optimised SM2 implementations allocate their own temporaries unless
+ * built with WOLFSSL_SP_NO_MALLOC - only those of this file come from the
+ * workspace. */
+
+/* Alignment of allocations from the workspace. */
+#define SM2_WS_ALIGN            16
+/* Size of header before each allocation in the workspace. */
+#define SM2_WS_HDR_SZ           SM2_WS_ALIGN
+/* Flag in header's size indicating allocation has been freed. */
+#define SM2_WS_FREED            0x80000000U
+/* Size taken from workspace by an allocation of sz bytes. */
+#define SM2_WS_SZ(sz)           \
+    (SM2_WS_HDR_SZ + (((sz) + SM2_WS_ALIGN - 1) & ~(SM2_WS_ALIGN - 1)))
+
+#ifdef WOLFSSL_SMALL_STACK
+/* Size of the temporaries live at once in signing. */
+#ifdef WOLFSSL_SM2_DETERMINISTIC_K
+    #define SM2_WS_SIGN_DET_SZ  SM2_WS_SZ(sizeof(EccSm2DetK))
+#else
+    #define SM2_WS_SIGN_DET_SZ  0
+#endif
+#define SM2_WS_SIGN_SZ                                                  \
+    (2 * SM2_WS_SZ(sizeof(mp_int)) + SM2_WS_SZ(sizeof(mp_int) * 4) +    \
+     SM2_WS_SIGN_DET_SZ + SM2_WS_SZ(sizeof(ecc_key)))
+/* Size of the temporaries live at once in verification. */
+#define SM2_WS_VERIFY_SZ                                                \
+    (2 * SM2_WS_SZ(sizeof(mp_int)) + SM2_WS_SZ(sizeof(mp_int) * 5))
+#endif
+
+#ifdef WOLFSSL_SMALL_STACK
+/* Allocate memory from a workspace.
+ *
+ * Uses dynamic memory when no workspace is passed in.
+ *
+ * @param [in] ws    Workspace to allocate from. May be NULL.
+ * @param [in] size  Number of bytes to allocate.
+ * @param [in] heap  Dynamic memory hint.
+ * @param [in] type  Type of dynamic memory.
+ * @return  Allocated memory on success.
+ * @return  NULL when workspace is full or dynamic memory allocation fails.
+ */
+static void* ecc_sm2_ws_alloc(wc_Sm2Workspace* ws, size_t size, void* heap,
+    int type)
+{
+    void* ptr = NULL;
+
+    if (ws == NULL) {
+        ptr = XMALLOC(size, heap, type);
+    }
+    else if (SM2_WS_SZ(size) <= (size_t)(ws->size - ws->used)) {
+        word32* hdr = (word32*)(ws->buf + ws->used);
+
+        /* Header: offset of previous block and size of this block. */
+        hdr[0] = ws->last;
+        hdr[1] = (word32)(SM2_WS_SZ(size) - SM2_WS_HDR_SZ);
+        ws->last = ws->used;
+        ws->used += (word32)SM2_WS_SZ(size);
+        ptr = (byte*)hdr + SM2_WS_HDR_SZ;
+    }
+    else {
+        WOLFSSL_MSG("SM2 workspace too small");
+    }
+    (void)heap;
+    (void)type;
+
+    return ptr;
+}
+
+/* Free memory allocated with ecc_sm2_ws_alloc.
+ *
+ * Memory in the workspace is reclaimed once all later allocations are freed.
+ *
+ * @param [in] ws    Workspace allocated from. May be NULL.
+ * @param [in] ptr   Memory to free. May be NULL.
+ * @param [in] heap  Dynamic memory hint.
+ * @param [in] type  Type of dynamic memory.
+ */
+static void ecc_sm2_ws_free(wc_Sm2Workspace* ws, void* ptr, void* heap,
+    int type)
+{
+    if (ws == NULL) {
+        XFREE(ptr, heap, type);
+    }
+    else if (ptr != NULL) {
+        word32* hdr = (word32*)((byte*)ptr - SM2_WS_HDR_SZ);
+
+        hdr[1] |= SM2_WS_FREED;
+        /* Reclaim freed blocks from the top of the workspace. */
+        while (ws->used > 0) {
+            hdr = (word32*)(ws->buf + ws->last);
+            if ((hdr[1] & SM2_WS_FREED) == 0) {
+                break;
+            }
+            ws->used = ws->last;
+            ws->last = hdr[0];
+        }
+    }
+    (void)heap;
+    (void)type;
+}
+
+/* Temporaries of operations passed a workspace are allocated from it. */
+#define SM2_WS_ALLOC(ws, s, h, t)   ecc_sm2_ws_alloc((ws), (s), (h), (t))
+#define SM2_WS_FREE(ws, p, h, t)    ecc_sm2_ws_free((ws), (p), (h), (t))
+#endif /* WOLFSSL_SMALL_STACK */
+#else
+#define SM2_WS_ALLOC(ws, s, h, t)   ((void)(ws), XMALLOC((s), (h), (t)))
+#define SM2_WS_FREE(ws, p, h, t)    XFREE((p), (h), (t))
+#endif /* WOLFSSL_SM2_WORKSPACE */
 
 #ifndef NO_HASH_WRAPPER
 /* Convert hex string to binary and hash it.
@@ -345,6 +458,458 @@ int wc_ecc_sm2_make_key(WC_RNG* rng, ecc_key* key, int flags)
     return wc_ecc_make_key_ex2(rng, 32, key, ECC_SM2P256V1, flags);
 }
 
+/* Make a number of keys on the SM2 curve.
+ *
+ * With the optimised implementation, random data for the private keys is
+ * generated in blocks and the public keys are converted to affine together,
+ * making this faster than calling wc_ecc_sm2_make_key for each key.
+ *
+ * @param [in]  rng    Random number generator.
+ * @param [out] keys   Array of initialized ECC keys to hold generated keys.
+ * @param [in]  cnt    Number of keys to make.
+ * @param [in]  flags  Flags to set against ECC keys.
+ * @return  0 on success. On any other return, none of the keys hold a key.
+ * @return  BAD_FUNC_ARG when rng is NULL or keys is NULL and cnt is not 0.
+ * @return  MEMORY_E when dynamic memory allocation fails.
+ */
+int wc_ecc_sm2_make_key_batch(WC_RNG* rng, ecc_key* keys, word32 cnt,
+    int flags)
+{
+    int err = 0;
+    word32 i;
+#if defined(WOLFSSL_HAVE_SP_ECC) && defined(WOLFSSL_SP_SM2) && \
+    !defined(WOLFSSL_ECC_BLIND_K)
+    mp_int* priv[ECC_SM2_KEY_BATCH];
+    ecc_point* pub[ECC_SM2_KEY_BATCH];
+    word32 n;
+    word32 j;
+#endif
+
+    if ((rng == NULL) || ((keys == NULL) && (cnt > 0))) {
+        err = BAD_FUNC_ARG;
+    }
+
+#if defined(WOLFSSL_HAVE_SP_ECC) && defined(WOLFSSL_SP_SM2) && \
+    !defined(WOLFSSL_ECC_BLIND_K)
+    for (i = 0; (err == 0) && (i < cnt); i += n) {
+        n = cnt - i;
+        if (n > ECC_SM2_KEY_BATCH) {
+            n = ECC_SM2_KEY_BATCH;
+        }
+    #ifdef WOLF_CRYPTO_CB
+        /* Keys on a device are made individually. */
+        if (keys[i].devId != INVALID_DEVID) {
+            err = wc_ecc_sm2_make_key(rng, &keys[i], flags);
+            n = 1;
+            continue;
+        }
+        for (j = 1; j < n; j++) {
+            if (keys[i + j].devId != INVALID_DEVID) {
+                n = j;
+                break;
+            }
+        }
+    #endif
+        for (j = 0; (err == 0) && (j < n); j++) {
+            err = wc_ecc_set_curve(&keys[i + j], 32, ECC_SM2P256V1);
+            if (err == 0) {
+                keys[i + j].flags = (byte)flags;
+                priv[j] = keys[i + j].k;
+                pub[j] = &keys[i + j].pubkey;
+            }
+        }
+        if (err == 0) {
+            SAVE_VECTOR_REGISTERS(return _svr_ret;);
+            err = sp_ecc_make_key_batch_sm2_256(rng, n, priv, pub,
+                keys[i].heap);
+            RESTORE_VECTOR_REGISTERS();
+        }
+        for (j = 0; (err == 0) && (j < n); j++) {
+            keys[i + j].type = ECC_PRIVATEKEY;
+        }
+    }
+#else
+    for (i = 0; (err == 0) && (i < cnt); i++) {
+        err = wc_ecc_sm2_make_key(rng, &keys[i], flags);
+    }
+#endif
+
+    if ((err != 0) && (rng != NULL) && (keys != NULL)) {
+        /* Don't leave some of the keys made when the batch failed. */
+        for (i = 0; i < cnt; i++) {
+            mp_forcezero(keys[i].k);
+            mp_zero(keys[i].pubkey.x);
+            mp_zero(keys[i].pubkey.y);
+            mp_zero(keys[i].pubkey.z);
+            keys[i].type = 0;
+        }
+    }
+
+    return err;
+}
+
+#if defined(HAVE_ECC_KEY_IMPORT) && defined(HAVE_COMP_KEY)
+/* Import a number of compressed public keys on the SM2 curve.
+ *
+ * Each encoded point is WC_SM2_COMP_POINT_SIZE bytes: 0x02 or 0x03 followed
+ * by the X ordinate.
+ * With the optimised implementation, the curve constants are converted and
+ * the temporaries allocated once for all points.
+ *
+ * @param [in]      in     Encoded points one after the other.
+ * @param [in]      inSz   Size of encoded points in bytes.
+ * @param [in, out] keys   Array of initialized ECC keys to import into.
+ * @param [in]      cnt    Number of keys to import.
+ * @param [in]      check  0 when points have already been validated and the
+ *                         check that each point is on the curve can be
+ *                         skipped.
+ * @return  0 on success. On any other return, none of the keys hold a point -
+ *          not even the valid points.
+ * @return  BAD_FUNC_ARG when in or keys is NULL and cnt is not 0 or inSz is
+ *          not cnt compressed points.
+ * @return  MP_VAL or IS_POINT_E when an encoded point is invalid.
+ */
+int wc_ecc_sm2_import_point_batch(const byte* in, word32 inSz, ecc_key* keys,
+    word32 cnt, int check)
+{
+    int err = 0;
+    word32 i;
+#if defined(WOLFSSL_HAVE_SP_ECC) && defined(WOLFSSL_SP_SM2)
+    ecc_point* pub[ECC_SM2_KEY_BATCH];
+    word32 n;
+    word32 j;
+#endif
+
+    if (((in == NULL) || (keys == NULL)) && (cnt > 0)) {
+        err = BAD_FUNC_ARG;
+    }
+    if ((err == 0) && ((cnt > inSz / WC_SM2_COMP_POINT_SIZE) ||
+            (inSz != cnt * WC_SM2_COMP_POINT_SIZE))) {
+        err = BAD_FUNC_ARG;
+    }
+
+#if defined(WOLFSSL_HAVE_SP_ECC) && defined(WOLFSSL_SP_SM2)
+    for (i = 0; (err == 0) && (i < cnt); i += n) {
+        n = cnt - i;
+        if (n > ECC_SM2_KEY_BATCH) {
+            n = ECC_SM2_KEY_BATCH;
+        }
+        for (j = 0; (err == 0) && (j < n); j++) {
+            err = wc_ecc_set_curve(&keys[i + j], 32, ECC_SM2P256V1);
+            if (err == 0) {
+                pub[j] = &keys[i + j].pubkey;
+            }
+        }
+        if (err == 0) {
+            SAVE_VECTOR_REGISTERS(return _svr_ret;);
+            err = sp_ecc_uncompress_batch_sm2_256(n,
+                in + i * WC_SM2_COMP_POINT_SIZE, pub, check, keys[i].heap);
+            RESTORE_VECTOR_REGISTERS();
+        }
+        for (j = 0; (err == 0) && (j < n); j++) {
+            keys[i + j].type = ECC_PUBLICKEY;
+        }
+    }
+#else
+    for (i = 0; (err == 0) && (i < cnt); i++) {
+        err = wc_ecc_import_x963_ex(in + i * WC_SM2_COMP_POINT_SIZE,
+            WC_SM2_COMP_POINT_SIZE, &keys[i], ECC_SM2P256V1);
+        if ((err == 0) && check) {
+            err = wc_ecc_point_is_on_curve(&keys[i].pubkey, keys[i].idx);
+        }
+    }
+#endif
+
+    if ((err != 0) && (keys != NULL) &&
+            (cnt <= inSz / WC_SM2_COMP_POINT_SIZE)) {
+        /* Don't leave some of the points imported when one is invalid. */
+        for (i = 0; i < cnt; i++) {
+            mp_forcezero(keys[i].k);
+            mp_zero(keys[i].pubkey.x);
+            mp_zero(keys[i].pubkey.y);
+            mp_zero(keys[i].pubkey.z);
+            keys[i].type = 0;
+        }
+    }
+
+    return err;
+}
+#endif /* HAVE_ECC_KEY_IMPORT && HAVE_COMP_KEY */
+
+#ifdef HAVE_ECC_CHECK_KEY
+#ifdef WOLFSSL_SM2_PUB_KEY_CACHE
+#if (WC_SM2_PUB_KEY_CACHE_SZ & (WC_SM2_PUB_KEY_CACHE_SZ - 1)) != 0
+    #error "WC_SM2_PUB_KEY_CACHE_SZ must be a power of 2"
+#endif
+
+/* Public keys, x || y, that have been validated. All zeros when unused - not
+ * a point on the curve. */
+static byte sm2PubKeyCache[WC_SM2_PUB_KEY_CACHE_SZ][2 * SM2_KEY_SIZE];
+#ifndef SINGLE_THREADED
+#ifndef WOLFSSL_MUTEX_INITIALIZER
+    static volatile int initSm2PubKeyCacheMutex = 0;
+#endif
+/* Protects the cache of validated public keys. */
+static wolfSSL_Mutex sm2PubKeyCacheLock
+    WOLFSSL_MUTEX_INITIALIZER_CLAUSE(sm2PubKeyCacheLock);
+#endif
+
+/* Lock the cache of validated public keys.
+ *
+ * @return  0 on success.
+ * @return  BAD_MUTEX_E when the lock can't be taken.
+ */
+static int ecc_sm2_pub_key_cache_lock(void)
+{
+    int err = 0;
+
+#ifndef SINGLE_THREADED
+#ifndef WOLFSSL_MUTEX_INITIALIZER
+    if (initSm2PubKeyCacheMutex == 0) {
+        if (wc_InitMutex(&sm2PubKeyCacheLock) != 0) {
+            err = BAD_MUTEX_E;
+        }
+        else {
+            initSm2PubKeyCacheMutex = 1;
+        }
+    }
+#endif
+    if ((err == 0) && (wc_LockMutex(&sm2PubKeyCacheLock) != 0)) {
+        err = BAD_MUTEX_E;
+    }
+#endif
+
+    return err;
+}
+
+/* Unlock the cache of validated public keys. */
+static void ecc_sm2_pub_key_cache_unlock(void)
+{
+#ifndef SINGLE_THREADED
+    wc_UnLockMutex(&sm2PubKeyCacheLock);
+#endif
+}
+
+/* Get the index into the cache of a public key.
+ *
+ * Entries are replaced when another public key has the same index. Lookups
+ * compare the whole public key so a different key is never found.
+ *
+ * @param [in] pub  Public key as x || y.
+ * @return  Index into cache.
+ */
+static word32 ecc_sm2_pub_key_cache_idx(const byte* pub)
+{
+    word32 h = 0;
+    int i;
+
+    for (i = 0; i < 2 * SM2_KEY_SIZE; i += 4) {
+        h ^= ((word32)pub[i + 0] << 24) | ((word32)pub[i + 1] << 16) |
+             ((word32)pub[i + 2] <<  8) |  (word32)pub[i + 3];
+    }
+    h ^= h >> 16;
+
+    return h & (WC_SM2_PUB_KEY_CACHE_SZ - 1);
+}
+
+/* Find a public key in the cache of validated public keys.
+ *
+ * @param [in] pub  Public key as x || y.
+ * @return  1 when found.
+ * @return  0 otherwise.
+ */
+static int ecc_sm2_pub_key_cache_find(const byte* pub)
+{
+    int found = 0;
+    word32 idx = ecc_sm2_pub_key_cache_idx(pub);
+
+    if (ecc_sm2_pub_key_cache_lock() == 0) {
+        found = (XMEMCMP(sm2PubKeyCache[idx], pub, 2 * SM2_KEY_SIZE) == 0);
+        ecc_sm2_pub_key_cache_unlock();
+    }
+
+    return found;
+}
+
+/* Add a validated public key to the cache.
+ *
+ * @param [in] pub  Public key as x || y.
+ */
+static void ecc_sm2_pub_key_cache_add(const byte* pub)
+{
+    word32 idx = ecc_sm2_pub_key_cache_idx(pub);
+
+    if (ecc_sm2_pub_key_cache_lock() == 0) {
+        XMEMCPY(sm2PubKeyCache[idx], pub, 2 * SM2_KEY_SIZE);
+        ecc_sm2_pub_key_cache_unlock();
+    }
+}
+
+/* Remove all public keys from the cache of validated public keys. */
+void wc_ecc_sm2_pub_key_cache_clear(void)
+{
+    if (ecc_sm2_pub_key_cache_lock() == 0) {
+        XMEMSET(sm2PubKeyCache, 0, sizeof(sm2PubKeyCache));
+        ecc_sm2_pub_key_cache_unlock();
+    }
+}
+#endif /* WOLFSSL_SM2_PUB_KEY_CACHE */
+
+/* Check the public key is on the curve and has the order of the base point.
+ *
+ * @param [in] key  SM2 ECC key with public key set.
+ * @return  0 on success.
+ * @return  ECC_INF_E when the public key is the point at infinity or the
+ *          public key multiplied by the order is not infinity.
+ * @return  ECC_OUT_OF_RANGE_E when an ordinate is not less than the prime.
+ * @return  MP_VAL or IS_POINT_E when the public key is not on the curve.
+ * @return  MEMORY_E when dynamic memory allocation fails.
+ */
+static int ecc_sm2_check_pub_key(ecc_key* key)
+{
+    int err = 0;
+#if !defined(WOLFSSL_HAVE_SP_ECC) || !defined(WOLFSSL_SP_SM2)
+#ifndef WOLFSSL_SP_MATH
+    ecc_point* inf = NULL;
+#ifdef WOLFSSL_SMALL_STACK
+    mp_int* data = NULL;
+#else
+    mp_int data[3];
+#endif
+    mp_int* a = NULL;
+    mp_int* prime = NULL;
+    mp_int* order = NULL;
+#endif
+#endif
+
+#if defined(WOLFSSL_HAVE_SP_ECC) && defined(WOLFSSL_SP_SM2)
+    SAVE_VECTOR_REGISTERS(return _svr_ret;);
+    /* On curve and point * order = infinity. */
+    err = sp_ecc_check_key_sm2_256(key->pubkey.x, key->pubkey.y, NULL,
+        key->heap);
+    RESTORE_VECTOR_REGISTERS();
+#elif !defined(WOLFSSL_SP_MATH)
+    if (wc_ecc_point_is_at_infinity(&key->pubkey)) {
+        err = ECC_INF_E;
+    }
+    if (err == 0) {
+        err = wc_ecc_point_is_on_curve(&key->pubkey, key->idx);
+    }
+#ifdef WOLFSSL_SMALL_STACK
+    if (err == 0) {
+        data = (mp_int*)XMALLOC(sizeof(mp_int) * 3, key->heap,
+            DYNAMIC_TYPE_ECC);
+        if (data == NULL) {
+            err = MEMORY_E;
+        }
+    }
+#endif
+    if (err == 0) {
+        a = data;
+        prime = data + 1;
+        order = data + 2;
+        err = mp_init_multi(a, prime, order, NULL, NULL, NULL);
+    }
+    if (err == 0) {
+        err = mp_read_radix(a, key->dp->Af, MP_RADIX_HEX);
+    }
+    if (err == 0) {
+        err = mp_read_radix(prime, key->dp->prime, MP_RADIX_HEX);
+    }
+    if (err == 0) {
+        err = mp_read_radix(order, key->dp->order, MP_RADIX_HEX);
+    }
+    if (err == 0) {
+        inf = wc_ecc_new_point_h(key->heap);
+        if (inf == NULL) {
+            err = MEMORY_E;
+        }
+    }
+    if (err == 0) {
+        /* Point * order = infinity */
+        err = wc_ecc_mulmod_ex(order, &key->pubkey, inf, a, prime, 1,
+            key->heap);
+    }
+    if ((err == 0) && (!wc_ecc_point_is_at_infinity(inf))) {
+        err = ECC_INF_E;
+    }
+
+    wc_ecc_del_point_h(inf, key->heap);
+    if (a != NULL) {
+        mp_free(order);
+        mp_free(prime);
+        mp_free(a);
+    }
+#ifdef WOLFSSL_SMALL_STACK
+    XFREE(data, key->heap, DYNAMIC_TYPE_ECC);
+#endif
+#else
+    (void)key;
+    err = NOT_COMPILED_IN;
+#endif
+
+    return err;
+}
+
+/* Check the public key of an SM2 key is valid.
+ *
+ * The public key is checked to be on the curve and multiplied by the order.
+ * With WOLFSSL_SM2_PUB_KEY_CACHE, valid public keys are cached, by their x
+ * and y ordinates, for all threads so that checking the same public key
+ * again, in any key object, doesn't repeat the check. Nothing is remembered
+ * in the key object so a public key imported into it later is always
+ * checked.
+ *
+ * @param [in, out] key  SM2 ECC key with public key set.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when key is NULL or not on the SM2 curve.
+ * @return  ECC_INF_E when the public key is the point at infinity or not of
+ *          the order of the base point.
+ * @return  ECC_OUT_OF_RANGE_E when an ordinate is not less than the prime.
+ * @return  MP_VAL or IS_POINT_E when the public key is not on the curve.
+ * @return  MEMORY_E when dynamic memory allocation fails.
+ */
+int wc_ecc_sm2_check_pub_key(ecc_key* key)
+{
+    int err = 0;
+    int valid = 0;
+#ifdef WOLFSSL_SM2_PUB_KEY_CACHE
+    byte pub[2 * SM2_KEY_SIZE];
+    int cache = 0;
+#endif
+
+    if ((key == NULL) || (key->dp == NULL)) {
+        err = BAD_FUNC_ARG;
+    }
+    if ((err == 0) && (key->dp->id != ECC_SM2P256V1) &&
+        (key->idx != ECC_CUSTOM_IDX)) {
+        err = BAD_FUNC_ARG;
+    }
+
+#ifdef WOLFSSL_SM2_PUB_KEY_CACHE
+    /* Only cache SM2 public keys with ordinates that fit. */
+    if ((err == 0) && (key->dp->id == ECC_SM2P256V1) &&
+            (mp_to_unsigned_bin_len(key->pubkey.x, pub,
+                SM2_KEY_SIZE) == MP_OKAY) &&
+            (mp_to_unsigned_bin_len(key->pubkey.y, pub + SM2_KEY_SIZE,
+                SM2_KEY_SIZE) == MP_OKAY)) {
+        cache = 1;
+        valid = ecc_sm2_pub_key_cache_find(pub);
+    }
+#endif
+    if ((err == 0) && (!valid)) {
+        err = ecc_sm2_check_pub_key(key);
+    #ifdef WOLFSSL_SM2_PUB_KEY_CACHE
+        if ((err == 0) && cache) {
+            ecc_sm2_pub_key_cache_add(pub);
+        }
+    #endif
+    }
+
+    return err;
+}
+#endif /* HAVE_ECC_CHECK_KEY */
+
 /* Create a shared secret from the private key and peer's public key.
  *
  * @param [in]      priv    Private key.
@@ -434,42 +999,344 @@ static int _ecc_sm2_calc_r_s(mp_int* x, mp_int* px, mp_int* k, mp_int* e,
 }
 #endif
 
-/* Calculate the signature from the hash with a key on the SM2 curve.
+#ifdef WOLFSSL_SM2_DETERMINISTIC_K
+#if defined(WOLFSSL_ECDSA_DETERMINISTIC_K) || \
+    defined(WOLFSSL_ECDSA_DETERMINISTIC_K_VARIANT)
+    /* Key set to generate k deterministically with wc_ecc_set_deterministic.
+     */
+    #define ECC_SM2_KEY_DET_K(key)      ((key)->deterministic)
+#else
+    #define ECC_SM2_KEY_DET_K(key)      0
+#endif
+
+/* HMAC_DRBG state for generating k deterministically. RFC 6979, 3.2. */
+typedef struct EccSm2DetK {
+    /* HMAC-SM3 object. */
+    Hmac hmac;
+    /* Key of HMAC - K. */
+    byte k[WC_SM3_DIGEST_SIZE];
+    /* Value - V. */
+    byte v[WC_SM3_DIGEST_SIZE];
+    /* Whether a value of k has been generated. */
+    byte gen;
+} EccSm2DetK;
+
+/* Calculate HMAC-SM3 with the key K over V with optional data appended.
  *
- * Use wc_ecc_sm2_create_digest to calculate the digest.
+ * out = HMAC_K(V || sep || x || h1 || extra)
  *
- * @param [in]  hash    Array of bytes holding hash value.
- * @param [in]  hashSz  Size of hash in bytes.
- * @param [in]  rng     Random number generator.
- * @param [in]  key     ECC private key.
- * @param [out] r       'r' part of signature as an MP integer.
- * @param [out] s       's' part of signature as an MP integer.
- * @return  MP_OKAY on success.
- * @return  ECC_BAD_ARGE_E when hash, r, s, key or rng is NULL.
- * @return  ECC_BAD_ARGE_E when key is not on SM2 curve.
+ * @param [in, out] det      Deterministic k state.
+ * @param [in]      sep      Separator byte. Negative when no data appended.
+ * @param [in]      x        Private key encoded in bytes. May be NULL.
+ * @param [in]      h1       Hash reduced by order encoded in bytes.
+ * @param [in]      extra    Additional data. May be NULL.
+ * @param [in]      extraSz  Size of additional data in bytes.
+ * @param [out]     out      Buffer to hold HMAC. May be K or V.
+ * @return  0 on success.
  */
-int wc_ecc_sm2_sign_hash_ex(const byte* hash, word32 hashSz, WC_RNG* rng,
-    ecc_key* key, mp_int* r, mp_int* s)
+static int ecc_sm2_det_k_hmac(EccSm2DetK* det, int sep, const byte* x,
+    const byte* h1, const byte* extra, word32 extraSz, byte* out)
 {
-    int err = MP_OKAY;
-#ifndef WOLFSSL_SP_MATH
-    mp_int* x = NULL;
-    mp_int* e = NULL;
-    mp_int* b = NULL;
-    mp_int* order = NULL;
-#ifdef WOLFSSL_SMALL_STACK
-    ecc_key* pub = NULL;
-    mp_int* data = NULL;
-#else
-    ecc_key pub[1];
-    mp_int data[4];
+    int err;
+    byte b;
+
+    err = wc_HmacSetKey(&det->hmac, WC_SM3, det->k, WC_SM3_DIGEST_SIZE);
+    if (err == 0) {
+        err = wc_HmacUpdate(&det->hmac, det->v, WC_SM3_DIGEST_SIZE);
+    }
+    if ((err == 0) && (sep >= 0)) {
+        b = (byte)sep;
+        err = wc_HmacUpdate(&det->hmac, &b, 1);
+    }
+    if ((err == 0) && (x != NULL)) {
+        err = wc_HmacUpdate(&det->hmac, x, SM2_KEY_SIZE);
+    }
+    if ((err == 0) && (x != NULL)) {
+        err = wc_HmacUpdate(&det->hmac, h1, SM2_KEY_SIZE);
+    }
+    if ((err == 0) && (x != NULL) && (extraSz > 0)) {
+        err = wc_HmacUpdate(&det->hmac, extra, extraSz);
+    }
+    if (err == 0) {
+        err = wc_HmacFinal(&det->hmac, out);
+    }
+
+    return err;
+}
+
+/* Initialize the state for generating k deterministically. RFC 6979, 3.2.
+ *
+ * Additional data is appended as in RFC 6979, 3.6. Random data makes the
+ * signature non-deterministic but protects against faults.
+ *
+ * @param [out] det      Deterministic k state.
+ * @param [in]  key      ECC private key.
+ * @param [in]  hash     Array of bytes holding hash value.
+ * @param [in]  hashSz   Size of hash in bytes.
+ * @param [in]  order    Order of curve.
+ * @param [in]  extra    Additional data. May be NULL.
+ * @param [in]  extraSz  Size of additional data in bytes.
+ * @param [in]  t        Temporary MP integer.
+ * @return  0 on success.
+ */
+static int ecc_sm2_det_k_init(EccSm2DetK* det, ecc_key* key, const byte* hash,
+    word32 hashSz, mp_int* order, const byte* extra, word32 extraSz,
+    mp_int* t)
+{
+    int err;
+    byte x[SM2_KEY_SIZE];
+    byte h1[SM2_KEY_SIZE];
+
+    det->gen = 0;
+    err = wc_HmacInit(&det->hmac, key->heap, INVALID_DEVID);
+    if (err == 0) {
+        /* x = int2octets(d) */
+        err = mp_to_unsigned_bin_len(wc_ecc_key_get_priv(key), x,
+            SM2_KEY_SIZE);
+    }
+    if (err == 0) {
+        /* h1 = bits2octets(H(m)) - hash is the size of the order. */
+        if (hashSz > SM2_KEY_SIZE) {
+            hashSz = SM2_KEY_SIZE;
+        }
+        err = mp_read_unsigned_bin(t, hash, hashSz);
+    }
+    if (err == 0) {
+        err = mp_mod(t, order, t);
+    }
+    if (err == 0) {
+        err = mp_to_unsigned_bin_len(t, h1, SM2_KEY_SIZE);
+    }
+    if (err == 0) {
+        /* V = 0x01 0x01 ... 0x01, K = 0x00 0x00 ... 0x00 */
+        XMEMSET(det->v, 0x01, sizeof(det->v));
+        XMEMSET(det->k, 0x00, sizeof(det->k));
+        /* K = HMAC_K(V || 0x00 || x || h1 || extra), V = HMAC_K(V) */
+        err = ecc_sm2_det_k_hmac(det, 0x00, x, h1, extra, extraSz, det->k);
+    }
+    if (err == 0) {
+        err = ecc_sm2_det_k_hmac(det, -1, NULL, NULL, NULL, 0, det->v);
+    }
+    if (err == 0) {
+        /* K = HMAC_K(V || 0x01 || x || h1 || extra), V = HMAC_K(V) */
+        err = ecc_sm2_det_k_hmac(det, 0x01, x, h1, extra, extraSz, det->k);
+    }
+    if (err == 0) {
+        err = ecc_sm2_det_k_hmac(det, -1, NULL, NULL, NULL, 0, det->v);
+    }
+
+    ForceZero(x, sizeof(x));
+    ForceZero(h1, sizeof(h1));
+    return err;
+}
+
+/* Generate the next value of k deterministically. RFC 6979, 3.2 h.
+ *
+ * Call again when the value of k doesn't result in a valid signature.
+ *
+ * @param [in, out] det    Deterministic k state.
+ * @param [in]      order  Order of curve.
+ * @param [out]     k      Generated value in range [1, order - 1].
+ * @return  0 on success.
+ */
+static int ecc_sm2_det_k_gen(EccSm2DetK* det, mp_int* order, mp_int* k)
+{
+    int err = 0;
+    int done = 0;
+
+    while ((err == 0) && (!done)) {
+        if (det->gen) {
+            /* K = HMAC_K(V || 0x00), V = HMAC_K(V) */
+            err = ecc_sm2_det_k_hmac(det, 0x00, NULL, NULL, NULL, 0, det->k);
+            if (err == 0) {
+                err = ecc_sm2_det_k_hmac(det, -1, NULL, NULL, NULL, 0,
+                    det->v);
+            }
+        }
+        det->gen = 1;
+        /* V = HMAC_K(V), T = V - order is the size of the hash output. */
+        if (err == 0) {
+            err = ecc_sm2_det_k_hmac(det, -1, NULL, NULL, NULL, 0, det->v);
+        }
+        /* k = bits2int(T) */
+        if (err == 0) {
+            err = mp_read_unsigned_bin(k, det->v, WC_SM3_DIGEST_SIZE);
+        }
+        /* Use k when in range [1, order - 1]. */
+        if ((err == 0) && (!mp_iszero(k)) && (mp_cmp(k, order) == MP_LT)) {
+            done = 1;
+        }
+    }
+
+    return err;
+}
+
+#ifdef WOLFSSL_SM2_DET_K_TEST
+/* Number of deterministically generated values of k still to reject. */
+static int ecc_sm2_det_k_reject = 0;
+
+/* Reject the next values of k generated deterministically when signing, as
+ * if the signature could not be made with them.
+ *
+ * For testing the retry path only - not thread safe.
+ *
+ * @param [in] cnt  Number of values of k to reject.
+ */
+void wc_ecc_sm2_det_k_test_reject(int cnt)
+{
+    ecc_sm2_det_k_reject = cnt;
+}
+
+/* Check whether the deterministically generated k is to be rejected.
+ *
+ * @return  1 when k is to be rejected.
+ * @return  0 otherwise.
+ */
+static int ecc_sm2_det_k_test_reject(void)
+{
+    int reject = (ecc_sm2_det_k_reject > 0);
+
+    if (reject) {
+        ecc_sm2_det_k_reject--;
+    }
+    return reject;
+}
+#endif
+
+/* Dispose of the state for generating k deterministically.
+ *
+ * @param [in, out] det  Deterministic k state.
+ */
+static void ecc_sm2_det_k_free(EccSm2DetK* det)
+{
+    wc_HmacFree(&det->hmac);
+    ForceZero(det, sizeof(EccSm2DetK));
+}
+
+#ifndef WOLFSSL_SP_MATH
+/* Generate a blinding value from the deterministic k state.
+ *
+ * b = HMAC_K(V || 0x02) mod order. K and V are not changed so that the
+ * sequence of values of k is that of RFC 6979 - the same as the SP code.
+ *
+ * @param [in]  det    Deterministic k state.
+ * @param [in]  order  Order of curve.
+ * @param [out] b      Blinding value in range [1, order - 1].
+ * @return  0 on success.
+ */
+static int ecc_sm2_det_k_blind(EccSm2DetK* det, mp_int* order, mp_int* b)
+{
+    int err;
+    byte t[WC_SM3_DIGEST_SIZE];
+
+    err = ecc_sm2_det_k_hmac(det, 0x02, NULL, NULL, NULL, 0, t);
+    if (err == 0) {
+        err = mp_read_unsigned_bin(b, t, WC_SM3_DIGEST_SIZE);
+    }
+    if (err == 0) {
+        err = mp_mod(b, order, b);
+    }
+    /* Zero has a negligible probability but isn't invertible. */
+    if ((err == 0) && mp_iszero(b)) {
+        err = mp_set(b, 1);
+    }
+
+    ForceZero(t, sizeof(t));
+    return err;
+}
+
+/* Make an ephemeral key on the SM2 curve from the next deterministic k.
+ *
+ * @param [in, out] det    Deterministic k state.
+ * @param [in]      order  Order of curve.
+ * @param [in]      k      Temporary MP integer to hold k.
+ * @param [out]     pub    ECC key to hold ephemeral key.
+ * @return  0 on success.
+ */
+static int ecc_sm2_det_k_make_key(EccSm2DetK* det, mp_int* order, mp_int* k,
+    ecc_key* pub)
+{
+    int err;
+    byte kb[SM2_KEY_SIZE];
+
+    err = ecc_sm2_det_k_gen(det, order, k);
+    if (err == 0) {
+        err = mp_to_unsigned_bin_len(k, kb, SM2_KEY_SIZE);
+    }
+    if (err == 0) {
+        err = wc_ecc_import_private_key_ex(kb, SM2_KEY_SIZE, NULL, 0, pub,
+            ECC_SM2P256V1);
+    }
+    if (err == 0) {
+        err = wc_ecc_make_pub(pub, NULL);
+    }
+
+    ForceZero(kb, sizeof(kb));
+    mp_forcezero(k);
+    return err;
+}
+#endif /* !WOLFSSL_SP_MATH */
+#else
+    #define ECC_SM2_KEY_DET_K(key)      0
+#endif /* WOLFSSL_SM2_DETERMINISTIC_K */
+
+/* Calculate the signature from the hash with a key on the SM2 curve.
+ *
+ * @param [in]  hash     Array of bytes holding hash value.
+ * @param [in]  hashSz   Size of hash in bytes.
+ * @param [in]  rng      Random number generator. May be NULL when detK set.
+ * @param [in]  detK     Whether to generate k deterministically.
+ * @param [in]  extra    Additional data for deterministic k. May be NULL.
+ * @param [in]  extraSz  Size of additional data in bytes.
+ * @param [in]  key      ECC private key.
+ * @param [out] r        'r' part of signature as an MP integer.
+ * @param [out] s        's' part of signature as an MP integer.
+ * @param [in]  ws       Workspace to allocate temporaries from. May be NULL.
+ * @return  MP_OKAY on success.
+ * @return  ECC_BAD_ARGE_E when hash, r, s or key is NULL.
+ * @return  ECC_BAD_ARGE_E when rng is NULL and not generating k
+ *          deterministically.
+ * @return  ECC_BAD_ARGE_E when key is not on SM2 curve.
+ */
+static int ecc_sm2_sign_hash(const byte* hash, word32 hashSz, WC_RNG* rng,
+    int detK, const byte* extra, word32 extraSz, ecc_key* key, mp_int* r,
+    mp_int* s, wc_Sm2Workspace* ws)
+{
+    int err = MP_OKAY;
+#if !defined(WOLFSSL_SP_MATH) || defined(WOLFSSL_SM2_DETERMINISTIC_K)
+    mp_int* x = NULL;
+    mp_int* order = NULL;
+#ifdef WOLFSSL_SMALL_STACK
+    mp_int* data = NULL;
+#else
+    mp_int data[4];
+#endif
 #endif
+#ifndef WOLFSSL_SP_MATH
+    mp_int* e = NULL;
+    mp_int* b = NULL;
+#ifdef WOLFSSL_SMALL_STACK
+    ecc_key* pub = NULL;
+#else
+    ecc_key pub[1];
+#endif
+#endif
+#if !defined(WOLFSSL_SP_MATH) || defined(WOLFSSL_SM2_DETERMINISTIC_K)
     int i;
 #endif
+#ifdef WOLFSSL_SM2_DETERMINISTIC_K
+#ifdef WOLFSSL_SMALL_STACK
+    EccSm2DetK* det = NULL;
+#else
+    EccSm2DetK det[1];
+#endif
+#endif
+
+    (void)ws;
 
     /* Validate parameters. */
     if ((hash == NULL) || (r == NULL) || (s == NULL) || (key == NULL) ||
-            (key->dp == NULL) || (rng == NULL)) {
+            (key->dp == NULL) || ((rng == NULL) && (!detK))) {
         err = BAD_FUNC_ARG;
     }
     /* SM2 signature must be with a key on the SM2 curve. */
@@ -477,9 +1344,16 @@ int wc_ecc_sm2_sign_hash_ex(const byte* hash, word32 hashSz, WC_RNG* rng,
         (key->idx != ECC_CUSTOM_IDX)) {
         err = BAD_FUNC_ARG;
     }
+#ifndef WOLFSSL_SM2_DETERMINISTIC_K
+    (void)extra;
+    (void)extraSz;
+    if ((err == MP_OKAY) && detK) {
+        err = NOT_COMPILED_IN;
+    }
+#endif
 
 #if defined(WOLFSSL_HAVE_SP_ECC) && defined(WOLFSSL_SP_SM2)
-    if ((err == MP_OKAY) && (key->dp->id == ECC_SM2P256V1)) {
+    if ((err == MP_OKAY) && (key->dp->id == ECC_SM2P256V1) && (!detK)) {
         /* Use optimized code in SP to perform signing. */
         SAVE_VECTOR_REGISTERS(return _svr_ret;);
         err = sp_ecc_sign_sm2_256(hash, hashSz, rng, key->k, r, s, NULL,
@@ -489,18 +1363,11 @@ int wc_ecc_sm2_sign_hash_ex(const byte* hash, word32 hashSz, WC_RNG* rng,
     }
 #endif
 
-#ifndef WOLFSSL_SP_MATH
+#if !defined(WOLFSSL_SP_MATH) || defined(WOLFSSL_SM2_DETERMINISTIC_K)
 #ifdef WOLFSSL_SMALL_STACK
-    if (err == MP_OKAY) {
-        /* Allocate ECC key. */
-        pub = (ecc_key*)XMALLOC(sizeof(ecc_key), key->heap, DYNAMIC_TYPE_ECC);
-        if (pub == NULL) {
-            err = MEMORY_E;
-        }
-    }
     if (err == MP_OKAY) {
         /* Allocate MP integers. */
-        data = (mp_int*)XMALLOC(sizeof(mp_int) * 4, key->heap,
+        data = (mp_int*)SM2_WS_ALLOC(ws, sizeof(mp_int) * 4, key->heap,
             DYNAMIC_TYPE_ECC);
         if (data == NULL) {
             err = MEMORY_E;
@@ -509,42 +1376,129 @@ int wc_ecc_sm2_sign_hash_ex(const byte* hash, word32 hashSz, WC_RNG* rng,
 #endif
     if (err == MP_OKAY) {
         x = data;
+        order = data + 3;
+    #ifndef WOLFSSL_SP_MATH
         e = data + 1;
         b = data + 2;
-        order = data + 3;
+    #endif
     }
 
     /* Initialize MP integers needed. */
     if (err == MP_OKAY) {
-        err = mp_init_multi(x, e, b, order, NULL, NULL);
+        err = mp_init_multi(data, data + 1, data + 2, data + 3, NULL, NULL);
     }
     if (err == MP_OKAY) {
-        /* Initialize ephemeral key. */
-        err = wc_ecc_init_ex(pub, key->heap, INVALID_DEVID);
-        if (err == MP_OKAY) {
-           /* Load the order into an MP integer for generating blinding value.
-            */
-            err = mp_read_radix(order, key->dp->order, MP_RADIX_HEX);
+        /* Load the order into an MP integer for generating blinding value
+         * and k. */
+        err = mp_read_radix(order, key->dp->order, MP_RADIX_HEX);
+    }
+#endif
+#ifdef WOLFSSL_SM2_DETERMINISTIC_K
+#ifdef WOLFSSL_SMALL_STACK
+    if ((err == MP_OKAY) && detK) {
+        /* Allocate deterministic k state. */
+        det = (EccSm2DetK*)SM2_WS_ALLOC(ws, sizeof(EccSm2DetK), key->heap,
+            DYNAMIC_TYPE_ECC);
+        if (det == NULL) {
+            err = MEMORY_E;
+        }
+    }
+#endif
+    if ((err == MP_OKAY) && detK) {
+        err = ecc_sm2_det_k_init(det, key, hash, hashSz, order, extra,
+            extraSz, x);
+    }
+#endif
+
+#if defined(WOLFSSL_HAVE_SP_ECC) && defined(WOLFSSL_SP_SM2) && \
+    defined(WOLFSSL_SM2_DETERMINISTIC_K)
+    if ((err == MP_OKAY) && (key->dp->id == ECC_SM2P256V1)) {
+        /* Try generating a signature a number of times. k is only not usable
+         * with a negligible probability - the next value is then generated
+         * deterministically as in RFC 6979, 3.2.h. */
+        for (i = 0; (err == MP_OKAY) && (i < ECC_SM2_MAX_SIG_GEN); i++) {
+            err = ecc_sm2_det_k_gen(det, order, x);
+        #ifdef WOLFSSL_SM2_DET_K_TEST
+            if ((err == MP_OKAY) && ecc_sm2_det_k_test_reject()) {
+                /* SP code treats a k of zero as not usable. */
+                mp_zero(x);
+            }
+        #endif
+            if (err == MP_OKAY) {
+                /* Use optimized code in SP to perform signing.
+                 * No RNG so MP_ZERO_E returned when k not usable. */
+                SAVE_VECTOR_REGISTERS(err = _svr_ret;);
+                if (err == MP_OKAY) {
+                    err = sp_ecc_sign_sm2_256(hash, hashSz, NULL, key->k, r,
+                        s, x, key->heap);
+                    RESTORE_VECTOR_REGISTERS();
+                }
+            }
+            /* Done if it worked. */
+            if (err == MP_OKAY) {
+                break;
+            }
+            /* Try again if k not usable. */
+            if (err == MP_ZERO_E) {
+                err = MP_OKAY;
+            }
         }
+        if ((err == MP_OKAY) && (i == ECC_SM2_MAX_SIG_GEN)) {
+            err = RNG_FAILURE_E;
+        }
+    }
+    else
+#endif
+#ifndef WOLFSSL_SP_MATH
+    {
+    #ifdef WOLFSSL_SMALL_STACK
         if (err == MP_OKAY) {
-            /* Convert hash to a number. */
-            err = mp_read_unsigned_bin(e, hash, hashSz);
+            /* Allocate ECC key. */
+            pub = (ecc_key*)SM2_WS_ALLOC(ws, sizeof(ecc_key), key->heap,
+                DYNAMIC_TYPE_ECC);
+            if (pub == NULL) {
+                err = MEMORY_E;
+            }
         }
+    #endif
         if (err == MP_OKAY) {
-            /* Reduce the hash value to that of the order once. */
-            err = mp_mod(e, order, e);
+            /* Initialize ephemeral key. */
+            err = wc_ecc_init_ex(pub, key->heap, INVALID_DEVID);
         }
         if (err == MP_OKAY) {
-            do {
-                /* Generate blinding value. */
-                err = wc_ecc_gen_k(rng, 32, b, order);
+            /* Convert hash to a number. */
+            err = mp_read_unsigned_bin(e, hash, hashSz);
+            if (err == MP_OKAY) {
+                /* Reduce the hash value to that of the order once. */
+                err = mp_mod(e, order, e);
             }
-            while (err == MP_ZERO_E);
-
             /* Try generating a signature a number of times. */
             for (i = 0; (err == MP_OKAY) && (i < ECC_SM2_MAX_SIG_GEN); i++) {
                 /* Make a new ephemeral key. */
-                err = wc_ecc_sm2_make_key(rng, pub, WC_ECC_FLAG_NONE);
+            #ifdef WOLFSSL_SM2_DETERMINISTIC_K
+                if (detK) {
+                    err = ecc_sm2_det_k_make_key(det, order, x, pub);
+                }
+                else
+            #endif
+                {
+                    err = wc_ecc_sm2_make_key(rng, pub, WC_ECC_FLAG_NONE);
+                }
+                if ((err == MP_OKAY) && (i == 0)) {
+                    do {
+                        /* Generate blinding value. */
+                    #ifdef WOLFSSL_SM2_DETERMINISTIC_K
+                        if (detK) {
+                            err = ecc_sm2_det_k_blind(det, order, b);
+                        }
+                        else
+                    #endif
+                        {
+                            err = wc_ecc_gen_k(rng, 32, b, order);
+                        }
+                    }
+                    while (err == MP_ZERO_E);
+                }
                 if (err == MP_OKAY) {
                     /* Copy the private key into temporary. */
                     err = mp_copy(wc_ecc_key_get_priv(key), x);
@@ -554,6 +1508,12 @@ int wc_ecc_sm2_sign_hash_ex(const byte* hash, word32 hashSz, WC_RNG* rng,
                     err = _ecc_sm2_calc_r_s(x, pub->pubkey.x,
                         wc_ecc_key_get_priv(pub), e, order, b, r, s);
                 }
+            #if defined(WOLFSSL_SM2_DETERMINISTIC_K) && \
+                defined(WOLFSSL_SM2_DET_K_TEST)
+                if ((err == MP_OKAY) && detK && ecc_sm2_det_k_test_reject()) {
+                    err = MP_ZERO_E;
+                }
+            #endif
                 /* Done if it worked. */
                 if (err == MP_OKAY) {
                     break;
@@ -563,26 +1523,56 @@ int wc_ecc_sm2_sign_hash_ex(const byte* hash, word32 hashSz, WC_RNG* rng,
                     err = MP_OKAY;
                 }
             }
+            if ((err == MP_OKAY) && (i == ECC_SM2_MAX_SIG_GEN)) {
+                err = RNG_FAILURE_E;
+            }
 
             /* Dispose of emphemeral key. */
             wc_ecc_free(pub);
         }
+    }
+#else
+    {
+        (void)hashSz;
 
-        /* Dispose of temproraries - x and b are sensitive data. */
-        mp_forcezero(x);
-        mp_forcezero(b);
-        mp_free(e);
-        mp_free(order);
+        if (err == MP_OKAY) {
+            err = NOT_COMPILED_IN;
+        }
     }
+#endif
 
+#ifdef WOLFSSL_SM2_DETERMINISTIC_K
+    if (detK
+    #ifdef WOLFSSL_SMALL_STACK
+        && (det != NULL)
+    #endif
+        ) {
+        ecc_sm2_det_k_free(det);
+    }
+#endif
+#if !defined(WOLFSSL_SP_MATH) || defined(WOLFSSL_SM2_DETERMINISTIC_K)
 #ifdef WOLFSSL_SMALL_STACK
-    XFREE(pub, key->heap, DYNAMIC_TYPE_ECC);
-    XFREE(data, key->heap, DYNAMIC_TYPE_ECC);
+    if (data != NULL)
+#endif
+    {
+        /* Dispose of temproraries - x and b are sensitive data. */
+        mp_forcezero(data);
+        mp_forcezero(data + 2);
+        mp_free(data + 1);
+        mp_free(data + 3);
+    }
 #endif
-#else
-    (void)hashSz;
 
-    err = NOT_COMPILED_IN;
+#ifdef WOLFSSL_SMALL_STACK
+#ifndef WOLFSSL_SP_MATH
+    SM2_WS_FREE(ws, pub, key->heap, DYNAMIC_TYPE_ECC);
+#endif
+#ifdef WOLFSSL_SM2_DETERMINISTIC_K
+    SM2_WS_FREE(ws, det, key->heap, DYNAMIC_TYPE_ECC);
+#endif
+#if !defined(WOLFSSL_SP_MATH) || defined(WOLFSSL_SM2_DETERMINISTIC_K)
+    SM2_WS_FREE(ws, data, key->heap, DYNAMIC_TYPE_ECC);
+#endif
 #endif
 
     return err;
@@ -591,20 +1581,84 @@ int wc_ecc_sm2_sign_hash_ex(const byte* hash, word32 hashSz, WC_RNG* rng,
 /* Calculate the signature from the hash with a key on the SM2 curve.
  *
  * Use wc_ecc_sm2_create_digest to calculate the digest.
+ * k is generated deterministically, as in RFC 6979 with HMAC-SM3, when set
+ * against the key with wc_ecc_set_deterministic().
  *
  * @param [in]  hash    Array of bytes holding hash value.
  * @param [in]  hashSz  Size of hash in bytes.
- * @param [in]  rng     Random number generator.
+ * @param [in]  rng     Random number generator. May be NULL when k is
+ *                      generated deterministically.
+ * @param [in]  key     ECC private key.
+ * @param [out] r       'r' part of signature as an MP integer.
+ * @param [out] s       's' part of signature as an MP integer.
+ * @return  MP_OKAY on success.
+ * @return  ECC_BAD_ARGE_E when hash, r, s, key or rng is NULL.
+ * @return  ECC_BAD_ARGE_E when key is not on SM2 curve.
+ */
+int wc_ecc_sm2_sign_hash_ex(const byte* hash, word32 hashSz, WC_RNG* rng,
+    ecc_key* key, mp_int* r, mp_int* s)
+{
+    int detK = 0;
+
+    if (key != NULL) {
+        detK = ECC_SM2_KEY_DET_K(key);
+    }
+
+    return ecc_sm2_sign_hash(hash, hashSz, rng, detK, NULL, 0, key, r, s,
+        NULL);
+}
+
+#ifdef WOLFSSL_SM2_DETERMINISTIC_K
+/* Calculate the signature from the hash with a key on the SM2 curve and k
+ * generated deterministically.
+ *
+ * k is generated as in RFC 6979 with HMAC-SM3. No random number generator is
+ * needed and signing the same hash with the same key gives the same
+ * signature. Additional data, e.g. random data, is appended as in RFC 6979,
+ * 3.6.
+ *
+ * @param [in]  hash     Array of bytes holding hash value.
+ * @param [in]  hashSz   Size of hash in bytes.
+ * @param [in]  extra    Additional data. May be NULL.
+ * @param [in]  extraSz  Size of additional data in bytes.
+ * @param [in]  key      ECC private key.
+ * @param [out] r        'r' part of signature as an MP integer.
+ * @param [out] s        's' part of signature as an MP integer.
+ * @return  MP_OKAY on success.
+ * @return  ECC_BAD_ARGE_E when hash, r, s or key is NULL.
+ * @return  ECC_BAD_ARGE_E when extra is NULL and extraSz is not 0.
+ * @return  ECC_BAD_ARGE_E when key is not on SM2 curve.
+ */
+int wc_ecc_sm2_sign_hash_det_ex(const byte* hash, word32 hashSz,
+    const byte* extra, word32 extraSz, ecc_key* key, mp_int* r, mp_int* s)
+{
+    if ((extra == NULL) && (extraSz > 0)) {
+        return BAD_FUNC_ARG;
+    }
+
+    return ecc_sm2_sign_hash(hash, hashSz, NULL, 1, extra, extraSz, key, r,
+        s, NULL);
+}
+#endif /* WOLFSSL_SM2_DETERMINISTIC_K */
+
+/* Calculate the DER encoded signature from the hash with a key on the SM2
+ * curve.
+ *
+ * @param [in]  hash    Array of bytes holding hash value.
+ * @param [in]  hashSz  Size of hash in bytes.
+ * @param [in]  rng     Random number generator. May be NULL when k is
+ *                      generated deterministically.
  * @param [in]  key     ECC private key.
  * @param [out] sig     DER encoded DSA signature.
  * @param [out] sigSz   On in, size of signature buffer in bytes.
  *                      On out, length of signature in bytes.
+ * @param [in]  ws      Workspace to allocate temporaries from. May be NULL.
  * @return  MP_OKAY on success.
  * @return  ECC_BAD_ARGE_E when hash, r, s, key or rng is NULL.
  * @return  ECC_BAD_ARGE_E when key is not on SM2 curve.
  */
-int wc_ecc_sm2_sign_hash(const byte* hash, word32 hashSz, byte* sig,
-    word32 *sigSz, WC_RNG* rng, ecc_key* key)
+static int ecc_sm2_sign_hash_der(const byte* hash, word32 hashSz, byte* sig,
+    word32 *sigSz, WC_RNG* rng, ecc_key* key, wc_Sm2Workspace* ws)
 {
     int err = MP_OKAY;
 #if !defined(WOLFSSL_ASYNC_CRYPT) || !defined(WC_ASYNC_ENABLE_ECC)
@@ -615,9 +1669,15 @@ int wc_ecc_sm2_sign_hash(const byte* hash, word32 hashSz, byte* sig,
 #endif
 #endif
 
+    (void)ws;
+
     /* Validate parameters. */
     if ((hash == NULL) || (sig == NULL) || (sigSz == NULL) || (key == NULL) ||
-            (key->dp == NULL) || (rng == NULL)) {
+            (key->dp == NULL)) {
+        err = BAD_FUNC_ARG;
+    }
+    /* Random number generator needed unless k generated deterministically. */
+    if ((err == MP_OKAY) && (rng == NULL) && (!ECC_SM2_KEY_DET_K(key))) {
         err = BAD_FUNC_ARG;
     }
     /* SM2 signature must be with a key on the SM2 curve. */
@@ -629,12 +1689,14 @@ int wc_ecc_sm2_sign_hash(const byte* hash, word32 hashSz, byte* sig,
 #ifdef WOLFSSL_SMALL_STACK
     if (err == MP_OKAY) {
         /* Allocate MP integers. */
-        r = (mp_int*)XMALLOC(sizeof(mp_int), key->heap, DYNAMIC_TYPE_ECC);
+        r = (mp_int*)SM2_WS_ALLOC(ws, sizeof(mp_int), key->heap,
+            DYNAMIC_TYPE_ECC);
         if (r == NULL)
             err = MEMORY_E;
     }
     if (err == MP_OKAY) {
-        s = (mp_int*)XMALLOC(sizeof(mp_int), key->heap, DYNAMIC_TYPE_ECC);
+        s = (mp_int*)SM2_WS_ALLOC(ws, sizeof(mp_int), key->heap,
+            DYNAMIC_TYPE_ECC);
         if (s == NULL) {
             err = MEMORY_E;
         }
@@ -655,7 +1717,8 @@ int wc_ecc_sm2_sign_hash(const byte* hash, word32 hashSz, byte* sig,
         err = mp_init_multi(r, s, NULL, NULL, NULL, NULL);
     /* Generate signature into numbers. */
     if (err == MP_OKAY)
-        err = wc_ecc_sm2_sign_hash_ex(hash, hashSz, rng, key, r, s);
+        err = ecc_sm2_sign_hash(hash, hashSz, rng, ECC_SM2_KEY_DET_K(key),
+            NULL, 0, key, r, s, ws);
 
     /* Encode r and s in DER DSA signature format. */
     if (err == MP_OKAY)
@@ -667,20 +1730,42 @@ int wc_ecc_sm2_sign_hash(const byte* hash, word32 hashSz, byte* sig,
 
 #ifdef WOLFSSL_SMALL_STACK
     /* Free allocated data. */
-    XFREE(s, key->heap, DYNAMIC_TYPE_ECC);
-    XFREE(r, key->heap, DYNAMIC_TYPE_ECC);
+    SM2_WS_FREE(ws, s, key->heap, DYNAMIC_TYPE_ECC);
+    SM2_WS_FREE(ws, r, key->heap, DYNAMIC_TYPE_ECC);
 #endif
 
     return err;
 }
-#endif
 
-#ifdef HAVE_ECC_VERIFY
-#ifndef WOLFSSL_SP_MATH
-/* Scalar multiply two scalars against respective points and add result.
+/* Calculate the signature from the hash with a key on the SM2 curve.
  *
- * @param [in]  mG       First point to multiply.
- * @param [in]  u1       First scalar.
+ * Use wc_ecc_sm2_create_digest to calculate the digest.
+ *
+ * @param [in]  hash    Array of bytes holding hash value.
+ * @param [in]  hashSz  Size of hash in bytes.
+ * @param [in]  rng     Random number generator. May be NULL when k is
+ *                      generated deterministically.
+ * @param [in]  key     ECC private key.
+ * @param [out] sig     DER encoded DSA signature.
+ * @param [out] sigSz   On in, size of signature buffer in bytes.
+ *                      On out, length of signature in bytes.
+ * @return  MP_OKAY on success.
+ * @return  ECC_BAD_ARGE_E when hash, r, s, key or rng is NULL.
+ * @return  ECC_BAD_ARGE_E when key is not on SM2 curve.
+ */
+int wc_ecc_sm2_sign_hash(const byte* hash, word32 hashSz, byte* sig,
+    word32 *sigSz, WC_RNG* rng, ecc_key* key)
+{
+    return ecc_sm2_sign_hash_der(hash, hashSz, sig, sigSz, rng, key, NULL);
+}
+#endif
+
+#ifdef HAVE_ECC_VERIFY
+#ifndef WOLFSSL_SP_MATH
+/* Scalar multiply two scalars against respective points and add result.
+ *
+ * @param [in]  mG       First point to multiply.
+ * @param [in]  u1       First scalar.
  * @param [in]  mQ       Second point to multiply.
  * @param [in]  u2       Second scalar.
  * @param [out] mR       Point to store result in.
@@ -761,6 +1846,7 @@ static int ecc_sm2_mul2add(ecc_point* mG, mp_int* u1, ecc_point* mQ, mp_int* u2,
  * @param [in]  hashSz  Size of hash in bytes.
  * @param [out] res     1 on successful verify and 0 on failure.
  * @param [in]  key     Public key on SM2 curve.
+ * @param [in]  ws      Workspace to allocate temporaries from. May be NULL.
  * @return  0 on success (note this is even when successfully finding verify is
  * incorrect)
  * @return  BAD_FUNC_ARG when key, res, r, s or hash is NULL.
@@ -768,8 +1854,8 @@ static int ecc_sm2_mul2add(ecc_point* mG, mp_int* u1, ecc_point* mQ, mp_int* u2,
  * @return  MEMORY_E on dynamic memory allocation failure.
  * @return  MP_MEM when dynamic memory allocation fails.
  */
-int wc_ecc_sm2_verify_hash_ex(mp_int *r, mp_int *s, const byte *hash,
-    word32 hashSz, int *res, ecc_key *key)
+static int ecc_sm2_verify_hash_ex(mp_int *r, mp_int *s, const byte *hash,
+    word32 hashSz, int *res, ecc_key *key, wc_Sm2Workspace* ws)
 {
     int err = MP_OKAY;
 #ifndef WOLFSSL_SP_MATH
@@ -787,6 +1873,8 @@ int wc_ecc_sm2_verify_hash_ex(mp_int *r, mp_int *s, const byte *hash,
 #endif
 #endif
 
+    (void)ws;
+
     /* Validate parameters. */
     if ((key == NULL) || (key->dp == NULL) || (res == NULL) || (r == NULL) ||
             (s == NULL) || (hash == NULL)) {
@@ -818,7 +1906,7 @@ int wc_ecc_sm2_verify_hash_ex(mp_int *r, mp_int *s, const byte *hash,
 #ifdef WOLFSSL_SMALL_STACK
     if (err == MP_OKAY) {
         /* Allocate temporary MP integer. */
-        data = (mp_int*)XMALLOC(sizeof(mp_int) * 5, key->heap,
+        data = (mp_int*)SM2_WS_ALLOC(ws, sizeof(mp_int) * 5, key->heap,
             DYNAMIC_TYPE_ECC);
         if (data == NULL) {
             err = MEMORY_E;
@@ -954,7 +2042,7 @@ int wc_ecc_sm2_verify_hash_ex(mp_int *r, mp_int *s, const byte *hash,
 
 #ifdef WOLFSSL_SMALL_STACK
     /* Free allocated data. */
-    XFREE(data, key->heap, DYNAMIC_TYPE_ECC);
+    SM2_WS_FREE(ws, data, key->heap, DYNAMIC_TYPE_ECC);
 #endif
 #else
     (void)hashSz;
@@ -966,6 +2054,31 @@ int wc_ecc_sm2_verify_hash_ex(mp_int *r, mp_int *s, const byte *hash,
 }
 
 
+/* Verify digest of hash(ZA || M) using key on SM2 curve and R and S.
+ *
+ * res gets set to 1 on successful verify and 0 on failure
+ *
+ * Use wc_ecc_sm2_create_digest to calculate the digest.
+ *
+ * @param [in]  r       MP integer holding r part of signature.
+ * @param [in]  s       MP integer holding s part of signature.
+ * @param [in]  hash    Array of bytes holding hash value.
+ * @param [in]  hashSz  Size of hash in bytes.
+ * @param [out] res     1 on successful verify and 0 on failure.
+ * @param [in]  key     Public key on SM2 curve.
+ * @return  0 on success (note this is even when successfully finding verify is
+ * incorrect)
+ * @return  BAD_FUNC_ARG when key, res, r, s or hash is NULL.
+ * @return  MP_VAL when r + s = 0.
+ * @return  MEMORY_E on dynamic memory allocation failure.
+ * @return  MP_MEM when dynamic memory allocation fails.
+ */
+int wc_ecc_sm2_verify_hash_ex(mp_int *r, mp_int *s, const byte *hash,
+    word32 hashSz, int *res, ecc_key *key)
+{
+    return ecc_sm2_verify_hash_ex(r, s, hash, hashSz, res, key, NULL);
+}
+
 #ifndef NO_ASN
 /* Verify digest of hash(ZA || M) using key on SM2 curve and encoded signature.
  *
@@ -979,6 +2092,7 @@ int wc_ecc_sm2_verify_hash_ex(mp_int *r, mp_int *s, const byte *hash,
  * @param [in]  hashSz  Size of hash in bytes.
  * @param [out] res     1 on successful verify and 0 on failure.
  * @param [in]  key     Public key on SM2 curve.
+ * @param [in]  ws      Workspace to allocate temporaries from. May be NULL.
  * @return  0 on success (note this is even when successfully finding verify is
  * incorrect)
  * @return  BAD_FUNC_ARG when key, res, sig or hash is NULL.
@@ -986,8 +2100,9 @@ int wc_ecc_sm2_verify_hash_ex(mp_int *r, mp_int *s, const byte *hash,
  * @return  MEMORY_E on dynamic memory allocation failure.
  * @return  MP_MEM when dynamic memory allocation fails.
  */
-int wc_ecc_sm2_verify_hash(const byte* sig, word32 sigSz, const byte* hash,
-    word32 hashSz, int* res, ecc_key* key)
+static int ecc_sm2_verify_hash_der(const byte* sig, word32 sigSz,
+    const byte* hash, word32 hashSz, int* res, ecc_key* key,
+    wc_Sm2Workspace* ws)
 {
     int err = 0;
 #ifdef WOLFSSL_SMALL_STACK
@@ -998,6 +2113,8 @@ int wc_ecc_sm2_verify_hash(const byte* sig, word32 sigSz, const byte* hash,
     mp_int s[1];
 #endif
 
+    (void)ws;
+
     /* Validate parameters. */
     if ((sig == NULL) || (hash == NULL) || (res == NULL) || (key == NULL) ||
             (key->dp == NULL)) {
@@ -1012,7 +2129,8 @@ int wc_ecc_sm2_verify_hash(const byte* sig, word32 sigSz, const byte* hash,
 #ifdef WOLFSSL_SMALL_STACK
     if (err == 0) {
         /* Allocate MP integers. */
-        r = (mp_int*)XMALLOC(sizeof(mp_int), key->heap, DYNAMIC_TYPE_ECC);
+        r = (mp_int*)SM2_WS_ALLOC(ws, sizeof(mp_int), key->heap,
+            DYNAMIC_TYPE_ECC);
         if (r == NULL) {
             err = MEMORY_E;
         }
@@ -1021,7 +2139,8 @@ int wc_ecc_sm2_verify_hash(const byte* sig, word32 sigSz, const byte* hash,
         }
     }
     if (err == MP_OKAY) {
-        s = (mp_int*)XMALLOC(sizeof(mp_int), key->heap, DYNAMIC_TYPE_ECC);
+        s = (mp_int*)SM2_WS_ALLOC(ws, sizeof(mp_int), key->heap,
+            DYNAMIC_TYPE_ECC);
         if (s == NULL) {
             err = MEMORY_E;
         }
@@ -1040,7 +2159,7 @@ int wc_ecc_sm2_verify_hash(const byte* sig, word32 sigSz, const byte* hash,
     }
     if (err == 0) {
         /* Verify the signature with hash, key, R and S. */
-        err = wc_ecc_sm2_verify_hash_ex(r, s, hash, hashSz, res, key);
+        err = ecc_sm2_verify_hash_ex(r, s, hash, hashSz, res, key, ws);
     }
 
     /* Dispose of allocated data. */
@@ -1059,13 +2178,1444 @@ int wc_ecc_sm2_verify_hash(const byte* sig, word32 sigSz, const byte* hash,
 
 #ifdef WOLFSSL_SMALL_STACK
     /* Free allocated data. */
-    XFREE(s, key->heap, DYNAMIC_TYPE_ECC);
-    XFREE(r, key->heap, DYNAMIC_TYPE_ECC);
+    SM2_WS_FREE(ws, s, key->heap, DYNAMIC_TYPE_ECC);
+    SM2_WS_FREE(ws, r, key->heap, DYNAMIC_TYPE_ECC);
 #endif
 
     return err;
 }
+
+/* Verify digest of hash(ZA || M) using key on SM2 curve and encoded signature.
+ *
+ * res gets set to 1 on successful verify and 0 on failure
+ *
+ * Use wc_ecc_sm2_create_digest to calculate the digest.
+ *
+ * @param [in]  sig     DER encoded DSA signature.
+ * @param [in]  sigSz   Length of signature in bytes.
+ * @param [in]  hash    Array of bytes holding hash value.
+ * @param [in]  hashSz  Size of hash in bytes.
+ * @param [out] res     1 on successful verify and 0 on failure.
+ * @param [in]  key     Public key on SM2 curve.
+ * @return  0 on success (note this is even when successfully finding verify is
+ * incorrect)
+ * @return  BAD_FUNC_ARG when key, res, sig or hash is NULL.
+ * @return  MP_VAL when r + s = 0.
+ * @return  MEMORY_E on dynamic memory allocation failure.
+ * @return  MP_MEM when dynamic memory allocation fails.
+ */
+int wc_ecc_sm2_verify_hash(const byte* sig, word32 sigSz, const byte* hash,
+    word32 hashSz, int* res, ecc_key* key)
+{
+    return ecc_sm2_verify_hash_der(sig, sigSz, hash, hashSz, res, key, NULL);
+}
 #endif /* NO_ASN */
 #endif /* HAVE_ECC_VERIFY */
 
+#ifdef WOLFSSL_SM2_ENCRYPT
+/* Maximum number of ephemeral keys to try when encrypting. */
+#define ECC_SM2_MAX_ENC_GEN     64
+
+/* Calculate the point k.P and get the ordinates as big-endian bytes.
+ *
+ * @param [in]  key  ECC key on SM2 curve. Used for curve and heap.
+ * @param [in]  k    Scalar to multiply by.
+ * @param [in]  p    Point to multiply.
+ * @param [out] xy   Buffer to hold x ordinate followed by y ordinate.
+ * @return  0 on success.
+ * @return  MEMORY_E on dynamic memory allocation failure.
+ * @return  ECC_INF_E when the result is the point at infinity.
+ */
+static int ecc_sm2_point_mul(ecc_key* key, mp_int* k, ecc_point* p, byte* xy)
+{
+    int err = 0;
+    ecc_point* r = NULL;
+#ifndef WOLFSSL_SP_MATH
+#ifdef WOLFSSL_SMALL_STACK
+    mp_int* data = NULL;
+#else
+    mp_int data[2];
+#endif
+    mp_int* a = NULL;
+    mp_int* prime = NULL;
+#endif
+
+    r = wc_ecc_new_point_h(key->heap);
+    if (r == NULL) {
+        err = MEMORY_E;
+    }
+
+#if defined(WOLFSSL_HAVE_SP_ECC) && defined(WOLFSSL_SP_SM2)
+    if ((err == 0) && (key->dp->id == ECC_SM2P256V1)) {
+        /* Use optimized code in SP to perform multiplication. */
+        SAVE_VECTOR_REGISTERS(err = _svr_ret;);
+        if (err == 0) {
+            err = sp_ecc_mulmod_sm2_256(k, p, r, 1, key->heap);
+            RESTORE_VECTOR_REGISTERS();
+        }
+    }
+    else
+#endif
+    if (err == 0) {
+#ifndef WOLFSSL_SP_MATH
+    #ifdef WOLFSSL_SMALL_STACK
+        data = (mp_int*)XMALLOC(sizeof(mp_int) * 2, key->heap,
+            DYNAMIC_TYPE_ECC);
+        if (data == NULL) {
+            err = MEMORY_E;
+        }
+        if (err == 0)
+    #endif
+        {
+            a = data;
+            prime = data + 1;
+            err = mp_init_multi(a, prime, NULL, NULL, NULL, NULL);
+        }
+        if (err == 0) {
+            err = mp_read_radix(a, key->dp->Af, MP_RADIX_HEX);
+        }
+        if (err == 0) {
+            err = mp_read_radix(prime, key->dp->prime, MP_RADIX_HEX);
+        }
+        if (err == 0) {
+            err = wc_ecc_mulmod_ex(k, p, r, a, prime, 1, key->heap);
+        }
+        if (a != NULL) {
+            mp_free(a);
+            mp_free(prime);
+        }
+    #ifdef WOLFSSL_SMALL_STACK
+        XFREE(data, key->heap, DYNAMIC_TYPE_ECC);
+    #endif
+#else
+        err = NOT_COMPILED_IN;
+#endif
+    }
+
+    /* Point at infinity can't be used. */
+    if ((err == 0) && mp_iszero(r->x) && mp_iszero(r->y)) {
+        err = ECC_INF_E;
+    }
+    if (err == 0) {
+        err = mp_to_unsigned_bin_len(r->x, xy, SM2_KEY_SIZE);
+    }
+    if (err == 0) {
+        err = mp_to_unsigned_bin_len(r->y, xy + SM2_KEY_SIZE, SM2_KEY_SIZE);
+    }
+
+    if (r != NULL) {
+        /* Shared point is sensitive. */
+        mp_forcezero(r->x);
+        mp_forcezero(r->y);
+        wc_ecc_del_point_h(r, key->heap);
+    }
+    return err;
+}
+
+/* Set up the KDF and C3 hashes from the shared point.
+ *
+ * @param [out] ctx   SM2 encryption context.
+ * @param [in]  xy    x2 || y2 of shared point.
+ * @param [in]  heap  Dynamic memory hint.
+ * @return  0 on success.
+ */
+static int ecc_sm2_enc_setup(wc_Sm2EncCtx* ctx, const byte* xy, void* heap)
+{
+    int err;
+
+    /* KDF input Z is x2 || y2 - one SM3 block. */
+    err = wc_InitSm3(&ctx->kdf, heap, INVALID_DEVID);
+    if (err == 0) {
+        err = wc_Sm3Update(&ctx->kdf, xy, 2 * SM2_KEY_SIZE);
+    }
+    /* C3 = SM3(x2 || M || y2) */
+    if (err == 0) {
+        err = wc_InitSm3(&ctx->c3, heap, INVALID_DEVID);
+    }
+    if (err == 0) {
+        err = wc_Sm3Update(&ctx->c3, xy, SM2_KEY_SIZE);
+    }
+    if (err == 0) {
+        XMEMCPY(ctx->y2, xy + SM2_KEY_SIZE, SM2_KEY_SIZE);
+        /* Key stream generated on first use. */
+        ctx->ksIdx = (word32)sizeof(ctx->ks);
+        ctx->ct = 1;
+        ctx->ksOr = 0;
+    }
+
+    return err;
+}
+
+/* XOR data with the key stream from the KDF.
+ *
+ * @param [in, out] ctx  SM2 encryption context.
+ * @param [in]      in   Data to XOR.
+ * @param [in]      sz   Number of bytes of data.
+ * @param [out]     out  Buffer to hold result. May be same as in.
+ * @return  0 on success.
+ * @return  BUFFER_E when the maximum length of key stream is exceeded.
+ */
+static int ecc_sm2_enc_xor(wc_Sm2EncCtx* ctx, const byte* in, word32 sz,
+    byte* out)
+{
+    int err = 0;
+    word32 i;
+    word32 n;
+
+    while ((err == 0) && (sz > 0)) {
+        if (ctx->ksIdx == (word32)sizeof(ctx->ks)) {
+            /* Counter must not wrap. */
+            if (ctx->ct > (word32)0 - WC_SM2_KDF_BLOCKS) {
+                err = BUFFER_E;
+                break;
+            }
+            /* Generate a number of blocks of key stream at a time. */
+            err = wc_Sm3KdfBlocks(&ctx->kdf, ctx->ct, ctx->ks,
+                WC_SM2_KDF_BLOCKS);
+            ctx->ct += WC_SM2_KDF_BLOCKS;
+            ctx->ksIdx = 0;
+        }
+        if (err == 0) {
+            n = (word32)sizeof(ctx->ks) - ctx->ksIdx;
+            if (n > sz) {
+                n = sz;
+            }
+            for (i = 0; i < n; i++) {
+                ctx->ksOr |= ctx->ks[ctx->ksIdx + i];
+                out[i] = in[i] ^ ctx->ks[ctx->ksIdx + i];
+            }
+            ctx->ksIdx += n;
+            in += n;
+            out += n;
+            sz -= n;
+        }
+    }
+
+    return err;
+}
+
+/* Start SM2 encryption with a public key.
+ *
+ * Encrypted data is: C1 || C3 || C2.
+ * C2 is output by wc_ecc_sm2_encrypt_update and C3 by wc_ecc_sm2_encrypt_final.
+ *
+ * @param [out] ctx  SM2 encryption context.
+ * @param [in]  key  ECC public key on SM2 curve.
+ * @param [in]  rng  Random number generator.
+ * @param [out] c1   Buffer to hold C1. WC_SM2_C1_SIZE bytes in size.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when ctx, key, rng or c1 is NULL.
+ * @return  BAD_FUNC_ARG when key is not on SM2 curve.
+ * @return  MEMORY_E on dynamic memory allocation failure.
+ */
+int wc_ecc_sm2_encrypt_init(wc_Sm2EncCtx* ctx, ecc_key* key, WC_RNG* rng,
+    byte* c1)
+{
+    int err = 0;
+#ifdef WOLFSSL_SMALL_STACK
+    ecc_key* eph = NULL;
+#else
+    ecc_key eph[1];
+#endif
+    byte xy[2 * SM2_KEY_SIZE];
+    word32 c1Sz = WC_SM2_C1_SIZE;
+    int init = 0;
+
+    /* Validate parameters. */
+    if ((ctx == NULL) || (key == NULL) || (rng == NULL) || (c1 == NULL) ||
+            (key->dp == NULL)) {
+        err = BAD_FUNC_ARG;
+    }
+    /* SM2 encryption must be with a key on the SM2 curve. */
+    if ((err == 0) && (key->dp->id != ECC_SM2P256V1) &&
+        (key->idx != ECC_CUSTOM_IDX)) {
+        err = BAD_FUNC_ARG;
+    }
+
+#ifdef WOLFSSL_SMALL_STACK
+    if (err == 0) {
+        eph = (ecc_key*)XMALLOC(sizeof(ecc_key), key->heap, DYNAMIC_TYPE_ECC);
+        if (eph == NULL) {
+            err = MEMORY_E;
+        }
+    }
+#endif
+    if (err == 0) {
+        err = wc_ecc_init_ex(eph, key->heap, INVALID_DEVID);
+        init = (err == 0);
+    }
+    /* C1 = k.G */
+    if (err == 0) {
+        err = wc_ecc_sm2_make_key(rng, eph, WC_ECC_FLAG_NONE);
+    }
+    if (err == 0) {
+        err = wc_ecc_export_x963(eph, c1, &c1Sz);
+    }
+    /* (x2, y2) = k.P */
+    if (err == 0) {
+        err = ecc_sm2_point_mul(key, wc_ecc_key_get_priv(eph), &key->pubkey,
+            xy);
+    }
+    if (err == 0) {
+        err = ecc_sm2_enc_setup(ctx, xy, key->heap);
+    }
+
+    if (init) {
+        /* Dispose of ephemeral key - private key is sensitive. */
+        wc_ecc_free(eph);
+    }
+#ifdef WOLFSSL_SMALL_STACK
+    XFREE(eph, key->heap, DYNAMIC_TYPE_ECC);
+#endif
+    ForceZero(xy, sizeof(xy));
+
+    return err;
+}
+
+/* Encrypt more message data.
+ *
+ * @param [in, out] ctx  SM2 encryption context.
+ * @param [in]      msg  Message data.
+ * @param [in]      sz   Number of bytes of message data.
+ * @param [out]     out  Buffer to hold next part of C2. May be same as msg.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when ctx is NULL, or msg or out is NULL and sz is
+ *          not 0.
+ */
+int wc_ecc_sm2_encrypt_update(wc_Sm2EncCtx* ctx, const byte* msg, word32 sz,
+    byte* out)
+{
+    int err = 0;
+
+    /* Validate parameters. */
+    if ((ctx == NULL) || ((sz > 0) && ((msg == NULL) || (out == NULL)))) {
+        err = BAD_FUNC_ARG;
+    }
+
+    /* Hash message before it is overwritten. */
+    if (err == 0) {
+        err = wc_Sm3Update(&ctx->c3, msg, sz);
+    }
+    if (err == 0) {
+        err = ecc_sm2_enc_xor(ctx, msg, sz, out);
+    }
+
+    return err;
+}
+
+/* Finish SM2 encryption and get C3.
+ *
+ * @param [in, out] ctx  SM2 encryption context.
+ * @param [out]     c3   Buffer to hold C3. WC_SM2_C3_SIZE bytes in size.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when ctx or c3 is NULL.
+ * @return  BAD_STATE_E when key stream used is all zeros or no message data.
+ *          Start again with a new ephemeral key.
+ */
+int wc_ecc_sm2_encrypt_final(wc_Sm2EncCtx* ctx, byte* c3)
+{
+    int err = 0;
+
+    /* Validate parameters. */
+    if ((ctx == NULL) || (c3 == NULL)) {
+        err = BAD_FUNC_ARG;
+    }
+    /* Key stream of all zeros is not allowed. */
+    if ((err == 0) && (ctx->ksOr == 0)) {
+        err = BAD_STATE_E;
+    }
+
+    if (err == 0) {
+        err = wc_Sm3Update(&ctx->c3, ctx->y2, SM2_KEY_SIZE);
+    }
+    if (err == 0) {
+        err = wc_Sm3Final(&ctx->c3, c3);
+    }
+
+    return err;
+}
+
+/* Start SM2 decryption with a private key.
+ *
+ * Encrypted data is: C1 || C3 || C2.
+ * C2 is decrypted with wc_ecc_sm2_decrypt_update and C3 checked with
+ * wc_ecc_sm2_decrypt_final. Decrypted data must not be used until C3 checked.
+ *
+ * @param [out] ctx   SM2 encryption context.
+ * @param [in]  key   ECC private key on SM2 curve.
+ * @param [in]  c1    C1 - encoded point.
+ * @param [in]  c1Sz  Size of C1 in bytes.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when ctx, key or c1 is NULL.
+ * @return  BAD_FUNC_ARG when key is not on SM2 curve.
+ * @return  MEMORY_E on dynamic memory allocation failure.
+ * @return  Other negative value when C1 is not a valid point on the curve.
+ */
+int wc_ecc_sm2_decrypt_init(wc_Sm2EncCtx* ctx, ecc_key* key, const byte* c1,
+    word32 c1Sz)
+{
+    int err = 0;
+    ecc_point* p = NULL;
+    byte xy[2 * SM2_KEY_SIZE];
+
+    /* Validate parameters. */
+    if ((ctx == NULL) || (key == NULL) || (c1 == NULL) || (key->dp == NULL)) {
+        err = BAD_FUNC_ARG;
+    }
+    /* SM2 decryption must be with a key on the SM2 curve. */
+    if ((err == 0) && (key->dp->id != ECC_SM2P256V1) &&
+        (key->idx != ECC_CUSTOM_IDX)) {
+        err = BAD_FUNC_ARG;
+    }
+
+    if (err == 0) {
+        p = wc_ecc_new_point_h(key->heap);
+        if (p == NULL) {
+            err = MEMORY_E;
+        }
+    }
+    /* C1 must be a point on the curve. */
+    if (err == 0) {
+        err = wc_ecc_import_point_der(c1, c1Sz, key->idx, p);
+    }
+    if (err == 0) {
+        err = wc_ecc_point_is_on_curve(p, key->idx);
+    }
+    /* (x2, y2) = d.C1 */
+    if (err == 0) {
+        err = ecc_sm2_point_mul(key, wc_ecc_key_get_priv(key), p, xy);
+    }
+    if (err == 0) {
+        err = ecc_sm2_enc_setup(ctx, xy, key->heap);
+    }
+
+    wc_ecc_del_point_h(p, key->heap);
+    ForceZero(xy, sizeof(xy));
+
+    return err;
+}
+
+/* Decrypt more of C2.
+ *
+ * @param [in, out] ctx  SM2 encryption context.
+ * @param [in]      in   Next part of C2.
+ * @param [in]      sz   Number of bytes of data.
+ * @param [out]     msg  Buffer to hold decrypted data. May be same as in.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when ctx is NULL, or in or msg is NULL and sz is
+ *          not 0.
+ */
+int wc_ecc_sm2_decrypt_update(wc_Sm2EncCtx* ctx, const byte* in, word32 sz,
+    byte* msg)
+{
+    int err = 0;
+
+    /* Validate parameters. */
+    if ((ctx == NULL) || ((sz > 0) && ((in == NULL) || (msg == NULL)))) {
+        err = BAD_FUNC_ARG;
+    }
+
+    if (err == 0) {
+        err = ecc_sm2_enc_xor(ctx, in, sz, msg);
+    }
+    /* Hash decrypted message. */
+    if (err == 0) {
+        err = wc_Sm3Update(&ctx->c3, msg, sz);
+    }
+
+    return err;
+}
+
+/* Finish SM2 decryption by checking C3.
+ *
+ * @param [in, out] ctx  SM2 encryption context.
+ * @param [in]      c3   C3 from encrypted data. WC_SM2_C3_SIZE bytes.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when ctx or c3 is NULL.
+ * @return  BAD_STATE_E when key stream used is all zeros or no data.
+ * @return  MAC_CMP_FAILED_E when C3 doesn't match decrypted data.
+ */
+int wc_ecc_sm2_decrypt_final(wc_Sm2EncCtx* ctx, const byte* c3)
+{
+    int err = 0;
+    byte u[WC_SM2_C3_SIZE];
+
+    /* Validate parameters. */
+    if ((ctx == NULL) || (c3 == NULL)) {
+        err = BAD_FUNC_ARG;
+    }
+    /* Key stream of all zeros is not allowed. */
+    if ((err == 0) && (ctx->ksOr == 0)) {
+        err = BAD_STATE_E;
+    }
+
+    if (err == 0) {
+        err = wc_Sm3Update(&ctx->c3, ctx->y2, SM2_KEY_SIZE);
+    }
+    if (err == 0) {
+        err = wc_Sm3Final(&ctx->c3, u);
+    }
+    if ((err == 0) && (ConstantCompare(u, c3, WC_SM2_C3_SIZE) != 0)) {
+        err = MAC_CMP_FAILED_E;
+    }
+
+    return err;
+}
+
+/* Dispose of SM2 encryption context.
+ *
+ * Sensitive data is zeroized.
+ *
+ * @param [in, out] ctx  SM2 encryption context.
+ */
+void wc_ecc_sm2_enc_free(wc_Sm2EncCtx* ctx)
+{
+    if (ctx != NULL) {
+        wc_Sm3Free(&ctx->kdf);
+        wc_Sm3Free(&ctx->c3);
+        ForceZero(ctx, sizeof(*ctx));
+    }
+}
+
+/* Encrypt a message with an SM2 public key.
+ *
+ * Encrypted data is: C1 || C3 || C2.
+ *
+ * @param [in]      key    ECC public key on SM2 curve.
+ * @param [in]      rng    Random number generator.
+ * @param [in]      msg    Message to encrypt.
+ * @param [in]      msgSz  Size of message in bytes.
+ * @param [out]     out    Buffer to hold encrypted data. Must not overlap msg.
+ * @param [in, out] outSz  On in, size of buffer in bytes.
+ *                         On out, size of encrypted data in bytes.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when key, rng, msg, out or outSz is NULL.
+ * @return  BAD_FUNC_ARG when msgSz is 0.
+ * @return  BUFFER_E when out is too small.
+ * @return  MEMORY_E on dynamic memory allocation failure.
+ */
+int wc_ecc_sm2_encrypt(ecc_key* key, WC_RNG* rng, const byte* msg,
+    word32 msgSz, byte* out, word32* outSz)
+{
+    int err = 0;
+#ifdef WOLFSSL_SMALL_STACK
+    wc_Sm2EncCtx* ctx = NULL;
+#else
+    wc_Sm2EncCtx ctx[1];
+#endif
+    int i;
+
+    /* Validate parameters. */
+    if ((key == NULL) || (rng == NULL) || (msg == NULL) || (out == NULL) ||
+            (outSz == NULL) || (msgSz == 0)) {
+        err = BAD_FUNC_ARG;
+    }
+    if ((err == 0) && ((msgSz > (word32)0 - WC_SM2_ENC_OVERHEAD) ||
+            (*outSz < msgSz + WC_SM2_ENC_OVERHEAD))) {
+        err = BUFFER_E;
+    }
+
+#ifdef WOLFSSL_SMALL_STACK
+    if (err == 0) {
+        ctx = (wc_Sm2EncCtx*)XMALLOC(sizeof(wc_Sm2EncCtx), key->heap,
+            DYNAMIC_TYPE_TMP_BUFFER);
+        if (ctx == NULL) {
+            err = MEMORY_E;
+        }
+    }
+#endif
+
+    /* Try again with a new ephemeral key when key stream is all zeros. */
+    for (i = 0; (err == 0) && (i < ECC_SM2_MAX_ENC_GEN); i++) {
+        err = wc_ecc_sm2_encrypt_init(ctx, key, rng, out);
+        if (err == 0) {
+            err = wc_ecc_sm2_encrypt_update(ctx, msg, msgSz,
+                out + WC_SM2_ENC_OVERHEAD);
+        }
+        if (err == 0) {
+            err = wc_ecc_sm2_encrypt_final(ctx, out + WC_SM2_C1_SIZE);
+        }
+        if (err != BAD_STATE_E) {
+            break;
+        }
+        err = 0;
+    }
+    if ((err == 0) && (i == ECC_SM2_MAX_ENC_GEN)) {
+        err = RNG_FAILURE_E;
+    }
+    if (err == 0) {
+        *outSz = msgSz + WC_SM2_ENC_OVERHEAD;
+    }
+
+#ifdef WOLFSSL_SMALL_STACK
+    if (ctx != NULL)
+#endif
+    {
+        wc_ecc_sm2_enc_free(ctx);
+    #ifdef WOLFSSL_SMALL_STACK
+        XFREE(ctx, key->heap, DYNAMIC_TYPE_TMP_BUFFER);
+    #endif
+    }
+
+    return err;
+}
+
+/* Decrypt data encrypted with an SM2 public key.
+ *
+ * Encrypted data is: C1 || C3 || C2.
+ * C1 may be an uncompressed or compressed point.
+ *
+ * @param [in]      key    ECC private key on SM2 curve.
+ * @param [in]      in     Encrypted data.
+ * @param [in]      inSz   Size of encrypted data in bytes.
+ * @param [out]     msg    Buffer to hold message. Must not overlap in.
+ * @param [in, out] msgSz  On in, size of buffer in bytes.
+ *                         On out, size of message in bytes.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when key, in, msg or msgSz is NULL.
+ * @return  BUFFER_E when in is too short or msg is too small.
+ * @return  MAC_CMP_FAILED_E when C3 doesn't match decrypted data.
+ * @return  MEMORY_E on dynamic memory allocation failure.
+ */
+int wc_ecc_sm2_decrypt(ecc_key* key, const byte* in, word32 inSz, byte* msg,
+    word32* msgSz)
+{
+    int err = 0;
+#ifdef WOLFSSL_SMALL_STACK
+    wc_Sm2EncCtx* ctx = NULL;
+#else
+    wc_Sm2EncCtx ctx[1];
+#endif
+    word32 c1Sz = WC_SM2_C1_SIZE;
+    word32 sz = 0;
+
+    /* Validate parameters. */
+    if ((key == NULL) || (in == NULL) || (msg == NULL) || (msgSz == NULL)) {
+        err = BAD_FUNC_ARG;
+    }
+    if (err == 0) {
+        /* Compressed points have only the x ordinate. */
+        if ((inSz > 0) && ((in[0] == ECC_POINT_COMP_EVEN) ||
+                           (in[0] == ECC_POINT_COMP_ODD))) {
+            c1Sz = 1 + SM2_KEY_SIZE;
+        }
+        /* Must have at least one byte of C2. */
+        if (inSz <= c1Sz + WC_SM2_C3_SIZE) {
+            err = BUFFER_E;
+        }
+    }
+    if (err == 0) {
+        sz = inSz - c1Sz - WC_SM2_C3_SIZE;
+        if (*msgSz < sz) {
+            err = BUFFER_E;
+        }
+    }
+
+#ifdef WOLFSSL_SMALL_STACK
+    if (err == 0) {
+        ctx = (wc_Sm2EncCtx*)XMALLOC(sizeof(wc_Sm2EncCtx), key->heap,
+            DYNAMIC_TYPE_TMP_BUFFER);
+        if (ctx == NULL) {
+            err = MEMORY_E;
+        }
+    }
+#endif
+
+    if (err == 0) {
+        err = wc_ecc_sm2_decrypt_init(ctx, key, in, c1Sz);
+    }
+    if (err == 0) {
+        err = wc_ecc_sm2_decrypt_update(ctx, in + c1Sz + WC_SM2_C3_SIZE, sz,
+            msg);
+    }
+    if (err == 0) {
+        err = wc_ecc_sm2_decrypt_final(ctx, in + c1Sz);
+        if (err != 0) {
+            /* Don't return unauthenticated data. */
+            ForceZero(msg, sz);
+        }
+    }
+    if (err == 0) {
+        *msgSz = sz;
+    }
+
+#ifdef WOLFSSL_SMALL_STACK
+    if (ctx != NULL)
+#endif
+    {
+        wc_ecc_sm2_enc_free(ctx);
+    #ifdef WOLFSSL_SMALL_STACK
+        XFREE(ctx, key->heap, DYNAMIC_TYPE_TMP_BUFFER);
+    #endif
+    }
+
+    return err;
+}
+#endif /* WOLFSSL_SM2_ENCRYPT */
+
+#ifdef WOLFSSL_SM2_KAP
+/* Number of bits of x-ordinate used in x_: w = ceil(ceil(log2(n)) / 2) - 1 */
+#define ECC_SM2_KAP_W           127
+
+/* Calculate ZA of a key for SM2 key exchange.
+ *
+ * ZA only depends on the ID and public key and can be cached.
+ *
+ * 5.1.4.4:
+ *   ZA=H256(ENTLA || IDA || a || b || xG || yG || xA || yA)
+ *
+ * @param [in]  id    ID of owner of key.
+ * @param [in]  idSz  Size of ID in bytes.
+ * @param [in]  key   SM2 ECC key with public key set.
+ * @param [out] za    Buffer to hold ZA. WC_SM2_Z_SIZE bytes in size.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when id, key or za is NULL.
+ * @return  MEMORY_E on dynamic memory allocation failure.
+ */
+int wc_ecc_sm2_calc_za(const byte* id, word16 idSz, ecc_key* key, byte* za)
+{
+    int err = 0;
+#ifdef WOLFSSL_SMALL_STACK
+    wc_HashAlg* hash = NULL;
+#else
+    wc_HashAlg hash[1];
+#endif
+    int hash_inited = 0;
+
+    /* Validate parameters. */
+    if ((key == NULL) || (key->dp == NULL) || (id == NULL) || (za == NULL)) {
+        err = BAD_FUNC_ARG;
+    }
+
+#ifdef WOLFSSL_SMALL_STACK
+    if (err == 0) {
+        hash = (wc_HashAlg*)XMALLOC(sizeof(wc_HashAlg), key->heap,
+            DYNAMIC_TYPE_HASHES);
+        if (hash == NULL) {
+            err = MEMORY_E;
+        }
+    }
+#endif
+
+    if (err == 0) {
+        /* Initialize hash algorithm object. */
+        err = wc_HashInit_ex(hash, WC_HASH_TYPE_SM3, key->heap, 0);
+    }
+    if (err == 0) {
+        hash_inited = 1;
+        err = _ecc_sm2_calc_za(id, idSz, hash, WC_HASH_TYPE_SM3, key, za);
+    }
+
+    /* Dispose of allocated data. */
+    if (hash_inited) {
+        (void)wc_HashFree(hash, WC_HASH_TYPE_SM3);
+    }
+#ifdef WOLFSSL_SMALL_STACK
+    XFREE(hash, key->heap, DYNAMIC_TYPE_HASHES);
+#endif
+    return err;
+}
+
+/* Calculate x_ = 2^w + (x & (2^w - 1)) from the x-ordinate of a point.
+ *
+ * @param [in]  p     Point in affine coordinates.
+ * @param [out] xBar  x_ as a multi-precision number.
+ * @return  0 on success.
+ */
+static int ecc_sm2_kap_xbar(ecc_point* p, mp_int* xBar)
+{
+    int err;
+    byte x[SM2_KEY_SIZE];
+
+    err = mp_to_unsigned_bin_len(p->x, x, SM2_KEY_SIZE);
+    if (err == 0) {
+        /* Keep bottom w bits and set bit w. */
+        x[SM2_KEY_SIZE - 16] = (byte)(x[SM2_KEY_SIZE - 16] | 0x80);
+        err = mp_read_unsigned_bin(xBar, x + SM2_KEY_SIZE - 16, 16);
+    }
+
+    return err;
+}
+
+/* Start SM2 key exchange with static and ephemeral keys.
+ *
+ * Ephemeral keys can be made ahead of time, e.g. wc_ecc_sm2_make_key_batch,
+ * and initialization done before the peer's ephemeral key is received.
+ * Send the public key of the ephemeral key to the peer.
+ *
+ * A4-A5 (B2-B4):
+ *   x1_ = 2^w + (x1 & (2^w - 1))
+ *   tA = (dA + x1_.rA) mod n
+ *
+ * @param [out] kap   SM2 key exchange object.
+ * @param [in]  priv  Static private key on SM2 curve.
+ * @param [in]  eph   Ephemeral private key on SM2 curve.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when kap, priv or eph is NULL.
+ * @return  BAD_FUNC_ARG when keys are not on SM2 curve.
+ * @return  MEMORY_E on dynamic memory allocation failure.
+ */
+int wc_ecc_sm2_kap_init(wc_Sm2Kap* kap, ecc_key* priv, ecc_key* eph)
+{
+    int err = 0;
+#ifdef WOLFSSL_SMALL_STACK
+    mp_int* data = NULL;
+#else
+    mp_int data[2];
+#endif
+    mp_int* xBar = NULL;
+    mp_int* order = NULL;
+    int tInit = 0;
+
+    /* Validate parameters. */
+    if ((kap == NULL) || (priv == NULL) || (eph == NULL) ||
+            (priv->dp == NULL) || (eph->dp == NULL)) {
+        err = BAD_FUNC_ARG;
+    }
+    /* SM2 key exchange must be with keys on the SM2 curve. */
+    if ((err == 0) && (((priv->dp->id != ECC_SM2P256V1) &&
+            (priv->idx != ECC_CUSTOM_IDX)) || (eph->dp->id != priv->dp->id))) {
+        err = BAD_FUNC_ARG;
+    }
+
+#ifdef WOLFSSL_SMALL_STACK
+    if (err == 0) {
+        data = (mp_int*)XMALLOC(sizeof(mp_int) * 2, priv->heap,
+            DYNAMIC_TYPE_ECC);
+        if (data == NULL) {
+            err = MEMORY_E;
+        }
+    }
+#endif
+    if (err == 0) {
+        xBar = data;
+        order = data + 1;
+        err = mp_init_multi(xBar, order, &kap->t, NULL, NULL, NULL);
+        tInit = (err == 0);
+    }
+    if (err == 0) {
+        kap->heap = priv->heap;
+        err = mp_read_radix(order, priv->dp->order, MP_RADIX_HEX);
+    }
+    if (err == 0) {
+        err = ecc_sm2_kap_xbar(&eph->pubkey, xBar);
+    }
+    /* t = (d + x_.r) mod n */
+    if (err == 0) {
+        err = mp_mulmod(xBar, wc_ecc_key_get_priv(eph), order, &kap->t);
+    }
+    if (err == 0) {
+        err = mp_addmod(&kap->t, wc_ecc_key_get_priv(priv), order, &kap->t);
+    }
+    /* Keep ephemeral public point for confirmation hashes. */
+    if (err == 0) {
+        err = mp_to_unsigned_bin_len(eph->pubkey.x, kap->r, SM2_KEY_SIZE);
+    }
+    if (err == 0) {
+        err = mp_to_unsigned_bin_len(eph->pubkey.y, kap->r + SM2_KEY_SIZE,
+            SM2_KEY_SIZE);
+    }
+
+    if (xBar != NULL) {
+        mp_free(xBar);
+        mp_free(order);
+    }
+#ifdef WOLFSSL_SMALL_STACK
+    XFREE(data, priv->heap, DYNAMIC_TYPE_ECC);
+#endif
+    if ((err != 0) && tInit) {
+        mp_forcezero(&kap->t);
+    }
+    return err;
+}
+
+#ifndef WOLFSSL_SP_MATH
+/* Calculate U = t.P + (t.x_ mod n).R in affine coordinates.
+ *
+ * Both scalar multiplications are constant time as t is secret.
+ *
+ * @param [in]  key   Key on SM2 curve. Used for curve and heap.
+ * @param [in]  t     Secret scalar.
+ * @param [in]  xBar  x_ of peer's ephemeral point.
+ * @param [in]  p     Peer's static public point.
+ * @param [in]  r     Peer's ephemeral public point.
+ * @param [out] u     Resulting point.
+ * @return  0 on success.
+ * @return  MEMORY_E on dynamic memory allocation failure.
+ */
+static int ecc_sm2_kap_mul(ecc_key* key, mp_int* t, mp_int* xBar,
+    ecc_point* p, ecc_point* r, ecc_point* u)
+{
+    int err = 0;
+#ifdef WOLFSSL_SMALL_STACK
+    mp_int* data = NULL;
+#else
+    mp_int data[4];
+#endif
+    mp_int* a = NULL;
+    mp_int* prime = NULL;
+    mp_int* order = NULL;
+    mp_int* t2 = NULL;
+    ecc_point* tp = NULL;
+    mp_digit mp = 0;
+
+#ifdef WOLFSSL_SMALL_STACK
+    data = (mp_int*)XMALLOC(sizeof(mp_int) * 4, key->heap, DYNAMIC_TYPE_ECC);
+    if (data == NULL) {
+        err = MEMORY_E;
+    }
+#endif
+    if (err == 0) {
+        tp = wc_ecc_new_point_h(key->heap);
+        if (tp == NULL) {
+            err = MEMORY_E;
+        }
+    }
+    if (err == 0) {
+        a = data;
+        prime = data + 1;
+        order = data + 2;
+        t2 = data + 3;
+        err = mp_init_multi(a, prime, order, t2, NULL, NULL);
+    }
+    if (err == 0) {
+        err = mp_read_radix(a, key->dp->Af, MP_RADIX_HEX);
+    }
+    if (err == 0) {
+        err = mp_read_radix(prime, key->dp->prime, MP_RADIX_HEX);
+    }
+    if (err == 0) {
+        err = mp_read_radix(order, key->dp->order, MP_RADIX_HEX);
+    }
+    if (err == 0) {
+        err = mp_montgomery_setup(prime, &mp);
+    }
+    /* t2 = t.x_ mod n */
+    if (err == 0) {
+        err = mp_mulmod(t, xBar, order, t2);
+    }
+    /* U = t.P + t2.R */
+    if (err == 0) {
+        err = wc_ecc_mulmod_ex(t, p, tp, a, prime, 0, key->heap);
+    }
+    if (err == 0) {
+        err = wc_ecc_mulmod_ex(t2, r, u, a, prime, 0, key->heap);
+    }
+    if (err == 0) {
+        err = ecc_projective_add_point(u, tp, u, a, prime, mp);
+    }
+    if ((err == 0) && mp_iszero(u->z) && mp_iszero(u->x) &&
+            mp_iszero(u->y)) {
+        /* Points were the same - double instead. */
+        err = ecc_projective_dbl_point(tp, u, a, prime, mp);
+    }
+    if ((err == 0) && mp_iszero(u->z)) {
+        /* Result is the point at infinity. */
+        err = ECC_INF_E;
+    }
+    if (err == 0) {
+        err = ecc_map(u, prime, mp);
+    }
+
+    if (tp != NULL) {
+        mp_forcezero(tp->x);
+        mp_forcezero(tp->y);
+        mp_forcezero(tp->z);
+        wc_ecc_del_point_h(tp, key->heap);
+    }
+    if (a != NULL) {
+        mp_free(a);
+        mp_free(prime);
+        mp_free(order);
+        mp_forcezero(t2);
+    }
+#ifdef WOLFSSL_SMALL_STACK
+    XFREE(data, key->heap, DYNAMIC_TYPE_ECC);
+#endif
+    return err;
+}
+#endif /* !WOLFSSL_SP_MATH */
+
+/* Calculate the confirmation value: Hash(tag || yU || inner)
+ *
+ * @param [in]  tag    0x02 or 0x03.
+ * @param [in]  yU     y-ordinate of U.
+ * @param [in]  inner  Hash(xU || ZA || ZB || x1 || y1 || x2 || y2)
+ * @param [out] s      Buffer to hold confirmation value.
+ * @param [in]  heap   Dynamic memory allocation hint.
+ * @return  0 on success.
+ */
+static int ecc_sm2_kap_confirm(byte tag, const byte* yU, const byte* inner,
+    byte* s, void* heap)
+{
+    int err;
+    wc_Sm3 sm3;
+
+    err = wc_InitSm3(&sm3, heap, INVALID_DEVID);
+    if (err == 0) {
+        err = wc_Sm3Update(&sm3, &tag, 1);
+        if (err == 0) {
+            err = wc_Sm3Update(&sm3, yU, SM2_KEY_SIZE);
+        }
+        if (err == 0) {
+            err = wc_Sm3Update(&sm3, inner, WC_SM3_DIGEST_SIZE);
+        }
+        if (err == 0) {
+            err = wc_Sm3Final(&sm3, s);
+        }
+        wc_Sm3Free(&sm3);
+    }
+
+    return err;
+}
+
+/* Finish SM2 key exchange with peer's static and ephemeral public keys.
+ *
+ * ZA is always of the initiator (A) and ZB of the responder (B).
+ * For the initiator:
+ *   sB is S1 - compare with SB received from responder.
+ *   sA is SA - send to responder.
+ * For the responder:
+ *   sB is SB - send to initiator.
+ *   sA is S2 - compare with SA received from initiator.
+ *
+ * A6-A10 (B5-B10):
+ *   x2_ = 2^w + (x2 & (2^w - 1))
+ *   U = [h.tA](PB + [x2_]RB)
+ *   KA = KDF(xU || yU || ZA || ZB, klen)
+ *   S1 = Hash(0x02 || yU || Hash(xU || ZA || ZB || x1 || y1 || x2 || y2))
+ *   SA = Hash(0x03 || yU || Hash(xU || ZA || ZB || x1 || y1 || x2 || y2))
+ *
+ * The cofactor h is 1 for the SM2 curve.
+ * With SP, P + [x2_]R is calculated with half the number of point doublings
+ * before the one constant time multiplication by t.
+ *
+ * @param [in]  kap        SM2 key exchange object.
+ * @param [in]  peer       Peer's static public key on SM2 curve.
+ * @param [in]  peerEph    Peer's ephemeral public key on SM2 curve.
+ * @param [in]  initiator  1 when this side initiated the exchange.
+ * @param [in]  za         ZA of initiator. WC_SM2_Z_SIZE bytes.
+ * @param [in]  zb         ZB of responder. WC_SM2_Z_SIZE bytes.
+ * @param [out] out        Buffer to hold shared key.
+ * @param [in]  outSz      Length of shared key to generate in bytes.
+ * @param [out] sB         Buffer to hold S1/SB. May be NULL.
+ * @param [out] sA         Buffer to hold SA/S2. May be NULL.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when kap, peer, peerEph, za, zb or out is NULL.
+ * @return  BAD_FUNC_ARG when keys are not on SM2 curve.
+ * @return  ECC_INF_E when U is the point at infinity.
+ * @return  MEMORY_E on dynamic memory allocation failure.
+ * @return  Other negative when peer's ephemeral point is not on the curve.
+ */
+int wc_ecc_sm2_kap_final(wc_Sm2Kap* kap, ecc_key* peer, ecc_key* peerEph,
+    int initiator, const byte* za, const byte* zb, byte* out, word32 outSz,
+    byte* sB, byte* sA)
+{
+    int err = 0;
+#ifdef WOLFSSL_SMALL_STACK
+    mp_int* xBar = NULL;
+    wc_Sm3* sm3 = NULL;
+#else
+    mp_int xBar[1];
+    wc_Sm3 sm3[1];
+#endif
+    ecc_point* u = NULL;
+    byte uxy[2 * SM2_KEY_SIZE];
+    byte rxy[2 * SM2_KEY_SIZE];
+    byte ks[WC_SM3_DIGEST_SIZE];
+    word32 ct = 1;
+    word32 blocks;
+    int xBarInit = 0;
+
+    /* Validate parameters. */
+    if ((kap == NULL) || (peer == NULL) || (peerEph == NULL) || (za == NULL) ||
+            (zb == NULL) || (out == NULL) || (peer->dp == NULL) ||
+            (peerEph->dp == NULL)) {
+        err = BAD_FUNC_ARG;
+    }
+    /* SM2 key exchange must be with keys on the SM2 curve. */
+    if ((err == 0) && (((peer->dp->id != ECC_SM2P256V1) &&
+            (peer->idx != ECC_CUSTOM_IDX)) ||
+            (peerEph->dp->id != peer->dp->id))) {
+        err = BAD_FUNC_ARG;
+    }
+
+#ifdef WOLFSSL_SMALL_STACK
+    if (err == 0) {
+        xBar = (mp_int*)XMALLOC(sizeof(mp_int), kap->heap, DYNAMIC_TYPE_ECC);
+        if (xBar == NULL) {
+            err = MEMORY_E;
+        }
+    }
+    if (err == 0) {
+        sm3 = (wc_Sm3*)XMALLOC(sizeof(wc_Sm3), kap->heap,
+            DYNAMIC_TYPE_TMP_BUFFER);
+        if (sm3 == NULL) {
+            err = MEMORY_E;
+        }
+    }
+#endif
+    if (err == 0) {
+        u = wc_ecc_new_point_h(kap->heap);
+        if (u == NULL) {
+            err = MEMORY_E;
+        }
+    }
+    if (err == 0) {
+        err = mp_init(xBar);
+        xBarInit = (err == 0);
+    }
+
+    /* Peer's ephemeral point must be on the curve. */
+    if (err == 0) {
+        err = wc_ecc_point_is_on_curve(&peerEph->pubkey, peerEph->idx);
+    }
+    if (err == 0) {
+        err = ecc_sm2_kap_xbar(&peerEph->pubkey, xBar);
+    }
+    /* U = t.(P + x_.R)
+     * P + x_.R is only public data and may be calculated in variable time. */
+#if defined(WOLFSSL_HAVE_SP_ECC) && defined(WOLFSSL_SP_SM2)
+    if ((err == 0) && (peer->dp->id == ECC_SM2P256V1)) {
+        SAVE_VECTOR_REGISTERS(err = _svr_ret;);
+        if (err == 0) {
+            err = sp_ecc_mulmod_kap_sm2_256(&kap->t, xBar, &peer->pubkey,
+                &peerEph->pubkey, u, kap->heap);
+            RESTORE_VECTOR_REGISTERS();
+        }
+    }
+    else
+#endif
+    if (err == 0) {
+#ifndef WOLFSSL_SP_MATH
+        err = ecc_sm2_kap_mul(peer, &kap->t, xBar, &peer->pubkey,
+            &peerEph->pubkey, u);
+#else
+        err = NOT_COMPILED_IN;
+#endif
+    }
+    if ((err == 0) && mp_iszero(u->x) && mp_iszero(u->y)) {
+        err = ECC_INF_E;
+    }
+    if (err == 0) {
+        err = mp_to_unsigned_bin_len(u->x, uxy, SM2_KEY_SIZE);
+    }
+    if (err == 0) {
+        err = mp_to_unsigned_bin_len(u->y, uxy + SM2_KEY_SIZE, SM2_KEY_SIZE);
+    }
+    if (err == 0) {
+        err = mp_to_unsigned_bin_len(peerEph->pubkey.x, rxy, SM2_KEY_SIZE);
+    }
+    if (err == 0) {
+        err = mp_to_unsigned_bin_len(peerEph->pubkey.y, rxy + SM2_KEY_SIZE,
+            SM2_KEY_SIZE);
+    }
+
+    /* K = KDF(xU || yU || ZA || ZB, klen) - Z is two SM3 blocks. */
+    if (err == 0) {
+        err = wc_InitSm3(sm3, kap->heap, INVALID_DEVID);
+    }
+    if (err == 0) {
+        err = wc_Sm3Update(sm3, uxy, 2 * SM2_KEY_SIZE);
+        if (err == 0) {
+            err = wc_Sm3Update(sm3, za, WC_SM2_Z_SIZE);
+        }
+        if (err == 0) {
+            err = wc_Sm3Update(sm3, zb, WC_SM2_Z_SIZE);
+        }
+        /* Generate all whole blocks of key at once. */
+        blocks = outSz / WC_SM3_DIGEST_SIZE;
+        if ((err == 0) && (blocks > 0)) {
+            err = wc_Sm3KdfBlocks(sm3, ct, out, blocks);
+            ct += blocks;
+        }
+        if ((err == 0) && ((outSz % WC_SM3_DIGEST_SIZE) != 0)) {
+            err = wc_Sm3KdfBlocks(sm3, ct, ks, 1);
+            XMEMCPY(out + blocks * WC_SM3_DIGEST_SIZE, ks,
+                outSz % WC_SM3_DIGEST_SIZE);
+        }
+        wc_Sm3Free(sm3);
+    }
+
+    /* Hash(xU || ZA || ZB || x1 || y1 || x2 || y2) */
+    if ((err == 0) && ((sB != NULL) || (sA != NULL))) {
+        err = wc_InitSm3(sm3, kap->heap, INVALID_DEVID);
+        if (err == 0) {
+            err = wc_Sm3Update(sm3, uxy, SM2_KEY_SIZE);
+            if (err == 0) {
+                err = wc_Sm3Update(sm3, za, WC_SM2_Z_SIZE);
+            }
+            if (err == 0) {
+                err = wc_Sm3Update(sm3, zb, WC_SM2_Z_SIZE);
+            }
+            /* Initiator's ephemeral point is first. */
+            if (err == 0) {
+                err = wc_Sm3Update(sm3, initiator ? kap->r : rxy,
+                    2 * SM2_KEY_SIZE);
+            }
+            if (err == 0) {
+                err = wc_Sm3Update(sm3, initiator ? rxy : kap->r,
+                    2 * SM2_KEY_SIZE);
+            }
+            if (err == 0) {
+                err = wc_Sm3Final(sm3, ks);
+            }
+            wc_Sm3Free(sm3);
+        }
+        if ((err == 0) && (sB != NULL)) {
+            err = ecc_sm2_kap_confirm(0x02, uxy + SM2_KEY_SIZE, ks, sB,
+                kap->heap);
+        }
+        if ((err == 0) && (sA != NULL)) {
+            err = ecc_sm2_kap_confirm(0x03, uxy + SM2_KEY_SIZE, ks, sA,
+                kap->heap);
+        }
+    }
+
+    if ((err != 0) && (out != NULL)) {
+        ForceZero(out, outSz);
+    }
+    if (u != NULL) {
+        /* Shared point is sensitive. */
+        mp_forcezero(u->x);
+        mp_forcezero(u->y);
+        wc_ecc_del_point_h(u, kap->heap);
+    }
+    if (xBarInit) {
+        mp_free(xBar);
+    }
+#ifdef WOLFSSL_SMALL_STACK
+    if (kap != NULL) {
+        XFREE(sm3, kap->heap, DYNAMIC_TYPE_TMP_BUFFER);
+        XFREE(xBar, kap->heap, DYNAMIC_TYPE_ECC);
+    }
+#endif
+    ForceZero(uxy, sizeof(uxy));
+    ForceZero(ks, sizeof(ks));
+
+    return err;
+}
+
+/* Dispose of SM2 key exchange object.
+ *
+ * Sensitive data is zeroized.
+ *
+ * @param [in, out] kap  SM2 key exchange object.
+ */
+void wc_ecc_sm2_kap_free(wc_Sm2Kap* kap)
+{
+    if (kap != NULL) {
+        mp_forcezero(&kap->t);
+        ForceZero(kap->r, sizeof(kap->r));
+    }
+}
+#endif /* WOLFSSL_SM2_KAP */
+
+#ifdef WOLFSSL_SM2_WORKSPACE
+/* Get the size of a workspace that allows any SM2 operation to be performed
+ * without dynamic memory allocation.
+ *
+ * Size is computed from the temporaries that the SM2 operations allocate.
+ * Temporaries of the optimised implementations are not included - build them
+ * with WOLFSSL_SP_NO_MALLOC to have no dynamic memory allocation.
+ *
+ * @return  Size of workspace buffer in bytes.
+ */
+int wc_ecc_sm2_workspace_size(void)
+{
+#ifdef WOLFSSL_SMALL_STACK
+    word32 sz = SM2_WS_SIGN_SZ;
+
+    if (sz < SM2_WS_VERIFY_SZ) {
+        sz = SM2_WS_VERIFY_SZ;
+    }
+#else
+    /* Temporaries are on the stack. */
+    word32 sz = 0;
+#endif
+    /* Allow for buffer not being aligned. */
+    return (int)(sz + SM2_WS_ALIGN - 1);
+}
+
+/* Initialize a workspace with a buffer.
+ *
+ * Buffer must be valid for as long as the workspace is used.
+ * Only one operation at a time may use a workspace.
+ *
+ * @param [out] ws    Workspace object.
+ * @param [in]  buf   Buffer to allocate temporaries from.
+ * @param [in]  size  Size of buffer in bytes.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when ws or buf is NULL.
+ * @return  BUFFER_E when size is less than wc_ecc_sm2_workspace_size().
+ */
+int wc_ecc_sm2_workspace_init(wc_Sm2Workspace* ws, void* buf, word32 size)
+{
+    int err = 0;
+    word32 off = 0;
+
+    if ((ws == NULL) || (buf == NULL)) {
+        err = BAD_FUNC_ARG;
+    }
+    if ((err == 0) && (size < (word32)wc_ecc_sm2_workspace_size())) {
+        err = BUFFER_E;
+    }
+    if (err == 0) {
+        /* Align start of buffer. */
+        off = (word32)((SM2_WS_ALIGN - ((wc_ptr_t)buf & (SM2_WS_ALIGN - 1))) &
+                       (SM2_WS_ALIGN - 1));
+        ws->buf = (byte*)buf + off;
+        ws->size = (size - off) & ~(word32)(SM2_WS_ALIGN - 1);
+        ws->used = 0;
+        ws->last = 0;
+    }
+
+    return err;
+}
+
+/* Check a workspace is free to be used by an SM2 operation.
+ *
+ * @param [in] ws  Workspace to use. May be NULL.
+ * @return  0 on success.
+ * @return  BAD_STATE_E when workspace has memory allocated from it.
+ */
+static int ecc_sm2_ws_start(wc_Sm2Workspace* ws)
+{
+    int err = 0;
+
+    /* Workspace is in use by another operation or memory was leaked. */
+    if ((ws != NULL) && (ws->used != 0)) {
+        WOLFSSL_MSG("SM2 workspace in use");
+        err = BAD_STATE_E;
+    }
+
+    return err;
+}
+
+/* Check all memory allocated from workspace by an SM2 operation was freed.
+ *
+ * Workspace is left in use on failure so that later operations fail too.
+ *
+ * @param [in] ws   Workspace used by operation. May be NULL.
+ * @param [in] err  Result of operation.
+ * @return  Result of operation on success.
+ * @return  BAD_STATE_E when memory is still allocated from workspace.
+ */
+static int ecc_sm2_ws_end(wc_Sm2Workspace* ws, int err)
+{
+    if ((ws != NULL) && (ws->used != 0)) {
+        WOLFSSL_MSG("SM2 workspace memory not freed");
+        err = BAD_STATE_E;
+    }
+
+    return err;
+}
+
+/* Make a key on the SM2 curve using workspace for temporaries.
+ *
+ * @param [in]  rng    Random number generator.
+ * @param [out] key    ECC key to hold generated key.
+ * @param [in]  flags  Flags to set against ECC key.
+ * @param [in]  ws     Workspace to allocate temporaries from. May be NULL.
+ * @return  0 on success.
+ * @return  BAD_STATE_E when workspace is in use.
+ */
+int wc_ecc_sm2_make_key_ws(WC_RNG* rng, ecc_key* key, int flags,
+    wc_Sm2Workspace* ws)
+{
+    int err = ecc_sm2_ws_start(ws);
+
+    if (err == 0) {
+        /* No temporaries allocated by SM2 code. */
+        err = wc_ecc_sm2_make_key(rng, key, flags);
+        err = ecc_sm2_ws_end(ws, err);
+    }
+
+    return err;
+}
+
+/* Create a shared secret using workspace for temporaries.
+ *
+ * @param [in]      priv    Private key.
+ * @param [in]      pub     Peer's public key.
+ * @param [out]     out     Array containing secret.
+ * @param [in, out] outLen  On in, length of array in bytes.
+ *                          On out, number of bytes in secret.
+ * @param [in]      ws      Workspace to allocate temporaries from.
+ *                          May be NULL.
+ * @return  0 on success.
+ * @return  BAD_STATE_E when workspace is in use.
+ */
+int wc_ecc_sm2_shared_secret_ws(ecc_key* priv, ecc_key* pub, byte* out,
+    word32* outLen, wc_Sm2Workspace* ws)
+{
+    int err = ecc_sm2_ws_start(ws);
+
+    if (err == 0) {
+        /* No temporaries allocated by SM2 code. */
+        err = wc_ecc_sm2_shared_secret(priv, pub, out, outLen);
+        err = ecc_sm2_ws_end(ws, err);
+    }
+
+    return err;
+}
+
+#ifdef HAVE_ECC_SIGN
+/* Calculate the signature from the hash using workspace for temporaries.
+ *
+ * @param [in]  hash    Array of bytes holding hash value.
+ * @param [in]  hashSz  Size of hash in bytes.
+ * @param [out] sig     DER encoded DSA signature.
+ * @param [out] sigSz   On in, size of signature buffer in bytes.
+ *                      On out, length of signature in bytes.
+ * @param [in]  rng     Random number generator.
+ * @param [in]  key     ECC private key.
+ * @param [in]  ws      Workspace to allocate temporaries from. May be NULL.
+ * @return  MP_OKAY on success.
+ * @return  BAD_STATE_E when workspace is in use.
+ * @return  MEMORY_E when workspace is too small.
+ */
+int wc_ecc_sm2_sign_hash_ws(const byte* hash, word32 hashSz, byte* sig,
+    word32 *sigSz, WC_RNG* rng, ecc_key* key, wc_Sm2Workspace* ws)
+{
+    int err = ecc_sm2_ws_start(ws);
+
+    if (err == 0) {
+        err = ecc_sm2_sign_hash_der(hash, hashSz, sig, sigSz, rng, key, ws);
+        err = ecc_sm2_ws_end(ws, err);
+    }
+
+    return err;
+}
+#endif /* HAVE_ECC_SIGN */
+
+#if defined(HAVE_ECC_VERIFY) && !defined(NO_ASN)
+/* Verify DER encoded signature using workspace for temporaries.
+ *
+ * @param [in]  sig     DER encoded DSA signature.
+ * @param [in]  sigSz   Length of signature in bytes.
+ * @param [in]  hash    Array of bytes holding hash value.
+ * @param [in]  hashSz  Size of hash in bytes.
+ * @param [out] res     1 when signature verified, 0 otherwise.
+ * @param [in]  key     ECC public key.
+ * @param [in]  ws      Workspace to allocate temporaries from. May be NULL.
+ * @return  MP_OKAY on success.
+ * @return  BAD_STATE_E when workspace is in use.
+ * @return  MEMORY_E when workspace is too small.
+ */
+int wc_ecc_sm2_verify_hash_ws(const byte* sig, word32 sigSz, const byte* hash,
+    word32 hashSz, int* res, ecc_key* key, wc_Sm2Workspace* ws)
+{
+    int err = ecc_sm2_ws_start(ws);
+
+    if (err == 0) {
+        err = ecc_sm2_verify_hash_der(sig, sigSz, hash, hashSz, res, key, ws);
+        err = ecc_sm2_ws_end(ws, err);
+    }
+
+    return err;
+}
+#endif /* HAVE_ECC_VERIFY && !NO_ASN */
+#endif /* WOLFSSL_SM2_WORKSPACE */
+
 #endif /* WOLFSSL_SM2 && HAVE_ECC */
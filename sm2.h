@@ -29,6 +29,27 @@
 
 #include <wolfssl/wolfcrypt/ecc.h>
 
+#if defined(WOLFSSL_SM3) && defined(HAVE_ECC_KEY_EXPORT) && \
+    defined(HAVE_ECC_KEY_IMPORT) && !defined(WOLFSSL_SM2_NO_ENCRYPT)
+    /* SM2 public key encryption (GM/T 0003.4) is available. */
+    #define WOLFSSL_SM2_ENCRYPT
+    #include <wolfssl/wolfcrypt/sm3.h>
+#endif
+#if defined(WOLFSSL_SM3) && !defined(NO_HMAC) && defined(HAVE_ECC_SIGN) && \
+    defined(HAVE_ECC_KEY_IMPORT) && !defined(WOLFSSL_SM2_NO_DETERMINISTIC_K)
+    /* Deterministic generation of k for SM2 signing with HMAC-SM3 is
+     * available. */
+    #define WOLFSSL_SM2_DETERMINISTIC_K
+    #include <wolfssl/wolfcrypt/sm3.h>
+    #include <wolfssl/wolfcrypt/hmac.h>
+#endif
+#if defined(WOLFSSL_SM3) && defined(HAVE_ECC_DHE) && \
+    !defined(NO_HASH_WRAPPER) && !defined(WOLFSSL_SM2_NO_KAP)
+    /* SM2 key exchange protocol (GM/T 0003.3) is available. */
+    #define WOLFSSL_SM2_KAP
+    #include <wolfssl/wolfcrypt/sm3.h>
+#endif
+
 #ifdef __cplusplus
     extern "C" {
 #endif
@@ -36,6 +57,13 @@
 /* Size of the private key. */
 #define SM2_KEY_SIZE    32
 
+#ifdef HAVE_ECC_CHECK_KEY
+#if defined(WOLFSSL_SM2_PUB_KEY_CACHE) && !defined(WC_SM2_PUB_KEY_CACHE_SZ)
+    /* Number of validated public keys cached. Must be a power of 2. */
+    #define WC_SM2_PUB_KEY_CACHE_SZ     1024
+#endif
+#endif
+
 /* ID to use when signing/verifying a certificate. */
 #define CERT_SIG_ID     ((byte*)"1234567812345678")
 /* Length of ID to use when signing/verifying a certificate. */
@@ -45,6 +73,26 @@ WOLFSSL_API
 int wc_ecc_sm2_gen_k(WC_RNG* rng, mp_int* k, mp_int* order);
 WOLFSSL_API
 int wc_ecc_sm2_make_key(WC_RNG* rng, ecc_key* key, int flags);
+WOLFSSL_API
+int wc_ecc_sm2_make_key_batch(WC_RNG* rng, ecc_key* keys, word32 cnt,
+    int flags);
+
+#if defined(HAVE_ECC_KEY_IMPORT) && defined(HAVE_COMP_KEY)
+/* Size of a compressed point on the SM2 curve. */
+#define WC_SM2_COMP_POINT_SIZE  (1 + SM2_KEY_SIZE)
+
+WOLFSSL_API
+int wc_ecc_sm2_import_point_batch(const byte* in, word32 inSz, ecc_key* keys,
+    word32 cnt, int check);
+#endif
+#ifdef HAVE_ECC_CHECK_KEY
+WOLFSSL_API
+int wc_ecc_sm2_check_pub_key(ecc_key* key);
+#ifdef WOLFSSL_SM2_PUB_KEY_CACHE
+WOLFSSL_API
+void wc_ecc_sm2_pub_key_cache_clear(void);
+#endif
+#endif
 
 WOLFSSL_API
 int wc_ecc_sm2_shared_secret(ecc_key* priv, ecc_key* pub, byte* out,
@@ -56,6 +104,15 @@ int wc_ecc_sm2_sign_hash_ex(const byte* hash, word32 hashSz, WC_RNG* rng,
 WOLFSSL_API
 int wc_ecc_sm2_sign_hash(const byte* hash, word32 hashSz, byte* sig,
     word32 *sigLen, WC_RNG* rng, ecc_key* key);
+#ifdef WOLFSSL_SM2_DETERMINISTIC_K
+WOLFSSL_API
+int wc_ecc_sm2_sign_hash_det_ex(const byte* hash, word32 hashSz,
+    const byte* extra, word32 extraSz, ecc_key* key, mp_int* r, mp_int* s);
+#ifdef WOLFSSL_SM2_DET_K_TEST
+WOLFSSL_API
+void wc_ecc_sm2_det_k_test_reject(int cnt);
+#endif
+#endif
 
 WOLFSSL_API
 int wc_ecc_sm2_create_digest(const byte *id, word16 idSz,
@@ -68,6 +125,142 @@ WOLFSSL_API
 int wc_ecc_sm2_verify_hash(const byte* sig, word32 siglen, const byte* hash,
                     word32 hashlen, int* stat, ecc_key* key);
 
+#ifdef WOLFSSL_SM2_ENCRYPT
+/* Size of C1, an uncompressed point, in SM2 encrypted data. */
+#define WC_SM2_C1_SIZE          (1 + 2 * SM2_KEY_SIZE)
+/* Size of C3, an SM3 hash, in SM2 encrypted data. */
+#define WC_SM2_C3_SIZE          WC_SM3_DIGEST_SIZE
+/* Size of SM2 encrypted data over message size: C1 || C3 || C2. */
+#define WC_SM2_ENC_OVERHEAD     (WC_SM2_C1_SIZE + WC_SM2_C3_SIZE)
+/* Number of KDF blocks generated at one time. */
+#ifndef WC_SM2_KDF_BLOCKS
+    #define WC_SM2_KDF_BLOCKS   4
+#endif
+
+/* Context for streaming SM2 encryption and decryption. */
+typedef struct wc_Sm2EncCtx {
+    /* SM3 state after hashing x2 || y2 for KDF. */
+    wc_Sm3 kdf;
+    /* SM3 state of C3: x2 || M || y2. */
+    wc_Sm3 c3;
+    /* y ordinate of shared point to complete C3. */
+    byte   y2[SM2_KEY_SIZE];
+    /* Key stream generated by KDF. */
+    byte   ks[WC_SM2_KDF_BLOCKS * WC_SM3_DIGEST_SIZE];
+    /* Index of next unused key stream byte. */
+    word32 ksIdx;
+    /* KDF counter value of next block of key stream. */
+    word32 ct;
+    /* OR of all key stream bytes used - zero when all zero. */
+    byte   ksOr;
+} wc_Sm2EncCtx;
+
+WOLFSSL_API
+int wc_ecc_sm2_encrypt(ecc_key* key, WC_RNG* rng, const byte* msg,
+    word32 msgSz, byte* out, word32* outSz);
+WOLFSSL_API
+int wc_ecc_sm2_decrypt(ecc_key* key, const byte* in, word32 inSz, byte* msg,
+    word32* msgSz);
+
+WOLFSSL_API
+int wc_ecc_sm2_encrypt_init(wc_Sm2EncCtx* ctx, ecc_key* key, WC_RNG* rng,
+    byte* c1);
+WOLFSSL_API
+int wc_ecc_sm2_encrypt_update(wc_Sm2EncCtx* ctx, const byte* msg, word32 sz,
+    byte* out);
+WOLFSSL_API
+int wc_ecc_sm2_encrypt_final(wc_Sm2EncCtx* ctx, byte* c3);
+WOLFSSL_API
+int wc_ecc_sm2_decrypt_init(wc_Sm2EncCtx* ctx, ecc_key* key, const byte* c1,
+    word32 c1Sz);
+WOLFSSL_API
+int wc_ecc_sm2_decrypt_update(wc_Sm2EncCtx* ctx, const byte* in, word32 sz,
+    byte* msg);
+WOLFSSL_API
+int wc_ecc_sm2_decrypt_final(wc_Sm2EncCtx* ctx, const byte* c3);
+WOLFSSL_API
+void wc_ecc_sm2_enc_free(wc_Sm2EncCtx* ctx);
+#endif /* WOLFSSL_SM2_ENCRYPT */
+
+#ifdef WOLFSSL_SM2_KAP
+/* Size of ZA and ZB used in SM2 key exchange. */
+#define WC_SM2_Z_SIZE           WC_SM3_DIGEST_SIZE
+/* Size of the optional confirmation values S1/SB and S2/SA. */
+#define WC_SM2_KAP_S_SIZE       WC_SM3_DIGEST_SIZE
+
+/* One side of an SM2 key exchange.
+ * Initialize with static and ephemeral keys before the peer's ephemeral key
+ * is received.
+ */
+typedef struct wc_Sm2Kap {
+    /* t = (d + x_.r) mod n - combination of static and ephemeral private. */
+    mp_int t;
+    /* Ephemeral public point: x || y. */
+    byte   r[2 * SM2_KEY_SIZE];
+    /* Dynamic memory allocation hint. */
+    void*  heap;
+} wc_Sm2Kap;
+
+WOLFSSL_API
+int wc_ecc_sm2_calc_za(const byte* id, word16 idSz, ecc_key* key, byte* za);
+WOLFSSL_API
+int wc_ecc_sm2_kap_init(wc_Sm2Kap* kap, ecc_key* priv, ecc_key* eph);
+WOLFSSL_API
+int wc_ecc_sm2_kap_final(wc_Sm2Kap* kap, ecc_key* peer, ecc_key* peerEph,
+    int initiator, const byte* za, const byte* zb, byte* out, word32 outSz,
+    byte* sB, byte* sA);
+WOLFSSL_API
+void wc_ecc_sm2_kap_free(wc_Sm2Kap* kap);
+#endif /* WOLFSSL_SM2_KAP */
+
+/* Caller provided memory to allocate the temporaries of SM2 operations from.
+ * Only defined with WOLFSSL_SM2_WORKSPACE.
+ */
+typedef struct wc_Sm2Workspace wc_Sm2Workspace;
+
+#ifdef WOLFSSL_SM2_WORKSPACE
+/* Only one operation at a time may use a workspace - use one per thread. */
+struct wc_Sm2Workspace {
+    byte*  buf;   /* Aligned start of buffer. */
+    word32 size;  /* Usable size of buffer in bytes. */
+    word32 used;  /* Number of bytes in use. */
+    word32 last;  /* Offset of last allocation's header. */
+};
+
+WOLFSSL_API
+int wc_ecc_sm2_workspace_size(void);
+WOLFSSL_API
+int wc_ecc_sm2_workspace_init(wc_Sm2Workspace* ws, void* buf, word32 size);
+
+WOLFSSL_API
+int wc_ecc_sm2_make_key_ws(WC_RNG* rng, ecc_key* key, int flags,
+    wc_Sm2Workspace* ws);
+WOLFSSL_API
+int wc_ecc_sm2_shared_secret_ws(ecc_key* priv, ecc_key* pub, byte* out,
+    word32* outLen, wc_Sm2Workspace* ws);
+WOLFSSL_API
+int wc_ecc_sm2_sign_hash_ws(const byte* hash, word32 hashSz, byte* sig,
+    word32 *sigSz, WC_RNG* rng, ecc_key* key, wc_Sm2Workspace* ws);
+WOLFSSL_API
+int wc_ecc_sm2_verify_hash_ws(const byte* sig, word32 sigSz, const byte* hash,
+    word32 hashSz, int* res, ecc_key* key, wc_Sm2Workspace* ws);
+
+#endif /* WOLFSSL_SM2_WORKSPACE */
+
+#if defined(WOLFSSL_HAVE_SP_ECC) && defined(WOLFSSL_SP_SM2)
+WOLFSSL_LOCAL
+int sp_ecc_make_key_batch_sm2_256(WC_RNG* rng, word32 cnt, mp_int** priv,
+    ecc_point** pub, void* heap);
+WOLFSSL_LOCAL
+int sp_ecc_mulmod_kap_sm2_256(const mp_int* tm, const mp_int* xm,
+    const ecc_point* pm, const ecc_point* rm, ecc_point* r, void* heap);
+#ifdef HAVE_COMP_KEY
+WOLFSSL_LOCAL
+int sp_ecc_uncompress_batch_sm2_256(word32 cnt, const byte* in,
+    ecc_point** r, int check, void* heap);
+#endif
+#endif
+
 #ifdef __cplusplus
     }    /* extern "C" */
 #endif
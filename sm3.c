@@ -30,6 +30,20 @@
 #include <wolfssl/wolfcrypt/sm3.h>
 #include <wolfssl/wolfcrypt/cpuid.h>
 #include <wolfssl/wolfcrypt/hash.h>
+#if defined(WOLFSSL_SM3_DRBG) && !defined(WC_NO_RNG)
+    #include <wolfssl/wolfcrypt/random.h>
+    /* Entropy for SM3 Hash_DRBG can be taken from the OS. */
+    #define SM3_DRBG_OS_SEED
+#endif
+
+#ifdef WOLFSSL_SM3_DRBG_THREAD
+    #ifndef SM3_DRBG_OS_SEED
+        #error "WOLFSSL_SM3_DRBG_THREAD requires seeding from the OS"
+    #endif
+    #if !defined(HAVE_THREAD_LS) && !defined(SINGLE_THREADED)
+        #error "WOLFSSL_SM3_DRBG_THREAD requires thread local storage"
+    #endif
+#endif
 
 #ifdef NO_INLINE
     #include <wolfssl/wolfcrypt/misc.h>
@@ -64,6 +78,26 @@
     #define HAVE_INTEL_RORX
 #endif
 
+#if defined(__riscv) && (__riscv_xlen == 64) && \
+    defined(WOLFSSL_RISCV_SCALAR_CRYPTO_SM3)
+    /* Use RISC-V scalar crypto instructions sm3p0 and sm3p1 (Zksh). */
+    #define SM3_RISCV_ZKSH
+#endif
+#if defined(__riscv) && (__riscv_xlen == 64) && \
+    defined(WOLFSSL_RISCV_VECTOR_CRYPTO_SM3)
+    /* Use RISC-V vector crypto instructions vsm3me and vsm3c (Zvksh) when
+     * available at runtime. */
+    #define SM3_RISCV_ZVKSH
+
+    #ifdef __linux__
+        #include <sys/syscall.h>
+        #include <unistd.h>
+        #ifdef __NR_riscv_hwprobe
+            #include <asm/hwprobe.h>
+        #endif
+    #endif
+#endif
+
 /******************************************************************************/
 
 /* To support different implementations at the same time, replace these
@@ -147,6 +181,180 @@ static void sm3_set_compress_x64(void)
 /* Only use C implementation of final process. */
 #define sm3_final(sm3)                      sm3_final_c(sm3)
 
+#elif defined(SM3_RISCV_ZVKSH)
+
+/* C and RISC-V vector crypto implementations available. */
+
+/* Vector crypto instructions are encoded so that assembler support is not
+ * required. Register numbers are passed as literals.
+ */
+
+/* vrev8.v vd, vs2 - reverse bytes in each element (Zvkb). */
+#define VREV8_V(vd, vs2)                                                    \
+    ".word (0x12 << 26) | (1 << 25) | "                                     \
+    "((" #vs2 ") << 20) | (0x09 << 15) | "                                  \
+    "(0x2 << 12) | ((" #vd ") << 7) | 0x57\n\t"
+/* vsm3me.vv vd, vs2, vs1 - message expansion of next 8 words. */
+#define VSM3ME_VV(vd, vs2, vs1)                                             \
+    ".word (0x20 << 26) | (1 << 25) | "                                     \
+    "((" #vs2 ") << 20) | ((" #vs1 ") << 15) | "                            \
+    "(0x2 << 12) | ((" #vd ") << 7) | 0x77\n\t"
+/* vsm3c.vi vd, vs2, rnd - rounds 2*rnd and 2*rnd+1 of compression. */
+#define VSM3C_VI(vd, vs2, rnd)                                              \
+    ".word (0x2b << 26) | (1 << 25) | "                                     \
+    "((" #vs2 ") << 20) | ((" #rnd ") << 15) | "                            \
+    "(0x2 << 12) | ((" #vd ") << 7) | 0x77\n\t"
+
+/* Eight rounds of compression with vector crypto instructions.
+ *
+ * State is in v0. v8 and v10 are temporaries.
+ *
+ * @param [in] rnd  First round divided by 2.
+ * @param [in] w0   Vector register with message words W[j..j+7].
+ * @param [in] w1   Vector register with message words W[j+8..j+15].
+ */
+#define SM3_8ROUNDS_ZVKSH(rnd, w0, w1)                  \
+    VSM3C_VI(0, w0, rnd)                                \
+    "vslidedown.vi	v8, v" #w0 ", 2\n\t"           \
+    VSM3C_VI(0, 8, rnd + 1)                             \
+    "vslidedown.vi	v8, v" #w0 ", 4\n\t"           \
+    "vslideup.vi	v8, v" #w1 ", 4\n\t"             \
+    VSM3C_VI(0, 8, rnd + 2)                             \
+    "vslidedown.vi	v10, v8, 2\n\t"                 \
+    VSM3C_VI(0, 10, rnd + 3)
+
+#if defined(__linux__) && defined(__NR_riscv_hwprobe) && \
+    defined(RISCV_HWPROBE_EXT_ZVKSH)
+/* Extensions required: V, Zvkb (vrev8) and Zvksh. */
+#define SM3_ZVKSH_EXTS \
+    (RISCV_HWPROBE_IMA_V | RISCV_HWPROBE_EXT_ZVKB | RISCV_HWPROBE_EXT_ZVKSH)
+#endif
+
+/* Check whether the CPU has the SM3 vector crypto instructions.
+ *
+ * Uses the hwprobe system call on Linux. Otherwise, the instructions are
+ * assumed to be available as they were selected at compile time.
+ * The result is cached with atomic accesses as any thread may check first.
+ *
+ * @return  1 when available.
+ * @return  0 otherwise.
+ */
+static int sm3_zvksh_avail(void)
+{
+    /* Negative until checked. */
+    static int avail = -1;
+    int ret = __atomic_load_n(&avail, __ATOMIC_RELAXED);
+
+    if (ret < 0) {
+    #ifdef SM3_ZVKSH_EXTS
+        struct riscv_hwprobe probe;
+
+        probe.key = RISCV_HWPROBE_KEY_IMA_EXT_0;
+        probe.value = 0;
+        ret = (syscall(__NR_riscv_hwprobe, &probe, 1, 0, NULL, 0) == 0) &&
+              ((probe.value & SM3_ZVKSH_EXTS) == SM3_ZVKSH_EXTS);
+    #else
+        ret = 1;
+    #endif
+        /* Every thread calculates the same value. */
+        __atomic_store_n(&avail, ret, __ATOMIC_RELAXED);
+    }
+
+    return ret;
+}
+
+/* Compression process applied to blocks of data using vector crypto
+ * instructions.
+ *
+ * Vector length agnostic - works with 256-bit element groups for any vector
+ * length.
+ *
+ * @param [in, out] sm3   SM3 hash object.
+ * @param [in]      data  Data to compress as a byte array.
+ * @param [in]      len   Number of bytes of data. Multiple of block size.
+ */
+static void sm3_compress_len_zvksh(wc_Sm3* sm3, const byte* data, word32 len)
+{
+    word32 blocks = len / WC_SM3_BLOCK_SIZE;
+
+    __asm__ __volatile__ (
+        /* Load state and make words big-endian. */
+        "vsetivli	zero, 8, e32, m2, ta, ma\n\t"
+        "vle32.v	v0, (%[v])\n\t"
+        VREV8_V(0, 0)
+        "li	t0, 32\n\t"
+    "1:\n\t"
+        /* Keep state to XOR in at end. */
+        "vmv.v.v	v2, v0\n\t"
+        /* Load message words - big-endian as in data. */
+        "vsetvli	zero, t0, e8, m2, ta, ma\n\t"
+        "vle8.v	v4, (%[data])\n\t"
+        "addi	%[data], %[data], 32\n\t"
+        "vle8.v	v6, (%[data])\n\t"
+        "addi	%[data], %[data], 32\n\t"
+        "vsetivli	zero, 8, e32, m2, ta, ma\n\t"
+
+        SM3_8ROUNDS_ZVKSH( 0, 4, 6)
+        VSM3ME_VV(4, 6, 4)
+        SM3_8ROUNDS_ZVKSH( 4, 6, 4)
+        VSM3ME_VV(6, 4, 6)
+        SM3_8ROUNDS_ZVKSH( 8, 4, 6)
+        VSM3ME_VV(4, 6, 4)
+        SM3_8ROUNDS_ZVKSH(12, 6, 4)
+        VSM3ME_VV(6, 4, 6)
+        SM3_8ROUNDS_ZVKSH(16, 4, 6)
+        VSM3ME_VV(4, 6, 4)
+        SM3_8ROUNDS_ZVKSH(20, 6, 4)
+        VSM3ME_VV(6, 4, 6)
+        SM3_8ROUNDS_ZVKSH(24, 4, 6)
+        VSM3ME_VV(4, 6, 4)
+        SM3_8ROUNDS_ZVKSH(28, 6, 4)
+
+        /* XOR in previous state. */
+        "vxor.vv	v0, v0, v2\n\t"
+        "addi	%[blocks], %[blocks], -1\n\t"
+        "bnez	%[blocks], 1b\n\t"
+
+        /* Store state with words in CPU endian. */
+        VREV8_V(0, 0)
+        "vse32.v	v0, (%[v])\n\t"
+        : [data] "+r" (data), [blocks] "+r" (blocks)
+        : [v] "r" (sm3->v)
+        : "memory", "t0", "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7",
+          "v8", "v9", "v10", "v11"
+    );
+}
+
+/* Compression process applied to a block of data using vector crypto
+ * instructions.
+ *
+ * 32-bit words are in appropriate order for CPU.
+ *
+ * @param [in, out] sm3    SM3 hash object.
+ * @param [in]      block  Block of data that is 512 bits (64 byte) long.
+ */
+static void sm3_compress_zvksh(wc_Sm3* sm3, const word32* block)
+{
+    word32 data[WC_SM3_BLOCK_SIZE / sizeof(word32)];
+
+    /* Put words back into big-endian. */
+    ByteReverseWords(data, block, WC_SM3_BLOCK_SIZE);
+    sm3_compress_len_zvksh(sm3, (const byte*)data, WC_SM3_BLOCK_SIZE);
+}
+
+/* No global function pointers to set. */
+#define SM3_SET_COMPRESS()
+/* Compression process uses vector crypto instructions when available. */
+#define SM3_COMPRESS(sm3, block)                                    \
+    (sm3_zvksh_avail() ? sm3_compress_zvksh : sm3_compress_c)(sm3, block)
+/* Compression process with length uses vector crypto instructions when
+ * available. */
+#define SM3_COMPRESS_LEN(sm3, data, len)                            \
+    (sm3_zvksh_avail() ? sm3_compress_len_zvksh : sm3_compress_len_c)(sm3, \
+        data, len)
+/* Only use C implementation of final process. */
+#define sm3_final(sm3)                      sm3_final_c(sm3)
+
 #else
 
 /* Only C implementation compiled in. */
@@ -184,7 +392,54 @@ static void sm3_set_compress_x64(void)
 #define BSWAP32_8(out, in) \
     ByteReverseWords((word32*)(out), (const word32*)(in), WC_SM3_DIGEST_SIZE)
 
-#if !(defined(WOLFSSL_X86_64_BUILD) || defined(WOLFSSL_X86_BUILD))
+#if defined(SM3_RISCV_ZKSH)
+/* Permutation function within the compression function - sm3p0 instruction.
+ *
+ * @param [in] x  Value to use.
+ * @return  Permutated result.
+ */
+static WC_INLINE word32 sm3_p0_zksh(word32 x)
+{
+    word32 r;
+
+    __asm__ ("sm3p0	%[r], %[x]\n\t"
+        : [r] "=r" (r)
+        : [x] "r" (x)
+    );
+
+    return r;
+}
+
+/* Permutation function within the message expansion - sm3p1 instruction.
+ *
+ * @param [in] x  Value to use.
+ * @return  Permutated result.
+ */
+static WC_INLINE word32 sm3_p1_zksh(word32 x)
+{
+    word32 r;
+
+    __asm__ ("sm3p1	%[r], %[x]\n\t"
+        : [r] "=r" (r)
+        : [x] "r" (x)
+    );
+
+    return r;
+}
+
+/* Permutation function within the compression function.
+ *
+ * @param [in] x  Value to use.
+ * @return  Permutated result.
+ */
+#define P0(x)       sm3_p0_zksh(x)
+/* Permutation function within the message expansion.
+ *
+ * @param [in] x  Value to use.
+ * @return  Permutated result.
+ */
+#define P1(x)       sm3_p1_zksh(x)
+#elif !(defined(WOLFSSL_X86_64_BUILD) || defined(WOLFSSL_X86_BUILD))
 /* Permutation function within the compression function.
  *
  * @param [in] x  Value to use.
@@ -967,6 +1222,37 @@ int wc_Sm3Update(wc_Sm3* sm3, const byte* data, word32 len)
     return ret;
 }
 
+#ifdef WOLFSSL_SM_IOV
+/* Update the hash with message data in a list of buffers.
+ *
+ * Bytes of a block that straddles buffers are cached as with wc_Sm3Update().
+ *
+ * @param [in, out] sm3  SM3 hash object.
+ * @param [in]      iov  List of buffers holding message data.
+ * @param [in]      cnt  Number of buffers in list.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm3 is NULL or cnt > 0 and iov is NULL.
+ * @return  BAD_FUNC_ARG when a buffer is NULL and its length is not 0.
+ * @return  BAD_COND_E when internal state invalid.
+ */
+int wc_Sm3UpdateIov(wc_Sm3* sm3, const wc_SmIov* iov, word32 cnt)
+{
+    int ret = 0;
+    word32 i;
+
+    /* Validate parameters. */
+    if ((sm3 == NULL) || ((cnt > 0) && (iov == NULL))) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    for (i = 0; (ret == 0) && (i < cnt); i++) {
+        ret = wc_Sm3Update(sm3, iov[i].buf, iov[i].len);
+    }
+
+    return ret;
+}
+#endif
+
 /* Last block with data to be hashed.
  *
  * @param [in, out] sm3   SM3 hash object.
@@ -1183,6 +1469,626 @@ int wc_Sm3Copy(const wc_Sm3* src, wc_Sm3* dst)
     return ret;
 }
 
+/* Generate blocks of output of the KDF of GM/T 0003 using SM3.
+ *
+ * Output is: Hash(Z || ct) || Hash(Z || ct + 1) || ...
+ * Z has been hashed into the object and is a multiple of the block size in
+ * length. The last block of each hash is all that is compressed. The state of
+ * the object is not changed by this operation.
+ *
+ * @param [in, out] sm3     SM3 hash object that has hashed Z.
+ * @param [in]      ct      Counter value of first block.
+ * @param [out]     out     Buffer to hold output.
+ *                          blocks * WC_SM3_DIGEST_SIZE bytes in size.
+ * @param [in]      blocks  Number of blocks of output to generate.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm3 is NULL or blocks > 0 and out is NULL.
+ * @return  BAD_STATE_E when the length of Z is not a multiple of the block
+ *          size.
+ */
+int wc_Sm3KdfBlocks(wc_Sm3* sm3, word32 ct, byte* out, word32 blocks)
+{
+    int ret = 0;
+    word32 v[WC_SM3_DIGEST_SIZE / sizeof(word32)];
+    word32 loLen;
+    word32 hiLen;
+    word32 i;
+
+    /* Validate parameters. */
+    if ((sm3 == NULL) || ((blocks > 0) && (out == NULL))) {
+        ret = BAD_FUNC_ARG;
+    }
+    /* Last block must only contain counter and padding. */
+    if ((ret == 0) && (sm3->buffLen != 0)) {
+        ret = BAD_STATE_E;
+    }
+
+    if ((ret == 0) && (blocks > 0)) {
+        /* Length of Z and counter in bytes. */
+        loLen = sm3->loLen + 4;
+        hiLen = sm3->hiLen + (loLen < 4);
+
+        /* Last block: counter, "1" bit and length in bits. */
+        XMEMSET(sm3->buffer, 0, WC_SM3_BLOCK_SIZE);
+        sm3->buffer[1] = 0x80000000;
+        sm3->buffer[14] = (hiLen << 3) | (loLen >> (32 - 3));
+        sm3->buffer[15] = (loLen << 3);
+
+        /* Keep state after hashing Z. */
+        XMEMCPY(v, sm3->v, sizeof(v));
+        for (i = 0; i < blocks; i++) {
+            /* Counter is only change to last block. */
+            sm3->buffer[0] = ct + i;
+            SM3_COMPRESS(sm3, sm3->buffer);
+        #ifdef LITTLE_ENDIAN_ORDER
+            /* Convert little-endian 32-bit words to big-endian bytes. */
+            BSWAP32_8(out, sm3->v);
+        #else
+            XMEMCPY(out, sm3->v, WC_SM3_DIGEST_SIZE);
+        #endif
+            out += WC_SM3_DIGEST_SIZE;
+            /* Restore state for next counter. */
+            XMEMCPY(sm3->v, v, sizeof(v));
+        }
+
+        /* No data cached - clear counter. */
+        XMEMSET(sm3->buffer, 0, WC_SM3_BLOCK_SIZE);
+        ForceZero(v, sizeof(v));
+    }
+
+    return ret;
+}
+
+#ifdef WOLFSSL_SM3_DRBG
+/* SM3 Hash_DRBG - NIST SP 800-90A Hash_DRBG with SM3 as in GM/T 0105.
+ *
+ * Seed length is 440 bits.
+ * There is no locking. Each thread is to have its own DRBG. With
+ * WOLFSSL_SM3_DRBG_THREAD, wc_Sm3DrbgGenerateBlock() uses a DRBG in thread
+ * local storage that is seeded from the OS on first use.
+ */
+
+/* Hash the concatenation of data into the SM3 hash object.
+ *
+ * @param [in, out] sm3   SM3 hash object.
+ * @param [in]      pre   Byte to prepend. Only used when havePre is set.
+ * @param [in]      havePre  Whether to hash the prepended byte.
+ * @param [in]      in    Array of data to hash.
+ * @param [in]      inSz  Array of lengths of data.
+ * @param [in]      cnt   Number of entries in arrays.
+ * @param [out]     hash  Buffer to hold hash result.
+ * @return  0 on success.
+ */
+static int sm3_drbg_hash(wc_Sm3* sm3, byte pre, int havePre,
+    const byte** in, const word32* inSz, int cnt, byte* hash)
+{
+    int ret = 0;
+    int i;
+
+    sm3_init(sm3);
+    if (havePre) {
+        ret = wc_Sm3Update(sm3, &pre, 1);
+    }
+    for (i = 0; (ret == 0) && (i < cnt); i++) {
+        if (inSz[i] > 0) {
+            ret = wc_Sm3Update(sm3, in[i], inSz[i]);
+        }
+    }
+    if (ret == 0) {
+        ret = wc_Sm3Final(sm3, hash);
+    }
+
+    return ret;
+}
+
+/* Derive seed length bytes from the concatenation of data - Hash_df.
+ *
+ * @param [in, out] sm3   SM3 hash object.
+ * @param [in]      pre   Byte to prepend. Only used when havePre is set.
+ * @param [in]      havePre  Whether to hash the prepended byte.
+ * @param [in]      in    Array of data to derive from.
+ * @param [in]      inSz  Array of lengths of data.
+ * @param [in]      cnt   Number of entries in arrays.
+ * @param [out]     out   Buffer to hold derived data.
+ *                        WC_SM3_DRBG_SEED_LEN bytes in size.
+ * @return  0 on success.
+ */
+static int sm3_drbg_hash_df(wc_Sm3* sm3, byte pre, int havePre,
+    const byte** in, const word32* inSz, int cnt, byte* out)
+{
+    int ret = 0;
+    byte hdr[5];
+    byte digest[WC_SM3_DIGEST_SIZE];
+    word32 i;
+    int j;
+
+    /* Number of bits to return as a 32-bit big-endian number. */
+    hdr[1] = 0;
+    hdr[2] = 0;
+    hdr[3] = (byte)((WC_SM3_DRBG_SEED_LEN * 8) >> 8);
+    hdr[4] = (byte)(WC_SM3_DRBG_SEED_LEN * 8);
+
+    for (i = 0; (ret == 0) && (i < WC_SM3_DRBG_SEED_LEN);
+            i += WC_SM3_DIGEST_SIZE) {
+        /* Counter starts at 1. */
+        hdr[0] = (byte)(i / WC_SM3_DIGEST_SIZE + 1);
+        sm3_init(sm3);
+        ret = wc_Sm3Update(sm3, hdr, sizeof(hdr));
+        if ((ret == 0) && havePre) {
+            ret = wc_Sm3Update(sm3, &pre, 1);
+        }
+        for (j = 0; (ret == 0) && (j < cnt); j++) {
+            if (inSz[j] > 0) {
+                ret = wc_Sm3Update(sm3, in[j], inSz[j]);
+            }
+        }
+        if (ret == 0) {
+            ret = wc_Sm3Final(sm3, digest);
+        }
+        if (ret == 0) {
+            /* Only use as much of the last digest as needed. */
+            word32 len = WC_SM3_DRBG_SEED_LEN - i;
+            if (len > WC_SM3_DIGEST_SIZE) {
+                len = WC_SM3_DIGEST_SIZE;
+            }
+            XMEMCPY(out + i, digest, len);
+        }
+    }
+
+    ForceZero(digest, sizeof(digest));
+    return ret;
+}
+
+/* Add a big-endian number into V modulo 2^440.
+ *
+ * @param [in, out] v    V of DRBG state.
+ * @param [in]      a    Big-endian number to add.
+ * @param [in]      aSz  Number of bytes in number. At most seed length.
+ */
+static void sm3_drbg_add(byte* v, const byte* a, word32 aSz)
+{
+    word32 i;
+    word16 carry = 0;
+
+    for (i = 1; i <= WC_SM3_DRBG_SEED_LEN; i++) {
+        carry += v[WC_SM3_DRBG_SEED_LEN - i];
+        if (i <= aSz) {
+            carry += a[aSz - i];
+        }
+        v[WC_SM3_DRBG_SEED_LEN - i] = (byte)carry;
+        carry >>= 8;
+    }
+}
+
+/* Set new V and C from seed material.
+ *
+ * V = Hash_df(seed material), C = Hash_df(0x00 || V)
+ *
+ * @param [in, out] drbg  SM3 Hash_DRBG object.
+ * @param [in]      pre   Byte to prepend. Only used when havePre is set.
+ * @param [in]      havePre  Whether to hash the prepended byte.
+ * @param [in]      in    Array of seed material.
+ * @param [in]      inSz  Array of lengths of seed material.
+ * @param [in]      cnt   Number of entries in arrays.
+ * @return  0 on success.
+ */
+static int sm3_drbg_seed(wc_Sm3Drbg* drbg, byte pre, int havePre,
+    const byte** in, const word32* inSz, int cnt)
+{
+    int ret;
+    byte v[WC_SM3_DRBG_SEED_LEN];
+    const byte* vIn[1];
+    word32 vInSz[1];
+
+    ret = sm3_drbg_hash_df(&drbg->sm3, pre, havePre, in, inSz, cnt, v);
+    if (ret == 0) {
+        vIn[0] = v;
+        vInSz[0] = WC_SM3_DRBG_SEED_LEN;
+        ret = sm3_drbg_hash_df(&drbg->sm3, 0x00, 1, vIn, vInSz, 1, drbg->c);
+    }
+    if (ret == 0) {
+        XMEMCPY(drbg->v, v, WC_SM3_DRBG_SEED_LEN);
+        drbg->reseedCtr = 1;
+    }
+
+    ForceZero(v, sizeof(v));
+    return ret;
+}
+
+/* Generate output from V - Hashgen.
+ *
+ * V is 55 bytes so V, the "1" bit and the length in bits make up exactly one
+ * SM3 block. The block is set up once and only the counter part is changed
+ * for each block of output.
+ *
+ * @param [in, out] drbg  SM3 Hash_DRBG object.
+ * @param [out]     out   Buffer to hold output.
+ * @param [in]      sz    Number of bytes to generate.
+ */
+static void sm3_drbg_hashgen(wc_Sm3Drbg* drbg, byte* out, word32 sz)
+{
+    wc_Sm3* sm3 = &drbg->sm3;
+    word32 data[WC_SM3_BLOCK_SIZE / sizeof(word32)];
+    word32 digest[WC_SM3_DIGEST_SIZE / sizeof(word32)];
+    byte* d = (byte*)data;
+    int i;
+
+    /* Last block: V, "1" bit and length in bits. */
+    XMEMCPY(d, drbg->v, WC_SM3_DRBG_SEED_LEN);
+    XMEMSET(d + WC_SM3_DRBG_SEED_LEN, 0, WC_SM3_BLOCK_SIZE -
+        WC_SM3_DRBG_SEED_LEN);
+    d[WC_SM3_DRBG_SEED_LEN] = 0x80;
+    d[WC_SM3_BLOCK_SIZE - 2] = (byte)((WC_SM3_DRBG_SEED_LEN * 8) >> 8);
+    d[WC_SM3_BLOCK_SIZE - 1] = (byte)(WC_SM3_DRBG_SEED_LEN * 8);
+
+    while (sz > 0) {
+        sm3_init(sm3);
+        SM3_COMPRESS_LEN(sm3, d, WC_SM3_BLOCK_SIZE);
+        if (sz >= WC_SM3_DIGEST_SIZE) {
+        #ifdef LITTLE_ENDIAN_ORDER
+            /* Convert little-endian 32-bit words to big-endian bytes. */
+            BSWAP32_8(out, sm3->v);
+        #else
+            XMEMCPY(out, sm3->v, WC_SM3_DIGEST_SIZE);
+        #endif
+            out += WC_SM3_DIGEST_SIZE;
+            sz -= WC_SM3_DIGEST_SIZE;
+        }
+        else {
+        #ifdef LITTLE_ENDIAN_ORDER
+            BSWAP32_8(digest, sm3->v);
+        #else
+            XMEMCPY(digest, sm3->v, WC_SM3_DIGEST_SIZE);
+        #endif
+            XMEMCPY(out, digest, sz);
+            sz = 0;
+        }
+
+        /* data = (data + 1) mod 2^440 */
+        for (i = WC_SM3_DRBG_SEED_LEN - 1; i >= 0; i--) {
+            if (++d[i] != 0) {
+                break;
+            }
+        }
+    }
+
+    ForceZero(data, sizeof(data));
+    ForceZero(digest, sizeof(digest));
+}
+
+#ifdef SM3_DRBG_OS_SEED
+/* Get entropy input from the OS.
+ *
+ * @param [out] seed    Buffer to hold entropy.
+ * @param [in]  seedSz  Number of bytes of entropy to get.
+ * @return  0 on success.
+ */
+static int sm3_drbg_os_seed(byte* seed, word32 seedSz)
+{
+    OS_Seed os;
+
+    XMEMSET(&os, 0, sizeof(os));
+    return wc_GenerateSeed(&os, seed, seedSz);
+}
+#endif
+
+/* Instantiate the SM3 Hash_DRBG.
+ *
+ * When entropy is NULL, the entropy input, and the nonce when NULL, are taken
+ * from the OS and the DRBG will reseed itself from the OS when the reseed
+ * interval is reached.
+ * The reseed interval is reduced by a random amount of up to 1/16th so that
+ * DRBGs seeded at the same time don't all reseed at the same time.
+ *
+ * @param [out] drbg       SM3 Hash_DRBG object.
+ * @param [in]  entropy    Entropy input. May be NULL.
+ * @param [in]  entropySz  Number of bytes of entropy input.
+ * @param [in]  nonce      Nonce. May be NULL.
+ * @param [in]  nonceSz    Number of bytes in nonce.
+ * @param [in]  pers       Personalization string. May be NULL.
+ * @param [in]  persSz     Number of bytes in personalization string.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when drbg is NULL, entropySz is less than
+ *          WC_SM3_DRBG_MIN_ENTROPY, or nonce/pers is NULL and its size is not
+ *          zero.
+ * @return  NOT_COMPILED_IN when entropy is NULL and entropy can't be taken
+ *          from the OS.
+ */
+int wc_Sm3DrbgInit(wc_Sm3Drbg* drbg, const byte* entropy, word32 entropySz,
+    const byte* nonce, word32 nonceSz, const byte* pers, word32 persSz)
+{
+    int ret = 0;
+    const byte* in[3];
+    word32 inSz[3];
+#ifdef SM3_DRBG_OS_SEED
+    byte seed[WC_SM3_DRBG_MIN_ENTROPY + WC_SM3_DRBG_NONCE_SZ + 2];
+#endif
+
+    /* Validate parameters. */
+    if ((drbg == NULL) ||
+            ((entropy != NULL) && (entropySz < WC_SM3_DRBG_MIN_ENTROPY)) ||
+            ((nonce == NULL) && (nonceSz != 0)) ||
+            ((pers == NULL) && (persSz != 0))) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    if (ret == 0) {
+        XMEMSET(drbg, 0, sizeof(*drbg));
+        drbg->reseedInterval = WC_SM3_DRBG_RESEED_INTERVAL;
+    }
+    if ((ret == 0) && (entropy == NULL)) {
+    #ifdef SM3_DRBG_OS_SEED
+        /* Entropy input, nonce and offset of reseed interval from OS. */
+        ret = sm3_drbg_os_seed(seed, sizeof(seed));
+        if (ret == 0) {
+            word32 offset = ((word32)seed[sizeof(seed) - 2] << 8) |
+                seed[sizeof(seed) - 1];
+
+            entropy = seed;
+            entropySz = WC_SM3_DRBG_MIN_ENTROPY;
+            if (nonce == NULL) {
+                nonce = seed + WC_SM3_DRBG_MIN_ENTROPY;
+                nonceSz = WC_SM3_DRBG_NONCE_SZ;
+            }
+            drbg->reseedInterval -= offset & (drbg->reseedInterval >> 4);
+            drbg->autoReseed = 1;
+        }
+    #else
+        ret = NOT_COMPILED_IN;
+    #endif
+    }
+    if (ret == 0) {
+        /* seed material = entropy || nonce || personalization string */
+        in[0] = entropy;
+        inSz[0] = entropySz;
+        in[1] = nonce;
+        inSz[1] = nonceSz;
+        in[2] = pers;
+        inSz[2] = persSz;
+        ret = sm3_drbg_seed(drbg, 0, 0, in, inSz, 3);
+    }
+
+#ifdef SM3_DRBG_OS_SEED
+    ForceZero(seed, sizeof(seed));
+#endif
+    return ret;
+}
+
+/* Reseed the SM3 Hash_DRBG.
+ *
+ * When entropy is NULL, the entropy input is taken from the OS.
+ *
+ * @param [in, out] drbg       SM3 Hash_DRBG object.
+ * @param [in]      entropy    Entropy input. May be NULL.
+ * @param [in]      entropySz  Number of bytes of entropy input.
+ * @param [in]      add        Additional input. May be NULL.
+ * @param [in]      addSz      Number of bytes of additional input.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when drbg is NULL, entropySz is less than
+ *          WC_SM3_DRBG_MIN_ENTROPY, or add is NULL and addSz is not zero.
+ * @return  NOT_COMPILED_IN when entropy is NULL and entropy can't be taken
+ *          from the OS.
+ */
+int wc_Sm3DrbgReseed(wc_Sm3Drbg* drbg, const byte* entropy, word32 entropySz,
+    const byte* add, word32 addSz)
+{
+    int ret = 0;
+    const byte* in[3];
+    word32 inSz[3];
+#ifdef SM3_DRBG_OS_SEED
+    byte seed[WC_SM3_DRBG_MIN_ENTROPY];
+#endif
+
+    /* Validate parameters. */
+    if ((drbg == NULL) ||
+            ((entropy != NULL) && (entropySz < WC_SM3_DRBG_MIN_ENTROPY)) ||
+            ((add == NULL) && (addSz != 0))) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    if ((ret == 0) && (entropy == NULL)) {
+    #ifdef SM3_DRBG_OS_SEED
+        ret = sm3_drbg_os_seed(seed, sizeof(seed));
+        entropy = seed;
+        entropySz = sizeof(seed);
+    #else
+        ret = NOT_COMPILED_IN;
+    #endif
+    }
+    if (ret == 0) {
+        /* seed material = 0x01 || V || entropy || additional input */
+        in[0] = drbg->v;
+        inSz[0] = WC_SM3_DRBG_SEED_LEN;
+        in[1] = entropy;
+        inSz[1] = entropySz;
+        in[2] = add;
+        inSz[2] = addSz;
+        ret = sm3_drbg_seed(drbg, 0x01, 1, in, inSz, 3);
+    }
+
+#ifdef SM3_DRBG_OS_SEED
+    ForceZero(seed, sizeof(seed));
+#endif
+    return ret;
+}
+
+/* Set the number of generate requests allowed between reseeds.
+ *
+ * @param [in, out] drbg      SM3 Hash_DRBG object.
+ * @param [in]      interval  Number of generate requests.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when drbg is NULL or interval is 0.
+ */
+int wc_Sm3DrbgSetReseedInterval(wc_Sm3Drbg* drbg, word32 interval)
+{
+    int ret = 0;
+
+    /* Validate parameters. */
+    if ((drbg == NULL) || (interval == 0)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    if (ret == 0) {
+        drbg->reseedInterval = interval;
+    }
+
+    return ret;
+}
+
+/* Generate pseudo-random bytes with the SM3 Hash_DRBG.
+ *
+ * When the DRBG was seeded from the OS, it reseeds itself when the reseed
+ * interval is reached. Otherwise, call wc_Sm3DrbgReseed().
+ *
+ * @param [in, out] drbg   SM3 Hash_DRBG object.
+ * @param [out]     out    Buffer to hold pseudo-random bytes.
+ * @param [in]      sz     Number of bytes to generate.
+ * @param [in]      add    Additional input. May be NULL.
+ * @param [in]      addSz  Number of bytes of additional input.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when drbg is NULL, out is NULL and sz is not zero,
+ *          sz is greater than WC_SM3_DRBG_MAX_REQUEST or add is NULL and
+ *          addSz is not zero.
+ * @return  BAD_STATE_E when the DRBG needs to be reseeded.
+ */
+int wc_Sm3DrbgGenerate(wc_Sm3Drbg* drbg, byte* out, word32 sz,
+    const byte* add, word32 addSz)
+{
+    int ret = 0;
+    byte hash[WC_SM3_DIGEST_SIZE];
+    byte ctr[4];
+    const byte* in[2];
+    word32 inSz[2];
+
+    /* Validate parameters. */
+    if ((drbg == NULL) || ((out == NULL) && (sz != 0)) ||
+            (sz > WC_SM3_DRBG_MAX_REQUEST) || ((add == NULL) && (addSz != 0))) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    if ((ret == 0) && (drbg->reseedCtr > drbg->reseedInterval)) {
+    #ifdef SM3_DRBG_OS_SEED
+        if (drbg->autoReseed) {
+            /* Additional input used in reseed and not in generate. */
+            ret = wc_Sm3DrbgReseed(drbg, NULL, 0, add, addSz);
+            add = NULL;
+            addSz = 0;
+        }
+        else
+    #endif
+        {
+            ret = BAD_STATE_E;
+        }
+    }
+    if ((ret == 0) && (addSz != 0)) {
+        /* V = V + Hash(0x02 || V || additional input) */
+        in[0] = drbg->v;
+        inSz[0] = WC_SM3_DRBG_SEED_LEN;
+        in[1] = add;
+        inSz[1] = addSz;
+        ret = sm3_drbg_hash(&drbg->sm3, 0x02, 1, in, inSz, 2, hash);
+        if (ret == 0) {
+            sm3_drbg_add(drbg->v, hash, WC_SM3_DIGEST_SIZE);
+        }
+    }
+    if (ret == 0) {
+        sm3_drbg_hashgen(drbg, out, sz);
+
+        /* V = V + Hash(0x03 || V) + C + reseed counter */
+        in[0] = drbg->v;
+        inSz[0] = WC_SM3_DRBG_SEED_LEN;
+        ret = sm3_drbg_hash(&drbg->sm3, 0x03, 1, in, inSz, 1, hash);
+    }
+    if (ret == 0) {
+        ctr[0] = (byte)(drbg->reseedCtr >> 24);
+        ctr[1] = (byte)(drbg->reseedCtr >> 16);
+        ctr[2] = (byte)(drbg->reseedCtr >>  8);
+        ctr[3] = (byte)(drbg->reseedCtr      );
+        sm3_drbg_add(drbg->v, hash, WC_SM3_DIGEST_SIZE);
+        sm3_drbg_add(drbg->v, drbg->c, WC_SM3_DRBG_SEED_LEN);
+        sm3_drbg_add(drbg->v, ctr, sizeof(ctr));
+        drbg->reseedCtr++;
+    }
+
+    ForceZero(hash, sizeof(hash));
+    return ret;
+}
+
+/* Dispose of the SM3 Hash_DRBG.
+ *
+ * State is zeroized.
+ *
+ * @param [in, out] drbg  SM3 Hash_DRBG object.
+ */
+void wc_Sm3DrbgFree(wc_Sm3Drbg* drbg)
+{
+    if (drbg != NULL) {
+        ForceZero(drbg, sizeof(*drbg));
+    }
+}
+
+#ifdef WOLFSSL_SM3_DRBG_THREAD
+/* SM3 Hash_DRBG of this thread. */
+static THREAD_LS_T wc_Sm3Drbg sm3DrbgThread;
+/* Whether the SM3 Hash_DRBG of this thread has been instantiated. */
+static THREAD_LS_T byte sm3DrbgThreadInit = 0;
+
+/* Generate pseudo-random bytes with the SM3 Hash_DRBG of this thread.
+ *
+ * DRBG is instantiated with entropy from the OS on first use.
+ * wc_Sm3DrbgThreadFree() must be called before the thread exits.
+ * Signature matches CUSTOM_RAND_GENERATE_BLOCK so that the WC_RNG APIs, and
+ * therefore SM2 key generation and signing, can use it without locking.
+ *
+ * @param [out] out  Buffer to hold pseudo-random bytes.
+ * @param [in]  sz   Number of bytes to generate.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when out is NULL and sz is not zero.
+ */
+int wc_Sm3DrbgGenerateBlock(byte* out, word32 sz)
+{
+    int ret = 0;
+
+    /* Validate parameters. */
+    if ((out == NULL) && (sz != 0)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    if ((ret == 0) && (!sm3DrbgThreadInit)) {
+        ret = wc_Sm3DrbgInit(&sm3DrbgThread, NULL, 0, NULL, 0, NULL, 0);
+        if (ret == 0) {
+            sm3DrbgThreadInit = 1;
+        }
+    }
+    while ((ret == 0) && (sz > 0)) {
+        /* Generate at most the maximum request size at a time. */
+        word32 len = sz;
+        if (len > WC_SM3_DRBG_MAX_REQUEST) {
+            len = WC_SM3_DRBG_MAX_REQUEST;
+        }
+        ret = wc_Sm3DrbgGenerate(&sm3DrbgThread, out, len, NULL, 0);
+        out += len;
+        sz -= len;
+    }
+
+    return ret;
+}
+
+/* Dispose of the SM3 Hash_DRBG of this thread.
+ *
+ * Required before a thread that generated with wc_Sm3DrbgGenerateBlock()
+ * exits - thread local storage is not zeroized when a thread exits.
+ */
+void wc_Sm3DrbgThreadFree(void)
+{
+    if (sm3DrbgThreadInit) {
+        wc_Sm3DrbgFree(&sm3DrbgThread);
+        sm3DrbgThreadInit = 0;
+    }
+}
+#endif /* WOLFSSL_SM3_DRBG_THREAD */
+#endif /* WOLFSSL_SM3_DRBG */
+
 #ifdef WOLFSSL_HASH_FLAGS
 /* Set the flags of the SM3 hash object.
  *
@@ -27,6 +27,11 @@
 
 #ifdef WOLFSSL_SM3
 
+#if defined(WOLFSSL_SM3_DRBG_THREAD) && !defined(WOLFSSL_SM3_DRBG)
+    /* Thread local SM3 Hash_DRBG requires SM3 Hash_DRBG. */
+    #define WOLFSSL_SM3_DRBG
+#endif
+
 #ifdef __cplusplus
     extern "C" {
 #endif
@@ -70,14 +75,87 @@ typedef struct wc_Sm3   wc_Sm3;
 #define WC_SM3_TYPE_DEFINED
 #endif
 
+#if defined(WOLFSSL_SM_IOV) && !defined(WC_SM_IOV_TYPE_DEFINED)
+/* Buffer in a list of buffers for scatter/gather operations. */
+typedef struct wc_SmIov {
+    /* Data of buffer. Only read when input. */
+    byte* buf;
+    /* Length of buffer in bytes. */
+    word32 len;
+} wc_SmIov;
+#define WC_SM_IOV_TYPE_DEFINED
+#endif
+
+#ifdef WOLFSSL_SM3_DRBG
+enum {
+    /* Number of bytes in V and C - seed length of 440 bits. */
+    WC_SM3_DRBG_SEED_LEN     = 55,
+    /* Minimum number of bytes of entropy input. */
+    WC_SM3_DRBG_MIN_ENTROPY  = 32,
+    /* Number of bytes of nonce when seeding from the OS. */
+    WC_SM3_DRBG_NONCE_SZ     = 16,
+    /* Maximum number of bytes generated in one request. */
+    WC_SM3_DRBG_MAX_REQUEST  = 0x10000
+};
+
+#ifndef WC_SM3_DRBG_RESEED_INTERVAL
+    /* Default number of generate requests between reseeds. */
+    #define WC_SM3_DRBG_RESEED_INTERVAL     1000000
+#endif
+
+/* SM3 Hash_DRBG state.
+ *
+ * No locking is performed - use one per thread.
+ */
+typedef struct wc_Sm3Drbg {
+    /* SM3 hash object used when hashing. */
+    wc_Sm3 sm3;
+    /* Value V of working state. */
+    byte   v[WC_SM3_DRBG_SEED_LEN];
+    /* Constant C of working state. */
+    byte   c[WC_SM3_DRBG_SEED_LEN];
+    /* Number of generate requests since last seeding plus one. */
+    word32 reseedCtr;
+    /* Number of generate requests allowed between reseeds. */
+    word32 reseedInterval;
+    /* Reseed with entropy from the OS when the interval is reached. */
+    byte   autoReseed;
+} wc_Sm3Drbg;
+#endif
+
 
 WOLFSSL_API int wc_InitSm3(wc_Sm3* sm3, void* heap, int devId);
 WOLFSSL_API int wc_Sm3Update(wc_Sm3* sm3, const byte* data, word32 len);
+#ifdef WOLFSSL_SM_IOV
+WOLFSSL_API int wc_Sm3UpdateIov(wc_Sm3* sm3, const wc_SmIov* iov, word32 cnt);
+#endif
 WOLFSSL_API int wc_Sm3FinalRaw(wc_Sm3* sm3, byte* hash);
 WOLFSSL_API int wc_Sm3Final(wc_Sm3* sm3, byte* hash);
 WOLFSSL_API void wc_Sm3Free(wc_Sm3* sm3);
 WOLFSSL_API int wc_Sm3Copy(const wc_Sm3* src, wc_Sm3* dst);
 WOLFSSL_API int wc_Sm3GetHash(wc_Sm3* sm3, byte* hash);
+WOLFSSL_API int wc_Sm3KdfBlocks(wc_Sm3* sm3, word32 ct, byte* out,
+    word32 blocks);
+
+#ifdef WOLFSSL_SM3_DRBG
+WOLFSSL_API int wc_Sm3DrbgInit(wc_Sm3Drbg* drbg, const byte* entropy,
+    word32 entropySz, const byte* nonce, word32 nonceSz, const byte* pers,
+    word32 persSz);
+WOLFSSL_API int wc_Sm3DrbgReseed(wc_Sm3Drbg* drbg, const byte* entropy,
+    word32 entropySz, const byte* add, word32 addSz);
+WOLFSSL_API int wc_Sm3DrbgSetReseedInterval(wc_Sm3Drbg* drbg,
+    word32 interval);
+WOLFSSL_API int wc_Sm3DrbgGenerate(wc_Sm3Drbg* drbg, byte* out, word32 sz,
+    const byte* add, word32 addSz);
+WOLFSSL_API void wc_Sm3DrbgFree(wc_Sm3Drbg* drbg);
+#ifdef WOLFSSL_SM3_DRBG_THREAD
+/* Each thread that calls wc_Sm3DrbgGenerateBlock(), directly or through
+ * CUSTOM_RAND_GENERATE_BLOCK, must call wc_Sm3DrbgThreadFree() before it
+ * exits. Otherwise the DRBG state is left in the thread's memory. */
+WOLFSSL_API int wc_Sm3DrbgGenerateBlock(byte* out, word32 sz);
+WOLFSSL_API void wc_Sm3DrbgThreadFree(void);
+#endif
+#endif
 
 #ifdef WOLFSSL_HASH_FLAGS
 WOLFSSL_API int wc_Sm3SetFlags(wc_Sm3* sm3, word32 flags);
@@ -28,6 +28,9 @@
 #ifdef WOLFSSL_SM4
 
 #include <wolfssl/wolfcrypt/sm4.h>
+#if defined(WOLF_CRYPTO_CB) && defined(WOLFSSL_SM_BATCH_DEV)
+    #include <wolfssl/wolfcrypt/sm_batch.h>
+#endif
 
 #ifdef NO_INLINE
     #include <wolfssl/wolfcrypt/misc.h>
@@ -36,6 +39,79 @@
     #include <wolfcrypt/src/misc.c>
 #endif
 
+#if defined(__riscv) && (__riscv_xlen == 64) && \
+    defined(WOLFSSL_RISCV_SCALAR_CRYPTO_SM4)
+    /* Use RISC-V scalar crypto instructions sm4ed and sm4ks (Zksed). */
+    #define SM4_RISCV_ZKSED
+#endif
+#if defined(__riscv) && (__riscv_xlen == 64) && \
+    defined(WOLFSSL_RISCV_VECTOR_CRYPTO_SM4)
+    /* Use RISC-V vector crypto instructions vsm4k and vsm4r (Zvksed) when
+     * available at runtime. */
+    #define SM4_RISCV_ZVKSED
+
+    #ifdef __linux__
+        #include <sys/syscall.h>
+        #include <unistd.h>
+        #ifdef __NR_riscv_hwprobe
+            #include <asm/hwprobe.h>
+        #endif
+    #endif
+#endif
+#if defined(__aarch64__) && defined(WOLFSSL_ARMASM) && \
+    !defined(WOLFSSL_ARMASM_CRYPTO_SM4) && !defined(WOLFSSL_ARMASM_NO_NEON)
+    /* Use NEON table lookups to encrypt blocks in parallel when there are no
+     * SM4 instructions. */
+    #define SM4_ARM64_NEON
+#endif
+#if defined(__arm__) && defined(__ARM_NEON) && defined(WOLFSSL_ARMASM) && \
+    !defined(WOLFSSL_ARMASM_NO_NEON)
+    /* Use NEON table lookups to encrypt blocks in parallel. */
+    #define SM4_ARM32_NEON
+#endif
+#if defined(SM4_ARM64_NEON) || defined(SM4_ARM32_NEON)
+    #define SM4_ARM_NEON
+#endif
+#if !defined(SM4_RISCV_ZVKSED) && !defined(SM4_ARM_NEON) && \
+    !defined(SM4_RISCV_ZKSED) && \
+    (!defined(__aarch64__) || !defined(WOLFSSL_ARMASM_CRYPTO_SM4)) && \
+    defined(WC_64BIT_CPU) && !defined(WOLFSSL_SM4_SMALL) && \
+    defined(WOLFSSL_SM4_BITSLICE)
+    /* Use bitsliced C code to encrypt 64 blocks at a time without tables.
+     * Single blocks, chained modes and the key schedule use the tables. */
+    #define SM4_BITSLICE
+    #ifndef WOLFSSL_SM4_BITSLICE_MIN
+        /* Minimum number of blocks to encrypt 64 blocks at a time for.
+         * Tables are faster for fewer blocks. */
+        #define WOLFSSL_SM4_BITSLICE_MIN    64
+    #endif
+#endif
+#if defined(SM4_RISCV_ZVKSED) || defined(SM4_ARM_NEON) || \
+    defined(SM4_BITSLICE)
+    /* Multiple blocks encrypted at a time in ECB, CBC decrypt, CFB decrypt,
+     * CTR, GCM and CCM. */
+    #define SM4_PARALLEL
+#endif
+#if defined(WOLFSSL_SM4_GCM) && defined(WOLFSSL_SM4_GHASH) && \
+    defined(WOLFSSL_X86_64_BUILD) && defined(USE_INTEL_SPEEDUP) && \
+    defined(__GNUC__)
+    /* Use PCLMULQDQ instruction for GHASH when available at runtime. */
+    #define SM4_GHASH_PCLMUL
+
+    #include <wolfssl/wolfcrypt/cpuid.h>
+    #include <immintrin.h>
+#endif
+#if defined(WOLFSSL_SM4_GCM) && defined(WOLFSSL_SM4_GHASH) && \
+    defined(__aarch64__) && defined(WOLFSSL_ARMASM) && \
+    !defined(WOLFSSL_ARMASM_NO_HW_CRYPTO)
+    /* Use PMULL instruction for GHASH. */
+    #define SM4_GHASH_PMULL
+#endif
+#ifdef WOLFSSL_SM4_THREADS
+    #ifdef SINGLE_THREADED
+        #error "WOLFSSL_SM4_THREADS not supported with SINGLE_THREADED"
+    #endif
+#endif
 
 #ifdef LITTLE_ENDIAN_ORDER
 
@@ -114,7 +190,8 @@ static word32 sm4_fk[4] = {
 };
 
 
-#if !defined(__aarch64__) || !defined(WOLFSSL_ARMASM_CRYPTO_SM4)
+#if (!defined(__aarch64__) || !defined(WOLFSSL_ARMASM_CRYPTO_SM4)) && \
+    !defined(SM4_RISCV_ZKSED)
 
 /* S-box used in nonlinear transformation tau. */
 static byte sm4_sbox[256] = {
@@ -152,6 +229,19 @@ static byte sm4_sbox[256] = {
     0x79, 0xEE, 0x5F, 0x3E, 0xD7, 0xCB, 0x39, 0x48
 };
 
+/* Nonlinear transformation tau - S-box applied to each byte.
+ *
+ * @param [in] x  Unsigned 32-bit value to transform.
+ * @return  Unsigned 32-bit bit value.
+ */
+static WC_INLINE word32 sm4_tau(word32 x)
+{
+    return ((word32)sm4_sbox[(byte)(x >> 24)]) << 24 |
+           ((word32)sm4_sbox[(byte)(x >> 16)]) << 16 |
+           ((word32)sm4_sbox[(byte)(x >>  8)]) <<  8 |
+           ((word32)sm4_sbox[(byte)(x      )])       ;
+}
+
 #ifndef WOLFSSL_SM4_SMALL
 
 /* S-boxes used in nonlinear transformation tau.
@@ -367,10 +457,7 @@ static word32 sm4_t(word32 x)
     word32 t;
 
     /* Nonlinear transformation. */
-    t  = ((word32)sm4_sbox[(byte)(x >> 24)]) << 24;
-    t |= ((word32)sm4_sbox[(byte)(x >> 16)]) << 16;
-    t |= ((word32)sm4_sbox[(byte)(x >>  8)]) <<  8;
-    t |=          sm4_sbox[(byte) x       ]       ;
+    t = sm4_tau(x);
 
     /* Linear transformation. */
     return t ^ rotlFixed(t, 2) ^ rotlFixed(t, 10) ^ rotlFixed(t, 18) ^
@@ -379,7 +466,266 @@ static word32 sm4_t(word32 x)
 
 #endif
 
-#endif /* !__aarch64__ || !WOLFSSL_ARMASM_CRYPTO_SM4 */
+#ifdef SM4_BITSLICE
+/* SM4 S-box as a boolean circuit applied to 64 bitsliced values.
+ *
+ * 36 AND and 137 XOR/NOT operations.
+ *
+ * Generated using script: ruby scripts/sm4/bitslice.rb
+ *
+ * @param [in, out] s  Bits of byte, most significant first. S-box value on
+ *                    output.
+ */
+static void sm4_bs_sbox(word64* s)
+{
+    word64 t0, t1, t2, t3, t4, t5, t6, t7;
+    word64 t8, t9, t10, t11, t12, t13, t14, t15;
+    word64 t16, t17, t18, t19, t20, t21, t22, t23;
+    word64 t24, t25, t26, t27, t28;
+
+    t0 = s[7] ^ s[1];
+    t1 = s[6] ^ s[3];
+    t2 = ~s[5];
+    t3 = s[4] ^ s[2];
+    t4 = t1 ^ t0;
+    t5 = s[6] ^ t0;
+    t6 = s[3] ^ t0;
+    t0 = s[7] ^ t1;
+    t7 = t2 ^ t3;
+    t8 = t4 ^ s[0];
+    t9 = t4 ^ t7;
+    t10 = s[5] ^ s[2];
+    t11 = t10 ^ t5;
+    t10 = t3 ^ t8;
+    t12 = t2 ^ t5;
+    t13 = s[0] ^ t2;
+    t14 = ~s[2];
+    t15 = s[5] ^ t3;
+    t3 = t15 ^ t0;
+    t15 = s[5] ^ t6;
+    t16 = s[1] ^ s[0];
+    t17 = t16 ^ t7;
+    t7 = ~t8;
+    t8 = ~t6;
+    t18 = ~s[1];
+    t19 = s[2] ^ t1;
+    t1 = t2 ^ t0;
+    t0 = s[5] ^ t4;
+    t4 = s[2] ^ t6;
+    t6 = t9 & t11;
+    t11 = t10 & t12;
+    t12 = t13 & t14;
+    t14 = t3 & t15;
+    t15 = t17 & t2;
+    t2 = t7 & t8;
+    t8 = t18 & t19;
+    t19 = t1 & t5;
+    t5 = t0 & t4;
+    t4 = s[7] ^ s[5];
+    t20 = s[6] ^ t14;
+    t14 = s[3] ^ t15;
+    t15 = t4 ^ t20;
+    t21 = ~s[4];
+    t22 = t21 ^ t11;
+    t11 = s[2] ^ t14;
+    t21 = t16 ^ t12;
+    t12 = t6 ^ t14;
+    t16 = t22 ^ t2;
+    t23 = t15 ^ t8;
+    t24 = t11 ^ t19;
+    t11 = t2 ^ t5;
+    t25 = t24 ^ t11;
+    t26 = t4 ^ t12;
+    t27 = t26 ^ t16;
+    t26 = t23 ^ t24;
+    t24 = t20 ^ t21;
+    t28 = t24 ^ t12;
+    t12 = t23 ^ t11;
+    t11 = t15 ^ t21;
+    t15 = t11 ^ t16;
+    t11 = t25 & t27;
+    t16 = t26 & t28;
+    t23 = t12 & t15;
+    t15 = s[2] ^ t19;
+    t19 = t6 ^ t15;
+    t24 = t22 ^ t8;
+    t27 = t4 ^ t19;
+    t4 = t21 ^ t2;
+    t2 = t20 ^ t5;
+    t20 = t14 ^ t24;
+    t14 = t4 ^ t11;
+    t4 = t20 ^ t16;
+    t11 = t2 ^ t23;
+    t2 = t5 ^ t22;
+    t16 = t2 ^ t27;
+    t2 = t6 ^ t4;
+    t6 = t2 ^ t11;
+    t2 = t8 ^ t21;
+    t8 = t2 ^ t27;
+    t2 = t19 ^ t14;
+    t19 = t2 ^ t11;
+    t2 = t5 ^ t21;
+    t5 = t2 ^ t24;
+    t2 = t15 ^ t14;
+    t11 = t2 ^ t4;
+    t2 = t16 & t6;
+    t4 = t8 & t19;
+    t8 = t5 & t11;
+    t5 = t25 & t6;
+    t6 = t26 & t19;
+    t14 = t12 & t11;
+    t11 = ~s[3];
+    t12 = s[6] ^ s[2];
+    t15 = s[2] ^ s[0];
+    t16 = s[5] ^ t11;
+    t19 = s[4] ^ s[1];
+    t20 = t2 ^ t4;
+    t21 = t2 ^ t8;
+    t2 = t4 ^ t8;
+    t4 = t5 ^ t6;
+    t8 = t5 ^ t14;
+    t5 = t6 ^ t14;
+    t6 = s[4] ^ t11;
+    t14 = s[4] ^ t15;
+    t22 = t14 ^ t16;
+    t14 = s[5] ^ t15;
+    t23 = t12 ^ t19;
+    t24 = t15 ^ t19;
+    t15 = s[6] ^ s[0];
+    t19 = s[1] ^ t11;
+    t11 = t19 ^ t12;
+    t19 = t2 ^ t5;
+    t25 = s[1] ^ t16;
+    t16 = t20 ^ t4;
+    t26 = s[5] ^ t12;
+    t12 = t21 ^ t8;
+    t27 = t6 & t5;
+    t6 = t22 & t4;
+    t22 = t14 & t8;
+    t14 = t23 & t2;
+    t23 = t24 & t20;
+    t24 = t15 & t21;
+    t15 = t11 & t19;
+    t11 = t25 & t16;
+    t25 = t26 & t12;
+    t26 = t9 & t5;
+    t5 = t10 & t4;
+    t4 = t13 & t8;
+    t8 = t3 & t2;
+    t2 = t17 & t20;
+    t3 = t7 & t21;
+    t7 = t18 & t19;
+    t9 = t1 & t16;
+    t1 = t0 & t12;
+    t0 = ~t22;
+    t10 = t27 ^ t9;
+    t12 = t6 ^ t24;
+    t13 = t0 ^ t4;
+    t16 = t23 ^ t10;
+    t17 = t12 ^ t1;
+    t18 = t15 ^ t7;
+    t7 = t6 ^ t25;
+    t6 = t14 ^ t5;
+    t19 = t11 ^ t18;
+    t11 = t7 ^ t8;
+    t7 = t2 ^ t16;
+    t20 = t14 ^ t0;
+    t0 = t20 ^ t12;
+    t12 = t15 ^ t5;
+    t14 = t12 ^ t3;
+    t12 = t14 ^ t13;
+    t14 = t12 ^ t11;
+    t12 = t27 ^ t4;
+    t4 = t12 ^ t17;
+    t12 = t4 ^ t6;
+    t4 = t12 ^ t19;
+    t12 = t22 ^ t2;
+    t2 = t12 ^ t9;
+    t9 = t2 ^ t18;
+    t2 = t9 ^ t11;
+    t9 = ~t26;
+    t11 = t9 ^ t5;
+    t5 = t11 ^ t16;
+    t9 = t5 ^ t17;
+    t5 = t3 ^ t17;
+    t3 = t5 ^ t7;
+    t5 = t26 ^ t10;
+    t10 = t5 ^ t13;
+    t5 = t10 ^ t19;
+    t10 = t8 ^ t1;
+    t1 = t10 ^ t13;
+    t8 = t1 ^ t6;
+    t1 = t8 ^ t7;
+
+    s[0] = t1;
+    s[1] = t5;
+    s[2] = t3;
+    s[3] = t9;
+    s[4] = t2;
+    s[5] = t4;
+    s[6] = t14;
+    s[7] = t0;
+}
+#endif /* SM4_BITSLICE */
+
+#endif /* (!__aarch64__ || !WOLFSSL_ARMASM_CRYPTO_SM4) && !SM4_RISCV_ZKSED */
+
+#ifdef SM4_RISCV_ZKSED
+/* XOR into r the linear transformation of the S-box value of byte bs of x.
+ *
+ * @param [in, out] r   Unsigned 32-bit value to XOR into.
+ * @param [in]      x   Unsigned 32-bit value to transform.
+ * @param [in]      bs  Index of byte to transform.
+ */
+#define SM4ED(r, x, bs)                                      \
+    __asm__ ("sm4ed	%[res], %[res], %[val], " #bs "\n\t" \
+        : [res] "+r" (r)                                     \
+        : [val] "r" (x)                                      \
+    )
+
+/* XOR into r the key schedule linear transformation of the S-box value of
+ * byte bs of x.
+ *
+ * @param [in, out] r   Unsigned 32-bit value to XOR into.
+ * @param [in]      x   Unsigned 32-bit value to transform.
+ * @param [in]      bs  Index of byte to transform.
+ */
+#define SM4KS(r, x, bs)                                      \
+    __asm__ ("sm4ks	%[res], %[res], %[val], " #bs "\n\t" \
+        : [res] "+r" (r)                                     \
+        : [val] "r" (x)                                      \
+    )
+
+/* XOR into r the transformation T of x.
+ *
+ * @param [in, out] r  Unsigned 32-bit value to XOR into.
+ * @param [in]      x  Unsigned 32-bit value to transform.
+ */
+#define SM4_T_ZKSED(r, x)   \
+    do {                    \
+        word32 _x = (x);    \
+        SM4ED(r, _x, 0);    \
+        SM4ED(r, _x, 1);    \
+        SM4ED(r, _x, 2);    \
+        SM4ED(r, _x, 3);    \
+    }                       \
+    while (0)
+
+/* XOR into r the key schedule transformation T' of x.
+ *
+ * @param [in, out] r  Unsigned 32-bit value to XOR into.
+ * @param [in]      x  Unsigned 32-bit value to transform.
+ */
+#define SM4_T_KS_ZKSED(r, x)    \
+    do {                        \
+        word32 _x = (x);        \
+        SM4KS(r, _x, 0);        \
+        SM4KS(r, _x, 1);        \
+        SM4KS(r, _x, 2);        \
+        SM4KS(r, _x, 3);        \
+    }                           \
+    while (0)
+#endif /* SM4_RISCV_ZKSED */
 
 /* Key schedule calculation.
  *
@@ -388,7 +734,29 @@ static word32 sm4_t(word32 x)
  */
 static void sm4_key_schedule(const byte* key, word32* ks)
 {
-#if !defined(__aarch64__) || !defined(WOLFSSL_ARMASM_CRYPTO_SM4)
+#if defined(SM4_RISCV_ZKSED)
+    word32 k0, k1, k2, k3;
+    int i;
+
+    /* Load key into words. */
+    LOAD_U32_BE(key, k0, k1, k2, k3);
+    k0 ^= sm4_fk[0];
+    k1 ^= sm4_fk[1];
+    k2 ^= sm4_fk[2];
+    k3 ^= sm4_fk[3];
+
+    /* Calculate each word of key schedule - 4 at a time. */
+    for (i = 0; i < SM4_KEY_SCHEDULE; i += 4) {
+        SM4_T_KS_ZKSED(k0, k1 ^ k2 ^ k3 ^ sm4_ck[i + 0]);
+        SM4_T_KS_ZKSED(k1, k2 ^ k3 ^ k0 ^ sm4_ck[i + 1]);
+        SM4_T_KS_ZKSED(k2, k3 ^ k0 ^ k1 ^ sm4_ck[i + 2]);
+        SM4_T_KS_ZKSED(k3, k0 ^ k1 ^ k2 ^ sm4_ck[i + 3]);
+        ks[i + 0] = k0;
+        ks[i + 1] = k1;
+        ks[i + 2] = k2;
+        ks[i + 3] = k3;
+    }
+#elif !defined(__aarch64__) || !defined(WOLFSSL_ARMASM_CRYPTO_SM4)
 #ifndef WOLFSSL_SMALL_STACK
     word32 k[36];
     word32 t;
@@ -407,10 +775,7 @@ static void sm4_key_schedule(const byte* key, word32* ks)
         x = k[i + 1] ^ k[i + 2] ^ k[i + 3] ^ sm4_ck[i];
 
         /* Nonlinear operation tau */
-        t = ((word32)sm4_sbox[(byte)(x >> 24)]) << 24 |
-            ((word32)sm4_sbox[(byte)(x >> 16)]) << 16 |
-            ((word32)sm4_sbox[(byte)(x >>  8)]) <<  8 |
-            ((word32)sm4_sbox[(byte)(x      )])       ;
+        t = sm4_tau(x);
 
         /* Linear operation L' */
         k[i+4] = k[i] ^ (t ^ rotlFixed(t, 13) ^ rotlFixed(t, 23));
@@ -434,10 +799,7 @@ static void sm4_key_schedule(const byte* key, word32* ks)
         x = k[i + 1] ^ k[i + 2] ^ k[i + 3] ^ sm4_ck[i];
 
         /* Nonlinear operation tau */
-        t = ((word32)sm4_sbox[(byte)(x >> 24)]) << 24 |
-            ((word32)sm4_sbox[(byte)(x >> 16)]) << 16 |
-            ((word32)sm4_sbox[(byte)(x >>  8)]) <<  8 |
-            ((word32)sm4_sbox[(byte)(x      )])       ;
+        t = sm4_tau(x);
 
         /* Linear operation L' */
         k[i + 4] = k[i] ^ (t ^ rotlFixed(t, 13) ^ rotlFixed(t, 23));
@@ -448,10 +810,7 @@ static void sm4_key_schedule(const byte* key, word32* ks)
         x = ks[i - 3] ^ ks[i - 2] ^ ks[i - 1] ^ sm4_ck[i];
 
         /* Nonlinear operation tau */
-        t = ((word32)sm4_sbox[(byte)(x >> 24)]) << 24 |
-            ((word32)sm4_sbox[(byte)(x >> 16)]) << 16 |
-            ((word32)sm4_sbox[(byte)(x >>  8)]) <<  8 |
-            ((word32)sm4_sbox[(byte)(x      )])       ;
+        t = sm4_tau(x);
 
         /* Linear operation L' */
         ks[i] = ks[i - 4] ^ (t ^ rotlFixed(t, 13) ^ rotlFixed(t, 23));
@@ -509,6 +868,24 @@ static void sm4_key_schedule(const byte* key, word32* ks)
         x2 ^= sm4_t(x0 ^ x1 ^ x3 ^ ks[k2]); \
         x3 ^= sm4_t(x0 ^ x1 ^ x2 ^ ks[k3])
 
+#ifdef SM4_RISCV_ZKSED
+/* Round operation using RISC-V scalar crypto instructions.
+ *
+ * Assumes x0, x1, x2, x3 are the current state.
+ * Assumes ks is the key schedule.
+ *
+ * @param [in] k0  Index into key schedule for first word.
+ * @param [in] k1  Index into key schedule for second word.
+ * @param [in] k2  Index into key schedule for third word.
+ * @param [in] k3  Index into key schedule for fourth word.
+ */
+#define SM4_ROUNDS_ZKSED(k0, k1, k2, k3)            \
+        SM4_T_ZKSED(x0, x1 ^ x2 ^ x3 ^ ks[k0]);     \
+        SM4_T_ZKSED(x1, x0 ^ x2 ^ x3 ^ ks[k1]);     \
+        SM4_T_ZKSED(x2, x0 ^ x1 ^ x3 ^ ks[k2]);     \
+        SM4_T_ZKSED(x3, x0 ^ x1 ^ x2 ^ ks[k3])
+#endif
+
 /* Encrypt a block of data using SM4 algorithm.
  *
  * @param [in]  ks   Key schedule.
@@ -517,7 +894,24 @@ static void sm4_key_schedule(const byte* key, word32* ks)
  */
 static void sm4_encrypt(const word32* ks, const byte* in, byte* out)
 {
-#if !defined(__aarch64__) || !defined(WOLFSSL_ARMASM_CRYPTO_SM4)
+#if defined(SM4_RISCV_ZKSED)
+    word32 x0, x1, x2, x3;
+    /* Load block. */
+    LOAD_U32_BE(in, x0, x1, x2, x3);
+
+    /* Encrypt block. */
+    SM4_ROUNDS_ZKSED( 0,  1,  2,  3);
+    SM4_ROUNDS_ZKSED( 4,  5,  6,  7);
+    SM4_ROUNDS_ZKSED( 8,  9, 10, 11);
+    SM4_ROUNDS_ZKSED(12, 13, 14, 15);
+    SM4_ROUNDS_ZKSED(16, 17, 18, 19);
+    SM4_ROUNDS_ZKSED(20, 21, 22, 23);
+    SM4_ROUNDS_ZKSED(24, 25, 26, 27);
+    SM4_ROUNDS_ZKSED(28, 29, 30, 31);
+
+    /* Store encrypted block. */
+    STORE_U32_BE(x0, x1, x2, x3, out);
+#elif !defined(__aarch64__) || !defined(WOLFSSL_ARMASM_CRYPTO_SM4)
     word32 x0, x1, x2, x3;
     /* Load block. */
     LOAD_U32_BE(in, x0, x1, x2, x3);
@@ -576,7 +970,25 @@ static void sm4_encrypt(const word32* ks, const byte* in, byte* out)
  */
 static void sm4_decrypt(const word32* ks, const byte* in, byte* out)
 {
-#if !defined(__aarch64__) || !defined(WOLFSSL_ARMASM_CRYPTO_SM4)
+#if defined(SM4_RISCV_ZKSED)
+    word32 x0, x1, x2, x3;
+
+    /* Load block. */
+    LOAD_U32_BE(in, x0, x1, x2, x3);
+
+    /* Decrypt block. */
+    SM4_ROUNDS_ZKSED(31, 30, 29, 28);
+    SM4_ROUNDS_ZKSED(27, 26, 25, 24);
+    SM4_ROUNDS_ZKSED(23, 22, 21, 20);
+    SM4_ROUNDS_ZKSED(19, 18, 17, 16);
+    SM4_ROUNDS_ZKSED(15, 14, 13, 12);
+    SM4_ROUNDS_ZKSED(11, 10,  9,  8);
+    SM4_ROUNDS_ZKSED( 7,  6,  5,  4);
+    SM4_ROUNDS_ZKSED( 3,  2,  1,  0);
+
+    /* Store decrypted block. */
+    STORE_U32_BE(x0, x1, x2, x3, out);
+#elif !defined(__aarch64__) || !defined(WOLFSSL_ARMASM_CRYPTO_SM4)
     word32 x0, x1, x2, x3;
 
     /* Load block. */
@@ -629,497 +1041,1415 @@ static void sm4_decrypt(const word32* ks, const byte* in, byte* out)
 #endif
 
 
-/* Initialize the SM4 algorithm object.
- *
- * @param [in, out] sm4    SM4 algorithm object.
- * @param [in]      heap   Heap hint for dynamic memory allocation.
- * @param [in]      devId  Device identifier.
- * @return  0 on success.
- * @return  BAD_FUNC_ARG when sm4 is NULL.
+#ifdef SM4_RISCV_ZVKSED
+/* Vector crypto instructions are encoded so that assembler support is not
+ * required. Register numbers are passed as literals.
  */
-int wc_Sm4Init(wc_Sm4* sm4, void* heap, int devId)
-{
-    int ret = 0;
 
-    /* No device support yet. */
-    (void)devId;
-
-    /* Validate parameters. */
-    if (sm4 == NULL) {
-        ret = BAD_FUNC_ARG;
-    }
-
-    if (ret == 0) {
-        /* Set all fields to zero including bit fields. */
-        XMEMSET(sm4, 0, sizeof(*sm4));
-
-        /* Cache heap hint to use with any dynamic allocations. */
-        sm4->heap = heap;
-    }
-
-    return ret;
-}
+/* vrev8.v vd, vs2 - reverse bytes in each element (Zvkb). */
+#define VREV8_V(vd, vs2)                                                    \
+    ".word (0x12 << 26) | (1 << 25) | "                                     \
+    "((" #vs2 ") << 20) | (0x09 << 15) | "                                  \
+    "(0x2 << 12) | ((" #vd ") << 7) | 0x57\n\t"
+/* vsm4k.vi vd, vs2, rnd - four rounds of SM4 key schedule. */
+#define VSM4K_VI(vd, vs2, rnd)                                              \
+    ".word (0x21 << 26) | (1 << 25) | "                                     \
+    "((" #vs2 ") << 20) | ((" #rnd ") << 15) | "                            \
+    "(0x2 << 12) | ((" #vd ") << 7) | 0x77\n\t"
+/* vsm4r.vs vd, vs2 - four rounds of SM4 with round keys in vs2. */
+#define VSM4R_VS(vd, vs2)                                                   \
+    ".word (0x29 << 26) | (1 << 25) | "                                     \
+    "((" #vs2 ") << 20) | (0x10 << 15) | "                                  \
+    "(0x2 << 12) | ((" #vd ") << 7) | 0x77\n\t"
+
+#if defined(__linux__) && defined(__NR_riscv_hwprobe) && \
+    defined(RISCV_HWPROBE_EXT_ZVKSED)
+/* Extensions required: V, Zvkb (vrev8) and Zvksed. */
+#define SM4_ZVKSED_EXTS \
+    (RISCV_HWPROBE_IMA_V | RISCV_HWPROBE_EXT_ZVKB | RISCV_HWPROBE_EXT_ZVKSED)
+#endif
 
-/* Dispose of SM4 algorithm object.
+/* Check whether the CPU has the SM4 vector crypto instructions.
  *
- * Zeroize sensitive data in object.
+ * Uses the hwprobe system call on Linux. Otherwise, the instructions are
+ * assumed to be available as they were selected at compile time.
+ * The result is cached with atomic accesses as any thread may check first.
  *
- * @param [in, out] sm4  SM4 algorithm object.
+ * @return  1 when available.
+ * @return  0 otherwise.
  */
-void wc_Sm4Free(wc_Sm4* sm4)
+static int sm4_zvksed_avail(void)
 {
-    /* Check we have something to work with. */
-    if (sm4 != NULL) {
-        /* Must zeroize key schedule. */
-        ForceZero(sm4->ks, sizeof(sm4->ks));
-    #if defined(WOLFSSL_SM4_CTR)
-        /* For CBC, tmp is cipher text - no need to zeroize. */
-        /* For CTR, tmp is encrypted counter that must be zeroized. */
-        ForceZero(sm4->tmp, sizeof(sm4->tmp));
+    /* Negative until checked. */
+    static int avail = -1;
+    int ret = __atomic_load_n(&avail, __ATOMIC_RELAXED);
+
+    if (ret < 0) {
+    #ifdef SM4_ZVKSED_EXTS
+        struct riscv_hwprobe probe;
+
+        probe.key = RISCV_HWPROBE_KEY_IMA_EXT_0;
+        probe.value = 0;
+        ret = (syscall(__NR_riscv_hwprobe, &probe, 1, 0, NULL, 0) == 0) &&
+              ((probe.value & SM4_ZVKSED_EXTS) == SM4_ZVKSED_EXTS);
+    #else
+        ret = 1;
     #endif
+        /* Every thread calculates the same value. */
+        __atomic_store_n(&avail, ret, __ATOMIC_RELAXED);
     }
+
+    return ret;
 }
 
-/* Set the key.
+/* Key schedule calculation using vector crypto instructions.
  *
- * @param [in, out] sm4  SM4 algorithm object.
- * @param [in]      key  Array of bytes representing key.
+ * @param [in]  key  Array of bytes representing key.
+ * @param [out] ks   Array of unsigned 32-bit values that are the key schedule.
  */
-static void sm4_set_key(wc_Sm4* sm4, const byte* key)
+static void sm4_key_schedule_zvksed(const byte* key, word32* ks)
 {
-    /* Create key schedule. */
-    sm4_key_schedule(key, sm4->ks);
-    /* Mark key as having been set. */
-    sm4->keySet = 1;
+    __asm__ __volatile__ (
+        "li	t0, 16\n\t"
+        "vsetvli	zero, t0, e8, m1, ta, ma\n\t"
+        "vle8.v	v1, (%[key])\n\t"
+        "vsetivli	zero, 4, e32, m1, ta, ma\n\t"
+        "vle32.v	v2, (%[fk])\n\t"
+        VREV8_V(1, 1)
+        "vxor.vv	v1, v1, v2\n\t"
+
+        /* Four words of key schedule at a time. */
+        VSM4K_VI(1, 1, 0)
+        "vse32.v	v1, (%[ks])\n\t"
+        "addi	%[ks], %[ks], 16\n\t"
+        VSM4K_VI(1, 1, 1)
+        "vse32.v	v1, (%[ks])\n\t"
+        "addi	%[ks], %[ks], 16\n\t"
+        VSM4K_VI(1, 1, 2)
+        "vse32.v	v1, (%[ks])\n\t"
+        "addi	%[ks], %[ks], 16\n\t"
+        VSM4K_VI(1, 1, 3)
+        "vse32.v	v1, (%[ks])\n\t"
+        "addi	%[ks], %[ks], 16\n\t"
+        VSM4K_VI(1, 1, 4)
+        "vse32.v	v1, (%[ks])\n\t"
+        "addi	%[ks], %[ks], 16\n\t"
+        VSM4K_VI(1, 1, 5)
+        "vse32.v	v1, (%[ks])\n\t"
+        "addi	%[ks], %[ks], 16\n\t"
+        VSM4K_VI(1, 1, 6)
+        "vse32.v	v1, (%[ks])\n\t"
+        "addi	%[ks], %[ks], 16\n\t"
+        VSM4K_VI(1, 1, 7)
+        "vse32.v	v1, (%[ks])\n\t"
+        : [ks] "+r" (ks)
+        : [key] "r" (key), [fk] "r" (sm4_fk)
+        : "memory", "t0", "v1", "v2"
+    );
 }
 
 #if defined(WOLFSSL_SM4_ECB) || defined(WOLFSSL_SM4_CBC) || \
-    defined(WOLFSSL_SM4_CTR) || defined(WOLFSSL_SM4_CCM)
-/* Set the key.
+    defined(WOLFSSL_SM4_CTR) || defined(WOLFSSL_SM4_GCM) || \
+    defined(WOLFSSL_SM4_CCM) || defined(WOLFSSL_SM4_CMAC) || \
+    defined(WOLFSSL_SM4_CFB)
+/* Encrypt or decrypt blocks using vector crypto instructions.
  *
- * @param [in, out] sm4  SM4 algorithm object.
- * @param [in]      key  Array of bytes representing key.
- * @param [in]      len  Length of key. Must be SM4_KEY_SIZE.
- * @return  0 on success.
- * @return  BAD_FUNC_ARG when sm4 or key is NULL.
- * @return  BAD_FUNC_ARG when len is not SM4_KEY_SIZE.
+ * As many blocks as fit in a group of 4 vector registers are processed at a
+ * time - vector length agnostic.
+ *
+ * @param [in]  ks      Key schedule. Reversed for decryption.
+ * @param [in]  in      Blocks to encrypt/decrypt.
+ * @param [out] out     Encrypted/decrypted blocks.
+ * @param [in]  blocks  Number of blocks. Must not be 0.
  */
-int wc_Sm4SetKey(wc_Sm4* sm4, const byte* key, word32 len)
+static void sm4_blocks_zvksed(const word32* ks, const byte* in, byte* out,
+    word32 blocks)
 {
-    int ret = 0;
+    word32 words = blocks * 4;
+
+    __asm__ __volatile__ (
+        /* Load key schedule - 4 rounds per register. */
+        "vsetivli	zero, 4, e32, m1, ta, ma\n\t"
+        "mv	t1, %[ks]\n\t"
+        "vle32.v	v0, (t1)\n\t"
+        "addi	t1, t1, 16\n\t"
+        "vle32.v	v1, (t1)\n\t"
+        "addi	t1, t1, 16\n\t"
+        "vle32.v	v2, (t1)\n\t"
+        "addi	t1, t1, 16\n\t"
+        "vle32.v	v3, (t1)\n\t"
+        "addi	t1, t1, 16\n\t"
+        "vle32.v	v4, (t1)\n\t"
+        "addi	t1, t1, 16\n\t"
+        "vle32.v	v5, (t1)\n\t"
+        "addi	t1, t1, 16\n\t"
+        "vle32.v	v6, (t1)\n\t"
+        "addi	t1, t1, 16\n\t"
+        "vle32.v	v7, (t1)\n\t"
+    "1:\n\t"
+        /* Number of words to process - whole blocks only. */
+        "vsetvli	t0, %[words], e32, m4, ta, ma\n\t"
+        "andi	t0, t0, -4\n\t"
+        "slli	t1, t0, 2\n\t"
+        /* Load bytes as data may not be aligned. */
+        "vsetvli	zero, t1, e8, m4, ta, ma\n\t"
+        "vle8.v	v8, (%[in])\n\t"
+        "vsetvli	zero, t0, e32, m4, ta, ma\n\t"
+        VREV8_V(8, 8)
+        VSM4R_VS(8, 0)
+        VSM4R_VS(8, 1)
+        VSM4R_VS(8, 2)
+        VSM4R_VS(8, 3)
+        VSM4R_VS(8, 4)
+        VSM4R_VS(8, 5)
+        VSM4R_VS(8, 6)
+        VSM4R_VS(8, 7)
+        VREV8_V(8, 8)
+        /* Reverse order of words in each block. */
+        "vid.v	v12\n\t"
+        "vxor.vi	v12, v12, 3\n\t"
+        "vrgather.vv	v16, v8, v12\n\t"
+        "vsetvli	zero, t1, e8, m4, ta, ma\n\t"
+        "vse8.v	v16, (%[out])\n\t"
+        "add	%[in], %[in], t1\n\t"
+        "add	%[out], %[out], t1\n\t"
+        "sub	%[words], %[words], t0\n\t"
+        "bnez	%[words], 1b\n\t"
+        : [in] "+r" (in), [out] "+r" (out), [words] "+r" (words)
+        : [ks] "r" (ks)
+        : "memory", "t0", "t1", "v0", "v1", "v2", "v3", "v4", "v5", "v6",
+          "v7", "v8", "v9", "v10", "v11", "v12", "v13", "v14", "v15", "v16",
+          "v17", "v18", "v19"
+    );
+}
+#endif
 
-    /* Validate parameters. */
-    if ((sm4 == NULL) || (key == NULL) || (len != SM4_KEY_SIZE)) {
-        ret = BAD_FUNC_ARG;
-    }
+#endif /* SM4_RISCV_ZVKSED */
 
-    if (ret == 0) {
-        sm4_set_key(sm4, key);
-    }
+#if defined(SM4_ARM_NEON) && (defined(WOLFSSL_SM4_ECB) || \
+    defined(WOLFSSL_SM4_CBC) || defined(WOLFSSL_SM4_CTR) || \
+    defined(WOLFSSL_SM4_GCM) || defined(WOLFSSL_SM4_CCM) || \
+    defined(WOLFSSL_SM4_CMAC) || defined(WOLFSSL_SM4_CFB))
+/* Table lookup indices that rotate each 32-bit word left by 8 bits. */
+static const byte sm4_neon_rol8[16] = {
+    3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14
+};
 
-    return ret;
+#ifdef SM4_ARM64_NEON
+/* S-box lookup of each byte of a into r.
+ *
+ * S-box is in v16-v31. v15 has 64 in each byte.
+ * Lookups of out of range indices are 0 for TBL and unchanged for TBX.
+ *
+ * @param [out]     r  Vector register to hold S-box values.
+ * @param [in, out] a  Vector register holding indices. Modified.
+ */
+#define SM4_NEON_SBOX(r, a)                                     \
+        "tbl	" #r ".16b, {v16.16b-v19.16b}, " #a ".16b\n\t"    \
+        "sub	" #a ".16b, " #a ".16b, v15.16b\n\t"              \
+        "tbx	" #r ".16b, {v20.16b-v23.16b}, " #a ".16b\n\t"    \
+        "sub	" #a ".16b, " #a ".16b, v15.16b\n\t"              \
+        "tbx	" #r ".16b, {v24.16b-v27.16b}, " #a ".16b\n\t"    \
+        "sub	" #a ".16b, " #a ".16b, v15.16b\n\t"              \
+        "tbx	" #r ".16b, {v28.16b-v31.16b}, " #a ".16b\n\t"
+
+/* Linear transformation L of r XORed into x0.
+ *
+ * L(r) = r ^ (r <<< 2) ^ (r <<< 10) ^ (r <<< 18) ^ (r <<< 24)
+ *      = r ^ (r <<< 24) ^ ((r ^ (r <<< 8) ^ (r <<< 16)) <<< 2)
+ *
+ * v14 has table indices that rotate words left by 8 bits.
+ *
+ * @param [in, out] x0  Vector register to XOR into.
+ * @param [in, out] r   Vector register with S-box values. Modified.
+ * @param [in, out] a   Temporary vector register.
+ * @param [in, out] t   Temporary vector register.
+ */
+#define SM4_NEON_L(x0, r, a, t)                                 \
+        "tbl	" #t ".16b, {" #r ".16b}, v14.16b\n\t"            \
+        "rev32	" #a ".8h, " #r ".8h\n\t"                         \
+        "eor	" #t ".16b, " #t ".16b, " #a ".16b\n\t"           \
+        "eor	" #t ".16b, " #t ".16b, " #r ".16b\n\t"           \
+        "tbl	" #a ".16b, {" #a ".16b}, v14.16b\n\t"            \
+        "eor	" #r ".16b, " #r ".16b, " #a ".16b\n\t"           \
+        "shl	" #a ".4s, " #t ".4s, #2\n\t"                      \
+        "sri	" #a ".4s, " #t ".4s, #30\n\t"                     \
+        "eor	" #x0 ".16b, " #x0 ".16b, " #r ".16b\n\t"         \
+        "eor	" #x0 ".16b, " #x0 ".16b, " #a ".16b\n\t"
+
+/* One round of SM4 on four blocks - one word of each block in each register.
+ *
+ * X0 ^= T(X1 ^ X2 ^ X3 ^ rk)
+ *
+ * @param [in, out] x0  Vector register with word to update.
+ * @param [in]      x1  Vector register with next word.
+ * @param [in]      x2  Vector register with next word.
+ * @param [in]      x3  Vector register with next word.
+ */
+#define SM4_NEON_ROUND_4(x0, x1, x2, x3)                        \
+        "ld1r	{v10.4s}, [%[k]], #4\n\t"                          \
+        "eor	v9.16b, " #x1 ".16b, " #x2 ".16b\n\t"              \
+        "eor	v9.16b, v9.16b, " #x3 ".16b\n\t"                   \
+        "eor	v9.16b, v9.16b, v10.16b\n\t"                       \
+        SM4_NEON_SBOX(v8, v9)                                   \
+        SM4_NEON_L(x0, v8, v9, v10)
+
+/* One round of SM4 on eight blocks - two groups of four blocks.
+ *
+ * Instructions of the two groups are interleaved.
+ *
+ * @param [in, out] x0  Vector register with word to update of first group.
+ * @param [in]      x1  Vector register with next word of first group.
+ * @param [in]      x2  Vector register with next word of first group.
+ * @param [in]      x3  Vector register with next word of first group.
+ * @param [in, out] y0  Vector register with word to update of second group.
+ * @param [in]      y1  Vector register with next word of second group.
+ * @param [in]      y2  Vector register with next word of second group.
+ * @param [in]      y3  Vector register with next word of second group.
+ */
+#define SM4_NEON_ROUND_8(x0, x1, x2, x3, y0, y1, y2, y3)        \
+        "ld1r	{v10.4s}, [%[k]], #4\n\t"                          \
+        "eor	v9.16b, " #x1 ".16b, " #x2 ".16b\n\t"              \
+        "eor	v12.16b, " #y1 ".16b, " #y2 ".16b\n\t"             \
+        "eor	v9.16b, v9.16b, " #x3 ".16b\n\t"                   \
+        "eor	v12.16b, v12.16b, " #y3 ".16b\n\t"                 \
+        "eor	v9.16b, v9.16b, v10.16b\n\t"                       \
+        "eor	v12.16b, v12.16b, v10.16b\n\t"                     \
+        "tbl	v8.16b, {v16.16b-v19.16b}, v9.16b\n\t"            \
+        "tbl	v11.16b, {v16.16b-v19.16b}, v12.16b\n\t"          \
+        "sub	v9.16b, v9.16b, v15.16b\n\t"                       \
+        "sub	v12.16b, v12.16b, v15.16b\n\t"                     \
+        "tbx	v8.16b, {v20.16b-v23.16b}, v9.16b\n\t"            \
+        "tbx	v11.16b, {v20.16b-v23.16b}, v12.16b\n\t"          \
+        "sub	v9.16b, v9.16b, v15.16b\n\t"                       \
+        "sub	v12.16b, v12.16b, v15.16b\n\t"                     \
+        "tbx	v8.16b, {v24.16b-v27.16b}, v9.16b\n\t"            \
+        "tbx	v11.16b, {v24.16b-v27.16b}, v12.16b\n\t"          \
+        "sub	v9.16b, v9.16b, v15.16b\n\t"                       \
+        "sub	v12.16b, v12.16b, v15.16b\n\t"                     \
+        "tbx	v8.16b, {v28.16b-v31.16b}, v9.16b\n\t"            \
+        "tbx	v11.16b, {v28.16b-v31.16b}, v12.16b\n\t"          \
+        "tbl	v10.16b, {v8.16b}, v14.16b\n\t"                   \
+        "tbl	v13.16b, {v11.16b}, v14.16b\n\t"                  \
+        "rev32	v9.8h, v8.8h\n\t"                                 \
+        "rev32	v12.8h, v11.8h\n\t"                               \
+        "eor	v10.16b, v10.16b, v9.16b\n\t"                      \
+        "eor	v13.16b, v13.16b, v12.16b\n\t"                     \
+        "eor	v10.16b, v10.16b, v8.16b\n\t"                      \
+        "eor	v13.16b, v13.16b, v11.16b\n\t"                     \
+        "tbl	v9.16b, {v9.16b}, v14.16b\n\t"                    \
+        "tbl	v12.16b, {v12.16b}, v14.16b\n\t"                  \
+        "eor	v8.16b, v8.16b, v9.16b\n\t"                        \
+        "eor	v11.16b, v11.16b, v12.16b\n\t"                     \
+        "shl	v9.4s, v10.4s, #2\n\t"                             \
+        "shl	v12.4s, v13.4s, #2\n\t"                            \
+        "sri	v9.4s, v10.4s, #30\n\t"                            \
+        "sri	v12.4s, v13.4s, #30\n\t"                           \
+        "eor	" #x0 ".16b, " #x0 ".16b, v8.16b\n\t"              \
+        "eor	" #y0 ".16b, " #y0 ".16b, v11.16b\n\t"             \
+        "eor	" #x0 ".16b, " #x0 ".16b, v9.16b\n\t"              \
+        "eor	" #y0 ".16b, " #y0 ".16b, v12.16b\n\t"
+
+/* Load the S-box into v16-v31 and the constants into v14 and v15. */
+#define SM4_NEON_LOAD_SBOX                                      \
+        "mov	%[k], %[sbox]\n\t"                                 \
+        "ld1	{v16.16b-v19.16b}, [%[k]], #64\n\t"               \
+        "ld1	{v20.16b-v23.16b}, [%[k]], #64\n\t"               \
+        "ld1	{v24.16b-v27.16b}, [%[k]], #64\n\t"               \
+        "ld1	{v28.16b-v31.16b}, [%[k]]\n\t"                     \
+        "ld1	{v14.16b}, [%[rol8]]\n\t"                          \
+        "movi	v15.16b, #64\n\t"
+
+/* Encrypt or decrypt blocks, eight at a time, using NEON.
+ *
+ * Words of the blocks are de-interleaved so that each register holds the same
+ * word of four blocks.
+ *
+ * @param [in]  ks      Key schedule. Reversed for decryption.
+ * @param [in]  in      Blocks to encrypt/decrypt.
+ * @param [out] out     Encrypted/decrypted blocks.
+ * @param [in]  blocks  Number of blocks. Non-zero multiple of 8.
+ */
+static void sm4_blocks_neon_8(const word32* ks, const byte* in, byte* out,
+    word32 blocks)
+{
+    const word32* k;
+    word32 r;
+
+    __asm__ __volatile__ (
+        SM4_NEON_LOAD_SBOX
+    "1:\n\t"
+        "ld4	{v0.4s-v3.4s}, [%[in]], #64\n\t"
+        "ld4	{v4.4s-v7.4s}, [%[in]], #64\n\t"
+        "rev32	v0.16b, v0.16b\n\t"
+        "rev32	v1.16b, v1.16b\n\t"
+        "rev32	v2.16b, v2.16b\n\t"
+        "rev32	v3.16b, v3.16b\n\t"
+        "rev32	v4.16b, v4.16b\n\t"
+        "rev32	v5.16b, v5.16b\n\t"
+        "rev32	v6.16b, v6.16b\n\t"
+        "rev32	v7.16b, v7.16b\n\t"
+        "mov	%[k], %[ks]\n\t"
+        "mov	%w[r], #8\n\t"
+    "2:\n\t"
+        SM4_NEON_ROUND_8(v0, v1, v2, v3, v4, v5, v6, v7)
+        SM4_NEON_ROUND_8(v1, v2, v3, v0, v5, v6, v7, v4)
+        SM4_NEON_ROUND_8(v2, v3, v0, v1, v6, v7, v4, v5)
+        SM4_NEON_ROUND_8(v3, v0, v1, v2, v7, v4, v5, v6)
+        "subs	%w[r], %w[r], #1\n\t"
+        "b.ne	2b\n\t"
+        /* Output words in reverse order. */
+        "rev32	v8.16b, v0.16b\n\t"
+        "rev32	v11.16b, v4.16b\n\t"
+        "rev32	v0.16b, v3.16b\n\t"
+        "rev32	v4.16b, v7.16b\n\t"
+        "mov	v3.16b, v8.16b\n\t"
+        "mov	v7.16b, v11.16b\n\t"
+        "rev32	v8.16b, v1.16b\n\t"
+        "rev32	v11.16b, v5.16b\n\t"
+        "rev32	v1.16b, v2.16b\n\t"
+        "rev32	v5.16b, v6.16b\n\t"
+        "mov	v2.16b, v8.16b\n\t"
+        "mov	v6.16b, v11.16b\n\t"
+        "st4	{v0.4s-v3.4s}, [%[out]], #64\n\t"
+        "st4	{v4.4s-v7.4s}, [%[out]], #64\n\t"
+        "subs	%w[blocks], %w[blocks], #8\n\t"
+        "b.ne	1b\n\t"
+        : [in] "+r" (in), [out] "+r" (out), [blocks] "+r" (blocks),
+          [k] "=&r" (k), [r] "=&r" (r)
+        : [ks] "r" (ks), [sbox] "r" (sm4_sbox), [rol8] "r" (sm4_neon_rol8)
+        : "memory", "cc", "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7",
+          "v8", "v9", "v10", "v11", "v12", "v13", "v14", "v15", "v16", "v17",
+          "v18", "v19", "v20", "v21", "v22", "v23", "v24", "v25", "v26",
+          "v27", "v28", "v29", "v30", "v31"
+    );
 }
-#endif
 
-#if defined(WOLFSSL_SM4_CBC) || defined(WOLFSSL_SM4_CTR) || \
-    defined(WOLFSSL_SM4_GCM)
-/* Set the IV.
+/* Encrypt or decrypt blocks, four at a time, using NEON.
  *
- * @param [in, out] sm4  SM4 algorithm object.
- * @param [in]      iv   Array of bytes representing IV. May be NULL.
+ * @param [in]  ks      Key schedule. Reversed for decryption.
+ * @param [in]  in      Blocks to encrypt/decrypt.
+ * @param [out] out     Encrypted/decrypted blocks.
+ * @param [in]  blocks  Number of blocks. Non-zero multiple of 4.
  */
-static void sm4_set_iv(wc_Sm4* sm4, const byte* iv)
+static void sm4_blocks_neon_4(const word32* ks, const byte* in, byte* out,
+    word32 blocks)
 {
-    /* Set IV. */
-    XMEMCPY(sm4->iv, iv, SM4_IV_SIZE);
-#ifdef WOLFSSL_SM4_CTR
-    /* Unused count of encrypted counter for CTR mode. */
-    sm4->unused = 0;
-#endif
-    sm4->ivSet = 1;
+    const word32* k;
+    word32 r;
+
+    __asm__ __volatile__ (
+        SM4_NEON_LOAD_SBOX
+    "1:\n\t"
+        "ld4	{v0.4s-v3.4s}, [%[in]], #64\n\t"
+        "rev32	v0.16b, v0.16b\n\t"
+        "rev32	v1.16b, v1.16b\n\t"
+        "rev32	v2.16b, v2.16b\n\t"
+        "rev32	v3.16b, v3.16b\n\t"
+        "mov	%[k], %[ks]\n\t"
+        "mov	%w[r], #8\n\t"
+    "2:\n\t"
+        SM4_NEON_ROUND_4(v0, v1, v2, v3)
+        SM4_NEON_ROUND_4(v1, v2, v3, v0)
+        SM4_NEON_ROUND_4(v2, v3, v0, v1)
+        SM4_NEON_ROUND_4(v3, v0, v1, v2)
+        "subs	%w[r], %w[r], #1\n\t"
+        "b.ne	2b\n\t"
+        /* Output words in reverse order. */
+        "rev32	v8.16b, v0.16b\n\t"
+        "rev32	v0.16b, v3.16b\n\t"
+        "mov	v3.16b, v8.16b\n\t"
+        "rev32	v8.16b, v1.16b\n\t"
+        "rev32	v1.16b, v2.16b\n\t"
+        "mov	v2.16b, v8.16b\n\t"
+        "st4	{v0.4s-v3.4s}, [%[out]], #64\n\t"
+        "subs	%w[blocks], %w[blocks], #4\n\t"
+        "b.ne	1b\n\t"
+        : [in] "+r" (in), [out] "+r" (out), [blocks] "+r" (blocks),
+          [k] "=&r" (k), [r] "=&r" (r)
+        : [ks] "r" (ks), [sbox] "r" (sm4_sbox), [rol8] "r" (sm4_neon_rol8)
+        : "memory", "cc", "v0", "v1", "v2", "v3", "v8", "v9", "v10", "v14",
+          "v15", "v16", "v17", "v18", "v19", "v20", "v21", "v22", "v23",
+          "v24", "v25", "v26", "v27", "v28", "v29", "v30", "v31"
+    );
 }
-#endif
+#else
+/* S-box lookup of each byte of q4 into q5 with 32 bytes of S-box.
+ *
+ * q10 has 32 in each byte. Out of range indices leave q5 unchanged.
+ * Indices in q4 are reduced by 32 ready for next part of S-box.
+ */
+#define SM4_NEON32_SBOX_PART                                    \
+        "vld1.8	{d16-d19}, [%[t]]!\n\t"                            \
+        "vtbx.8	d10, {d16-d19}, d8\n\t"                            \
+        "vtbx.8	d11, {d16-d19}, d9\n\t"                            \
+        "vsub.i8	q4, q4, q10\n\t"
 
-#if defined(WOLFSSL_SM4_CBC) || defined(WOLFSSL_SM4_CTR)
-/* Set the IV.
+/* One round of SM4 on four blocks - one word of each block in each register.
  *
- * @param [in, out] sm4  SM4 algorithm object.
- * @param [in]      iv   Array of bytes representing IV. May be NULL.
- * @return  0 on success.
- * @return  BAD_FUNC_ARG when sm4 or iv is NULL.
+ * X0 ^= T(X1 ^ X2 ^ X3 ^ rk)
+ * T(x) = L(S(x)) where
+ * L(r) = r ^ (r <<< 24) ^ ((r ^ (r <<< 8) ^ (r <<< 16)) <<< 2)
+ *
+ * d22 has table indices that rotate words left by 8 bits.
+ *
+ * @param [in, out] x0  Vector register with word to update.
+ * @param [in]      x1  Vector register with next word.
+ * @param [in]      x2  Vector register with next word.
+ * @param [in]      x3  Vector register with next word.
  */
-int wc_Sm4SetIV(wc_Sm4* sm4, const byte* iv)
+#define SM4_NEON32_ROUND(x0, x1, x2, x3)                        \
+        "vld1.32	{d12[], d13[]}, [%[k]]!\n\t"                    \
+        "veor	q4, " #x1 ", " #x2 "\n\t"                          \
+        "veor	q4, q4, " #x3 "\n\t"                               \
+        "veor	q4, q4, q6\n\t"                                    \
+        /* S-box in eight parts of 32 bytes. */                 \
+        "mov	%[t], %[sbox]\n\t"                                 \
+        "vld1.8	{d16-d19}, [%[t]]!\n\t"                            \
+        "vtbl.8	d10, {d16-d19}, d8\n\t"                            \
+        "vtbl.8	d11, {d16-d19}, d9\n\t"                            \
+        "vsub.i8	q4, q4, q10\n\t"                                \
+        SM4_NEON32_SBOX_PART                                    \
+        SM4_NEON32_SBOX_PART                                    \
+        SM4_NEON32_SBOX_PART                                    \
+        SM4_NEON32_SBOX_PART                                    \
+        SM4_NEON32_SBOX_PART                                    \
+        SM4_NEON32_SBOX_PART                                    \
+        SM4_NEON32_SBOX_PART                                    \
+        /* Linear transformation. */                            \
+        "vtbl.8	d12, {d10}, d22\n\t"                               \
+        "vtbl.8	d13, {d11}, d22\n\t"                               \
+        "vrev32.16	q4, q5\n\t"                                     \
+        "veor	q6, q6, q4\n\t"                                    \
+        "veor	q6, q6, q5\n\t"                                    \
+        "vtbl.8	d14, {d8}, d22\n\t"                                \
+        "vtbl.8	d15, {d9}, d22\n\t"                                \
+        "veor	q5, q5, q7\n\t"                                    \
+        "vshl.i32	q4, q6, #2\n\t"                                 \
+        "vsri.32	q4, q6, #30\n\t"                                \
+        "veor	" #x0 ", " #x0 ", q5\n\t"                          \
+        "veor	" #x0 ", " #x0 ", q4\n\t"
+
+/* Encrypt or decrypt blocks, four at a time, using NEON.
+ *
+ * Words of the blocks are de-interleaved so that each register holds the same
+ * word of four blocks.
+ *
+ * @param [in]  ks      Key schedule. Reversed for decryption.
+ * @param [in]  in      Blocks to encrypt/decrypt.
+ * @param [out] out     Encrypted/decrypted blocks.
+ * @param [in]  blocks  Number of blocks. Non-zero multiple of 4.
+ */
+static void sm4_blocks_neon_4(const word32* ks, const byte* in, byte* out,
+    word32 blocks)
 {
-    int ret = 0;
-
-    /* Validate parameters. */
-    if ((sm4 == NULL) || (iv == NULL)) {
-        ret = BAD_FUNC_ARG;
-    }
-
-    if (ret == 0) {
-        sm4_set_iv(sm4, iv);
-    }
-
-    return ret;
+    const word32* k;
+    const byte* t;
+    word32 r;
+
+    __asm__ __volatile__ (
+        "vld1.8	{d22}, [%[rol8]]\n\t"
+        "vmov.i8	q10, #32\n\t"
+    "1:\n\t"
+        "vld4.32	{d0, d2, d4, d6}, [%[in]]!\n\t"
+        "vld4.32	{d1, d3, d5, d7}, [%[in]]!\n\t"
+        "vrev32.8	q0, q0\n\t"
+        "vrev32.8	q1, q1\n\t"
+        "vrev32.8	q2, q2\n\t"
+        "vrev32.8	q3, q3\n\t"
+        "mov	%[k], %[ks]\n\t"
+        "mov	%[r], #8\n\t"
+    "2:\n\t"
+        SM4_NEON32_ROUND(q0, q1, q2, q3)
+        SM4_NEON32_ROUND(q1, q2, q3, q0)
+        SM4_NEON32_ROUND(q2, q3, q0, q1)
+        SM4_NEON32_ROUND(q3, q0, q1, q2)
+        "subs	%[r], %[r], #1\n\t"
+        "bne	2b\n\t"
+        /* Output words in reverse order. */
+        "vrev32.8	q4, q0\n\t"
+        "vrev32.8	q0, q3\n\t"
+        "vmov	q3, q4\n\t"
+        "vrev32.8	q4, q1\n\t"
+        "vrev32.8	q1, q2\n\t"
+        "vmov	q2, q4\n\t"
+        "vst4.32	{d0, d2, d4, d6}, [%[out]]!\n\t"
+        "vst4.32	{d1, d3, d5, d7}, [%[out]]!\n\t"
+        "subs	%[blocks], %[blocks], #4\n\t"
+        "bne	1b\n\t"
+        : [in] "+r" (in), [out] "+r" (out), [blocks] "+r" (blocks),
+          [k] "=&r" (k), [t] "=&r" (t), [r] "=&r" (r)
+        : [ks] "r" (ks), [sbox] "r" (sm4_sbox), [rol8] "r" (sm4_neon_rol8)
+        : "memory", "cc", "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7",
+          "d8", "d9", "d10", "d11", "d12", "d13", "d14", "d15", "d16", "d17",
+          "d18", "d19", "d20", "d21", "d22"
+    );
 }
 #endif
 
-#ifdef WOLFSSL_SM4_ECB
-
-/* Encrypt bytes using SM4-ECB.
+/* Encrypt or decrypt blocks using NEON.
  *
- * Length of input must be a multiple of the block size.
- * Assumes out is at least sz bytes long.
+ * Table lookups of the S-box are independent of data so the timing is
+ * constant.
  *
- * @param [in]  sm4  SM4 algorithm object.
- * @param [out] out  Byte array in which to place encrypted data.
- * @param [in]  in   Array of bytes to encrypt.
- * @param [in]  sz   Number of bytes to encrypt.
- * @return  0 on success.
- * @return  BAD_FUNC_ARG when sm4, out or in is NULL.
- * @return  BAD_FUNC_ARG when sz is not a multiple of SM4_BLOCK_SIZE.
- * @return  MISSING_KEY when a key has not been set.
+ * @param [in]  ks      Key schedule. Reversed for decryption.
+ * @param [in]  in      Blocks to encrypt/decrypt.
+ * @param [out] out     Encrypted/decrypted blocks.
+ * @param [in]  blocks  Number of blocks. Must not be 0.
  */
-int wc_Sm4EcbEncrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz)
+static void sm4_blocks_neon(const word32* ks, const byte* in, byte* out,
+    word32 blocks)
 {
-    int ret = 0;
-
-    /* Validate parameters. */
-    if ((sm4 == NULL) || (in == NULL) || (out == NULL)) {
-        ret = BAD_FUNC_ARG;
+    word32 n;
+
+#ifdef SM4_ARM64_NEON
+    n = blocks & ~(word32)7;
+    if (n > 0) {
+        sm4_blocks_neon_8(ks, in, out, n);
+        in += n * SM4_BLOCK_SIZE;
+        out += n * SM4_BLOCK_SIZE;
+        blocks -= n;
     }
-    /* Can only work on multiples of block size of bytes. */
-    if ((ret == 0) && ((sz & (SM4_BLOCK_SIZE - 1)) != 0)) {
-        ret = BAD_FUNC_ARG;
+#endif
+    n = blocks & ~(word32)3;
+    if (n > 0) {
+        sm4_blocks_neon_4(ks, in, out, n);
+        in += n * SM4_BLOCK_SIZE;
+        out += n * SM4_BLOCK_SIZE;
+        blocks -= n;
     }
-
-    /* Ensure a key has been set. */
-    if ((ret == 0) && (!sm4->keySet)) {
-        ret = MISSING_KEY;
+    if (blocks > 0) {
+        ALIGN16 byte tmp[4 * SM4_BLOCK_SIZE];
+
+        /* Last blocks padded out to 4 blocks. */
+        XMEMSET(tmp, 0, sizeof(tmp));
+        XMEMCPY(tmp, in, blocks * SM4_BLOCK_SIZE);
+        sm4_blocks_neon_4(ks, tmp, tmp, 4);
+        XMEMCPY(out, tmp, blocks * SM4_BLOCK_SIZE);
+        ForceZero(tmp, sizeof(tmp));
     }
+}
+#endif /* SM4_ARM_NEON && (ECB || CBC || CTR || GCM || CCM || CMAC || CFB) */
 
-    if (ret == 0) {
-        /* Encrypt all bytes. */
-        while (sz > 0) {
-            /* Encrypt a block. */
-            sm4_encrypt(sm4->ks, in, out);
-            /* Move on to next block. */
-            in += SM4_BLOCK_SIZE;
-            out += SM4_BLOCK_SIZE;
-            sz -= SM4_BLOCK_SIZE;
+#ifdef SM4_BITSLICE
+/* Number of blocks encrypted at a time - one per bit of a 64-bit word. */
+#define SM4_BS_BLOCKS               64
+#endif
+
+#if defined(SM4_BITSLICE) && (defined(WOLFSSL_SM4_ECB) || \
+    defined(WOLFSSL_SM4_CBC) || defined(WOLFSSL_SM4_CTR) || \
+    defined(WOLFSSL_SM4_GCM) || defined(WOLFSSL_SM4_CCM) || \
+    defined(WOLFSSL_SM4_CMAC) || defined(WOLFSSL_SM4_CFB))
+/* Swap bits between rows j apart in a stage of transposing a bit matrix.
+ *
+ * @param [in, out] a  Rows of bit matrix.
+ * @param [in]      j  Distance between rows and bits to swap.
+ * @param [in]      m  Mask of bits to swap in first row.
+ */
+static WC_INLINE void sm4_bs_transpose_stage(word64* a, int j, word64 m)
+{
+    int k;
+    int l;
+
+    for (k = 0; k < 64; k += 2 * j) {
+        for (l = k; l < k + j; l++) {
+            word64 t = (a[l] ^ (a[l + j] >> j)) & m;
+            a[l] ^= t;
+            a[l + j] ^= t << j;
         }
     }
-
-    return ret;
 }
 
-/* Decrypt bytes using SM4-ECB.
+/* Transpose a 64x64 bit matrix in place.
  *
- * Length of input must be a multiple of the block size.
- * Assumes out is at least sz bytes long.
+ * Row i is a[i] with column 0 in the most significant bit.
  *
- * @param [in]  sm4  SM4 algorithm object.
- * @param [out] out  Byte array in which to place decrypted data.
- * @param [in]  in   Array of bytes to decrypt.
- * @param [in]  sz   Number of bytes to decrypt.
- * @return  0 on success.
- * @return  BAD_FUNC_ARG when sm4, out or in is NULL.
- * @return  BAD_FUNC_ARG when sz is not a multiple of SM4_BLOCK_SIZE.
- * @return  MISSING_KEY when a key has not been set.
+ * @param [in, out] a  Rows of bit matrix.
  */
-int wc_Sm4EcbDecrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz)
+static void sm4_bs_transpose(word64* a)
 {
+    /* Constant distance and mask for each stage allows better code. */
+    sm4_bs_transpose_stage(a, 32, W64LIT(0x00000000FFFFFFFF));
+    sm4_bs_transpose_stage(a, 16, W64LIT(0x0000FFFF0000FFFF));
+    sm4_bs_transpose_stage(a,  8, W64LIT(0x00FF00FF00FF00FF));
+    sm4_bs_transpose_stage(a,  4, W64LIT(0x0F0F0F0F0F0F0F0F));
+    sm4_bs_transpose_stage(a,  2, W64LIT(0x3333333333333333));
+    sm4_bs_transpose_stage(a,  1, W64LIT(0x5555555555555555));
+}
 
-    int ret = 0;
-
-    /* Validate parameters. */
-    if ((sm4 == NULL) || (in == NULL) || (out == NULL)) {
-        ret = BAD_FUNC_ARG;
+/* One round of SM4 on bitsliced words: X0 ^= T(X1 ^ X2 ^ X3 ^ rk)
+ *
+ * Each word is 32 slices, most significant bit first.
+ * T(x) = L(S(x)) where
+ * L(b) = b ^ (b <<< 2) ^ (b <<< 10) ^ (b <<< 18) ^ (b <<< 24)
+ * Rotating is indexing slices.
+ *
+ * @param [in, out] x0  Slices of word to update.
+ * @param [in]      x1  Slices of next word.
+ * @param [in]      x2  Slices of next word.
+ * @param [in]      x3  Slices of next word.
+ * @param [in]      rk  Slices of round key.
+ */
+static void sm4_bs_round(word64* x0, const word64* x1, const word64* x2,
+    const word64* x3, const word64* rk)
+{
+    word64 t[32];
+    int i;
+
+    for (i = 0; i < 32; i++) {
+        t[i] = x1[i] ^ x2[i] ^ x3[i] ^ rk[i];
     }
-    /* Can only work on multiples of block size of bytes. */
-    if ((ret == 0) && ((sz & (SM4_BLOCK_SIZE - 1)) != 0)) {
-        ret = BAD_FUNC_ARG;
+    /* S-box on each byte. */
+    sm4_bs_sbox(t +  0);
+    sm4_bs_sbox(t +  8);
+    sm4_bs_sbox(t + 16);
+    sm4_bs_sbox(t + 24);
+    for (i = 0; i < 32; i++) {
+        x0[i] ^= t[i] ^ t[(i + 2) & 31] ^ t[(i + 10) & 31] ^
+                 t[(i + 18) & 31] ^ t[(i + 24) & 31];
     }
+}
 
-    /* Ensure a key has been set. */
-    if ((ret == 0) && (!sm4->keySet)) {
-        ret = MISSING_KEY;
-    }
+/* Slice two round keys that are the same for all blocks.
+ *
+ * @param [in]  ks  Key schedule at round.
+ * @param [out] rk  Slices of two round keys.
+ */
+static void sm4_bs_rk(const word32* ks, word64* rk)
+{
+    int i;
 
-    if (ret == 0) {
-       /* Decrypt all bytes. */
-        while (sz > 0) {
-            /* Decrypt a block. */
-            sm4_decrypt(sm4->ks, in, out);
-            /* Move on to next block. */
-            in += SM4_BLOCK_SIZE;
-            out += SM4_BLOCK_SIZE;
-            sz -= SM4_BLOCK_SIZE;
-        }
+    for (i = 0; i < 32; i++) {
+        /* Round key bit as all zeros or all ones. */
+        rk[i]      = (word64)0 - (word64)((ks[0] >> (31 - i)) & 1);
+        rk[32 + i] = (word64)0 - (word64)((ks[1] >> (31 - i)) & 1);
     }
-
-    return ret;
 }
 
-#endif /* WOLFSSL_SM4_ECB */
+/* Slice two round keys from the key schedule of each block.
+ *
+ * @param [in]  mks     Key schedule of each block.
+ * @param [in]  r       Round.
+ * @param [in]  blocks  Number of blocks. Must be no more than SM4_BS_BLOCKS.
+ * @param [out] rk      Slices of two round keys.
+ */
+static void sm4_bs_rk_mk(const word32* const* mks, int r, word32 blocks,
+    word64* rk)
+{
+    word32 i;
 
-#ifdef WOLFSSL_SM4_CBC
+    for (i = 0; i < blocks; i++) {
+        rk[i] = ((word64)mks[i][r] << 32) | mks[i][r + 1];
+    }
+    for (; i < SM4_BS_BLOCKS; i++) {
+        rk[i] = 0;
+    }
+    /* Slices of first round key at rk, second at rk + 32. */
+    sm4_bs_transpose(rk);
+}
 
-/* Encrypt bytes using SM4-CBC.
+/* Encrypt or decrypt up to 64 blocks with bitsliced implementation.
  *
- * Length of input must be a multiple of the block size.
- * Assumes out is at least sz bytes long.
+ * Only operations whose timing doesn't depend on the data are used.
  *
- * @param [in]  sm4  SM4 algorithm object.
- * @param [out] out  Byte array in which to place encrypted data.
- * @param [in]  in   Array of bytes to encrypt.
- * @param [in]  sz   Number of bytes to encrypt.
- * @return  0 on success.
- * @return  BAD_FUNC_ARG when sm4, out or in is NULL.
- * @return  BAD_FUNC_ARG when sz is not a multiple of SM4_BLOCK_SIZE.
- * @return  MISSING_KEY when a key has not been set.
- * @return  MISSING_IV when an IV has not been set.
+ * @param [in]  ks      Key schedule. Reversed for decryption.
+ * @param [in]  mks     Key schedule of each block. NULL when ks used for all
+ *                      blocks.
+ * @param [in]  in      Blocks to encrypt/decrypt.
+ * @param [out] out     Encrypted/decrypted blocks.
+ * @param [in]  blocks  Number of blocks. Must be no more than SM4_BS_BLOCKS.
  */
-int wc_Sm4CbcEncrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz)
+static void sm4_blocks_bs_64(const word32* ks, const word32* const* mks,
+    const byte* in, byte* out, word32 blocks)
 {
-    int ret = 0;
+    /* First 64: words 0 and 1 of each block, last 64: words 2 and 3. */
+    word64 x[2 * SM4_BS_BLOCKS];
+    /* Slices of two round keys. */
+    word64 rk[SM4_BS_BLOCKS];
+    word32 i;
 
-    /* Validate parameters. */
-    if ((sm4 == NULL) || (in == NULL) || (out == NULL)) {
-        ret = BAD_FUNC_ARG;
+    for (i = 0; i < blocks; i++) {
+        word32 w0, w1, w2, w3;
+
+        LOAD_U32_BE(in + i * SM4_BLOCK_SIZE, w0, w1, w2, w3);
+        x[i] = ((word64)w0 << 32) | w1;
+        x[SM4_BS_BLOCKS + i] = ((word64)w2 << 32) | w3;
     }
-    /* Can only work on multiples of block size of bytes. */
-    if ((ret == 0) && ((sz & (SM4_BLOCK_SIZE - 1)) != 0)) {
-        ret = BAD_FUNC_ARG;
+    for (; i < SM4_BS_BLOCKS; i++) {
+        x[i] = 0;
+        x[SM4_BS_BLOCKS + i] = 0;
     }
+    /* Slices of word 0, 1, 2 and 3 are at: x, x + 32, x + 64, x + 96. */
+    sm4_bs_transpose(x);
+    sm4_bs_transpose(x + SM4_BS_BLOCKS);
 
-    /* Ensure a key and IV have been set. */
-    if ((ret == 0) && (!sm4->keySet)) {
-        ret = MISSING_KEY;
-    }
-    if ((ret == 0) && (!sm4->ivSet)) {
-        ret = MISSING_IV;
+    for (i = 0; i < SM4_KEY_SCHEDULE; i += 2) {
+        if (mks == NULL) {
+            sm4_bs_rk(ks + i, rk);
+        }
+        else {
+            sm4_bs_rk_mk(mks, (int)i, blocks, rk);
+        }
+        if ((i & 2) == 0) {
+            sm4_bs_round(x +  0, x + 32, x + 64, x + 96, rk);
+            sm4_bs_round(x + 32, x + 64, x + 96, x +  0, rk + 32);
+        }
+        else {
+            sm4_bs_round(x + 64, x + 96, x +  0, x + 32, rk);
+            sm4_bs_round(x + 96, x +  0, x + 32, x + 64, rk + 32);
+        }
     }
 
-    if (ret == 0) {
-        /* Encrypt all bytes. */
-        while (sz > 0) {
-            /* XOR next block into IV. */
-            xorbuf(sm4->iv, in, SM4_BLOCK_SIZE);
-            /* Encrypt IV XORed with block. */
-            sm4_encrypt(sm4->ks, sm4->iv, sm4->iv);
-            /* Use output block as next IV. */
-            XMEMCPY(out, sm4->iv, SM4_BLOCK_SIZE);
+    sm4_bs_transpose(x);
+    sm4_bs_transpose(x + SM4_BS_BLOCKS);
+    /* Store puts words in reverse order. */
+    for (i = 0; i < blocks; i++) {
+        word32 w0 = (word32)(x[i] >> 32);
+        word32 w1 = (word32)x[i];
+        word32 w2 = (word32)(x[SM4_BS_BLOCKS + i] >> 32);
+        word32 w3 = (word32)x[SM4_BS_BLOCKS + i];
 
-            /* Move on to next block. */
-            in += SM4_BLOCK_SIZE;
-            out += SM4_BLOCK_SIZE;
-            sz -= SM4_BLOCK_SIZE;
-        }
+        STORE_U32_BE(w0, w1, w2, w3, out + i * SM4_BLOCK_SIZE);
     }
 
-    return ret;
+    ForceZero(x, sizeof(x));
+    ForceZero(rk, sizeof(rk));
 }
 
-/* Decrypt bytes using SM4-CBC.
+/* Encrypt or decrypt blocks with bitsliced implementation.
  *
- * Length of input must be a multiple of the block size.
- * Assumes out is at least sz bytes long.
+ * Runs of fewer than WOLFSSL_SM4_BITSLICE_MIN blocks are done one at a time
+ * with the tables as the bitsliced code always does the work of 64 blocks.
  *
- * @param [in]  sm4  SM4 algorithm object.
- * @param [out] out  Byte array in which to place decrypted data.
- * @param [in]  in   Array of bytes to decrypt.
- * @param [in]  sz   Number of bytes to decrypt.
- * @return  0 on success.
- * @return  BAD_FUNC_ARG when sm4, out or in is NULL.
- * @return  MISSING_KEY when a key has not been set.
- * @return  MISSING_IV when an IV has not been set.
+ * @param [in]  ks      Key schedule. Reversed for decryption.
+ * @param [in]  in      Blocks to encrypt/decrypt.
+ * @param [out] out     Encrypted/decrypted blocks.
+ * @param [in]  blocks  Number of blocks. Must not be 0.
  */
-int wc_Sm4CbcDecrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz)
+static void sm4_blocks_bs(const word32* ks, const byte* in, byte* out,
+    word32 blocks)
 {
-    int ret = 0;
+    while (blocks >= WOLFSSL_SM4_BITSLICE_MIN) {
+        word32 n = min(blocks, SM4_BS_BLOCKS);
 
-    /* Validate parameters. */
-    if ((sm4 == NULL) || (in == NULL) || (out == NULL)) {
-        ret = BAD_FUNC_ARG;
+        sm4_blocks_bs_64(ks, NULL, in, out, n);
+        in += n * SM4_BLOCK_SIZE;
+        out += n * SM4_BLOCK_SIZE;
+        blocks -= n;
     }
-    /* Can only work on multiples of block size of bytes. */
-    if ((ret == 0) && ((sz & (SM4_BLOCK_SIZE - 1)) != 0)) {
-        ret = BAD_FUNC_ARG;
+    for (; blocks > 0; blocks--) {
+        sm4_encrypt(ks, in, out);
+        in += SM4_BLOCK_SIZE;
+        out += SM4_BLOCK_SIZE;
     }
+}
+#endif /* SM4_BITSLICE && (ECB || CBC || CTR || GCM || CCM || CMAC || CFB) */
 
-    /* Ensure a key and IV have been set. */
-    if ((ret == 0) && (!sm4->keySet)) {
-        ret = MISSING_KEY;
-    }
-    if ((ret == 0) && (!sm4->ivSet)) {
-        ret = MISSING_IV;
+#ifdef SM4_PARALLEL
+/* Number of blocks of counters or data to prepare before encrypting. */
+#ifdef SM4_BITSLICE
+    #define SM4_PAR_BLOCKS          SM4_BS_BLOCKS
+#else
+    #define SM4_PAR_BLOCKS          16
+#endif
+
+/* Check whether blocks can be encrypted in parallel.
+ *
+ * @return  1 when available.
+ * @return  0 otherwise.
+ */
+static WC_INLINE int sm4_par_avail(void)
+{
+#ifdef SM4_RISCV_ZVKSED
+    return sm4_zvksed_avail();
+#else
+    return 1;
+#endif
+}
+
+#if defined(WOLFSSL_SM4_ECB) || defined(WOLFSSL_SM4_CBC) || \
+    defined(WOLFSSL_SM4_CTR) || defined(WOLFSSL_SM4_GCM) || \
+    defined(WOLFSSL_SM4_CCM) || defined(WOLFSSL_SM4_CMAC) || \
+    defined(WOLFSSL_SM4_CFB)
+/* Encrypt or decrypt blocks in parallel.
+ *
+ * @param [in]  ks      Key schedule. Reversed for decryption.
+ * @param [in]  in      Blocks to encrypt/decrypt.
+ * @param [out] out     Encrypted/decrypted blocks.
+ * @param [in]  blocks  Number of blocks. Must not be 0.
+ */
+static WC_INLINE void sm4_blocks(const word32* ks, const byte* in, byte* out,
+    word32 blocks)
+{
+#if defined(SM4_RISCV_ZVKSED)
+    sm4_blocks_zvksed(ks, in, out, blocks);
+#elif defined(SM4_ARM_NEON)
+    sm4_blocks_neon(ks, in, out, blocks);
+#else
+    sm4_blocks_bs(ks, in, out, blocks);
+#endif
+}
+#endif
+
+#if defined(WOLFSSL_SM4_ECB) || defined(WOLFSSL_SM4_CBC)
+/* Reverse the key schedule for decryption.
+ *
+ * Decryption is encryption with the round keys in reverse order.
+ *
+ * @param [in]  ks     Key schedule.
+ * @param [out] ksDec  Reversed key schedule.
+ */
+static void sm4_key_schedule_dec(const word32* ks, word32* ksDec)
+{
+    int i;
+
+    for (i = 0; i < SM4_KEY_SCHEDULE; i++) {
+        ksDec[i] = ks[SM4_KEY_SCHEDULE - 1 - i];
     }
+}
+#endif
+#endif /* SM4_PARALLEL */
 
-    if (ret == 0) {
-    #ifndef WOLFSSL_SM4_SMALL
-        if (in != out) {
-            while (sz > 0) {
-                /* Decrypt next block. */
-                sm4_decrypt(sm4->ks, in, sm4->tmp);
-                /* XOR decrypted block with IV to create output. */
-                xorbufout(out, sm4->tmp, sm4->iv, SM4_BLOCK_SIZE);
-                /* This encrypted block is the IV for next decryption. */
-                XMEMCPY(sm4->iv, in, SM4_BLOCK_SIZE);
+#if defined(WOLFSSL_SM4_ECB) || defined(WOLFSSL_SM4_GCM) || \
+    defined(WOLFSSL_SM4_CMAC)
+/* Number of blocks, each with its own key, to prepare before encrypting. */
+#ifdef SM4_PARALLEL
+    #define SM4_MK_BLOCKS           SM4_PAR_BLOCKS
+#else
+    #define SM4_MK_BLOCKS           16
+#endif
 
-                /* Move on to next block. */
-                in += SM4_BLOCK_SIZE;
-                out += SM4_BLOCK_SIZE;
-                sz -= SM4_BLOCK_SIZE;
-            }
+/* Encrypt blocks that each have their own key schedule.
+ *
+ * With the bitsliced implementation, at least WOLFSSL_SM4_BITSLICE_MIN blocks
+ * of different keys are encrypted together. Otherwise, consecutive blocks with
+ * the same key schedule are encrypted together.
+ *
+ * @param [in]  mks     Key schedule of each block.
+ * @param [in]  in      Blocks to encrypt.
+ * @param [out] out     Encrypted blocks.
+ * @param [in]  blocks  Number of blocks. Must be no more than SM4_MK_BLOCKS.
+ */
+static void sm4_blocks_mk(const word32* const* mks, const byte* in, byte* out,
+    word32 blocks)
+{
+#ifdef SM4_BITSLICE
+    if (blocks >= WOLFSSL_SM4_BITSLICE_MIN) {
+        sm4_blocks_bs_64(NULL, mks, in, out, blocks);
+        blocks = 0;
+    }
+#endif
+    while (blocks > 0) {
+        word32 n = 1;
+
+        /* Count blocks using the same key schedule. */
+        while ((n < blocks) && (mks[n] == mks[0])) {
+            n++;
+        }
+    #ifdef SM4_PARALLEL
+        if (sm4_par_avail()) {
+            sm4_blocks(mks[0], in, out, n);
         }
         else
     #endif
         {
-            while (sz > 0) {
-                /* Cache encrypted block as it is next IV. */
-                XMEMCPY(sm4->tmp, in, SM4_BLOCK_SIZE);
-                /* Decrypt next block. */
-                sm4_decrypt(sm4->ks, sm4->tmp, out);
-                /* XOR decrypted block with IV to create output. */
-                xorbuf(out, sm4->iv, SM4_BLOCK_SIZE);
-                /* Cached encrypted block is next IV. */
-                XMEMCPY(sm4->iv, sm4->tmp, SM4_BLOCK_SIZE);
+            word32 i;
 
-                /* Move on to next block. */
-                in += SM4_BLOCK_SIZE;
-                out += SM4_BLOCK_SIZE;
-                sz -= SM4_BLOCK_SIZE;
+            for (i = 0; i < n; i++) {
+                sm4_encrypt(mks[0], in + i * SM4_BLOCK_SIZE,
+                    out + i * SM4_BLOCK_SIZE);
             }
         }
+        mks += n;
+        in += n * SM4_BLOCK_SIZE;
+        out += n * SM4_BLOCK_SIZE;
+        blocks -= n;
     }
+}
+#endif /* WOLFSSL_SM4_ECB || WOLFSSL_SM4_GCM || WOLFSSL_SM4_CMAC */
+
+#if defined(WOLFSSL_SM4_SHARED_KEY_ONLY)
+    /* Key data is always shared. */
+    #define SM4_KS(sm4)     ((sm4)->key->ks)
+    #define SM4_GCM(sm4)    (&(sm4)->key->gcm)
+    #define SM4_HPOW(sm4)   ((sm4)->key->hPow)
+#elif defined(WOLFSSL_SM4_SHARED_KEY)
+    /* Key data is shared or in object. */
+    #define SM4_KS(sm4)     \
+        (((sm4)->key != NULL) ? (sm4)->key->ks : (sm4)->ks)
+    #define SM4_GCM(sm4)    \
+        (((sm4)->key != NULL) ? &(sm4)->key->gcm : &(sm4)->gcm)
+    #define SM4_HPOW(sm4)   \
+        (((sm4)->key != NULL) ? (sm4)->key->hPow : (sm4)->hPow)
+#else
+    /* Key data is in object. */
+    #define SM4_KS(sm4)     ((sm4)->ks)
+    #define SM4_GCM(sm4)    (&(sm4)->gcm)
+    #define SM4_HPOW(sm4)   ((sm4)->hPow)
+#endif
 
-    return ret;
+/* Create the key schedule.
+ *
+ * @param [in]  key  Array of bytes representing key.
+ * @param [out] ks   Key schedule.
+ */
+static void sm4_expand_key(const byte* key, word32* ks)
+{
+#ifdef SM4_RISCV_ZVKSED
+    if (sm4_zvksed_avail()) {
+        /* Create key schedule with vector crypto instructions. */
+        sm4_key_schedule_zvksed(key, ks);
+    }
+    else
+#endif
+    {
+        /* Create key schedule. */
+        sm4_key_schedule(key, ks);
+    }
 }
 
-#endif /* WOLFSSL_SM4_CBC */
+#if defined(WOLFSSL_SM4_GCM) && defined(WOLFSSL_SM4_GHASH)
+/* GHASH implementation for SM4-GCM.
+ *
+ * Powers of the hash key, H^1..H^SM4_GHASH_POWERS, are stored so that up to
+ * SM4_GHASH_POWERS blocks are multiplied and added before one reduction:
+ *   Y' = (Y ^ X_1).H^n ^ X_2.H^(n-1) ^ ... ^ X_n.H
+ *
+ * Each power is stored as SM4_GHASH_POWER_WORDS 64-bit words:
+ *   0: last 8 bytes as big-endian number (lo)
+ *   1: first 8 bytes as big-endian number (hi)
+ *   2: hi with bits reversed
+ *   3: lo with bits reversed
+ *   4: lo ^ hi - for Karatsuba multiplication
+ *   5: word 2 ^ word 3 - for Karatsuba multiplication
+ * Words 0 and 1 are the byte reversed power as used with PCLMULQDQ.
+ * Words 2 and 3 are the bit reversed power as used with PMULL.
+ */
 
-#ifdef WOLFSSL_SM4_CTR
+/* Multiply two 64-bit numbers without carry - lower 64 bits of product.
+ *
+ * Bits are spread out so that integer multiplication carries don't reach the
+ * bits kept. Only operations whose timing doesn't depend on the data are used.
+ *
+ * @param [in] x  First number.
+ * @param [in] y  Second number.
+ * @return  Lower 64 bits of carry-less product.
+ */
+static WC_INLINE word64 sm4_ghash_bmul64(word64 x, word64 y)
+{
+    word64 x0 = x & W64LIT(0x1111111111111111);
+    word64 x1 = x & W64LIT(0x2222222222222222);
+    word64 x2 = x & W64LIT(0x4444444444444444);
+    word64 x3 = x & W64LIT(0x8888888888888888);
+    word64 y0 = y & W64LIT(0x1111111111111111);
+    word64 y1 = y & W64LIT(0x2222222222222222);
+    word64 y2 = y & W64LIT(0x4444444444444444);
+    word64 y3 = y & W64LIT(0x8888888888888888);
+    word64 z0 = (x0 * y0) ^ (x1 * y3) ^ (x2 * y2) ^ (x3 * y1);
+    word64 z1 = (x0 * y1) ^ (x1 * y0) ^ (x2 * y3) ^ (x3 * y2);
+    word64 z2 = (x0 * y2) ^ (x1 * y1) ^ (x2 * y0) ^ (x3 * y3);
+    word64 z3 = (x0 * y3) ^ (x1 * y2) ^ (x2 * y1) ^ (x3 * y0);
+
+    return (z0 & W64LIT(0x1111111111111111)) |
+           (z1 & W64LIT(0x2222222222222222)) |
+           (z2 & W64LIT(0x4444444444444444)) |
+           (z3 & W64LIT(0x8888888888888888));
+}
 
-/* Increment IV in big-endian representation.
+/* Reverse the bits of a 64-bit number.
  *
- * @param [in, out] counter  Counter value to increment.
+ * @param [in] x  Number to reverse.
+ * @return  Number with bits reversed.
  */
-static WC_INLINE void sm4_increment_counter(byte* counter)
+static WC_INLINE word64 sm4_ghash_rev64(word64 x)
 {
-    int i;
+    x = ((x >> 1) & W64LIT(0x5555555555555555)) |
+        ((x & W64LIT(0x5555555555555555)) << 1);
+    x = ((x >> 2) & W64LIT(0x3333333333333333)) |
+        ((x & W64LIT(0x3333333333333333)) << 2);
+    x = ((x >> 4) & W64LIT(0x0F0F0F0F0F0F0F0F)) |
+        ((x & W64LIT(0x0F0F0F0F0F0F0F0F)) << 4);
+    return ByteReverseWord64(x);
+}
 
-    /* Big-endian number. */
-    for (i = SM4_BLOCK_SIZE - 1; i >= 0; i--) {
-        /* Increment byte and check for carry. */
-        if ((++counter[i]) != 0) {
-            /* No carry - done. */
-            break;
+/* Hash blocks into the GHASH state using C code.
+ *
+ * Upper half of each 128-bit carry-less product is calculated with bit
+ * reversed numbers.
+ *
+ * @param [in]      hPow    Powers of hash key.
+ * @param [in, out] s       GHASH state.
+ * @param [in]      data    Blocks of data.
+ * @param [in]      blocks  Number of blocks.
+ */
+static void sm4_ghash_blocks_c(const word64* hPow, byte* s, const byte* data,
+    word32 blocks)
+{
+    word32 w0, w1, w2, w3;
+    word64 y0, y1;
+
+    LOAD_U32_BE(s, w0, w1, w2, w3);
+    y1 = ((word64)w0 << 32) | w1;
+    y0 = ((word64)w2 << 32) | w3;
+
+    while (blocks > 0) {
+        word32 n = min(blocks, SM4_GHASH_POWERS);
+        word64 z0 = 0, z1 = 0, z2 = 0;
+        word64 z0h = 0, z1h = 0, z2h = 0;
+        word64 v0, v1, v2, v3;
+        word32 i;
+
+        for (i = 0; i < n; i++) {
+            /* First block is multiplied by highest power of H. */
+            const word64* h = hPow + (n - 1 - i) * SM4_GHASH_POWER_WORDS;
+            word64 x0, x1, x0r, x1r;
+
+            LOAD_U32_BE(data, w0, w1, w2, w3);
+            x1 = ((word64)w0 << 32) | w1;
+            x0 = ((word64)w2 << 32) | w3;
+            if (i == 0) {
+                /* Add state to first block. */
+                x0 ^= y0;
+                x1 ^= y1;
+            }
+            x0r = sm4_ghash_rev64(x0);
+            x1r = sm4_ghash_rev64(x1);
+
+            /* Karatsuba multiplication - sum of products kept unreduced. */
+            z0  ^= sm4_ghash_bmul64(x0, h[0]);
+            z1  ^= sm4_ghash_bmul64(x1, h[1]);
+            z2  ^= sm4_ghash_bmul64(x0 ^ x1, h[4]);
+            z0h ^= sm4_ghash_bmul64(x0r, h[3]);
+            z1h ^= sm4_ghash_bmul64(x1r, h[2]);
+            z2h ^= sm4_ghash_bmul64(x0r ^ x1r, h[5]);
+
+            data += SM4_BLOCK_SIZE;
         }
+
+        z2 ^= z0 ^ z1;
+        z2h ^= z0h ^ z1h;
+        z0h = sm4_ghash_rev64(z0h) >> 1;
+        z1h = sm4_ghash_rev64(z1h) >> 1;
+        z2h = sm4_ghash_rev64(z2h) >> 1;
+
+        /* 256-bit product of bit reflected numbers. */
+        v0 = z0;
+        v1 = z0h ^ z2;
+        v2 = z1 ^ z2h;
+        v3 = z1h;
+        /* Shift left by one to align reflected product. */
+        v3 = (v3 << 1) | (v2 >> 63);
+        v2 = (v2 << 1) | (v1 >> 63);
+        v1 = (v1 << 1) | (v0 >> 63);
+        v0 = (v0 << 1);
+        /* Reduce by polynomial: x^128 + x^7 + x^2 + x + 1. */
+        v2 ^= v0 ^ (v0 >> 1) ^ (v0 >> 2) ^ (v0 >> 7);
+        v1 ^= (v0 << 63) ^ (v0 << 62) ^ (v0 << 57);
+        v3 ^= v1 ^ (v1 >> 1) ^ (v1 >> 2) ^ (v1 >> 7);
+        v2 ^= (v1 << 63) ^ (v1 << 62) ^ (v1 << 57);
+        y0 = v2;
+        y1 = v3;
+
+        blocks -= n;
     }
+
+    /* Words are stored last to first. */
+    w3 = (word32)(y1 >> 32);
+    w2 = (word32)y1;
+    w1 = (word32)(y0 >> 32);
+    w0 = (word32)y0;
+    STORE_U32_BE(w0, w1, w2, w3, s);
 }
 
-/* Encrypt bytes using SM4-CTR.
+#ifdef SM4_GHASH_PCLMUL
+/* Check whether the CPU has the PCLMULQDQ instruction.
  *
- * Assumes out is at least sz bytes long.
+ * All CPUs with AES-NI have PCLMULQDQ.
  *
- * @param [in]  sm4  SM4 algorithm object.
- * @param [out] out  Byte array in which to place encrypted data.
- * @param [in]  in   Array of bytes to encrypt.
- * @param [in]  sz   Number of bytes to encrypt.
- * @return  0 on success.
- * @return  BAD_FUNC_ARG when sm4, out or in is NULL.
- * @return  MISSING_KEY when a key has not been set.
- * @return  MISSING_IV when an IV has not been set.
+ * @return  1 when available.
+ * @return  0 otherwise.
  */
-int wc_Sm4CtrEncrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz)
+static int sm4_pclmul_avail(void)
 {
-    int ret = 0;
+    /* Negative until checked. */
+    static int avail = -1;
 
-    /* Validate parameters. */
-    if ((sm4 == NULL) || (in == NULL) || (out == NULL)) {
-        ret = BAD_FUNC_ARG;
+    if (avail < 0) {
+        avail = (IS_INTEL_AESNI(cpuid_get_flags()) != 0);
     }
 
-    /* Ensure a key and IV have been set. */
-    if ((ret == 0) && (!sm4->keySet)) {
-        ret = MISSING_KEY;
-    }
-    if ((ret == 0) && (!sm4->ivSet)) {
-        ret = MISSING_IV;
-    }
+    return avail;
+}
 
-    /* Continue if no error and bytes to encrypt. */
-    if ((ret == 0) && (sz > 0)) {
-        /* Check for unused bytes from previous encrypted counter. */
-        if (sm4->unused != 0) {
-            /* Calculate maximum length that can be encrypted. */
-            word32 len = min(sm4->unused, sz);
+/* Hash blocks into the GHASH state using PCLMULQDQ.
+ *
+ * Blocks are byte reversed so that carry-less products are of bit reflected
+ * numbers.
+ *
+ * @param [in]      hPow    Powers of hash key.
+ * @param [in, out] s       GHASH state.
+ * @param [in]      data    Blocks of data.
+ * @param [in]      blocks  Number of blocks.
+ */
+static __attribute__((target("pclmul,ssse3"))) void sm4_ghash_blocks_pclmul(
+    const word64* hPow, byte* s, const byte* data, word32 blocks)
+{
+    const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+        12, 13, 14, 15);
+    __m128i y = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)s), bswap);
+
+    while (blocks > 0) {
+        word32 n = min(blocks, SM4_GHASH_POWERS);
+        __m128i lo = _mm_setzero_si128();
+        __m128i hi = _mm_setzero_si128();
+        __m128i mid = _mm_setzero_si128();
+        __m128i t;
+        word32 i;
+
+        for (i = 0; i < n; i++) {
+            /* First block is multiplied by highest power of H. */
+            const word64* h = hPow + (n - 1 - i) * SM4_GHASH_POWER_WORDS;
+            __m128i hk = _mm_loadu_si128((const __m128i*)h);
+            __m128i hm = _mm_loadl_epi64((const __m128i*)(h + 4));
+            __m128i x = _mm_shuffle_epi8(
+                _mm_loadu_si128((const __m128i*)data), bswap);
+
+            if (i == 0) {
+                /* Add state to first block. */
+                x = _mm_xor_si128(x, y);
+            }
+            /* Karatsuba multiplication - sum of products kept unreduced. */
+            lo = _mm_xor_si128(lo, _mm_clmulepi64_si128(x, hk, 0x00));
+            hi = _mm_xor_si128(hi, _mm_clmulepi64_si128(x, hk, 0x11));
+            x = _mm_xor_si128(x, _mm_srli_si128(x, 8));
+            mid = _mm_xor_si128(mid, _mm_clmulepi64_si128(x, hm, 0x00));
 
-            /* XOR the encrypted counter with input into output. */
-            xorbufout(out, in, sm4->tmp + SM4_BLOCK_SIZE - sm4->unused, len);
-
-            /* Move over processed data. */
-            in += len;
-            out += len;
-            sz -= len;
-            /* Some or all unused bytes used up. */
-            sm4->unused -= (byte)len;
+            data += SM4_BLOCK_SIZE;
         }
 
-        /* Do blocks at a time - only get here when there are no unused bytes.
-         */
-        while (sz >= SM4_BLOCK_SIZE) {
-            /* Encrypt the current IV into temporary buffer in object. */
-            sm4_encrypt(sm4->ks, sm4->iv, sm4->tmp);
-            /* XOR the encrypted IV with next block into output. */
-            xorbufout(out, in, sm4->tmp, SM4_BLOCK_SIZE);
-            /* Increment counter for next block. */
-            sm4_increment_counter(sm4->iv);
+        mid = _mm_xor_si128(mid, _mm_xor_si128(lo, hi));
+        lo = _mm_xor_si128(lo, _mm_slli_si128(mid, 8));
+        hi = _mm_xor_si128(hi, _mm_srli_si128(mid, 8));
+
+        /* Shift left by one to align reflected product. */
+        t = _mm_srli_epi64(lo, 63);
+        mid = _mm_srli_epi64(hi, 63);
+        lo = _mm_slli_epi64(lo, 1);
+        hi = _mm_slli_epi64(hi, 1);
+        lo = _mm_or_si128(lo, _mm_slli_si128(t, 8));
+        hi = _mm_or_si128(hi, _mm_srli_si128(t, 8));
+        hi = _mm_or_si128(hi, _mm_slli_si128(mid, 8));
+
+        /* Reduce by polynomial: x^128 + x^7 + x^2 + x + 1. */
+        t = _mm_xor_si128(_mm_slli_epi64(lo, 63), _mm_slli_epi64(lo, 62));
+        t = _mm_xor_si128(t, _mm_slli_epi64(lo, 57));
+        lo = _mm_xor_si128(lo, _mm_slli_si128(t, 8));
+        t = _mm_xor_si128(_mm_slli_epi64(lo, 63), _mm_slli_epi64(lo, 62));
+        t = _mm_xor_si128(t, _mm_slli_epi64(lo, 57));
+        hi = _mm_xor_si128(hi, _mm_srli_si128(t, 8));
+        t = _mm_xor_si128(_mm_srli_epi64(lo, 1), _mm_srli_epi64(lo, 2));
+        t = _mm_xor_si128(t, _mm_srli_epi64(lo, 7));
+        y = _mm_xor_si128(hi, _mm_xor_si128(lo, t));
+
+        blocks -= n;
+    }
 
-            /* Move on to next block. */
-            in += SM4_BLOCK_SIZE;
-            out += SM4_BLOCK_SIZE;
-            sz -= SM4_BLOCK_SIZE;
-        }
+    _mm_storeu_si128((__m128i*)s, _mm_shuffle_epi8(y, bswap));
+}
+#endif /* SM4_GHASH_PCLMUL */
 
-        /* Check for less than a block of data that needing to be encrypted. */
-        if (sz > 0) {
-            /* Encrypt the current IV into temporary buffer in object. */
-            sm4_encrypt(sm4->ks, sm4->iv, sm4->tmp);
-            /* Increment counter for next block. */
-            sm4_increment_counter(sm4->iv);
-            /* XOR the encrypted IV with remaining data into output. */
-            xorbufout(out, in, sm4->tmp, sz);
-            /* Record number of unused encrypted IV bytes. */
-            sm4->unused = (byte)(SM4_BLOCK_SIZE - sz);
-        }
+#ifdef SM4_GHASH_PMULL
+/* Hash blocks into the GHASH state using PMULL.
+ *
+ * Bits of blocks are reversed so that carry-less products don't need to be
+ * shifted.
+ *
+ * @param [in]      hPow    Powers of hash key.
+ * @param [in, out] s       GHASH state.
+ * @param [in]      data    Blocks of data.
+ * @param [in]      blocks  Number of blocks.
+ */
+static void sm4_ghash_blocks_pmull(const word64* hPow, byte* s,
+    const byte* data, word32 blocks)
+{
+    while (blocks > 0) {
+        word32 n = min(blocks, SM4_GHASH_POWERS);
+        /* First block is multiplied by highest power of H. */
+        const word64* h = hPow + (n - 1) * SM4_GHASH_POWER_WORDS;
+        word32 cnt = n;
+
+        __asm__ __volatile__ (
+            "LD1	{v0.16b}, [%[s]]\n\t"
+            "RBIT	v0.16b, v0.16b\n\t"
+            "MOVI	v16.16b, #0\n\t"
+            "MOVI	v17.16b, #0\n\t"
+            "MOVI	v18.16b, #0\n\t"
+            "MOVI	v19.16b, #0\n\t"
+        "1:\n\t"
+            "LD1	{v1.16b}, [%[data]], #16\n\t"
+            "LD1	{v2.2d-v4.2d}, [%[h]]\n\t"
+            "SUB	%[h], %[h], #48\n\t"
+            "RBIT	v1.16b, v1.16b\n\t"
+            /* Add state to first block. */
+            "EOR	v1.16b, v1.16b, v0.16b\n\t"
+            "MOVI	v0.16b, #0\n\t"
+            /* Karatsuba multiplication - sum of products kept unreduced. */
+            "EXT	v5.16b, v1.16b, v1.16b, #8\n\t"
+            "PMULL	v6.1q, v1.1d, v3.1d\n\t"
+            "PMULL2	v7.1q, v1.2d, v3.2d\n\t"
+            "EOR	v5.16b, v5.16b, v1.16b\n\t"
+            "EOR	v16.16b, v16.16b, v6.16b\n\t"
+            "PMULL2	v6.1q, v5.2d, v4.2d\n\t"
+            "EOR	v17.16b, v17.16b, v7.16b\n\t"
+            "EOR	v18.16b, v18.16b, v6.16b\n\t"
+            "SUBS	%w[cnt], %w[cnt], #1\n\t"
+            "B.NE	1b\n\t"
+
+            "EOR	v18.16b, v18.16b, v16.16b\n\t"
+            "EOR	v18.16b, v18.16b, v17.16b\n\t"
+            "EXT	v5.16b, v19.16b, v18.16b, #8\n\t"
+            "EXT	v6.16b, v18.16b, v19.16b, #8\n\t"
+            "EOR	v16.16b, v16.16b, v5.16b\n\t"
+            "EOR	v17.16b, v17.16b, v6.16b\n\t"
+
+            /* Reduce by polynomial: x^128 + x^7 + x^2 + x + 1. */
+            "MOVI	v20.16b, #0x87\n\t"
+            "USHR	v20.2d, v20.2d, #56\n\t"
+            "PMULL2	v5.1q, v17.2d, v20.2d\n\t"
+            "EXT	v6.16b, v19.16b, v5.16b, #8\n\t"
+            "EXT	v7.16b, v5.16b, v19.16b, #8\n\t"
+            "EOR	v16.16b, v16.16b, v6.16b\n\t"
+            "EOR	v17.16b, v17.16b, v7.16b\n\t"
+            "PMULL	v5.1q, v17.1d, v20.1d\n\t"
+            "EOR	v0.16b, v16.16b, v5.16b\n\t"
+            "RBIT	v0.16b, v0.16b\n\t"
+            "ST1	{v0.16b}, [%[s]]\n\t"
+            : [data] "+r" (data), [h] "+r" (h), [cnt] "+r" (cnt)
+            : [s] "r" (s)
+            : "memory", "cc", "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7",
+              "v16", "v17", "v18", "v19", "v20"
+        );
+
+        blocks -= n;
     }
+}
+#endif /* SM4_GHASH_PMULL */
 
-    return ret;
+/* Hash blocks into the GHASH state.
+ *
+ * @param [in]      hPow    Powers of hash key.
+ * @param [in, out] s       GHASH state.
+ * @param [in]      data    Blocks of data.
+ * @param [in]      blocks  Number of blocks.
+ */
+static WC_INLINE void sm4_ghash_blocks(const word64* hPow, byte* s,
+    const byte* data, word32 blocks)
+{
+#if defined(SM4_GHASH_PMULL)
+    sm4_ghash_blocks_pmull(hPow, s, data, blocks);
+#else
+    #ifdef SM4_GHASH_PCLMUL
+    if (sm4_pclmul_avail()) {
+        sm4_ghash_blocks_pclmul(hPow, s, data, blocks);
+    }
+    else
+    #endif
+    {
+        sm4_ghash_blocks_c(hPow, s, data, blocks);
+    }
+#endif
 }
 
-#endif /* WOLFSSL_SM4_CTR */
+/* Hash data into the GHASH state with last partial block padded with zeros.
+ *
+ * @param [in]      hPow  Powers of hash key.
+ * @param [in, out] s     GHASH state.
+ * @param [in]      data  Data to hash. May be NULL when sz is 0.
+ * @param [in]      sz    Number of bytes to hash.
+ */
+static void sm4_ghash_update(const word64* hPow, byte* s, const byte* data,
+    word32 sz)
+{
+    word32 blocks = sz / SM4_BLOCK_SIZE;
+    word32 partial = sz % SM4_BLOCK_SIZE;
 
-#ifdef WOLFSSL_SM4_GCM
+    if (blocks > 0) {
+        sm4_ghash_blocks(hPow, s, data, blocks);
+        data += blocks * SM4_BLOCK_SIZE;
+    }
+    if (partial > 0) {
+        ALIGN16 byte b[SM4_BLOCK_SIZE];
+
+        XMEMCPY(b, data, partial);
+        XMEMSET(b + partial, 0, SM4_BLOCK_SIZE - partial);
+        sm4_ghash_blocks(hPow, s, b, 1);
+    }
+}
+
+/* Set a power of the hash key into the table.
+ *
+ * @param [out] h  Words of power of hash key.
+ * @param [in]  p  Power of hash key as bytes.
+ */
+static void sm4_ghash_set_power(word64* h, const byte* p)
+{
+    word32 w0, w1, w2, w3;
+
+    LOAD_U32_BE(p, w0, w1, w2, w3);
+    h[1] = ((word64)w0 << 32) | w1;
+    h[0] = ((word64)w2 << 32) | w3;
+    h[2] = sm4_ghash_rev64(h[1]);
+    h[3] = sm4_ghash_rev64(h[0]);
+    h[4] = h[0] ^ h[1];
+    h[5] = h[2] ^ h[3];
+}
+
+/* Calculate the value of H for the GMAC operation and its powers.
+ *
+ * @param [in]  ks    Key schedule.
+ * @param [out] hPow  Powers of hash key.
+ * @param [in]  iv    Initial IV.
+ */
+static void sm4_gcm_calc_h(const word32* ks, word64* hPow, byte* iv)
+{
+    ALIGN16 byte h[SM4_BLOCK_SIZE];
+    ALIGN16 byte p[SM4_BLOCK_SIZE];
+    int i;
+
+    /* Encrypt all zeros IV to create hash key for GCM. */
+    sm4_encrypt(ks, iv, h);
+    sm4_ghash_set_power(hPow, h);
+    XMEMCPY(p, h, SM4_BLOCK_SIZE);
+    for (i = 1; i < SM4_GHASH_POWERS; i++) {
+        /* H^(i+1) = (0 ^ H^i) * H */
+        XMEMSET(h, 0, SM4_BLOCK_SIZE);
+        sm4_ghash_blocks_c(hPow, h, p, 1);
+        sm4_ghash_set_power(hPow + i * SM4_GHASH_POWER_WORDS, h);
+        XMEMCPY(p, h, SM4_BLOCK_SIZE);
+    }
+
+    ForceZero(h, sizeof(h));
+    ForceZero(p, sizeof(p));
+}
+#elif defined(WOLFSSL_SM4_GCM)
 /* Calculate the value of H for the GMAC operation.
  *
- * @param [in]  sm4  SM4 algorithm object.
- * @param [in]  iv   Initial IV.
+ * @param [in]      ks   Key schedule.
+ * @param [in, out] gcm  GCM data.
+ * @param [in]      iv   Initial IV.
  */
-static void sm4_gcm_calc_h(wc_Sm4* sm4, byte* iv)
+static void sm4_gcm_calc_h(const word32* ks, Gcm* gcm, byte* iv)
 {
 #if defined(__aarch64__) && defined(WOLFSSL_ARMASM)
-    word32* pt = (word32*)sm4->gcm.H;
+    word32* pt = (word32*)gcm->H;
 #endif
 
     /* Encrypt all zeros IV to create hash key for GCM. */
-    sm4_encrypt(sm4->ks, iv, sm4->gcm.H);
+    sm4_encrypt(ks, iv, gcm->H);
 #if !defined(__aarch64__) || !defined(WOLFSSL_ARMASM)
     #if defined(GCM_TABLE) || defined(GCM_TABLE_4BIT)
         /* Generate table from hash key. */
-        GenerateM0(&sm4->gcm);
+        GenerateM0(gcm);
     #endif /* GCM_TABLE */
 #else
     /* Reverse the bits of H for use in assembly. */
@@ -1133,256 +2463,283 @@ static void sm4_gcm_calc_h(wc_Sm4* sm4, byte* iv)
     );
 #endif
 }
+#endif
 
-/* Increment counter for GCM.
+#ifdef WOLFSSL_SM4_SHARED_KEY
+/* Create shared key data.
  *
- * @param [in, out] counter  4-byte big endian number.
+ * The key schedule and, with GCM, the hash key table are calculated here.
+ * Dispose of with wc_Sm4KeyFree().
+ *
+ * @param [in]  key          Array of bytes representing key.
+ * @param [in]  len          Length of key. Must be SM4_KEY_SIZE.
+ * @param [in]  heap         Heap hint for dynamic memory allocation.
+ * @param [out] result_code  0 on success.
+ *                           BAD_FUNC_ARG when key is NULL or len is not
+ *                           SM4_KEY_SIZE.
+ *                           MEMORY_E when dynamic memory allocation fails.
+ *                           May be NULL.
+ * @return  Shared key data with one reference on success.
+ * @return  NULL on failure.
  */
-static WC_INLINE void sm4_increment_gcm_counter(byte* counter)
+wc_Sm4Key* wc_Sm4KeyNew(const byte* key, word32 len, void* heap,
+    int* result_code)
 {
-    int i;
+    int ret = 0;
+    wc_Sm4Key* sm4Key = NULL;
+#ifdef WOLFSSL_SM4_GCM
+    byte iv[SM4_BLOCK_SIZE];
+#endif
 
-    /* Big-endian number in last 4 bytes. */
-    for (i = SM4_BLOCK_SIZE - 1; i >= SM4_BLOCK_SIZE - CTR_SZ; i--) {
-        /* Increment byte and check for carry. */
-        if ((++counter[i]) != 0) {
-            /* No carry - done. */
-            break;
+    /* Validate parameters. */
+    if ((key == NULL) || (len != SM4_KEY_SIZE)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    if (ret == 0) {
+        sm4Key = (wc_Sm4Key*)XMALLOC(sizeof(wc_Sm4Key), heap,
+            DYNAMIC_TYPE_CIPHER);
+        if (sm4Key == NULL) {
+            ret = MEMORY_E;
         }
     }
+    if (ret == 0) {
+        XMEMSET(sm4Key, 0, sizeof(*sm4Key));
+        sm4Key->heap = heap;
+        wolfSSL_RefInit(&sm4Key->ref, &ret);
+        if (ret != 0) {
+            XFREE(sm4Key, heap, DYNAMIC_TYPE_CIPHER);
+            sm4Key = NULL;
+        }
+    }
+    if (ret == 0) {
+        sm4_expand_key(key, sm4Key->ks);
+    #ifdef WOLFSSL_SM4_GCM
+        /* Calculate H for GMAC operation from an all zeros IV. */
+        XMEMSET(iv, 0, sizeof(iv));
+    #ifdef WOLFSSL_SM4_GHASH
+        sm4_gcm_calc_h(sm4Key->ks, sm4Key->hPow, iv);
+    #else
+        sm4_gcm_calc_h(sm4Key->ks, &sm4Key->gcm, iv);
+    #endif
+    #endif
+    }
+
+    if (result_code != NULL) {
+        *result_code = ret;
+    }
+    return sm4Key;
 }
 
-/* Encrypt bytes using SM4-GCM implementation in C.
+/* Add a reference to the shared key data.
  *
- * @param [in]  sm4      SM4 algorithm object.
- * @param [out] out      Byte array in which to place encrypted data.
- * @param [in]  in       Array of bytes to encrypt.
- * @param [in]  sz       Number of bytes to encrypt.
- * @param [in]  nonce    Array of bytes holding nonce.
- * @param [in]  nonceSz  Length of nonce in bytes.
- * @param [out] tag      Authentication tag calculated using GCM.
- * @param [in]  tagSz    Length of authentication tag to calculate in bytes.
- *                       Must be no more than SM4_BLOCK_SIZE.
- * @param [in]  aad      Additional authentication data. May be NULL.
- * @param [in]  aadSz    Length of additional authentication data in bytes.
+ * @param [in, out] key  Shared key data.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when key is NULL.
  */
-static void sm4_gcm_encrypt_c(wc_Sm4* sm4, byte* out, const byte* in, word32 sz,
-    const byte* nonce, word32 nonceSz, byte* tag, word32 tagSz,
-    const byte* aad, word32 aadSz)
+int wc_Sm4KeyUpRef(wc_Sm4Key* key)
 {
-    word32 blocks = sz / SM4_BLOCK_SIZE;
-    word32 partial = sz % SM4_BLOCK_SIZE;
-    byte* c = out;
-    ALIGN16 byte counter[SM4_BLOCK_SIZE];
-    ALIGN16 byte encCounter[SM4_BLOCK_SIZE];
+    int ret = 0;
 
-    /* Check for 12 bytes of nonce to use as is with 4 bytes of counter. */
-    if (nonceSz == GCM_NONCE_MID_SZ) {
-        /* Counter is nonce with bottom 4 bytes set to: 0x00,0x00,0x00,0x01. */
-        XMEMCPY(counter, nonce, nonceSz);
-        XMEMSET(counter + GCM_NONCE_MID_SZ, 0, CTR_SZ - 1);
-        counter[SM4_BLOCK_SIZE - 1] = 1;
-    }
-    else {
-        /* Counter is GHASH of nonce. */
-        GHASH(&sm4->gcm, NULL, 0, nonce, nonceSz, counter, SM4_BLOCK_SIZE);
-#ifdef WOLFSSL_ARMASM
-        GMULT(counter, sm4->gcm.H);
-#endif
+    /* Validate parameters. */
+    if (key == NULL) {
+        ret = BAD_FUNC_ARG;
     }
-    /* Encrypt the initial counter for GMAC. */
-    sm4_encrypt(sm4->ks, counter, encCounter);
-
-#if defined(WOLFSSL_SM4_ECB)
-    /* Encrypting multiple blocks at a time can be faster. */
-    if ((c != in) && (blocks > 0)) {
-        /* Set the counters for a multiple of block size into the output. */
-        while (blocks--) {
-            /* Increment last 4 bytes of big-endian counter. */
-            sm4_increment_gcm_counter(counter);
-            /* Copy into output. */
-            XMEMCPY(c, counter, SM4_BLOCK_SIZE);
-            /* Move output position past this block. */
-            c += SM4_BLOCK_SIZE;
-        }
 
-        /* Reset number of blocks. */
-        blocks = sz / SM4_BLOCK_SIZE;
-        /* Encrypt the counters. */
-        wc_Sm4EcbEncrypt(sm4, out, out, SM4_BLOCK_SIZE * blocks);
-        /* XOR in the plaintext to create cipher text. */
-        xorbuf(out, in, SM4_BLOCK_SIZE * blocks);
-        /* Step over handled plaintext */
-        in += SM4_BLOCK_SIZE * blocks;
+    if (ret == 0) {
+        wolfSSL_RefInc(&key->ref, &ret);
     }
-    else
-#endif /* HAVE_SM4_ECB */
-    {
-        ALIGN32 byte scratch[SM4_BLOCK_SIZE];
 
-        /* For each full block of data, encrypt. */
-        while (blocks--) {
-            /* Increment last 4 bytes of big-endian counter. */
-            sm4_increment_gcm_counter(counter);
-            /* Encrypt the counter into scratch. */
-            sm4_encrypt(sm4->ks, counter, scratch);
-            /* XOR encryted counter with plaintext into output. */
-            xorbufout(c, scratch, in, SM4_BLOCK_SIZE);
-            /* Move plaintext and cipher text position past this block. */
-            in += SM4_BLOCK_SIZE;
-            c += SM4_BLOCK_SIZE;
+    return ret;
+}
+
+/* Remove a reference to the shared key data.
+ *
+ * Zeroizes and disposes of the key data when the last reference is removed.
+ *
+ * @param [in, out] key  Shared key data. May be NULL.
+ */
+void wc_Sm4KeyFree(wc_Sm4Key* key)
+{
+    int ret = 0;
+    int isZero = 0;
+    void* heap;
+
+    if (key != NULL) {
+        wolfSSL_RefDec(&key->ref, &isZero, &ret);
+        if ((ret == 0) && isZero) {
+            heap = key->heap;
+            wolfSSL_RefFree(&key->ref);
+            /* Must zeroize key schedule and hash key. */
+            ForceZero(key, sizeof(*key));
+            XFREE(key, heap, DYNAMIC_TYPE_CIPHER);
         }
     }
+}
 
-    if (partial != 0) {
-        /* Increment last 4 bytes of big-endian counter. */
-        sm4_increment_gcm_counter(counter);
-        /* Encrypt the last counter. */
-        sm4_encrypt(sm4->ks, counter, counter);
-        /* XOR encryted counter with partial block plaintext into output. */
-        xorbufout(c, counter, in, partial);
+/* Release the reference to shared key data held by the SM4 object.
+ *
+ * @param [in, out] sm4  SM4 algorithm object.
+ */
+static void sm4_release_key(wc_Sm4* sm4)
+{
+    if (sm4->key != NULL) {
+        wc_Sm4KeyFree(sm4->key);
+        sm4->key = NULL;
     }
-
-    /* Calculate GHASH on additional authentication data and cipher text. */
-#ifndef WOLFSSL_ARMASM
-    GHASH(&sm4->gcm, aad, aadSz, out, sz, tag, tagSz);
-#else
-    GHASH(&sm4->gcm, aad, aadSz, out, sz, counter, SM4_BLOCK_SIZE);
-    GMULT(counter, sm4->gcm.H);
-    XMEMCPY(tag, counter, tagSz);
-#endif
-    /* XOR the encrypted initial counter into tag. */
-    xorbuf(tag, encCounter, tagSz);
 }
 
-/* Decrypt bytes using SM4-GCM implementation in C.
+/* Use shared key data for operations with the SM4 object.
  *
- * @param [in]  sm4      SM4 algorithm object.
- * @param [out] out      Byte array in which to place decrypted data.
- * @param [in]  in       Array of bytes to decrypt.
- * @param [in]  sz       Number of bytes to decrypt.
- * @param [in]  nonce    Array of bytes holding initialization vector.
- * @param [in]  nonceSz  Length of nonce in bytes.
- * @param [in]  tag      Authentication tag calculated using GCM.
- * @param [in]  tagSz    Length of authentication tag to calculate in bytes.
- *                       Must be no more than SM4_BLOCK_SIZE.
- * @param [in]  aad      Additional authentication data. May be NULL.
- * @param [in]  aadSz    Length of additional authentication data in bytes.
+ * Adds a reference to the key data. The reference is removed when another key
+ * is set or the SM4 object is freed. Key data is not modified by operations so
+ * it can be used by SM4 objects in different threads at the same time.
+ *
+ * @param [in, out] sm4  SM4 algorithm object.
+ * @param [in]      key  Shared key data.
  * @return  0 on success.
- * @return  SM4_GCM_AUTH_E when authentication tag calculated does not match
- *          the one passed in.
+ * @return  BAD_FUNC_ARG when sm4 or key is NULL.
  */
-static int sm4_gcm_decrypt_c(wc_Sm4* sm4, byte* out, const byte* in, word32 sz,
-    const byte* nonce, word32 nonceSz, const byte* tag, word32 tagSz,
-    const byte* aad, word32 aadSz)
+int wc_Sm4SetSharedKey(wc_Sm4* sm4, wc_Sm4Key* key)
 {
-    int ret;
-    word32 blocks = sz / SM4_BLOCK_SIZE;
-    word32 partial = sz % SM4_BLOCK_SIZE;
-    byte* p = out;
-    ALIGN16 byte counter[SM4_BLOCK_SIZE];
-    ALIGN16 byte calcTag[SM4_BLOCK_SIZE];
-    ALIGN16 byte scratch[SM4_BLOCK_SIZE];
-    sword32 res;
+    int ret = 0;
 
-    if (nonceSz == GCM_NONCE_MID_SZ) {
-        /* Counter is nonce with bottom 4 bytes set to: 0x00,0x00,0x00,0x01. */
-        XMEMCPY(counter, nonce, nonceSz);
-        XMEMSET(counter + GCM_NONCE_MID_SZ, 0, CTR_SZ - 1);
-        counter[SM4_BLOCK_SIZE - 1] = 1;
+    /* Validate parameters. */
+    if ((sm4 == NULL) || (key == NULL)) {
+        ret = BAD_FUNC_ARG;
     }
-    else {
-        /* Counter is GHASH of nonce. */
-        GHASH(&sm4->gcm, NULL, 0, nonce, nonceSz, counter, SM4_BLOCK_SIZE);
-#ifdef WOLFSSL_ARMASM
-        GMULT(counter, sm4->gcm.H);
-#endif
+
+    if (ret == 0) {
+        wolfSSL_RefInc(&key->ref, &ret);
+    }
+    if (ret == 0) {
+        sm4_release_key(sm4);
+    #ifndef WOLFSSL_SM4_SHARED_KEY_ONLY
+        /* Key no longer held in object. */
+        ForceZero(sm4->ks, sizeof(sm4->ks));
+    #endif
+        sm4->key = key;
+        /* Mark key as having been set. */
+        sm4->keySet = 1;
     }
 
-    /* Calculate GHASH on additional authentication data and cipher text. */
-#ifndef WOLFSSL_ARMASM
-    GHASH(&sm4->gcm, aad, aadSz, in, sz, calcTag, sizeof(calcTag));
-#else
-    GHASH(&sm4->gcm, aad, aadSz, in, sz, calcTag, SM4_BLOCK_SIZE);
-    GMULT(calcTag, sm4->gcm.H);
-#endif
-    /* Encrypt the initial counter. */
-    sm4_encrypt(sm4->ks, counter, scratch);
-    /* XOR the encrypted initial counter into calculated tag. */
-    xorbuf(calcTag, scratch, sizeof(calcTag));
-#ifdef WC_SM4_GCM_DEC_AUTH_EARLY
-    /* Compare tag and calculated tag in constant time. */
-    res = ConstantCompare(tag, calcTag, tagSz);
-    /* Create mask based on comparison result in constant time */
-    res = 0 - (sword32)(((word32)(0 - res)) >> 31U);
-    /* Mask error code to get return value. */
-    ret = res & SM4_GCM_AUTH_E;
-    /* Decrypt data when no error. */
-    if (ret == 0)
+    return ret;
+}
+#endif /* WOLFSSL_SM4_SHARED_KEY */
+
+/* Initialize the SM4 algorithm object.
+ *
+ * @param [in, out] sm4    SM4 algorithm object.
+ * @param [in]      heap   Heap hint for dynamic memory allocation.
+ * @param [in]      devId  Device identifier.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4 is NULL.
+ */
+int wc_Sm4Init(wc_Sm4* sm4, void* heap, int devId)
+{
+    int ret = 0;
+
+#ifndef WOLF_CRYPTO_CB
+    /* No device support. */
+    (void)devId;
 #endif
-    {
-    #if defined(WOLFSSL_SM4_ECB)
-        if ((in != p) && (blocks > 0)) {
-            /* Set the counters for a multiple of block size into the output. */
-            while (blocks--) {
-                /* Increment last 4 bytes of big-endian counter. */
-                sm4_increment_gcm_counter(counter);
-                /* Copy into output. */
-                XMEMCPY(p, counter, SM4_BLOCK_SIZE);
-                /* Move output position past this block. */
-                p += SM4_BLOCK_SIZE;
-            }
 
-            /* Reset number of blocks. */
-            blocks = sz / SM4_BLOCK_SIZE;
-            /* Encrypt the counters. */
-            wc_Sm4EcbEncrypt(sm4, out, out, SM4_BLOCK_SIZE * blocks);
-            /* XOR in the plaintext to create cipher text. */
-            xorbuf(out, in, SM4_BLOCK_SIZE * blocks);
-            /* Step over handled plaintext */
-            in += SM4_BLOCK_SIZE * blocks;
-        }
-        else
-    #endif /* WOLFSSL_SM4_ECB */
-        {
-            while (blocks--) {
-                /* Increment last 4 bytes of big-endian counter. */
-                sm4_increment_gcm_counter(counter);
-                /* Encrypt the counter into scratch. */
-                sm4_encrypt(sm4->ks, counter, scratch);
-                /* XOR encryted counter with cipher text into output. */
-                xorbufout(p, scratch, in, SM4_BLOCK_SIZE);
-                /* Move plaintext and cipher text position past this block. */
-                p += SM4_BLOCK_SIZE;
-                in += SM4_BLOCK_SIZE;
-            }
-        }
+    /* Validate parameters. */
+    if (sm4 == NULL) {
+        ret = BAD_FUNC_ARG;
+    }
 
-        if (partial != 0) {
-            /* Increment last 4 bytes of big-endian counter. */
-            sm4_increment_gcm_counter(counter);
-            /* Encrypt the last counter. */
-            sm4_encrypt(sm4->ks, counter, counter);
-            /* XOR encryted counter with partial block cipher text into output.
-             */
-            xorbufout(p, counter, in, partial);
-        }
+    if (ret == 0) {
+        /* Set all fields to zero including bit fields. */
+        XMEMSET(sm4, 0, sizeof(*sm4));
 
-    #ifndef WC_SM4_GCM_DEC_AUTH_EARLY
-        /* Compare tag and calculated tag in constant time. */
-        res = ConstantCompare(tag, calcTag, (int)tagSz);
-        /* Create mask based on comparison result in constant time */
-        res = 0 - (sword32)(((word32)(0 - res)) >> 31U);
-        /* Mask error code to get return value. */
-        ret = res & SM4_GCM_AUTH_E;
+        /* Cache heap hint to use with any dynamic allocations. */
+        sm4->heap = heap;
+    #ifdef WOLF_CRYPTO_CB
+        sm4->devId = devId;
     #endif
     }
+
     return ret;
 }
 
-/* Set the SM4-GCM key.
+/* Dispose of SM4 algorithm object.
  *
- * Calculates key based table here.
+ * Zeroize sensitive data in object.
+ * Required with WOLFSSL_SM4_SHARED_KEY_ONLY, or after wc_Sm4SetSharedKey(), to
+ * release the key data.
+ *
+ * @param [in, out] sm4  SM4 algorithm object.
+ */
+void wc_Sm4Free(wc_Sm4* sm4)
+{
+    /* Check we have something to work with. */
+    if (sm4 != NULL) {
+    #ifdef WOLFSSL_SM4_SHARED_KEY
+        /* Release reference to shared key data. */
+        sm4_release_key(sm4);
+    #endif
+    #ifndef WOLFSSL_SM4_SHARED_KEY_ONLY
+        /* Must zeroize key schedule. */
+        ForceZero(sm4->ks, sizeof(sm4->ks));
+    #endif
+    #if defined(WOLFSSL_SM4_CTR) || defined(WOLFSSL_SM4_CFB)
+        /* For CBC, tmp is cipher text - no need to zeroize. */
+        /* For CTR and CFB, tmp is encrypted counter/IV that must be
+         * zeroized. */
+        ForceZero(sm4->tmp, sizeof(sm4->tmp));
+    #endif
+    #ifdef WOLFSSL_SM4_OFB
+        /* For OFB, iv is key stream that must be zeroized. */
+        ForceZero(sm4->iv, sizeof(sm4->iv));
+    #endif
+    }
+}
+
+/* Set the key.
+ *
+ * With WOLFSSL_SM4_SHARED_KEY_ONLY, key data is allocated and released by
+ * wc_Sm4Free().
+ *
+ * @param [in, out] sm4  SM4 algorithm object.
+ * @param [in]      key  Array of bytes representing key.
+ * @return  0 on success.
+ * @return  MEMORY_E when dynamic memory allocation fails.
+ */
+static int sm4_set_key(wc_Sm4* sm4, const byte* key)
+{
+    int ret = 0;
+#ifdef WOLFSSL_SM4_SHARED_KEY_ONLY
+    /* Key data only referenced by this object. */
+    wc_Sm4Key* sm4Key = wc_Sm4KeyNew(key, SM4_KEY_SIZE, sm4->heap, &ret);
+
+    if (ret == 0) {
+        sm4_release_key(sm4);
+        sm4->key = sm4Key;
+    }
+#else
+#ifdef WOLFSSL_SM4_SHARED_KEY
+    /* Key now held in object. */
+    sm4_release_key(sm4);
+#endif
+    sm4_expand_key(key, sm4->ks);
+#endif
+
+    if (ret == 0) {
+        /* Mark key as having been set. */
+        sm4->keySet = 1;
+    }
+
+    return ret;
+}
+
+#if defined(WOLFSSL_SM4_ECB) || defined(WOLFSSL_SM4_CBC) || \
+    defined(WOLFSSL_SM4_CTR) || defined(WOLFSSL_SM4_CCM) || \
+    defined(WOLFSSL_SM4_CFB) || defined(WOLFSSL_SM4_OFB)
+/* Set the key.
+ *
+ * With WOLFSSL_SM4_SHARED_KEY_ONLY, wc_Sm4Free() must be called to free the
+ * key data.
  *
  * @param [in, out] sm4  SM4 algorithm object.
  * @param [in]      key  Array of bytes representing key.
@@ -1390,11 +2747,11 @@ static int sm4_gcm_decrypt_c(wc_Sm4* sm4, byte* out, const byte* in, word32 sz,
  * @return  0 on success.
  * @return  BAD_FUNC_ARG when sm4 or key is NULL.
  * @return  BAD_FUNC_ARG when len is not SM4_KEY_SIZE.
+ * @return  MEMORY_E when dynamic memory allocation fails.
  */
-int wc_Sm4GcmSetKey(wc_Sm4* sm4, const byte* key, word32 len)
+int wc_Sm4SetKey(wc_Sm4* sm4, const byte* key, word32 len)
 {
     int ret = 0;
-    byte iv[SM4_BLOCK_SIZE];
 
     /* Validate parameters. */
     if ((sm4 == NULL) || (key == NULL) || (len != SM4_KEY_SIZE)) {
@@ -1402,56 +2759,86 @@ int wc_Sm4GcmSetKey(wc_Sm4* sm4, const byte* key, word32 len)
     }
 
     if (ret == 0) {
-        /* Set key. */
-        sm4_set_key(sm4, key);
-        /* Reset IV to all zeros. */
-        XMEMSET(iv, 0, sizeof(iv));
-        /* Set IV. */
+        ret = sm4_set_key(sm4, key);
+    }
+
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM4_CBC) || defined(WOLFSSL_SM4_CTR) || \
+    defined(WOLFSSL_SM4_GCM) || defined(WOLFSSL_SM4_CFB) || \
+    defined(WOLFSSL_SM4_OFB)
+/* Set the IV.
+ *
+ * @param [in, out] sm4  SM4 algorithm object.
+ * @param [in]      iv   Array of bytes representing IV. May be NULL.
+ */
+static void sm4_set_iv(wc_Sm4* sm4, const byte* iv)
+{
+    /* Set IV. */
+    XMEMCPY(sm4->iv, iv, SM4_IV_SIZE);
+#if defined(WOLFSSL_SM4_CTR) || defined(WOLFSSL_SM4_CFB) || \
+    defined(WOLFSSL_SM4_OFB)
+    /* Unused count of encrypted counter/IV for CTR, CFB and OFB modes. */
+    sm4->unused = 0;
+#endif
+    sm4->ivSet = 1;
+}
+#endif
+
+#if defined(WOLFSSL_SM4_CBC) || defined(WOLFSSL_SM4_CTR) || \
+    defined(WOLFSSL_SM4_CFB) || defined(WOLFSSL_SM4_OFB)
+/* Set the IV.
+ *
+ * @param [in, out] sm4  SM4 algorithm object.
+ * @param [in]      iv   Array of bytes representing IV. May be NULL.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4 or iv is NULL.
+ */
+int wc_Sm4SetIV(wc_Sm4* sm4, const byte* iv)
+{
+    int ret = 0;
+
+    /* Validate parameters. */
+    if ((sm4 == NULL) || (iv == NULL)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    if (ret == 0) {
         sm4_set_iv(sm4, iv);
-        /* Calculate H for GMAC operation */
-        sm4_gcm_calc_h(sm4, iv);
     }
 
     return ret;
 }
+#endif
 
-/* Encrypt bytes using SM4-GCM.
+#ifdef WOLFSSL_SM4_ECB
+
+/* Encrypt bytes using SM4-ECB.
  *
+ * Length of input must be a multiple of the block size.
  * Assumes out is at least sz bytes long.
  *
- * @param [in]  sm4      SM4 algorithm object.
- * @param [out] out      Byte array in which to place encrypted data.
- * @param [in]  in       Array of bytes to encrypt.
- * @param [in]  sz       Number of bytes to encrypt.
- * @param [in]  nonce    Array of bytes holding initialization vector.
- * @param [in]  nonceSz  Length of nonce in bytes.
- * @param [out] tag      Authentication tag calculated using GCM.
- * @param [in]  tagSz    Length of authentication tag to calculate in bytes.
- *                       Must be no more than SM4_BLOCK_SIZE.
- * @param [in]  aad      Additional authentication data. May be NULL.
- * @param [in]  aadSz    Length of additional authentication data in bytes.
+ * @param [in]  sm4  SM4 algorithm object.
+ * @param [out] out  Byte array in which to place encrypted data.
+ * @param [in]  in   Array of bytes to encrypt.
+ * @param [in]  sz   Number of bytes to encrypt.
  * @return  0 on success.
- * @return  BAD_FUNC_ARG when sm4, in, out, nonce or tag is NULL.
- * @return  BAD_FUNC_ARG when authentication tag data length is less than
- *          WOLFSSL_MIN_AUTH_TAG_SZ or is more than SM4_BLOCK_SIZE.
- * @return  BAD_FUNC_ARG when nonce length is 0.
+ * @return  BAD_FUNC_ARG when sm4, out or in is NULL.
+ * @return  BAD_FUNC_ARG when sz is not a multiple of SM4_BLOCK_SIZE.
  * @return  MISSING_KEY when a key has not been set.
  */
-int wc_Sm4GcmEncrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz,
-    const byte* nonce, word32 nonceSz, byte* tag, word32 tagSz, const byte* aad,
-    word32 aadSz)
+int wc_Sm4EcbEncrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz)
 {
     int ret = 0;
 
     /* Validate parameters. */
-    if ((sm4 == NULL) || ((sz != 0) && ((in == NULL) || (out == NULL))) ||
-            (nonce == NULL) || (tag == NULL)) {
-        ret = BAD_FUNC_ARG;
-    }
-    if ((tagSz < WOLFSSL_MIN_AUTH_TAG_SZ) || (tagSz > SM4_BLOCK_SIZE)) {
+    if ((sm4 == NULL) || (in == NULL) || (out == NULL)) {
         ret = BAD_FUNC_ARG;
     }
-    if (nonceSz == 0) {
+    /* Can only work on multiples of block size of bytes. */
+    if ((ret == 0) && ((sz & (SM4_BLOCK_SIZE - 1)) != 0)) {
         ret = BAD_FUNC_ARG;
     }
 
@@ -1460,58 +2847,3713 @@ int wc_Sm4GcmEncrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz,
         ret = MISSING_KEY;
     }
 
+#ifdef SM4_PARALLEL
+    if ((ret == 0) && (sz > 0) && sm4_par_avail()) {
+        /* Encrypt all blocks in parallel. */
+        sm4_blocks(SM4_KS(sm4), in, out, sz / SM4_BLOCK_SIZE);
+        sz = 0;
+    }
+#endif
     if (ret == 0) {
-    #ifdef OPENSSL_EXTRA
-        sm4->nonceSz = (int)nonceSz;
-    #endif
-        /* Perform encryption using C implementation. */
-        sm4_gcm_encrypt_c(sm4, out, in, sz, nonce, nonceSz, tag, tagSz, aad,
-            aadSz);
+        /* Encrypt all bytes. */
+        while (sz > 0) {
+            /* Encrypt a block. */
+            sm4_encrypt(SM4_KS(sm4), in, out);
+            /* Move on to next block. */
+            in += SM4_BLOCK_SIZE;
+            out += SM4_BLOCK_SIZE;
+            sz -= SM4_BLOCK_SIZE;
+        }
     }
 
     return ret;
 }
 
-/* Decrypt bytes using SM4-GCM.
+/* Decrypt bytes using SM4-ECB.
  *
+ * Length of input must be a multiple of the block size.
  * Assumes out is at least sz bytes long.
  *
- * @param [in]  sm4      SM4 algorithm object.
- * @param [out] out      Byte array in which to place decrypted data.
- * @param [in]  in       Array of bytes to decrypt.
- * @param [in]  sz       Number of bytes to decrypt.
- * @param [in]  nonce    Array of bytes holding initialization vector.
- * @param [in]  nonceSz  Length of nonce in bytes.
- * @param [in]  tag      Authentication tag to compare against calculated.
- * @param [in]  tagSz    Length of authentication tag in bytes.
- *                       Must be no more than SM4_BLOCK_SIZE.
- * @param [in]  aad      Additional authentication data. May be NULL.
- * @param [in]  aadSz    Length of additional authentication data in bytes.
+ * @param [in]  sm4  SM4 algorithm object.
+ * @param [out] out  Byte array in which to place decrypted data.
+ * @param [in]  in   Array of bytes to decrypt.
+ * @param [in]  sz   Number of bytes to decrypt.
  * @return  0 on success.
- * @return  BAD_FUNC_ARG when sm4, in, out, nonce or tag is NULL.
- * @return  BAD_FUNC_ARG when authentication tag data length is less than
- *          WOLFSSL_MIN_AUTH_TAG_SZ or is more than SM4_BLOCK_SIZE.
+ * @return  BAD_FUNC_ARG when sm4, out or in is NULL.
+ * @return  BAD_FUNC_ARG when sz is not a multiple of SM4_BLOCK_SIZE.
+ * @return  MISSING_KEY when a key has not been set.
+ */
+int wc_Sm4EcbDecrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz)
+{
+
+    int ret = 0;
+
+    /* Validate parameters. */
+    if ((sm4 == NULL) || (in == NULL) || (out == NULL)) {
+        ret = BAD_FUNC_ARG;
+    }
+    /* Can only work on multiples of block size of bytes. */
+    if ((ret == 0) && ((sz & (SM4_BLOCK_SIZE - 1)) != 0)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    /* Ensure a key has been set. */
+    if ((ret == 0) && (!sm4->keySet)) {
+        ret = MISSING_KEY;
+    }
+
+#ifdef SM4_PARALLEL
+    if ((ret == 0) && (sz > 0) && sm4_par_avail()) {
+        word32 ks[SM4_KEY_SCHEDULE];
+
+        /* Decrypt all blocks in parallel. */
+        sm4_key_schedule_dec(SM4_KS(sm4), ks);
+        sm4_blocks(ks, in, out, sz / SM4_BLOCK_SIZE);
+        ForceZero(ks, sizeof(ks));
+        sz = 0;
+    }
+#endif
+    if (ret == 0) {
+       /* Decrypt all bytes. */
+        while (sz > 0) {
+            /* Decrypt a block. */
+            sm4_decrypt(SM4_KS(sm4), in, out);
+            /* Move on to next block. */
+            in += SM4_BLOCK_SIZE;
+            out += SM4_BLOCK_SIZE;
+            sz -= SM4_BLOCK_SIZE;
+        }
+    }
+
+    return ret;
+}
+
+/* Encrypt a block with each of a number of SM4 objects using SM4-ECB.
+ *
+ * Block i is encrypted with the key of sm4[i]. Use to calculate many
+ * header protection masks, each from a sample of a packet, at once.
+ *
+ * @param [in]  sm4  Array of SM4 algorithm objects.
+ * @param [out] out  Byte array in which to place encrypted blocks.
+ * @param [in]  in   Array of blocks to encrypt.
+ * @param [in]  cnt  Number of blocks and SM4 algorithm objects.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4, out or in is NULL.
+ * @return  BAD_FUNC_ARG when an SM4 algorithm object is NULL.
+ * @return  MISSING_KEY when a key has not been set.
+ */
+int wc_Sm4EcbEncryptBurst(wc_Sm4* const* sm4, byte* out, const byte* in,
+    word32 cnt)
+{
+    int ret = 0;
+    const word32* mks[SM4_MK_BLOCKS];
+    word32 i;
+
+    /* Validate parameters. */
+    if ((cnt > 0) && ((sm4 == NULL) || (in == NULL) || (out == NULL))) {
+        ret = BAD_FUNC_ARG;
+    }
+    for (i = 0; (ret == 0) && (i < cnt); i++) {
+        if (sm4[i] == NULL) {
+            ret = BAD_FUNC_ARG;
+        }
+        /* Ensure a key has been set. */
+        else if (!sm4[i]->keySet) {
+            ret = MISSING_KEY;
+        }
+    }
+
+    while ((ret == 0) && (cnt > 0)) {
+        word32 n = min(cnt, SM4_MK_BLOCKS);
+
+        for (i = 0; i < n; i++) {
+            mks[i] = SM4_KS(sm4[i]);
+        }
+        /* Encrypt a block with each key. */
+        sm4_blocks_mk(mks, in, out, n);
+
+        /* Move on to next blocks. */
+        sm4 += n;
+        in += n * SM4_BLOCK_SIZE;
+        out += n * SM4_BLOCK_SIZE;
+        cnt -= n;
+    }
+
+    return ret;
+}
+
+#endif /* WOLFSSL_SM4_ECB */
+
+#ifdef WOLFSSL_SM4_CBC
+
+#ifdef SM4_PARALLEL
+/* Decrypt bytes using SM4-CBC in parallel.
+ *
+ * Blocks are decrypted in parallel.
+ *
+ * @param [in]  sm4  SM4 algorithm object.
+ * @param [out] out  Byte array in which to place decrypted data.
+ * @param [in]  in   Array of bytes to decrypt.
+ * @param [in]  sz   Number of bytes to decrypt. Multiple of block size.
+ */
+static void sm4_cbc_decrypt_par(wc_Sm4* sm4, byte* out, const byte* in,
+    word32 sz)
+{
+    word32 ks[SM4_KEY_SCHEDULE];
+    ALIGN16 byte tmp[SM4_PAR_BLOCKS * SM4_BLOCK_SIZE];
+
+    sm4_key_schedule_dec(SM4_KS(sm4), ks);
+    while (sz > 0) {
+        word32 len = min(sz, (word32)sizeof(tmp));
+
+        /* Decrypt blocks into temporary. */
+        sm4_blocks(ks, in, tmp, len / SM4_BLOCK_SIZE);
+        /* XOR first block with IV and the rest with previous cipher text. */
+        xorbuf(tmp, sm4->iv, SM4_BLOCK_SIZE);
+        xorbuf(tmp + SM4_BLOCK_SIZE, in, len - SM4_BLOCK_SIZE);
+        /* Last cipher text block is next IV - copy before output written. */
+        XMEMCPY(sm4->iv, in + len - SM4_BLOCK_SIZE, SM4_BLOCK_SIZE);
+        XMEMCPY(out, tmp, len);
+
+        /* Move on to next blocks. */
+        in += len;
+        out += len;
+        sz -= len;
+    }
+
+    ForceZero(ks, sizeof(ks));
+    ForceZero(tmp, sizeof(tmp));
+}
+#endif
+
+/* Encrypt bytes using SM4-CBC.
+ *
+ * Length of input must be a multiple of the block size.
+ * Assumes out is at least sz bytes long.
+ *
+ * @param [in]  sm4  SM4 algorithm object.
+ * @param [out] out  Byte array in which to place encrypted data.
+ * @param [in]  in   Array of bytes to encrypt.
+ * @param [in]  sz   Number of bytes to encrypt.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4, out or in is NULL.
+ * @return  BAD_FUNC_ARG when sz is not a multiple of SM4_BLOCK_SIZE.
+ * @return  MISSING_KEY when a key has not been set.
+ * @return  MISSING_IV when an IV has not been set.
+ */
+int wc_Sm4CbcEncrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz)
+{
+    int ret = 0;
+
+    /* Validate parameters. */
+    if ((sm4 == NULL) || (in == NULL) || (out == NULL)) {
+        ret = BAD_FUNC_ARG;
+    }
+    /* Can only work on multiples of block size of bytes. */
+    if ((ret == 0) && ((sz & (SM4_BLOCK_SIZE - 1)) != 0)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    /* Ensure a key and IV have been set. */
+    if ((ret == 0) && (!sm4->keySet)) {
+        ret = MISSING_KEY;
+    }
+    if ((ret == 0) && (!sm4->ivSet)) {
+        ret = MISSING_IV;
+    }
+
+    if (ret == 0) {
+        /* Encrypt all bytes. */
+        while (sz > 0) {
+            /* XOR next block into IV. */
+            xorbuf(sm4->iv, in, SM4_BLOCK_SIZE);
+            /* Encrypt IV XORed with block. */
+            sm4_encrypt(SM4_KS(sm4), sm4->iv, sm4->iv);
+            /* Use output block as next IV. */
+            XMEMCPY(out, sm4->iv, SM4_BLOCK_SIZE);
+
+            /* Move on to next block. */
+            in += SM4_BLOCK_SIZE;
+            out += SM4_BLOCK_SIZE;
+            sz -= SM4_BLOCK_SIZE;
+        }
+    }
+
+    return ret;
+}
+
+/* Decrypt bytes using SM4-CBC.
+ *
+ * Length of input must be a multiple of the block size.
+ * Assumes out is at least sz bytes long.
+ *
+ * @param [in]  sm4  SM4 algorithm object.
+ * @param [out] out  Byte array in which to place decrypted data.
+ * @param [in]  in   Array of bytes to decrypt.
+ * @param [in]  sz   Number of bytes to decrypt.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4, out or in is NULL.
+ * @return  MISSING_KEY when a key has not been set.
+ * @return  MISSING_IV when an IV has not been set.
+ */
+int wc_Sm4CbcDecrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz)
+{
+    int ret = 0;
+
+    /* Validate parameters. */
+    if ((sm4 == NULL) || (in == NULL) || (out == NULL)) {
+        ret = BAD_FUNC_ARG;
+    }
+    /* Can only work on multiples of block size of bytes. */
+    if ((ret == 0) && ((sz & (SM4_BLOCK_SIZE - 1)) != 0)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    /* Ensure a key and IV have been set. */
+    if ((ret == 0) && (!sm4->keySet)) {
+        ret = MISSING_KEY;
+    }
+    if ((ret == 0) && (!sm4->ivSet)) {
+        ret = MISSING_IV;
+    }
+
+    if (ret == 0) {
+    #ifdef SM4_PARALLEL
+        if (sm4_par_avail()) {
+            sm4_cbc_decrypt_par(sm4, out, in, sz);
+        }
+        else
+    #endif
+    #ifndef WOLFSSL_SM4_SMALL
+        if (in != out) {
+            while (sz > 0) {
+                /* Decrypt next block. */
+                sm4_decrypt(SM4_KS(sm4), in, sm4->tmp);
+                /* XOR decrypted block with IV to create output. */
+                xorbufout(out, sm4->tmp, sm4->iv, SM4_BLOCK_SIZE);
+                /* This encrypted block is the IV for next decryption. */
+                XMEMCPY(sm4->iv, in, SM4_BLOCK_SIZE);
+
+                /* Move on to next block. */
+                in += SM4_BLOCK_SIZE;
+                out += SM4_BLOCK_SIZE;
+                sz -= SM4_BLOCK_SIZE;
+            }
+        }
+        else
+    #endif
+        {
+            while (sz > 0) {
+                /* Cache encrypted block as it is next IV. */
+                XMEMCPY(sm4->tmp, in, SM4_BLOCK_SIZE);
+                /* Decrypt next block. */
+                sm4_decrypt(SM4_KS(sm4), sm4->tmp, out);
+                /* XOR decrypted block with IV to create output. */
+                xorbuf(out, sm4->iv, SM4_BLOCK_SIZE);
+                /* Cached encrypted block is next IV. */
+                XMEMCPY(sm4->iv, sm4->tmp, SM4_BLOCK_SIZE);
+
+                /* Move on to next block. */
+                in += SM4_BLOCK_SIZE;
+                out += SM4_BLOCK_SIZE;
+                sz -= SM4_BLOCK_SIZE;
+            }
+        }
+    }
+
+    return ret;
+}
+
+#endif /* WOLFSSL_SM4_CBC */
+
+#if defined(WOLFSSL_SM4_CTR) || \
+    (defined(WOLFSSL_SM4_THREADS) && defined(WOLFSSL_SM4_GCM))
+/* Add to a big-endian counter.
+ *
+ * Counter wraps around when the addition overflows.
+ *
+ * @param [in, out] ctr    Counter to add to.
+ * @param [in]      n      Number to add.
+ * @param [in]      ctrSz  Number of bytes at end of block that is counter.
+ */
+static void sm4_add_counter(byte* ctr, word64 n, int ctrSz)
+{
+    int i;
+    word64 c = n;
+
+    for (i = SM4_BLOCK_SIZE - 1; (i >= SM4_BLOCK_SIZE - ctrSz) && (c != 0);
+            i--) {
+        c += ctr[i];
+        ctr[i] = (byte)c;
+        c >>= 8;
+    }
+}
+#endif
+
+#ifdef WOLFSSL_SM4_CTR
+
+/* Increment IV in big-endian representation.
+ *
+ * @param [in, out] counter  Counter value to increment.
+ */
+static WC_INLINE void sm4_increment_counter(byte* counter)
+{
+    int i;
+
+    /* Big-endian number. */
+    for (i = SM4_BLOCK_SIZE - 1; i >= 0; i--) {
+        /* Increment byte and check for carry. */
+        if ((++counter[i]) != 0) {
+            /* No carry - done. */
+            break;
+        }
+    }
+}
+
+#ifdef SM4_PARALLEL
+/* Generate consecutive counter blocks.
+ *
+ * When the bottom 32 bits of the counter don't wrap, the top 96 bits are the
+ * same for all blocks and only the bottom 32 bits are calculated.
+ *
+ * @param [in, out] iv   Counter of first block. Next counter on return.
+ * @param [out]     ctr  Counter blocks.
+ * @param [in]      n    Number of counter blocks to generate.
+ */
+static void sm4_ctr_gen(byte* iv, byte* ctr, word32 n)
+{
+    word32 lo = ((word32)iv[12] << 24) | ((word32)iv[13] << 16) |
+                ((word32)iv[14] <<  8) | ((word32)iv[15] <<  0);
+    word32 i;
+
+    if (lo + n >= lo) {
+        for (i = 0; i < n; i++, lo++) {
+            XMEMCPY(ctr, iv, SM4_BLOCK_SIZE - 4);
+            ctr[12] = (byte)(lo >> 24);
+            ctr[13] = (byte)(lo >> 16);
+            ctr[14] = (byte)(lo >>  8);
+            ctr[15] = (byte)(lo >>  0);
+            ctr += SM4_BLOCK_SIZE;
+        }
+        iv[12] = (byte)(lo >> 24);
+        iv[13] = (byte)(lo >> 16);
+        iv[14] = (byte)(lo >>  8);
+        iv[15] = (byte)(lo >>  0);
+    }
+    else {
+        /* Carry into top 96 bits - increment whole counter. */
+        for (i = 0; i < n; i++) {
+            XMEMCPY(ctr, iv, SM4_BLOCK_SIZE);
+            sm4_increment_counter(iv);
+            ctr += SM4_BLOCK_SIZE;
+        }
+    }
+}
+
+/* Encrypt blocks using SM4-CTR in parallel.
+ *
+ * Counters are encrypted in parallel.
+ *
+ * @param [in]      ks      Key schedule.
+ * @param [in, out] iv      Counter of first block. Next counter on return.
+ * @param [out]     out     Byte array in which to place encrypted data.
+ * @param [in]      in      Array of bytes to encrypt.
+ * @param [in]      blocks  Number of blocks to encrypt.
+ */
+static void sm4_ctr_par(const word32* ks, byte* iv, byte* out, const byte* in,
+    word32 blocks)
+{
+    ALIGN16 byte ctr[SM4_PAR_BLOCKS * SM4_BLOCK_SIZE];
+
+    while (blocks > 0) {
+        word32 n = min(blocks, SM4_PAR_BLOCKS);
+
+        /* Set the counters - IV is the counter for next block. */
+        sm4_ctr_gen(iv, ctr, n);
+        /* Encrypt the counters and XOR with input into output. */
+        sm4_blocks(ks, ctr, ctr, n);
+        xorbufout(out, in, ctr, n * SM4_BLOCK_SIZE);
+
+        /* Move on to next blocks. */
+        in += n * SM4_BLOCK_SIZE;
+        out += n * SM4_BLOCK_SIZE;
+        blocks -= n;
+    }
+
+    ForceZero(ctr, sizeof(ctr));
+}
+#endif
+
+/* Encrypt bytes using SM4-CTR.
+ *
+ * Assumes out is at least sz bytes long.
+ *
+ * @param [in]  sm4  SM4 algorithm object.
+ * @param [out] out  Byte array in which to place encrypted data.
+ * @param [in]  in   Array of bytes to encrypt.
+ * @param [in]  sz   Number of bytes to encrypt.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4, out or in is NULL.
+ * @return  MISSING_KEY when a key has not been set.
+ * @return  MISSING_IV when an IV has not been set.
+ */
+int wc_Sm4CtrEncrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz)
+{
+    int ret = 0;
+
+    /* Validate parameters. */
+    if ((sm4 == NULL) || (in == NULL) || (out == NULL)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    /* Ensure a key and IV have been set. */
+    if ((ret == 0) && (!sm4->keySet)) {
+        ret = MISSING_KEY;
+    }
+    if ((ret == 0) && (!sm4->ivSet)) {
+        ret = MISSING_IV;
+    }
+
+    /* Continue if no error and bytes to encrypt. */
+    if ((ret == 0) && (sz > 0)) {
+        /* Check for unused bytes from previous encrypted counter. */
+        if (sm4->unused != 0) {
+            /* Calculate maximum length that can be encrypted. */
+            word32 len = min(sm4->unused, sz);
+
+            /* XOR the encrypted counter with input into output. */
+            xorbufout(out, in, sm4->tmp + SM4_BLOCK_SIZE - sm4->unused, len);
+
+            /* Move over processed data. */
+            in += len;
+            out += len;
+            sz -= len;
+            /* Some or all unused bytes used up. */
+            sm4->unused -= (byte)len;
+        }
+
+    #ifdef SM4_PARALLEL
+        if ((sz >= SM4_BLOCK_SIZE) && sm4_par_avail()) {
+            word32 len = sz & (~(word32)(SM4_BLOCK_SIZE - 1));
+
+            /* Encrypt all blocks in parallel. */
+            sm4_ctr_par(SM4_KS(sm4), sm4->iv, out, in,
+                len / SM4_BLOCK_SIZE);
+            in += len;
+            out += len;
+            sz -= len;
+        }
+    #endif
+        /* Do blocks at a time - only get here when there are no unused bytes.
+         */
+        while (sz >= SM4_BLOCK_SIZE) {
+            /* Encrypt the current IV into temporary buffer in object. */
+            sm4_encrypt(SM4_KS(sm4), sm4->iv, sm4->tmp);
+            /* XOR the encrypted IV with next block into output. */
+            xorbufout(out, in, sm4->tmp, SM4_BLOCK_SIZE);
+            /* Increment counter for next block. */
+            sm4_increment_counter(sm4->iv);
+
+            /* Move on to next block. */
+            in += SM4_BLOCK_SIZE;
+            out += SM4_BLOCK_SIZE;
+            sz -= SM4_BLOCK_SIZE;
+        }
+
+        /* Check for less than a block of data that needing to be encrypted. */
+        if (sz > 0) {
+            /* Encrypt the current IV into temporary buffer in object. */
+            sm4_encrypt(SM4_KS(sm4), sm4->iv, sm4->tmp);
+            /* Increment counter for next block. */
+            sm4_increment_counter(sm4->iv);
+            /* XOR the encrypted IV with remaining data into output. */
+            xorbufout(out, in, sm4->tmp, sz);
+            /* Record number of unused encrypted IV bytes. */
+            sm4->unused = (byte)(SM4_BLOCK_SIZE - sz);
+        }
+    }
+
+    return ret;
+}
+
+/* Set the position in the SM4-CTR key stream.
+ *
+ * The counter is set to the IV plus the number of whole blocks before the
+ * offset. When the offset is not on a block boundary, the counter is
+ * encrypted and the bytes after the offset are available for the next
+ * encryption. The counter wraps around as with wc_Sm4CtrEncrypt().
+ *
+ * @param [in, out] sm4     SM4 algorithm object.
+ * @param [in]      iv      Array of bytes representing IV at offset 0.
+ * @param [in]      offset  Offset of next byte to encrypt/decrypt.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4 or iv is NULL.
+ * @return  MISSING_KEY when offset is not on a block boundary and a key has
+ *          not been set.
+ */
+int wc_Sm4CtrSeek(wc_Sm4* sm4, const byte* iv, word64 offset)
+{
+    int ret = 0;
+    byte partial = (byte)(offset % SM4_BLOCK_SIZE);
+
+    /* Validate parameters. */
+    if ((sm4 == NULL) || (iv == NULL)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    /* Ensure a key has been set when encrypting counter. */
+    if ((ret == 0) && (partial != 0) && (!sm4->keySet)) {
+        ret = MISSING_KEY;
+    }
+
+    if (ret == 0) {
+        sm4_set_iv(sm4, iv);
+        /* Move counter on by number of whole blocks before offset. */
+        sm4_add_counter(sm4->iv, offset / SM4_BLOCK_SIZE, SM4_BLOCK_SIZE);
+        if (partial != 0) {
+            /* Encrypt the counter of the block offset is in. */
+            sm4_encrypt(SM4_KS(sm4), sm4->iv, sm4->tmp);
+            /* Increment counter for next block. */
+            sm4_increment_counter(sm4->iv);
+            /* Bytes of block after offset are unused. */
+            sm4->unused = (byte)(SM4_BLOCK_SIZE - partial);
+        }
+    }
+
+    return ret;
+}
+
+#endif /* WOLFSSL_SM4_CTR */
+
+#ifdef WOLFSSL_SM4_CFB
+
+#ifdef SM4_PARALLEL
+/* Decrypt blocks using SM4-CFB in parallel.
+ *
+ * The feedback is the cipher text so all blocks are encrypted in parallel.
+ *
+ * @param [in]      ks      Key schedule.
+ * @param [in, out] iv      Feedback for first block. Next feedback on return.
+ * @param [out]     out     Byte array in which to place decrypted data.
+ * @param [in]      in      Array of bytes to decrypt.
+ * @param [in]      blocks  Number of blocks to decrypt.
+ */
+static void sm4_cfb_decrypt_par(const word32* ks, byte* iv, byte* out,
+    const byte* in, word32 blocks)
+{
+    ALIGN16 byte tmp[SM4_PAR_BLOCKS * SM4_BLOCK_SIZE];
+
+    while (blocks > 0) {
+        word32 n = min(blocks, SM4_PAR_BLOCKS);
+        word32 len = n * SM4_BLOCK_SIZE;
+
+        /* Feedback is IV and then all but the last cipher text block. */
+        XMEMCPY(tmp, iv, SM4_BLOCK_SIZE);
+        XMEMCPY(tmp + SM4_BLOCK_SIZE, in, len - SM4_BLOCK_SIZE);
+        /* Last cipher text block is next IV - copy before output written. */
+        XMEMCPY(iv, in + len - SM4_BLOCK_SIZE, SM4_BLOCK_SIZE);
+        /* Encrypt the feedback and XOR with cipher text into output. */
+        sm4_blocks(ks, tmp, tmp, n);
+        xorbufout(out, in, tmp, len);
+
+        /* Move on to next blocks. */
+        in += len;
+        out += len;
+        blocks -= n;
+    }
+
+    ForceZero(tmp, sizeof(tmp));
+}
+
+/* Decrypt bytes using SM4-CFB8 in parallel.
+ *
+ * The feedback of each byte is the previous 16 bytes of cipher text so a
+ * block is encrypted in parallel for each byte.
+ *
+ * @param [in]      ks   Key schedule.
+ * @param [in, out] iv   Feedback for first byte. Next feedback on return.
+ * @param [out]     out  Byte array in which to place decrypted data.
+ * @param [in]      in   Array of bytes to decrypt.
+ * @param [in]      sz   Number of bytes to decrypt.
+ */
+static void sm4_cfb8_decrypt_par(const word32* ks, byte* iv, byte* out,
+    const byte* in, word32 sz)
+{
+    ALIGN16 byte tmp[SM4_PAR_BLOCKS * SM4_BLOCK_SIZE];
+    byte fb[SM4_BLOCK_SIZE + SM4_PAR_BLOCKS];
+    word32 i;
+
+    while (sz > 0) {
+        word32 n = min(sz, SM4_PAR_BLOCKS);
+
+        /* Cipher text to take feedback from - IV then input. */
+        XMEMCPY(fb, iv, SM4_BLOCK_SIZE);
+        XMEMCPY(fb + SM4_BLOCK_SIZE, in, n);
+        for (i = 0; i < n; i++) {
+            XMEMCPY(tmp + i * SM4_BLOCK_SIZE, fb + i, SM4_BLOCK_SIZE);
+        }
+        /* Last 16 bytes of cipher text is next IV. */
+        XMEMCPY(iv, fb + n, SM4_BLOCK_SIZE);
+        /* Encrypt the feedback and XOR first byte with cipher text. */
+        sm4_blocks(ks, tmp, tmp, n);
+        for (i = 0; i < n; i++) {
+            out[i] = in[i] ^ tmp[i * SM4_BLOCK_SIZE];
+        }
+
+        /* Move on to next bytes. */
+        in += n;
+        out += n;
+        sz -= n;
+    }
+
+    ForceZero(tmp, sizeof(tmp));
+}
+#endif
+
+/* XOR encrypted feedback with bytes and put cipher text into feedback.
+ *
+ * @param [in, out] sm4  SM4 algorithm object.
+ * @param [out]     out  Byte array in which to place output.
+ * @param [in]      in   Array of bytes to encrypt/decrypt.
+ * @param [in]      off  Offset into block of first byte.
+ * @param [in]      len  Number of bytes. No more than to end of block.
+ * @param [in]      dec  Whether decrypting.
+ */
+static void sm4_cfb_xor(wc_Sm4* sm4, byte* out, const byte* in, word32 off,
+    word32 len, int dec)
+{
+    if (dec) {
+        /* Input is cipher text - copy before output written. */
+        XMEMCPY(sm4->iv + off, in, len);
+        xorbufout(out, in, sm4->tmp + off, len);
+    }
+    else {
+        /* Output is cipher text. */
+        xorbufout(out, in, sm4->tmp + off, len);
+        XMEMCPY(sm4->iv + off, out, len);
+    }
+}
+
+/* Encrypt or decrypt bytes using SM4-CFB with 128-bit feedback.
+ *
+ * Assumes out is at least sz bytes long.
+ *
+ * @param [in]  sm4  SM4 algorithm object.
+ * @param [out] out  Byte array in which to place output.
+ * @param [in]  in   Array of bytes to encrypt/decrypt.
+ * @param [in]  sz   Number of bytes to encrypt/decrypt.
+ * @param [in]  dec  Whether decrypting.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4, out or in is NULL.
+ * @return  MISSING_KEY when a key has not been set.
+ * @return  MISSING_IV when an IV has not been set.
+ */
+static int sm4_cfb(wc_Sm4* sm4, byte* out, const byte* in, word32 sz, int dec)
+{
+    int ret = 0;
+
+    /* Validate parameters. */
+    if ((sm4 == NULL) || (in == NULL) || (out == NULL)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    /* Ensure a key and IV have been set. */
+    if ((ret == 0) && (!sm4->keySet)) {
+        ret = MISSING_KEY;
+    }
+    if ((ret == 0) && (!sm4->ivSet)) {
+        ret = MISSING_IV;
+    }
+
+    /* Continue if no error and bytes to encrypt/decrypt. */
+    if ((ret == 0) && (sz > 0)) {
+        /* Check for unused bytes from previous encrypted feedback. */
+        if (sm4->unused != 0) {
+            /* Calculate maximum length that can be processed. */
+            word32 len = min(sm4->unused, sz);
+
+            sm4_cfb_xor(sm4, out, in, SM4_BLOCK_SIZE - sm4->unused, len, dec);
+
+            /* Move over processed data. */
+            in += len;
+            out += len;
+            sz -= len;
+            /* Some or all unused bytes used up. */
+            sm4->unused -= (byte)len;
+        }
+
+    #ifdef SM4_PARALLEL
+        if (dec && (sz >= SM4_BLOCK_SIZE) && sm4_par_avail()) {
+            word32 len = sz & (~(word32)(SM4_BLOCK_SIZE - 1));
+
+            /* Decrypt all blocks in parallel. */
+            sm4_cfb_decrypt_par(SM4_KS(sm4), sm4->iv, out, in,
+                len / SM4_BLOCK_SIZE);
+            in += len;
+            out += len;
+            sz -= len;
+        }
+    #endif
+        /* Do blocks at a time - only get here when there are no unused bytes.
+         */
+        while (sz >= SM4_BLOCK_SIZE) {
+            /* Encrypt the feedback into temporary buffer in object. */
+            sm4_encrypt(SM4_KS(sm4), sm4->iv, sm4->tmp);
+            sm4_cfb_xor(sm4, out, in, 0, SM4_BLOCK_SIZE, dec);
+
+            /* Move on to next block. */
+            in += SM4_BLOCK_SIZE;
+            out += SM4_BLOCK_SIZE;
+            sz -= SM4_BLOCK_SIZE;
+        }
+
+        /* Check for less than a block of data to process. */
+        if (sz > 0) {
+            /* Encrypt the feedback into temporary buffer in object. */
+            sm4_encrypt(SM4_KS(sm4), sm4->iv, sm4->tmp);
+            sm4_cfb_xor(sm4, out, in, 0, sz, dec);
+            /* Record number of unused encrypted feedback bytes. */
+            sm4->unused = (byte)(SM4_BLOCK_SIZE - sz);
+        }
+    }
+
+    return ret;
+}
+
+/* Encrypt bytes using SM4-CFB with 128-bit feedback.
+ *
+ * Data may be passed in pieces of any length.
+ * Assumes out is at least sz bytes long.
+ *
+ * @param [in]  sm4  SM4 algorithm object.
+ * @param [out] out  Byte array in which to place encrypted data.
+ * @param [in]  in   Array of bytes to encrypt.
+ * @param [in]  sz   Number of bytes to encrypt.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4, out or in is NULL.
+ * @return  MISSING_KEY when a key has not been set.
+ * @return  MISSING_IV when an IV has not been set.
+ */
+int wc_Sm4CfbEncrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz)
+{
+    return sm4_cfb(sm4, out, in, sz, 0);
+}
+
+/* Decrypt bytes using SM4-CFB with 128-bit feedback.
+ *
+ * Data may be passed in pieces of any length.
+ * Assumes out is at least sz bytes long.
+ *
+ * @param [in]  sm4  SM4 algorithm object.
+ * @param [out] out  Byte array in which to place decrypted data.
+ * @param [in]  in   Array of bytes to decrypt.
+ * @param [in]  sz   Number of bytes to decrypt.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4, out or in is NULL.
+ * @return  MISSING_KEY when a key has not been set.
+ * @return  MISSING_IV when an IV has not been set.
+ */
+int wc_Sm4CfbDecrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz)
+{
+    return sm4_cfb(sm4, out, in, sz, 1);
+}
+
+/* Encrypt or decrypt bytes using SM4-CFB with 8-bit feedback.
+ *
+ * Assumes out is at least sz bytes long.
+ *
+ * @param [in]  sm4  SM4 algorithm object.
+ * @param [out] out  Byte array in which to place output.
+ * @param [in]  in   Array of bytes to encrypt/decrypt.
+ * @param [in]  sz   Number of bytes to encrypt/decrypt.
+ * @param [in]  dec  Whether decrypting.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4, out or in is NULL.
+ * @return  MISSING_KEY when a key has not been set.
+ * @return  MISSING_IV when an IV has not been set.
+ */
+static int sm4_cfb8(wc_Sm4* sm4, byte* out, const byte* in, word32 sz,
+    int dec)
+{
+    int ret = 0;
+
+    /* Validate parameters. */
+    if ((sm4 == NULL) || (in == NULL) || (out == NULL)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    /* Ensure a key and IV have been set. */
+    if ((ret == 0) && (!sm4->keySet)) {
+        ret = MISSING_KEY;
+    }
+    if ((ret == 0) && (!sm4->ivSet)) {
+        ret = MISSING_IV;
+    }
+
+    if (ret == 0) {
+    #ifdef SM4_PARALLEL
+        if (dec && sm4_par_avail()) {
+            /* Decrypt all bytes in parallel. */
+            sm4_cfb8_decrypt_par(SM4_KS(sm4), sm4->iv, out, in, sz);
+            sz = 0;
+        }
+    #endif
+        while (sz > 0) {
+            /* Cipher text byte. */
+            byte c;
+
+            /* Encrypt the feedback into temporary buffer in object. */
+            sm4_encrypt(SM4_KS(sm4), sm4->iv, sm4->tmp);
+            /* Input is cipher text when decrypting. */
+            c = *in;
+            *out = *in ^ sm4->tmp[0];
+            if (!dec) {
+                c = *out;
+            }
+            /* Shift cipher text byte into feedback. */
+            XMEMMOVE(sm4->iv, sm4->iv + 1, SM4_BLOCK_SIZE - 1);
+            sm4->iv[SM4_BLOCK_SIZE - 1] = c;
+
+            /* Move on to next byte. */
+            in++;
+            out++;
+            sz--;
+        }
+    }
+
+    return ret;
+}
+
+/* Encrypt bytes using SM4-CFB with 8-bit feedback.
+ *
+ * Assumes out is at least sz bytes long.
+ *
+ * @param [in]  sm4  SM4 algorithm object.
+ * @param [out] out  Byte array in which to place encrypted data.
+ * @param [in]  in   Array of bytes to encrypt.
+ * @param [in]  sz   Number of bytes to encrypt.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4, out or in is NULL.
+ * @return  MISSING_KEY when a key has not been set.
+ * @return  MISSING_IV when an IV has not been set.
+ */
+int wc_Sm4Cfb8Encrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz)
+{
+    return sm4_cfb8(sm4, out, in, sz, 0);
+}
+
+/* Decrypt bytes using SM4-CFB with 8-bit feedback.
+ *
+ * Assumes out is at least sz bytes long.
+ *
+ * @param [in]  sm4  SM4 algorithm object.
+ * @param [out] out  Byte array in which to place decrypted data.
+ * @param [in]  in   Array of bytes to decrypt.
+ * @param [in]  sz   Number of bytes to decrypt.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4, out or in is NULL.
+ * @return  MISSING_KEY when a key has not been set.
+ * @return  MISSING_IV when an IV has not been set.
+ */
+int wc_Sm4Cfb8Decrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz)
+{
+    return sm4_cfb8(sm4, out, in, sz, 1);
+}
+
+#endif /* WOLFSSL_SM4_CFB */
+
+#ifdef WOLFSSL_SM4_OFB
+
+/* Encrypt bytes using SM4-OFB.
+ *
+ * Decryption is the same operation.
+ * Data may be passed in pieces of any length.
+ * Assumes out is at least sz bytes long.
+ *
+ * @param [in]  sm4  SM4 algorithm object.
+ * @param [out] out  Byte array in which to place encrypted data.
+ * @param [in]  in   Array of bytes to encrypt.
+ * @param [in]  sz   Number of bytes to encrypt.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4, out or in is NULL.
+ * @return  MISSING_KEY when a key has not been set.
+ * @return  MISSING_IV when an IV has not been set.
+ */
+int wc_Sm4OfbEncrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz)
+{
+    int ret = 0;
+
+    /* Validate parameters. */
+    if ((sm4 == NULL) || (in == NULL) || (out == NULL)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    /* Ensure a key and IV have been set. */
+    if ((ret == 0) && (!sm4->keySet)) {
+        ret = MISSING_KEY;
+    }
+    if ((ret == 0) && (!sm4->ivSet)) {
+        ret = MISSING_IV;
+    }
+
+    /* Continue if no error and bytes to encrypt. */
+    if ((ret == 0) && (sz > 0)) {
+        /* Check for unused bytes from previous encrypted IV. */
+        if (sm4->unused != 0) {
+            /* Calculate maximum length that can be encrypted. */
+            word32 len = min(sm4->unused, sz);
+
+            /* XOR the encrypted IV with input into output. */
+            xorbufout(out, in, sm4->iv + SM4_BLOCK_SIZE - sm4->unused, len);
+
+            /* Move over processed data. */
+            in += len;
+            out += len;
+            sz -= len;
+            /* Some or all unused bytes used up. */
+            sm4->unused -= (byte)len;
+        }
+
+        /* Each block of key stream is the encryption of the previous one -
+         * can't be done in parallel. */
+        while (sz >= SM4_BLOCK_SIZE) {
+            /* Encrypted IV is key stream and next IV. */
+            sm4_encrypt(SM4_KS(sm4), sm4->iv, sm4->iv);
+            /* XOR the encrypted IV with next block into output. */
+            xorbufout(out, in, sm4->iv, SM4_BLOCK_SIZE);
+
+            /* Move on to next block. */
+            in += SM4_BLOCK_SIZE;
+            out += SM4_BLOCK_SIZE;
+            sz -= SM4_BLOCK_SIZE;
+        }
+
+        /* Check for less than a block of data that needs to be encrypted. */
+        if (sz > 0) {
+            /* Encrypted IV is key stream and next IV. */
+            sm4_encrypt(SM4_KS(sm4), sm4->iv, sm4->iv);
+            /* XOR the encrypted IV with remaining data into output. */
+            xorbufout(out, in, sm4->iv, sz);
+            /* Record number of unused encrypted IV bytes. */
+            sm4->unused = (byte)(SM4_BLOCK_SIZE - sz);
+        }
+    }
+
+    return ret;
+}
+
+#endif /* WOLFSSL_SM4_OFB */
+
+#ifdef WOLFSSL_SM4_GCM
+/* Increment counter for GCM.
+ *
+ * @param [in, out] counter  4-byte big endian number.
+ */
+static WC_INLINE void sm4_increment_gcm_counter(byte* counter)
+{
+    int i;
+
+    /* Big-endian number in last 4 bytes. */
+    for (i = SM4_BLOCK_SIZE - 1; i >= SM4_BLOCK_SIZE - CTR_SZ; i--) {
+        /* Increment byte and check for carry. */
+        if ((++counter[i]) != 0) {
+            /* No carry - done. */
+            break;
+        }
+    }
+}
+
+#if defined(WOLFSSL_SM4_THREADS) || defined(WOLFSSL_SM_IOV) || \
+    defined(WOLFSSL_SM4_GHASH)
+/* Set the GHASH lengths block.
+ *
+ * @param [out] r    Lengths block - lengths in bits as 64-bit big-endian.
+ * @param [in]  aSz  Length of additional authentication data in bytes.
+ * @param [in]  cSz  Length of cipher text in bytes.
+ */
+static void sm4_gcm_set_len(byte* r, word32 aSz, word32 cSz)
+{
+    word64 aBits = (word64)aSz * 8;
+    word64 cBits = (word64)cSz * 8;
+    int i;
+
+    for (i = 7; i >= 0; i--) {
+        r[i] = (byte)aBits;
+        r[i + 8] = (byte)cBits;
+        aBits >>= 8;
+        cBits >>= 8;
+    }
+}
+#endif
+
+/* Calculate GHASH on additional authentication data and cipher text.
+ *
+ * @param [in]  sm4    SM4 algorithm object.
+ * @param [in]  aad    Additional authentication data. May be NULL.
+ * @param [in]  aadSz  Length of additional authentication data in bytes.
+ * @param [in]  c      Cipher text.
+ * @param [in]  cSz    Length of cipher text in bytes.
+ * @param [out] s      GHASH result. SM4_BLOCK_SIZE bytes.
+ */
+static void sm4_gcm_ghash(wc_Sm4* sm4, const byte* aad, word32 aadSz,
+    const byte* c, word32 cSz, byte* s)
+{
+#ifdef WOLFSSL_SM4_GHASH
+    ALIGN16 byte l[SM4_BLOCK_SIZE];
+
+    XMEMSET(s, 0, SM4_BLOCK_SIZE);
+    sm4_ghash_update(SM4_HPOW(sm4), s, aad, aadSz);
+    sm4_ghash_update(SM4_HPOW(sm4), s, c, cSz);
+    /* Hash in lengths block. */
+    sm4_gcm_set_len(l, aadSz, cSz);
+    sm4_ghash_blocks(SM4_HPOW(sm4), s, l, 1);
+#else
+    GHASH(SM4_GCM(sm4), aad, aadSz, c, cSz, s, SM4_BLOCK_SIZE);
+#ifdef WOLFSSL_ARMASM
+    GMULT(s, SM4_GCM(sm4)->H);
+#endif
+#endif
+}
+
+/* Calculate the initial counter of a packet for SM4-GCM.
+ *
+ * @param [in]  sm4      SM4 algorithm object.
+ * @param [in]  nonce    Array of bytes holding nonce.
+ * @param [in]  nonceSz  Length of nonce in bytes.
+ * @param [out] counter  Initial counter.
+ */
+static void sm4_gcm_init_counter(wc_Sm4* sm4, const byte* nonce,
+    word32 nonceSz, byte* counter)
+{
+    if (nonceSz == GCM_NONCE_MID_SZ) {
+        /* Counter is nonce with bottom 4 bytes set to: 0x00,0x00,0x00,0x01. */
+        XMEMCPY(counter, nonce, nonceSz);
+        XMEMSET(counter + GCM_NONCE_MID_SZ, 0, CTR_SZ - 1);
+        counter[SM4_BLOCK_SIZE - 1] = 1;
+    }
+    else {
+        /* Counter is GHASH of nonce. */
+        sm4_gcm_ghash(sm4, NULL, 0, nonce, nonceSz, counter);
+    }
+}
+
+#ifdef SM4_PARALLEL
+/* Encrypt blocks using the CTR part of SM4-GCM in parallel.
+ *
+ * Counters are encrypted in parallel.
+ *
+ * @param [in]      sm4      SM4 algorithm object.
+ * @param [in, out] counter  Last counter used.
+ * @param [out]     out      Byte array in which to place encrypted data.
+ * @param [in]      in       Array of bytes to encrypt.
+ * @param [in]      blocks   Number of blocks to encrypt.
+ */
+static void sm4_gcm_ctr_par(wc_Sm4* sm4, byte* counter, byte* out,
+    const byte* in, word32 blocks)
+{
+    ALIGN16 byte ctr[SM4_PAR_BLOCKS * SM4_BLOCK_SIZE];
+
+    while (blocks > 0) {
+        word32 n = min(blocks, SM4_PAR_BLOCKS);
+        word32 i;
+
+        /* Increment last 4 bytes of big-endian counter and set. */
+        for (i = 0; i < n; i++) {
+            sm4_increment_gcm_counter(counter);
+            XMEMCPY(ctr + i * SM4_BLOCK_SIZE, counter, SM4_BLOCK_SIZE);
+        }
+        /* Encrypt the counters and XOR with input into output. */
+        sm4_blocks(SM4_KS(sm4), ctr, ctr, n);
+        xorbufout(out, in, ctr, n * SM4_BLOCK_SIZE);
+
+        /* Move on to next blocks. */
+        in += n * SM4_BLOCK_SIZE;
+        out += n * SM4_BLOCK_SIZE;
+        blocks -= n;
+    }
+
+    ForceZero(ctr, sizeof(ctr));
+}
+#endif
+
+/* Encrypt bytes using SM4-GCM implementation in C.
+ *
+ * @param [in]  sm4      SM4 algorithm object.
+ * @param [out] out      Byte array in which to place encrypted data.
+ * @param [in]  in       Array of bytes to encrypt.
+ * @param [in]  sz       Number of bytes to encrypt.
+ * @param [in]  nonce    Array of bytes holding nonce.
+ * @param [in]  nonceSz  Length of nonce in bytes.
+ * @param [out] tag      Authentication tag calculated using GCM.
+ * @param [in]  tagSz    Length of authentication tag to calculate in bytes.
+ *                       Must be no more than SM4_BLOCK_SIZE.
+ * @param [in]  aad      Additional authentication data. May be NULL.
+ * @param [in]  aadSz    Length of additional authentication data in bytes.
+ */
+static void sm4_gcm_encrypt_c(wc_Sm4* sm4, byte* out, const byte* in, word32 sz,
+    const byte* nonce, word32 nonceSz, byte* tag, word32 tagSz,
+    const byte* aad, word32 aadSz)
+{
+    word32 blocks = sz / SM4_BLOCK_SIZE;
+    word32 partial = sz % SM4_BLOCK_SIZE;
+    byte* c = out;
+    ALIGN16 byte counter[SM4_BLOCK_SIZE];
+    ALIGN16 byte encCounter[SM4_BLOCK_SIZE];
+
+    /* Calculate the initial counter from the nonce. */
+    sm4_gcm_init_counter(sm4, nonce, nonceSz, counter);
+    /* Encrypt the initial counter for GMAC. */
+    sm4_encrypt(SM4_KS(sm4), counter, encCounter);
+
+#ifdef SM4_PARALLEL
+    if ((blocks > 0) && sm4_par_avail()) {
+        /* Encrypt all blocks in parallel. */
+        sm4_gcm_ctr_par(sm4, counter, c, in, blocks);
+        in += SM4_BLOCK_SIZE * blocks;
+        c += SM4_BLOCK_SIZE * blocks;
+    }
+    else
+#endif
+#if defined(WOLFSSL_SM4_ECB)
+    /* Encrypting multiple blocks at a time can be faster. */
+    if ((c != in) && (blocks > 0)) {
+        /* Set the counters for a multiple of block size into the output. */
+        while (blocks--) {
+            /* Increment last 4 bytes of big-endian counter. */
+            sm4_increment_gcm_counter(counter);
+            /* Copy into output. */
+            XMEMCPY(c, counter, SM4_BLOCK_SIZE);
+            /* Move output position past this block. */
+            c += SM4_BLOCK_SIZE;
+        }
+
+        /* Reset number of blocks. */
+        blocks = sz / SM4_BLOCK_SIZE;
+        /* Encrypt the counters. */
+        wc_Sm4EcbEncrypt(sm4, out, out, SM4_BLOCK_SIZE * blocks);
+        /* XOR in the plaintext to create cipher text. */
+        xorbuf(out, in, SM4_BLOCK_SIZE * blocks);
+        /* Step over handled plaintext */
+        in += SM4_BLOCK_SIZE * blocks;
+    }
+    else
+#endif /* HAVE_SM4_ECB */
+    {
+        ALIGN32 byte scratch[SM4_BLOCK_SIZE];
+
+        /* For each full block of data, encrypt. */
+        while (blocks--) {
+            /* Increment last 4 bytes of big-endian counter. */
+            sm4_increment_gcm_counter(counter);
+            /* Encrypt the counter into scratch. */
+            sm4_encrypt(SM4_KS(sm4), counter, scratch);
+            /* XOR encryted counter with plaintext into output. */
+            xorbufout(c, scratch, in, SM4_BLOCK_SIZE);
+            /* Move plaintext and cipher text position past this block. */
+            in += SM4_BLOCK_SIZE;
+            c += SM4_BLOCK_SIZE;
+        }
+    }
+
+    if (partial != 0) {
+        /* Increment last 4 bytes of big-endian counter. */
+        sm4_increment_gcm_counter(counter);
+        /* Encrypt the last counter. */
+        sm4_encrypt(SM4_KS(sm4), counter, counter);
+        /* XOR encryted counter with partial block plaintext into output. */
+        xorbufout(c, counter, in, partial);
+    }
+
+    /* Calculate GHASH on additional authentication data and cipher text. */
+    sm4_gcm_ghash(sm4, aad, aadSz, out, sz, counter);
+    XMEMCPY(tag, counter, tagSz);
+    /* XOR the encrypted initial counter into tag. */
+    xorbuf(tag, encCounter, tagSz);
+}
+
+/* Decrypt bytes using SM4-GCM implementation in C.
+ *
+ * @param [in]  sm4      SM4 algorithm object.
+ * @param [out] out      Byte array in which to place decrypted data.
+ * @param [in]  in       Array of bytes to decrypt.
+ * @param [in]  sz       Number of bytes to decrypt.
+ * @param [in]  nonce    Array of bytes holding initialization vector.
+ * @param [in]  nonceSz  Length of nonce in bytes.
+ * @param [in]  tag      Authentication tag calculated using GCM.
+ * @param [in]  tagSz    Length of authentication tag to calculate in bytes.
+ *                       Must be no more than SM4_BLOCK_SIZE.
+ * @param [in]  aad      Additional authentication data. May be NULL.
+ * @param [in]  aadSz    Length of additional authentication data in bytes.
+ * @return  0 on success.
+ * @return  SM4_GCM_AUTH_E when authentication tag calculated does not match
+ *          the one passed in.
+ */
+static int sm4_gcm_decrypt_c(wc_Sm4* sm4, byte* out, const byte* in, word32 sz,
+    const byte* nonce, word32 nonceSz, const byte* tag, word32 tagSz,
+    const byte* aad, word32 aadSz)
+{
+    int ret;
+    word32 blocks = sz / SM4_BLOCK_SIZE;
+    word32 partial = sz % SM4_BLOCK_SIZE;
+    byte* p = out;
+    ALIGN16 byte counter[SM4_BLOCK_SIZE];
+    ALIGN16 byte calcTag[SM4_BLOCK_SIZE];
+    ALIGN16 byte scratch[SM4_BLOCK_SIZE];
+    sword32 res;
+
+    /* Calculate the initial counter from the nonce. */
+    sm4_gcm_init_counter(sm4, nonce, nonceSz, counter);
+
+    /* Calculate GHASH on additional authentication data and cipher text. */
+    sm4_gcm_ghash(sm4, aad, aadSz, in, sz, calcTag);
+    /* Encrypt the initial counter. */
+    sm4_encrypt(SM4_KS(sm4), counter, scratch);
+    /* XOR the encrypted initial counter into calculated tag. */
+    xorbuf(calcTag, scratch, sizeof(calcTag));
+#ifdef WC_SM4_GCM_DEC_AUTH_EARLY
+    /* Compare tag and calculated tag in constant time. */
+    res = ConstantCompare(tag, calcTag, tagSz);
+    /* Create mask based on comparison result in constant time */
+    res = 0 - (sword32)(((word32)(0 - res)) >> 31U);
+    /* Mask error code to get return value. */
+    ret = res & SM4_GCM_AUTH_E;
+    /* Decrypt data when no error. */
+    if (ret == 0)
+#endif
+    {
+    #ifdef SM4_PARALLEL
+        if ((blocks > 0) && sm4_par_avail()) {
+            /* Decrypt all blocks in parallel. */
+            sm4_gcm_ctr_par(sm4, counter, p, in, blocks);
+            in += SM4_BLOCK_SIZE * blocks;
+            p += SM4_BLOCK_SIZE * blocks;
+        }
+        else
+    #endif
+    #if defined(WOLFSSL_SM4_ECB)
+        if ((in != p) && (blocks > 0)) {
+            /* Set the counters for a multiple of block size into the output. */
+            while (blocks--) {
+                /* Increment last 4 bytes of big-endian counter. */
+                sm4_increment_gcm_counter(counter);
+                /* Copy into output. */
+                XMEMCPY(p, counter, SM4_BLOCK_SIZE);
+                /* Move output position past this block. */
+                p += SM4_BLOCK_SIZE;
+            }
+
+            /* Reset number of blocks. */
+            blocks = sz / SM4_BLOCK_SIZE;
+            /* Encrypt the counters. */
+            wc_Sm4EcbEncrypt(sm4, out, out, SM4_BLOCK_SIZE * blocks);
+            /* XOR in the plaintext to create cipher text. */
+            xorbuf(out, in, SM4_BLOCK_SIZE * blocks);
+            /* Step over handled plaintext */
+            in += SM4_BLOCK_SIZE * blocks;
+        }
+        else
+    #endif /* WOLFSSL_SM4_ECB */
+        {
+            while (blocks--) {
+                /* Increment last 4 bytes of big-endian counter. */
+                sm4_increment_gcm_counter(counter);
+                /* Encrypt the counter into scratch. */
+                sm4_encrypt(SM4_KS(sm4), counter, scratch);
+                /* XOR encryted counter with cipher text into output. */
+                xorbufout(p, scratch, in, SM4_BLOCK_SIZE);
+                /* Move plaintext and cipher text position past this block. */
+                p += SM4_BLOCK_SIZE;
+                in += SM4_BLOCK_SIZE;
+            }
+        }
+
+        if (partial != 0) {
+            /* Increment last 4 bytes of big-endian counter. */
+            sm4_increment_gcm_counter(counter);
+            /* Encrypt the last counter. */
+            sm4_encrypt(SM4_KS(sm4), counter, counter);
+            /* XOR encryted counter with partial block cipher text into output.
+             */
+            xorbufout(p, counter, in, partial);
+        }
+
+    #ifndef WC_SM4_GCM_DEC_AUTH_EARLY
+        /* Compare tag and calculated tag in constant time. */
+        res = ConstantCompare(tag, calcTag, (int)tagSz);
+        /* Create mask based on comparison result in constant time */
+        res = 0 - (sword32)(((word32)(0 - res)) >> 31U);
+        /* Mask error code to get return value. */
+        ret = res & SM4_GCM_AUTH_E;
+    #endif
+    }
+    return ret;
+}
+
+/* Set the SM4-GCM key.
+ *
+ * Calculates key based table here.
+ * With WOLFSSL_SM4_SHARED_KEY_ONLY, wc_Sm4Free() must be called to free the
+ * key data.
+ *
+ * @param [in, out] sm4  SM4 algorithm object.
+ * @param [in]      key  Array of bytes representing key.
+ * @param [in]      len  Length of key. Must be SM4_KEY_SIZE.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4 or key is NULL.
+ * @return  BAD_FUNC_ARG when len is not SM4_KEY_SIZE.
+ * @return  MEMORY_E when dynamic memory allocation fails.
+ */
+int wc_Sm4GcmSetKey(wc_Sm4* sm4, const byte* key, word32 len)
+{
+    int ret = 0;
+    byte iv[SM4_BLOCK_SIZE];
+
+    /* Validate parameters. */
+    if ((sm4 == NULL) || (key == NULL) || (len != SM4_KEY_SIZE)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    if (ret == 0) {
+        /* Set key. */
+        ret = sm4_set_key(sm4, key);
+    }
+    if (ret == 0) {
+        /* Reset IV to all zeros. */
+        XMEMSET(iv, 0, sizeof(iv));
+        /* Set IV. */
+        sm4_set_iv(sm4, iv);
+    #ifndef WOLFSSL_SM4_SHARED_KEY_ONLY
+        /* Calculate H for GMAC operation */
+    #ifdef WOLFSSL_SM4_GHASH
+        sm4_gcm_calc_h(sm4->ks, sm4->hPow, iv);
+    #else
+        sm4_gcm_calc_h(sm4->ks, &sm4->gcm, iv);
+    #endif
+    #endif
+    }
+
+    return ret;
+}
+
+#if defined(WOLF_CRYPTO_CB) && defined(WOLFSSL_SM_BATCH_DEV)
+/* Encrypt or decrypt bytes using SM4-GCM on the batching device registered
+ * against the object's device id.
+ *
+ * Waits for the device to perform the request. Parameters have been
+ * validated.
+ *
+ * @param [in]      sm4      SM4 algorithm object with device id.
+ * @param [out]     out      Byte array in which to place output.
+ * @param [in]      in       Array of bytes to encrypt/decrypt.
+ * @param [in]      sz       Number of bytes to encrypt/decrypt.
+ * @param [in]      nonce    Array of bytes holding initialization vector.
+ * @param [in]      nonceSz  Length of nonce in bytes.
+ * @param [in, out] tag      Authentication tag. Only read when decrypting.
+ * @param [in]      tagSz    Length of authentication tag in bytes.
+ * @param [in]      aad      Additional authentication data. May be NULL.
+ * @param [in]      aadSz    Length of additional authentication data in
+ *                           bytes.
+ * @param [in]      type     WC_SM_BATCH_SM4_GCM_ENC or
+ *                           WC_SM_BATCH_SM4_GCM_DEC.
+ * @return  0 on success.
+ * @return  SM4_GCM_AUTH_E when decrypting and authentication tag calculated
+ *          does not match the one passed in.
+ * @return  CRYPTOCB_UNAVAILABLE when no batching device is registered against
+ *          the device id.
+ * @return  BAD_MUTEX_E when the registered devices can't be locked.
+ */
+static int sm4_gcm_batch_dev(wc_Sm4* sm4, byte* out, const byte* in,
+    word32 sz, const byte* nonce, word32 nonceSz, byte* tag, word32 tagSz,
+    const byte* aad, word32 aadSz, int type)
+{
+    wc_SmBatchReq req;
+
+    XMEMSET(&req, 0, sizeof(req));
+    req.type = type;
+    req.gcm.sm4 = sm4;
+    req.gcm.nonce = nonce;
+    req.gcm.nonceSz = nonceSz;
+    req.gcm.aad = aad;
+    req.gcm.aadSz = aadSz;
+    req.gcm.in = in;
+    req.gcm.out = out;
+    req.gcm.sz = sz;
+    req.gcm.tag = tag;
+    req.gcm.tagSz = tagSz;
+
+    return sm_batch_dev_run(sm4->devId, &req);
+}
+#endif
+
+/* Encrypt bytes using SM4-GCM.
+ *
+ * Assumes out is at least sz bytes long.
+ *
+ * @param [in]  sm4      SM4 algorithm object.
+ * @param [out] out      Byte array in which to place encrypted data.
+ * @param [in]  in       Array of bytes to encrypt.
+ * @param [in]  sz       Number of bytes to encrypt.
+ * @param [in]  nonce    Array of bytes holding initialization vector.
+ * @param [in]  nonceSz  Length of nonce in bytes.
+ * @param [out] tag      Authentication tag calculated using GCM.
+ * @param [in]  tagSz    Length of authentication tag to calculate in bytes.
+ *                       Must be no more than SM4_BLOCK_SIZE.
+ * @param [in]  aad      Additional authentication data. May be NULL.
+ * @param [in]  aadSz    Length of additional authentication data in bytes.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4, in, out, nonce or tag is NULL.
+ * @return  BAD_FUNC_ARG when authentication tag data length is less than
+ *          WOLFSSL_MIN_AUTH_TAG_SZ or is more than SM4_BLOCK_SIZE.
+ * @return  BAD_FUNC_ARG when nonce length is 0.
+ * @return  MISSING_KEY when a key has not been set.
+ */
+int wc_Sm4GcmEncrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz,
+    const byte* nonce, word32 nonceSz, byte* tag, word32 tagSz, const byte* aad,
+    word32 aadSz)
+{
+    int ret = 0;
+
+    /* Validate parameters. */
+    if ((sm4 == NULL) || ((sz != 0) && ((in == NULL) || (out == NULL))) ||
+            (nonce == NULL) || (tag == NULL)) {
+        ret = BAD_FUNC_ARG;
+    }
+    if ((tagSz < WOLFSSL_MIN_AUTH_TAG_SZ) || (tagSz > SM4_BLOCK_SIZE)) {
+        ret = BAD_FUNC_ARG;
+    }
+    if (nonceSz == 0) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    /* Ensure a key has been set. */
+    if ((ret == 0) && (!sm4->keySet)) {
+        ret = MISSING_KEY;
+    }
+
+    if (ret == 0) {
+    #ifdef OPENSSL_EXTRA
+        sm4->nonceSz = (int)nonceSz;
+    #endif
+    #if defined(WOLF_CRYPTO_CB) && defined(WOLFSSL_SM_BATCH_DEV)
+        ret = CRYPTOCB_UNAVAILABLE;
+        if (sm4->devId != INVALID_DEVID) {
+            /* Encrypt with packets of other threads on batching device. */
+            ret = sm4_gcm_batch_dev(sm4, out, in, sz, nonce, nonceSz, tag,
+                tagSz, aad, aadSz, WC_SM_BATCH_SM4_GCM_ENC);
+        }
+        if (ret == CRYPTOCB_UNAVAILABLE)
+    #endif
+        {
+            /* Perform encryption using C implementation. */
+            sm4_gcm_encrypt_c(sm4, out, in, sz, nonce, nonceSz, tag, tagSz,
+                aad, aadSz);
+            ret = 0;
+        }
+    }
+
+    return ret;
+}
+
+/* Decrypt bytes using SM4-GCM.
+ *
+ * Assumes out is at least sz bytes long.
+ *
+ * @param [in]  sm4      SM4 algorithm object.
+ * @param [out] out      Byte array in which to place decrypted data.
+ * @param [in]  in       Array of bytes to decrypt.
+ * @param [in]  sz       Number of bytes to decrypt.
+ * @param [in]  nonce    Array of bytes holding initialization vector.
+ * @param [in]  nonceSz  Length of nonce in bytes.
+ * @param [in]  tag      Authentication tag to compare against calculated.
+ * @param [in]  tagSz    Length of authentication tag in bytes.
+ *                       Must be no more than SM4_BLOCK_SIZE.
+ * @param [in]  aad      Additional authentication data. May be NULL.
+ * @param [in]  aadSz    Length of additional authentication data in bytes.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4, in, out, nonce or tag is NULL.
+ * @return  BAD_FUNC_ARG when authentication tag data length is less than
+ *          WOLFSSL_MIN_AUTH_TAG_SZ or is more than SM4_BLOCK_SIZE.
+ * @return  BAD_FUNC_ARG when nonce length is 0.
+ * @return  MISSING_KEY when a key has not been set.
+ * @return  SM4_GCM_AUTH_E when authentication tag calculated does not match
+ *          the one passed in.
+ */
+int wc_Sm4GcmDecrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz,
+    const byte* nonce, word32 nonceSz, const byte* tag, word32 tagSz,
+    const byte* aad, word32 aadSz)
+{
+    int ret = 0;
+
+    /* Validate parameters. */
+    if ((sm4 == NULL) || ((sz != 0) && ((in == NULL) || (out == NULL))) ||
+            (nonce == NULL) || (tag == NULL)) {
+        ret = BAD_FUNC_ARG;
+    }
+    if ((tagSz < WOLFSSL_MIN_AUTH_TAG_SZ) || (tagSz > SM4_BLOCK_SIZE)) {
+        ret = BAD_FUNC_ARG;
+    }
+    if (nonceSz == 0) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    /* Ensure a key has been set. */
+    if ((ret == 0) && (!sm4->keySet)) {
+        ret = MISSING_KEY;
+    }
+
+    if (ret == 0) {
+    #ifdef OPENSSL_EXTRA
+        sm4->nonceSz = (int)nonceSz;
+    #endif
+    #if defined(WOLF_CRYPTO_CB) && defined(WOLFSSL_SM_BATCH_DEV)
+        ret = CRYPTOCB_UNAVAILABLE;
+        if (sm4->devId != INVALID_DEVID) {
+            /* Decrypt with packets of other threads on batching device. */
+            ret = sm4_gcm_batch_dev(sm4, out, in, sz, nonce, nonceSz,
+                (byte*)tag, tagSz, aad, aadSz, WC_SM_BATCH_SM4_GCM_DEC);
+        }
+        if (ret == CRYPTOCB_UNAVAILABLE)
+    #endif
+        {
+            /* Perform decryption using C implementation. */
+            ret = sm4_gcm_decrypt_c(sm4, out, in, sz, nonce, nonceSz, tag,
+                tagSz, aad, aadSz);
+        }
+    }
+
+    return ret;
+}
+
+/* Calculate the SM4-GMAC authentication tag of data.
+ *
+ * GMAC is SM4-GCM with no data to encrypt.
+ * Key is set with wc_Sm4GcmSetKey().
+ *
+ * @param [in]  sm4      SM4 algorithm object.
+ * @param [in]  nonce    Array of bytes holding nonce.
+ * @param [in]  nonceSz  Length of nonce in bytes.
+ * @param [in]  aad      Data to authenticate. May be NULL when aadSz is 0.
+ * @param [in]  aadSz    Length of data in bytes.
+ * @param [out] tag      Authentication tag calculated using GMAC.
+ * @param [in]  tagSz    Length of authentication tag to calculate in bytes.
+ *                       Must be no more than SM4_BLOCK_SIZE.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4, nonce or tag is NULL.
+ * @return  BAD_FUNC_ARG when aad is NULL and aadSz is not 0.
+ * @return  BAD_FUNC_ARG when authentication tag data length is less than
+ *          WOLFSSL_MIN_AUTH_TAG_SZ or is more than SM4_BLOCK_SIZE.
+ * @return  BAD_FUNC_ARG when nonce length is 0.
+ * @return  MISSING_KEY when a key has not been set.
+ */
+int wc_Sm4Gmac(wc_Sm4* sm4, const byte* nonce, word32 nonceSz,
+    const byte* aad, word32 aadSz, byte* tag, word32 tagSz)
+{
+    int ret = 0;
+
+    /* Validate parameters not checked by GCM. */
+    if ((aad == NULL) && (aadSz != 0)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    if (ret == 0) {
+        ret = wc_Sm4GcmEncrypt(sm4, NULL, NULL, 0, nonce, nonceSz, tag, tagSz,
+            aad, aadSz);
+    }
+
+    return ret;
+}
+
+/* Verify the SM4-GMAC authentication tag of data.
+ *
+ * GMAC is SM4-GCM with no data to decrypt.
+ * Key is set with wc_Sm4GcmSetKey().
+ *
+ * @param [in] sm4      SM4 algorithm object.
+ * @param [in] nonce    Array of bytes holding nonce.
+ * @param [in] nonceSz  Length of nonce in bytes.
+ * @param [in] aad      Data to authenticate. May be NULL when aadSz is 0.
+ * @param [in] aadSz    Length of data in bytes.
+ * @param [in] tag      Authentication tag to compare against calculated.
+ * @param [in] tagSz    Length of authentication tag in bytes.
+ *                      Must be no more than SM4_BLOCK_SIZE.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4, nonce or tag is NULL.
+ * @return  BAD_FUNC_ARG when aad is NULL and aadSz is not 0.
+ * @return  BAD_FUNC_ARG when authentication tag data length is less than
+ *          WOLFSSL_MIN_AUTH_TAG_SZ or is more than SM4_BLOCK_SIZE.
+ * @return  BAD_FUNC_ARG when nonce length is 0.
+ * @return  MISSING_KEY when a key has not been set.
+ * @return  SM4_GCM_AUTH_E when authentication tag calculated does not match
+ *          the one passed in.
+ */
+int wc_Sm4GmacVerify(wc_Sm4* sm4, const byte* nonce, word32 nonceSz,
+    const byte* aad, word32 aadSz, const byte* tag, word32 tagSz)
+{
+    int ret = 0;
+
+    /* Validate parameters not checked by GCM. */
+    if ((aad == NULL) && (aadSz != 0)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    if (ret == 0) {
+        ret = wc_Sm4GcmDecrypt(sm4, NULL, NULL, 0, nonce, nonceSz, tag, tagSz,
+            aad, aadSz);
+    }
+
+    return ret;
+}
+
+/* Blocks of packets in a burst to encrypt or decrypt with SM4-GCM. */
+typedef struct Sm4GcmBurst {
+    /* Counters to encrypt. Key stream once encrypted. */
+    ALIGN16 byte ctr[SM4_MK_BLOCKS * SM4_BLOCK_SIZE];
+    /* GHASH of cipher text at initial counter blocks when decrypting. */
+    ALIGN16 byte s[SM4_MK_BLOCKS * SM4_BLOCK_SIZE];
+    /* Key schedule of each block. */
+    const word32* mks[SM4_MK_BLOCKS];
+    /* Packet of each block. */
+    wc_Sm4GcmPacket* pkt[SM4_MK_BLOCKS];
+    /* Offset into packet data of each block. */
+    word32 off[SM4_MK_BLOCKS];
+    /* Number of bytes of packet data for each block. 0 for initial counter. */
+    byte len[SM4_MK_BLOCKS];
+    /* Number of blocks ready to encrypt. */
+    word32 n;
+    /* Encrypting packets when 1, decrypting when 0. */
+    int enc;
+} Sm4GcmBurst;
+
+#if defined(WOLFSSL_SM4_THREADS) || defined(WOLFSSL_SM_IOV)
+/* Multiply two numbers in GF(2^128) as defined for GCM.
+ *
+ * Only operations whose timing doesn't depend on the data are used.
+ *
+ * @param [in, out] x  First number. Result on return.
+ * @param [in]      y  Second number.
+ */
+static void sm4_gf_mul(byte* x, const byte* y)
+{
+    word64 x0 = 0, x1 = 0;
+    word64 v0 = 0, v1 = 0;
+    word64 z0 = 0, z1 = 0;
+    word64 m;
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        x0 = (x0 << 8) | x[i];
+        x1 = (x1 << 8) | x[i + 8];
+        v0 = (v0 << 8) | y[i];
+        v1 = (v1 << 8) | y[i + 8];
+    }
+    for (i = 0; i < 128; i++) {
+        /* Add V when bit of X is set - most significant bit first. */
+        m = (word64)0 - ((i < 64) ? (x0 >> (63 - i)) & 1 :
+                                    (x1 >> (127 - i)) & 1);
+        z0 ^= v0 & m;
+        z1 ^= v1 & m;
+        /* Multiply V by x and reduce. */
+        m = (word64)0 - (v1 & 1);
+        v1 = (v1 >> 1) | (v0 << 63);
+        v0 = (v0 >> 1) ^ (W64LIT(0xE100000000000000) & m);
+    }
+    for (i = 7; i >= 0; i--) {
+        x[i] = (byte)z0;
+        x[i + 8] = (byte)z1;
+        z0 >>= 8;
+        z1 >>= 8;
+    }
+}
+#endif
+
+/* Encrypt the counters of the burst and apply to the packets.
+ *
+ * Tags are calculated or checked at the initial counter block of a packet.
+ *
+ * @param [in, out] b  Burst of blocks.
+ */
+static void sm4_gcm_burst_flush(Sm4GcmBurst* b)
+{
+    word32 i;
+
+    /* Encrypt counters of all packets together. */
+    sm4_blocks_mk(b->mks, b->ctr, b->ctr, b->n);
+
+    for (i = 0; i < b->n; i++) {
+        wc_Sm4GcmPacket* pkt = b->pkt[i];
+        byte* ks = b->ctr + i * SM4_BLOCK_SIZE;
+
+        if (b->len[i] != 0) {
+        #ifdef WC_SM4_GCM_DEC_AUTH_EARLY
+            /* Only decrypt when tag matches. */
+            if (pkt->ret == 0)
+        #endif
+            {
+                /* XOR key stream with input into output. */
+                xorbufout(pkt->out + b->off[i], ks, pkt->in + b->off[i],
+                    b->len[i]);
+            }
+        }
+        else if (b->enc) {
+            /* Encrypted initial counter is XORed into GHASH for tag. */
+            XMEMCPY(pkt->tag, ks, pkt->tagSz);
+        }
+        else {
+            byte* calcTag = b->s + i * SM4_BLOCK_SIZE;
+            sword32 res;
+
+            /* XOR the encrypted initial counter into calculated tag. */
+            xorbuf(calcTag, ks, SM4_BLOCK_SIZE);
+            /* Compare tag and calculated tag in constant time. */
+            res = ConstantCompare(pkt->tag, calcTag, (int)pkt->tagSz);
+            /* Create mask based on comparison result in constant time */
+            res = 0 - (sword32)(((word32)(0 - res)) >> 31U);
+            /* Mask error code to get return value. */
+            pkt->ret = res & SM4_GCM_AUTH_E;
+        }
+
+        /* Complete tag when last block of encrypted packet. */
+        if (b->enc && (b->off[i] + b->len[i] == pkt->sz)) {
+            ALIGN16 byte s[SM4_BLOCK_SIZE];
+
+            /* Calculate GHASH on additional authentication data and cipher
+             * text. */
+            sm4_gcm_ghash(pkt->sm4, pkt->aad, pkt->aadSz, pkt->out, pkt->sz,
+                s);
+            xorbuf(pkt->tag, s, pkt->tagSz);
+        }
+    }
+
+    b->n = 0;
+    ForceZero(b->ctr, sizeof(b->ctr));
+}
+
+/* Add the blocks of a packet to the burst.
+ *
+ * Counters are encrypted when the burst is full.
+ *
+ * @param [in, out] b    Burst of blocks.
+ * @param [in, out] pkt  Packet to encrypt or decrypt.
+ */
+static void sm4_gcm_burst_add(Sm4GcmBurst* b, wc_Sm4GcmPacket* pkt)
+{
+    const word32* ks = SM4_KS(pkt->sm4);
+    ALIGN16 byte counter[SM4_BLOCK_SIZE];
+    word32 off;
+
+    sm4_gcm_init_counter(pkt->sm4, pkt->nonce, pkt->nonceSz, counter);
+
+    if (b->n == SM4_MK_BLOCKS) {
+        sm4_gcm_burst_flush(b);
+    }
+    /* Initial counter block is encrypted for tag. */
+    XMEMCPY(b->ctr + b->n * SM4_BLOCK_SIZE, counter, SM4_BLOCK_SIZE);
+    b->mks[b->n] = ks;
+    b->pkt[b->n] = pkt;
+    b->off[b->n] = 0;
+    b->len[b->n] = 0;
+    if (!b->enc) {
+        /* Cipher text is hashed before being decrypted. */
+        sm4_gcm_ghash(pkt->sm4, pkt->aad, pkt->aadSz, pkt->in, pkt->sz,
+            b->s + b->n * SM4_BLOCK_SIZE);
+    }
+    b->n++;
+
+    for (off = 0; off < pkt->sz; off += SM4_BLOCK_SIZE) {
+        if (b->n == SM4_MK_BLOCKS) {
+            sm4_gcm_burst_flush(b);
+        }
+        /* Increment last 4 bytes of big-endian counter and set. */
+        sm4_increment_gcm_counter(counter);
+        XMEMCPY(b->ctr + b->n * SM4_BLOCK_SIZE, counter, SM4_BLOCK_SIZE);
+        b->mks[b->n] = ks;
+        b->pkt[b->n] = pkt;
+        b->off[b->n] = off;
+        b->len[b->n] = (byte)min(pkt->sz - off, SM4_BLOCK_SIZE);
+        b->n++;
+    }
+
+    ForceZero(counter, sizeof(counter));
+}
+
+/* Encrypt or decrypt a burst of packets using SM4-GCM.
+ *
+ * @param [in, out] pkt  Array of packets.
+ * @param [in]      cnt  Number of packets.
+ * @param [in]      enc  1 to encrypt, 0 to decrypt.
+ * @return  0 when all packets were successful.
+ * @return  BAD_FUNC_ARG when pkt is NULL.
+ * @return  MEMORY_E when dynamic memory allocation fails.
+ * @return  Error of first packet that failed otherwise.
+ */
+static int sm4_gcm_burst(wc_Sm4GcmPacket* pkt, word32 cnt, int enc)
+{
+    int ret = 0;
+#ifdef WOLFSSL_SMALL_STACK
+    Sm4GcmBurst* b = NULL;
+#else
+    Sm4GcmBurst b[1];
+#endif
+    word32 i;
+
+    /* Validate parameters. */
+    if ((pkt == NULL) && (cnt > 0)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+#ifdef WOLFSSL_SMALL_STACK
+    if ((ret == 0) && (cnt > 0)) {
+        b = (Sm4GcmBurst*)XMALLOC(sizeof(Sm4GcmBurst), NULL,
+            DYNAMIC_TYPE_TMP_BUFFER);
+        if (b == NULL) {
+            ret = MEMORY_E;
+        }
+    }
+#endif
+    if ((ret == 0) && (cnt > 0)) {
+        b->n = 0;
+        b->enc = enc;
+
+        for (i = 0; i < cnt; i++) {
+            wc_Sm4GcmPacket* p = &pkt[i];
+
+            p->ret = 0;
+            /* Validate packet. */
+            if ((p->sm4 == NULL) ||
+                    ((p->sz != 0) && ((p->in == NULL) || (p->out == NULL))) ||
+                    (p->nonce == NULL) || (p->tag == NULL)) {
+                p->ret = BAD_FUNC_ARG;
+            }
+            if ((p->tagSz < WOLFSSL_MIN_AUTH_TAG_SZ) ||
+                    (p->tagSz > SM4_BLOCK_SIZE)) {
+                p->ret = BAD_FUNC_ARG;
+            }
+            if (p->nonceSz == 0) {
+                p->ret = BAD_FUNC_ARG;
+            }
+            /* Ensure a key has been set. */
+            if ((p->ret == 0) && (!p->sm4->keySet)) {
+                p->ret = MISSING_KEY;
+            }
+
+            if (p->ret == 0) {
+            #ifdef OPENSSL_EXTRA
+                p->sm4->nonceSz = (int)p->nonceSz;
+            #endif
+                sm4_gcm_burst_add(b, p);
+            }
+        }
+        if (b->n > 0) {
+            sm4_gcm_burst_flush(b);
+        }
+        ForceZero(b->s, sizeof(b->s));
+
+        /* Return error of first packet that failed. */
+        for (i = 0; (ret == 0) && (i < cnt); i++) {
+            ret = pkt[i].ret;
+        }
+    }
+
+#ifdef WOLFSSL_SMALL_STACK
+    XFREE(b, NULL, DYNAMIC_TYPE_TMP_BUFFER);
+#endif
+    return ret;
+}
+
+/* Encrypt a burst of packets using SM4-GCM.
+ *
+ * Each packet may use a different key. The counter blocks of all the packets
+ * are encrypted together - bitsliced implementation interleaves packets with
+ * different keys.
+ * The result of each packet is placed in its ret field.
+ *
+ * @param [in, out] pkt  Array of packets.
+ * @param [in]      cnt  Number of packets.
+ * @return  0 when all packets were encrypted.
+ * @return  BAD_FUNC_ARG when pkt is NULL.
+ * @return  MEMORY_E when dynamic memory allocation fails.
+ * @return  Error of first packet that failed otherwise.
+ */
+int wc_Sm4GcmEncryptBurst(wc_Sm4GcmPacket* pkt, word32 cnt)
+{
+    return sm4_gcm_burst(pkt, cnt, 1);
+}
+
+/* Decrypt a burst of packets using SM4-GCM.
+ *
+ * Each packet may use a different key. The counter blocks of all the packets
+ * are decrypted together - bitsliced implementation interleaves packets with
+ * different keys.
+ * The result of each packet is placed in its ret field. SM4_GCM_AUTH_E
+ * indicates the tag of the packet did not match.
+ *
+ * @param [in, out] pkt  Array of packets.
+ * @param [in]      cnt  Number of packets.
+ * @return  0 when all packets were decrypted and authenticated.
+ * @return  BAD_FUNC_ARG when pkt is NULL.
+ * @return  MEMORY_E when dynamic memory allocation fails.
+ * @return  Error of first packet that failed otherwise.
+ */
+int wc_Sm4GcmDecryptBurst(wc_Sm4GcmPacket* pkt, word32 cnt)
+{
+    return sm4_gcm_burst(pkt, cnt, 0);
+}
+
+#endif /* WOLFSSL_SM4_GCM */
+
+#if defined(WOLFSSL_SM4_THREADS) && \
+    (defined(WOLFSSL_SM4_CTR) || defined(WOLFSSL_SM4_GCM))
+
+/* Job is SM4-CTR encryption of blocks. */
+#define SM4_JOB_CTR             0x01
+/* Job is CTR part of SM4-GCM encryption/decryption. */
+#define SM4_JOB_GCM_CTR         0x02
+/* Job calculates GHASH of input before encryption/decryption. */
+#define SM4_JOB_GHASH_IN        0x04
+/* Job calculates GHASH of output after encryption. */
+#define SM4_JOB_GHASH_OUT       0x08
+
+/* Part of an SM4 operation that is performed by a thread. */
+typedef struct Sm4Job {
+    /* SM4 algorithm object. Only read by job. */
+    wc_Sm4* sm4;
+    /* Counter before first block of job. */
+    ALIGN16 byte ctr[SM4_BLOCK_SIZE];
+    /* GHASH of cipher text of job. */
+    ALIGN16 byte s[SM4_BLOCK_SIZE];
+    /* Output and input data of job and their length in bytes. */
+    byte* out;
+    const byte* in;
+    word32 sz;
+    /* Operations to perform - SM4_JOB_* flags. */
+    byte op;
+    /* Whether a thread was started for job. */
+    byte started;
+    /* Thread performing job. */
+    THREAD_TYPE tid;
+} Sm4Job;
+
+/* Perform the job.
+ *
+ * @param [in, out] job  Part of an SM4 operation.
+ */
+static void sm4_job_run(Sm4Job* job)
+{
+#ifdef WOLFSSL_SM4_GCM
+    if (job->op & SM4_JOB_GHASH_IN) {
+        /* Hash cipher text before it is decrypted. */
+        sm4_gcm_ghash(job->sm4, NULL, 0, job->in, job->sz, job->s);
+    }
+#endif
+#ifdef WOLFSSL_SM4_CTR
+    if (job->op & SM4_JOB_CTR) {
+        word32 blocks = job->sz / SM4_BLOCK_SIZE;
+
+    #ifdef SM4_PARALLEL
+        if (sm4_par_avail()) {
+            sm4_ctr_par(SM4_KS(job->sm4), job->ctr, job->out, job->in,
+                blocks);
+        }
+        else
+    #endif
+        {
+            ALIGN16 byte scratch[SM4_BLOCK_SIZE];
+            word32 i;
+
+            for (i = 0; i < blocks; i++) {
+                sm4_encrypt(SM4_KS(job->sm4), job->ctr, scratch);
+                xorbufout(job->out + i * SM4_BLOCK_SIZE, scratch,
+                    job->in + i * SM4_BLOCK_SIZE, SM4_BLOCK_SIZE);
+                sm4_increment_counter(job->ctr);
+            }
+            ForceZero(scratch, sizeof(scratch));
+        }
+    }
+#endif
+#ifdef WOLFSSL_SM4_GCM
+    if (job->op & SM4_JOB_GCM_CTR) {
+        word32 blocks = job->sz / SM4_BLOCK_SIZE;
+        word32 partial = job->sz % SM4_BLOCK_SIZE;
+        ALIGN16 byte scratch[SM4_BLOCK_SIZE];
+        byte* out = job->out;
+        const byte* in = job->in;
+
+    #ifdef SM4_PARALLEL
+        if ((blocks > 0) && sm4_par_avail()) {
+            sm4_gcm_ctr_par(job->sm4, job->ctr, out, in, blocks);
+            in += SM4_BLOCK_SIZE * blocks;
+            out += SM4_BLOCK_SIZE * blocks;
+            blocks = 0;
+        }
+    #endif
+        while (blocks--) {
+            sm4_increment_gcm_counter(job->ctr);
+            sm4_encrypt(SM4_KS(job->sm4), job->ctr, scratch);
+            xorbufout(out, scratch, in, SM4_BLOCK_SIZE);
+            in += SM4_BLOCK_SIZE;
+            out += SM4_BLOCK_SIZE;
+        }
+        if (partial != 0) {
+            sm4_increment_gcm_counter(job->ctr);
+            sm4_encrypt(SM4_KS(job->sm4), job->ctr, scratch);
+            xorbufout(out, scratch, in, partial);
+        }
+        ForceZero(scratch, sizeof(scratch));
+    }
+    if (job->op & SM4_JOB_GHASH_OUT) {
+        /* Hash cipher text once it is encrypted. */
+        sm4_gcm_ghash(job->sm4, NULL, 0, job->out, job->sz, job->s);
+    }
+#endif
+}
+
+/* Thread entry point that performs a job.
+ *
+ * @param [in, out] arg  Job to perform.
+ */
+static THREAD_RETURN WOLFSSL_THREAD sm4_job_thread(void* arg)
+{
+    sm4_job_run((Sm4Job*)arg);
+    WOLFSSL_RETURN_FROM_THREAD(0);
+}
+
+/* Perform jobs - all but the first in new threads.
+ *
+ * Jobs whose thread can't be started are performed in this thread.
+ *
+ * @param [in, out] jobs  Jobs to perform.
+ * @param [in]      cnt   Number of jobs.
+ */
+static void sm4_jobs_run(Sm4Job* jobs, word32 cnt)
+{
+    word32 i;
+
+    for (i = 1; i < cnt; i++) {
+        jobs[i].started = (wolfSSL_NewThread(&jobs[i].tid, sm4_job_thread,
+            &jobs[i]) == 0);
+    }
+    sm4_job_run(&jobs[0]);
+    for (i = 1; i < cnt; i++) {
+        if (jobs[i].started) {
+            (void)wolfSSL_JoinThread(jobs[i].tid);
+        }
+        else {
+            sm4_job_run(&jobs[i]);
+        }
+    }
+}
+
+/* Split data into jobs of whole blocks.
+ *
+ * Each job has at least WOLFSSL_SM4_THREADS_MIN bytes except when there is
+ * only one. Blocks are shared out evenly with the first jobs having one more
+ * block when they don't divide equally. Only the last job may end with a
+ * partial block.
+ *
+ * @param [in]  sm4      SM4 algorithm object.
+ * @param [out] out      Output data.
+ * @param [in]  in       Input data.
+ * @param [in]  sz       Length of data in bytes.
+ * @param [in]  threads  Maximum number of threads to use.
+ * @param [in]  op       Operations of jobs - SM4_JOB_* flags.
+ * @param [in]  ctr      Counter before first block.
+ * @param [in]  ctrSz    Number of bytes at end of block that is counter.
+ * @param [out] cnt      Number of jobs.
+ * @return  Jobs on success.
+ * @return  NULL when dynamic memory allocation fails.
+ */
+static Sm4Job* sm4_jobs_new(wc_Sm4* sm4, byte* out, const byte* in, word32 sz,
+    int threads, byte op, const byte* ctr, int ctrSz, word32* cnt)
+{
+    Sm4Job* jobs;
+    word32 blocks = (sz + SM4_BLOCK_SIZE - 1) / SM4_BLOCK_SIZE;
+    word32 n = sz / WOLFSSL_SM4_THREADS_MIN;
+    word32 per;
+    word32 extra;
+    word32 len;
+    word32 off;
+    word32 i;
+
+    /* Never more jobs than threads or blocks and always at least one. */
+    if ((threads > 0) && (n > (word32)threads)) {
+        n = (word32)threads;
+    }
+    if (n > blocks) {
+        n = blocks;
+    }
+    if (n == 0) {
+        n = 1;
+    }
+    /* Number of blocks in each job and number of jobs with one more. */
+    per = blocks / n;
+    extra = blocks % n;
+
+    jobs = (Sm4Job*)XMALLOC(n * sizeof(Sm4Job), sm4->heap,
+        DYNAMIC_TYPE_TMP_BUFFER);
+    if (jobs != NULL) {
+        XMEMSET(jobs, 0, n * sizeof(Sm4Job));
+        for (i = 0, off = 0; i < n; i++, off += len) {
+            len = (per + (i < extra)) * SM4_BLOCK_SIZE;
+            if (len > sz - off) {
+                /* Last job ends with the partial block. */
+                len = sz - off;
+            }
+            jobs[i].sm4 = sm4;
+            jobs[i].out = out + off;
+            jobs[i].in = in + off;
+            jobs[i].sz = len;
+            jobs[i].op = op;
+            /* Counter is after the blocks of the previous jobs. */
+            XMEMCPY(jobs[i].ctr, ctr, SM4_BLOCK_SIZE);
+            sm4_add_counter(jobs[i].ctr, off / SM4_BLOCK_SIZE, ctrSz);
+        }
+        *cnt = n;
+    }
+
+    return jobs;
+}
+
+/* Dispose of jobs.
+ *
+ * @param [in] sm4   SM4 algorithm object.
+ * @param [in] jobs  Jobs to dispose of.
+ * @param [in] cnt   Number of jobs.
+ */
+static void sm4_jobs_free(wc_Sm4* sm4, Sm4Job* jobs, word32 cnt)
+{
+    ForceZero(jobs, cnt * sizeof(Sm4Job));
+    XFREE(jobs, sm4->heap, DYNAMIC_TYPE_TMP_BUFFER);
+}
+
+#ifdef WOLFSSL_SM4_CTR
+/* Encrypt bytes using SM4-CTR with multiple threads.
+ *
+ * Each thread encrypts its own range of counters. The result and state of the
+ * SM4 object are the same as for wc_Sm4CtrEncrypt().
+ * Assumes out is at least sz bytes long.
+ *
+ * @param [in]  sm4      SM4 algorithm object.
+ * @param [out] out      Byte array in which to place encrypted data.
+ * @param [in]  in       Array of bytes to encrypt.
+ * @param [in]  sz       Number of bytes to encrypt.
+ * @param [in]  threads  Maximum number of threads to use including this one.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4, out or in is NULL.
+ * @return  BAD_FUNC_ARG when threads is less than 1.
+ * @return  MISSING_KEY when a key has not been set.
+ * @return  MISSING_IV when an IV has not been set.
+ * @return  MEMORY_E when dynamic memory allocation fails.
+ */
+int wc_Sm4CtrEncryptParallel(wc_Sm4* sm4, byte* out, const byte* in,
+    word32 sz, int threads)
+{
+    int ret = 0;
+    word32 len;
+
+    /* Validate parameters. */
+    if ((sm4 == NULL) || (in == NULL) || (out == NULL) || (threads < 1)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    /* Ensure a key and IV have been set. */
+    if ((ret == 0) && (!sm4->keySet)) {
+        ret = MISSING_KEY;
+    }
+    if ((ret == 0) && (!sm4->ivSet)) {
+        ret = MISSING_IV;
+    }
+
+    if ((ret == 0) && (sm4->unused != 0)) {
+        /* Use up unused bytes from previous encrypted counter. */
+        len = min(sm4->unused, sz);
+        ret = wc_Sm4CtrEncrypt(sm4, out, in, len);
+        in += len;
+        out += len;
+        sz -= len;
+    }
+    len = sz & (~(word32)(SM4_BLOCK_SIZE - 1));
+    if ((ret == 0) && (threads > 1) && (len >= 2 * WOLFSSL_SM4_THREADS_MIN)) {
+        Sm4Job* jobs;
+        word32 cnt = 0;
+
+        /* Blocks are split between threads. */
+        jobs = sm4_jobs_new(sm4, out, in, len, threads, SM4_JOB_CTR, sm4->iv,
+            SM4_BLOCK_SIZE, &cnt);
+        if (jobs == NULL) {
+            ret = MEMORY_E;
+        }
+        else {
+            sm4_jobs_run(jobs, cnt);
+            sm4_jobs_free(sm4, jobs, cnt);
+            /* Counter is after all the blocks. */
+            sm4_add_counter(sm4->iv, len / SM4_BLOCK_SIZE, SM4_BLOCK_SIZE);
+            in += len;
+            out += len;
+            sz -= len;
+        }
+    }
+    if ((ret == 0) && (sz > 0)) {
+        /* Encrypt remaining data in this thread. */
+        ret = wc_Sm4CtrEncrypt(sm4, out, in, sz);
+    }
+
+    return ret;
+}
+#endif /* WOLFSSL_SM4_CTR */
+
+#ifdef WOLFSSL_SM4_GCM
+/* Raise H to a power in GF(2^128).
+ *
+ * @param [in]  h  H - hash key.
+ * @param [in]  e  Exponent.
+ * @param [out] r  H^e.
+ */
+static void sm4_gf_pow(const byte* h, word32 e, byte* r)
+{
+    int i;
+
+    /* One is the most significant bit set. */
+    XMEMSET(r, 0, SM4_BLOCK_SIZE);
+    r[0] = 0x80;
+    for (i = 31; i >= 0; i--) {
+        sm4_gf_mul(r, r);
+        if ((e >> i) & 1) {
+            sm4_gf_mul(r, h);
+        }
+    }
+}
+
+/* Calculate the lengths block multiplied by H.
+ *
+ * @param [in]  h      H - hash key.
+ * @param [in]  aSz    Length of additional authentication data in bytes.
+ * @param [in]  cSz    Length of cipher text in bytes.
+ * @param [out] r      Lengths in bits multiplied by H.
+ */
+static void sm4_gcm_len_h(const byte* h, word32 aSz, word32 cSz, byte* r)
+{
+    sm4_gcm_set_len(r, aSz, cSz);
+    sm4_gf_mul(r, h);
+}
+
+/* Combine the GHASH of the additional authentication data and of each job's
+ * cipher text into the GHASH of all the data.
+ *
+ * GHASH(A) = (Z ^ L) * H where Z is the hash of the blocks of A and L the
+ * lengths block. Z * H = GHASH(A) ^ L * H is multiplied by H to the power of
+ * the number of blocks that follow and added to the hash of those blocks.
+ *
+ * @param [in]  sm4    SM4 algorithm object.
+ * @param [in]  aad    Additional authentication data. May be NULL.
+ * @param [in]  aadSz  Length of additional authentication data in bytes.
+ * @param [in]  jobs   Jobs that calculated GHASH of cipher text.
+ * @param [in]  cnt    Number of jobs.
+ * @param [in]  sz     Length of all cipher text in bytes.
+ * @param [out] s      GHASH of additional authentication data and cipher text.
+ */
+static void sm4_gcm_ghash_merge(wc_Sm4* sm4, const byte* aad, word32 aadSz,
+    const Sm4Job* jobs, word32 cnt, word32 sz, byte* s)
+{
+    ALIGN16 byte h[SM4_BLOCK_SIZE];
+    ALIGN16 byte hn[SM4_BLOCK_SIZE];
+    ALIGN16 byte t[SM4_BLOCK_SIZE];
+    word32 blocks;
+    word32 last = 0;
+    word32 i;
+
+    /* H is the encrypted all zeros block. */
+    XMEMSET(h, 0, sizeof(h));
+    sm4_encrypt(SM4_KS(sm4), h, h);
+
+    /* Start with hash of AAD multiplied by H. */
+    XMEMSET(s, 0, SM4_BLOCK_SIZE);
+    if (aadSz > 0) {
+        sm4_gcm_ghash(sm4, aad, aadSz, NULL, 0, s);
+        sm4_gcm_len_h(h, aadSz, 0, t);
+        xorbuf(s, t, SM4_BLOCK_SIZE);
+    }
+    for (i = 0; i < cnt; i++) {
+        blocks = (jobs[i].sz + SM4_BLOCK_SIZE - 1) / SM4_BLOCK_SIZE;
+        /* Jobs have at most three different numbers of blocks. */
+        if ((i == 0) || (blocks != last)) {
+            sm4_gf_pow(h, blocks, hn);
+            last = blocks;
+        }
+        /* Move hash along by the number of blocks in job and add job's. */
+        sm4_gf_mul(s, hn);
+        sm4_gcm_len_h(h, 0, jobs[i].sz, t);
+        xorbuf(s, t, SM4_BLOCK_SIZE);
+        xorbuf(s, jobs[i].s, SM4_BLOCK_SIZE);
+    }
+    /* Finish with lengths of all data. */
+    sm4_gcm_len_h(h, aadSz, sz, t);
+    xorbuf(s, t, SM4_BLOCK_SIZE);
+
+    ForceZero(h, sizeof(h));
+    ForceZero(hn, sizeof(hn));
+}
+
+/* Encrypt or decrypt bytes using SM4-GCM with multiple threads.
+ *
+ * @param [in]      sm4      SM4 algorithm object.
+ * @param [out]     out      Byte array in which to place output data.
+ * @param [in]      in       Array of bytes to encrypt/decrypt.
+ * @param [in]      sz       Number of bytes to encrypt/decrypt.
+ * @param [in]      nonce    Array of bytes holding nonce.
+ * @param [in]      nonceSz  Length of nonce in bytes.
+ * @param [in, out] tag      Authentication tag. Calculated when encrypting,
+ *                           checked when decrypting.
+ * @param [in]      tagSz    Length of authentication tag in bytes.
+ * @param [in]      aad      Additional authentication data. May be NULL.
+ * @param [in]      aadSz    Length of additional authentication data in bytes.
+ * @param [in]      threads  Maximum number of threads to use including this
+ *                           one.
+ * @param [in]      enc      1 to encrypt, 0 to decrypt.
+ * @return  0 on success.
+ * @return  MEMORY_E when dynamic memory allocation fails.
+ * @return  SM4_GCM_AUTH_E when authentication tag calculated does not match
+ *          the one passed in.
+ */
+static int sm4_gcm_crypt_parallel(wc_Sm4* sm4, byte* out, const byte* in,
+    word32 sz, const byte* nonce, word32 nonceSz, byte* tag, word32 tagSz,
+    const byte* aad, word32 aadSz, int threads, int enc)
+{
+    int ret = 0;
+    Sm4Job* jobs;
+    word32 cnt = 0;
+    ALIGN16 byte counter[SM4_BLOCK_SIZE];
+    ALIGN16 byte s[SM4_BLOCK_SIZE];
+    byte op;
+    sword32 res;
+
+    sm4_gcm_init_counter(sm4, nonce, nonceSz, counter);
+
+    if (enc) {
+        op = SM4_JOB_GCM_CTR | SM4_JOB_GHASH_OUT;
+    }
+    else {
+    #ifdef WC_SM4_GCM_DEC_AUTH_EARLY
+        /* Decrypt only once tag checked. */
+        op = SM4_JOB_GHASH_IN;
+    #else
+        op = SM4_JOB_GHASH_IN | SM4_JOB_GCM_CTR;
+    #endif
+    }
+    jobs = sm4_jobs_new(sm4, out, in, sz, threads, op, counter, CTR_SZ, &cnt);
+    if (jobs == NULL) {
+        ret = MEMORY_E;
+    }
+    if (ret == 0) {
+        sm4_jobs_run(jobs, cnt);
+        sm4_gcm_ghash_merge(sm4, aad, aadSz, jobs, cnt, sz, s);
+        /* XOR the encrypted initial counter into GHASH for tag. */
+        sm4_encrypt(SM4_KS(sm4), counter, counter);
+        xorbuf(s, counter, SM4_BLOCK_SIZE);
+
+        if (enc) {
+            XMEMCPY(tag, s, tagSz);
+        }
+        else {
+            /* Compare tag and calculated tag in constant time. */
+            res = ConstantCompare(tag, s, (int)tagSz);
+            /* Create mask based on comparison result in constant time */
+            res = 0 - (sword32)(((word32)(0 - res)) >> 31U);
+            /* Mask error code to get return value. */
+            ret = res & SM4_GCM_AUTH_E;
+        #ifdef WC_SM4_GCM_DEC_AUTH_EARLY
+            if (ret == 0) {
+                word32 i;
+
+                /* Tag matches - decrypt. */
+                for (i = 0; i < cnt; i++) {
+                    jobs[i].op = SM4_JOB_GCM_CTR;
+                }
+                sm4_jobs_run(jobs, cnt);
+            }
+        #endif
+        }
+
+        sm4_jobs_free(sm4, jobs, cnt);
+    }
+
+    ForceZero(counter, sizeof(counter));
+    ForceZero(s, sizeof(s));
+    return ret;
+}
+
+/* Encrypt bytes using SM4-GCM with multiple threads.
+ *
+ * Each thread encrypts its own range of counters and calculates the GHASH of
+ * its cipher text. The GHASH results are combined using powers of H.
+ * Assumes out is at least sz bytes long.
+ *
+ * @param [in]  sm4      SM4 algorithm object.
+ * @param [out] out      Byte array in which to place encrypted data.
+ * @param [in]  in       Array of bytes to encrypt.
+ * @param [in]  sz       Number of bytes to encrypt.
+ * @param [in]  nonce    Array of bytes holding initialization vector.
+ * @param [in]  nonceSz  Length of nonce in bytes.
+ * @param [out] tag      Authentication tag calculated using GCM.
+ * @param [in]  tagSz    Length of authentication tag to calculate in bytes.
+ *                       Must be no more than SM4_BLOCK_SIZE.
+ * @param [in]  aad      Additional authentication data. May be NULL.
+ * @param [in]  aadSz    Length of additional authentication data in bytes.
+ * @param [in]  threads  Maximum number of threads to use including this one.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4, in, out, nonce or tag is NULL.
+ * @return  BAD_FUNC_ARG when authentication tag data length is less than
+ *          WOLFSSL_MIN_AUTH_TAG_SZ or is more than SM4_BLOCK_SIZE.
+ * @return  BAD_FUNC_ARG when nonce length is 0.
+ * @return  BAD_FUNC_ARG when threads is less than 1.
+ * @return  MISSING_KEY when a key has not been set.
+ * @return  MEMORY_E when dynamic memory allocation fails.
+ */
+int wc_Sm4GcmEncryptParallel(wc_Sm4* sm4, byte* out, const byte* in,
+    word32 sz, const byte* nonce, word32 nonceSz, byte* tag, word32 tagSz,
+    const byte* aad, word32 aadSz, int threads)
+{
+    int ret;
+
+    if ((threads > 1) && (sz >= 2 * WOLFSSL_SM4_THREADS_MIN)) {
+        /* Validate parameters. */
+        ret = wc_Sm4GcmEncrypt(sm4, out, in, 0, nonce, nonceSz, tag, tagSz,
+            NULL, 0);
+        if ((ret == 0) && ((in == NULL) || (out == NULL))) {
+            ret = BAD_FUNC_ARG;
+        }
+        if (ret == 0) {
+            ret = sm4_gcm_crypt_parallel(sm4, out, in, sz, nonce, nonceSz, tag,
+                tagSz, aad, aadSz, threads, 1);
+        }
+    }
+    else if (threads < 1) {
+        ret = BAD_FUNC_ARG;
+    }
+    else {
+        /* Not enough data to split between threads. */
+        ret = wc_Sm4GcmEncrypt(sm4, out, in, sz, nonce, nonceSz, tag, tagSz,
+            aad, aadSz);
+    }
+
+    return ret;
+}
+
+/* Decrypt bytes using SM4-GCM with multiple threads.
+ *
+ * Each thread decrypts its own range of counters and calculates the GHASH of
+ * its cipher text. The GHASH results are combined using powers of H.
+ * Assumes out is at least sz bytes long.
+ *
+ * @param [in]  sm4      SM4 algorithm object.
+ * @param [out] out      Byte array in which to place decrypted data.
+ * @param [in]  in       Array of bytes to decrypt.
+ * @param [in]  sz       Number of bytes to decrypt.
+ * @param [in]  nonce    Array of bytes holding initialization vector.
+ * @param [in]  nonceSz  Length of nonce in bytes.
+ * @param [in]  tag      Authentication tag to compare against calculated.
+ * @param [in]  tagSz    Length of authentication tag in bytes.
+ *                       Must be no more than SM4_BLOCK_SIZE.
+ * @param [in]  aad      Additional authentication data. May be NULL.
+ * @param [in]  aadSz    Length of additional authentication data in bytes.
+ * @param [in]  threads  Maximum number of threads to use including this one.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4, in, out, nonce or tag is NULL.
+ * @return  BAD_FUNC_ARG when authentication tag data length is less than
+ *          WOLFSSL_MIN_AUTH_TAG_SZ or is more than SM4_BLOCK_SIZE.
  * @return  BAD_FUNC_ARG when nonce length is 0.
+ * @return  BAD_FUNC_ARG when threads is less than 1.
+ * @return  MISSING_KEY when a key has not been set.
+ * @return  MEMORY_E when dynamic memory allocation fails.
+ * @return  SM4_GCM_AUTH_E when authentication tag calculated does not match
+ *          the one passed in.
+ */
+int wc_Sm4GcmDecryptParallel(wc_Sm4* sm4, byte* out, const byte* in,
+    word32 sz, const byte* nonce, word32 nonceSz, const byte* tag,
+    word32 tagSz, const byte* aad, word32 aadSz, int threads)
+{
+    int ret = 0;
+
+    if ((threads > 1) && (sz >= 2 * WOLFSSL_SM4_THREADS_MIN)) {
+        /* Validate parameters. */
+        if ((sm4 == NULL) || (in == NULL) || (out == NULL) ||
+                (nonce == NULL) || (tag == NULL)) {
+            ret = BAD_FUNC_ARG;
+        }
+        if ((tagSz < WOLFSSL_MIN_AUTH_TAG_SZ) || (tagSz > SM4_BLOCK_SIZE)) {
+            ret = BAD_FUNC_ARG;
+        }
+        if (nonceSz == 0) {
+            ret = BAD_FUNC_ARG;
+        }
+        /* Ensure a key has been set. */
+        if ((ret == 0) && (!sm4->keySet)) {
+            ret = MISSING_KEY;
+        }
+        if (ret == 0) {
+        #ifdef OPENSSL_EXTRA
+            sm4->nonceSz = (int)nonceSz;
+        #endif
+            ret = sm4_gcm_crypt_parallel(sm4, out, in, sz, nonce, nonceSz,
+                (byte*)tag, tagSz, aad, aadSz, threads, 0);
+        }
+    }
+    else if (threads < 1) {
+        ret = BAD_FUNC_ARG;
+    }
+    else {
+        /* Not enough data to split between threads. */
+        ret = wc_Sm4GcmDecrypt(sm4, out, in, sz, nonce, nonceSz, tag, tagSz,
+            aad, aadSz);
+    }
+
+    return ret;
+}
+#endif /* WOLFSSL_SM4_GCM */
+
+#endif /* WOLFSSL_SM4_THREADS && (WOLFSSL_SM4_CTR || WOLFSSL_SM4_GCM) */
+
+#ifdef WOLFSSL_SM4_CCM
+
+/* Roll up data.
+ *
+ * Encrypt each block XORed into out.
+ *
+ * @param [in]      sm4  SM4 algorithm object.
+ * @param [in]      in   Data to roll up.
+ * @param [in]      sz   Length in bytes of data.
+ * @param [in, out] out  Block XORed into and encrypted.
+ */
+static void sm4_ccm_roll_x(wc_Sm4* sm4, const byte* in, word32 sz, byte* out)
+{
+    /* XOR in each block and encrypt each result. */
+    while (sz >= SM4_BLOCK_SIZE) {
+        /* XOR in next block. */
+        xorbuf(out, in, SM4_BLOCK_SIZE);
+        /* Move on past block. */
+        in += SM4_BLOCK_SIZE;
+        sz -= SM4_BLOCK_SIZE;
+        /* Encrypt into self. */
+        sm4_encrypt(SM4_KS(sm4), out, out);
+    }
+
+    /* XOR in a block of data and encrypt result. */
+    if (sz > 0) {
+        /* XOR in partial block. */
+        xorbuf(out, in, sz);
+        /* Encrypt into self. */
+        sm4_encrypt(SM4_KS(sm4), out, out);
+    }
+}
+
+/* Roll up additional authentication data (AAD).
+ *
+ * First block has length plus ant AAD XORed in before being encrypted.
+ *
+ * @param [in]  sm4  SM4 algorithm object.
+ * @param [in]  in   Additional authentication data to roll up.
+ * @param [in]  sz   Length in bytes of data.
+ * @param [out] out  Block XORed into and encrypted.
+ */
+static void sm4_ccm_roll_aad(wc_Sm4* sm4, const byte* in, word32 sz, byte* out)
+{
+    word32 aadLenSz;
+    word32 remainder;
+
+    /* XOR length at start of block. */
+    if (sz <= 0xFEFF) {
+        /* Two bytes used to represent length. */
+        aadLenSz = 2;
+        out[0] ^= ((sz & 0xFF00) >> 8);
+        out[1] ^=  (sz & 0x00FF);
+    }
+    else {
+        /* Four bytes used to represent length plus two unique bytes. */
+        aadLenSz = 6;
+        out[0] ^= 0xFF;
+        out[1] ^= 0xFE;
+        out[2] ^= (byte)((sz & 0xFF000000) >> 24);
+        out[3] ^= (byte)((sz & 0x00FF0000) >> 16);
+        out[4] ^= (byte)((sz & 0x0000FF00) >>  8);
+        out[5] ^= (byte) (sz & 0x000000FF);
+    }
+
+    /* Calculate number of input bytes required to make up the block. */
+    remainder = SM4_BLOCK_SIZE - aadLenSz;
+    /* Check how much AAD available. */
+    if (sz >= remainder) {
+        /* XOR up to block into out. */
+        xorbuf(out + aadLenSz, in, remainder);
+        /* Move past data. */
+        sz -= remainder;
+        in += remainder;
+    }
+    else {
+        /* XOR in AAD available. */
+        xorbuf(out + aadLenSz, in, sz);
+        /* All AAD used. */
+        sz = 0;
+    }
+    /* Encrypt into self. */
+    sm4_encrypt(SM4_KS(sm4), out, out);
+
+    if (sz > 0) {
+        /* Roll up any remaining AAD. */
+        sm4_ccm_roll_x(sm4, in, sz, out);
+    }
+}
+
+/* Last bytes incremented as a big-endian number.
+ *
+ * Bytes not the nonce and length are incremented.
+ *
+ * @param [in, out] b      IV block.
+ * @param [in]      ctrSz  Length of counter.
+ */
+static WC_INLINE void sm4_ccm_ctr_inc(byte* b, word32 ctrSz)
+{
+    word32 i;
+
+    /* Only last bytes that make up counter. */
+    for (i = 0; i < ctrSz; i++) {
+        /* Increment byte and check for carry. */
+        if ((++b[SM4_BLOCK_SIZE - 1 - i]) != 0) {
+            /* No carry - done. */
+            break;
+        }
+    }
+}
+
+#ifdef SM4_PARALLEL
+/* Encipher blocks using the CTR part of SM4-CCM in parallel.
+ *
+ * @param [in]       sm4     SM4 algorithm object.
+ * @param [out]      out     Byte array in which to place encrypted data.
+ * @param [in]       in      Array of bytes to encrypt.
+ * @param [in]       blocks  Number of blocks to encrypt.
+ * @param [in, out]  b       IV block. Counter incremented for each block.
+ * @param [in]       ctrSz   Number of counter bytes in IV block.
+ */
+static void sm4_ccm_ctr_par(wc_Sm4* sm4, byte* out, const byte* in,
+    word32 blocks, byte* b, byte ctrSz)
+{
+    ALIGN16 byte ctr[SM4_PAR_BLOCKS * SM4_BLOCK_SIZE];
+
+    while (blocks > 0) {
+        word32 n = min(blocks, SM4_PAR_BLOCKS);
+        word32 i;
+
+        /* Set the counters and increment for next block. */
+        for (i = 0; i < n; i++) {
+            XMEMCPY(ctr + i * SM4_BLOCK_SIZE, b, SM4_BLOCK_SIZE);
+            sm4_ccm_ctr_inc(b, ctrSz);
+        }
+        /* Encrypt the counters and XOR with input into output. */
+        sm4_blocks(SM4_KS(sm4), ctr, ctr, n);
+        xorbufout(out, in, ctr, n * SM4_BLOCK_SIZE);
+
+        /* Move on to next blocks. */
+        in += n * SM4_BLOCK_SIZE;
+        out += n * SM4_BLOCK_SIZE;
+        blocks -= n;
+    }
+
+    ForceZero(ctr, sizeof(ctr));
+}
+#endif
+
+/* Encipher bytes using SM4-CCM.
+ *
+ * @param [in]       sm4    SM4 algorithm object.
+ * @param [out]      out    Byte array in which to place encrypted data.
+ * @param [in]       in     Array of bytes to encrypt.
+ * @param [in]       sz     Number of bytes to encrypt.
+ * @param [in, out]  b      IV block.
+ * @param [in]       ctrSz  Number of counter bytes in IV block.
+ */
+static WC_INLINE void sm4_ccm_crypt(wc_Sm4* sm4, byte* out, const byte* in,
+    word32 sz, byte* b, byte ctrSz)
+{
+    ALIGN16 byte a[SM4_BLOCK_SIZE];
+
+    /* Nonce and length have been set and counter 0 except for last byte. */
+
+    /* Set counter to 1. */
+    b[SM4_BLOCK_SIZE - 1] = 1;
+#ifdef SM4_PARALLEL
+    if ((sz >= SM4_BLOCK_SIZE) && sm4_par_avail()) {
+        word32 len = sz & (~(word32)(SM4_BLOCK_SIZE - 1));
+
+        /* Encipher all full blocks in parallel. */
+        sm4_ccm_ctr_par(sm4, out, in, len / SM4_BLOCK_SIZE, b, ctrSz);
+        in += len;
+        out += len;
+        sz -= len;
+    }
+#endif
+    /* Encrypting full blocks at a time. */
+    while (sz >= SM4_BLOCK_SIZE) {
+        /* Encrypt counter. */
+        sm4_encrypt(SM4_KS(sm4), b, a);
+        /* XOR in plaintext. */
+        xorbuf(a, in, SM4_BLOCK_SIZE);
+        /* Copy cipher text out. */
+        XMEMCPY(out, a, SM4_BLOCK_SIZE);
+
+        /* Increment counter for next block. */
+        sm4_ccm_ctr_inc(b, ctrSz);
+        /* Move over block. */
+        sz -= SM4_BLOCK_SIZE;
+        in += SM4_BLOCK_SIZE;
+        out += SM4_BLOCK_SIZE;
+    }
+    if (sz > 0) {
+        /* Encrypt counter. */
+        sm4_encrypt(SM4_KS(sm4), b, a);
+        /* XOR in remaining plaintext. */
+        xorbuf(a, in, sz);
+        /* Copy cipher text out. */
+        XMEMCPY(out, a, sz);
+    }
+}
+
+/* Start authentication tag calculation for SM4-CCM.
+ *
+ * Encrypts the first block, with flags, nonce and length, and rolls up the
+ * additional authentication data.
+ *
+ * @param [in]       sm4    SM4 algorithm object.
+ * @param [in]       sz     Number of bytes to encrypt.
+ * @param [in]       aad    Additional authentication data. May be NULL.
+ * @param [in]       aadSz  Length of additional authentication data in bytes.
+ * @param [in, out]  b      IV block.
+ * @param [in]       ctrSz  Number of counter bytes in IV block.
+ * @param [in]       tagSz  Length of authentication tag to calculate in bytes.
+ * @param [out]      a      Authentication tag block.
+ */
+static void sm4_ccm_auth_start(wc_Sm4* sm4, word32 sz, const byte* aad,
+    word32 aadSz, byte* b, byte ctrSz, word32 tagSz, byte* a)
+{
+    word32 i;
+
+    /* Nonce is in place. */
+
+    /* Set first byte to length and flags. */
+    b[0] = (byte)((((aad != NULL) && (aadSz > 0)) ? 0x40 : 0x00) +
+                  (8 * (((byte)tagSz - 2) / 2)) + (ctrSz - 1));
+    /* Set the counter bytes to length of data - 4 bytes of length only. */
+    for (i = 0; i < ctrSz && i < sizeof(word32); i++) {
+        b[SM4_BLOCK_SIZE - 1 - i] = (byte)(sz >> (8 * i));
+    }
+    /* Set remaining counter bytes to 0. */
+    for (; i < ctrSz; i++) {
+        b[SM4_BLOCK_SIZE - 1 - i] = 0x00;
+    }
+    /* Encrypt block into authentication tag block. */
+    sm4_encrypt(SM4_KS(sm4), b, a);
+
+    if ((aad != NULL) && (aadSz > 0)) {
+        /* Roll up any AAD. */
+        sm4_ccm_roll_aad(sm4, aad, aadSz, a);
+    }
+}
+
+/* Finish authentication tag calculation for SM4-CCM.
+ *
+ * @param [in]       sm4    SM4 algorithm object.
+ * @param [in, out]  b      IV block. Counter set to zero on return.
+ * @param [in]       ctrSz  Number of counter bytes in IV block.
+ * @param [in]       a      Authentication tag block.
+ * @param [out]      tag    Authentication tag calculated using CCM.
+ * @param [in]       tagSz  Length of authentication tag to calculate in bytes.
+ */
+static void sm4_ccm_auth_final(wc_Sm4* sm4, byte* b, byte ctrSz,
+    const byte* a, byte* tag, word32 tagSz)
+{
+    byte t[SM4_BLOCK_SIZE];
+    word32 i;
+
+    /* Nonce remains in place. */
+    /* Set first byte to counter size - 1. */
+    b[0] = ctrSz - 1;
+    /* Set counter to 0. */
+    for (i = 0; i < ctrSz; i++) {
+        b[SM4_BLOCK_SIZE - 1 - i] = 0;
+    }
+    /* Encrypt block into authentication tag block. */
+    sm4_encrypt(SM4_KS(sm4), b, t);
+    /* XOR in other authentication tag data. */
+    xorbufout(tag, t, a, tagSz);
+}
+
+/* Calculate authentication tag for SM4-CCM.
+ *
+ * @param [in]       sm4    SM4 algorithm object.
+ * @param [in]       plain  Array of bytes to encrypt.
+ * @param [in]       sz     Number of bytes to encrypt.
+ * @param [in]       aad    Additional authentication data. May be NULL.
+ * @param [in]       aadSz  Length of additional authentication data in bytes.
+ * @param [in, out]  b      IV block.
+ * @param [in]       ctrSz  Number of counter bytes in IV block.
+ * @param [out]      tag    Authentication tag calculated using CCM.
+ * @param [in]       tagSz  Length of authentication tag to calculate in bytes.
+ */
+static WC_INLINE void sm4_ccm_calc_auth_tag(wc_Sm4* sm4, const byte* plain,
+    word32 sz, const byte* aad, word32 aadSz, byte* b, byte ctrSz,
+    byte* tag, word32 tagSz)
+{
+    ALIGN16 byte a[SM4_BLOCK_SIZE];
+
+    sm4_ccm_auth_start(sm4, sz, aad, aadSz, b, ctrSz, tagSz, a);
+    if (sz > 0) {
+        /* Roll up any plaintext. */
+        sm4_ccm_roll_x(sm4, plain, sz, a);
+    }
+    sm4_ccm_auth_final(sm4, b, ctrSz, a, tag, tagSz);
+}
+
+/* Encrypt bytes using SM4-CCM implementation in C.
+ *
+ * @param [in]  sm4      SM4 algorithm object.
+ * @param [out] out      Byte array in which to place encrypted data.
+ * @param [in]  in       Array of bytes to encrypt.
+ * @param [in]  sz       Number of bytes to encrypt.
+ * @param [in]  nonce    Array of bytes holding initialization vector.
+ * @param [in]  nonceSz  Length of nonce in bytes.
+ * @param [out] tag      Authentication tag calculated using CCM.
+ * @param [in]  tagSz    Length of authentication tag to calculate in bytes.
+ *                       Must be no more than SM4_BLOCK_SIZE.
+ * @param [in]  aad      Additional authentication data. May be NULL.
+ * @param [in]  aadSz    Length of additional authentication data in bytes.
+ */
+static void sm4_ccm_encrypt_c(wc_Sm4* sm4, byte* out, const byte* in, word32 sz,
+    const byte* nonce, word32 nonceSz, byte* tag, word32 tagSz, const byte* aad,
+    word32 aadSz)
+{
+    ALIGN16 byte b[SM4_BLOCK_SIZE];
+    byte ctrSz;
+
+    /* Calculate length of counter. */
+    ctrSz = SM4_BLOCK_SIZE - 1 - (byte)nonceSz;
+    /* Copy nonce in after length byte. */
+    XMEMCPY(b + 1, nonce, nonceSz);
+
+    /* Calculate authentication tag. */
+    sm4_ccm_calc_auth_tag(sm4, in, sz, aad, aadSz, b, ctrSz, tag, tagSz);
+    /* b is left with first byte counter size - 1 and counter part set to zero.
+     */
+
+    if (sz > 0) {
+        /* Encrypt plaintext to cipher text. */
+        sm4_ccm_crypt(sm4, out, in, sz, b, ctrSz);
+    }
+}
+
+/* Decrypt bytes using SM4-CCM implementation in C.
+ *
+ * @param [in]  sm4      SM4 algorithm object.
+ * @param [out] out      Byte array in which to place decrypted data.
+ * @param [in]  in       Array of bytes to decrypt.
+ * @param [in]  sz       Number of bytes to decrypt.
+ * @param [in]  nonce    Array of bytes holding initialization vector.
+ * @param [in]  nonceSz  Length of nonce in bytes.
+ * @param [in]  tag      Authentication tag calculated using GCM.
+ * @param [in]  tagSz    Length of authentication tag to calculate in bytes.
+ *                       Must be no more than SM4_BLOCK_SIZE.
+ * @param [in]  aad      Additional authentication data. May be NULL.
+ * @param [in]  aadSz    Length of additional authentication data in bytes.
+ * @return  0 on success.
+ * @return  SM4_CCM_AUTH_E when authentication tag calculated does not match
+ *          the one passed in.
+ */
+static int sm4_ccm_decrypt_c(wc_Sm4* sm4, byte* out, const byte* in, word32 sz,
+    const byte* nonce, word32 nonceSz, const byte* tag, word32 tagSz,
+    const byte* aad, word32 aadSz)
+{
+    ALIGN16 byte b[SM4_BLOCK_SIZE];
+    ALIGN16 byte t[SM4_BLOCK_SIZE];
+    byte ctrSz;
+    word32 i;
+    int ret = 0;
+
+    /* Calculate length of counter. */
+    ctrSz = SM4_BLOCK_SIZE - 1 - (byte)nonceSz;
+    /* Copy nonce in after length byte. */
+    XMEMCPY(b + 1, nonce, nonceSz);
+
+    /* Set length byte to counter size - 1. */
+    b[0] = ctrSz - 1;
+    /* Set all bytes but least significant of counter to 0. */
+    for (i = 1; i < ctrSz; i++) {
+        b[SM4_BLOCK_SIZE - 1 - i] = 0;
+    }
+    if (sz > 0) {
+        /* Decrypt cipher text to plaintext. */
+        sm4_ccm_crypt(sm4, out, in, sz, b, ctrSz);
+        /* b still has nonce in place. */
+    }
+
+    /* Calculate authentication tag. */
+    sm4_ccm_calc_auth_tag(sm4, out, sz, aad, aadSz, b, ctrSz, t, tagSz);
+
+    /* Compare calculated tag with passed in tag. */
+    if (ConstantCompare(t, tag, (int)tagSz) != 0) {
+        /* Set CCM authentication error return. */
+        ret = SM4_CCM_AUTH_E;
+    }
+
+    return ret;
+}
+
+/* Encrypt bytes using SM4-CCM.
+ *
+ * Assumes out is at least sz bytes long.
+ *
+ * @param [in]  sm4      SM4 algorithm object.
+ * @param [out] out      Byte array in which to place encrypted data.
+ * @param [in]  in       Array of bytes to encrypt.
+ * @param [in]  sz       Number of bytes to encrypt.
+ * @param [in]  nonce    Array of bytes holding initialization vector.
+ * @param [in]  nonceSz  Length of nonce in bytes.
+ * @param [out] tag      Authentication tag calculated using CCM.
+ * @param [in]  tagSz    Length of authentication tag to calculate in bytes.
+ *                       Must be no more than SM4_BLOCK_SIZE.
+ * @param [in]  aad      Additional authentication data. May be NULL.
+ * @param [in]  aadSz    Length of additional authentication data in bytes.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4, in, out, nonce or tag is NULL.
+ * @return  BAD_FUNC_ARG when authentication tag data length is less than
+ *          4 or is more than SM4_BLOCK_SIZE or an odd value.
+ * @return  BAD_FUNC_ARG when nonce length is less than CCM_NONCE_MIN_SZ or
+ *          greater than CCM_NONCE_MAX_SZ.
+ * @return  MISSING_KEY when a key has not been set.
+ */
+int wc_Sm4CcmEncrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz,
+    const byte* nonce, word32 nonceSz, byte* tag, word32 tagSz, const byte* aad,
+    word32 aadSz)
+{
+    int ret = 0;
+
+    /* Validate parameters. */
+    if ((sm4 == NULL) || ((sz != 0) && ((in == NULL) || (out == NULL))) ||
+            (nonce == NULL) || (tag == NULL)) {
+        ret = BAD_FUNC_ARG;
+    }
+    /* Tag size is even number 4..16. */
+    if ((tagSz < 4) || (tagSz > SM4_BLOCK_SIZE) || ((tagSz & 1) == 1)) {
+        ret = BAD_FUNC_ARG;
+    }
+    /* Nonce must be within supported range. */
+    if ((nonceSz < CCM_NONCE_MIN_SZ) || (nonceSz > CCM_NONCE_MAX_SZ)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    /* Ensure a key has been set. */
+    if ((ret == 0) && (!sm4->keySet)) {
+        ret = MISSING_KEY;
+    }
+
+    if (ret == 0) {
+    #ifdef OPENSSL_EXTRA
+        sm4->nonceSz = (int)nonceSz;
+    #endif
+        /* Perform encryption using C implementation. */
+        sm4_ccm_encrypt_c(sm4, out, in, sz, nonce, nonceSz, tag, tagSz, aad,
+            aadSz);
+    }
+
+    return ret;
+}
+
+/* Decrypt bytes using SM4-CCM.
+ *
+ * Assumes out is at least sz bytes long.
+ *
+ * @param [in]  sm4      SM4 algorithm object.
+ * @param [out] out      Byte array in which to place decrypted data.
+ * @param [in]  in       Array of bytes to decrypt.
+ * @param [in]  sz       Number of bytes to decrypt.
+ * @param [in]  nonce    Array of bytes holding initialization vector.
+ * @param [in]  nonceSz  Length of nonce in bytes.
+ * @param [in]  tag      Authentication tag to compare against calculated.
+ * @param [in]  tagSz    Length of authentication tag in bytes.
+ *                       Must be no more than SM4_BLOCK_SIZE.
+ * @param [in]  aad      Additional authentication data. May be NULL.
+ * @param [in]  aadSz    Length of additional authentication data in bytes.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4, in, out, nonce or tag is NULL.
+ * @return  BAD_FUNC_ARG when authentication tag data length is less than
+ *          4 or is more than SM4_BLOCK_SIZE or an odd value.
+ * @return  BAD_FUNC_ARG when nonce length is less than CCM_NONCE_MIN_SZ or
+ *          greater than CCM_NONCE_MAX_SZ.
+ * @return  MISSING_KEY when a key has not been set.
+ * @return  SM4_CCM_AUTH_E when authentication tag calculated does not match
+ *          the one passed in.
+ */
+int wc_Sm4CcmDecrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz,
+    const byte* nonce, word32 nonceSz, const byte* tag, word32 tagSz,
+    const byte* aad, word32 aadSz)
+{
+    int ret = 0;
+
+    /* Validate parameters. */
+    if ((sm4 == NULL) || ((sz != 0) && ((in == NULL) || (out == NULL))) ||
+            (nonce == NULL) || (tag == NULL)) {
+        ret = BAD_FUNC_ARG;
+    }
+    /* Tag size is even number 4..16. */
+    if ((tagSz < 4) || (tagSz > SM4_BLOCK_SIZE) || ((tagSz & 1) == 1)) {
+        ret = BAD_FUNC_ARG;
+    }
+    /* Nonce must be within supported range. */
+    if ((nonceSz < CCM_NONCE_MIN_SZ) || (nonceSz > CCM_NONCE_MAX_SZ)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    /* Ensure a key has been set. */
+    if ((ret == 0) && (!sm4->keySet)) {
+        ret = MISSING_KEY;
+    }
+
+    if (ret == 0) {
+    #ifdef OPENSSL_EXTRA
+        sm4->nonceSz = (int)nonceSz;
+    #endif
+        /* Perform decryption using C implementation. */
+        ret = sm4_ccm_decrypt_c(sm4, out, in, sz, nonce, nonceSz, tag, tagSz,
+            aad, aadSz);
+    }
+
+    return ret;
+}
+
+#endif
+
+#ifdef WOLFSSL_SM4_CMAC
+
+/* Double a number in GF(2^128) as defined for CMAC.
+ *
+ * Only operations whose timing doesn't depend on the data are used.
+ *
+ * @param [out] out  Doubled number.
+ * @param [in]  in   Number to double.
+ */
+static void sm4_cmac_dbl(byte* out, const byte* in)
+{
+    /* Reduce when top bit shifted out. */
+    byte mask = (byte)(0 - (in[0] >> 7));
+    int i;
+
+    for (i = 0; i < SM4_BLOCK_SIZE - 1; i++) {
+        out[i] = (byte)((in[i] << 1) | (in[i + 1] >> 7));
+    }
+    out[SM4_BLOCK_SIZE - 1] = (byte)((in[SM4_BLOCK_SIZE - 1] << 1) ^
+                                     (mask & 0x87));
+}
+
+/* Roll up blocks into the CBC-MAC.
+ *
+ * @param [in]      ks      Key schedule.
+ * @param [in, out] x       CBC-MAC of blocks so far.
+ * @param [in]      in      Blocks to roll up.
+ * @param [in]      blocks  Number of blocks.
+ */
+static void sm4_cmac_roll(const word32* ks, byte* x, const byte* in,
+    word32 blocks)
+{
+    while (blocks--) {
+        /* XOR in next block and encrypt. */
+        xorbuf(x, in, SM4_BLOCK_SIZE);
+        sm4_encrypt(ks, x, x);
+        in += SM4_BLOCK_SIZE;
+    }
+}
+
+/* Initialize the SM4-CMAC object.
+ *
+ * @param [in, out] cmac   SM4-CMAC object.
+ * @param [in]      heap   Heap hint for dynamic memory allocation.
+ * @param [in]      devId  Device identifier.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when cmac is NULL.
+ */
+int wc_Sm4CmacInit(wc_Sm4Cmac* cmac, void* heap, int devId)
+{
+    int ret = 0;
+
+    /* Validate parameters. */
+    if (cmac == NULL) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    if (ret == 0) {
+        XMEMSET(cmac, 0, sizeof(*cmac));
+        ret = wc_Sm4Init(&cmac->sm4, heap, devId);
+    }
+
+    return ret;
+}
+
+/* Dispose of the SM4-CMAC object.
+ *
+ * Zeroizes key data and state.
+ *
+ * @param [in, out] cmac  SM4-CMAC object.
+ */
+void wc_Sm4CmacFree(wc_Sm4Cmac* cmac)
+{
+    /* Check we have something to work with. */
+    if (cmac != NULL) {
+        wc_Sm4Free(&cmac->sm4);
+        ForceZero(cmac->k1, sizeof(cmac->k1));
+        ForceZero(cmac->k2, sizeof(cmac->k2));
+        ForceZero(cmac->digest, sizeof(cmac->digest));
+        ForceZero(cmac->buffer, sizeof(cmac->buffer));
+        cmac->bufferSz = 0;
+    }
+}
+
+/* Set the SM4-CMAC key.
+ *
+ * Subkeys are calculated here and used for every message.
+ * Any message in progress is discarded.
+ * With WOLFSSL_SM4_SHARED_KEY_ONLY, wc_Sm4CmacFree() must be called to free
+ * the key data.
+ *
+ * @param [in, out] cmac  SM4-CMAC object.
+ * @param [in]      key   Array of bytes representing key.
+ * @param [in]      len   Length of key. Must be SM4_KEY_SIZE.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when cmac or key is NULL.
+ * @return  BAD_FUNC_ARG when len is not SM4_KEY_SIZE.
+ * @return  MEMORY_E when dynamic memory allocation fails.
+ */
+int wc_Sm4CmacSetKey(wc_Sm4Cmac* cmac, const byte* key, word32 len)
+{
+    int ret = 0;
+
+    /* Validate parameters. */
+    if ((cmac == NULL) || (key == NULL) || (len != SM4_KEY_SIZE)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    if (ret == 0) {
+        ret = sm4_set_key(&cmac->sm4, key);
+    }
+    if (ret == 0) {
+        /* L is encrypted all zeros block. K1 = 2.L, K2 = 2.K1 */
+        XMEMSET(cmac->k1, 0, SM4_BLOCK_SIZE);
+        sm4_encrypt(SM4_KS(&cmac->sm4), cmac->k1, cmac->k1);
+        sm4_cmac_dbl(cmac->k1, cmac->k1);
+        sm4_cmac_dbl(cmac->k2, cmac->k1);
+
+        /* Start a new message. */
+        XMEMSET(cmac->digest, 0, SM4_BLOCK_SIZE);
+        cmac->bufferSz = 0;
+    }
+
+    return ret;
+}
+
+/* Add data to the message being authenticated with SM4-CMAC.
+ *
+ * The last block is kept until final as it has a subkey added.
+ *
+ * @param [in, out] cmac  SM4-CMAC object.
+ * @param [in]      in    Data to authenticate. May be NULL when sz is 0.
+ * @param [in]      sz    Length of data in bytes.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when cmac is NULL.
+ * @return  BAD_FUNC_ARG when in is NULL and sz is not 0.
+ * @return  MISSING_KEY when a key has not been set.
+ */
+int wc_Sm4CmacUpdate(wc_Sm4Cmac* cmac, const byte* in, word32 sz)
+{
+    int ret = 0;
+
+    /* Validate parameters. */
+    if ((cmac == NULL) || ((in == NULL) && (sz != 0))) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    /* Ensure a key has been set. */
+    if ((ret == 0) && (!cmac->sm4.keySet)) {
+        ret = MISSING_KEY;
+    }
+
+    if ((ret == 0) && (sz > 0)) {
+        const word32* ks = SM4_KS(&cmac->sm4);
+
+        if (cmac->bufferSz > 0) {
+            word32 n = min(SM4_BLOCK_SIZE - cmac->bufferSz, sz);
+
+            /* Fill up buffered block. */
+            XMEMCPY(cmac->buffer + cmac->bufferSz, in, n);
+            cmac->bufferSz += n;
+            in += n;
+            sz -= n;
+            /* Buffered block is not the last when more data. */
+            if (sz > 0) {
+                sm4_cmac_roll(ks, cmac->digest, cmac->buffer, 1);
+                cmac->bufferSz = 0;
+            }
+        }
+        if (sz > SM4_BLOCK_SIZE) {
+            /* Roll up all blocks in place but the one holding last byte. */
+            word32 blocks = (sz - 1) / SM4_BLOCK_SIZE;
+
+            sm4_cmac_roll(ks, cmac->digest, in, blocks);
+            in += blocks * SM4_BLOCK_SIZE;
+            sz -= blocks * SM4_BLOCK_SIZE;
+        }
+        if (sz > 0) {
+            /* Keep what may be the last block. */
+            XMEMCPY(cmac->buffer, in, sz);
+            cmac->bufferSz = sz;
+        }
+    }
+
+    return ret;
+}
+
+/* Calculate the SM4-CMAC of the message and start a new message.
+ *
+ * @param [in, out] cmac  SM4-CMAC object.
+ * @param [out]     t     Full authentication tag. SM4_BLOCK_SIZE bytes.
+ */
+static void sm4_cmac_final(wc_Sm4Cmac* cmac, byte* t)
+{
+    if (cmac->bufferSz == SM4_BLOCK_SIZE) {
+        /* Complete last block has K1 added. */
+        xorbuf(cmac->buffer, cmac->k1, SM4_BLOCK_SIZE);
+    }
+    else {
+        /* Partial or empty last block is padded and has K2 added. */
+        cmac->buffer[cmac->bufferSz] = 0x80;
+        XMEMSET(cmac->buffer + cmac->bufferSz + 1, 0,
+            SM4_BLOCK_SIZE - 1 - cmac->bufferSz);
+        xorbuf(cmac->buffer, cmac->k2, SM4_BLOCK_SIZE);
+    }
+    sm4_cmac_roll(SM4_KS(&cmac->sm4), cmac->digest, cmac->buffer, 1);
+    XMEMCPY(t, cmac->digest, SM4_BLOCK_SIZE);
+
+    /* Start a new message. */
+    XMEMSET(cmac->digest, 0, SM4_BLOCK_SIZE);
+    ForceZero(cmac->buffer, sizeof(cmac->buffer));
+    cmac->bufferSz = 0;
+}
+
+/* Calculate the SM4-CMAC authentication tag of the message.
+ *
+ * The object is ready for a new message with the same key afterwards.
+ *
+ * @param [in, out] cmac   SM4-CMAC object.
+ * @param [out]     tag    Authentication tag.
+ * @param [in]      tagSz  Length of authentication tag in bytes.
+ *                         Must be from SM4_CMAC_TAG_MIN_SZ to SM4_BLOCK_SIZE.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when cmac or tag is NULL.
+ * @return  BAD_FUNC_ARG when tagSz is out of range.
+ * @return  MISSING_KEY when a key has not been set.
+ */
+int wc_Sm4CmacFinal(wc_Sm4Cmac* cmac, byte* tag, word32 tagSz)
+{
+    int ret = 0;
+    ALIGN16 byte t[SM4_BLOCK_SIZE];
+
+    /* Validate parameters. */
+    if ((cmac == NULL) || (tag == NULL)) {
+        ret = BAD_FUNC_ARG;
+    }
+    if ((tagSz < SM4_CMAC_TAG_MIN_SZ) || (tagSz > SM4_BLOCK_SIZE)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    /* Ensure a key has been set. */
+    if ((ret == 0) && (!cmac->sm4.keySet)) {
+        ret = MISSING_KEY;
+    }
+
+    if (ret == 0) {
+        sm4_cmac_final(cmac, t);
+        XMEMCPY(tag, t, tagSz);
+    }
+
+    return ret;
+}
+
+/* Check the SM4-CMAC authentication tag of the message.
+ *
+ * The object is ready for a new message with the same key afterwards.
+ *
+ * @param [in, out] cmac   SM4-CMAC object.
+ * @param [in]      tag    Authentication tag to compare against calculated.
+ * @param [in]      tagSz  Length of authentication tag in bytes.
+ *                         Must be from SM4_CMAC_TAG_MIN_SZ to SM4_BLOCK_SIZE.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when cmac or tag is NULL.
+ * @return  BAD_FUNC_ARG when tagSz is out of range.
+ * @return  MISSING_KEY when a key has not been set.
+ * @return  MAC_CMP_FAILED_E when authentication tag calculated does not
+ *          match the one passed in.
+ */
+int wc_Sm4CmacVerify(wc_Sm4Cmac* cmac, const byte* tag, word32 tagSz)
+{
+    int ret = 0;
+    ALIGN16 byte t[SM4_BLOCK_SIZE];
+
+    /* Validate parameters. */
+    if ((cmac == NULL) || (tag == NULL)) {
+        ret = BAD_FUNC_ARG;
+    }
+    if ((tagSz < SM4_CMAC_TAG_MIN_SZ) || (tagSz > SM4_BLOCK_SIZE)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    /* Ensure a key has been set. */
+    if ((ret == 0) && (!cmac->sm4.keySet)) {
+        ret = MISSING_KEY;
+    }
+
+    if (ret == 0) {
+        sm4_cmac_final(cmac, t);
+        /* Compare tag and calculated tag in constant time. */
+        if (ConstantCompare(tag, t, (int)tagSz) != 0) {
+            ret = MAC_CMP_FAILED_E;
+        }
+    }
+
+    return ret;
+}
+
+/* Messages of a burst being authenticated with SM4-CMAC.
+ *
+ * Each lane holds a message. The next block of every message is encrypted
+ * together so the serial chains of independent messages are interleaved.
+ */
+typedef struct Sm4CmacBurst {
+    /* CBC-MAC of each message. */
+    ALIGN16 byte x[SM4_MK_BLOCKS * SM4_BLOCK_SIZE];
+    /* Key schedule of each message. */
+    const word32* mks[SM4_MK_BLOCKS];
+    /* Packet of each message. */
+    wc_Sm4CmacPacket* pkt[SM4_MK_BLOCKS];
+    /* Offset into packet data of next block of each message. */
+    word32 off[SM4_MK_BLOCKS];
+    /* Whether last block of message is being encrypted. */
+    byte last[SM4_MK_BLOCKS];
+    /* Number of messages in lanes. */
+    word32 n;
+} Sm4CmacBurst;
+
+/* Add the next block of the message in a lane into its CBC-MAC.
+ *
+ * @param [in, out] b  Burst of messages.
+ * @param [in]      i  Lane of message.
+ */
+static void sm4_cmac_burst_next(Sm4CmacBurst* b, word32 i)
+{
+    wc_Sm4CmacPacket* p = b->pkt[i];
+    byte* x = b->x + i * SM4_BLOCK_SIZE;
+    word32 rem = p->sz - b->off[i];
+
+    if (rem > SM4_BLOCK_SIZE) {
+        xorbuf(x, p->in + b->off[i], SM4_BLOCK_SIZE);
+        b->off[i] += SM4_BLOCK_SIZE;
+    }
+    else if (rem == SM4_BLOCK_SIZE) {
+        /* Complete last block has K1 added. */
+        xorbuf(x, p->in + b->off[i], SM4_BLOCK_SIZE);
+        xorbuf(x, p->cmac->k1, SM4_BLOCK_SIZE);
+        b->last[i] = 1;
+    }
+    else {
+        /* Partial or empty last block is padded and has K2 added. */
+        if (rem > 0) {
+            xorbuf(x, p->in + b->off[i], rem);
+        }
+        x[rem] ^= 0x80;
+        xorbuf(x, p->cmac->k2, SM4_BLOCK_SIZE);
+        b->last[i] = 1;
+    }
+}
+
+/* Authenticate the messages of the packets as a burst.
+ *
+ * Lanes freed by finished messages are filled with the next packets.
+ *
+ * @param [in, out] b    Burst of messages.
+ * @param [in, out] pkt  Array of packets. Packets with an error are skipped.
+ * @param [in]      cnt  Number of packets.
+ */
+static void sm4_cmac_burst_run(Sm4CmacBurst* b, wc_Sm4CmacPacket* pkt,
+    word32 cnt)
+{
+    word32 i;
+
+    b->n = 0;
+    while ((cnt > 0) || (b->n > 0)) {
+        /* Start new messages in free lanes. */
+        while ((b->n < SM4_MK_BLOCKS) && (cnt > 0)) {
+            if (pkt->ret == 0) {
+                i = b->n++;
+                b->pkt[i] = pkt;
+                b->mks[i] = SM4_KS(&pkt->cmac->sm4);
+                b->off[i] = 0;
+                b->last[i] = 0;
+                XMEMSET(b->x + i * SM4_BLOCK_SIZE, 0, SM4_BLOCK_SIZE);
+            }
+            pkt++;
+            cnt--;
+        }
+        if (b->n == 0) {
+            break;
+        }
+
+        /* Encrypt next block of all messages together. */
+        for (i = 0; i < b->n; i++) {
+            sm4_cmac_burst_next(b, i);
+        }
+        sm4_blocks_mk(b->mks, b->x, b->x, b->n);
+
+        /* Output tags of finished messages and free their lanes. */
+        i = 0;
+        while (i < b->n) {
+            if (!b->last[i]) {
+                i++;
+                continue;
+            }
+            XMEMCPY(b->pkt[i]->tag, b->x + i * SM4_BLOCK_SIZE,
+                b->pkt[i]->tagSz);
+            /* Move message in last lane into this one. */
+            b->n--;
+            if (i < b->n) {
+                b->pkt[i] = b->pkt[b->n];
+                b->mks[i] = b->mks[b->n];
+                b->off[i] = b->off[b->n];
+                b->last[i] = b->last[b->n];
+                XMEMCPY(b->x + i * SM4_BLOCK_SIZE,
+                    b->x + b->n * SM4_BLOCK_SIZE, SM4_BLOCK_SIZE);
+            }
+        }
+    }
+}
+
+/* Authenticate a burst of messages using SM4-CMAC.
+ *
+ * Each packet may use a different key. A block of each message is encrypted
+ * at the same time - bitsliced implementation interleaves messages with
+ * different keys. Only the key and subkeys of each SM4-CMAC object are used,
+ * so one object may be used by many packets.
+ * The result of each packet is placed in its ret field.
+ *
+ * @param [in, out] pkt  Array of packets.
+ * @param [in]      cnt  Number of packets.
+ * @return  0 when all packets were authenticated.
+ * @return  BAD_FUNC_ARG when pkt is NULL.
+ * @return  MEMORY_E when dynamic memory allocation fails.
+ * @return  Error of first packet that failed otherwise.
+ */
+int wc_Sm4CmacBurst(wc_Sm4CmacPacket* pkt, word32 cnt)
+{
+    int ret = 0;
+#ifdef WOLFSSL_SMALL_STACK
+    Sm4CmacBurst* b = NULL;
+#else
+    Sm4CmacBurst b[1];
+#endif
+    word32 i;
+
+    /* Validate parameters. */
+    if ((pkt == NULL) && (cnt > 0)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+#ifdef WOLFSSL_SMALL_STACK
+    if ((ret == 0) && (cnt > 0)) {
+        b = (Sm4CmacBurst*)XMALLOC(sizeof(Sm4CmacBurst), NULL,
+            DYNAMIC_TYPE_TMP_BUFFER);
+        if (b == NULL) {
+            ret = MEMORY_E;
+        }
+    }
+#endif
+    if ((ret == 0) && (cnt > 0)) {
+        for (i = 0; i < cnt; i++) {
+            wc_Sm4CmacPacket* p = &pkt[i];
+
+            p->ret = 0;
+            /* Validate packet. */
+            if ((p->cmac == NULL) || ((p->sz != 0) && (p->in == NULL)) ||
+                    (p->tag == NULL)) {
+                p->ret = BAD_FUNC_ARG;
+            }
+            if ((p->tagSz < SM4_CMAC_TAG_MIN_SZ) ||
+                    (p->tagSz > SM4_BLOCK_SIZE)) {
+                p->ret = BAD_FUNC_ARG;
+            }
+            /* Ensure a key has been set. */
+            if ((p->ret == 0) && (!p->cmac->sm4.keySet)) {
+                p->ret = MISSING_KEY;
+            }
+        }
+
+        sm4_cmac_burst_run(b, pkt, cnt);
+        ForceZero(b->x, sizeof(b->x));
+
+        /* Return error of first packet that failed. */
+        for (i = 0; (ret == 0) && (i < cnt); i++) {
+            ret = pkt[i].ret;
+        }
+    }
+
+#ifdef WOLFSSL_SMALL_STACK
+    XFREE(b, NULL, DYNAMIC_TYPE_TMP_BUFFER);
+#endif
+    return ret;
+}
+
+#endif /* WOLFSSL_SM4_CMAC */
+
+#if defined(WOLFSSL_SM_IOV) && (defined(WOLFSSL_SM4_CBC) || \
+    defined(WOLFSSL_SM4_CTR) || defined(WOLFSSL_SM4_GCM) || \
+    defined(WOLFSSL_SM4_CCM))
+
+/* Position in a list of buffers. */
+typedef struct Sm4IovPos {
+    /* List of buffers and number of buffers. */
+    const wc_SmIov* iov;
+    word32 cnt;
+    /* Index of current buffer. */
+    word32 idx;
+    /* Offset into current buffer. */
+    word32 off;
+} Sm4IovPos;
+
+/* Start at the beginning of a list of buffers and get the total length.
+ *
+ * @param [out] p    Position in list of buffers.
+ * @param [in]  iov  List of buffers.
+ * @param [in]  cnt  Number of buffers in list.
+ * @param [out] len  Total length of buffers in bytes.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when iov is NULL and cnt is not 0.
+ * @return  BAD_FUNC_ARG when a buffer is NULL and its length is not 0.
+ * @return  BAD_FUNC_ARG when total length doesn't fit in 32 bits.
+ */
+static int sm4_iov_start(Sm4IovPos* p, const wc_SmIov* iov, word32 cnt,
+    word32* len)
+{
+    int ret = 0;
+    word32 total = 0;
+    word32 i;
+
+    /* Validate parameters. */
+    if ((iov == NULL) && (cnt > 0)) {
+        ret = BAD_FUNC_ARG;
+    }
+    for (i = 0; (ret == 0) && (i < cnt); i++) {
+        if (((iov[i].buf == NULL) && (iov[i].len > 0)) ||
+                (total + iov[i].len < total)) {
+            ret = BAD_FUNC_ARG;
+        }
+        total += iov[i].len;
+    }
+
+    p->iov = iov;
+    p->cnt = cnt;
+    p->idx = 0;
+    p->off = 0;
+    *len = total;
+    return ret;
+}
+
+/* Get the contiguous bytes at the position.
+ *
+ * Empty buffers are skipped.
+ *
+ * @param [in, out] p    Position in list of buffers.
+ * @param [out]     buf  Bytes at position.
+ * @return  Number of contiguous bytes at position. 0 at end of list.
+ */
+static word32 sm4_iov_avail(Sm4IovPos* p, byte** buf)
+{
+    word32 n = 0;
+
+    /* Move on to next buffer when current one is used up. */
+    while ((p->idx < p->cnt) && (p->off == p->iov[p->idx].len)) {
+        p->idx++;
+        p->off = 0;
+    }
+    if (p->idx < p->cnt) {
+        *buf = p->iov[p->idx].buf + p->off;
+        n = p->iov[p->idx].len - p->off;
+    }
+
+    return n;
+}
+
+#if defined(WOLFSSL_SM4_CTR) || defined(WOLFSSL_SM4_GCM) || \
+    defined(WOLFSSL_SM4_CCM)
+/* Get the bytes that are contiguous in both the output and input.
+ *
+ * Positions are moved past the bytes.
+ *
+ * @param [in, out] o    Position in output buffers.
+ * @param [in, out] i    Position in input buffers.
+ * @param [in]      sz   Maximum number of bytes.
+ * @param [out]     out  Output bytes.
+ * @param [out]     in   Input bytes.
+ * @return  Number of contiguous bytes.
+ */
+static word32 sm4_iov_span(Sm4IovPos* o, Sm4IovPos* i, word32 sz, byte** out,
+    const byte** in)
+{
+    byte* ib = NULL;
+    word32 n;
+
+    n = min(sm4_iov_avail(o, out), sm4_iov_avail(i, &ib));
+    n = min(n, sz);
+    *in = ib;
+    o->off += n;
+    i->off += n;
+
+    return n;
+}
+#endif
+
+/* Validate SM4 object and lists of buffers for output and input.
+ *
+ * @param [in]  sm4     SM4 algorithm object.
+ * @param [out] o       Position at start of output buffers.
+ * @param [in]  out     List of output buffers.
+ * @param [in]  outCnt  Number of output buffers.
+ * @param [out] i       Position at start of input buffers.
+ * @param [in]  in      List of input buffers.
+ * @param [in]  inCnt   Number of input buffers.
+ * @param [out] sz      Total length of input in bytes.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4 is NULL or a list of buffers is invalid.
+ * @return  BUFFER_E when output buffers are shorter than input buffers.
  * @return  MISSING_KEY when a key has not been set.
- * @return  SM4_GCM_AUTH_E when authentication tag calculated does not match
- *          the one passed in.
  */
-int wc_Sm4GcmDecrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz,
-    const byte* nonce, word32 nonceSz, const byte* tag, word32 tagSz,
-    const byte* aad, word32 aadSz)
+static int sm4_iov_init(wc_Sm4* sm4, Sm4IovPos* o, const wc_SmIov* out,
+    word32 outCnt, Sm4IovPos* i, const wc_SmIov* in, word32 inCnt, word32* sz)
 {
     int ret = 0;
+    word32 outSz = 0;
 
     /* Validate parameters. */
-    if ((sm4 == NULL) || ((sz != 0) && ((in == NULL) || (out == NULL))) ||
-            (nonce == NULL) || (tag == NULL)) {
+    if (sm4 == NULL) {
         ret = BAD_FUNC_ARG;
     }
-    if ((tagSz < WOLFSSL_MIN_AUTH_TAG_SZ) || (tagSz > SM4_BLOCK_SIZE)) {
-        ret = BAD_FUNC_ARG;
+    if (ret == 0) {
+        ret = sm4_iov_start(i, in, inCnt, sz);
     }
-    if (nonceSz == 0) {
-        ret = BAD_FUNC_ARG;
+    if (ret == 0) {
+        ret = sm4_iov_start(o, out, outCnt, &outSz);
+    }
+    if ((ret == 0) && (outSz < *sz)) {
+        ret = BUFFER_E;
     }
 
     /* Ensure a key has been set. */
@@ -1519,358 +6561,737 @@ int wc_Sm4GcmDecrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz,
         ret = MISSING_KEY;
     }
 
-    if (ret == 0) {
-    #ifdef OPENSSL_EXTRA
-        sm4->nonceSz = (int)nonceSz;
-    #endif
-        /* Perform decryption using C implementation. */
-        ret = sm4_gcm_decrypt_c(sm4, out, in, sz, nonce, nonceSz, tag, tagSz,
-            aad, aadSz);
-    }
-
     return ret;
 }
 
-#endif /* WOLFSSL_SM4_GCM */
+#ifdef WOLFSSL_SM4_CBC
+/* Copy bytes out of buffers.
+ *
+ * @param [in, out] p   Position in list of buffers.
+ * @param [out]     b   Byte array to copy into.
+ * @param [in]      sz  Number of bytes to copy.
+ */
+static void sm4_iov_gather(Sm4IovPos* p, byte* b, word32 sz)
+{
+    byte* buf = NULL;
 
-#ifdef WOLFSSL_SM4_CCM
+    while (sz > 0) {
+        word32 n = min(sm4_iov_avail(p, &buf), sz);
 
-/* Roll up data.
- *
- * Encrypt each block XORed into out.
+        XMEMCPY(b, buf, n);
+        p->off += n;
+        b += n;
+        sz -= n;
+    }
+}
+
+/* Copy bytes into buffers.
  *
- * @param [in]      sm4  SM4 algorithm object.
- * @param [in]      in   Data to roll up.
- * @param [in]      sz   Length in bytes of data.
- * @param [in, out] out  Block XORed into and encrypted.
+ * @param [in, out] p   Position in list of buffers.
+ * @param [in]      b   Byte array to copy from.
+ * @param [in]      sz  Number of bytes to copy.
  */
-static void sm4_ccm_roll_x(wc_Sm4* sm4, const byte* in, word32 sz, byte* out)
+static void sm4_iov_scatter(Sm4IovPos* p, const byte* b, word32 sz)
 {
-    /* XOR in each block and encrypt each result. */
-    while (sz >= SM4_BLOCK_SIZE) {
-        /* XOR in next block. */
-        xorbuf(out, in, SM4_BLOCK_SIZE);
-        /* Move on past block. */
-        in += SM4_BLOCK_SIZE;
-        sz -= SM4_BLOCK_SIZE;
-        /* Encrypt into self. */
-        sm4_encrypt(sm4->ks, out, out);
-    }
+    byte* buf = NULL;
 
-    /* XOR in a block of data and encrypt result. */
-    if (sz > 0) {
-        /* XOR in partial block. */
-        xorbuf(out, in, sz);
-        /* Encrypt into self. */
-        sm4_encrypt(sm4->ks, out, out);
+    while (sz > 0) {
+        word32 n = min(sm4_iov_avail(p, &buf), sz);
+
+        XMEMCPY(buf, b, n);
+        p->off += n;
+        b += n;
+        sz -= n;
     }
 }
 
-/* Roll up additional authentication data (AAD).
- *
- * First block has length plus ant AAD XORed in before being encrypted.
+/* Encrypt or decrypt lists of buffers using SM4-CBC.
  *
- * @param [in]  sm4  SM4 algorithm object.
- * @param [in]  in   Additional authentication data to roll up.
- * @param [in]  sz   Length in bytes of data.
- * @param [out] out  Block XORed into and encrypted.
+ * @param [in] sm4     SM4 algorithm object.
+ * @param [in] out     List of buffers to place output data in.
+ * @param [in] outCnt  Number of output buffers.
+ * @param [in] in      List of buffers holding input data.
+ * @param [in] inCnt   Number of input buffers.
+ * @param [in] enc     1 to encrypt, 0 to decrypt.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4 is NULL or a list of buffers is invalid.
+ * @return  BAD_FUNC_ARG when input length is not a multiple of
+ *          SM4_BLOCK_SIZE.
+ * @return  BUFFER_E when output buffers are shorter than input buffers.
+ * @return  MISSING_KEY when a key has not been set.
+ * @return  MISSING_IV when an IV has not been set.
  */
-static void sm4_ccm_roll_aad(wc_Sm4* sm4, const byte* in, word32 sz, byte* out)
+static int sm4_cbc_iov(wc_Sm4* sm4, const wc_SmIov* out, word32 outCnt,
+    const wc_SmIov* in, word32 inCnt, int enc)
 {
-    word32 aadLenSz;
-    word32 remainder;
+    int ret;
+    Sm4IovPos o;
+    Sm4IovPos i;
+    word32 sz = 0;
 
-    /* XOR length at start of block. */
-    if (sz <= 0xFEFF) {
-        /* Two bytes used to represent length. */
-        aadLenSz = 2;
-        out[0] ^= ((sz & 0xFF00) >> 8);
-        out[1] ^=  (sz & 0x00FF);
+    ret = sm4_iov_init(sm4, &o, out, outCnt, &i, in, inCnt, &sz);
+    if ((ret == 0) && ((sz & (SM4_BLOCK_SIZE - 1)) != 0)) {
+        ret = BAD_FUNC_ARG;
     }
-    else {
-        /* Four bytes used to represent length plus two unique bytes. */
-        aadLenSz = 6;
-        out[0] ^= 0xFF;
-        out[1] ^= 0xFE;
-        out[2] ^= (byte)((sz & 0xFF000000) >> 24);
-        out[3] ^= (byte)((sz & 0x00FF0000) >> 16);
-        out[4] ^= (byte)((sz & 0x0000FF00) >>  8);
-        out[5] ^= (byte) (sz & 0x000000FF);
+    /* Ensure an IV has been set. */
+    if ((ret == 0) && (!sm4->ivSet)) {
+        ret = MISSING_IV;
     }
 
-    /* Calculate number of input bytes required to make up the block. */
-    remainder = SM4_BLOCK_SIZE - aadLenSz;
-    /* Check how much AAD available. */
-    if (sz >= remainder) {
-        /* XOR up to block into out. */
-        xorbuf(out + aadLenSz, in, remainder);
-        /* Move past data. */
-        sz -= remainder;
-        in += remainder;
+    while ((ret == 0) && (sz > 0)) {
+        byte* ob = NULL;
+        byte* ib = NULL;
+        word32 n;
+
+        /* Whole blocks that are contiguous in both output and input. */
+        n = min(sm4_iov_avail(&o, &ob), sm4_iov_avail(&i, &ib));
+        n &= ~(word32)(SM4_BLOCK_SIZE - 1);
+        if (n > 0) {
+            if (enc) {
+                ret = wc_Sm4CbcEncrypt(sm4, ob, ib, n);
+            }
+            else {
+                ret = wc_Sm4CbcDecrypt(sm4, ob, ib, n);
+            }
+            o.off += n;
+            i.off += n;
+        }
+        else {
+            ALIGN16 byte b[SM4_BLOCK_SIZE];
+
+            /* Block straddles buffers - copy in, process and copy out. */
+            n = SM4_BLOCK_SIZE;
+            sm4_iov_gather(&i, b, n);
+            if (enc) {
+                ret = wc_Sm4CbcEncrypt(sm4, b, b, n);
+            }
+            else {
+                ret = wc_Sm4CbcDecrypt(sm4, b, b, n);
+            }
+            sm4_iov_scatter(&o, b, n);
+            ForceZero(b, sizeof(b));
+        }
+        sz -= n;
     }
-    else {
-        /* XOR in AAD available. */
-        xorbuf(out + aadLenSz, in, sz);
-        /* All AAD used. */
-        sz = 0;
+
+    return ret;
+}
+
+/* Encrypt a list of buffers using SM4-CBC.
+ *
+ * Blocks that straddle buffers are handled internally. The input length must
+ * be a multiple of the block size. Output and input may be the same list.
+ *
+ * @param [in] sm4     SM4 algorithm object.
+ * @param [in] out     List of buffers to place encrypted data in.
+ * @param [in] outCnt  Number of output buffers.
+ * @param [in] in      List of buffers holding data to encrypt.
+ * @param [in] inCnt   Number of input buffers.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4 is NULL or a list of buffers is invalid.
+ * @return  BAD_FUNC_ARG when input length is not a multiple of
+ *          SM4_BLOCK_SIZE.
+ * @return  BUFFER_E when output buffers are shorter than input buffers.
+ * @return  MISSING_KEY when a key has not been set.
+ * @return  MISSING_IV when an IV has not been set.
+ */
+int wc_Sm4CbcEncryptIov(wc_Sm4* sm4, const wc_SmIov* out, word32 outCnt,
+    const wc_SmIov* in, word32 inCnt)
+{
+    return sm4_cbc_iov(sm4, out, outCnt, in, inCnt, 1);
+}
+
+/* Decrypt a list of buffers using SM4-CBC.
+ *
+ * Blocks that straddle buffers are handled internally. The input length must
+ * be a multiple of the block size. Output and input may be the same list.
+ *
+ * @param [in] sm4     SM4 algorithm object.
+ * @param [in] out     List of buffers to place decrypted data in.
+ * @param [in] outCnt  Number of output buffers.
+ * @param [in] in      List of buffers holding data to decrypt.
+ * @param [in] inCnt   Number of input buffers.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4 is NULL or a list of buffers is invalid.
+ * @return  BAD_FUNC_ARG when input length is not a multiple of
+ *          SM4_BLOCK_SIZE.
+ * @return  BUFFER_E when output buffers are shorter than input buffers.
+ * @return  MISSING_KEY when a key has not been set.
+ * @return  MISSING_IV when an IV has not been set.
+ */
+int wc_Sm4CbcDecryptIov(wc_Sm4* sm4, const wc_SmIov* out, word32 outCnt,
+    const wc_SmIov* in, word32 inCnt)
+{
+    return sm4_cbc_iov(sm4, out, outCnt, in, inCnt, 0);
+}
+#endif /* WOLFSSL_SM4_CBC */
+
+#ifdef WOLFSSL_SM4_CTR
+/* Encrypt a list of buffers using SM4-CTR.
+ *
+ * Bytes of a block that straddles buffers use the unused bytes of the
+ * encrypted counter. Output and input may be the same list.
+ *
+ * @param [in] sm4     SM4 algorithm object.
+ * @param [in] out     List of buffers to place encrypted data in.
+ * @param [in] outCnt  Number of output buffers.
+ * @param [in] in      List of buffers holding data to encrypt.
+ * @param [in] inCnt   Number of input buffers.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4 is NULL or a list of buffers is invalid.
+ * @return  BUFFER_E when output buffers are shorter than input buffers.
+ * @return  MISSING_KEY when a key has not been set.
+ * @return  MISSING_IV when an IV has not been set.
+ */
+int wc_Sm4CtrEncryptIov(wc_Sm4* sm4, const wc_SmIov* out, word32 outCnt,
+    const wc_SmIov* in, word32 inCnt)
+{
+    int ret;
+    Sm4IovPos o;
+    Sm4IovPos i;
+    word32 sz = 0;
+
+    ret = sm4_iov_init(sm4, &o, out, outCnt, &i, in, inCnt, &sz);
+    /* Ensure an IV has been set. */
+    if ((ret == 0) && (!sm4->ivSet)) {
+        ret = MISSING_IV;
     }
-    /* Encrypt into self. */
-    sm4_encrypt(sm4->ks, out, out);
 
-    if (sz > 0) {
-        /* Roll up any remaining AAD. */
-        sm4_ccm_roll_x(sm4, in, sz, out);
+    while ((ret == 0) && (sz > 0)) {
+        byte* ob = NULL;
+        const byte* ib = NULL;
+        word32 n = sm4_iov_span(&o, &i, sz, &ob, &ib);
+
+        ret = wc_Sm4CtrEncrypt(sm4, ob, ib, n);
+        sz -= n;
     }
+
+    return ret;
 }
+#endif /* WOLFSSL_SM4_CTR */
 
-/* Last bytes incremented as a big-endian number.
- *
- * Bytes not the nonce and length are incremented.
+#if defined(WOLFSSL_SM4_GCM) || defined(WOLFSSL_SM4_CCM)
+/* Counter mode key stream of SM4-GCM and SM4-CCM. */
+typedef struct Sm4IovCtr {
+    /* SM4 algorithm object. */
+    wc_Sm4* sm4;
+    /* Next counter to encrypt. */
+    ALIGN16 byte ctr[SM4_BLOCK_SIZE];
+    /* Last encrypted counter. */
+    ALIGN16 byte ks[SM4_BLOCK_SIZE];
+    /* Number of unused bytes at end of last encrypted counter. */
+    byte unused;
+    /* Number of bytes at end of block that are counter. */
+    byte ctrSz;
+} Sm4IovCtr;
+
+/* Increment the counter bytes as a big-endian number.
  *
- * @param [in, out] b      IV block.
- * @param [in]      ctrSz  Length of counter.
+ * @param [in, out] ctr    Counter block.
+ * @param [in]      ctrSz  Number of bytes at end of block that are counter.
  */
-static WC_INLINE void sm4_ccm_ctr_inc(byte* b, word32 ctrSz)
+static WC_INLINE void sm4_iov_ctr_inc(byte* ctr, byte ctrSz)
 {
-    word32 i;
+    int i;
 
-    /* Only last bytes that make up counter. */
-    for (i = 0; i < ctrSz; i++) {
+    for (i = SM4_BLOCK_SIZE - 1; i >= SM4_BLOCK_SIZE - ctrSz; i--) {
         /* Increment byte and check for carry. */
-        if ((++b[SM4_BLOCK_SIZE - 1 - i]) != 0) {
+        if ((++ctr[i]) != 0) {
             /* No carry - done. */
             break;
         }
     }
 }
 
-/* Encipher bytes using SM4-CCM.
+/* Encrypt or decrypt contiguous bytes with the counter mode key stream.
  *
- * @param [in]       sm4    SM4 algorithm object.
- * @param [out]      out    Byte array in which to place encrypted data.
- * @param [in]       in     Array of bytes to encrypt.
- * @param [in]       sz     Number of bytes to encrypt.
- * @param [in, out]  b      IV block.
- * @param [in]       ctrSz  Number of counter bytes in IV block.
+ * Unused bytes of the last encrypted counter are used first.
+ *
+ * @param [in, out] c    Counter mode key stream.
+ * @param [out]     out  Byte array in which to place output data.
+ * @param [in]      in   Array of bytes to encrypt/decrypt.
+ * @param [in]      sz   Number of bytes to encrypt/decrypt.
  */
-static WC_INLINE void sm4_ccm_crypt(wc_Sm4* sm4, byte* out, const byte* in,
-    word32 sz, byte* b, byte ctrSz)
+static void sm4_iov_ctr(Sm4IovCtr* c, byte* out, const byte* in, word32 sz)
+{
+    const word32* ks = SM4_KS(c->sm4);
+
+    if (c->unused > 0) {
+        word32 n = min(c->unused, sz);
+
+        /* Use up unused bytes of last encrypted counter. */
+        xorbufout(out, in, c->ks + SM4_BLOCK_SIZE - c->unused, n);
+        c->unused -= (byte)n;
+        in += n;
+        out += n;
+        sz -= n;
+    }
+#ifdef SM4_PARALLEL
+    if ((sz >= SM4_BLOCK_SIZE) && sm4_par_avail()) {
+        ALIGN16 byte ctr[SM4_PAR_BLOCKS * SM4_BLOCK_SIZE];
+
+        while (sz >= SM4_BLOCK_SIZE) {
+            word32 n = min(sz / SM4_BLOCK_SIZE, SM4_PAR_BLOCKS);
+            word32 j;
+
+            /* Set the counters and increment for next block. */
+            for (j = 0; j < n; j++) {
+                XMEMCPY(ctr + j * SM4_BLOCK_SIZE, c->ctr, SM4_BLOCK_SIZE);
+                sm4_iov_ctr_inc(c->ctr, c->ctrSz);
+            }
+            /* Encrypt the counters and XOR with input into output. */
+            sm4_blocks(ks, ctr, ctr, n);
+            xorbufout(out, in, ctr, n * SM4_BLOCK_SIZE);
+
+            /* Move on to next blocks. */
+            in += n * SM4_BLOCK_SIZE;
+            out += n * SM4_BLOCK_SIZE;
+            sz -= n * SM4_BLOCK_SIZE;
+        }
+        ForceZero(ctr, sizeof(ctr));
+    }
+#endif
+    while (sz > 0) {
+        word32 n = min(sz, SM4_BLOCK_SIZE);
+
+        /* Encrypt counter and increment for next block. */
+        sm4_encrypt(ks, c->ctr, c->ks);
+        sm4_iov_ctr_inc(c->ctr, c->ctrSz);
+        xorbufout(out, in, c->ks, n);
+        /* Keep bytes not used for next call. */
+        c->unused = (byte)(SM4_BLOCK_SIZE - n);
+
+        in += n;
+        out += n;
+        sz -= n;
+    }
+}
+#endif /* WOLFSSL_SM4_GCM || WOLFSSL_SM4_CCM */
+
+#ifdef WOLFSSL_SM4_GCM
+/* GHASH of data in a list of buffers. */
+typedef struct Sm4IovGhash {
+    /* SM4 algorithm object. */
+    wc_Sm4* sm4;
+    /* H - hash key. */
+    ALIGN16 byte h[SM4_BLOCK_SIZE];
+    /* Hash of blocks so far. */
+    ALIGN16 byte y[SM4_BLOCK_SIZE];
+    /* Bytes of a block that straddles buffers. */
+    ALIGN16 byte part[SM4_BLOCK_SIZE];
+    /* Number of bytes in part. */
+    byte partSz;
+} Sm4IovGhash;
+
+/* Hash whole blocks into the GHASH state.
+ *
+ * With wolfCrypt's GHASH, the state is added to the first block which is
+ * hashed as AAD so that GHASH can be used on the rest. GHASH returns (Y' ^ L) * H where Y' is the state
+ * before the last block B and L is the lengths block. The new state is
+ * (Y' ^ B) * H = GHASH ^ (L ^ B) * H.
+ *
+ * @param [in, out] g       GHASH state.
+ * @param [in]      data    Blocks of data.
+ * @param [in]      blocks  Number of blocks.
+ */
+static void sm4_iov_ghash_blocks(Sm4IovGhash* g, const byte* data,
+    word32 blocks)
 {
+#ifdef WOLFSSL_SM4_GHASH
+    /* State is hashed with blocks directly. */
+    sm4_ghash_blocks(SM4_HPOW(g->sm4), g->y, data, blocks);
+#else
     ALIGN16 byte a[SM4_BLOCK_SIZE];
 
-    /* Nonce and length have been set and counter 0 except for last byte. */
+    /* First block has state added. */
+    xorbufout(a, g->y, data, SM4_BLOCK_SIZE);
+    if (blocks == 1) {
+        sm4_gf_mul(a, g->h);
+        XMEMCPY(g->y, a, SM4_BLOCK_SIZE);
+    }
+    else {
+        ALIGN16 byte l[SM4_BLOCK_SIZE];
+        word32 cSz = (blocks - 2) * SM4_BLOCK_SIZE;
+
+        /* Hash all blocks but last after first. */
+        sm4_gcm_ghash(g->sm4, a, SM4_BLOCK_SIZE, data + SM4_BLOCK_SIZE, cSz,
+            g->y);
+        /* Remove lengths block and add in last block. */
+        sm4_gcm_set_len(l, SM4_BLOCK_SIZE, cSz);
+        xorbuf(l, data + (blocks - 1) * SM4_BLOCK_SIZE, SM4_BLOCK_SIZE);
+        sm4_gf_mul(l, g->h);
+        xorbuf(g->y, l, SM4_BLOCK_SIZE);
+    }
+    ForceZero(a, sizeof(a));
+#endif
+}
 
-    /* Set counter to 1. */
-    b[SM4_BLOCK_SIZE - 1] = 1;
-    /* Encrypting full blocks at a time. */
-    while (sz >= SM4_BLOCK_SIZE) {
-        /* Encrypt counter. */
-        sm4_encrypt(sm4->ks, b, a);
-        /* XOR in plaintext. */
-        xorbuf(a, in, SM4_BLOCK_SIZE);
-        /* Copy cipher text out. */
-        XMEMCPY(out, a, SM4_BLOCK_SIZE);
+/* Hash contiguous bytes into the GHASH state.
+ *
+ * Bytes of a block that straddles buffers are kept until the block is full.
+ *
+ * @param [in, out] g     GHASH state.
+ * @param [in]      data  Data to hash.
+ * @param [in]      sz    Number of bytes to hash.
+ */
+static void sm4_iov_ghash_update(Sm4IovGhash* g, const byte* data, word32 sz)
+{
+    if (g->partSz > 0) {
+        word32 n = min((word32)(SM4_BLOCK_SIZE - g->partSz), sz);
+
+        /* Fill up partial block. */
+        XMEMCPY(g->part + g->partSz, data, n);
+        g->partSz += (byte)n;
+        data += n;
+        sz -= n;
+        if (g->partSz == SM4_BLOCK_SIZE) {
+            sm4_iov_ghash_blocks(g, g->part, 1);
+            g->partSz = 0;
+        }
+    }
+    if (sz >= SM4_BLOCK_SIZE) {
+        word32 blocks = sz / SM4_BLOCK_SIZE;
 
-        /* Increment counter for next block. */
-        sm4_ccm_ctr_inc(b, ctrSz);
-        /* Move over block. */
-        sz -= SM4_BLOCK_SIZE;
-        in += SM4_BLOCK_SIZE;
-        out += SM4_BLOCK_SIZE;
+        /* Hash whole blocks in place. */
+        sm4_iov_ghash_blocks(g, data, blocks);
+        data += blocks * SM4_BLOCK_SIZE;
+        sz -= blocks * SM4_BLOCK_SIZE;
     }
     if (sz > 0) {
-        /* Encrypt counter. */
-        sm4_encrypt(sm4->ks, b, a);
-        /* XOR in remaining plaintext. */
-        xorbuf(a, in, sz);
-        /* Copy cipher text out. */
-        XMEMCPY(out, a, sz);
+        /* Keep start of block. */
+        XMEMCPY(g->part, data, sz);
+        g->partSz = (byte)sz;
     }
 }
 
-/* Calculate authentication tag for SM4-CCM.
+/* Hash any partial block padded with zeros.
  *
- * @param [in]       sm4    SM4 algorithm object.
- * @param [in]       plain  Array of bytes to encrypt.
- * @param [in]       sz     Number of bytes to encrypt.
- * @param [in]       aad    Additional authentication data. May be NULL.
- * @param [in]       aadSz  Length of additional authentication data in bytes.
- * @param [in, out]  b      IV block.
- * @param [in]       ctrSz  Number of counter bytes in IV block.
- * @param [out]      tag    Authentication tag calculated using CCM.
- * @param [in]       tagSz  Length of authentication tag to calculate in bytes.
+ * @param [in, out] g  GHASH state.
  */
-static WC_INLINE void sm4_ccm_calc_auth_tag(wc_Sm4* sm4, const byte* plain,
-    word32 sz, const byte* aad, word32 aadSz, byte* b, byte ctrSz,
-    byte* tag, word32 tagSz)
+static void sm4_iov_ghash_pad(Sm4IovGhash* g)
 {
-    ALIGN16 byte a[SM4_BLOCK_SIZE];
-    byte t[SM4_BLOCK_SIZE];
-    word32 i;
+    if (g->partSz > 0) {
+        XMEMSET(g->part + g->partSz, 0, SM4_BLOCK_SIZE - g->partSz);
+        sm4_iov_ghash_blocks(g, g->part, 1);
+        g->partSz = 0;
+    }
+}
 
-    /* Nonce is in place. */
+/* Hash the data in a list of buffers.
+ *
+ * @param [in, out] g  GHASH state.
+ * @param [in, out] p  Position at start of list of buffers.
+ */
+static void sm4_iov_ghash_iov(Sm4IovGhash* g, Sm4IovPos* p)
+{
+    byte* buf = NULL;
+    word32 n;
+
+    while ((n = sm4_iov_avail(p, &buf)) > 0) {
+        sm4_iov_ghash_update(g, buf, n);
+        p->off += n;
+    }
+}
+
+/* Encrypt or decrypt a list of buffers using SM4-GCM.
+ *
+ * @param [in]      sm4      SM4 algorithm object.
+ * @param [in]      out      List of buffers to place output data in.
+ * @param [in]      outCnt   Number of output buffers.
+ * @param [in]      in       List of buffers holding input data.
+ * @param [in]      inCnt    Number of input buffers.
+ * @param [in]      nonce    Array of bytes holding nonce.
+ * @param [in]      nonceSz  Length of nonce in bytes.
+ * @param [in, out] tag      Authentication tag. Calculated when encrypting,
+ *                           checked when decrypting.
+ * @param [in]      tagSz    Length of authentication tag in bytes.
+ * @param [in]      aad      Additional authentication data. May be NULL.
+ * @param [in]      aadSz    Length of additional authentication data in bytes.
+ * @param [in]      enc      1 to encrypt, 0 to decrypt.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4, nonce or tag is NULL.
+ * @return  BAD_FUNC_ARG when a list of buffers is invalid.
+ * @return  BAD_FUNC_ARG when authentication tag data length is less than
+ *          WOLFSSL_MIN_AUTH_TAG_SZ or is more than SM4_BLOCK_SIZE.
+ * @return  BAD_FUNC_ARG when nonce length is 0.
+ * @return  BUFFER_E when output buffers are shorter than input buffers.
+ * @return  MISSING_KEY when a key has not been set.
+ * @return  SM4_GCM_AUTH_E when authentication tag calculated does not match
+ *          the one passed in.
+ */
+static int sm4_gcm_iov(wc_Sm4* sm4, const wc_SmIov* out, word32 outCnt,
+    const wc_SmIov* in, word32 inCnt, const byte* nonce, word32 nonceSz,
+    byte* tag, word32 tagSz, const byte* aad, word32 aadSz, int enc)
+{
+    int ret = 0;
+    Sm4IovPos o;
+    Sm4IovPos i;
+    word32 sz = 0;
+    Sm4IovCtr c;
+    Sm4IovGhash g;
+    ALIGN16 byte s[SM4_BLOCK_SIZE];
+    ALIGN16 byte t[SM4_BLOCK_SIZE];
 
-    /* Set first byte to length and flags. */
-    b[0] = (byte)((((aad != NULL) && (aadSz > 0)) ? 0x40 : 0x00) +
-                  (8 * (((byte)tagSz - 2) / 2)) + (ctrSz - 1));
-    /* Set the counter bytes to length of data - 4 bytes of length only. */
-    for (i = 0; i < ctrSz && i < sizeof(word32); i++) {
-        b[SM4_BLOCK_SIZE - 1 - i] = (byte)(sz >> (8 * i));
+    /* Validate parameters. */
+    if ((nonce == NULL) || (tag == NULL) || ((aad == NULL) && (aadSz > 0))) {
+        ret = BAD_FUNC_ARG;
     }
-    /* Set remaining counter bytes to 0. */
-    for (; i < ctrSz; i++) {
-        b[SM4_BLOCK_SIZE - 1 - i] = 0x00;
+    if ((tagSz < WOLFSSL_MIN_AUTH_TAG_SZ) || (tagSz > SM4_BLOCK_SIZE)) {
+        ret = BAD_FUNC_ARG;
     }
-    /* Encrypt block into authentication tag block. */
-    sm4_encrypt(sm4->ks, b, a);
-
-    if ((aad != NULL) && (aadSz > 0)) {
-        /* Roll up any AAD. */
-        sm4_ccm_roll_aad(sm4, aad, aadSz, a);
+    if (nonceSz == 0) {
+        ret = BAD_FUNC_ARG;
     }
-    if (sz > 0) {
-        /* Roll up any plaintext. */
-        sm4_ccm_roll_x(sm4, plain, sz, a);
+    if (ret == 0) {
+        ret = sm4_iov_init(sm4, &o, out, outCnt, &i, in, inCnt, &sz);
     }
 
-    /* Nonce remains in place. */
-    /* Set first byte to counter size - 1. */
-    b[0] = ctrSz - 1;
-    /* Set counter to 0. */
-    for (i = 0; i < ctrSz; i++) {
-        b[SM4_BLOCK_SIZE - 1 - i] = 0;
+    if (ret == 0) {
+        word32 len = sz;
+
+    #ifdef OPENSSL_EXTRA
+        sm4->nonceSz = (int)nonceSz;
+    #endif
+        /* Encrypt initial counter for tag and start key stream after it. */
+        c.sm4 = sm4;
+        c.unused = 0;
+        c.ctrSz = CTR_SZ;
+        sm4_gcm_init_counter(sm4, nonce, nonceSz, c.ctr);
+        sm4_encrypt(SM4_KS(sm4), c.ctr, t);
+        sm4_iov_ctr_inc(c.ctr, CTR_SZ);
+
+        /* H is the encrypted all zeros block. */
+        g.sm4 = sm4;
+        g.partSz = 0;
+        XMEMSET(g.h, 0, SM4_BLOCK_SIZE);
+        sm4_encrypt(SM4_KS(sm4), g.h, g.h);
+        XMEMSET(g.y, 0, SM4_BLOCK_SIZE);
+        if (aadSz > 0) {
+            sm4_iov_ghash_update(&g, aad, aadSz);
+            sm4_iov_ghash_pad(&g);
+        }
+
+        if (enc) {
+            while (sz > 0) {
+                byte* ob = NULL;
+                const byte* ib = NULL;
+                word32 n = sm4_iov_span(&o, &i, sz, &ob, &ib);
+
+                /* Encrypt then hash cipher text while in cache. */
+                sm4_iov_ctr(&c, ob, ib, n);
+                sm4_iov_ghash_update(&g, ob, n);
+                sz -= n;
+            }
+        }
+        else {
+            /* Hash all cipher text before it is decrypted. */
+            sm4_iov_ghash_iov(&g, &i);
+            i.idx = 0;
+            i.off = 0;
+        }
+
+        /* Add in lengths block to complete GHASH. */
+        sm4_iov_ghash_pad(&g);
+        sm4_gcm_set_len(s, aadSz, len);
+        xorbuf(s, g.y, SM4_BLOCK_SIZE);
+        sm4_gf_mul(s, g.h);
+        /* XOR the encrypted initial counter into GHASH for tag. */
+        xorbuf(s, t, SM4_BLOCK_SIZE);
+
+        if (enc) {
+            XMEMCPY(tag, s, tagSz);
+        }
+        else {
+            sword32 res;
+
+            /* Compare tag and calculated tag in constant time. */
+            res = ConstantCompare(tag, s, (int)tagSz);
+            /* Create mask based on comparison result in constant time */
+            res = 0 - (sword32)(((word32)(0 - res)) >> 31U);
+            /* Mask error code to get return value. */
+            ret = res & SM4_GCM_AUTH_E;
+        #ifdef WC_SM4_GCM_DEC_AUTH_EARLY
+            /* Only decrypt when tag matches. */
+            if (ret == 0)
+        #endif
+            {
+                while (sz > 0) {
+                    byte* ob = NULL;
+                    const byte* ib = NULL;
+                    word32 n = sm4_iov_span(&o, &i, sz, &ob, &ib);
+
+                    sm4_iov_ctr(&c, ob, ib, n);
+                    sz -= n;
+                }
+            }
+        }
+
+        ForceZero(&c, sizeof(c));
+        ForceZero(&g, sizeof(g));
+        ForceZero(s, sizeof(s));
+        ForceZero(t, sizeof(t));
     }
-    /* Encrypt block into authentication tag block. */
-    sm4_encrypt(sm4->ks, b, t);
-    /* XOR in other authentication tag data. */
-    xorbufout(tag, t, a, tagSz);
+
+    return ret;
 }
 
-/* Encrypt bytes using SM4-CCM implementation in C.
+/* Encrypt a list of buffers using SM4-GCM.
+ *
+ * Blocks that straddle buffers are handled internally without copying the
+ * data. Output and input may be the same list.
  *
  * @param [in]  sm4      SM4 algorithm object.
- * @param [out] out      Byte array in which to place encrypted data.
- * @param [in]  in       Array of bytes to encrypt.
- * @param [in]  sz       Number of bytes to encrypt.
- * @param [in]  nonce    Array of bytes holding initialization vector.
+ * @param [in]  out      List of buffers to place encrypted data in.
+ * @param [in]  outCnt   Number of output buffers.
+ * @param [in]  in       List of buffers holding data to encrypt.
+ * @param [in]  inCnt    Number of input buffers.
+ * @param [in]  nonce    Array of bytes holding nonce.
  * @param [in]  nonceSz  Length of nonce in bytes.
- * @param [out] tag      Authentication tag calculated using CCM.
+ * @param [out] tag      Authentication tag calculated using GCM.
  * @param [in]  tagSz    Length of authentication tag to calculate in bytes.
  *                       Must be no more than SM4_BLOCK_SIZE.
  * @param [in]  aad      Additional authentication data. May be NULL.
  * @param [in]  aadSz    Length of additional authentication data in bytes.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4, nonce or tag is NULL.
+ * @return  BAD_FUNC_ARG when a list of buffers is invalid.
+ * @return  BAD_FUNC_ARG when authentication tag data length is less than
+ *          WOLFSSL_MIN_AUTH_TAG_SZ or is more than SM4_BLOCK_SIZE.
+ * @return  BAD_FUNC_ARG when nonce length is 0.
+ * @return  BUFFER_E when output buffers are shorter than input buffers.
+ * @return  MISSING_KEY when a key has not been set.
  */
-static void sm4_ccm_encrypt_c(wc_Sm4* sm4, byte* out, const byte* in, word32 sz,
-    const byte* nonce, word32 nonceSz, byte* tag, word32 tagSz, const byte* aad,
-    word32 aadSz)
+int wc_Sm4GcmEncryptIov(wc_Sm4* sm4, const wc_SmIov* out, word32 outCnt,
+    const wc_SmIov* in, word32 inCnt, const byte* nonce, word32 nonceSz,
+    byte* tag, word32 tagSz, const byte* aad, word32 aadSz)
 {
-    ALIGN16 byte b[SM4_BLOCK_SIZE];
-    byte ctrSz;
-
-    /* Calculate length of counter. */
-    ctrSz = SM4_BLOCK_SIZE - 1 - (byte)nonceSz;
-    /* Copy nonce in after length byte. */
-    XMEMCPY(b + 1, nonce, nonceSz);
-
-    /* Calculate authentication tag. */
-    sm4_ccm_calc_auth_tag(sm4, in, sz, aad, aadSz, b, ctrSz, tag, tagSz);
-    /* b is left with first byte counter size - 1 and counter part set to zero.
-     */
-
-    if (sz > 0) {
-        /* Encrypt plaintext to cipher text. */
-        sm4_ccm_crypt(sm4, out, in, sz, b, ctrSz);
-    }
+    return sm4_gcm_iov(sm4, out, outCnt, in, inCnt, nonce, nonceSz, tag, tagSz,
+        aad, aadSz, 1);
 }
 
-/* Decrypt bytes using SM4-CCM implementation in C.
+/* Decrypt a list of buffers using SM4-GCM.
+ *
+ * Blocks that straddle buffers are handled internally without copying the
+ * data. Output and input may be the same list.
  *
  * @param [in]  sm4      SM4 algorithm object.
- * @param [out] out      Byte array in which to place decrypted data.
- * @param [in]  in       Array of bytes to decrypt.
- * @param [in]  sz       Number of bytes to decrypt.
- * @param [in]  nonce    Array of bytes holding initialization vector.
+ * @param [in]  out      List of buffers to place decrypted data in.
+ * @param [in]  outCnt   Number of output buffers.
+ * @param [in]  in       List of buffers holding data to decrypt.
+ * @param [in]  inCnt    Number of input buffers.
+ * @param [in]  nonce    Array of bytes holding nonce.
  * @param [in]  nonceSz  Length of nonce in bytes.
- * @param [in]  tag      Authentication tag calculated using GCM.
- * @param [in]  tagSz    Length of authentication tag to calculate in bytes.
+ * @param [in]  tag      Authentication tag to compare against calculated.
+ * @param [in]  tagSz    Length of authentication tag in bytes.
  *                       Must be no more than SM4_BLOCK_SIZE.
  * @param [in]  aad      Additional authentication data. May be NULL.
  * @param [in]  aadSz    Length of additional authentication data in bytes.
  * @return  0 on success.
- * @return  SM4_CCM_AUTH_E when authentication tag calculated does not match
+ * @return  BAD_FUNC_ARG when sm4, nonce or tag is NULL.
+ * @return  BAD_FUNC_ARG when a list of buffers is invalid.
+ * @return  BAD_FUNC_ARG when authentication tag data length is less than
+ *          WOLFSSL_MIN_AUTH_TAG_SZ or is more than SM4_BLOCK_SIZE.
+ * @return  BAD_FUNC_ARG when nonce length is 0.
+ * @return  BUFFER_E when output buffers are shorter than input buffers.
+ * @return  MISSING_KEY when a key has not been set.
+ * @return  SM4_GCM_AUTH_E when authentication tag calculated does not match
  *          the one passed in.
  */
-static int sm4_ccm_decrypt_c(wc_Sm4* sm4, byte* out, const byte* in, word32 sz,
-    const byte* nonce, word32 nonceSz, const byte* tag, word32 tagSz,
-    const byte* aad, word32 aadSz)
+int wc_Sm4GcmDecryptIov(wc_Sm4* sm4, const wc_SmIov* out, word32 outCnt,
+    const wc_SmIov* in, word32 inCnt, const byte* nonce, word32 nonceSz,
+    const byte* tag, word32 tagSz, const byte* aad, word32 aadSz)
 {
-    ALIGN16 byte b[SM4_BLOCK_SIZE];
-    ALIGN16 byte t[SM4_BLOCK_SIZE];
-    byte ctrSz;
-    word32 i;
-    int ret = 0;
+    return sm4_gcm_iov(sm4, out, outCnt, in, inCnt, nonce, nonceSz,
+        (byte*)tag, tagSz, aad, aadSz, 0);
+}
+#endif /* WOLFSSL_SM4_GCM */
 
-    /* Calculate length of counter. */
-    ctrSz = SM4_BLOCK_SIZE - 1 - (byte)nonceSz;
-    /* Copy nonce in after length byte. */
-    XMEMCPY(b + 1, nonce, nonceSz);
+#ifdef WOLFSSL_SM4_CCM
+/* Roll up contiguous bytes into the CBC-MAC of SM4-CCM.
+ *
+ * A block is only encrypted once it is full.
+ *
+ * @param [in]      sm4   SM4 algorithm object.
+ * @param [in, out] a     Authentication tag block.
+ * @param [in, out] pos   Number of bytes XORed into authentication tag block.
+ * @param [in]      data  Data to roll up.
+ * @param [in]      sz    Number of bytes to roll up.
+ */
+static void sm4_iov_ccm_mac(wc_Sm4* sm4, byte* a, byte* pos, const byte* data,
+    word32 sz)
+{
+    if (*pos > 0) {
+        word32 n = min((word32)(SM4_BLOCK_SIZE - *pos), sz);
+
+        /* Fill up block. */
+        xorbuf(a + *pos, data, n);
+        *pos += (byte)n;
+        data += n;
+        sz -= n;
+        if (*pos == SM4_BLOCK_SIZE) {
+            sm4_encrypt(SM4_KS(sm4), a, a);
+            *pos = 0;
+        }
+    }
+    if (sz >= SM4_BLOCK_SIZE) {
+        word32 len = sz & (~(word32)(SM4_BLOCK_SIZE - 1));
 
-    /* Set length byte to counter size - 1. */
-    b[0] = ctrSz - 1;
-    /* Set all bytes but least significant of counter to 0. */
-    for (i = 1; i < ctrSz; i++) {
-        b[SM4_BLOCK_SIZE - 1 - i] = 0;
+        /* Roll up whole blocks in place. */
+        sm4_ccm_roll_x(sm4, data, len, a);
+        data += len;
+        sz -= len;
     }
     if (sz > 0) {
-        /* Decrypt cipher text to plaintext. */
-        sm4_ccm_crypt(sm4, out, in, sz, b, ctrSz);
-        /* b still has nonce in place. */
-    }
-
-    /* Calculate authentication tag. */
-    sm4_ccm_calc_auth_tag(sm4, out, sz, aad, aadSz, b, ctrSz, t, tagSz);
-
-    /* Compare calculated tag with passed in tag. */
-    if (ConstantCompare(t, tag, (int)tagSz) != 0) {
-        /* Set CCM authentication error return. */
-        ret = SM4_CCM_AUTH_E;
+        /* Start of block XORed in - encrypted when full or at end. */
+        xorbuf(a, data, sz);
+        *pos = (byte)sz;
     }
-
-    return ret;
 }
 
-/* Encrypt bytes using SM4-CCM.
- *
- * Assumes out is at least sz bytes long.
+/* Encrypt or decrypt a list of buffers using SM4-CCM.
  *
- * @param [in]  sm4      SM4 algorithm object.
- * @param [out] out      Byte array in which to place encrypted data.
- * @param [in]  in       Array of bytes to encrypt.
- * @param [in]  sz       Number of bytes to encrypt.
- * @param [in]  nonce    Array of bytes holding initialization vector.
- * @param [in]  nonceSz  Length of nonce in bytes.
- * @param [out] tag      Authentication tag calculated using CCM.
- * @param [in]  tagSz    Length of authentication tag to calculate in bytes.
- *                       Must be no more than SM4_BLOCK_SIZE.
- * @param [in]  aad      Additional authentication data. May be NULL.
- * @param [in]  aadSz    Length of additional authentication data in bytes.
+ * @param [in]      sm4      SM4 algorithm object.
+ * @param [in]      out      List of buffers to place output data in.
+ * @param [in]      outCnt   Number of output buffers.
+ * @param [in]      in       List of buffers holding input data.
+ * @param [in]      inCnt    Number of input buffers.
+ * @param [in]      nonce    Array of bytes holding nonce.
+ * @param [in]      nonceSz  Length of nonce in bytes.
+ * @param [in, out] tag      Authentication tag. Calculated when encrypting,
+ *                           checked when decrypting.
+ * @param [in]      tagSz    Length of authentication tag in bytes.
+ * @param [in]      aad      Additional authentication data. May be NULL.
+ * @param [in]      aadSz    Length of additional authentication data in bytes.
+ * @param [in]      enc      1 to encrypt, 0 to decrypt.
  * @return  0 on success.
- * @return  BAD_FUNC_ARG when sm4, in, out, nonce or tag is NULL.
+ * @return  BAD_FUNC_ARG when sm4, nonce or tag is NULL.
+ * @return  BAD_FUNC_ARG when a list of buffers is invalid.
  * @return  BAD_FUNC_ARG when authentication tag data length is less than
  *          4 or is more than SM4_BLOCK_SIZE or an odd value.
  * @return  BAD_FUNC_ARG when nonce length is less than CCM_NONCE_MIN_SZ or
  *          greater than CCM_NONCE_MAX_SZ.
+ * @return  BUFFER_E when output buffers are shorter than input buffers.
  * @return  MISSING_KEY when a key has not been set.
+ * @return  SM4_CCM_AUTH_E when authentication tag calculated does not match
+ *          the one passed in.
  */
-int wc_Sm4CcmEncrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz,
-    const byte* nonce, word32 nonceSz, byte* tag, word32 tagSz, const byte* aad,
-    word32 aadSz)
+static int sm4_ccm_iov(wc_Sm4* sm4, const wc_SmIov* out, word32 outCnt,
+    const wc_SmIov* in, word32 inCnt, const byte* nonce, word32 nonceSz,
+    byte* tag, word32 tagSz, const byte* aad, word32 aadSz, int enc)
 {
     int ret = 0;
+    Sm4IovPos o;
+    Sm4IovPos i;
+    word32 sz = 0;
+    Sm4IovCtr c;
+    ALIGN16 byte b[SM4_BLOCK_SIZE];
+    ALIGN16 byte a[SM4_BLOCK_SIZE];
+    ALIGN16 byte t[SM4_BLOCK_SIZE];
+    byte ctrSz;
+    byte pos = 0;
 
     /* Validate parameters. */
-    if ((sm4 == NULL) || ((sz != 0) && ((in == NULL) || (out == NULL))) ||
-            (nonce == NULL) || (tag == NULL)) {
+    if ((nonce == NULL) || (tag == NULL)) {
         ret = BAD_FUNC_ARG;
     }
     /* Tag size is even number 4..16. */
@@ -1881,33 +7302,117 @@ int wc_Sm4CcmEncrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz,
     if ((nonceSz < CCM_NONCE_MIN_SZ) || (nonceSz > CCM_NONCE_MAX_SZ)) {
         ret = BAD_FUNC_ARG;
     }
-
-    /* Ensure a key has been set. */
-    if ((ret == 0) && (!sm4->keySet)) {
-        ret = MISSING_KEY;
+    if (ret == 0) {
+        ret = sm4_iov_init(sm4, &o, out, outCnt, &i, in, inCnt, &sz);
     }
 
     if (ret == 0) {
     #ifdef OPENSSL_EXTRA
         sm4->nonceSz = (int)nonceSz;
     #endif
-        /* Perform encryption using C implementation. */
-        sm4_ccm_encrypt_c(sm4, out, in, sz, nonce, nonceSz, tag, tagSz, aad,
-            aadSz);
+        /* Calculate length of counter. */
+        ctrSz = SM4_BLOCK_SIZE - 1 - (byte)nonceSz;
+        /* Copy nonce in after length byte. */
+        XMEMCPY(b + 1, nonce, nonceSz);
+        /* Start authentication tag with length and AAD. */
+        sm4_ccm_auth_start(sm4, sz, aad, aadSz, b, ctrSz, tagSz, a);
+
+        /* Key stream starts at counter of 1. */
+        c.sm4 = sm4;
+        c.unused = 0;
+        c.ctrSz = ctrSz;
+        XMEMSET(c.ctr, 0, SM4_BLOCK_SIZE);
+        c.ctr[0] = ctrSz - 1;
+        XMEMCPY(c.ctr + 1, nonce, nonceSz);
+        c.ctr[SM4_BLOCK_SIZE - 1] = 1;
+
+        while (sz > 0) {
+            byte* ob = NULL;
+            const byte* ib = NULL;
+            word32 n = sm4_iov_span(&o, &i, sz, &ob, &ib);
+
+            /* Authentication tag is calculated on plaintext. */
+            if (enc) {
+                sm4_iov_ccm_mac(sm4, a, &pos, ib, n);
+                sm4_iov_ctr(&c, ob, ib, n);
+            }
+            else {
+                sm4_iov_ctr(&c, ob, ib, n);
+                sm4_iov_ccm_mac(sm4, a, &pos, ob, n);
+            }
+            sz -= n;
+        }
+        if (pos > 0) {
+            /* Encrypt last partial block. */
+            sm4_encrypt(SM4_KS(sm4), a, a);
+        }
+
+        if (enc) {
+            sm4_ccm_auth_final(sm4, b, ctrSz, a, tag, tagSz);
+        }
+        else {
+            sm4_ccm_auth_final(sm4, b, ctrSz, a, t, tagSz);
+            /* Compare calculated tag with passed in tag. */
+            if (ConstantCompare(t, tag, (int)tagSz) != 0) {
+                /* Set CCM authentication error return. */
+                ret = SM4_CCM_AUTH_E;
+            }
+        }
+
+        ForceZero(&c, sizeof(c));
+        ForceZero(a, sizeof(a));
+        ForceZero(t, sizeof(t));
     }
 
     return ret;
 }
 
-/* Decrypt bytes using SM4-CCM.
+/* Encrypt a list of buffers using SM4-CCM.
  *
- * Assumes out is at least sz bytes long.
+ * Blocks that straddle buffers are handled internally without copying the
+ * data. Output and input may be the same list.
  *
  * @param [in]  sm4      SM4 algorithm object.
- * @param [out] out      Byte array in which to place decrypted data.
- * @param [in]  in       Array of bytes to decrypt.
- * @param [in]  sz       Number of bytes to decrypt.
- * @param [in]  nonce    Array of bytes holding initialization vector.
+ * @param [in]  out      List of buffers to place encrypted data in.
+ * @param [in]  outCnt   Number of output buffers.
+ * @param [in]  in       List of buffers holding data to encrypt.
+ * @param [in]  inCnt    Number of input buffers.
+ * @param [in]  nonce    Array of bytes holding nonce.
+ * @param [in]  nonceSz  Length of nonce in bytes.
+ * @param [out] tag      Authentication tag calculated using CCM.
+ * @param [in]  tagSz    Length of authentication tag to calculate in bytes.
+ *                       Must be no more than SM4_BLOCK_SIZE.
+ * @param [in]  aad      Additional authentication data. May be NULL.
+ * @param [in]  aadSz    Length of additional authentication data in bytes.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when sm4, nonce or tag is NULL.
+ * @return  BAD_FUNC_ARG when a list of buffers is invalid.
+ * @return  BAD_FUNC_ARG when authentication tag data length is less than
+ *          4 or is more than SM4_BLOCK_SIZE or an odd value.
+ * @return  BAD_FUNC_ARG when nonce length is less than CCM_NONCE_MIN_SZ or
+ *          greater than CCM_NONCE_MAX_SZ.
+ * @return  BUFFER_E when output buffers are shorter than input buffers.
+ * @return  MISSING_KEY when a key has not been set.
+ */
+int wc_Sm4CcmEncryptIov(wc_Sm4* sm4, const wc_SmIov* out, word32 outCnt,
+    const wc_SmIov* in, word32 inCnt, const byte* nonce, word32 nonceSz,
+    byte* tag, word32 tagSz, const byte* aad, word32 aadSz)
+{
+    return sm4_ccm_iov(sm4, out, outCnt, in, inCnt, nonce, nonceSz, tag, tagSz,
+        aad, aadSz, 1);
+}
+
+/* Decrypt a list of buffers using SM4-CCM.
+ *
+ * Blocks that straddle buffers are handled internally without copying the
+ * data. Output and input may be the same list.
+ *
+ * @param [in]  sm4      SM4 algorithm object.
+ * @param [in]  out      List of buffers to place decrypted data in.
+ * @param [in]  outCnt   Number of output buffers.
+ * @param [in]  in       List of buffers holding data to decrypt.
+ * @param [in]  inCnt    Number of input buffers.
+ * @param [in]  nonce    Array of bytes holding nonce.
  * @param [in]  nonceSz  Length of nonce in bytes.
  * @param [in]  tag      Authentication tag to compare against calculated.
  * @param [in]  tagSz    Length of authentication tag in bytes.
@@ -1915,53 +7420,27 @@ int wc_Sm4CcmEncrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz,
  * @param [in]  aad      Additional authentication data. May be NULL.
  * @param [in]  aadSz    Length of additional authentication data in bytes.
  * @return  0 on success.
- * @return  BAD_FUNC_ARG when sm4, in, out, nonce or tag is NULL.
+ * @return  BAD_FUNC_ARG when sm4, nonce or tag is NULL.
+ * @return  BAD_FUNC_ARG when a list of buffers is invalid.
  * @return  BAD_FUNC_ARG when authentication tag data length is less than
  *          4 or is more than SM4_BLOCK_SIZE or an odd value.
  * @return  BAD_FUNC_ARG when nonce length is less than CCM_NONCE_MIN_SZ or
  *          greater than CCM_NONCE_MAX_SZ.
+ * @return  BUFFER_E when output buffers are shorter than input buffers.
  * @return  MISSING_KEY when a key has not been set.
  * @return  SM4_CCM_AUTH_E when authentication tag calculated does not match
  *          the one passed in.
  */
-int wc_Sm4CcmDecrypt(wc_Sm4* sm4, byte* out, const byte* in, word32 sz,
-    const byte* nonce, word32 nonceSz, const byte* tag, word32 tagSz,
-    const byte* aad, word32 aadSz)
+int wc_Sm4CcmDecryptIov(wc_Sm4* sm4, const wc_SmIov* out, word32 outCnt,
+    const wc_SmIov* in, word32 inCnt, const byte* nonce, word32 nonceSz,
+    const byte* tag, word32 tagSz, const byte* aad, word32 aadSz)
 {
-    int ret = 0;
-
-    /* Validate parameters. */
-    if ((sm4 == NULL) || ((sz != 0) && ((in == NULL) || (out == NULL))) ||
-            (nonce == NULL) || (tag == NULL)) {
-        ret = BAD_FUNC_ARG;
-    }
-    /* Tag size is even number 4..16. */
-    if ((tagSz < 4) || (tagSz > SM4_BLOCK_SIZE) || ((tagSz & 1) == 1)) {
-        ret = BAD_FUNC_ARG;
-    }
-    /* Nonce must be within supported range. */
-    if ((nonceSz < CCM_NONCE_MIN_SZ) || (nonceSz > CCM_NONCE_MAX_SZ)) {
-        ret = BAD_FUNC_ARG;
-    }
-
-    /* Ensure a key has been set. */
-    if ((ret == 0) && (!sm4->keySet)) {
-        ret = MISSING_KEY;
-    }
-
-    if (ret == 0) {
-    #ifdef OPENSSL_EXTRA
-        sm4->nonceSz = (int)nonceSz;
-    #endif
-        /* Perform decryption using C implementation. */
-        ret = sm4_ccm_decrypt_c(sm4, out, in, sz, nonce, nonceSz, tag, tagSz,
-            aad, aadSz);
-    }
-
-    return ret;
+    return sm4_ccm_iov(sm4, out, outCnt, in, inCnt, nonce, nonceSz,
+        (byte*)tag, tagSz, aad, aadSz, 0);
 }
+#endif /* WOLFSSL_SM4_CCM */
 
-#endif
+#endif /* WOLFSSL_SM_IOV */
 
 #endif /* WOLFSSL_SM4 */
 
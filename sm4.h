@@ -44,30 +44,89 @@ enum {
     SM4_KEY_SCHEDULE    = 32,
 };
 
+#if defined(WOLFSSL_SM4_GCM) && defined(WOLFSSL_SM4_GHASH)
+enum {
+    /* Number of powers of the GCM hash key stored to hash blocks at once. */
+    SM4_GHASH_POWERS        = 8,
+    /* Number of 64-bit words stored for each power of the hash key. */
+    SM4_GHASH_POWER_WORDS   = 6,
+};
+#endif
+
+#if defined(WOLFSSL_SM4_THREADS) && !defined(WOLFSSL_SM4_THREADS_MIN)
+    /* Minimum number of bytes for each thread to encrypt/decrypt. */
+    #define WOLFSSL_SM4_THREADS_MIN     65536
+#endif
+
+#if defined(WOLFSSL_SM4_SHARED_KEY_ONLY) && !defined(WOLFSSL_SM4_SHARED_KEY)
+    /* Key data is never held in wc_Sm4. wc_Sm4SetKey(), wc_Sm4GcmSetKey() and
+     * wc_Sm4CmacSetKey() allocate a wc_Sm4Key - wc_Sm4Free() or
+     * wc_Sm4CmacFree() must be called to free it. */
+    #define WOLFSSL_SM4_SHARED_KEY
+#endif
+
+#ifdef WOLFSSL_SM4_SHARED_KEY
+/* Expanded key data for SM4 algorithm that can be shared.
+ *
+ * Read-only once created so may be used by many SM4 objects in many threads.
+ * Reference counted - disposed of when the last reference is freed.
+ */
+typedef struct wc_Sm4Key {
+    /* Key schedule. */
+    ALIGN16 word32 ks[SM4_KEY_SCHEDULE];
+#if defined(WOLFSSL_SM4_GCM) && defined(WOLFSSL_SM4_GHASH)
+    /* Powers of GCM hash key. */
+    ALIGN16 word64 hPow[SM4_GHASH_POWERS * SM4_GHASH_POWER_WORDS];
+#elif defined(WOLFSSL_SM4_GCM)
+    /* GCM hash key and table. */
+    Gcm gcm;
+#endif
+    /* Reference count. */
+    wolfSSL_Ref ref;
+    void* heap; /* memory hint to use */
+} wc_Sm4Key;
+#endif
+
 /* Data for SM4 algorithm. */
 typedef struct wc_Sm4 {
+#ifndef WOLFSSL_SM4_SHARED_KEY_ONLY
     /* Key schedule. */
     ALIGN16 word32 ks[SM4_KEY_SCHEDULE];
+#endif
 #if defined(WOLFSSL_SM4_CBC) || defined(WOLFSSL_SM4_CTR) || \
-    defined(WOLFSSL_SM4_GCM) || \
+    defined(WOLFSSL_SM4_GCM) || defined(WOLFSSL_SM4_CFB) || \
+    defined(WOLFSSL_SM4_OFB) || \
     (defined(OPENSSL_EXTRA) && defined(WOLFSSL_SM4_CCM))
     /* Cached IV. */
     ALIGN16 byte iv[SM4_IV_SIZE];
 #endif
-#if defined(WOLFSSL_SM4_CBC) || defined(WOLFSSL_SM4_CTR)
+#if defined(WOLFSSL_SM4_CBC) || defined(WOLFSSL_SM4_CTR) || \
+    defined(WOLFSSL_SM4_CFB)
     /* Temporary buffer when encrypting/decrypting.
-     * Used in CBC decrypt and CTR encrypt.
+     * Used in CBC decrypt, CTR encrypt and CFB.
      */
     byte tmp[SM4_IV_SIZE];
 #endif
-#ifdef WOLFSSL_SM4_CTR
-    /* For CTR encrypt, unused encrypted IV/counter bytes in tmp. */
+#if defined(WOLFSSL_SM4_CTR) || defined(WOLFSSL_SM4_CFB) || \
+    defined(WOLFSSL_SM4_OFB)
+    /* For CTR and CFB, unused encrypted IV/counter bytes in tmp.
+     * For OFB, unused encrypted IV bytes in iv.
+     */
     byte unused;
 #endif
-#ifdef WOLFSSL_SM4_GCM
+#if defined(WOLFSSL_SM4_GCM) && !defined(WOLFSSL_SM4_SHARED_KEY_ONLY)
+#ifdef WOLFSSL_SM4_GHASH
+    /* Powers of GCM hash key. */
+    ALIGN16 word64 hPow[SM4_GHASH_POWERS * SM4_GHASH_POWER_WORDS];
+#else
     /* GCM data. */
     Gcm gcm;
 #endif
+#endif
+#ifdef WOLFSSL_SM4_SHARED_KEY
+    /* Shared key data. NULL when key is stored in this object. */
+    wc_Sm4Key* key;
+#endif
 #if (defined(WOLFSSL_SM4_GCM) || defined(WOLFSSL_SM4_CCM)) && \
     defined(OPENSSL_EXTRA)
     int nonceSz;
@@ -80,11 +139,83 @@ typedef struct wc_Sm4 {
 
     byte keySet:1;
 #if defined(WOLFSSL_SM4_CBC) || defined(WOLFSSL_SM4_CTR) || \
-    defined(WOLFSSL_SM4_GCM)
+    defined(WOLFSSL_SM4_GCM) || defined(WOLFSSL_SM4_CFB) || \
+    defined(WOLFSSL_SM4_OFB)
     byte ivSet:1;
 #endif
 } wc_Sm4;
 
+#if defined(WOLFSSL_SM_IOV) && !defined(WC_SM_IOV_TYPE_DEFINED)
+/* Buffer in a list of buffers for scatter/gather operations. */
+typedef struct wc_SmIov {
+    /* Data of buffer. Only read when input. */
+    byte* buf;
+    /* Length of buffer in bytes. */
+    word32 len;
+} wc_SmIov;
+#define WC_SM_IOV_TYPE_DEFINED
+#endif
+
+#ifdef WOLFSSL_SM4_CMAC
+enum {
+    /* Minimum length of SM4-CMAC authentication tag in bytes. */
+    SM4_CMAC_TAG_MIN_SZ     = SM4_BLOCK_SIZE / 4,
+};
+
+/* Data for SM4-CMAC algorithm. */
+typedef struct wc_Sm4Cmac {
+    /* SM4 algorithm object holding key. */
+    wc_Sm4 sm4;
+    /* Subkeys K1 and K2 - calculated when key is set. */
+    ALIGN16 byte k1[SM4_BLOCK_SIZE];
+    ALIGN16 byte k2[SM4_BLOCK_SIZE];
+    /* CBC-MAC of blocks so far. */
+    ALIGN16 byte digest[SM4_BLOCK_SIZE];
+    /* Unprocessed data - last block is kept until final. */
+    ALIGN16 byte buffer[SM4_BLOCK_SIZE];
+    /* Number of bytes in buffer. */
+    word32 bufferSz;
+} wc_Sm4Cmac;
+
+/* Message to authenticate with SM4-CMAC as part of a burst. */
+typedef struct wc_Sm4CmacPacket {
+    /* SM4-CMAC object with key set. Streaming state is not used. */
+    wc_Sm4Cmac* cmac;
+    /* Data to authenticate and its length in bytes. */
+    const byte* in;
+    word32 sz;
+    /* Authentication tag and its length in bytes. */
+    byte* tag;
+    word32 tagSz;
+    /* Result of operation on packet. */
+    int ret;
+} wc_Sm4CmacPacket;
+#endif
+
+#ifdef WOLFSSL_SM4_GCM
+/* Packet to encrypt or decrypt with SM4-GCM as part of a burst. */
+typedef struct wc_Sm4GcmPacket {
+    /* SM4 algorithm object with GCM key set. */
+    wc_Sm4* sm4;
+    /* Nonce and its length in bytes. */
+    const byte* nonce;
+    word32 nonceSz;
+    /* Additional authentication data and its length in bytes. May be NULL. */
+    const byte* aad;
+    word32 aadSz;
+    /* Input data, output data and their length in bytes. */
+    const byte* in;
+    byte* out;
+    word32 sz;
+    /* Authentication tag and its length in bytes.
+     * Calculated when encrypting, checked when decrypting. */
+    byte* tag;
+    word32 tagSz;
+    /* Result of operation on packet. */
+    int ret;
+} wc_Sm4GcmPacket;
+#endif
+
 
 #ifdef __cplusplus
     extern "C" {
@@ -95,16 +226,40 @@ WOLFSSL_API void wc_Sm4Free(wc_Sm4* sm4);
 
 WOLFSSL_API int wc_Sm4SetKey(wc_Sm4* sm4, const byte* key, word32 len);
 WOLFSSL_API int wc_Sm4SetIV(wc_Sm4* sm4, const byte* iv);
+#ifdef WOLFSSL_SM4_SHARED_KEY
+WOLFSSL_API wc_Sm4Key* wc_Sm4KeyNew(const byte* key, word32 len, void* heap,
+    int* result_code);
+WOLFSSL_API int wc_Sm4KeyUpRef(wc_Sm4Key* key);
+WOLFSSL_API void wc_Sm4KeyFree(wc_Sm4Key* key);
+WOLFSSL_API int wc_Sm4SetSharedKey(wc_Sm4* sm4, wc_Sm4Key* key);
+#endif
 WOLFSSL_API int wc_Sm4EcbEncrypt(wc_Sm4* sm4, byte* out, const byte* in,
     word32 sz);
 WOLFSSL_API int wc_Sm4EcbDecrypt(wc_Sm4* sm4, byte* out, const byte* in,
     word32 sz);
+WOLFSSL_API int wc_Sm4EcbEncryptBurst(wc_Sm4* const* sm4, byte* out,
+    const byte* in, word32 cnt);
 WOLFSSL_API int wc_Sm4CbcEncrypt(wc_Sm4* sm4, byte* out, const byte* in,
     word32 sz);
 WOLFSSL_API int wc_Sm4CbcDecrypt(wc_Sm4* sm4, byte* out, const byte* in,
     word32 sz);
 WOLFSSL_API int wc_Sm4CtrEncrypt(wc_Sm4* sm4, byte* out, const byte* in,
     word32 sz);
+WOLFSSL_API int wc_Sm4CtrSeek(wc_Sm4* sm4, const byte* iv, word64 offset);
+#ifdef WOLFSSL_SM4_THREADS
+WOLFSSL_API int wc_Sm4CtrEncryptParallel(wc_Sm4* sm4, byte* out,
+    const byte* in, word32 sz, int threads);
+#endif
+WOLFSSL_API int wc_Sm4CfbEncrypt(wc_Sm4* sm4, byte* out, const byte* in,
+    word32 sz);
+WOLFSSL_API int wc_Sm4CfbDecrypt(wc_Sm4* sm4, byte* out, const byte* in,
+    word32 sz);
+WOLFSSL_API int wc_Sm4Cfb8Encrypt(wc_Sm4* sm4, byte* out, const byte* in,
+    word32 sz);
+WOLFSSL_API int wc_Sm4Cfb8Decrypt(wc_Sm4* sm4, byte* out, const byte* in,
+    word32 sz);
+WOLFSSL_API int wc_Sm4OfbEncrypt(wc_Sm4* sm4, byte* out, const byte* in,
+    word32 sz);
 
 WOLFSSL_API int wc_Sm4GcmSetKey(wc_Sm4* sm4, const byte* key, word32 len);
 WOLFSSL_API int wc_Sm4GcmEncrypt(wc_Sm4* sm4, byte* out, const byte* in,
@@ -113,6 +268,23 @@ WOLFSSL_API int wc_Sm4GcmEncrypt(wc_Sm4* sm4, byte* out, const byte* in,
 WOLFSSL_API int wc_Sm4GcmDecrypt(wc_Sm4* sm4, byte* out, const byte* in,
     word32 sz, const byte* nonce, word32 nonceSz, const byte* tag, word32 tagSz,
     const byte* aad, word32 aadSz);
+#ifdef WOLFSSL_SM4_GCM
+WOLFSSL_API int wc_Sm4Gmac(wc_Sm4* sm4, const byte* nonce, word32 nonceSz,
+    const byte* aad, word32 aadSz, byte* tag, word32 tagSz);
+WOLFSSL_API int wc_Sm4GmacVerify(wc_Sm4* sm4, const byte* nonce,
+    word32 nonceSz, const byte* aad, word32 aadSz, const byte* tag,
+    word32 tagSz);
+WOLFSSL_API int wc_Sm4GcmEncryptBurst(wc_Sm4GcmPacket* pkt, word32 cnt);
+WOLFSSL_API int wc_Sm4GcmDecryptBurst(wc_Sm4GcmPacket* pkt, word32 cnt);
+#ifdef WOLFSSL_SM4_THREADS
+WOLFSSL_API int wc_Sm4GcmEncryptParallel(wc_Sm4* sm4, byte* out,
+    const byte* in, word32 sz, const byte* nonce, word32 nonceSz, byte* tag,
+    word32 tagSz, const byte* aad, word32 aadSz, int threads);
+WOLFSSL_API int wc_Sm4GcmDecryptParallel(wc_Sm4* sm4, byte* out,
+    const byte* in, word32 sz, const byte* nonce, word32 nonceSz,
+    const byte* tag, word32 tagSz, const byte* aad, word32 aadSz, int threads);
+#endif
+#endif
 
 WOLFSSL_API int wc_Sm4CcmEncrypt(wc_Sm4* sm4, byte* out, const byte* in,
     word32 sz, const byte* nonce, word32 nonceSz, byte* tag, word32 tagSz,
@@ -121,6 +293,41 @@ WOLFSSL_API int wc_Sm4CcmDecrypt(wc_Sm4* sm4, byte* out, const byte* in,
     word32 sz, const byte* nonce, word32 nonceSz, const byte* tag, word32 tagSz,
     const byte* aad, word32 aadSz);
 
+#ifdef WOLFSSL_SM4_CMAC
+WOLFSSL_API int wc_Sm4CmacInit(wc_Sm4Cmac* cmac, void* heap, int devId);
+WOLFSSL_API void wc_Sm4CmacFree(wc_Sm4Cmac* cmac);
+WOLFSSL_API int wc_Sm4CmacSetKey(wc_Sm4Cmac* cmac, const byte* key,
+    word32 len);
+WOLFSSL_API int wc_Sm4CmacUpdate(wc_Sm4Cmac* cmac, const byte* in, word32 sz);
+WOLFSSL_API int wc_Sm4CmacFinal(wc_Sm4Cmac* cmac, byte* tag, word32 tagSz);
+WOLFSSL_API int wc_Sm4CmacVerify(wc_Sm4Cmac* cmac, const byte* tag,
+    word32 tagSz);
+WOLFSSL_API int wc_Sm4CmacBurst(wc_Sm4CmacPacket* pkt, word32 cnt);
+#endif
+
+#ifdef WOLFSSL_SM_IOV
+WOLFSSL_API int wc_Sm4CbcEncryptIov(wc_Sm4* sm4, const wc_SmIov* out,
+    word32 outCnt, const wc_SmIov* in, word32 inCnt);
+WOLFSSL_API int wc_Sm4CbcDecryptIov(wc_Sm4* sm4, const wc_SmIov* out,
+    word32 outCnt, const wc_SmIov* in, word32 inCnt);
+WOLFSSL_API int wc_Sm4CtrEncryptIov(wc_Sm4* sm4, const wc_SmIov* out,
+    word32 outCnt, const wc_SmIov* in, word32 inCnt);
+WOLFSSL_API int wc_Sm4GcmEncryptIov(wc_Sm4* sm4, const wc_SmIov* out,
+    word32 outCnt, const wc_SmIov* in, word32 inCnt, const byte* nonce,
+    word32 nonceSz, byte* tag, word32 tagSz, const byte* aad, word32 aadSz);
+WOLFSSL_API int wc_Sm4GcmDecryptIov(wc_Sm4* sm4, const wc_SmIov* out,
+    word32 outCnt, const wc_SmIov* in, word32 inCnt, const byte* nonce,
+    word32 nonceSz, const byte* tag, word32 tagSz, const byte* aad,
+    word32 aadSz);
+WOLFSSL_API int wc_Sm4CcmEncryptIov(wc_Sm4* sm4, const wc_SmIov* out,
+    word32 outCnt, const wc_SmIov* in, word32 inCnt, const byte* nonce,
+    word32 nonceSz, byte* tag, word32 tagSz, const byte* aad, word32 aadSz);
+WOLFSSL_API int wc_Sm4CcmDecryptIov(wc_Sm4* sm4, const wc_SmIov* out,
+    word32 outCnt, const wc_SmIov* in, word32 inCnt, const byte* nonce,
+    word32 nonceSz, const byte* tag, word32 tagSz, const byte* aad,
+    word32 aadSz);
+#endif
+
 #ifdef __cplusplus
     } /* extern "C" */
 #endif
@@ -0,0 +1,789 @@
+/* sm_batch.c
+ *
+ * Copyright (C) 2006-2024 wolfSSL Inc.
+ *
+ * This file is part of wolfSSL.
+ *
+ * wolfSSL is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfSSL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+/* Software device that batches SM4-GCM operations requested by many threads.
+ *
+ * Small operations from many threads are performed together so that the
+ * multi-block kernels have enough data to work on.
+ */
+
+#include <wolfssl/wolfcrypt/libwolfssl_sources.h>
+
+#ifdef WOLFSSL_SM_BATCH_DEV
+
+#include <wolfssl/wolfcrypt/sm_batch.h>
+#ifdef WOLF_CRYPTO_CB
+    #include <wolfssl/wolfcrypt/cryptocb.h>
+#endif
+
+#ifdef SINGLE_THREADED
+    #error "WOLFSSL_SM_BATCH_DEV not supported with SINGLE_THREADED"
+#endif
+#ifndef WOLFSSL_COND
+    #error "WOLFSSL_SM_BATCH_DEV requires condition variable support"
+#endif
+
+#ifdef HAVE_THREAD_LS
+/* Batching device whose thread this is. NULL for other threads. */
+static THREAD_LS_T wc_SmBatchDev* smBatchThreadDev = NULL;
+#endif
+
+/* Perform the SM4-GCM requests of a type in a batch as a burst.
+ *
+ * @param [in, out] dev   Batching device.
+ * @param [in]      cnt   Number of requests in batch.
+ * @param [in]      type  WC_SM_BATCH_SM4_GCM_ENC or WC_SM_BATCH_SM4_GCM_DEC.
+ */
+static void sm_batch_gcm(wc_SmBatchDev* dev, word32 cnt, int type)
+{
+    word32 i;
+    word32 n = 0;
+
+    /* Packets need to be consecutive for a burst. */
+    for (i = 0; i < cnt; i++) {
+        if (dev->reqs[i]->type == type) {
+            dev->pkt[n++] = dev->reqs[i]->gcm;
+        }
+    }
+    if (n > 0) {
+        if (type == WC_SM_BATCH_SM4_GCM_ENC) {
+            (void)wc_Sm4GcmEncryptBurst(dev->pkt, n);
+        }
+        else {
+            (void)wc_Sm4GcmDecryptBurst(dev->pkt, n);
+        }
+
+        /* Result of each packet is result of request. */
+        n = 0;
+        for (i = 0; i < cnt; i++) {
+            if (dev->reqs[i]->type == type) {
+                dev->reqs[i]->ret = dev->pkt[n++].ret;
+            }
+        }
+    }
+}
+
+/* Perform a batch of requests and call their done functions.
+ *
+ * @param [in, out] dev  Batching device.
+ * @param [in]      cnt  Number of requests in batch.
+ */
+static void sm_batch_run(wc_SmBatchDev* dev, word32 cnt)
+{
+    word32 i;
+
+    /* Packets of all requesters encrypted/decrypted together. */
+    sm_batch_gcm(dev, cnt, WC_SM_BATCH_SM4_GCM_ENC);
+    sm_batch_gcm(dev, cnt, WC_SM_BATCH_SM4_GCM_DEC);
+
+    for (i = 0; i < cnt; i++) {
+        /* Request may be reused or freed by done function. */
+        wc_SmBatchReq* req = dev->reqs[i];
+
+        req->done(req, req->ctx);
+    }
+}
+
+/* Perform the requests taken off the queue in batches.
+ *
+ * Only one thread performs batches at a time - busy is set.
+ *
+ * @param [in, out] dev   Batching device.
+ * @param [in]      list  Requests taken off the queue.
+ */
+static void sm_batch_perform(wc_SmBatchDev* dev, wc_SmBatchReq* list)
+{
+    while (list != NULL) {
+        word32 cnt = 0;
+
+        /* Take next batch of requests off list. */
+        while ((list != NULL) && (cnt < WC_SM_BATCH_MAX)) {
+            dev->reqs[cnt++] = list;
+            list = list->next;
+        }
+        sm_batch_run(dev, cnt);
+    }
+}
+
+/* Thread entry point of batching device.
+ *
+ * Takes all queued requests and performs them in batches, when no other
+ * thread is, until the device is stopped, the queue is empty and no thread
+ * is waiting on a request.
+ *
+ * @param [in, out] arg  Batching device.
+ */
+static THREAD_RETURN WOLFSSL_THREAD sm_batch_thread(void* arg)
+{
+    wc_SmBatchDev* dev = (wc_SmBatchDev*)arg;
+    wc_SmBatchReq* list;
+    int stop = 0;
+
+#ifdef HAVE_THREAD_LS
+    /* Requests run by done functions are performed immediately. */
+    smBatchThreadDev = dev;
+#endif
+    while (!stop) {
+        /* Wait for requests to perform or for the device to be done with. */
+        (void)wolfSSL_CondStart(&dev->cond);
+        while (((dev->head == NULL) || dev->busy) &&
+               ((!dev->stop) || (dev->head != NULL) || dev->busy ||
+                (dev->users > 0))) {
+            (void)wolfSSL_CondWait(&dev->cond);
+        }
+        list = dev->head;
+        dev->head = NULL;
+        dev->tail = NULL;
+        stop = (list == NULL);
+        dev->busy = !stop;
+        (void)wolfSSL_CondEnd(&dev->cond);
+
+        if (!stop) {
+            sm_batch_perform(dev, list);
+
+            (void)wolfSSL_CondStart(&dev->cond);
+            dev->busy = 0;
+            (void)wolfSSL_CondEnd(&dev->cond);
+        }
+    }
+
+    WOLFSSL_RETURN_FROM_THREAD(0);
+}
+
+/* Initialize the batching device and start its thread.
+ *
+ * @param [out] dev   Batching device.
+ * @param [in]  heap  Heap hint for dynamic memory allocation.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when dev is NULL.
+ * @return  BAD_MUTEX_E when a condition can't be initialized.
+ * @return  Other negative when the thread can't be started.
+ */
+int wc_SmBatchDevInit(wc_SmBatchDev* dev, void* heap)
+{
+    int ret = 0;
+    int i = 0;
+
+    /* Validate parameters. */
+    if (dev == NULL) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    if (ret == 0) {
+        XMEMSET(dev, 0, sizeof(*dev));
+        dev->devId = INVALID_DEVID;
+        dev->heap = heap;
+        if (wolfSSL_CondInit(&dev->cond) != 0) {
+            ret = BAD_MUTEX_E;
+        }
+    }
+    if (ret == 0) {
+        /* Conditions initialized once rather than for each request. */
+        for (; i < WC_SM_BATCH_WAITS; i++) {
+            if (wolfSSL_CondInit(&dev->wait[i].cond) != 0) {
+                ret = BAD_MUTEX_E;
+                break;
+            }
+            dev->wait[i].next = dev->freeWait;
+            dev->freeWait = &dev->wait[i];
+        }
+        if (ret == 0) {
+            ret = wolfSSL_NewThread(&dev->tid, sm_batch_thread, dev);
+        }
+        if (ret == 0) {
+            dev->started = 1;
+        }
+        else {
+            while (i > 0) {
+                (void)wolfSSL_CondFree(&dev->wait[--i].cond);
+            }
+            (void)wolfSSL_CondFree(&dev->cond);
+        }
+    }
+
+    return ret;
+}
+
+/* Stop the batching device and dispose of it.
+ *
+ * Requests already queued are performed first and threads waiting on
+ * requests are returned to.
+ * Unregisters the device when registered.
+ * Does nothing when the device's thread wasn't started.
+ *
+ * @param [in, out] dev  Batching device.
+ */
+void wc_SmBatchDevFree(wc_SmBatchDev* dev)
+{
+    int i;
+
+    /* Check we have something to work with. */
+    if ((dev != NULL) && dev->started) {
+    #ifdef WOLF_CRYPTO_CB
+        if (dev->devId != INVALID_DEVID) {
+            wc_SmBatchDevUnRegister(dev->devId);
+        }
+    #endif
+        /* Tell thread to stop once queue is empty. */
+        (void)wolfSSL_CondStart(&dev->cond);
+        dev->stop = 1;
+        (void)wolfSSL_CondSignal(&dev->cond);
+        (void)wolfSSL_CondEnd(&dev->cond);
+
+        (void)wolfSSL_JoinThread(dev->tid);
+        dev->started = 0;
+        for (i = 0; i < WC_SM_BATCH_WAITS; i++) {
+            (void)wolfSSL_CondFree(&dev->wait[i].cond);
+        }
+        (void)wolfSSL_CondFree(&dev->cond);
+    }
+}
+
+/* Check the type of operation is one the device performs.
+ *
+ * @param [in] req  Request.
+ * @return  0 when supported.
+ * @return  BAD_FUNC_ARG otherwise.
+ */
+static int sm_batch_check_type(const wc_SmBatchReq* req)
+{
+    int ret = 0;
+
+    if ((req->type != WC_SM_BATCH_SM4_GCM_ENC) &&
+            (req->type != WC_SM_BATCH_SM4_GCM_DEC)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    return ret;
+}
+
+/* Add a request to the end of the queue.
+ *
+ * Device's condition must be held.
+ *
+ * @param [in, out] dev  Batching device.
+ * @param [in, out] req  Request to perform.
+ */
+static void sm_batch_queue(wc_SmBatchDev* dev, wc_SmBatchReq* req)
+{
+    req->ret = 0;
+    req->next = NULL;
+    if (dev->tail == NULL) {
+        dev->head = req;
+    }
+    else {
+        dev->tail->next = req;
+    }
+    dev->tail = req;
+}
+
+/* Queue a request to be performed by the batching device.
+ *
+ * Returns without waiting. The request's done function is called once it
+ * has been performed - the result is in ret.
+ *
+ * @param [in, out] dev  Batching device.
+ * @param [in, out] req  Request to perform. done must be set.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when dev, req or the done function is NULL.
+ * @return  BAD_FUNC_ARG when the type of request is not supported.
+ * @return  BAD_STATE_E when the device is not started or is being freed.
+ */
+int wc_SmBatchDevSubmit(wc_SmBatchDev* dev, wc_SmBatchReq* req)
+{
+    int ret = 0;
+
+    /* Validate parameters. */
+    if ((dev == NULL) || (req == NULL) || (req->done == NULL)) {
+        ret = BAD_FUNC_ARG;
+    }
+    if (ret == 0) {
+        ret = sm_batch_check_type(req);
+    }
+    if ((ret == 0) && (!dev->started)) {
+        ret = BAD_STATE_E;
+    }
+
+    if (ret == 0) {
+        (void)wolfSSL_CondStart(&dev->cond);
+        if (dev->stop) {
+            ret = BAD_STATE_E;
+        }
+        else {
+            sm_batch_queue(dev, req);
+            /* Thread performing a batch takes the queue when done. */
+            if (!dev->busy) {
+                (void)wolfSSL_CondSignal(&dev->cond);
+            }
+        }
+        (void)wolfSSL_CondEnd(&dev->cond);
+    }
+
+    return ret;
+}
+
+#ifdef HAVE_THREAD_LS
+/* Perform a request immediately on this thread.
+ *
+ * @param [in, out] req  Request to perform.
+ * @return  Result of request on success.
+ * @return  BAD_FUNC_ARG when the type of request is not supported.
+ */
+static int sm_batch_now(wc_SmBatchReq* req)
+{
+    if (req->type == WC_SM_BATCH_SM4_GCM_ENC) {
+        (void)wc_Sm4GcmEncryptBurst(&req->gcm, 1);
+        req->ret = req->gcm.ret;
+    }
+    else if (req->type == WC_SM_BATCH_SM4_GCM_DEC) {
+        (void)wc_Sm4GcmDecryptBurst(&req->gcm, 1);
+        req->ret = req->gcm.ret;
+    }
+    else {
+        req->ret = BAD_FUNC_ARG;
+    }
+
+    return req->ret;
+}
+#endif
+
+/* Done function that wakes the thread waiting on the request.
+ *
+ * @param [in] req  Request that is done.
+ * @param [in] ctx  Waiting object.
+ */
+static void sm_batch_wake(wc_SmBatchReq* req, void* ctx)
+{
+    wc_SmBatchWait* wait = (wc_SmBatchWait*)ctx;
+
+    (void)req;
+
+    (void)wolfSSL_CondStart(&wait->cond);
+    wait->done = 1;
+    (void)wolfSSL_CondSignal(&wait->cond);
+    (void)wolfSSL_CondEnd(&wait->cond);
+}
+
+/* Start waiting on requests of the device.
+ *
+ * The device's thread doesn't finish while threads are waiting.
+ *
+ * @param [in, out] dev  Batching device.
+ * @return  0 on success.
+ * @return  BAD_STATE_E when the device is not started or is being freed.
+ */
+static int sm_batch_enter(wc_SmBatchDev* dev)
+{
+    int ret = 0;
+
+    if (!dev->started) {
+        ret = BAD_STATE_E;
+    }
+    if (ret == 0) {
+        (void)wolfSSL_CondStart(&dev->cond);
+        if (dev->stop) {
+            ret = BAD_STATE_E;
+        }
+        else {
+            dev->users++;
+        }
+        (void)wolfSSL_CondEnd(&dev->cond);
+    }
+
+    return ret;
+}
+
+/* Submit a request to the batching device and wait for it to be done.
+ *
+ * When no batch is being performed, this thread takes the queue and
+ * performs it rather than handing it to the device's thread and waiting to
+ * be woken.
+ * Device must have been entered and is left.
+ *
+ * @param [in, out] dev  Batching device.
+ * @param [in, out] req  Request to perform.
+ * @return  Result of request on success.
+ * @return  BAD_MUTEX_E when no waiting object is free and one can't be
+ *          initialized.
+ */
+static int sm_batch_wait(wc_SmBatchDev* dev, wc_SmBatchReq* req)
+{
+    int ret = 0;
+    wc_SmBatchWait own;
+    wc_SmBatchWait* wait;
+    wc_SmBatchReq* list = NULL;
+#ifdef HAVE_THREAD_LS
+    wc_SmBatchDev* prev;
+#endif
+
+    /* Take an object to wait on. */
+    (void)wolfSSL_CondStart(&dev->cond);
+    wait = dev->freeWait;
+    if (wait != NULL) {
+        dev->freeWait = wait->next;
+    }
+    (void)wolfSSL_CondEnd(&dev->cond);
+    if (wait == NULL) {
+        /* All in use - initialize one for this request. */
+        wait = &own;
+        if (wolfSSL_CondInit(&own.cond) != 0) {
+            ret = BAD_MUTEX_E;
+        }
+    }
+
+    if (ret == 0) {
+        wait->done = 0;
+        req->done = sm_batch_wake;
+        req->ctx = wait;
+
+        (void)wolfSSL_CondStart(&dev->cond);
+        sm_batch_queue(dev, req);
+        if (!dev->busy) {
+            /* Perform the queue on this thread. */
+            list = dev->head;
+            dev->head = NULL;
+            dev->tail = NULL;
+            dev->busy = 1;
+        }
+        (void)wolfSSL_CondEnd(&dev->cond);
+
+        if (list != NULL) {
+        #ifdef HAVE_THREAD_LS
+            /* Requests run by done functions are performed immediately. */
+            prev = smBatchThreadDev;
+            smBatchThreadDev = dev;
+        #endif
+            sm_batch_perform(dev, list);
+        #ifdef HAVE_THREAD_LS
+            smBatchThreadDev = prev;
+        #endif
+
+            (void)wolfSSL_CondStart(&dev->cond);
+            dev->busy = 0;
+            /* Requests queued meanwhile are performed by device's thread. */
+            if ((dev->head != NULL) || dev->stop) {
+                (void)wolfSSL_CondSignal(&dev->cond);
+            }
+            (void)wolfSSL_CondEnd(&dev->cond);
+        }
+
+        /* Wait for request to be performed. */
+        (void)wolfSSL_CondStart(&wait->cond);
+        while (!wait->done) {
+            (void)wolfSSL_CondWait(&wait->cond);
+        }
+        (void)wolfSSL_CondEnd(&wait->cond);
+        ret = req->ret;
+    }
+
+    if (wait == &own) {
+        if (ret != BAD_MUTEX_E) {
+            (void)wolfSSL_CondFree(&own.cond);
+        }
+        wait = NULL;
+    }
+
+    /* Leave device - return wait object and let thread finish. */
+    (void)wolfSSL_CondStart(&dev->cond);
+    if (wait != NULL) {
+        wait->next = dev->freeWait;
+        dev->freeWait = wait;
+    }
+    dev->users--;
+    if (dev->stop && (dev->users == 0)) {
+        (void)wolfSSL_CondSignal(&dev->cond);
+    }
+    (void)wolfSSL_CondEnd(&dev->cond);
+
+    return ret;
+}
+
+/* Perform a request with the batching device and wait for it to be done.
+ *
+ * Intended for thread-per-connection applications - the requests of other
+ * threads waiting at the same time are performed in the same batch.
+ * The request's done function and context are replaced.
+ * When called on the thread performing a batch, from a done function, the
+ * request is performed immediately as the batch can't be waited on.
+ * Without thread local storage (HAVE_THREAD_LS) this is not detected and
+ * it must not be called from a done function.
+ *
+ * @param [in, out] dev  Batching device.
+ * @param [in, out] req  Request to perform.
+ * @return  Result of request on success.
+ * @return  BAD_FUNC_ARG when dev or req is NULL.
+ * @return  BAD_FUNC_ARG when the type of request is not supported.
+ * @return  BAD_STATE_E when the device is not started or is being freed.
+ * @return  BAD_MUTEX_E when no waiting object is free and one can't be
+ *          initialized.
+ */
+int wc_SmBatchDevRun(wc_SmBatchDev* dev, wc_SmBatchReq* req)
+{
+    int ret = 0;
+
+    /* Validate parameters. */
+    if ((dev == NULL) || (req == NULL)) {
+        ret = BAD_FUNC_ARG;
+    }
+    if (ret == 0) {
+        ret = sm_batch_check_type(req);
+    }
+
+    if (ret == 0) {
+    #ifdef HAVE_THREAD_LS
+        if (smBatchThreadDev == dev) {
+            /* Thread would wait on itself - perform request now. */
+            ret = sm_batch_now(req);
+        }
+        else
+    #endif
+        {
+            ret = sm_batch_enter(dev);
+            if (ret == 0) {
+                ret = sm_batch_wait(dev, req);
+            }
+        }
+    }
+
+    return ret;
+}
+
+#ifdef WOLF_CRYPTO_CB
+
+/* Batching devices registered against device ids. */
+static wc_SmBatchDev* smBatchDevs[WC_SM_BATCH_DEVS];
+#ifndef WOLFSSL_MUTEX_INITIALIZER
+    static volatile int initSmBatchDevsMutex = 0;
+#endif
+/* Protects the registered batching devices. */
+static wolfSSL_Mutex smBatchDevsLock WOLFSSL_MUTEX_INITIALIZER_CLAUSE(smBatchDevsLock);
+
+/* Lock the registered batching devices.
+ *
+ * @return  0 on success.
+ * @return  BAD_MUTEX_E when the lock can't be taken.
+ */
+static int sm_batch_devs_lock(void)
+{
+    int ret = 0;
+
+#ifndef WOLFSSL_MUTEX_INITIALIZER
+    if (initSmBatchDevsMutex == 0) {
+        if (wc_InitMutex(&smBatchDevsLock) != 0) {
+            ret = BAD_MUTEX_E;
+        }
+        else {
+            initSmBatchDevsMutex = 1;
+        }
+    }
+#endif
+    if ((ret == 0) && (wc_LockMutex(&smBatchDevsLock) != 0)) {
+        ret = BAD_MUTEX_E;
+    }
+
+    return ret;
+}
+
+/* Crypto callback of batching device.
+ *
+ * wolfCrypt has no SM operations to pass to devices (wc_CryptoInfo), so SM4
+ * objects with the device id are dispatched to the batching device by
+ * sm_batch_dev_run(). Registering the callback reserves the device id so no
+ * other device can be registered against it. The operations that wolfCrypt
+ * does pass use software.
+ *
+ * @param [in] devId  Device id.
+ * @param [in] info   Operation to perform.
+ * @param [in] ctx    Batching device.
+ * @return  CRYPTOCB_UNAVAILABLE always.
+ */
+static int sm_batch_crypto_cb(int devId, wc_CryptoInfo* info, void* ctx)
+{
+    (void)devId;
+    (void)info;
+    (void)ctx;
+
+    return CRYPTOCB_UNAVAILABLE;
+}
+
+/* Register the batching device against a device id.
+ *
+ * The device id is registered with wolfSSL like a hardware device. SM4
+ * objects initialized with the device id have their SM4-GCM one-shot
+ * encryptions and decryptions performed by the batching device while it is
+ * registered - the device is looked up on each operation.
+ *
+ * @param [in, out] dev    Batching device.
+ * @param [in]      devId  Device id to register against.
+ * @return  0 on success.
+ * @return  BAD_FUNC_ARG when dev is NULL or devId is INVALID_DEVID.
+ * @return  BAD_STATE_E when the device is not started or is already
+ *          registered.
+ * @return  BUFFER_E when WC_SM_BATCH_DEVS devices are registered.
+ * @return  BAD_MUTEX_E when the registered devices can't be locked.
+ * @return  Other negative when wolfSSL fails to register device.
+ */
+int wc_SmBatchDevRegister(wc_SmBatchDev* dev, int devId)
+{
+    int ret = 0;
+    int i;
+
+    /* Validate parameters. */
+    if ((dev == NULL) || (devId == INVALID_DEVID)) {
+        ret = BAD_FUNC_ARG;
+    }
+
+    if (ret == 0) {
+        ret = sm_batch_devs_lock();
+    }
+    if (ret == 0) {
+        if ((!dev->started) || (dev->devId != INVALID_DEVID)) {
+            ret = BAD_STATE_E;
+        }
+        /* Find a free entry. */
+        for (i = 0; (ret == 0) && (i < WC_SM_BATCH_DEVS); i++) {
+            if (smBatchDevs[i] == NULL) {
+                break;
+            }
+        }
+        if ((ret == 0) && (i == WC_SM_BATCH_DEVS)) {
+            ret = BUFFER_E;
+        }
+        if (ret == 0) {
+            ret = wc_CryptoCb_RegisterDevice(devId, sm_batch_crypto_cb, dev);
+        }
+        if (ret == 0) {
+            dev->devId = devId;
+            smBatchDevs[i] = dev;
+        }
+        wc_UnLockMutex(&smBatchDevsLock);
+    }
+
+    return ret;
+}
+
+/* Unregister the batching device registered against a device id.
+ *
+ * Operations of objects initialized with the device id use software
+ * afterwards.
+ *
+ * @param [in] devId  Device id.
+ */
+void wc_SmBatchDevUnRegister(int devId)
+{
+    int i;
+
+    if (sm_batch_devs_lock() == 0) {
+        for (i = 0; i < WC_SM_BATCH_DEVS; i++) {
+            if ((smBatchDevs[i] != NULL) &&
+                    (smBatchDevs[i]->devId == devId)) {
+                wc_CryptoCb_UnRegisterDevice(devId);
+                smBatchDevs[i]->devId = INVALID_DEVID;
+                smBatchDevs[i] = NULL;
+                break;
+            }
+        }
+        wc_UnLockMutex(&smBatchDevsLock);
+    }
+}
+
+/* Find the batching device registered against a device id.
+ *
+ * Registered devices must be locked.
+ *
+ * @param [in] devId  Device id.
+ * @return  Batching device when registered.
+ * @return  NULL otherwise.
+ */
+static wc_SmBatchDev* sm_batch_dev_find(int devId)
+{
+    wc_SmBatchDev* dev = NULL;
+    int i;
+
+    for (i = 0; i < WC_SM_BATCH_DEVS; i++) {
+        if ((smBatchDevs[i] != NULL) && (smBatchDevs[i]->devId == devId)) {
+            dev = smBatchDevs[i];
+            break;
+        }
+    }
+
+    return dev;
+}
+
+/* Perform a request with the batching device registered against a device id
+ * and wait for it to be done.
+ *
+ * Like a crypto callback, the device is found on each operation and
+ * CRYPTOCB_UNAVAILABLE is returned when there is none so that software is
+ * used.
+ *
+ * @param [in]      devId  Device id.
+ * @param [in, out] req    Request to perform.
+ * @return  Result of request on success.
+ * @return  CRYPTOCB_UNAVAILABLE when no batching device is registered against
+ *          the device id.
+ * @return  BAD_MUTEX_E when the registered devices can't be locked.
+ * @return  BAD_MUTEX_E when no waiting object is free and one can't be
+ *          initialized.
+ */
+int sm_batch_dev_run(int devId, wc_SmBatchReq* req)
+{
+    int ret;
+    wc_SmBatchDev* dev = NULL;
+
+    ret = sm_batch_devs_lock();
+    if (ret == 0) {
+        dev = sm_batch_dev_find(devId);
+        if (dev == NULL) {
+            ret = CRYPTOCB_UNAVAILABLE;
+        }
+    #ifdef HAVE_THREAD_LS
+        else if (smBatchThreadDev == dev) {
+            /* Performed below without waiting. */
+        }
+    #endif
+        else if (sm_batch_enter(dev) != 0) {
+            /* Being freed - use software. */
+            ret = CRYPTOCB_UNAVAILABLE;
+        }
+        /* Device can't be freed once entered. */
+        wc_UnLockMutex(&smBatchDevsLock);
+    }
+
+    if (ret == 0) {
+    #ifdef HAVE_THREAD_LS
+        if (smBatchThreadDev == dev) {
+            /* Thread would wait on itself - perform request now. */
+            ret = sm_batch_now(req);
+        }
+        else
+    #endif
+        {
+            ret = sm_batch_wait(dev, req);
+        }
+    }
+
+    return ret;
+}
+
+#endif /* WOLF_CRYPTO_CB */
+
+#endif /* WOLFSSL_SM_BATCH_DEV */
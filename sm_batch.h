@@ -0,0 +1,157 @@
+/* sm_batch.h
+ *
+ * Copyright (C) 2006-2024 wolfSSL Inc.
+ *
+ * This file is part of wolfSSL.
+ *
+ * wolfSSL is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfSSL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+#ifndef WOLF_CRYPT_SM_BATCH_H
+#define WOLF_CRYPT_SM_BATCH_H
+
+#include <wolfssl/wolfcrypt/types.h>
+
+#ifdef WOLFSSL_SM_BATCH_DEV
+
+#include <wolfssl/wolfcrypt/sm4.h>
+
+#if !defined(WOLFSSL_SM4) || !defined(WOLFSSL_SM4_GCM)
+    #error "WOLFSSL_SM_BATCH_DEV requires WOLFSSL_SM4 and WOLFSSL_SM4_GCM"
+#endif
+
+#ifndef WC_SM_BATCH_MAX
+    /* Maximum number of requests taken off the queue and processed
+     * together. */
+    #define WC_SM_BATCH_MAX     64
+#endif
+#ifndef WC_SM_BATCH_DEVS
+    /* Maximum number of batching devices registered against device ids. */
+    #define WC_SM_BATCH_DEVS    4
+#endif
+#ifndef WC_SM_BATCH_WAITS
+    /* Number of objects kept by a device for threads to wait on requests.
+     * A thread initializes its own when all are in use. */
+    #define WC_SM_BATCH_WAITS   WC_SM_BATCH_MAX
+#endif
+
+/* Types of operation a batching device performs. */
+enum {
+    /* SM4-GCM encrypt of a packet. */
+    WC_SM_BATCH_SM4_GCM_ENC = 1,
+    /* SM4-GCM decrypt of a packet. */
+    WC_SM_BATCH_SM4_GCM_DEC = 2,
+};
+
+typedef struct wc_SmBatchReq wc_SmBatchReq;
+
+/* Called on the thread performing the batch when a request has been
+ * performed - the device's thread or a thread waiting in wc_SmBatchDevRun().
+ *
+ * May submit more requests to the device. Requests run on the device from
+ * here are performed immediately when HAVE_THREAD_LS is defined - otherwise
+ * running a request deadlocks.
+ */
+typedef void (*wc_SmBatchDoneCb)(wc_SmBatchReq* req, void* ctx);
+
+/* Request to perform an operation on a batching device.
+ *
+ * Data referenced by the request must not be changed or freed until it is
+ * done.
+ */
+struct wc_SmBatchReq {
+    /* Type of operation - WC_SM_BATCH_*. */
+    int type;
+    /* SM4-GCM packet to encrypt or decrypt. */
+    wc_Sm4GcmPacket gcm;
+    /* Function to call when done and its context. */
+    wc_SmBatchDoneCb done;
+    void* ctx;
+    /* Result of operation. */
+    int ret;
+    /* Next request in queue. Internal. */
+    wc_SmBatchReq* next;
+};
+
+/* Object a thread waits on until its request is done. Internal. */
+typedef struct wc_SmBatchWait {
+    /* Signalled when done. */
+    COND_TYPE cond;
+    /* Set when done. */
+    int done;
+    /* Next object not in use. */
+    struct wc_SmBatchWait* next;
+} wc_SmBatchWait;
+
+/* Software device that performs the SM4-GCM requests of many threads in
+ * batches.
+ *
+ * Requests are queued and performed on the device's thread, or by a thread
+ * in wc_SmBatchDevRun() when no batch is being performed. All requests
+ * queued while a batch is performed make up the next batch.
+ *
+ * There are no multi-buffer SM3 or batched SM2 verify implementations to
+ * feed, so SM3 and SM2 operations are not performed by the device.
+ */
+typedef struct wc_SmBatchDev {
+    /* Protects the queue and wakes the device's thread. */
+    COND_TYPE cond;
+    /* Queue of requests to perform. */
+    wc_SmBatchReq* head;
+    wc_SmBatchReq* tail;
+    /* Requests of batch being performed. */
+    wc_SmBatchReq* reqs[WC_SM_BATCH_MAX];
+    /* Packets of SM4-GCM requests in batch. */
+    wc_Sm4GcmPacket pkt[WC_SM_BATCH_MAX];
+    /* Objects for threads to wait on and list of those not in use. */
+    wc_SmBatchWait wait[WC_SM_BATCH_WAITS];
+    wc_SmBatchWait* freeWait;
+    /* Number of threads in wc_SmBatchDevRun(). */
+    int users;
+    /* Thread performing requests. */
+    THREAD_TYPE tid;
+    /* Device id registered against. INVALID_DEVID when not registered. */
+    int devId;
+    /* Set when the device's thread has been started. */
+    byte started;
+    /* Set while a thread is performing a batch. */
+    byte busy;
+    /* Set when the device is being freed. */
+    byte stop;
+    void* heap; /* memory hint to use */
+} wc_SmBatchDev;
+
+#ifdef __cplusplus
+    extern "C" {
+#endif
+
+WOLFSSL_API int wc_SmBatchDevInit(wc_SmBatchDev* dev, void* heap);
+WOLFSSL_API void wc_SmBatchDevFree(wc_SmBatchDev* dev);
+WOLFSSL_API int wc_SmBatchDevSubmit(wc_SmBatchDev* dev, wc_SmBatchReq* req);
+WOLFSSL_API int wc_SmBatchDevRun(wc_SmBatchDev* dev, wc_SmBatchReq* req);
+#ifdef WOLF_CRYPTO_CB
+WOLFSSL_API int wc_SmBatchDevRegister(wc_SmBatchDev* dev, int devId);
+WOLFSSL_API void wc_SmBatchDevUnRegister(int devId);
+
+WOLFSSL_LOCAL int sm_batch_dev_run(int devId, wc_SmBatchReq* req);
+#endif
+
+#ifdef __cplusplus
+    }    /* extern "C" */
+#endif
+
+#endif /* WOLFSSL_SM_BATCH_DEV */
+
+#endif /* WOLF_CRYPT_SM_BATCH_H */
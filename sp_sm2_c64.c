@@ -719,6 +719,24 @@ SP_NOINLINE static void sp_256_mul_add_sm2_5(sp_digit* r, const sp_digit* a,
 #endif /* WOLFSSL_SP_SMALL */
 }
 
+#ifdef WOLFSSL_SP_SMALL
+/* Mul the modulus (prime) by scalar b and add into r. (r += m * b)
+ * Uses the special form of the modulus: 2^256 - 2^224 - 2^96 + 2^64 - 1
+ * Words of the result may be negative.
+ *
+ * r  A single precision integer.
+ * b  A scalar less than 2^52.
+ */
+static void sp_256_mul_add_p_sm2_5(sp_digit* r, const sp_digit b)
+{
+    r[ 0] -= b;
+    r[ 1] += ((b & 0xffffffffffL) << 12) - ((b & 0xffL) << 44);
+    r[ 2] += (b >> 40) - (b >> 8);
+    r[ 4] -= ((b & 0xfffffffffL) << 16) - ((b & 0xfL) << 48);
+    r[ 5] -= (b >> 36) - (b >> 4);
+}
+#endif /* WOLFSSL_SP_SMALL */
+
 /* Normalize the values in each word to 52 bits.
  *
  * a  Array of sp_digit to normalize.
@@ -794,15 +812,60 @@ static void sp_256_mont_reduce_sm2_5(sp_digit* a, const sp_digit* m, sp_digit mp
         a[i] &= 0xfffffffffffffL;
     }
     else {
+#ifdef WOLFSSL_SP_SMALL
         for (i=0; i<4; i++) {
             mu = a[i] & 0xfffffffffffffL;
-            sp_256_mul_add_sm2_5(a+i, p256_sm2_mod, mu);
+            sp_256_mul_add_p_sm2_5(a+i, mu);
             a[i+1] += a[i] >> 52;
         }
         mu = a[i] & 0xffffffffffffL;
-        sp_256_mul_add_sm2_5(a+i, p256_sm2_mod, mu);
+        sp_256_mul_add_p_sm2_5(a+i, mu);
         a[i+1] += a[i] >> 52;
         a[i] &= 0xfffffffffffffL;
+        /* Top words may be negative - normalize before shifting down. */
+        for (i++; i<9; i++) {
+            a[i+1] += a[i] >> 52;
+            a[i] &= 0xfffffffffffffL;
+        }
+#else
+        /* Low words are shifted out - only subtract mu from top. */
+        mu = a[ 0] & 0xfffffffffffffL;
+        a[ 1] += ((mu & 0xffffffffffL) << 12) - ((mu & 0xffL) << 44);
+        a[ 2] += (mu >> 40) - (mu >> 8);
+        a[ 4] -= ((mu & 0xfffffffffL) << 16) - ((mu & 0xfL) << 48);
+        a[ 5] -= (mu >> 36) - (mu >> 4);
+        a[ 1] += a[ 0] >> 52;
+        mu = a[ 1] & 0xfffffffffffffL;
+        a[ 2] += ((mu & 0xffffffffffL) << 12) - ((mu & 0xffL) << 44);
+        a[ 3] += (mu >> 40) - (mu >> 8);
+        a[ 5] -= ((mu & 0xfffffffffL) << 16) - ((mu & 0xfL) << 48);
+        a[ 6] -= (mu >> 36) - (mu >> 4);
+        a[ 2] += a[ 1] >> 52;
+        mu = a[ 2] & 0xfffffffffffffL;
+        a[ 3] += ((mu & 0xffffffffffL) << 12) - ((mu & 0xffL) << 44);
+        a[ 4] += (mu >> 40) - (mu >> 8);
+        a[ 6] -= ((mu & 0xfffffffffL) << 16) - ((mu & 0xfL) << 48);
+        a[ 7] -= (mu >> 36) - (mu >> 4);
+        a[ 3] += a[ 2] >> 52;
+        mu = a[ 3] & 0xfffffffffffffL;
+        a[ 4] += ((mu & 0xffffffffffL) << 12) - ((mu & 0xffL) << 44);
+        a[ 5] += (mu >> 40) - (mu >> 8);
+        a[ 7] -= ((mu & 0xfffffffffL) << 16) - ((mu & 0xfL) << 48);
+        a[ 8] -= (mu >> 36) - (mu >> 4);
+        a[ 4] += a[ 3] >> 52;
+        mu = a[ 4] & 0xffffffffffffL;
+        a[ 5] += ((mu & 0xffffffffffL) << 12) - ((mu & 0xffL) << 44);
+        a[ 6] += (mu >> 40) - (mu >> 8);
+        a[ 8] -= ((mu & 0xfffffffffL) << 16) - ((mu & 0xfL) << 48);
+        a[ 9] -= (mu >> 36) - (mu >> 4);
+        a[ 4] -= mu;
+        a[ 5] += a[ 4] >> 52;
+        a[ 4] &= 0xfffffffffffffL;
+        a[ 6] += a[ 5] >> 52; a[ 5] &= 0xfffffffffffffL;
+        a[ 7] += a[ 6] >> 52; a[ 6] &= 0xfffffffffffffL;
+        a[ 8] += a[ 7] >> 52; a[ 7] &= 0xfffffffffffffL;
+        a[ 9] += a[ 8] >> 52; a[ 8] &= 0xfffffffffffffL;
+#endif /* WOLFSSL_SP_SMALL */
     }
 
     sp_256_mont_shift_5(a, a);
@@ -3396,6 +3459,160 @@ int sp_ecc_mulmod_add_sm2_256(const mp_int* km, const ecc_point* gm,
     return err;
 }
 
+/* Multiply the point by a public scalar of at most 128 bits and add a point.
+ * Not constant time - only use with public scalars and points.
+ *
+ * r    Resulting point in Montgomery form. Must not be the same as a.
+ * t    Table of 16 points. Entry 1 is the point to multiply in Montgomery
+ *      form.
+ * k    Scalar to multiply by.
+ * a    Point to add in Montgomery form.
+ * tmp  Temporary ordinate data.
+ */
+static void sp_256_ecc_mulmod_add_half_vt_sm2_5(sp_point_256* r,
+    sp_point_256* t, const sp_digit* k, const sp_point_256* a,
+    sp_digit* tmp)
+{
+    int i;
+    int j;
+    int y;
+
+    /* t[0] = infinity, t[2..15] = 2..15 times point */
+    XMEMSET(&t[0], 0, sizeof(t[0]));
+    t[0].infinity = 1;
+    for (i = 2; i < 16; i += 2) {
+        sp_256_proj_point_dbl_sm2_5(&t[i], &t[i / 2], tmp);
+        sp_256_proj_point_add_sm2_5(&t[i + 1], &t[i], &t[1], tmp);
+    }
+
+    XMEMCPY(r, &t[0], sizeof(sp_point_256));
+    for (i = 124; i >= 0; i -= 4) {
+        y = 0;
+        for (j = 3; j >= 0; j--) {
+            y = (y << 1) | (int)((k[(i + j) / 52] >> ((i + j) % 52)) & 1);
+        }
+        for (j = 0; (j < 4) && (!r->infinity); j++) {
+            sp_256_proj_point_dbl_sm2_5(r, r, tmp);
+        }
+        if (y != 0) {
+            sp_256_proj_point_add_sm2_5(r, r, &t[y], tmp);
+        }
+    }
+    sp_256_proj_point_add_sm2_5(r, r, a, tmp);
+}
+
+/* Calculate the SM2 key exchange point: U = t.(P + x.R)
+ * x is public and at most 128 bits. t is secret.
+ * Result is in affine coordinates.
+ *
+ * Q = P + x.R is calculated in variable time. P is the peer's static public
+ * key, R the peer's ephemeral public key and x is taken from the x ordinate of
+ * R. All are sent in the clear, so the timing reveals only what an
+ * eavesdropper can calculate for themselves. The secret t is only used in the
+ * constant time multiplication of Q.
+ *
+ * tm    Secret scalar t.
+ * xm    Public scalar x.
+ * pm    Peer's public key point P.
+ * rm    Peer's ephemeral point R.
+ * r     Resulting point U.
+ * heap  Heap to use for allocation.
+ * returns MEMORY_E when memory allocation fails, ECC_INF_E when P + x.R is the
+ * point at infinity, MP_VAL when x is too big and MP_OKAY on success.
+ */
+int sp_ecc_mulmod_kap_sm2_256(const mp_int* tm, const mp_int* xm,
+    const ecc_point* pm, const ecc_point* rm, ecc_point* r, void* heap)
+{
+#ifdef WOLFSSL_SP_SMALL_STACK
+    sp_point_256* t = NULL;
+    sp_digit* k = NULL;
+#else
+    sp_point_256 t[16 + 2];
+    sp_digit k[2 * 5 + 2 * 5 * 6];
+#endif
+    sp_point_256* q = NULL;
+    sp_point_256* u = NULL;
+    sp_digit* x = NULL;
+    sp_digit* tmp = NULL;
+    int err = MP_OKAY;
+
+    if (mp_count_bits(xm) > 128) {
+        err = MP_VAL;
+    }
+
+#ifdef WOLFSSL_SP_SMALL_STACK
+    if (err == MP_OKAY) {
+        t = (sp_point_256*)XMALLOC(sizeof(sp_point_256) * (16 + 2),
+            heap, DYNAMIC_TYPE_ECC);
+        if (t == NULL)
+            err = MEMORY_E;
+    }
+    if (err == MP_OKAY) {
+        k = (sp_digit*)XMALLOC(sizeof(sp_digit) *
+            (2 * 5 + 2 * 5 * 6), heap, DYNAMIC_TYPE_ECC);
+        if (k == NULL)
+            err = MEMORY_E;
+    }
+#endif
+
+    if (err == MP_OKAY) {
+        q = t + 16;
+        u = t + 17;
+        x = k + 5;
+        tmp = k + 2 * 5;
+
+        sp_256_from_mp(k, 5, tm);
+        sp_256_from_mp(x, 5, xm);
+        sp_256_point_from_ecc_point_5(&t[1], rm);
+        sp_256_point_from_ecc_point_5(q, pm);
+        err = sp_256_mod_mul_norm_sm2_5(t[1].x, t[1].x, p256_sm2_mod);
+    }
+    if (err == MP_OKAY) {
+        err = sp_256_mod_mul_norm_sm2_5(t[1].y, t[1].y, p256_sm2_mod);
+    }
+    if (err == MP_OKAY) {
+        err = sp_256_mod_mul_norm_sm2_5(t[1].z, t[1].z, p256_sm2_mod);
+    }
+    if (err == MP_OKAY) {
+        err = sp_256_mod_mul_norm_sm2_5(q->x, q->x, p256_sm2_mod);
+    }
+    if (err == MP_OKAY) {
+        err = sp_256_mod_mul_norm_sm2_5(q->y, q->y, p256_sm2_mod);
+    }
+    if (err == MP_OKAY) {
+        err = sp_256_mod_mul_norm_sm2_5(q->z, q->z, p256_sm2_mod);
+    }
+    if (err == MP_OKAY) {
+        /* Q = P + x.R - public values. U = t.Q - constant time. */
+        sp_256_ecc_mulmod_add_half_vt_sm2_5(u, t, x, q, tmp);
+        if (sp_256_iszero_5(u->z)) {
+            err = ECC_INF_E;
+        }
+        else {
+            sp_256_map_sm2_5(u, u, tmp);
+            err = sp_256_ecc_mulmod_sm2_5(u, u, k, 1, 1, heap);
+        }
+    }
+    if (err == MP_OKAY) {
+        err = sp_256_point_to_ecc_point_5(u, r);
+    }
+
+#ifdef WOLFSSL_SP_SMALL_STACK
+    if (k != NULL)
+#endif
+    {
+        ForceZero(k, sizeof(sp_digit) * 5);
+    #ifdef WOLFSSL_SP_SMALL_STACK
+        XFREE(k, heap, DYNAMIC_TYPE_ECC);
+    #endif
+    }
+#ifdef WOLFSSL_SP_SMALL_STACK
+    XFREE(t, heap, DYNAMIC_TYPE_ECC);
+#endif
+
+    return err;
+}
+
 #ifdef WOLFSSL_SP_SMALL
 /* Multiply the base point of P256 by the scalar and return the result.
  * If map is true then convert result to affine coordinates.
@@ -5025,6 +5242,231 @@ int sp_ecc_make_key_sm2_256(WC_RNG* rng, mp_int* priv, ecc_point* pub, void* hea
     return err;
 }
 
+/* Map the Montgomery form projective coordinate point to an affine point
+ * using the already calculated inverse of z.
+ *
+ * r   Montgomery form projective coordinate point to map.
+ * zi  Inverse of z ordinate of point in Montgomery form.
+ * t   Temporary ordinate data.
+ */
+static void sp_256_map_inv_sm2_5(sp_point_256* r, const sp_digit* zi,
+    sp_digit* t)
+{
+    sp_digit* t1 = t;
+    sp_digit* t2 = t + 2*5;
+    sp_int64 n;
+
+    sp_256_mont_sqr_sm2_5(t2, zi, p256_sm2_mod, p256_sm2_mp_mod);
+    sp_256_mont_mul_sm2_5(t1, t2, zi, p256_sm2_mod, p256_sm2_mp_mod);
+
+    /* x /= z^2 */
+    sp_256_mont_mul_sm2_5(r->x, r->x, t2, p256_sm2_mod, p256_sm2_mp_mod);
+    XMEMSET(r->x + 5, 0, sizeof(sp_digit) * 5U);
+    sp_256_mont_reduce_sm2_5(r->x, p256_sm2_mod, p256_sm2_mp_mod);
+    /* Reduce x to less than modulus */
+    n = sp_256_cmp_sm2_5(r->x, p256_sm2_mod);
+    sp_256_cond_sub_sm2_5(r->x, r->x, p256_sm2_mod, (sp_digit)~(n >> 51));
+    sp_256_norm_5(r->x);
+
+    /* y /= z^3 */
+    sp_256_mont_mul_sm2_5(r->y, r->y, t1, p256_sm2_mod, p256_sm2_mp_mod);
+    XMEMSET(r->y + 5, 0, sizeof(sp_digit) * 5U);
+    sp_256_mont_reduce_sm2_5(r->y, p256_sm2_mod, p256_sm2_mp_mod);
+    /* Reduce y to less than modulus */
+    n = sp_256_cmp_sm2_5(r->y, p256_sm2_mod);
+    sp_256_cond_sub_sm2_5(r->y, r->y, p256_sm2_mod, (sp_digit)~(n >> 51));
+    sp_256_norm_5(r->y);
+
+    XMEMSET(r->z, 0, sizeof(r->z) / 2);
+    r->z[0] = 1;
+}
+
+/* Generates a number of scalars that are in the range 1..order-1.
+ * Scalars are generated from one block of random data. Rejected values are
+ * replaced with newly generated scalars.
+ *
+ * rng  Random number generator.
+ * k    Scalar values.
+ * n    Number of scalars to generate.
+ * buf  Buffer to hold random data. n * 32 bytes in size.
+ * returns RNG failures and MP_OKAY on success.
+ */
+static int sp_256_ecc_gen_k_batch_sm2_5(WC_RNG* rng, sp_digit* k, int n,
+    byte* buf)
+{
+#ifndef WC_NO_RNG
+    int err;
+    int j;
+
+    err = wc_RNG_GenerateBlock(rng, buf, (word32)n * 32);
+    for (j = 0; (err == 0) && (j < n); j++) {
+        sp_256_from_bin(k + j * 5, 5, buf + j * 32,
+            32);
+        if (sp_256_cmp_sm2_5(k + j * 5, p256_sm2_order2) <= 0) {
+            sp_256_add_one_sm2_5(k + j * 5);
+        }
+        else {
+            err = sp_256_ecc_gen_k_sm2_5(rng, k + j * 5);
+        }
+    }
+    ForceZero(buf, (word32)n * 32);
+
+    return err;
+#else
+    (void)rng;
+    (void)k;
+    (void)n;
+    (void)buf;
+    return NOT_COMPILED_IN;
+#endif
+}
+
+#ifndef SP_256_SM2_KEY_BATCH
+/* Number of keys to generate at one time. */
+#define SP_256_SM2_KEY_BATCH     8
+#endif
+
+/* Makes a number of random EC key pairs.
+ *
+ * Public points are converted to affine together using Montgomery's trick -
+ * one field inversion for each batch of SP_256_SM2_KEY_BATCH keys.
+ *
+ * rng   Random number generator.
+ * cnt   Number of key pairs to make.
+ * priv  Array of generated private values.
+ * pub   Array of generated public points.
+ * heap  Heap to use for allocation.
+ * returns ECC_INF_E when the point does not have the correct order, RNG
+ * failures, MEMORY_E when memory allocation fails and MP_OKAY on success.
+ */
+int sp_ecc_make_key_batch_sm2_256(WC_RNG* rng, word32 cnt, mp_int** priv,
+    ecc_point** pub, void* heap)
+{
+#ifdef WOLFSSL_SP_SMALL_STACK
+    sp_point_256* point = NULL;
+    sp_digit* k = NULL;
+#else
+    #ifdef WOLFSSL_VALIDATE_ECC_KEYGEN
+    sp_point_256 point[SP_256_SM2_KEY_BATCH + 1];
+    #else
+    sp_point_256 point[SP_256_SM2_KEY_BATCH];
+    #endif
+    sp_digit k[5 * SP_256_SM2_KEY_BATCH +
+               2 * 5 * (SP_256_SM2_KEY_BATCH + 7)];
+#endif
+#ifdef WOLFSSL_VALIDATE_ECC_KEYGEN
+    sp_point_256* infinity = NULL;
+#endif
+    sp_digit* acc = NULL;
+    sp_digit* inv = NULL;
+    sp_digit* zi = NULL;
+    sp_digit* t = NULL;
+    word32 i;
+    int n = 0;
+    int j;
+    int err = MP_OKAY;
+
+    (void)heap;
+
+#ifdef WOLFSSL_SP_SMALL_STACK
+    #ifdef WOLFSSL_VALIDATE_ECC_KEYGEN
+    point = (sp_point_256*)XMALLOC(sizeof(sp_point_256) *
+        (SP_256_SM2_KEY_BATCH + 1), heap, DYNAMIC_TYPE_ECC);
+    #else
+    point = (sp_point_256*)XMALLOC(sizeof(sp_point_256) *
+        SP_256_SM2_KEY_BATCH, heap, DYNAMIC_TYPE_ECC);
+    #endif
+    if (point == NULL)
+        err = MEMORY_E;
+    if (err == MP_OKAY) {
+        k = (sp_digit*)XMALLOC(sizeof(sp_digit) *
+            (5 * SP_256_SM2_KEY_BATCH +
+             2 * 5 * (SP_256_SM2_KEY_BATCH + 7)), heap,
+            DYNAMIC_TYPE_ECC);
+        if (k == NULL)
+            err = MEMORY_E;
+    }
+#endif
+
+    if (err == MP_OKAY) {
+    #ifdef WOLFSSL_VALIDATE_ECC_KEYGEN
+        infinity = point + SP_256_SM2_KEY_BATCH;
+    #endif
+        /* Products of z ordinates - random data is generated in here. */
+        acc = k + 5 * SP_256_SM2_KEY_BATCH;
+        inv = acc + 2 * 5 * SP_256_SM2_KEY_BATCH;
+        zi = inv + 2 * 5;
+        t = zi + 2 * 5;
+    }
+
+    for (i = 0; (err == MP_OKAY) && (i < cnt); i += (word32)n) {
+        n = ((cnt - i) < SP_256_SM2_KEY_BATCH) ? (int)(cnt - i) :
+                                                 SP_256_SM2_KEY_BATCH;
+
+        err = sp_256_ecc_gen_k_batch_sm2_5(rng, k, n, (byte*)acc);
+        for (j = 0; (err == MP_OKAY) && (j < n); j++) {
+            err = sp_256_ecc_mulmod_base_sm2_5(point + j, k + j * 5,
+                0, 1, heap);
+        }
+        if (err == MP_OKAY) {
+            /* acc[j] = z[0] * ... * z[j] */
+            XMEMCPY(acc, point[0].z, sizeof(sp_digit) * 5);
+            for (j = 1; j < n; j++) {
+                sp_256_mont_mul_sm2_5(acc + j * 2 * 5,
+                    acc + (j - 1) * 2 * 5, point[j].z,
+                    p256_sm2_mod, p256_sm2_mp_mod);
+            }
+            /* inv = 1 / (z[0] * ... * z[n-1]) */
+            sp_256_mont_inv_sm2_5(inv, acc + (n - 1) * 2 * 5, t);
+            for (j = n - 1; j > 0; j--) {
+                /* zi = 1 / z[j] */
+                sp_256_mont_mul_sm2_5(zi, inv, acc + (j - 1) * 2 * 5,
+                    p256_sm2_mod, p256_sm2_mp_mod);
+                /* inv = 1 / (z[0] * ... * z[j-1]) */
+                sp_256_mont_mul_sm2_5(inv, inv, point[j].z,
+                    p256_sm2_mod, p256_sm2_mp_mod);
+                sp_256_map_inv_sm2_5(point + j, zi, t);
+            }
+            sp_256_map_inv_sm2_5(point, inv, t);
+        }
+
+#ifdef WOLFSSL_VALIDATE_ECC_KEYGEN
+        for (j = 0; (err == MP_OKAY) && (j < n); j++) {
+            err = sp_256_ecc_mulmod_sm2_5(infinity, point + j,
+                p256_sm2_order, 1, 1, heap);
+            if ((err == MP_OKAY) && (sp_256_iszero_5(point[j].x) ||
+                    sp_256_iszero_5(point[j].y))) {
+                err = ECC_INF_E;
+            }
+        }
+#endif
+
+        for (j = 0; (err == MP_OKAY) && (j < n); j++) {
+            err = sp_256_to_mp(k + j * 5, priv[i + (word32)j]);
+            if (err == MP_OKAY) {
+                err = sp_256_point_to_ecc_point_5(point + j,
+                    pub[i + (word32)j]);
+            }
+        }
+    }
+
+#ifdef WOLFSSL_SP_SMALL_STACK
+    if (k != NULL)
+#endif
+    {
+        ForceZero(k, sizeof(sp_digit) * 5 * SP_256_SM2_KEY_BATCH);
+    #ifdef WOLFSSL_SP_SMALL_STACK
+        XFREE(k, heap, DYNAMIC_TYPE_ECC);
+    #endif
+    }
+#ifdef WOLFSSL_SP_SMALL_STACK
+    /* point is not sensitive, so no need to zeroize */
+    XFREE(point, heap, DYNAMIC_TYPE_ECC);
+#endif
+
+    return err;
+}
+
 #ifdef WOLFSSL_SP_NONBLOCK
 typedef struct sp_ecc_key_gen_256_ctx {
     int state;
@@ -5148,6 +5590,366 @@ static void sp_256_to_bin_5(sp_digit* r, byte* a)
     }
 }
 
+#if defined(WOLFSSL_SP_SMALL) || defined(WOLFSSL_SP_SM2_COZ_LADDER)
+/* The order of the curve P256 as big-endian bytes. */
+static const byte p256_sm2_order_bin[32] = {
+    0xff, 0xff, 0xff, 0xfe, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0x72, 0x03, 0xdf, 0x6b, 0x21, 0xc6, 0x05, 0x2b,
+    0x53, 0xbb, 0xf4, 0x09, 0x39, 0xd5, 0x41, 0x23
+};
+
+/* Conditionally swap two numbers in constant time.
+ *
+ * a  First number.
+ * b  Second number.
+ * m  Mask value to apply: all ones to swap, zero to leave unchanged.
+ */
+static void sp_256_cond_swap_sm2_5(sp_digit* a, sp_digit* b, sp_digit m)
+{
+    sp_digit t;
+    int i;
+
+    for (i = 0; i < 5; i++) {
+        t = (a[i] ^ b[i]) & m;
+        a[i] ^= t;
+        b[i] ^= t;
+    }
+}
+
+/* Co-Z addition with update: P2 = P1 + P2 and P1 is updated to have the same
+ * Z ordinate as the result. Points have the same, implicit, Z ordinate.
+ * All ordinates are in Montgomery form.
+ *
+ * x1  X ordinate of P1.
+ * y1  Y ordinate of P1.
+ * x2  X ordinate of P2.
+ * y2  Y ordinate of P2.
+ * t   Temporary ordinate data.
+ */
+static void sp_256_proj_point_add_coz_sm2_5(sp_digit* x1,
+    sp_digit* y1, sp_digit* x2, sp_digit* y2, sp_digit* t)
+{
+    sp_digit* t1 = t;
+    sp_digit* t2 = t + 2*5;
+    sp_digit* t3 = t + 4*5;
+
+    /* C = (X1 - X2)^2 */
+    sp_256_mont_sub_sm2_5(t1, x1, x2, p256_sm2_mod);
+    sp_256_mont_sqr_sm2_5(t1, t1, p256_sm2_mod, p256_sm2_mp_mod);
+    /* W2 = X2 * C, W1 = X1 * C */
+    sp_256_mont_mul_sm2_5(t2, x2, t1, p256_sm2_mod, p256_sm2_mp_mod);
+    sp_256_mont_mul_sm2_5(x1, x1, t1, p256_sm2_mod, p256_sm2_mp_mod);
+    /* D = (Y1 - Y2)^2 */
+    sp_256_mont_sub_sm2_5(t1, y1, y2, p256_sm2_mod);
+    sp_256_mont_sqr_sm2_5(t3, t1, p256_sm2_mod, p256_sm2_mp_mod);
+    /* X2 = D - W1 - W2 */
+    sp_256_mont_sub_sm2_5(x2, t3, x1, p256_sm2_mod);
+    sp_256_mont_sub_sm2_5(x2, x2, t2, p256_sm2_mod);
+    /* Y1 = Y1 * (W1 - W2) */
+    sp_256_mont_sub_sm2_5(t2, x1, t2, p256_sm2_mod);
+    sp_256_mont_mul_sm2_5(y1, y1, t2, p256_sm2_mod, p256_sm2_mp_mod);
+    /* Y2 = (Y1 - Y2) * (W1 - X2) - Y1 */
+    sp_256_mont_sub_sm2_5(t2, x1, x2, p256_sm2_mod);
+    sp_256_mont_mul_sm2_5(t1, t1, t2, p256_sm2_mod, p256_sm2_mp_mod);
+    sp_256_mont_sub_sm2_5(y2, t1, y1, p256_sm2_mod);
+}
+
+/* Co-Z conjugate addition: P2 = P1 + P2 and P1 = P1 - P2.
+ * Points have the same, implicit, Z ordinate as do the results.
+ * All ordinates are in Montgomery form.
+ *
+ * x1  X ordinate of P1.
+ * y1  Y ordinate of P1.
+ * x2  X ordinate of P2.
+ * y2  Y ordinate of P2.
+ * t   Temporary ordinate data.
+ */
+static void sp_256_proj_point_add_conj_coz_sm2_5(sp_digit* x1,
+    sp_digit* y1, sp_digit* x2, sp_digit* y2, sp_digit* t)
+{
+    sp_digit* t1 = t;
+    sp_digit* t2 = t + 2*5;
+    sp_digit* t3 = t + 4*5;
+    sp_digit* t4 = t + 6*5;
+    sp_digit* t5 = t + 8*5;
+
+    /* C = (X1 - X2)^2 */
+    sp_256_mont_sub_sm2_5(t1, x1, x2, p256_sm2_mod);
+    sp_256_mont_sqr_sm2_5(t1, t1, p256_sm2_mod, p256_sm2_mp_mod);
+    /* W2 = X2 * C, W1 = X1 * C */
+    sp_256_mont_mul_sm2_5(t2, x2, t1, p256_sm2_mod, p256_sm2_mp_mod);
+    sp_256_mont_mul_sm2_5(t3, x1, t1, p256_sm2_mod, p256_sm2_mp_mod);
+    /* X2 = (Y1 - Y2)^2 - W1 - W2 */
+    sp_256_mont_sub_sm2_5(t4, y1, y2, p256_sm2_mod);
+    sp_256_mont_sqr_sm2_5(t5, t4, p256_sm2_mod, p256_sm2_mp_mod);
+    sp_256_mont_sub_sm2_5(x2, t5, t3, p256_sm2_mod);
+    sp_256_mont_sub_sm2_5(x2, x2, t2, p256_sm2_mod);
+    /* X1 = (Y1 + Y2)^2 - W1 - W2 */
+    sp_256_mont_add_sm2_5(t1, y1, y2, p256_sm2_mod);
+    sp_256_mont_sqr_sm2_5(t5, t1, p256_sm2_mod, p256_sm2_mp_mod);
+    sp_256_mont_sub_sm2_5(x1, t5, t3, p256_sm2_mod);
+    sp_256_mont_sub_sm2_5(x1, x1, t2, p256_sm2_mod);
+    /* A = Y1 * (W1 - W2) */
+    sp_256_mont_sub_sm2_5(t2, t3, t2, p256_sm2_mod);
+    sp_256_mont_mul_sm2_5(t2, y1, t2, p256_sm2_mod, p256_sm2_mp_mod);
+    /* Y2 = (Y1 - Y2) * (W1 - X2) - A */
+    sp_256_mont_sub_sm2_5(t5, t3, x2, p256_sm2_mod);
+    sp_256_mont_mul_sm2_5(t4, t4, t5, p256_sm2_mod, p256_sm2_mp_mod);
+    sp_256_mont_sub_sm2_5(y2, t4, t2, p256_sm2_mod);
+    /* Y1 = (Y1 + Y2) * (W1 - X1) - A */
+    sp_256_mont_sub_sm2_5(t5, t3, x1, p256_sm2_mod);
+    sp_256_mont_mul_sm2_5(t1, t1, t5, p256_sm2_mod, p256_sm2_mp_mod);
+    sp_256_mont_sub_sm2_5(y1, t1, t2, p256_sm2_mod);
+}
+
+/* Multiply the affine point by the scalar calculating only the x ordinate.
+ *
+ * Co-Z Montgomery ladder with (X, Y)-only conjugate addition and addition.
+ * The Z ordinate is recovered at the end from the difference of the ladder
+ * points, which is always the input point, so only one inversion is needed.
+ * The scalar is recoded to k + n or k + 2n so that the top bit, 2^256, is
+ * always set and the number of iterations is fixed.
+ * No table of points is used.
+ * The ladder fails for the scalars 1, (n-1)/2, n-2 and n-1. Without
+ * branching, the ladder is performed with k - 1 for these and the x ordinate
+ * of R1 is used instead. For 1 and n-1, x(k.P) = x(P) is selected at the end.
+ * Private keys that are zero or not less than the order, and points not in
+ * affine form, are not valid for the ladder and use the general
+ * implementation.
+ *
+ * r     Resulting point. Only the x ordinate is calculated.
+ * g     Point to multiply.
+ * k     Scalar to multiply by.
+ * heap  Heap to use for allocation.
+ * returns MEMORY_E when memory allocation fails and MP_OKAY on success.
+ */
+static int sp_256_ecc_mulmod_x_sm2_5(sp_point_256* r,
+        const sp_point_256* g, const sp_digit* k, void* heap)
+{
+#ifdef WOLFSSL_SP_SMALL_STACK
+    sp_digit* tmp = NULL;
+#else
+    sp_digit tmp[2 * 5 * 17];
+#endif
+    sp_digit* t;
+    sp_digit* xa;
+    sp_digit* ya;
+    sp_digit* xb;
+    sp_digit* yb;
+    sp_digit* xp;
+    sp_digit* yp;
+    sp_digit* xg;
+    sp_digit* t1;
+    sp_digit* t2;
+    sp_digit* t3;
+    byte kb[32];
+    byte kr[32];
+    byte t8[32];
+    sp_digit z;
+    sp_digit m;
+    sp_digit m1;
+    sp_digit mx;
+    word32 c;
+    word32 d;
+    word32 h;
+    word32 e1;
+    word32 eh;
+    word32 en1;
+    word32 en2;
+    int b;
+    int s;
+    int i;
+    int invalid = 1;
+    int err = MP_OKAY;
+
+    (void)heap;
+
+    /* Ladder requires an affine point. */
+    z = g->z[0] ^ 1;
+    for (i = 1; i < 5; i++) {
+        z |= g->z[i];
+    }
+
+#ifdef WOLFSSL_SP_SMALL_STACK
+    tmp = (sp_digit*)XMALLOC(sizeof(sp_digit) * 2 * 5 * 17, heap,
+                             DYNAMIC_TYPE_ECC);
+    if (tmp == NULL)
+        err = MEMORY_E;
+#endif
+
+    if (err == MP_OKAY) {
+        t = tmp;
+        xa = tmp + 2 * 5 * 10;
+        ya = tmp + 2 * 5 * 11;
+        xb = tmp + 2 * 5 * 12;
+        yb = tmp + 2 * 5 * 13;
+        xp = tmp + 2 * 5 * 14;
+        yp = tmp + 2 * 5 * 15;
+        xg = tmp + 2 * 5 * 16;
+
+        XMEMCPY(t, k, sizeof(sp_digit) * 5);
+        sp_256_to_bin_5(t, kb);
+
+        /* Check for private keys that are not valid: k = 0 and k >= n. */
+        d = 0;
+        c = 0;
+        for (i = 31; i >= 0; i--) {
+            d |= kb[i];
+            c += (word32)kb[i] - p256_sm2_order_bin[i];
+            c = (word32)((sp_int32)c >> 8);
+        }
+        invalid = (z != 0) || (d == 0) || (c == 0);
+        if (invalid) {
+            err = sp_256_ecc_mulmod_sm2_5(r, g, k, 1, 1, heap);
+        }
+    }
+
+    if ((err == MP_OKAY) && (!invalid)) {
+        /* Check for scalars that are special cases of the ladder:
+         * k = 1, k = (n - 1) / 2, k = n - 2 and k = n - 1. */
+        e1 = kb[31] ^ 1;
+        h = kb[0] ^ (p256_sm2_order_bin[0] >> 1);
+        d = 0;
+        for (i = 0; i < 31; i++) {
+            e1 |= kb[i];
+            h |= kb[i + 1] ^ (byte)((p256_sm2_order_bin[i + 1] >> 1) |
+                                    (p256_sm2_order_bin[i] << 7));
+            d |= kb[i] ^ p256_sm2_order_bin[i];
+        }
+        en1 = d | (kb[31] ^ (byte)(p256_sm2_order_bin[31] - 1));
+        en2 = d | (kb[31] ^ (byte)(p256_sm2_order_bin[31] - 2));
+        /* Each is 1 when equal and 0 otherwise. */
+        e1 = (e1 - 1) >> 31;
+        eh = (h - 1) >> 31;
+        en1 = (en1 - 1) >> 31;
+        en2 = (en2 - 1) >> 31;
+        m1 = (sp_digit)0 - (sp_digit)(e1 | eh | en1 | en2);
+        mx = (sp_digit)0 - (sp_digit)(e1 | en1);
+
+        /* Special cases use k - 1 and the x ordinate of R1. */
+        c = e1 | eh | en1 | en2;
+        for (i = 31; i >= 0; i--) {
+            c = (word32)kb[i] - c;
+            kb[i] = (byte)c;
+            c = (c >> 8) & 1;
+        }
+
+        /* Recode scalar: kr = k + n when it overflows, otherwise k + 2n.
+         * Bit 256 is set in both cases. */
+        c = 0;
+        for (i = 31; i >= 0; i--) {
+            c += (word32)kb[i] + p256_sm2_order_bin[i];
+            t8[i] = (byte)c;
+            c >>= 8;
+        }
+        m = (sp_digit)0 - (sp_digit)c;
+        c = 0;
+        for (i = 31; i >= 0; i--) {
+            c += (word32)t8[i] + p256_sm2_order_bin[i];
+            kr[i] = (byte)c;
+            c >>= 8;
+        }
+        for (i = 0; i < 32; i++) {
+            kr[i] ^= (kr[i] ^ t8[i]) & (byte)m;
+        }
+
+        /* Keep x(P) as r may be the same as g. */
+        XMEMCPY(xg, g->x, sizeof(sp_digit) * 5);
+        err = sp_256_mod_mul_norm_sm2_5(xp, g->x, p256_sm2_mod);
+    }
+    if ((err == MP_OKAY) && (!invalid))
+        err = sp_256_mod_mul_norm_sm2_5(yp, g->y, p256_sm2_mod);
+    if ((err == MP_OKAY) && (!invalid))
+        err = sp_256_mod_mul_norm_sm2_5(xa, g->z, p256_sm2_mod);
+    if ((err == MP_OKAY) && (!invalid)) {
+        /* R1 = 2.P */
+        XMEMCPY(r->x, xp, sizeof(sp_digit) * 5);
+        XMEMCPY(r->y, yp, sizeof(sp_digit) * 5);
+        XMEMCPY(r->z, xa, sizeof(sp_digit) * 5);
+        r->infinity = 0;
+        sp_256_proj_point_dbl_sm2_5(r, r, t);
+        XMEMCPY(xb, r->x, sizeof(sp_digit) * 5);
+        XMEMCPY(yb, r->y, sizeof(sp_digit) * 5);
+        /* R0 = P with the same Z ordinate as R1. */
+        sp_256_mont_sqr_sm2_5(t, r->z, p256_sm2_mod, p256_sm2_mp_mod);
+        sp_256_mont_mul_sm2_5(xa, xp, t, p256_sm2_mod, p256_sm2_mp_mod);
+        sp_256_mont_mul_sm2_5(t, t, r->z, p256_sm2_mod, p256_sm2_mp_mod);
+        sp_256_mont_mul_sm2_5(ya, yp, t, p256_sm2_mod, p256_sm2_mp_mod);
+
+        /* A is R[b] and B is R[1-b] for the current bit b. */
+        s = 0;
+        for (i = 255; i >= 0; i--) {
+            b = (kr[31 - (i >> 3)] >> (i & 7)) & 1;
+            m = (sp_digit)0 - (sp_digit)(b ^ s);
+            sp_256_cond_swap_sm2_5(xa, xb, m);
+            sp_256_cond_swap_sm2_5(ya, yb, m);
+            s = b;
+
+            /* R[1-b] = R[b] + R[1-b], R[b] = R[b] - R[1-b] */
+            sp_256_proj_point_add_conj_coz_sm2_5(xa, ya, xb, yb, t);
+            /* R[b] = R[1-b] + R[b] */
+            sp_256_proj_point_add_coz_sm2_5(xb, yb, xa, ya, t);
+        }
+        /* A is R0 and B is R1. */
+        m = (sp_digit)0 - (sp_digit)s;
+        sp_256_cond_swap_sm2_5(xa, xb, m);
+        sp_256_cond_swap_sm2_5(ya, yb, m);
+
+        /* Calculate P = R1 - R0 = (X', Y') with Z' = Z.(X1 - X0) and change
+         * R0 to have Z'. */
+        t1 = t;
+        t2 = t + 2 * 5;
+        t3 = t + 4 * 5;
+        sp_256_mont_sub_sm2_5(t1, xb, xa, p256_sm2_mod);
+        sp_256_mont_sqr_sm2_5(t1, t1, p256_sm2_mod, p256_sm2_mp_mod);
+        sp_256_mont_mul_sm2_5(xa, xa, t1, p256_sm2_mod, p256_sm2_mp_mod);
+        sp_256_mont_mul_sm2_5(xb, xb, t1, p256_sm2_mod, p256_sm2_mp_mod);
+        /* X' = (Y1 + Y0)^2 - W1 - W0 */
+        sp_256_mont_add_sm2_5(t2, yb, ya, p256_sm2_mod);
+        sp_256_mont_sqr_sm2_5(t3, t2, p256_sm2_mod, p256_sm2_mp_mod);
+        sp_256_mont_sub_sm2_5(t3, t3, xb, p256_sm2_mod);
+        sp_256_mont_sub_sm2_5(t3, t3, xa, p256_sm2_mod);
+        /* Y' = (Y1 + Y0) * (W1 - X') - Y1 * (W1 - W0) */
+        sp_256_mont_sub_sm2_5(t1, xb, xa, p256_sm2_mod);
+        sp_256_mont_mul_sm2_5(yb, yb, t1, p256_sm2_mod, p256_sm2_mp_mod);
+        sp_256_mont_sub_sm2_5(t1, xb, t3, p256_sm2_mod);
+        sp_256_mont_mul_sm2_5(t2, t2, t1, p256_sm2_mod, p256_sm2_mp_mod);
+        sp_256_mont_sub_sm2_5(t2, t2, yb, p256_sm2_mod);
+
+        /* 1/Z' = (y.X') / (x.Y') as P is (x, y) in affine.
+         * x(R0) = W0 / Z'^2 = (W0.(y.X')^2) / (x.Y')^2
+         * Use W1 instead of W0 for x(R1) with special cases. */
+        sp_256_cond_swap_sm2_5(xa, xb, m1);
+        sp_256_mont_mul_sm2_5(r->z, xp, t2, p256_sm2_mod, p256_sm2_mp_mod);
+        sp_256_mont_mul_sm2_5(t1, yp, t3, p256_sm2_mod, p256_sm2_mp_mod);
+        sp_256_mont_sqr_sm2_5(t1, t1, p256_sm2_mod, p256_sm2_mp_mod);
+        sp_256_mont_mul_sm2_5(r->x, xa, t1, p256_sm2_mod, p256_sm2_mp_mod);
+        sp_256_map_sm2_5(r, r, t);
+        /* x(k.P) = x(P) when k = 1 or k = n - 1. */
+        for (i = 0; i < 5; i++) {
+            r->x[i] ^= (r->x[i] ^ xg[i]) & mx;
+        }
+    }
+
+#ifdef WOLFSSL_SP_SMALL_STACK
+    if (tmp != NULL)
+#endif
+    {
+        ForceZero(tmp, sizeof(sp_digit) * 2 * 5 * 17);
+    #ifdef WOLFSSL_SP_SMALL_STACK
+        XFREE(tmp, heap, DYNAMIC_TYPE_ECC);
+    #endif
+    }
+    ForceZero(kb, sizeof(kb));
+    ForceZero(kr, sizeof(kr));
+    ForceZero(t8, sizeof(t8));
+
+    return err;
+}
+
+#endif /* WOLFSSL_SP_SMALL || WOLFSSL_SP_SM2_COZ_LADDER */
+
 /* Multiply the point by the scalar and serialize the X ordinate.
  * The number is 0 padded to maximum size on output.
  *
@@ -5194,7 +5996,11 @@ int sp_ecc_secret_gen_sm2_256(const mp_int* priv, const ecc_point* pub, byte* ou
     if (err == MP_OKAY) {
         sp_256_from_mp(k, 5, priv);
         sp_256_point_from_ecc_point_5(point, pub);
-            err = sp_256_ecc_mulmod_sm2_5(point, point, k, 1, 1, heap);
+    #if defined(WOLFSSL_SP_SMALL) || defined(WOLFSSL_SP_SM2_COZ_LADDER)
+        err = sp_256_ecc_mulmod_x_sm2_5(point, point, k, heap);
+    #else
+        err = sp_256_ecc_mulmod_sm2_5(point, point, k, 1, 1, heap);
+    #endif
     }
     if (err == MP_OKAY) {
         sp_256_to_bin_5(point->x, out);
@@ -5437,13 +6243,14 @@ static void sp_256_mont_inv_order_sm2_5(sp_digit* r, const sp_digit* a,
  *
  * hash     Hash to sign.
  * hashLen  Length of the hash data.
- * rng      Random number generator.
+ * rng      Random number generator. May be NULL when km is set.
  * priv     Private part of key - scalar.
  * rm       First part of result as an mp_int.
  * sm       Sirst part of result as an mp_int.
+ * km       k to use. May be NULL.
  * heap     Heap to use for allocation.
- * returns RNG failures, MEMORY_E when memory allocation fails and
- * MP_OKAY on success.
+ * returns RNG failures, MEMORY_E when memory allocation fails,
+ * MP_ZERO_E when km is not usable and rng is NULL, and MP_OKAY on success.
  */
 int sp_ecc_sign_sm2_256(const byte* hash, word32 hashLen, WC_RNG* rng,
     const mp_int* priv, mp_int* rm, mp_int* sm, mp_int* km, void* heap)
@@ -5506,7 +6313,11 @@ int sp_ecc_sign_sm2_256(const byte* hash, word32 hashLen, WC_RNG* rng,
         sp_256_from_mp(x, 5, priv);
 
         /* New random point. */
-        if (km == NULL || mp_iszero(km)) {
+        if ((km == NULL || mp_iszero(km)) && (rng == NULL)) {
+            /* k passed in not usable - caller to generate another. */
+            err = MP_ZERO_E;
+        }
+        else if (km == NULL || mp_iszero(km)) {
             err = sp_256_ecc_gen_k_sm2_5(rng, k);
         }
         else {
@@ -6173,6 +6984,75 @@ static const word64 p256_sm2_sqrt_power[4] = {
     0x3fffffffbfffffff
 };
 
+/* Find the square root of a number mod the prime of the curve.
+ *
+ * y  The number to operate on and the result.
+ * t  Temporary data - 6 * 5 digits.
+ */
+static void sp_256_mont_sqrt_tmp_sm2_5(sp_digit* y, sp_digit* t)
+{
+#ifndef WOLFSSL_SP_SMALL
+    /* Square root power only used by the small implementation. */
+    (void)p256_sm2_sqrt_power;
+
+#endif
+    {
+#ifdef WOLFSSL_SP_SMALL
+        int i;
+
+        XMEMCPY(t, y, sizeof(sp_digit) * 5);
+        for (i=252; i>=0; i--) {
+            sp_256_mont_sqr_sm2_5(t, t, p256_sm2_mod, p256_sm2_mp_mod);
+            if (p256_sm2_sqrt_power[i / 64] & ((sp_digit)1 << (i % 64)))
+                sp_256_mont_mul_sm2_5(t, t, y, p256_sm2_mod, p256_sm2_mp_mod);
+        }
+        XMEMCPY(y, t, sizeof(sp_digit) * 5);
+#else
+        sp_digit* t1 = t;
+        sp_digit* t2 = t + 2 * 5;
+        sp_digit* t3 = t + 4 * 5;
+        int i;
+
+        /* t1 = y ^ (2^2 - 1) */
+        sp_256_mont_sqr_sm2_5(t1, y, p256_sm2_mod, p256_sm2_mp_mod);
+        sp_256_mont_mul_sm2_5(t1, t1, y, p256_sm2_mod, p256_sm2_mp_mod);
+        /* t2 = y ^ (2^3 - 1) */
+        sp_256_mont_sqr_sm2_5(t2, t1, p256_sm2_mod, p256_sm2_mp_mod);
+        sp_256_mont_mul_sm2_5(t2, t2, y, p256_sm2_mod, p256_sm2_mp_mod);
+        /* t3 = y ^ (2^6 - 1) */
+        sp_256_mont_sqr_n_sm2_5(t3, t2, 3, p256_sm2_mod, p256_sm2_mp_mod);
+        sp_256_mont_mul_sm2_5(t3, t3, t2, p256_sm2_mod, p256_sm2_mp_mod);
+        /* t1 = y ^ (2^12 - 1) */
+        sp_256_mont_sqr_n_sm2_5(t1, t3, 6, p256_sm2_mod, p256_sm2_mp_mod);
+        sp_256_mont_mul_sm2_5(t1, t1, t3, p256_sm2_mod, p256_sm2_mp_mod);
+        /* t1 = y ^ (2^15 - 1) */
+        sp_256_mont_sqr_n_sm2_5(t1, t1, 3, p256_sm2_mod, p256_sm2_mp_mod);
+        sp_256_mont_mul_sm2_5(t1, t1, t2, p256_sm2_mod, p256_sm2_mp_mod);
+        /* t3 = y ^ (2^30 - 1) */
+        sp_256_mont_sqr_n_sm2_5(t3, t1, 15, p256_sm2_mod, p256_sm2_mp_mod);
+        sp_256_mont_mul_sm2_5(t3, t3, t1, p256_sm2_mod, p256_sm2_mp_mod);
+        /* t1 = y ^ (2^31 - 1) */
+        sp_256_mont_sqr_sm2_5(t1, t3, p256_sm2_mod, p256_sm2_mp_mod);
+        sp_256_mont_mul_sm2_5(t1, t1, y, p256_sm2_mod, p256_sm2_mp_mod);
+        /* t2 = y ^ (2^32 - 1) */
+        sp_256_mont_sqr_sm2_5(t2, t1, p256_sm2_mod, p256_sm2_mp_mod);
+        sp_256_mont_mul_sm2_5(t2, t2, y, p256_sm2_mod, p256_sm2_mp_mod);
+        /* t1 = y ^ ((2^31 - 1) << 1) */
+        sp_256_mont_sqr_sm2_5(t1, t1, p256_sm2_mod, p256_sm2_mp_mod);
+        /* t1 = y ^ (((2^31 - 1) << 129) | (2^128 - 1)) */
+        for (i = 0; i < 4; i++) {
+            sp_256_mont_sqr_n_sm2_5(t1, t1, 32, p256_sm2_mod, p256_sm2_mp_mod);
+            sp_256_mont_mul_sm2_5(t1, t1, t2, p256_sm2_mod, p256_sm2_mp_mod);
+        }
+        /* t1 = y ^ (((2^31 - 1) << 161) | ((2^128 - 1) << 32) | 1) */
+        sp_256_mont_sqr_n_sm2_5(t1, t1, 32, p256_sm2_mod, p256_sm2_mp_mod);
+        sp_256_mont_mul_sm2_5(t1, t1, y, p256_sm2_mod, p256_sm2_mp_mod);
+        /* y = y ^ ((p + 1) / 4) */
+        sp_256_mont_sqr_n_sm2_5(y, t1, 62, p256_sm2_mod, p256_sm2_mp_mod);
+#endif /* WOLFSSL_SP_SMALL */
+    }
+}
+
 /* Find the square root of a number mod the prime of the curve.
  *
  * y  The number to operate on and the result.
@@ -6183,29 +7063,18 @@ static int sp_256_mont_sqrt_sm2_5(sp_digit* y)
 #ifdef WOLFSSL_SP_SMALL_STACK
     sp_digit* t = NULL;
 #else
-    sp_digit t[2 * 5];
+    sp_digit t[6 * 5];
 #endif
     int err = MP_OKAY;
 
 #ifdef WOLFSSL_SP_SMALL_STACK
-    t = (sp_digit*)XMALLOC(sizeof(sp_digit) * 2 * 5, NULL, DYNAMIC_TYPE_ECC);
+    t = (sp_digit*)XMALLOC(sizeof(sp_digit) * 6 * 5, NULL, DYNAMIC_TYPE_ECC);
     if (t == NULL)
         err = MEMORY_E;
 #endif
 
     if (err == MP_OKAY) {
-
-        {
-            int i;
-
-            XMEMCPY(t, y, sizeof(sp_digit) * 5);
-            for (i=252; i>=0; i--) {
-                sp_256_mont_sqr_sm2_5(t, t, p256_sm2_mod, p256_sm2_mp_mod);
-                if (p256_sm2_sqrt_power[i / 64] & ((sp_digit)1 << (i % 64)))
-                    sp_256_mont_mul_sm2_5(t, t, y, p256_sm2_mod, p256_sm2_mp_mod);
-            }
-            XMEMCPY(y, t, sizeof(sp_digit) * 5);
-        }
+        sp_256_mont_sqrt_tmp_sm2_5(y, t);
     }
 
 #ifdef WOLFSSL_SP_SMALL_STACK
@@ -6280,6 +7149,136 @@ int sp_ecc_uncompress_sm2_256(mp_int* xm, int odd, mp_int* ym)
 
     return err;
 }
+
+/* Uncompress many points encoded as a byte indicating whether the Y ordinate
+ * is odd followed by the X ordinate.
+ * Constants are converted and temporaries, including those of the square
+ * root, allocated once for all points.
+ *
+ * cnt    Number of points.
+ * in     Encoded points - cnt * 33 bytes.
+ * r      Array of points to set. Z ordinate is set to one.
+ * check  Whether to check that X is less than the prime and that the point is
+ *        on the curve.
+ * heap   Heap to use for allocation.
+ * returns MEMORY_E if dynamic memory allocation fails, MP_VAL when an encoding
+ * is invalid or, when checking, a point is not on the curve and MP_OKAY
+ * otherwise.
+ */
+int sp_ecc_uncompress_batch_sm2_256(word32 cnt, const byte* in,
+    ecc_point** r, int check, void* heap)
+{
+#ifdef WOLFSSL_SP_SMALL_STACK
+    sp_digit* x = NULL;
+#else
+    sp_digit x[14 * 5];
+#endif
+    sp_digit* y = NULL;
+    sp_digit* z = NULL;
+    sp_digit* b = NULL;
+    sp_digit* t = NULL;
+    const byte* pt;
+    sp_int64 n;
+    word32 i;
+    int err = MP_OKAY;
+
+    (void)heap;
+
+#ifdef WOLFSSL_SP_SMALL_STACK
+    x = (sp_digit*)XMALLOC(sizeof(sp_digit) * 14 * 5, heap,
+        DYNAMIC_TYPE_ECC);
+    if (x == NULL)
+        err = MEMORY_E;
+#endif
+
+    if (err == MP_OKAY) {
+        y = x + 2 * 5;
+        z = x + 4 * 5;
+        b = x + 6 * 5;
+        t = x + 8 * 5;
+
+        /* b in Montgomery form is used for all points. */
+        err = sp_256_mod_mul_norm_sm2_5(b, p256_sm2_b, p256_sm2_mod);
+    }
+    for (i = 0; (err == MP_OKAY) && (i < cnt); i++) {
+        pt = in + i * 33;
+
+        if ((pt[0] != ECC_POINT_COMP_EVEN) && (pt[0] != ECC_POINT_COMP_ODD)) {
+            err = MP_VAL;
+        }
+        if (err == MP_OKAY) {
+            sp_256_from_bin(x, 5, pt + 1, 32);
+            if (check && (sp_256_cmp_sm2_5(x, p256_sm2_mod) >= 0)) {
+                err = MP_VAL;
+            }
+        }
+        if (err == MP_OKAY) {
+            err = sp_256_to_mp(x, r[i]->x);
+        }
+        if (err == MP_OKAY) {
+            err = sp_256_mod_mul_norm_sm2_5(x, x, p256_sm2_mod);
+        }
+        if (err == MP_OKAY) {
+            /* y = x^3 */
+            sp_256_mont_sqr_sm2_5(y, x, p256_sm2_mod, p256_sm2_mp_mod);
+            sp_256_mont_mul_sm2_5(y, y, x, p256_sm2_mod, p256_sm2_mp_mod);
+            /* y = x^3 - 3x + b */
+            sp_256_mont_sub_sm2_5(y, y, x, p256_sm2_mod);
+            sp_256_mont_sub_sm2_5(y, y, x, p256_sm2_mod);
+            sp_256_mont_sub_sm2_5(y, y, x, p256_sm2_mod);
+            sp_256_mont_add_sm2_5(y, y, b, p256_sm2_mod);
+            if (check) {
+                /* z = x^3 - 3x + b - not in Montgomery form */
+                XMEMCPY(z, y, 5U * sizeof(sp_digit));
+                XMEMSET(z + 5, 0, 5U * sizeof(sp_digit));
+                sp_256_mont_reduce_sm2_5(z, p256_sm2_mod, p256_sm2_mp_mod);
+                /* Reduce z to less than modulus */
+                n = sp_256_cmp_sm2_5(z, p256_sm2_mod);
+                sp_256_cond_sub_sm2_5(z, z, p256_sm2_mod, (sp_digit)~(n >> 51));
+                sp_256_norm_5(z);
+            }
+            /* y = sqrt(x^3 - 3x + b) */
+            sp_256_mont_sqrt_tmp_sm2_5(y, t);
+        }
+        if ((err == MP_OKAY) && check) {
+            /* Point is on the curve when y^2 = x^3 - 3x + b */
+            sp_256_mont_sqr_sm2_5(x, y, p256_sm2_mod, p256_sm2_mp_mod);
+            XMEMSET(x + 5, 0, 5U * sizeof(sp_digit));
+            sp_256_mont_reduce_sm2_5(x, p256_sm2_mod, p256_sm2_mp_mod);
+            /* Reduce x to less than modulus */
+            n = sp_256_cmp_sm2_5(x, p256_sm2_mod);
+            sp_256_cond_sub_sm2_5(x, x, p256_sm2_mod, (sp_digit)~(n >> 51));
+            sp_256_norm_5(x);
+            if (sp_256_cmp_sm2_5(x, z) != 0) {
+                err = MP_VAL;
+            }
+        }
+        if (err == MP_OKAY) {
+            XMEMSET(y + 5, 0, 5U * sizeof(sp_digit));
+            sp_256_mont_reduce_sm2_5(y, p256_sm2_mod, p256_sm2_mp_mod);
+            /* Reduce y to less than modulus */
+            n = sp_256_cmp_sm2_5(y, p256_sm2_mod);
+            sp_256_cond_sub_sm2_5(y, y, p256_sm2_mod, (sp_digit)~(n >> 51));
+            sp_256_norm_5(y);
+            if ((((word32)y[0] ^ (word32)pt[0]) & 1U) != 0U) {
+                sp_256_mont_sub_sm2_5(y, p256_sm2_mod, y, p256_sm2_mod);
+            }
+
+            err = sp_256_to_mp(y, r[i]->y);
+        }
+        if (err == MP_OKAY) {
+            XMEMSET(x, 0, 5U * sizeof(sp_digit));
+            x[0] = 1;
+            err = sp_256_to_mp(x, r[i]->z);
+        }
+    }
+
+#ifdef WOLFSSL_SP_SMALL_STACK
+    XFREE(x, heap, DYNAMIC_TYPE_ECC);
+#endif
+
+    return err;
+}
 #endif
 #endif /* WOLFSSL_SP_SM2 */
 #endif /* WOLFSSL_HAVE_SP_ECC */
@@ -0,0 +1,3585 @@
+/* sm_test.c
+ *
+ * Copyright (C) 2006-2024 wolfSSL Inc.
+ *
+ * This file is part of wolfSSL.
+ *
+ * wolfSSL is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * wolfSSL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1335, USA
+ */
+
+/* Tests of the wolfsm APIs that are not covered by wolfCrypt's tests.
+ *
+ * Build against a wolfSSL that has the wolfsm files installed:
+ *   gcc -I<wolfssl> -o sm_test tests/sm_test.c \
+ *       -L<wolfssl>/src/.libs -lwolfssl -lpthread
+ */
+
+#ifdef HAVE_CONFIG_H
+    #include <config.h>
+#endif
+#ifndef WOLFSSL_USER_SETTINGS
+    #include <wolfssl/options.h>
+#endif
+#include <wolfssl/wolfcrypt/settings.h>
+#include <wolfssl/wolfcrypt/types.h>
+#include <wolfssl/wolfcrypt/error-crypt.h>
+
+#ifdef WOLFSSL_SM3
+    #include <wolfssl/wolfcrypt/sm3.h>
+#endif
+#ifdef WOLFSSL_SM4
+    #include <wolfssl/wolfcrypt/sm4.h>
+#endif
+#ifdef WOLFSSL_SM_BATCH_DEV
+    #include <wolfssl/wolfcrypt/sm_batch.h>
+#endif
+#if defined(WOLFSSL_SM2) && defined(HAVE_ECC)
+    #include <wolfssl/wolfcrypt/ecc.h>
+    #include <wolfssl/wolfcrypt/sm2.h>
+    #include <wolfssl/wolfcrypt/wolfmath.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+/* Return value of a failed check - negative line number of check. */
+#define SM_TEST_FAIL()      (-(int)__LINE__)
+
+/* Number of test failures. */
+static int failures = 0;
+
+/* Fill buffer with data that depends on a seed.
+ *
+ * @param [out] buf   Buffer to fill.
+ * @param [in]  sz    Number of bytes to fill.
+ * @param [in]  seed  Seed of data.
+ */
+static void sm_test_fill(byte* buf, word32 sz, word32 seed)
+{
+    word32 i;
+
+    for (i = 0; i < sz; i++) {
+        seed = seed * 1103515245U + 12345U;
+        buf[i] = (byte)(seed >> 16);
+    }
+}
+
+/* Report the result of a test.
+ *
+ * @param [in] name  Name of test.
+ * @param [in] ret   Result of test - 0 on success.
+ */
+static void sm_test_report(const char* name, int ret)
+{
+    if (ret == 0) {
+        printf("%-30s test passed!\n", name);
+    }
+    else {
+        printf("%-30s test failed! (line %d)\n", name, -ret);
+        failures++;
+    }
+}
+
+#ifdef WOLFSSL_SM3_DRBG
+/* Test SM3 Hash_DRBG against known answers.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm3_drbg_test(void)
+{
+    static const byte exp[3][64] = {
+        {
+0xed, 0x6c, 0xbf, 0x17, 0x9c, 0x35, 0x4a, 0x49,
+            0xd1, 0x3e, 0x6d, 0xd3, 0x5d, 0x5e, 0x62, 0xd1,
+            0xe3, 0x9a, 0x2f, 0x5f, 0x7c, 0xd7, 0xea, 0x3f,
+            0x18, 0x35, 0xf0, 0x6a, 0x45, 0x6a, 0x8d, 0x14,
+            0x84, 0x14, 0x11, 0xf1, 0x53, 0xdd, 0x8b, 0x64,
+            0x74, 0xf2, 0x5d, 0xe7, 0x1e, 0x28, 0xaf, 0x1e,
+            0xd2, 0x6b, 0xe9, 0x33, 0xd5, 0x5b, 0xc9, 0x42,
+            0xf1, 0x61, 0x90, 0x0b, 0x69, 0xfc, 0x04, 0xb1
+        },
+        {
+            0xa7, 0x80, 0x30, 0x85, 0xf1, 0x77, 0x16, 0x38,
+            0xf7, 0xd0, 0xbb, 0x14, 0xd6, 0x36, 0x45, 0x09,
+            0xde, 0x1f, 0xf8, 0xe5, 0x51, 0xdd, 0x5a, 0x9f,
+            0x9b, 0xa6, 0x33, 0xdf, 0xf6, 0xf4, 0x58, 0x86
+        },
+        {
+            0xa4, 0x8c, 0x7e, 0x78, 0x3c, 0xd8, 0xae, 0x31,
+            0x95, 0xf1, 0x16, 0xcc, 0xbe, 0x39, 0x22, 0xa4,
+            0xb0, 0xa6, 0x0c, 0x61, 0x98, 0x34, 0x54, 0x2d,
+            0xbc, 0x41, 0xba, 0xf0, 0x73, 0x63, 0xcb, 0x24
+        }
+    };
+    static const byte pers[] = { 'w', 'o', 'l', 'f', 's', 'm' };
+    wc_Sm3Drbg drbg;
+    byte entropy[WC_SM3_DRBG_MIN_ENTROPY];
+    byte nonce[WC_SM3_DRBG_NONCE_SZ];
+    byte add[7];
+    byte out[64];
+    word32 i;
+    int ret = 0;
+
+    for (i = 0; i < sizeof(entropy); i++)
+        entropy[i] = (byte)i;
+    for (i = 0; i < sizeof(nonce); i++)
+        nonce[i] = (byte)(0x80 + i);
+    for (i = 0; i < sizeof(add); i++)
+        add[i] = (byte)(0xa0 + i);
+
+    if (wc_Sm3DrbgInit(&drbg, entropy, sizeof(entropy), nonce, sizeof(nonce),
+            pers, sizeof(pers)) != 0)
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && (wc_Sm3DrbgSetReseedInterval(&drbg, 2) != 0))
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && ((wc_Sm3DrbgGenerate(&drbg, out, 64, NULL, 0) != 0) ||
+            (XMEMCMP(out, exp[0], 64) != 0)))
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && ((wc_Sm3DrbgGenerate(&drbg, out, 32, add,
+            sizeof(add)) != 0) || (XMEMCMP(out, exp[1], 32) != 0)))
+        ret = SM_TEST_FAIL();
+    /* Reseed interval reached and seeded by caller - must reseed. */
+    if ((ret == 0) && (wc_Sm3DrbgGenerate(&drbg, out, 32, NULL, 0) !=
+            BAD_STATE_E))
+        ret = SM_TEST_FAIL();
+    for (i = 0; i < sizeof(entropy); i++)
+        entropy[i] = (byte)(0x20 + i);
+    if ((ret == 0) && (wc_Sm3DrbgReseed(&drbg, entropy, sizeof(entropy), add,
+            sizeof(add)) != 0))
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && ((wc_Sm3DrbgGenerate(&drbg, out, 32, NULL, 0) != 0) ||
+            (XMEMCMP(out, exp[2], 32) != 0)))
+        ret = SM_TEST_FAIL();
+    /* Not enough entropy. */
+    if ((ret == 0) && (wc_Sm3DrbgInit(&drbg, entropy, sizeof(entropy) - 1,
+            NULL, 0, NULL, 0) != BAD_FUNC_ARG))
+        ret = SM_TEST_FAIL();
+
+    wc_Sm3DrbgFree(&drbg);
+    return ret;
+}
+#endif
+
+#ifdef WOLFSSL_SM3_DRBG_THREAD
+/* Test the SM3 Hash_DRBG of a thread.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm3_drbg_thread_test(void)
+{
+    byte out[2][WC_SM3_DIGEST_SIZE];
+    int ret = 0;
+
+    if ((wc_Sm3DrbgGenerateBlock(out[0], sizeof(out[0])) != 0) ||
+            (wc_Sm3DrbgGenerateBlock(out[1], sizeof(out[1])) != 0) ||
+            (XMEMCMP(out[0], out[1], sizeof(out[0])) == 0))
+        ret = SM_TEST_FAIL();
+    /* Freed DRBG is seeded again on next use. */
+    wc_Sm3DrbgThreadFree();
+    if ((ret == 0) && ((wc_Sm3DrbgGenerateBlock(out[0], sizeof(out[0])) != 0)
+            || (XMEMCMP(out[0], out[1], sizeof(out[0])) == 0)))
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && (wc_Sm3DrbgGenerateBlock(NULL, 1) != BAD_FUNC_ARG))
+        ret = SM_TEST_FAIL();
+
+    wc_Sm3DrbgThreadFree();
+    return ret;
+}
+#endif
+
+#ifdef WOLFSSL_SM3
+/* Test SM3 against known answers with data split into different sized
+ * updates.
+ *
+ * Known answers from GB/T 32905-2016, Appendix A and a multi-block message.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm3_kat_test(void)
+{
+    /* Appendix A.1 - "abc". */
+    static const byte exp1[WC_SM3_DIGEST_SIZE] = {
+        0x66, 0xc7, 0xf0, 0xf4, 0x62, 0xee, 0xed, 0xd9,
+        0xd1, 0xf2, 0xd4, 0x6b, 0xdc, 0x10, 0xe4, 0xe2,
+        0x41, 0x67, 0xc4, 0x87, 0x5c, 0xf2, 0xf7, 0xa2,
+        0x29, 0x7d, 0xa0, 0x2b, 0x8f, 0x4b, 0xa8, 0xe0
+    };
+    /* Appendix A.2 - "abcd" 16 times. */
+    static const byte exp2[WC_SM3_DIGEST_SIZE] = {
+        0xde, 0xbe, 0x9f, 0xf9, 0x22, 0x75, 0xb8, 0xa1,
+        0x38, 0x60, 0x48, 0x89, 0xc1, 0x8e, 0x5a, 0x4d,
+        0x6f, 0xdb, 0x70, 0xe5, 0x38, 0x7e, 0x57, 0x65,
+        0x29, 0x3d, 0xcb, 0xa3, 0x9c, 0x0c, 0x57, 0x32
+    };
+    /* 1000 bytes of data from sm_test_fill() with seed 37. */
+    static const byte exp3[WC_SM3_DIGEST_SIZE] = {
+        0x78, 0x66, 0xb3, 0x57, 0xa1, 0x80, 0x09, 0x24,
+        0x19, 0xbf, 0x76, 0x31, 0x0c, 0xe7, 0x2e, 0x9f,
+        0x87, 0xa9, 0xd2, 0x68, 0x3a, 0xf1, 0xb7, 0xad,
+        0x34, 0x3a, 0xcc, 0x4a, 0xfb, 0xf5, 0xe8, 0xe3
+    };
+    static const word32 parts[] = { 1, 3, 63, 64, 65, 128, 200 };
+    byte msg[1000];
+    byte hash[WC_SM3_DIGEST_SIZE];
+    wc_Sm3 sm3;
+    word32 i;
+    word32 j;
+    word32 sz;
+    int ret = 0;
+
+    if (wc_InitSm3(&sm3, NULL, INVALID_DEVID) != 0)
+        return SM_TEST_FAIL();
+
+    if ((wc_Sm3Update(&sm3, (const byte*)"abc", 3) != 0) ||
+            (wc_Sm3Final(&sm3, hash) != 0) ||
+            (XMEMCMP(hash, exp1, sizeof(hash)) != 0))
+        ret = SM_TEST_FAIL();
+    for (i = 0; i < 64; i += 4)
+        XMEMCPY(msg + i, "abcd", 4);
+    if ((ret == 0) && ((wc_Sm3Update(&sm3, msg, 64) != 0) ||
+            (wc_Sm3Final(&sm3, hash) != 0) ||
+            (XMEMCMP(hash, exp2, sizeof(hash)) != 0)))
+        ret = SM_TEST_FAIL();
+
+    /* Multiple blocks in one update and updates not on a block boundary. */
+    sm_test_fill(msg, sizeof(msg), 37);
+    for (j = 0; (ret == 0) && (j < sizeof(parts) / sizeof(*parts)); j++) {
+        for (i = 0; (ret == 0) && (i < sizeof(msg)); i += sz) {
+            sz = parts[j];
+            if (sz > sizeof(msg) - i)
+                sz = sizeof(msg) - i;
+            if (wc_Sm3Update(&sm3, msg + i, sz) != 0)
+                ret = SM_TEST_FAIL();
+        }
+        if ((ret == 0) && ((wc_Sm3Final(&sm3, hash) != 0) ||
+                (XMEMCMP(hash, exp3, sizeof(hash)) != 0)))
+            ret = SM_TEST_FAIL();
+    }
+    if ((ret == 0) && ((wc_Sm3Update(&sm3, msg, sizeof(msg)) != 0) ||
+            (wc_Sm3Final(&sm3, hash) != 0) ||
+            (XMEMCMP(hash, exp3, sizeof(hash)) != 0)))
+        ret = SM_TEST_FAIL();
+
+    wc_Sm3Free(&sm3);
+    return ret;
+}
+#endif
+
+#ifdef WOLFSSL_SM3
+/* Test generating blocks of KDF output against hashing Z || ct.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm3_kdf_blocks_test(void)
+{
+    /* Counters of first block - counter carries into the next byte. */
+    static const word32 cts[] = { 1, 0xfe };
+    byte z[2 * WC_SM3_BLOCK_SIZE];
+    byte out[5 * WC_SM3_DIGEST_SIZE];
+    byte exp[WC_SM3_DIGEST_SIZE];
+    byte ctBuf[4];
+    wc_Sm3 sm3;
+    wc_Sm3 ref;
+    word32 i;
+    word32 j;
+    word32 ct;
+    int ret = 0;
+
+    sm_test_fill(z, sizeof(z), 310);
+    if (wc_InitSm3(&sm3, NULL, INVALID_DEVID) != 0)
+        return SM_TEST_FAIL();
+    if (wc_InitSm3(&ref, NULL, INVALID_DEVID) != 0) {
+        wc_Sm3Free(&sm3);
+        return SM_TEST_FAIL();
+    }
+    if (wc_Sm3Update(&sm3, z, sizeof(z)) != 0)
+        ret = SM_TEST_FAIL();
+
+    /* Object's state is not changed so can be used repeatedly. */
+    for (j = 0; (ret == 0) && (j < sizeof(cts) / sizeof(*cts)); j++) {
+        if (wc_Sm3KdfBlocks(&sm3, cts[j], out, 5) != 0)
+            ret = SM_TEST_FAIL();
+        for (i = 0; (ret == 0) && (i < 5); i++) {
+            ct = cts[j] + i;
+            ctBuf[0] = (byte)(ct >> 24);
+            ctBuf[1] = (byte)(ct >> 16);
+            ctBuf[2] = (byte)(ct >>  8);
+            ctBuf[3] = (byte)(ct      );
+            if ((wc_Sm3Update(&ref, z, sizeof(z)) != 0) ||
+                    (wc_Sm3Update(&ref, ctBuf, sizeof(ctBuf)) != 0) ||
+                    (wc_Sm3Final(&ref, exp) != 0) ||
+                    (XMEMCMP(out + i * WC_SM3_DIGEST_SIZE, exp,
+                        WC_SM3_DIGEST_SIZE) != 0))
+                ret = SM_TEST_FAIL();
+        }
+    }
+
+    /* Z must be a multiple of the block size. */
+    if ((ret == 0) && ((wc_Sm3Update(&sm3, z, 1) != 0) ||
+            (wc_Sm3KdfBlocks(&sm3, 1, out, 1) != BAD_STATE_E)))
+        ret = SM_TEST_FAIL();
+
+    wc_Sm3Free(&ref);
+    wc_Sm3Free(&sm3);
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_ECB)
+/* Test SM4-ECB with numbers of blocks that use each implementation.
+ *
+ * Known answer from GB/T 32907-2016, Appendix A.1 - key and plaintext are the
+ * same.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm4_ecb_test(void)
+{
+    static const byte key[SM4_KEY_SIZE] = {
+        0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+        0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10
+    };
+    static const byte exp[SM4_BLOCK_SIZE] = {
+        0x68, 0x1e, 0xdf, 0x34, 0xd2, 0x06, 0x96, 0x5e,
+        0x86, 0xb3, 0xe9, 0x4f, 0x53, 0x6e, 0x42, 0x46
+    };
+    static const word32 blocks[] = { 1, 3, 15, 16, 17, 64, 67, 130 };
+    static byte in[130 * SM4_BLOCK_SIZE];
+    static byte out[130 * SM4_BLOCK_SIZE];
+    static byte one[SM4_BLOCK_SIZE];
+    wc_Sm4 sm4;
+    word32 i;
+    word32 j;
+    word32 sz;
+    int ret = 0;
+
+    if ((wc_Sm4Init(&sm4, NULL, INVALID_DEVID) != 0) ||
+            (wc_Sm4SetKey(&sm4, key, sizeof(key)) != 0))
+        ret = SM_TEST_FAIL();
+    /* Every block is the known answer. */
+    for (i = 0; i < sizeof(in); i += SM4_BLOCK_SIZE)
+        XMEMCPY(in + i, key, SM4_BLOCK_SIZE);
+    for (j = 0; (ret == 0) && (j < sizeof(blocks) / sizeof(*blocks)); j++) {
+        sz = blocks[j] * SM4_BLOCK_SIZE;
+        if (wc_Sm4EcbEncrypt(&sm4, out, in, sz) != 0)
+            ret = SM_TEST_FAIL();
+        for (i = 0; (ret == 0) && (i < sz); i += SM4_BLOCK_SIZE) {
+            if (XMEMCMP(out + i, exp, SM4_BLOCK_SIZE) != 0)
+                ret = SM_TEST_FAIL();
+        }
+        if ((ret == 0) && ((wc_Sm4EcbDecrypt(&sm4, out, out, sz) != 0) ||
+                (XMEMCMP(out, in, sz) != 0)))
+            ret = SM_TEST_FAIL();
+    }
+    /* Different blocks - same as a block at a time. */
+    sm_test_fill(in, sizeof(in), 41);
+    for (j = 0; (ret == 0) && (j < sizeof(blocks) / sizeof(*blocks)); j++) {
+        sz = blocks[j] * SM4_BLOCK_SIZE;
+        if (wc_Sm4EcbEncrypt(&sm4, out, in, sz) != 0)
+            ret = SM_TEST_FAIL();
+        for (i = 0; (ret == 0) && (i < sz); i += SM4_BLOCK_SIZE) {
+            if ((wc_Sm4EcbEncrypt(&sm4, one, in + i, SM4_BLOCK_SIZE) != 0) ||
+                    (XMEMCMP(out + i, one, SM4_BLOCK_SIZE) != 0))
+                ret = SM_TEST_FAIL();
+        }
+        if ((ret == 0) && ((wc_Sm4EcbDecrypt(&sm4, out, out, sz) != 0) ||
+                (XMEMCMP(out, in, sz) != 0)))
+            ret = SM_TEST_FAIL();
+    }
+
+    wc_Sm4Free(&sm4);
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_ECB) && \
+    defined(WOLFSSL_SM4_CBC) && defined(WOLFSSL_SM4_CTR)
+/* Test SM4-CBC decrypt and SM4-CTR with numbers of blocks that use each
+ * implementation against a block at a time with SM4-ECB.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm4_multi_block_test(void)
+{
+    static const byte key[SM4_KEY_SIZE] = {
+        0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+        0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10
+    };
+    /* Counter carries into upper bytes. */
+    static const byte iv[SM4_BLOCK_SIZE] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0a, 0x0b, 0x0c, 0xff, 0xff, 0xfa
+    };
+    static const word32 blocks[] = { 1, 3, 4, 5, 7, 8, 9, 15, 17, 64, 67 };
+    static byte in[67 * SM4_BLOCK_SIZE];
+    static byte out[67 * SM4_BLOCK_SIZE];
+    static byte exp[67 * SM4_BLOCK_SIZE];
+    byte ctr[SM4_BLOCK_SIZE];
+    wc_Sm4 sm4;
+    word32 i;
+    word32 j;
+    word32 k;
+    word32 sz;
+    int ret = 0;
+
+    if ((wc_Sm4Init(&sm4, NULL, INVALID_DEVID) != 0) ||
+            (wc_Sm4SetKey(&sm4, key, sizeof(key)) != 0))
+        ret = SM_TEST_FAIL();
+    sm_test_fill(in, sizeof(in), 40);
+
+    for (j = 0; (ret == 0) && (j < sizeof(blocks) / sizeof(*blocks)); j++) {
+        sz = blocks[j] * SM4_BLOCK_SIZE;
+
+        /* CBC decrypt: P[i] = D(C[i]) ^ C[i-1]. */
+        for (i = 0; (ret == 0) && (i < sz); i += SM4_BLOCK_SIZE) {
+            if (wc_Sm4EcbDecrypt(&sm4, exp + i, in + i, SM4_BLOCK_SIZE) != 0)
+                ret = SM_TEST_FAIL();
+            for (k = 0; k < SM4_BLOCK_SIZE; k++)
+                exp[i + k] ^= (i == 0) ? iv[k] : in[i - SM4_BLOCK_SIZE + k];
+        }
+        if ((ret == 0) && ((wc_Sm4SetIV(&sm4, iv) != 0) ||
+                (wc_Sm4CbcDecrypt(&sm4, out, in, sz) != 0) ||
+                (XMEMCMP(out, exp, sz) != 0)))
+            ret = SM_TEST_FAIL();
+
+        /* CTR: C[i] = P[i] ^ E(counter + i) - last block partial. */
+        XMEMCPY(ctr, iv, sizeof(ctr));
+        for (i = 0; (ret == 0) && (i < sz); i += SM4_BLOCK_SIZE) {
+            if (wc_Sm4EcbEncrypt(&sm4, exp + i, ctr, SM4_BLOCK_SIZE) != 0)
+                ret = SM_TEST_FAIL();
+            for (k = 0; k < SM4_BLOCK_SIZE; k++)
+                exp[i + k] ^= in[i + k];
+            for (k = SM4_BLOCK_SIZE; (k > 0) && (++ctr[k - 1] == 0); k--) {
+            }
+        }
+        if ((ret == 0) && ((wc_Sm4SetIV(&sm4, iv) != 0) ||
+                (wc_Sm4CtrEncrypt(&sm4, out, in, sz - 3) != 0) ||
+                (XMEMCMP(out, exp, sz - 3) != 0)))
+            ret = SM_TEST_FAIL();
+    }
+
+    wc_Sm4Free(&sm4);
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_CTR)
+/* Test seeking in the SM4-CTR key stream against encrypting from the start.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm4_ctr_seek_test(void)
+{
+    static const byte key[SM4_KEY_SIZE] = {
+        0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+        0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10
+    };
+    /* Counter carries into upper bytes within the data. */
+    static const byte iv[SM4_BLOCK_SIZE] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0a, 0x0b, 0xff, 0xff, 0xff, 0xf8
+    };
+    /* Counter 2^32 blocks on from iv. */
+    static const byte ivFar[SM4_BLOCK_SIZE] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0a, 0x0c, 0xff, 0xff, 0xff, 0xf8
+    };
+    static const word32 offset[] = { 0, 1, 15, 16, 17, 130, 500, 999 };
+    static byte in[1000];
+    static byte exp[1000];
+    static byte out[1000];
+    byte ivMax[SM4_BLOCK_SIZE];
+    byte ivZero[SM4_BLOCK_SIZE];
+    wc_Sm4 sm4;
+    word32 i;
+    word32 sz;
+    int ret = 0;
+
+    sm_test_fill(in, sizeof(in), 45);
+    if ((wc_Sm4Init(&sm4, NULL, INVALID_DEVID) != 0) ||
+            (wc_Sm4SetKey(&sm4, key, sizeof(key)) != 0) ||
+            (wc_Sm4SetIV(&sm4, iv) != 0) ||
+            (wc_Sm4CtrEncrypt(&sm4, exp, in, sizeof(in)) != 0))
+        ret = SM_TEST_FAIL();
+
+    /* Seek into the key stream and encrypt to the end. */
+    for (i = 0; (ret == 0) && (i < sizeof(offset) / sizeof(*offset)); i++) {
+        sz = sizeof(in) - offset[i];
+        if ((wc_Sm4CtrSeek(&sm4, iv, offset[i]) != 0) ||
+                (wc_Sm4CtrEncrypt(&sm4, out, in + offset[i], sz) != 0) ||
+                (XMEMCMP(out, exp + offset[i], sz) != 0))
+            ret = SM_TEST_FAIL();
+    }
+
+    /* Seek beyond 32 bits of blocks. */
+    if ((ret == 0) && ((wc_Sm4SetIV(&sm4, ivFar) != 0) ||
+            (wc_Sm4CtrEncrypt(&sm4, exp, in, 100) != 0) ||
+            (wc_Sm4CtrSeek(&sm4, iv, ((word64)1 << 36) + 5) != 0) ||
+            (wc_Sm4CtrEncrypt(&sm4, out, in + 5, 95) != 0) ||
+            (XMEMCMP(out, exp + 5, 95) != 0)))
+        ret = SM_TEST_FAIL();
+
+    /* Counter wraps around to zero. */
+    XMEMSET(ivMax, 0xff, sizeof(ivMax));
+    XMEMSET(ivZero, 0, sizeof(ivZero));
+    if ((ret == 0) && ((wc_Sm4SetIV(&sm4, ivZero) != 0) ||
+            (wc_Sm4CtrEncrypt(&sm4, exp, in, 40) != 0) ||
+            (wc_Sm4CtrSeek(&sm4, ivMax, SM4_BLOCK_SIZE + 3) != 0) ||
+            (wc_Sm4CtrEncrypt(&sm4, out, in + 3, 37) != 0) ||
+            (XMEMCMP(out, exp + 3, 37) != 0)))
+        ret = SM_TEST_FAIL();
+
+    if ((ret == 0) && (wc_Sm4CtrSeek(&sm4, NULL, 0) != BAD_FUNC_ARG))
+        ret = SM_TEST_FAIL();
+
+    wc_Sm4Free(&sm4);
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM4) && (defined(WOLFSSL_SM4_CFB) || \
+    defined(WOLFSSL_SM4_OFB))
+/* SM4 encrypt or decrypt function of a streaming mode. */
+typedef int (*SmTestSm4Fn)(wc_Sm4* sm4, byte* out, const byte* in,
+    word32 sz);
+
+/* Test an SM4 streaming mode against a known answer, in pieces and round
+ * trip.
+ *
+ * Known answer is of 64 bytes of data from sm_test_fill() with seed 49.
+ *
+ * @param [in] enc  Encrypt function of mode.
+ * @param [in] dec  Decrypt function of mode.
+ * @param [in] exp  Known answer - 64 bytes.
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm4_stream_mode_test(SmTestSm4Fn enc, SmTestSm4Fn dec,
+    const byte* exp)
+{
+    static const byte key[SM4_KEY_SIZE] = {
+        0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+        0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10
+    };
+    static const byte iv[SM4_BLOCK_SIZE] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+    };
+    static const word32 parts[] = { 1, 15, 16, 17, 64 };
+    byte in[300];
+    byte out[300];
+    byte ct[300];
+    wc_Sm4 sm4;
+    word32 i;
+    word32 j;
+    word32 len;
+    int ret = 0;
+
+    sm_test_fill(in, 64, 49);
+    if (wc_Sm4Init(&sm4, NULL, INVALID_DEVID) != 0)
+        return SM_TEST_FAIL();
+    if (wc_Sm4SetKey(&sm4, key, sizeof(key)) != 0)
+        ret = SM_TEST_FAIL();
+
+    /* Encrypt in pieces - unused key stream carried over. */
+    for (j = 0; (ret == 0) && (j < sizeof(parts) / sizeof(*parts)); j++) {
+        if (wc_Sm4SetIV(&sm4, iv) != 0)
+            ret = SM_TEST_FAIL();
+        for (i = 0; (ret == 0) && (i < 64); i += len) {
+            len = parts[j];
+            if (len > 64 - i)
+                len = 64 - i;
+            if (enc(&sm4, out + i, in + i, len) != 0)
+                ret = SM_TEST_FAIL();
+        }
+        if ((ret == 0) && (XMEMCMP(out, exp, 64) != 0))
+            ret = SM_TEST_FAIL();
+    }
+    if ((ret == 0) && ((wc_Sm4SetIV(&sm4, iv) != 0) ||
+            (dec(&sm4, out, exp, 7) != 0) ||
+            (dec(&sm4, out + 7, exp + 7, 64 - 7) != 0) ||
+            (XMEMCMP(out, in, 64) != 0)))
+        ret = SM_TEST_FAIL();
+
+    /* Round trip of many blocks - decrypted in place in two pieces. */
+    sm_test_fill(in, sizeof(in), 490);
+    if ((ret == 0) && ((wc_Sm4SetIV(&sm4, iv) != 0) ||
+            (enc(&sm4, ct, in, sizeof(in)) != 0)))
+        ret = SM_TEST_FAIL();
+    XMEMCPY(out, ct, sizeof(out));
+    if ((ret == 0) && ((wc_Sm4SetIV(&sm4, iv) != 0) ||
+            (dec(&sm4, out, out, 5) != 0) ||
+            (dec(&sm4, out + 5, out + 5, sizeof(out) - 5) != 0) ||
+            (XMEMCMP(out, in, sizeof(out)) != 0)))
+        ret = SM_TEST_FAIL();
+
+    wc_Sm4Free(&sm4);
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_CFB)
+/* Test SM4-CFB and SM4-CFB8.
+ *
+ * Known answers calculated with OpenSSL - CFB8 from SM4-ECB.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm4_cfb_test(void)
+{
+    static const byte expCfb[64] = {
+        0xf3, 0x63, 0x89, 0xc2, 0xb4, 0xed, 0x8a, 0x38,
+        0x1d, 0xc5, 0xcb, 0xfa, 0x70, 0x60, 0xbd, 0x0a,
+        0xc4, 0x7b, 0x47, 0xb7, 0x1e, 0x97, 0xa2, 0xe8,
+        0xb8, 0x15, 0xf0, 0x37, 0x2c, 0x4d, 0x6e, 0x28,
+        0xc1, 0xa1, 0x24, 0x86, 0xd1, 0x60, 0x2f, 0xf1,
+        0xaa, 0x77, 0x34, 0xa4, 0xb1, 0x64, 0xf6, 0x5f,
+        0x82, 0xa0, 0xa6, 0x24, 0xdd, 0x11, 0xec, 0xc2,
+        0x10, 0x3e, 0x38, 0xa4, 0x0b, 0xd8, 0xfa, 0x38
+    };
+    static const byte expCfb8[64] = {
+        0xf3, 0xfd, 0x1b, 0x7d, 0x5e, 0x08, 0x12, 0x60,
+        0x65, 0x24, 0x49, 0x08, 0xc9, 0xb8, 0xcc, 0x58,
+        0x73, 0xa0, 0x6b, 0x28, 0xb8, 0x1e, 0x82, 0xd8,
+        0xc6, 0x13, 0x92, 0x80, 0x56, 0x83, 0x6f, 0x50,
+        0x69, 0x2c, 0xa4, 0xe3, 0x70, 0xfa, 0x4e, 0xc6,
+        0xfb, 0xf2, 0x87, 0xd0, 0x95, 0xf6, 0x5a, 0xdc,
+        0xbd, 0x96, 0xc8, 0xa9, 0xff, 0xfe, 0xf2, 0x60,
+        0x14, 0x71, 0xf0, 0x53, 0xe3, 0x3b, 0xa3, 0x67
+    };
+    int ret;
+
+    ret = sm4_stream_mode_test(wc_Sm4CfbEncrypt, wc_Sm4CfbDecrypt, expCfb);
+    if (ret == 0) {
+        ret = sm4_stream_mode_test(wc_Sm4Cfb8Encrypt, wc_Sm4Cfb8Decrypt,
+            expCfb8);
+    }
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_OFB)
+/* Test SM4-OFB.
+ *
+ * Known answer calculated with OpenSSL.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm4_ofb_test(void)
+{
+    static const byte expOfb[64] = {
+        0xf3, 0x63, 0x89, 0xc2, 0xb4, 0xed, 0x8a, 0x38,
+        0x1d, 0xc5, 0xcb, 0xfa, 0x70, 0x60, 0xbd, 0x0a,
+        0xcd, 0x17, 0x5b, 0x45, 0x32, 0x7b, 0x17, 0xa6,
+        0xfa, 0x6d, 0xe7, 0x0a, 0x70, 0x5d, 0xec, 0xdd,
+        0xf0, 0xb0, 0x86, 0xf4, 0x55, 0x92, 0xdc, 0x91,
+        0x29, 0x4b, 0x8f, 0x82, 0xca, 0x1a, 0x6c, 0x9c,
+        0x6f, 0x67, 0x7f, 0x17, 0x2b, 0x4a, 0xba, 0x8d,
+        0xd0, 0x0b, 0x3b, 0x0b, 0x43, 0xa5, 0x94, 0x66
+    };
+
+    return sm4_stream_mode_test(wc_Sm4OfbEncrypt, wc_Sm4OfbEncrypt, expOfb);
+}
+#endif
+
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_GCM)
+/* SM4-GCM test vector from RFC 8998, Appendix A.1. */
+static const byte sm4GcmKatKey[SM4_KEY_SIZE] = {
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+    0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10
+};
+static const byte sm4GcmKatIv[GCM_NONCE_MID_SZ] = {
+    0x00, 0x00, 0x12, 0x34, 0x56, 0x78, 0x00, 0x00,
+    0x00, 0x00, 0xab, 0xcd
+};
+static const byte sm4GcmKatAad[] = {
+    0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef,
+    0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef,
+    0xab, 0xad, 0xda, 0xd2
+};
+static const byte sm4GcmKatPt[] = {
+    0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa,
+    0xbb, 0xbb, 0xbb, 0xbb, 0xbb, 0xbb, 0xbb, 0xbb,
+    0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc, 0xcc,
+    0xdd, 0xdd, 0xdd, 0xdd, 0xdd, 0xdd, 0xdd, 0xdd,
+    0xee, 0xee, 0xee, 0xee, 0xee, 0xee, 0xee, 0xee,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xee, 0xee, 0xee, 0xee, 0xee, 0xee, 0xee, 0xee,
+    0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa
+};
+static const byte sm4GcmKatCt[] = {
+    0x17, 0xf3, 0x99, 0xf0, 0x8c, 0x67, 0xd5, 0xee,
+    0x19, 0xd0, 0xdc, 0x99, 0x69, 0xc4, 0xbb, 0x7d,
+    0x5f, 0xd4, 0x6f, 0xd3, 0x75, 0x64, 0x89, 0x06,
+    0x91, 0x57, 0xb2, 0x82, 0xbb, 0x20, 0x07, 0x35,
+    0xd8, 0x27, 0x10, 0xca, 0x5c, 0x22, 0xf0, 0xcc,
+    0xfa, 0x7c, 0xbf, 0x93, 0xd4, 0x96, 0xac, 0x15,
+    0xa5, 0x68, 0x34, 0xcb, 0xcf, 0x98, 0xc3, 0x97,
+    0xb4, 0x02, 0x4a, 0x26, 0x91, 0x23, 0x3b, 0x8d
+};
+static const byte sm4GcmKatTag[SM4_BLOCK_SIZE] = {
+    0x83, 0xde, 0x35, 0x41, 0xe4, 0xc2, 0xb5, 0x81,
+    0x77, 0xe0, 0x65, 0xa9, 0xbf, 0x7b, 0x62, 0xec
+};
+#ifdef WOLFSSL_SM4_SHARED_KEY
+/* Key that is replaced by the known answer test key. */
+static const byte sm4KeyOther[SM4_KEY_SIZE] = {
+    0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10,
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef
+};
+#endif
+#endif
+
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_GCM)
+/* Test GHASH with data of many blocks and SM4-GMAC against known answers.
+ *
+ * Known answers calculated independently with SM4-ECB and a bit-wise GHASH.
+ * Key and nonce are from the RFC 8998 test vector.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm4_gmac_test(void)
+{
+    /* GMAC of 300 bytes of data from sm_test_fill() with seed 47. */
+    static const byte expGmac[SM4_BLOCK_SIZE] = {
+        0xca, 0x16, 0x7d, 0x87, 0xd7, 0xda, 0xe5, 0xde,
+        0xad, 0xca, 0x1f, 0xed, 0xcb, 0xfb, 0xb4, 0x1c
+    };
+    /* GCM tag of 300 bytes of plain text (seed 472) with 200 bytes of AAD
+     * (seed 471). */
+    static const byte expTag[SM4_BLOCK_SIZE] = {
+        0x1b, 0xe4, 0x81, 0x7d, 0x55, 0xcd, 0x71, 0xee,
+        0x90, 0x96, 0x6e, 0xf5, 0xf3, 0x50, 0x91, 0x19
+    };
+    byte aad[300];
+    byte in[300];
+    byte out[300];
+    byte tag[SM4_BLOCK_SIZE];
+    wc_Sm4 sm4;
+    int ret = 0;
+
+    if (wc_Sm4Init(&sm4, NULL, INVALID_DEVID) != 0)
+        return SM_TEST_FAIL();
+    if (wc_Sm4GcmSetKey(&sm4, sm4GcmKatKey, SM4_KEY_SIZE) != 0)
+        ret = SM_TEST_FAIL();
+
+    sm_test_fill(aad, sizeof(aad), 47);
+    if ((ret == 0) && ((wc_Sm4Gmac(&sm4, sm4GcmKatIv, sizeof(sm4GcmKatIv),
+            aad, sizeof(aad), tag, sizeof(tag)) != 0) ||
+            (XMEMCMP(tag, expGmac, sizeof(tag)) != 0)))
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && (wc_Sm4GmacVerify(&sm4, sm4GcmKatIv,
+            sizeof(sm4GcmKatIv), aad, sizeof(aad), expGmac,
+            sizeof(expGmac)) != 0))
+        ret = SM_TEST_FAIL();
+    /* Same as GCM with no plain text. */
+    if ((ret == 0) && ((wc_Sm4GcmEncrypt(&sm4, out, in, 0, sm4GcmKatIv,
+            sizeof(sm4GcmKatIv), tag, sizeof(tag), aad, sizeof(aad)) != 0) ||
+            (XMEMCMP(tag, expGmac, sizeof(tag)) != 0)))
+        ret = SM_TEST_FAIL();
+    if (ret == 0) {
+        aad[sizeof(aad) - 1] ^= 0x01;
+        if (wc_Sm4GmacVerify(&sm4, sm4GcmKatIv, sizeof(sm4GcmKatIv), aad,
+                sizeof(aad), expGmac, sizeof(expGmac)) != SM4_GCM_AUTH_E)
+            ret = SM_TEST_FAIL();
+    }
+
+    /* AAD and cipher text of many blocks, not a multiple of a block. */
+    sm_test_fill(aad, 200, 471);
+    sm_test_fill(in, sizeof(in), 472);
+    if ((ret == 0) && ((wc_Sm4GcmEncrypt(&sm4, out, in, sizeof(in),
+            sm4GcmKatIv, sizeof(sm4GcmKatIv), tag, sizeof(tag), aad,
+            200) != 0) ||
+            (XMEMCMP(tag, expTag, sizeof(tag)) != 0)))
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && ((wc_Sm4GcmDecrypt(&sm4, out, out, sizeof(out),
+            sm4GcmKatIv, sizeof(sm4GcmKatIv), tag, sizeof(tag), aad,
+            200) != 0) ||
+            (XMEMCMP(out, in, sizeof(out)) != 0)))
+        ret = SM_TEST_FAIL();
+
+    wc_Sm4Free(&sm4);
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_CMAC)
+/* Number of messages in SM4-CMAC test. */
+#define SM4_CMAC_CNT    4
+
+/* Test SM4-CMAC against known answers - one-shot, streaming and burst.
+ *
+ * Known answers calculated with OpenSSL's CMAC and SM4-CBC. Messages are the
+ * start of 64 bytes of data from sm_test_fill() with seed 48.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm4_cmac_test(void)
+{
+    static const byte key[SM4_KEY_SIZE] = {
+        0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+        0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10
+    };
+    /* Empty, one block, partial last block and whole last block. */
+    static const word32 sz[SM4_CMAC_CNT] = { 0, 16, 20, 64 };
+    static const byte exp[SM4_CMAC_CNT][SM4_BLOCK_SIZE] = {
+        {
+            0x29, 0xe1, 0x54, 0x32, 0x2e, 0x5c, 0x7b, 0xd8,
+            0xee, 0x6a, 0x25, 0xba, 0x54, 0x9b, 0x24, 0xbc
+        },
+        {
+            0x5a, 0xea, 0x94, 0x75, 0xef, 0x0e, 0xbe, 0xc0,
+            0x6c, 0xeb, 0xe1, 0x22, 0xcd, 0x65, 0x94, 0x37
+        },
+        {
+            0x51, 0x2b, 0xf2, 0xdb, 0x07, 0x06, 0x5a, 0x88,
+            0x53, 0x79, 0x5b, 0xb2, 0x3e, 0xdf, 0x6c, 0x59
+        },
+        {
+            0xc5, 0xd2, 0xf6, 0x9a, 0xfb, 0x23, 0xd8, 0x2a,
+            0xa4, 0xfe, 0x47, 0x04, 0x91, 0xd5, 0x57, 0x14
+        }
+    };
+    static const word32 parts[] = { 1, 15, 16, 17, 64 };
+    byte msg[64];
+    byte tag[SM4_CMAC_CNT][SM4_BLOCK_SIZE];
+    wc_Sm4Cmac cmac;
+    wc_Sm4CmacPacket pkt[SM4_CMAC_CNT];
+    word32 i;
+    word32 j;
+    word32 len;
+    int ret = 0;
+
+    sm_test_fill(msg, sizeof(msg), 48);
+    if (wc_Sm4CmacInit(&cmac, NULL, INVALID_DEVID) != 0)
+        return SM_TEST_FAIL();
+    if (wc_Sm4CmacSetKey(&cmac, key, sizeof(key)) != 0)
+        ret = SM_TEST_FAIL();
+
+    for (i = 0; (ret == 0) && (i < SM4_CMAC_CNT); i++) {
+        if ((wc_Sm4CmacUpdate(&cmac, msg, sz[i]) != 0) ||
+                (wc_Sm4CmacFinal(&cmac, tag[i], SM4_BLOCK_SIZE) != 0) ||
+                (XMEMCMP(tag[i], exp[i], SM4_BLOCK_SIZE) != 0))
+            ret = SM_TEST_FAIL();
+    }
+
+    /* Message passed in pieces. */
+    for (j = 0; (ret == 0) && (j < sizeof(parts) / sizeof(*parts)); j++) {
+        for (i = 0; (ret == 0) && (i < sizeof(msg)); i += len) {
+            len = parts[j];
+            if (len > sizeof(msg) - i)
+                len = sizeof(msg) - i;
+            if (wc_Sm4CmacUpdate(&cmac, msg + i, len) != 0)
+                ret = SM_TEST_FAIL();
+        }
+        if ((ret == 0) && ((wc_Sm4CmacFinal(&cmac, tag[0],
+                SM4_BLOCK_SIZE) != 0) ||
+                (XMEMCMP(tag[0], exp[SM4_CMAC_CNT - 1], SM4_BLOCK_SIZE) != 0)))
+            ret = SM_TEST_FAIL();
+    }
+
+    /* Verify full and truncated tags. */
+    if ((ret == 0) && ((wc_Sm4CmacUpdate(&cmac, msg, sz[2]) != 0) ||
+            (wc_Sm4CmacVerify(&cmac, exp[2], SM4_BLOCK_SIZE) != 0)))
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && ((wc_Sm4CmacUpdate(&cmac, msg, sz[2]) != 0) ||
+            (wc_Sm4CmacVerify(&cmac, exp[2], SM4_CMAC_TAG_MIN_SZ) != 0)))
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && ((wc_Sm4CmacUpdate(&cmac, msg, sz[1]) != 0) ||
+            (wc_Sm4CmacVerify(&cmac, exp[2], SM4_BLOCK_SIZE) !=
+                MAC_CMP_FAILED_E)))
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && (wc_Sm4CmacFinal(&cmac, tag[0],
+            SM4_CMAC_TAG_MIN_SZ - 1) != BAD_FUNC_ARG))
+        ret = SM_TEST_FAIL();
+
+    /* Burst of messages with the same key. */
+    XMEMSET(tag, 0, sizeof(tag));
+    for (i = 0; i < SM4_CMAC_CNT; i++) {
+        pkt[i].cmac = &cmac;
+        pkt[i].in = msg;
+        pkt[i].sz = sz[i];
+        pkt[i].tag = tag[i];
+        pkt[i].tagSz = SM4_BLOCK_SIZE;
+        pkt[i].ret = -1;
+    }
+    if ((ret == 0) && (wc_Sm4CmacBurst(pkt, SM4_CMAC_CNT) != 0))
+        ret = SM_TEST_FAIL();
+    for (i = 0; (ret == 0) && (i < SM4_CMAC_CNT); i++) {
+        if ((pkt[i].ret != 0) ||
+                (XMEMCMP(tag[i], exp[i], SM4_BLOCK_SIZE) != 0))
+            ret = SM_TEST_FAIL();
+    }
+
+    wc_Sm4CmacFree(&cmac);
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_GCM) && \
+    defined(WOLFSSL_SM4_SHARED_KEY)
+/* Test SM4-GCM with a key set in the object and a shared key.
+ *
+ * Key set repeatedly to check key data is released.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm4_shared_key_test(void)
+{
+    wc_Sm4 sm4[3];
+    wc_Sm4Key* key = NULL;
+    byte out[sizeof(sm4GcmKatPt)];
+    byte tag[SM4_BLOCK_SIZE];
+    int i;
+    int ret = 0;
+
+    for (i = 0; i < 3; i++) {
+        if (wc_Sm4Init(&sm4[i], NULL, INVALID_DEVID) != 0)
+            ret = SM_TEST_FAIL();
+    }
+    /* Set key twice - first key data released. */
+    if ((ret == 0) && ((wc_Sm4GcmSetKey(&sm4[0], sm4KeyOther,
+            SM4_KEY_SIZE) != 0) || (wc_Sm4GcmSetKey(&sm4[0], sm4GcmKatKey,
+            SM4_KEY_SIZE) != 0)))
+        ret = SM_TEST_FAIL();
+    if (ret == 0) {
+        key = wc_Sm4KeyNew(sm4GcmKatKey, SM4_KEY_SIZE, NULL, &ret);
+        if ((key == NULL) || (ret != 0))
+            ret = SM_TEST_FAIL();
+    }
+    /* Own key replaced by shared key in one, shared by two objects. */
+    if ((ret == 0) && ((wc_Sm4GcmSetKey(&sm4[1], sm4KeyOther,
+            SM4_KEY_SIZE) != 0) || (wc_Sm4SetSharedKey(&sm4[1], key) != 0) ||
+            (wc_Sm4SetSharedKey(&sm4[2], key) != 0)))
+        ret = SM_TEST_FAIL();
+    /* Creator's reference released - objects keep key data. */
+    wc_Sm4KeyFree(key);
+
+    for (i = 0; (ret == 0) && (i < 3); i++) {
+        if ((wc_Sm4GcmEncrypt(&sm4[i], out, sm4GcmKatPt, sizeof(sm4GcmKatPt),
+                sm4GcmKatIv, sizeof(sm4GcmKatIv), tag, sizeof(tag),
+                sm4GcmKatAad, sizeof(sm4GcmKatAad)) != 0) ||
+                (XMEMCMP(out, sm4GcmKatCt, sizeof(out)) != 0) ||
+                (XMEMCMP(tag, sm4GcmKatTag, sizeof(tag)) != 0))
+            ret = SM_TEST_FAIL();
+        if ((ret == 0) && ((wc_Sm4GcmDecrypt(&sm4[2 - i], out, out,
+                sizeof(out), sm4GcmKatIv, sizeof(sm4GcmKatIv), tag,
+                sizeof(tag), sm4GcmKatAad, sizeof(sm4GcmKatAad)) != 0) ||
+                (XMEMCMP(out, sm4GcmKatPt, sizeof(out)) != 0)))
+            ret = SM_TEST_FAIL();
+    }
+
+    for (i = 0; i < 3; i++) {
+        wc_Sm4Free(&sm4[i]);
+    }
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM4) && (defined(WOLFSSL_SM4_GCM) || \
+    defined(WOLFSSL_SM4_ECB))
+/* Number of packets or blocks in burst tests. */
+#define SM4_BURST_CNT   6
+#endif
+
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_GCM)
+/* Test SM4-GCM bursts with different keys against a packet at a time.
+ *
+ * First packet is the known answer. Others have sizes that fill bursts
+ * differently.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm4_gcm_burst_test(void)
+{
+    static const word32 sz[SM4_BURST_CNT] = {
+        sizeof(sm4GcmKatPt), 0, 1, 63, 300, 16
+    };
+    static byte in[SM4_BURST_CNT][300];
+    static byte out[SM4_BURST_CNT][300];
+    static byte exp[SM4_BURST_CNT][300];
+    byte key[SM4_KEY_SIZE];
+    byte nonce[SM4_BURST_CNT][GCM_NONCE_MID_SZ];
+    byte aad[SM4_BURST_CNT][20];
+    byte tag[SM4_BURST_CNT][SM4_BLOCK_SIZE];
+    byte expTag[SM4_BURST_CNT][SM4_BLOCK_SIZE];
+    wc_Sm4 sm4[SM4_BURST_CNT];
+    wc_Sm4GcmPacket pkt[SM4_BURST_CNT];
+    word32 i;
+    int ret = 0;
+
+    for (i = 0; i < SM4_BURST_CNT; i++) {
+        if (wc_Sm4Init(&sm4[i], NULL, INVALID_DEVID) != 0)
+            ret = SM_TEST_FAIL();
+    }
+    for (i = 0; (ret == 0) && (i < SM4_BURST_CNT); i++) {
+        if (i == 0) {
+            XMEMCPY(key, sm4GcmKatKey, sizeof(key));
+            XMEMCPY(nonce[i], sm4GcmKatIv, sizeof(nonce[i]));
+            XMEMCPY(aad[i], sm4GcmKatAad, sizeof(aad[i]));
+            XMEMCPY(in[i], sm4GcmKatPt, sizeof(sm4GcmKatPt));
+        }
+        else {
+            sm_test_fill(key, sizeof(key), 430 + i);
+            sm_test_fill(nonce[i], sizeof(nonce[i]), 440 + i);
+            sm_test_fill(aad[i], sizeof(aad[i]), 450 + i);
+            sm_test_fill(in[i], sz[i], 460 + i);
+        }
+        if ((wc_Sm4GcmSetKey(&sm4[i], key, sizeof(key)) != 0) ||
+                (wc_Sm4GcmEncrypt(&sm4[i], exp[i], in[i], sz[i], nonce[i],
+                    sizeof(nonce[i]), expTag[i], sizeof(expTag[i]), aad[i],
+                    sizeof(aad[i])) != 0))
+            ret = SM_TEST_FAIL();
+
+        XMEMSET(&pkt[i], 0, sizeof(pkt[i]));
+        pkt[i].sm4 = &sm4[i];
+        pkt[i].nonce = nonce[i];
+        pkt[i].nonceSz = sizeof(nonce[i]);
+        pkt[i].aad = aad[i];
+        pkt[i].aadSz = sizeof(aad[i]);
+        pkt[i].in = in[i];
+        pkt[i].out = out[i];
+        pkt[i].sz = sz[i];
+        pkt[i].tag = tag[i];
+        pkt[i].tagSz = sizeof(tag[i]);
+    }
+    if ((ret == 0) && ((XMEMCMP(exp[0], sm4GcmKatCt,
+            sizeof(sm4GcmKatCt)) != 0) ||
+            (XMEMCMP(expTag[0], sm4GcmKatTag, sizeof(sm4GcmKatTag)) != 0)))
+        ret = SM_TEST_FAIL();
+
+    if ((ret == 0) && (wc_Sm4GcmEncryptBurst(pkt, SM4_BURST_CNT) != 0))
+        ret = SM_TEST_FAIL();
+    for (i = 0; (ret == 0) && (i < SM4_BURST_CNT); i++) {
+        if ((pkt[i].ret != 0) || (XMEMCMP(out[i], exp[i], sz[i]) != 0) ||
+                (XMEMCMP(tag[i], expTag[i], sizeof(tag[i])) != 0))
+            ret = SM_TEST_FAIL();
+    }
+
+    /* Round trip - decrypt cipher text. */
+    for (i = 0; i < SM4_BURST_CNT; i++) {
+        pkt[i].in = exp[i];
+    }
+    if ((ret == 0) && (wc_Sm4GcmDecryptBurst(pkt, SM4_BURST_CNT) != 0))
+        ret = SM_TEST_FAIL();
+    for (i = 0; (ret == 0) && (i < SM4_BURST_CNT); i++) {
+        if ((pkt[i].ret != 0) || (XMEMCMP(out[i], in[i], sz[i]) != 0))
+            ret = SM_TEST_FAIL();
+    }
+
+    /* Modified tag fails only its packet. */
+    if (ret == 0) {
+        tag[3][0] ^= 0x01;
+        if (wc_Sm4GcmDecryptBurst(pkt, SM4_BURST_CNT) != SM4_GCM_AUTH_E)
+            ret = SM_TEST_FAIL();
+    }
+    for (i = 0; (ret == 0) && (i < SM4_BURST_CNT); i++) {
+        if (pkt[i].ret != ((i == 3) ? SM4_GCM_AUTH_E : 0))
+            ret = SM_TEST_FAIL();
+    }
+
+    for (i = 0; i < SM4_BURST_CNT; i++) {
+        wc_Sm4Free(&sm4[i]);
+    }
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_ECB)
+/* Test SM4-ECB burst with a key per block against a block at a time.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm4_ecb_burst_test(void)
+{
+    byte key[SM4_KEY_SIZE];
+    byte in[SM4_BURST_CNT * SM4_BLOCK_SIZE];
+    byte out[SM4_BURST_CNT * SM4_BLOCK_SIZE];
+    byte exp[SM4_BLOCK_SIZE];
+    wc_Sm4 sm4[SM4_BURST_CNT];
+    wc_Sm4* p[SM4_BURST_CNT];
+    word32 i;
+    int ret = 0;
+
+    sm_test_fill(in, sizeof(in), 43);
+    for (i = 0; i < SM4_BURST_CNT; i++) {
+        p[i] = &sm4[i];
+        sm_test_fill(key, sizeof(key), 470 + i);
+        if ((wc_Sm4Init(&sm4[i], NULL, INVALID_DEVID) != 0) ||
+                (wc_Sm4SetKey(&sm4[i], key, sizeof(key)) != 0))
+            ret = SM_TEST_FAIL();
+    }
+
+    if ((ret == 0) && (wc_Sm4EcbEncryptBurst(p, out, in,
+            SM4_BURST_CNT) != 0))
+        ret = SM_TEST_FAIL();
+    for (i = 0; (ret == 0) && (i < SM4_BURST_CNT); i++) {
+        if ((wc_Sm4EcbEncrypt(&sm4[i], exp, in + i * SM4_BLOCK_SIZE,
+                SM4_BLOCK_SIZE) != 0) ||
+                (XMEMCMP(out + i * SM4_BLOCK_SIZE, exp, SM4_BLOCK_SIZE) != 0))
+            ret = SM_TEST_FAIL();
+    }
+
+    /* Object without a key. */
+    if (ret == 0) {
+        wc_Sm4Free(&sm4[2]);
+        if ((wc_Sm4Init(&sm4[2], NULL, INVALID_DEVID) != 0) ||
+                (wc_Sm4EcbEncryptBurst(p, out, in, SM4_BURST_CNT) !=
+                    MISSING_KEY))
+            ret = SM_TEST_FAIL();
+    }
+
+    for (i = 0; i < SM4_BURST_CNT; i++) {
+        wc_Sm4Free(&sm4[i]);
+    }
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM_IOV) && (defined(WOLFSSL_SM3) || \
+    defined(WOLFSSL_SM4))
+/* Number of buffers in scatter/gather tests. */
+#define SM_IOV_CNT      6
+
+/* Split a buffer into a list of buffers - last buffer has the rest.
+ *
+ * @param [out] iov  List of buffers.
+ * @param [in]  buf  Buffer to split.
+ * @param [in]  sz   Length of buffer in bytes.
+ * @param [in]  len  Lengths of all but the last buffer in the list.
+ */
+static void sm_test_iov(wc_SmIov* iov, byte* buf, word32 sz,
+    const word32* len)
+{
+    word32 i;
+
+    for (i = 0; i < SM_IOV_CNT - 1; i++) {
+        iov[i].buf = buf;
+        iov[i].len = len[i];
+        buf += len[i];
+        sz -= len[i];
+    }
+    iov[i].buf = buf;
+    iov[i].len = sz;
+}
+
+/* Lengths of buffers - empty, less than a block and crossing blocks. */
+static const word32 smIovInLen[SM_IOV_CNT - 1] = { 0, 5, 16, 43, 0 };
+static const word32 smIovOutLen[SM_IOV_CNT - 1] = { 17, 1, 0, 100, 30 };
+#endif
+
+#if defined(WOLFSSL_SM_IOV) && defined(WOLFSSL_SM3)
+/* Test SM3 update with a list of buffers against one buffer.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm3_iov_test(void)
+{
+    byte msg[300];
+    byte hash[WC_SM3_DIGEST_SIZE];
+    byte exp[WC_SM3_DIGEST_SIZE];
+    wc_SmIov iov[SM_IOV_CNT];
+    wc_Sm3 sm3;
+    int ret = 0;
+
+    sm_test_fill(msg, sizeof(msg), 46);
+    sm_test_iov(iov, msg, sizeof(msg), smIovInLen);
+
+    if (wc_InitSm3(&sm3, NULL, INVALID_DEVID) != 0)
+        return SM_TEST_FAIL();
+    if ((wc_Sm3Update(&sm3, msg, sizeof(msg)) != 0) ||
+            (wc_Sm3Final(&sm3, exp) != 0))
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && ((wc_Sm3UpdateIov(&sm3, iov, SM_IOV_CNT) != 0) ||
+            (wc_Sm3Final(&sm3, hash) != 0) ||
+            (XMEMCMP(hash, exp, sizeof(hash)) != 0)))
+        ret = SM_TEST_FAIL();
+    /* Data already buffered before the list. */
+    if (ret == 0) {
+        iov[1].buf += 3;
+        iov[1].len -= 3;
+        if ((wc_Sm3Update(&sm3, msg, 3) != 0) ||
+                (wc_Sm3UpdateIov(&sm3, iov, SM_IOV_CNT) != 0) ||
+                (wc_Sm3Final(&sm3, hash) != 0) ||
+                (XMEMCMP(hash, exp, sizeof(hash)) != 0))
+            ret = SM_TEST_FAIL();
+    }
+
+    wc_Sm3Free(&sm3);
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM_IOV) && defined(WOLFSSL_SM4)
+/* Test SM4 scatter/gather APIs against one buffer.
+ *
+ * Input and output lists are split at different places.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm4_iov_test(void)
+{
+    static const byte key[SM4_KEY_SIZE] = {
+        0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+        0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10
+    };
+    static const byte iv[SM4_BLOCK_SIZE] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+    };
+    static const byte aad[] = {
+        0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef
+    };
+    byte in[300];
+    byte out[300];
+    byte exp[300];
+    wc_SmIov inIov[SM_IOV_CNT];
+    wc_SmIov outIov[SM_IOV_CNT];
+#if defined(WOLFSSL_SM4_GCM) || defined(WOLFSSL_SM4_CCM)
+    byte tag[SM4_BLOCK_SIZE];
+    byte expTag[SM4_BLOCK_SIZE];
+#endif
+    wc_Sm4 sm4;
+    int ret = 0;
+
+    sm_test_fill(in, sizeof(in), 46);
+    (void)aad;
+
+    if (wc_Sm4Init(&sm4, NULL, INVALID_DEVID) != 0)
+        return SM_TEST_FAIL();
+    if (wc_Sm4SetKey(&sm4, key, sizeof(key)) != 0)
+        ret = SM_TEST_FAIL();
+
+#ifdef WOLFSSL_SM4_CBC
+    /* Whole blocks only. */
+    sm_test_iov(inIov, in, 18 * SM4_BLOCK_SIZE, smIovInLen);
+    sm_test_iov(outIov, out, 18 * SM4_BLOCK_SIZE, smIovOutLen);
+    if ((ret == 0) && ((wc_Sm4SetIV(&sm4, iv) != 0) ||
+            (wc_Sm4CbcEncrypt(&sm4, exp, in, 18 * SM4_BLOCK_SIZE) != 0) ||
+            (wc_Sm4SetIV(&sm4, iv) != 0) ||
+            (wc_Sm4CbcEncryptIov(&sm4, outIov, SM_IOV_CNT, inIov,
+                SM_IOV_CNT) != 0) ||
+            (XMEMCMP(out, exp, 18 * SM4_BLOCK_SIZE) != 0)))
+        ret = SM_TEST_FAIL();
+    sm_test_iov(inIov, exp, 18 * SM4_BLOCK_SIZE, smIovInLen);
+    if ((ret == 0) && ((wc_Sm4SetIV(&sm4, iv) != 0) ||
+            (wc_Sm4CbcDecryptIov(&sm4, outIov, SM_IOV_CNT, inIov,
+                SM_IOV_CNT) != 0) ||
+            (XMEMCMP(out, in, 18 * SM4_BLOCK_SIZE) != 0)))
+        ret = SM_TEST_FAIL();
+#endif
+
+    sm_test_iov(inIov, in, sizeof(in), smIovInLen);
+    sm_test_iov(outIov, out, sizeof(out), smIovOutLen);
+#ifdef WOLFSSL_SM4_CTR
+    if ((ret == 0) && ((wc_Sm4SetIV(&sm4, iv) != 0) ||
+            (wc_Sm4CtrEncrypt(&sm4, exp, in, sizeof(in)) != 0) ||
+            (wc_Sm4SetIV(&sm4, iv) != 0) ||
+            (wc_Sm4CtrEncryptIov(&sm4, outIov, SM_IOV_CNT, inIov,
+                SM_IOV_CNT) != 0) ||
+            (XMEMCMP(out, exp, sizeof(out)) != 0)))
+        ret = SM_TEST_FAIL();
+#endif
+#ifdef WOLFSSL_SM4_GCM
+    if ((ret == 0) && ((wc_Sm4GcmSetKey(&sm4, key, sizeof(key)) != 0) ||
+            (wc_Sm4GcmEncrypt(&sm4, exp, in, sizeof(in), iv,
+                GCM_NONCE_MID_SZ, expTag, sizeof(expTag), aad,
+                sizeof(aad)) != 0) ||
+            (wc_Sm4GcmEncryptIov(&sm4, outIov, SM_IOV_CNT, inIov, SM_IOV_CNT,
+                iv, GCM_NONCE_MID_SZ, tag, sizeof(tag), aad,
+                sizeof(aad)) != 0) ||
+            (XMEMCMP(out, exp, sizeof(out)) != 0) ||
+            (XMEMCMP(tag, expTag, sizeof(tag)) != 0)))
+        ret = SM_TEST_FAIL();
+    sm_test_iov(inIov, exp, sizeof(exp), smIovInLen);
+    if ((ret == 0) && ((wc_Sm4GcmDecryptIov(&sm4, outIov, SM_IOV_CNT, inIov,
+            SM_IOV_CNT, iv, GCM_NONCE_MID_SZ, tag, sizeof(tag), aad,
+            sizeof(aad)) != 0) ||
+            (XMEMCMP(out, in, sizeof(out)) != 0)))
+        ret = SM_TEST_FAIL();
+    if (ret == 0) {
+        tag[0] ^= 0x01;
+        if (wc_Sm4GcmDecryptIov(&sm4, outIov, SM_IOV_CNT, inIov, SM_IOV_CNT,
+                iv, GCM_NONCE_MID_SZ, tag, sizeof(tag), aad,
+                sizeof(aad)) != SM4_GCM_AUTH_E)
+            ret = SM_TEST_FAIL();
+    }
+    sm_test_iov(inIov, in, sizeof(in), smIovInLen);
+#endif
+#ifdef WOLFSSL_SM4_CCM
+    if ((ret == 0) && ((wc_Sm4SetKey(&sm4, key, sizeof(key)) != 0) ||
+            (wc_Sm4CcmEncrypt(&sm4, exp, in, sizeof(in), iv, 12, expTag,
+                sizeof(expTag), aad, sizeof(aad)) != 0) ||
+            (wc_Sm4CcmEncryptIov(&sm4, outIov, SM_IOV_CNT, inIov, SM_IOV_CNT,
+                iv, 12, tag, sizeof(tag), aad, sizeof(aad)) != 0) ||
+            (XMEMCMP(out, exp, sizeof(out)) != 0) ||
+            (XMEMCMP(tag, expTag, sizeof(tag)) != 0)))
+        ret = SM_TEST_FAIL();
+    sm_test_iov(inIov, exp, sizeof(exp), smIovInLen);
+    if ((ret == 0) && ((wc_Sm4CcmDecryptIov(&sm4, outIov, SM_IOV_CNT, inIov,
+            SM_IOV_CNT, iv, 12, tag, sizeof(tag), aad, sizeof(aad)) != 0) ||
+            (XMEMCMP(out, in, sizeof(out)) != 0)))
+        ret = SM_TEST_FAIL();
+#endif
+
+    /* Output shorter than input. */
+#ifdef WOLFSSL_SM4_CTR
+    if (ret == 0) {
+        outIov[SM_IOV_CNT - 1].len--;
+        if (wc_Sm4CtrEncryptIov(&sm4, outIov, SM_IOV_CNT, inIov,
+                SM_IOV_CNT) != BUFFER_E)
+            ret = SM_TEST_FAIL();
+    }
+#endif
+
+    wc_Sm4Free(&sm4);
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_THREADS) && \
+    (defined(WOLFSSL_SM4_CTR) || defined(WOLFSSL_SM4_GCM))
+/* Sizes that don't split evenly into blocks or threads. Small sizes are
+ * split when built with a small WOLFSSL_SM4_THREADS_MIN. */
+static const word32 sm4ParSz[] = {
+    6 * SM4_BLOCK_SIZE,
+    16 * SM4_BLOCK_SIZE + 5,
+    2 * WOLFSSL_SM4_THREADS_MIN,
+    2 * WOLFSSL_SM4_THREADS_MIN + 3 * SM4_BLOCK_SIZE + 5,
+    5 * WOLFSSL_SM4_THREADS_MIN + 3 * SM4_BLOCK_SIZE,
+    7 * WOLFSSL_SM4_THREADS_MIN - 1,
+};
+/* Thread counts including more than there are minimum sized parts. */
+static const int sm4ParThreads[] = { 1, 2, 3, 5, 7, 64 };
+/* Largest size of data tested. */
+#define SM4_PAR_MAX     (7 * WOLFSSL_SM4_THREADS_MIN + 16 * SM4_BLOCK_SIZE)
+
+/* Key of parallel tests. */
+static const byte sm4ParKey[SM4_KEY_SIZE] = {
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+    0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10
+};
+/* Buffers of parallel tests. */
+static byte sm4ParIn[SM4_PAR_MAX];
+static byte sm4ParOut[SM4_PAR_MAX];
+static byte sm4ParExp[SM4_PAR_MAX];
+#endif
+
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_THREADS) && \
+    defined(WOLFSSL_SM4_CTR)
+/* Test multi-threaded SM4-CTR against single threaded.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm4_ctr_parallel_test(void)
+{
+    /* Counter wraps into the upper bytes part way through. */
+    static const byte iv[SM4_BLOCK_SIZE] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+        0x08, 0x09, 0x0a, 0x0b, 0x0c, 0xff, 0xff, 0xf0
+    };
+    wc_Sm4 sm4;
+    wc_Sm4 ref;
+    word32 i;
+    word32 j;
+    int ret = 0;
+
+    sm_test_fill(sm4ParIn, sizeof(sm4ParIn), 44);
+
+    if (wc_Sm4Init(&sm4, NULL, INVALID_DEVID) != 0)
+        return SM_TEST_FAIL();
+    if (wc_Sm4Init(&ref, NULL, INVALID_DEVID) != 0)
+        return SM_TEST_FAIL();
+
+    for (i = 0; (ret == 0) && (i < sizeof(sm4ParSz) / sizeof(*sm4ParSz));
+            i++) {
+        word32 sz = sm4ParSz[i];
+
+        for (j = 0; (ret == 0) &&
+                (j < sizeof(sm4ParThreads) / sizeof(*sm4ParThreads)); j++) {
+            if ((wc_Sm4SetKey(&ref, sm4ParKey, SM4_KEY_SIZE) != 0) ||
+                    (wc_Sm4SetIV(&ref, iv) != 0) ||
+                    (wc_Sm4CtrEncrypt(&ref, sm4ParExp, sm4ParIn, sz) != 0))
+                ret = SM_TEST_FAIL();
+            /* Start part way into a block to use up the unused bytes. */
+            if ((ret == 0) && ((wc_Sm4SetKey(&sm4, sm4ParKey,
+                    SM4_KEY_SIZE) != 0) ||
+                    (wc_Sm4SetIV(&sm4, iv) != 0) ||
+                    (wc_Sm4CtrEncrypt(&sm4, sm4ParOut, sm4ParIn, 7) != 0) ||
+                    (wc_Sm4CtrEncryptParallel(&sm4, sm4ParOut + 7,
+                        sm4ParIn + 7, sz - 7, sm4ParThreads[j]) != 0)))
+                ret = SM_TEST_FAIL();
+            if ((ret == 0) && (XMEMCMP(sm4ParOut, sm4ParExp, sz) != 0))
+                ret = SM_TEST_FAIL();
+            /* Counter state continues on from the parallel operation. */
+            if ((ret == 0) && ((wc_Sm4CtrEncrypt(&ref, sm4ParExp, sm4ParIn,
+                    SM4_BLOCK_SIZE + 1) != 0) ||
+                    (wc_Sm4CtrEncrypt(&sm4, sm4ParOut, sm4ParIn,
+                        SM4_BLOCK_SIZE + 1) != 0) ||
+                    (XMEMCMP(sm4ParOut, sm4ParExp, SM4_BLOCK_SIZE + 1) != 0)))
+                ret = SM_TEST_FAIL();
+        }
+    }
+
+    if ((ret == 0) && (wc_Sm4CtrEncryptParallel(&sm4, sm4ParOut, sm4ParIn,
+            SM4_BLOCK_SIZE, 0) != BAD_FUNC_ARG))
+        ret = SM_TEST_FAIL();
+
+    wc_Sm4Free(&ref);
+    wc_Sm4Free(&sm4);
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_THREADS) && \
+    defined(WOLFSSL_SM4_GCM)
+/* Test multi-threaded SM4-GCM against single threaded and round trip.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm4_gcm_parallel_test(void)
+{
+    static const byte nonce[GCM_NONCE_MID_SZ] = {
+        0x00, 0x00, 0x12, 0x34, 0x56, 0x78, 0x00, 0x00,
+        0xab, 0xcd, 0xef, 0x01
+    };
+    static const byte aad[] = {
+        0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef,
+        0xab, 0xad, 0xda, 0xd2
+    };
+    wc_Sm4 sm4;
+    wc_Sm4 ref;
+    byte tag[SM4_BLOCK_SIZE];
+    byte expTag[SM4_BLOCK_SIZE];
+    word32 i;
+    word32 j;
+    int ret = 0;
+
+    sm_test_fill(sm4ParIn, sizeof(sm4ParIn), 44);
+
+    if (wc_Sm4Init(&sm4, NULL, INVALID_DEVID) != 0)
+        return SM_TEST_FAIL();
+    if (wc_Sm4Init(&ref, NULL, INVALID_DEVID) != 0)
+        return SM_TEST_FAIL();
+    if ((wc_Sm4GcmSetKey(&ref, sm4ParKey, SM4_KEY_SIZE) != 0) ||
+            (wc_Sm4GcmSetKey(&sm4, sm4ParKey, SM4_KEY_SIZE) != 0))
+        ret = SM_TEST_FAIL();
+
+    for (i = 0; (ret == 0) && (i < sizeof(sm4ParSz) / sizeof(*sm4ParSz));
+            i++) {
+        word32 sz = sm4ParSz[i];
+
+        for (j = 0; (ret == 0) &&
+                (j < sizeof(sm4ParThreads) / sizeof(*sm4ParThreads)); j++) {
+            int threads = sm4ParThreads[j];
+
+            if (wc_Sm4GcmEncrypt(&ref, sm4ParExp, sm4ParIn, sz, nonce,
+                    sizeof(nonce), expTag, sizeof(expTag), aad,
+                    sizeof(aad)) != 0)
+                ret = SM_TEST_FAIL();
+            if ((ret == 0) && (wc_Sm4GcmEncryptParallel(&sm4, sm4ParOut,
+                    sm4ParIn, sz, nonce, sizeof(nonce), tag, sizeof(tag), aad,
+                    sizeof(aad), threads) != 0))
+                ret = SM_TEST_FAIL();
+            if ((ret == 0) && ((XMEMCMP(sm4ParOut, sm4ParExp, sz) != 0) ||
+                    (XMEMCMP(tag, expTag, sizeof(tag)) != 0)))
+                ret = SM_TEST_FAIL();
+            /* Round trip - decrypt in place. */
+            if ((ret == 0) && (wc_Sm4GcmDecryptParallel(&sm4, sm4ParOut,
+                    sm4ParOut, sz, nonce, sizeof(nonce), tag, sizeof(tag), aad,
+                    sizeof(aad), threads) != 0))
+                ret = SM_TEST_FAIL();
+            if ((ret == 0) && (XMEMCMP(sm4ParOut, sm4ParIn, sz) != 0))
+                ret = SM_TEST_FAIL();
+            /* Modified cipher text fails authentication. */
+            if (ret == 0) {
+                sm4ParExp[sz - 1] ^= 0x80;
+                if (wc_Sm4GcmDecryptParallel(&sm4, sm4ParOut, sm4ParExp, sz,
+                        nonce, sizeof(nonce), tag, sizeof(tag), aad,
+                        sizeof(aad), threads) != SM4_GCM_AUTH_E)
+                    ret = SM_TEST_FAIL();
+            }
+        }
+    }
+
+    wc_Sm4Free(&ref);
+    wc_Sm4Free(&sm4);
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM2) && defined(HAVE_ECC)
+/* Private key of the example in GB/T 32918.2, Appendix A. */
+static const byte sm2TestPriv[SM2_KEY_SIZE] = {
+    0x39, 0x45, 0x20, 0x8f, 0x7b, 0x21, 0x44, 0xb1,
+    0x3f, 0x36, 0xe3, 0x8a, 0xc6, 0xd3, 0x9f, 0x95,
+    0x88, 0x93, 0x93, 0x69, 0x28, 0x60, 0xb5, 0x1a,
+    0x42, 0xfb, 0x81, 0xef, 0x4d, 0xf7, 0xc5, 0xb8
+};
+/* Public key of the example in GB/T 32918.2, Appendix A - uncompressed. */
+static const byte sm2TestPub[1 + 2 * SM2_KEY_SIZE] = {
+    0x04,
+    0x09, 0xf9, 0xdf, 0x31, 0x1e, 0x54, 0x21, 0xa1,
+    0x50, 0xdd, 0x7d, 0x16, 0x1e, 0x4b, 0xc5, 0xc6,
+    0x72, 0x17, 0x9f, 0xad, 0x18, 0x33, 0xfc, 0x07,
+    0x6b, 0xb0, 0x8f, 0xf3, 0x56, 0xf3, 0x50, 0x20,
+    0xcc, 0xea, 0x49, 0x0c, 0xe2, 0x67, 0x75, 0xa5,
+    0x2d, 0xc6, 0xea, 0x71, 0x8c, 0xc1, 0xaa, 0x60,
+    0x0a, 0xed, 0x05, 0xfb, 0xf3, 0x5e, 0x08, 0x4a,
+    0x66, 0x32, 0xf6, 0x07, 0x2d, 0xa9, 0xad, 0x13
+};
+/* Digest to sign. */
+static const byte sm2TestHash[WC_SM3_DIGEST_SIZE] = {
+    0xf0, 0xb4, 0x3e, 0x94, 0xba, 0x45, 0xac, 0xca,
+    0xac, 0xe6, 0x92, 0xed, 0x53, 0x43, 0x82, 0xeb,
+    0x17, 0xe6, 0xab, 0x5a, 0x19, 0xce, 0x7b, 0x31,
+    0xf4, 0x48, 0x6f, 0xdf, 0xc0, 0xd2, 0x86, 0x40
+};
+
+/* Load the test key.
+ *
+ * @param [out] key   ECC key to load into.
+ * @param [in]  priv  Whether to load the private key.
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm2_test_key(ecc_key* key, int priv)
+{
+    int ret = 0;
+
+    if (wc_ecc_init_ex(key, NULL, INVALID_DEVID) != 0)
+        return SM_TEST_FAIL();
+    if (priv) {
+        if (wc_ecc_import_private_key_ex(sm2TestPriv, sizeof(sm2TestPriv),
+                sm2TestPub, sizeof(sm2TestPub), key, ECC_SM2P256V1) != 0)
+            ret = SM_TEST_FAIL();
+    }
+    else if (wc_ecc_import_x963_ex(sm2TestPub, sizeof(sm2TestPub), key,
+            ECC_SM2P256V1) != 0) {
+        ret = SM_TEST_FAIL();
+    }
+    if (ret != 0)
+        wc_ecc_free(key);
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM2) && defined(HAVE_ECC) && defined(HAVE_ECC_SIGN) && \
+    defined(HAVE_ECC_VERIFY) && !defined(NO_ASN) && \
+    defined(HAVE_ECC_KEY_EXPORT) && defined(HAVE_ECC_KEY_IMPORT)
+/* Number of keys made in batch test - more than one batch of SP code. */
+#define SM2_BATCH_CNT   20
+
+#if defined(WOLFSSL_SMALL_STACK) && defined(USE_WOLFSSL_MEMORY) && \
+    !defined(WOLFSSL_STATIC_MEMORY) && !defined(WOLFSSL_NO_MALLOC)
+/* Number of allocations made since the count was reset. */
+static int smTestAllocCnt;
+/* Index of the allocation to fail. */
+static int smTestAllocFail;
+
+/* Allocate memory, failing the smTestAllocFail-th allocation.
+ *
+ * @param [in] size  Number of bytes to allocate.
+ * @return  Allocated memory on success.
+ * @return  NULL when this allocation is to fail.
+ */
+static void* sm_test_malloc(size_t size)
+{
+    if (smTestAllocCnt++ == smTestAllocFail)
+        return NULL;
+    return malloc(size);
+}
+
+/* Free memory allocated with sm_test_malloc().
+ *
+ * @param [in] ptr  Memory to free.
+ */
+static void sm_test_free(void* ptr)
+{
+    free(ptr);
+}
+
+/* Reallocate memory allocated with sm_test_malloc().
+ *
+ * @param [in] ptr   Memory to reallocate.
+ * @param [in] size  Number of bytes to allocate.
+ * @return  Allocated memory on success.
+ */
+static void* sm_test_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+/* Test that a batch of SM2 keys is not partially made when an allocation
+ * fails.
+ *
+ * Each allocation is failed in turn until the batch is made.
+ *
+ * @param [in] rng   Random number generator.
+ * @param [in] keys  Initialized keys - SM2_BATCH_CNT.
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm2_make_key_batch_alloc_test(WC_RNG* rng, ecc_key* keys)
+{
+    wolfSSL_Malloc_cb mf;
+    wolfSSL_Free_cb ff;
+    wolfSSL_Realloc_cb rf;
+    int err = MEMORY_E;
+    int fails = 0;
+    int i;
+    int ret = 0;
+
+    if (wolfSSL_GetAllocators(&mf, &ff, &rf) != 0)
+        return SM_TEST_FAIL();
+    for (smTestAllocFail = 0; (ret == 0) && (err != 0); smTestAllocFail++) {
+        smTestAllocCnt = 0;
+        if (wolfSSL_SetAllocators(sm_test_malloc, sm_test_free,
+                sm_test_realloc) != 0)
+            ret = SM_TEST_FAIL();
+        err = wc_ecc_sm2_make_key_batch(rng, keys, SM2_BATCH_CNT,
+            WC_ECC_FLAG_NONE);
+        (void)wolfSSL_SetAllocators(mf, ff, rf);
+        if ((ret == 0) && (err != 0)) {
+            fails++;
+            if (err != MEMORY_E)
+                ret = SM_TEST_FAIL();
+            /* None of the keys made. */
+            for (i = 0; (ret == 0) && (i < SM2_BATCH_CNT); i++) {
+                if ((keys[i].type != 0) ||
+                        (!mp_iszero(wc_ecc_key_get_priv(&keys[i]))))
+                    ret = SM_TEST_FAIL();
+            }
+        }
+        if ((ret == 0) && (smTestAllocFail > 10000))
+            ret = SM_TEST_FAIL();
+    }
+    /* Allocations were failed, unless none are made - e.g. with
+     * WOLFSSL_SP_NO_MALLOC. */
+    if ((ret == 0) && (fails == 0) && (smTestAllocCnt != 0))
+        ret = SM_TEST_FAIL();
+
+    return ret;
+}
+#endif
+
+/* Test making a batch of SM2 keys.
+ *
+ * Each public key is compared against the private key multiplied by the base
+ * point individually, and each key signs and verifies.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm2_make_key_batch_test(void)
+{
+    WC_RNG rng;
+    ecc_key keys[SM2_BATCH_CNT];
+    ecc_key chk;
+    byte pub[SM2_BATCH_CNT][1 + 2 * SM2_KEY_SIZE];
+    byte exp[1 + 2 * SM2_KEY_SIZE];
+    byte priv[SM2_KEY_SIZE];
+    byte sig[80];
+    word32 pubSz;
+    word32 privSz;
+    word32 sigSz;
+    int res;
+    int i;
+    int j;
+    int ret = 0;
+
+    if (wc_InitRng(&rng) != 0)
+        return SM_TEST_FAIL();
+    for (i = 0; i < SM2_BATCH_CNT; i++) {
+        if (wc_ecc_init_ex(&keys[i], NULL, INVALID_DEVID) != 0)
+            ret = SM_TEST_FAIL();
+    }
+
+    if ((ret == 0) && (wc_ecc_sm2_make_key_batch(&rng, keys, SM2_BATCH_CNT,
+            WC_ECC_FLAG_NONE) != 0))
+        ret = SM_TEST_FAIL();
+    for (i = 0; (ret == 0) && (i < SM2_BATCH_CNT); i++) {
+        pubSz = (word32)sizeof(pub[i]);
+        if (wc_ecc_export_x963(&keys[i], pub[i], &pubSz) != 0)
+            ret = SM_TEST_FAIL();
+        /* Public key is private key times base point. */
+        privSz = (word32)sizeof(priv);
+        if ((ret == 0) && (wc_ecc_export_private_only(&keys[i], priv,
+                &privSz) != 0))
+            ret = SM_TEST_FAIL();
+        if ((ret == 0) && (wc_ecc_init_ex(&chk, NULL, INVALID_DEVID) != 0))
+            ret = SM_TEST_FAIL();
+        if (ret == 0) {
+            pubSz = (word32)sizeof(exp);
+            if ((wc_ecc_import_private_key_ex(priv, privSz, NULL, 0, &chk,
+                    ECC_SM2P256V1) != 0) ||
+                    (wc_ecc_make_pub(&chk, NULL) != 0) ||
+                    (wc_ecc_export_x963(&chk, exp, &pubSz) != 0) ||
+                    (XMEMCMP(exp, pub[i], sizeof(exp)) != 0))
+                ret = SM_TEST_FAIL();
+            wc_ecc_free(&chk);
+        }
+        sigSz = (word32)sizeof(sig);
+        res = 0;
+        if ((ret == 0) && ((wc_ecc_sm2_sign_hash(sm2TestHash,
+                sizeof(sm2TestHash), sig, &sigSz, &rng, &keys[i]) != 0) ||
+                (wc_ecc_sm2_verify_hash(sig, sigSz, sm2TestHash,
+                    sizeof(sm2TestHash), &res, &keys[i]) != 0) ||
+                (res != 1)))
+            ret = SM_TEST_FAIL();
+        /* Keys are all different. */
+        for (j = 0; (ret == 0) && (j < i); j++) {
+            if (XMEMCMP(pub[i], pub[j], sizeof(pub[i])) == 0)
+                ret = SM_TEST_FAIL();
+        }
+    }
+
+    if ((ret == 0) && ((wc_ecc_sm2_make_key_batch(&rng, keys, 0,
+            WC_ECC_FLAG_NONE) != 0) ||
+            (wc_ecc_sm2_make_key_batch(NULL, keys, SM2_BATCH_CNT,
+                WC_ECC_FLAG_NONE) != BAD_FUNC_ARG) ||
+            (wc_ecc_sm2_make_key_batch(&rng, NULL, SM2_BATCH_CNT,
+                WC_ECC_FLAG_NONE) != BAD_FUNC_ARG)))
+        ret = SM_TEST_FAIL();
+#if defined(WOLFSSL_SMALL_STACK) && defined(USE_WOLFSSL_MEMORY) && \
+    !defined(WOLFSSL_STATIC_MEMORY) && !defined(WOLFSSL_NO_MALLOC)
+    if (ret == 0)
+        ret = sm2_make_key_batch_alloc_test(&rng, keys);
+#endif
+
+    for (i = 0; i < SM2_BATCH_CNT; i++) {
+        wc_ecc_free(&keys[i]);
+    }
+    wc_FreeRng(&rng);
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM2) && defined(HAVE_ECC) && defined(WOLFSSL_SM2_ENCRYPT)
+/* Test SM2 public key encryption - known answer, streaming and round trip.
+ *
+ * Known answer calculated independently with k = SM3("wolfsm SM2 encrypt k")
+ * mod n, encrypting "encryption standard" with the test key.
+ * Streaming is split at every offset and a key stream of all zeros is forced
+ * through the context to check it is rejected.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm2_encrypt_test(void)
+{
+    static const byte msgKat[] = "encryption standard";
+    /* C1 || C3 || C2. */
+    static const byte encKat[WC_SM2_ENC_OVERHEAD + sizeof(msgKat) - 1] = {
+        0x04, 0x69, 0x53, 0xb2, 0x99, 0x69, 0x99, 0x79,
+        0x17, 0x65, 0x92, 0x1b, 0x48, 0x99, 0xc1, 0x44,
+        0x43, 0x21, 0x46, 0x48, 0xe8, 0x98, 0x43, 0x49,
+        0x69, 0x67, 0xcc, 0x8d, 0xe6, 0x74, 0xcf, 0x38,
+        0x6b, 0x8a, 0x1b, 0xc8, 0x18, 0xfa, 0x84, 0xe9,
+        0x92, 0xfd, 0x63, 0x1b, 0xb6, 0x0a, 0x36, 0x3a,
+        0x91, 0xf9, 0x1a, 0xf1, 0xf3, 0xc2, 0x9d, 0x62,
+        0x3c, 0xa8, 0x61, 0xe8, 0x66, 0x2a, 0x0c, 0x02,
+        0x5b, 0x74, 0x12, 0x54, 0x51, 0x5d, 0xd9, 0x57,
+        0xfb, 0xd4, 0x83, 0x33, 0xee, 0xb3, 0xd2, 0x0f,
+        0x35, 0xb2, 0xed, 0xb4, 0x42, 0xe7, 0x28, 0x00,
+        0x2b, 0xa6, 0x07, 0xb4, 0x2c, 0x66, 0x1b, 0x1c,
+        0xad, 0x6e, 0x5d, 0xe0, 0x60, 0xdc, 0x4d, 0x73,
+        0xb1, 0xe8, 0xd8, 0x3d, 0x91, 0x2c, 0xd7, 0x12,
+        0x18, 0x9c, 0x98, 0xf8
+    };
+    static const word32 parts[] = { 1, 31, 32, 33, 200 };
+    WC_RNG rng;
+    ecc_key key;
+    wc_Sm2EncCtx ctx;
+    byte msg[200];
+    byte enc[WC_SM2_ENC_OVERHEAD + 200];
+    byte dec[200];
+    word32 encSz;
+    word32 decSz;
+    word32 i;
+    word32 j;
+    word32 len;
+    int ret;
+
+    ret = sm2_test_key(&key, 1);
+    if (ret != 0)
+        return ret;
+    if (wc_InitRng(&rng) != 0) {
+        wc_ecc_free(&key);
+        return SM_TEST_FAIL();
+    }
+    XMEMSET(&ctx, 0, sizeof(ctx));
+
+    decSz = (word32)sizeof(dec);
+    if ((wc_ecc_sm2_decrypt(&key, encKat, sizeof(encKat), dec,
+            &decSz) != 0) || (decSz != sizeof(msgKat) - 1) ||
+            (XMEMCMP(dec, msgKat, decSz) != 0))
+        ret = SM_TEST_FAIL();
+    /* Streaming decryption of known answer. */
+    if ((ret == 0) && ((wc_ecc_sm2_decrypt_init(&ctx, &key, encKat,
+            WC_SM2_C1_SIZE) != 0) ||
+            (wc_ecc_sm2_decrypt_update(&ctx, encKat + WC_SM2_ENC_OVERHEAD, 5,
+                dec) != 0) ||
+            (wc_ecc_sm2_decrypt_update(&ctx,
+                encKat + WC_SM2_ENC_OVERHEAD + 5, sizeof(msgKat) - 1 - 5,
+                dec + 5) != 0) ||
+            (wc_ecc_sm2_decrypt_final(&ctx, encKat + WC_SM2_C1_SIZE) != 0) ||
+            (XMEMCMP(dec, msgKat, sizeof(msgKat) - 1) != 0)))
+        ret = SM_TEST_FAIL();
+    wc_ecc_sm2_enc_free(&ctx);
+    /* Streaming decryption of known answer split at every offset. */
+    for (i = 0; (ret == 0) && (i < sizeof(msgKat)); i++) {
+        XMEMSET(dec, 0, sizeof(dec));
+        if ((wc_ecc_sm2_decrypt_init(&ctx, &key, encKat,
+                WC_SM2_C1_SIZE) != 0) ||
+                (wc_ecc_sm2_decrypt_update(&ctx, encKat + WC_SM2_ENC_OVERHEAD,
+                    i, dec) != 0) ||
+                (wc_ecc_sm2_decrypt_update(&ctx,
+                    encKat + WC_SM2_ENC_OVERHEAD + i, sizeof(msgKat) - 1 - i,
+                    dec + i) != 0) ||
+                (wc_ecc_sm2_decrypt_final(&ctx,
+                    encKat + WC_SM2_C1_SIZE) != 0) ||
+                (XMEMCMP(dec, msgKat, sizeof(msgKat) - 1) != 0))
+            ret = SM_TEST_FAIL();
+        wc_ecc_sm2_enc_free(&ctx);
+    }
+
+    /* Key stream of all zeros is rejected - decrypting and encrypting. */
+    if ((ret == 0) && (wc_ecc_sm2_decrypt_init(&ctx, &key, encKat,
+            WC_SM2_C1_SIZE) != 0))
+        ret = SM_TEST_FAIL();
+    if (ret == 0) {
+        XMEMSET(ctx.ks, 0, sizeof(ctx.ks));
+        ctx.ksIdx = 0;
+        if ((wc_ecc_sm2_decrypt_update(&ctx, encKat + WC_SM2_ENC_OVERHEAD,
+                sizeof(msgKat) - 1, dec) != 0) ||
+                (wc_ecc_sm2_decrypt_final(&ctx,
+                    encKat + WC_SM2_C1_SIZE) != BAD_STATE_E))
+            ret = SM_TEST_FAIL();
+    }
+    wc_ecc_sm2_enc_free(&ctx);
+    if ((ret == 0) && (wc_ecc_sm2_encrypt_init(&ctx, &key, &rng, enc) != 0))
+        ret = SM_TEST_FAIL();
+    if (ret == 0) {
+        XMEMSET(ctx.ks, 0, sizeof(ctx.ks));
+        ctx.ksIdx = 0;
+        if ((wc_ecc_sm2_encrypt_update(&ctx, msgKat, sizeof(msgKat) - 1,
+                enc + WC_SM2_ENC_OVERHEAD) != 0) ||
+                (wc_ecc_sm2_encrypt_final(&ctx,
+                    enc + WC_SM2_C1_SIZE) != BAD_STATE_E))
+            ret = SM_TEST_FAIL();
+    }
+    wc_ecc_sm2_enc_free(&ctx);
+    /* No key stream used is the same as all zeros. */
+    if ((ret == 0) && ((wc_ecc_sm2_encrypt_init(&ctx, &key, &rng, enc) != 0) ||
+            (wc_ecc_sm2_encrypt_final(&ctx, enc + WC_SM2_C1_SIZE) !=
+                BAD_STATE_E)))
+        ret = SM_TEST_FAIL();
+    wc_ecc_sm2_enc_free(&ctx);
+    if ((ret == 0) && ((wc_ecc_sm2_decrypt_init(&ctx, &key, encKat,
+            WC_SM2_C1_SIZE) != 0) ||
+            (wc_ecc_sm2_decrypt_final(&ctx, encKat + WC_SM2_C1_SIZE) !=
+                BAD_STATE_E)))
+        ret = SM_TEST_FAIL();
+    wc_ecc_sm2_enc_free(&ctx);
+    encSz = (word32)sizeof(enc);
+    decSz = (word32)sizeof(dec);
+    if ((ret == 0) && ((wc_ecc_sm2_encrypt(&key, &rng, msg, 0, enc,
+            &encSz) != BAD_FUNC_ARG) || (wc_ecc_sm2_decrypt(&key, encKat,
+                WC_SM2_ENC_OVERHEAD, dec, &decSz) != BUFFER_E)))
+        ret = SM_TEST_FAIL();
+
+    /* One-shot round trip. */
+    sm_test_fill(msg, sizeof(msg), 31);
+    encSz = (word32)sizeof(enc);
+    decSz = (word32)sizeof(dec);
+    if ((ret == 0) && ((wc_ecc_sm2_encrypt(&key, &rng, msg, sizeof(msg), enc,
+            &encSz) != 0) || (encSz != sizeof(enc)) ||
+            (wc_ecc_sm2_decrypt(&key, enc, encSz, dec, &decSz) != 0) ||
+            (decSz != sizeof(msg)) || (XMEMCMP(dec, msg, decSz) != 0)))
+        ret = SM_TEST_FAIL();
+
+    /* Streaming encryption in pieces - one-shot decryption. */
+    for (j = 0; (ret == 0) && (j < sizeof(parts) / sizeof(*parts)); j++) {
+        if (wc_ecc_sm2_encrypt_init(&ctx, &key, &rng, enc) != 0)
+            ret = SM_TEST_FAIL();
+        for (i = 0; (ret == 0) && (i < sizeof(msg)); i += len) {
+            len = parts[j];
+            if (len > sizeof(msg) - i)
+                len = sizeof(msg) - i;
+            if (wc_ecc_sm2_encrypt_update(&ctx, msg + i, len,
+                    enc + WC_SM2_ENC_OVERHEAD + i) != 0)
+                ret = SM_TEST_FAIL();
+        }
+        if ((ret == 0) && (wc_ecc_sm2_encrypt_final(&ctx,
+                enc + WC_SM2_C1_SIZE) != 0))
+            ret = SM_TEST_FAIL();
+        wc_ecc_sm2_enc_free(&ctx);
+        decSz = (word32)sizeof(dec);
+        if ((ret == 0) && ((wc_ecc_sm2_decrypt(&key, enc, sizeof(enc), dec,
+                &decSz) != 0) || (decSz != sizeof(msg)) ||
+                (XMEMCMP(dec, msg, decSz) != 0)))
+            ret = SM_TEST_FAIL();
+    }
+
+    /* Streaming encryption and decryption split at every offset - crosses
+     * the boundaries of the blocks of key stream. */
+    for (j = 0; (ret == 0) && (j <= sizeof(msg)); j++) {
+        if ((wc_ecc_sm2_encrypt_init(&ctx, &key, &rng, enc) != 0) ||
+                (wc_ecc_sm2_encrypt_update(&ctx, msg, j,
+                    enc + WC_SM2_ENC_OVERHEAD) != 0) ||
+                (wc_ecc_sm2_encrypt_update(&ctx, msg + j, sizeof(msg) - j,
+                    enc + WC_SM2_ENC_OVERHEAD + j) != 0) ||
+                (wc_ecc_sm2_encrypt_final(&ctx, enc + WC_SM2_C1_SIZE) != 0))
+            ret = SM_TEST_FAIL();
+        wc_ecc_sm2_enc_free(&ctx);
+        decSz = (word32)sizeof(dec);
+        if ((ret == 0) && ((wc_ecc_sm2_decrypt(&key, enc, sizeof(enc), dec,
+                &decSz) != 0) || (decSz != sizeof(msg)) ||
+                (XMEMCMP(dec, msg, decSz) != 0)))
+            ret = SM_TEST_FAIL();
+        /* Decrypt split at a different offset. */
+        i = (word32)sizeof(msg) - j;
+        XMEMSET(dec, 0, sizeof(dec));
+        if ((ret == 0) && ((wc_ecc_sm2_decrypt_init(&ctx, &key, enc,
+                WC_SM2_C1_SIZE) != 0) ||
+                (wc_ecc_sm2_decrypt_update(&ctx, enc + WC_SM2_ENC_OVERHEAD, i,
+                    dec) != 0) ||
+                (wc_ecc_sm2_decrypt_update(&ctx,
+                    enc + WC_SM2_ENC_OVERHEAD + i, sizeof(msg) - i,
+                    dec + i) != 0) ||
+                (wc_ecc_sm2_decrypt_final(&ctx, enc + WC_SM2_C1_SIZE) != 0) ||
+                (XMEMCMP(dec, msg, sizeof(msg)) != 0)))
+            ret = SM_TEST_FAIL();
+        wc_ecc_sm2_enc_free(&ctx);
+    }
+
+    /* Modified cipher text fails C3 check. */
+    if (ret == 0) {
+        enc[sizeof(enc) - 1] ^= 0x01;
+        decSz = (word32)sizeof(dec);
+        if (wc_ecc_sm2_decrypt(&key, enc, sizeof(enc), dec, &decSz) !=
+                MAC_CMP_FAILED_E)
+            ret = SM_TEST_FAIL();
+    }
+    /* Output buffer too small. */
+    encSz = (word32)sizeof(enc) - 1;
+    if ((ret == 0) && (wc_ecc_sm2_encrypt(&key, &rng, msg, sizeof(msg), enc,
+            &encSz) != BUFFER_E))
+        ret = SM_TEST_FAIL();
+
+    wc_FreeRng(&rng);
+    wc_ecc_free(&key);
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM2) && defined(HAVE_ECC) && defined(WOLFSSL_SM2_KAP)
+/* Load a key pair.
+ *
+ * @param [out] key   ECC key to load into.
+ * @param [in]  priv  Private key. SM2_KEY_SIZE bytes.
+ * @param [in]  pub   Uncompressed public key.
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm2_test_key_pair(ecc_key* key, const byte* priv, const byte* pub)
+{
+    int ret = 0;
+
+    if (wc_ecc_init_ex(key, NULL, INVALID_DEVID) != 0)
+        return SM_TEST_FAIL();
+    if (wc_ecc_import_private_key_ex(priv, SM2_KEY_SIZE, pub,
+            1 + 2 * SM2_KEY_SIZE, key, ECC_SM2P256V1) != 0) {
+        wc_ecc_free(key);
+        ret = SM_TEST_FAIL();
+    }
+    return ret;
+}
+
+/* Test SM2 key exchange - known answer and both sides agreeing.
+ *
+ * Initiator A has the test key. B's static key and the ephemeral keys are
+ * SM3 of a label mod n. Known answer calculated independently.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm2_kap_test(void)
+{
+    static const byte idA[] = "ALICE123@YAHOO.COM";
+    static const byte idB[] = "BILL456@YAHOO.COM";
+    static const byte privB[SM2_KEY_SIZE] = {
+        0x8d, 0xc7, 0xa4, 0x29, 0x80, 0x03, 0xbf, 0xda,
+        0xdb, 0xd3, 0x27, 0x1d, 0xf2, 0xa7, 0x82, 0xd9,
+        0x4b, 0x5b, 0x8f, 0x46, 0x71, 0x9d, 0xd9, 0xc0,
+        0xac, 0x49, 0xda, 0xbb, 0x66, 0x3d, 0x4e, 0x15
+    };
+    static const byte pubB[1 + 2 * SM2_KEY_SIZE] = {
+        0x04,
+        0x43, 0xd2, 0x65, 0xe6, 0xa0, 0x0d, 0x41, 0x43,
+        0xa0, 0x5b, 0xcf, 0x69, 0x80, 0xa5, 0x5c, 0x0c,
+        0x68, 0x21, 0x37, 0x6a, 0x73, 0xf0, 0xf1, 0x48,
+        0x71, 0xea, 0x02, 0x07, 0xa1, 0xcf, 0x7c, 0x3c,
+        0x96, 0xf8, 0x44, 0xcf, 0xce, 0xd8, 0x10, 0x24,
+        0xbe, 0x9d, 0x97, 0x0c, 0xbc, 0x31, 0xea, 0x5a,
+        0x0e, 0xbc, 0x18, 0x81, 0xd1, 0xf3, 0xac, 0xc3,
+        0x06, 0x8d, 0xb2, 0xe2, 0xfa, 0x87, 0xb2, 0x40
+    };
+    static const byte privEphA[SM2_KEY_SIZE] = {
+        0x8c, 0xe9, 0x2d, 0x55, 0xe2, 0x70, 0x0d, 0x77,
+        0xf1, 0x48, 0x31, 0xc2, 0xc5, 0x49, 0xce, 0x54,
+        0x1a, 0xd7, 0x9d, 0x1b, 0xbf, 0xe4, 0xa4, 0xc2,
+        0x86, 0xb2, 0x2f, 0x2e, 0x95, 0x9a, 0xc2, 0x8c
+    };
+    static const byte pubEphA[1 + 2 * SM2_KEY_SIZE] = {
+        0x04,
+        0xba, 0x9f, 0x20, 0xb5, 0xc8, 0xc5, 0x22, 0xa2,
+        0x22, 0x1b, 0xb5, 0xc5, 0xb4, 0xd9, 0xa6, 0x47,
+        0x93, 0x89, 0x46, 0xa4, 0xd2, 0xce, 0xba, 0x11,
+        0xee, 0xc1, 0x9d, 0x18, 0x3e, 0x1a, 0xc6, 0xce,
+        0x5a, 0x3a, 0xe4, 0x8d, 0xdf, 0x98, 0x49, 0x3c,
+        0x7f, 0x46, 0x92, 0x45, 0x32, 0x3b, 0x69, 0x97,
+        0x17, 0x8c, 0xa1, 0x0d, 0xda, 0x71, 0xfd, 0x69,
+        0xb7, 0x5e, 0x9f, 0xc0, 0xd4, 0x63, 0xda, 0x8f
+    };
+    static const byte privEphB[SM2_KEY_SIZE] = {
+        0xaa, 0x74, 0xe8, 0x5c, 0x72, 0x5a, 0xe6, 0x96,
+        0x25, 0xa8, 0xc6, 0x78, 0x49, 0x7e, 0xc2, 0x4b,
+        0x3a, 0x9e, 0x5d, 0x8d, 0x64, 0xc0, 0x20, 0x3c,
+        0xb4, 0xaf, 0x44, 0xde, 0x6b, 0xee, 0x60, 0x44
+    };
+    static const byte pubEphB[1 + 2 * SM2_KEY_SIZE] = {
+        0x04,
+        0x49, 0xe0, 0x53, 0xe1, 0x4c, 0x36, 0x69, 0x28,
+        0x23, 0x98, 0x1e, 0x76, 0x53, 0x0f, 0x9b, 0xb1,
+        0xff, 0xf6, 0x5d, 0x41, 0x87, 0x36, 0x8e, 0x98,
+        0xd4, 0xc1, 0x3a, 0x01, 0x9b, 0xb0, 0x5d, 0x45,
+        0x32, 0xe3, 0x95, 0x03, 0xbe, 0x19, 0xcc, 0x6d,
+        0x17, 0x1e, 0x0d, 0x9f, 0xf7, 0x27, 0xef, 0xc1,
+        0x41, 0x4b, 0x8b, 0x94, 0x9a, 0x62, 0x91, 0x6f,
+        0x5c, 0xa0, 0x07, 0xaf, 0x2b, 0x25, 0x44, 0x66
+    };
+    static const byte expZa[WC_SM2_Z_SIZE] = {
+        0x26, 0xdb, 0x4b, 0xc1, 0x83, 0x9b, 0xd2, 0x2e,
+        0x97, 0xe1, 0xda, 0xb6, 0x67, 0xec, 0x5e, 0x0a,
+        0x73, 0x0d, 0x5e, 0x16, 0x52, 0x13, 0x98, 0xb4,
+        0x43, 0x5c, 0x57, 0x6a, 0x93, 0xaf, 0xd7, 0xed
+    };
+    static const byte expZb[WC_SM2_Z_SIZE] = {
+        0x1c, 0xbd, 0x23, 0x26, 0x5d, 0x01, 0xbb, 0x87,
+        0xe4, 0xdc, 0xdd, 0xf2, 0x13, 0x6c, 0xa5, 0xc2,
+        0x99, 0x26, 0x94, 0x29, 0xa5, 0xb1, 0x86, 0x74,
+        0x8a, 0xd7, 0x5c, 0x84, 0x5d, 0xc6, 0xb9, 0x84
+    };
+    static const byte expKey[16] = {
+        0x38, 0x55, 0xf5, 0x7d, 0xc1, 0x11, 0xf3, 0xab,
+        0x28, 0xac, 0x0c, 0xcb, 0x02, 0xc6, 0x00, 0x6a
+    };
+    /* S1 of A and SB of B. */
+    static const byte expSb[WC_SM2_KAP_S_SIZE] = {
+        0x8d, 0xd5, 0xd3, 0xc1, 0xbc, 0x61, 0x87, 0xae,
+        0x53, 0x11, 0x79, 0xad, 0x42, 0x30, 0x75, 0xcd,
+        0xc4, 0xce, 0x2f, 0x25, 0x8f, 0x69, 0x1a, 0x75,
+        0xbe, 0xea, 0x3c, 0x51, 0x13, 0x57, 0x7e, 0x96
+    };
+    /* SA of A and S2 of B. */
+    static const byte expSa[WC_SM2_KAP_S_SIZE] = {
+        0x0f, 0x4d, 0xc5, 0xbe, 0xf5, 0x36, 0x0a, 0x7f,
+        0x36, 0xcd, 0x10, 0x6d, 0x02, 0x8d, 0xab, 0x30,
+        0x45, 0xf5, 0x85, 0x70, 0x04, 0x30, 0xd0, 0xc3,
+        0x4c, 0xff, 0x3f, 0x3b, 0x6a, 0x1e, 0x5a, 0xd0
+    };
+    ecc_key keyA;
+    ecc_key keyB;
+    ecc_key ephA;
+    ecc_key ephB;
+    wc_Sm2Kap kapA;
+    wc_Sm2Kap kapB;
+    byte za[WC_SM2_Z_SIZE];
+    byte zb[WC_SM2_Z_SIZE];
+    byte outA[100];
+    byte outB[100];
+    byte sbA[WC_SM2_KAP_S_SIZE];
+    byte saA[WC_SM2_KAP_S_SIZE];
+    byte sbB[WC_SM2_KAP_S_SIZE];
+    byte saB[WC_SM2_KAP_S_SIZE];
+    int ret;
+
+    ret = sm2_test_key(&keyA, 1);
+    if (ret != 0)
+        return ret;
+    ret = sm2_test_key_pair(&keyB, privB, pubB);
+    if (ret != 0) {
+        wc_ecc_free(&keyA);
+        return ret;
+    }
+    ret = sm2_test_key_pair(&ephA, privEphA, pubEphA);
+    if (ret != 0) {
+        wc_ecc_free(&keyB);
+        wc_ecc_free(&keyA);
+        return ret;
+    }
+    ret = sm2_test_key_pair(&ephB, privEphB, pubEphB);
+    if (ret != 0) {
+        wc_ecc_free(&ephA);
+        wc_ecc_free(&keyB);
+        wc_ecc_free(&keyA);
+        return ret;
+    }
+    XMEMSET(&kapA, 0, sizeof(kapA));
+    XMEMSET(&kapB, 0, sizeof(kapB));
+
+    if ((wc_ecc_sm2_calc_za(idA, sizeof(idA) - 1, &keyA, za) != 0) ||
+            (XMEMCMP(za, expZa, sizeof(za)) != 0))
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && ((wc_ecc_sm2_calc_za(idB, sizeof(idB) - 1, &keyB,
+            zb) != 0) || (XMEMCMP(zb, expZb, sizeof(zb)) != 0)))
+        ret = SM_TEST_FAIL();
+
+    /* Each side initializes before receiving the peer's ephemeral key. */
+    if ((ret == 0) && ((wc_ecc_sm2_kap_init(&kapA, &keyA, &ephA) != 0) ||
+            (wc_ecc_sm2_kap_init(&kapB, &keyB, &ephB) != 0)))
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && ((wc_ecc_sm2_kap_final(&kapA, &keyB, &ephB, 1, za, zb,
+            outA, sizeof(expKey), sbA, saA) != 0) ||
+            (wc_ecc_sm2_kap_final(&kapB, &keyA, &ephA, 0, za, zb, outB,
+                sizeof(expKey), sbB, saB) != 0)))
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && ((XMEMCMP(outA, expKey, sizeof(expKey)) != 0) ||
+            (XMEMCMP(outB, expKey, sizeof(expKey)) != 0) ||
+            (XMEMCMP(sbA, expSb, sizeof(expSb)) != 0) ||
+            (XMEMCMP(sbB, expSb, sizeof(expSb)) != 0) ||
+            (XMEMCMP(saA, expSa, sizeof(expSa)) != 0) ||
+            (XMEMCMP(saB, expSa, sizeof(expSa)) != 0)))
+        ret = SM_TEST_FAIL();
+
+    /* Key of many KDF blocks, no confirmation values. */
+    if ((ret == 0) && ((wc_ecc_sm2_kap_final(&kapA, &keyB, &ephB, 1, za, zb,
+            outA, sizeof(outA), NULL, NULL) != 0) ||
+            (wc_ecc_sm2_kap_final(&kapB, &keyA, &ephA, 0, za, zb, outB,
+                sizeof(outB), NULL, NULL) != 0) ||
+            (XMEMCMP(outA, expKey, sizeof(expKey)) != 0) ||
+            (XMEMCMP(outA, outB, sizeof(outA)) != 0)))
+        ret = SM_TEST_FAIL();
+    /* Responder with the wrong ZB agrees on a different key. */
+    if ((ret == 0) && ((wc_ecc_sm2_kap_final(&kapB, &keyA, &ephA, 0, za, za,
+            outB, sizeof(outB), NULL, NULL) != 0) ||
+            (XMEMCMP(outA, outB, sizeof(outA)) == 0)))
+        ret = SM_TEST_FAIL();
+
+    wc_ecc_sm2_kap_free(&kapB);
+    wc_ecc_sm2_kap_free(&kapA);
+    wc_ecc_free(&ephB);
+    wc_ecc_free(&ephA);
+    wc_ecc_free(&keyB);
+    wc_ecc_free(&keyA);
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM2) && defined(HAVE_ECC) && \
+    defined(HAVE_ECC_KEY_IMPORT) && defined(HAVE_COMP_KEY) && \
+    defined(HAVE_ECC_KEY_EXPORT)
+/* Number of points in batch import test - more than one batch. */
+#define SM2_IMPORT_CNT  18
+
+/* Import a batch of points into freshly initialized keys.
+ *
+ * @param [in]  in     Encoded points.
+ * @param [in]  keys   Keys to import into.
+ * @param [in]  check  Whether to check the points are on the curve.
+ * @return  Return of wc_ecc_sm2_import_point_batch().
+ * @return  Negative line number when initializing a key failed.
+ */
+static int sm2_import_point_batch(const byte* in, ecc_key* keys, int check)
+{
+    int i;
+    int ret = 0;
+
+    for (i = 0; i < SM2_IMPORT_CNT; i++) {
+        if (wc_ecc_init_ex(&keys[i], NULL, INVALID_DEVID) != 0)
+            ret = SM_TEST_FAIL();
+    }
+    if (ret == 0) {
+        ret = wc_ecc_sm2_import_point_batch(in,
+            SM2_IMPORT_CNT * WC_SM2_COMP_POINT_SIZE, keys, SM2_IMPORT_CNT,
+            check);
+    }
+    return ret;
+}
+
+/* Test importing a batch of compressed SM2 public keys.
+ *
+ * Points are the test public key (odd y), G (even y) and 2G (odd y) repeated.
+ * An invalid point at the start, in the middle or at the end of the batch
+ * fails the whole import and no key is left holding a point.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm2_import_point_batch_test(void)
+{
+    static const byte compG[WC_SM2_COMP_POINT_SIZE] = {
+        0x02,
+        0x32, 0xc4, 0xae, 0x2c, 0x1f, 0x19, 0x81, 0x19,
+        0x5f, 0x99, 0x04, 0x46, 0x6a, 0x39, 0xc9, 0x94,
+        0x8f, 0xe3, 0x0b, 0xbf, 0xf2, 0x66, 0x0b, 0xe1,
+        0x71, 0x5a, 0x45, 0x89, 0x33, 0x4c, 0x74, 0xc7
+    };
+    static const byte pubG[1 + 2 * SM2_KEY_SIZE] = {
+        0x04,
+        0x32, 0xc4, 0xae, 0x2c, 0x1f, 0x19, 0x81, 0x19,
+        0x5f, 0x99, 0x04, 0x46, 0x6a, 0x39, 0xc9, 0x94,
+        0x8f, 0xe3, 0x0b, 0xbf, 0xf2, 0x66, 0x0b, 0xe1,
+        0x71, 0x5a, 0x45, 0x89, 0x33, 0x4c, 0x74, 0xc7,
+        0xbc, 0x37, 0x36, 0xa2, 0xf4, 0xf6, 0x77, 0x9c,
+        0x59, 0xbd, 0xce, 0xe3, 0x6b, 0x69, 0x21, 0x53,
+        0xd0, 0xa9, 0x87, 0x7c, 0xc6, 0x2a, 0x47, 0x40,
+        0x02, 0xdf, 0x32, 0xe5, 0x21, 0x39, 0xf0, 0xa0
+    };
+    static const byte comp2G[WC_SM2_COMP_POINT_SIZE] = {
+        0x03,
+        0x56, 0xce, 0xfd, 0x60, 0xd7, 0xc8, 0x7c, 0x00,
+        0x0d, 0x58, 0xef, 0x57, 0xfa, 0x73, 0xba, 0x4d,
+        0x9c, 0x0d, 0xfa, 0x08, 0xc0, 0x8a, 0x73, 0x31,
+        0x49, 0x5c, 0x2e, 0x1d, 0xa3, 0xf2, 0xbd, 0x52
+    };
+    static const byte pub2G[1 + 2 * SM2_KEY_SIZE] = {
+        0x04,
+        0x56, 0xce, 0xfd, 0x60, 0xd7, 0xc8, 0x7c, 0x00,
+        0x0d, 0x58, 0xef, 0x57, 0xfa, 0x73, 0xba, 0x4d,
+        0x9c, 0x0d, 0xfa, 0x08, 0xc0, 0x8a, 0x73, 0x31,
+        0x49, 0x5c, 0x2e, 0x1d, 0xa3, 0xf2, 0xbd, 0x52,
+        0x31, 0xb7, 0xe7, 0xe6, 0xcc, 0x81, 0x89, 0xf6,
+        0x68, 0x53, 0x5c, 0xe0, 0xf8, 0xea, 0xf1, 0xbd,
+        0x6d, 0xe8, 0x4c, 0x18, 0x2f, 0x6c, 0x8e, 0x71,
+        0x6f, 0x78, 0x0d, 0x3a, 0x97, 0x0a, 0x23, 0xc3
+    };
+    const byte* exp[3] = { sm2TestPub, pubG, pub2G };
+    static const int badIdx[3] = { 0, SM2_IMPORT_CNT / 2, SM2_IMPORT_CNT - 1 };
+    byte in[SM2_IMPORT_CNT * WC_SM2_COMP_POINT_SIZE];
+    byte bad[SM2_IMPORT_CNT * WC_SM2_COMP_POINT_SIZE];
+    byte pub[1 + 2 * SM2_KEY_SIZE];
+    ecc_key keys[SM2_IMPORT_CNT];
+    byte* pt;
+    word32 pubSz;
+    int check;
+    int i;
+    int j;
+    int ret = 0;
+
+    for (i = 0; i < SM2_IMPORT_CNT; i++) {
+        pt = in + i * WC_SM2_COMP_POINT_SIZE;
+        if (i % 3 == 0) {
+            pt[0] = (byte)(0x02 | (sm2TestPub[2 * SM2_KEY_SIZE] & 1));
+            XMEMCPY(pt + 1, sm2TestPub + 1, SM2_KEY_SIZE);
+        }
+        else {
+            XMEMCPY(pt, (i % 3 == 1) ? compG : comp2G,
+                WC_SM2_COMP_POINT_SIZE);
+        }
+    }
+
+    /* With and without checking points are on the curve. */
+    for (check = 1; (ret == 0) && (check >= 0); check--) {
+        if (sm2_import_point_batch(in, keys, check) != 0)
+            ret = SM_TEST_FAIL();
+        for (i = 0; (ret == 0) && (i < SM2_IMPORT_CNT); i++) {
+            pubSz = (word32)sizeof(pub);
+            if ((keys[i].type != ECC_PUBLICKEY) ||
+                    (wc_ecc_export_x963(&keys[i], pub, &pubSz) != 0) ||
+                    (pubSz != sizeof(pub)) ||
+                    (XMEMCMP(pub, exp[i % 3], sizeof(pub)) != 0))
+                ret = SM_TEST_FAIL();
+        }
+        for (i = 0; i < SM2_IMPORT_CNT; i++) {
+            wc_ecc_free(&keys[i]);
+        }
+    }
+
+    for (j = 0; (ret == 0) && (j < 3); j++) {
+        for (check = 1; (ret == 0) && (check >= 0); check--) {
+            XMEMCPY(bad, in, sizeof(in));
+            pt = bad + badIdx[j] * WC_SM2_COMP_POINT_SIZE;
+            if (check) {
+                /* x = 2 is not the x ordinate of a point on the curve. */
+                XMEMSET(pt + 1, 0, SM2_KEY_SIZE);
+                pt[SM2_KEY_SIZE] = 2;
+            }
+            else {
+                /* Not a compressed point - detected without checking. */
+                pt[0] = 0x04;
+            }
+            if (sm2_import_point_batch(bad, keys, check) == 0)
+                ret = SM_TEST_FAIL();
+            /* None of the points, valid or not, are left imported. */
+            for (i = 0; (ret == 0) && (i < SM2_IMPORT_CNT); i++) {
+                pubSz = (word32)sizeof(pub);
+                if ((keys[i].type == ECC_PUBLICKEY) ||
+                        (!mp_iszero(keys[i].pubkey.x)) ||
+                        (!mp_iszero(keys[i].pubkey.y)) ||
+                        (wc_ecc_export_x963(&keys[i], pub, &pubSz) == 0))
+                    ret = SM_TEST_FAIL();
+            }
+            for (i = 0; i < SM2_IMPORT_CNT; i++) {
+                wc_ecc_free(&keys[i]);
+            }
+        }
+    }
+
+    /* Length must be that of the number of points. */
+    if ((ret == 0) && (wc_ecc_sm2_import_point_batch(in, sizeof(in) - 1,
+            keys, SM2_IMPORT_CNT, 1) != BAD_FUNC_ARG))
+        ret = SM_TEST_FAIL();
+
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM2) && defined(HAVE_ECC) && defined(HAVE_ECC_CHECK_KEY)
+/* Test checking SM2 public keys, with and without the cache.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm2_check_pub_key_test(void)
+{
+    ecc_key key;
+    byte bad[sizeof(sm2TestPub)];
+    int i;
+    int ret = 0;
+
+#ifdef WOLFSSL_SM2_PUB_KEY_CACHE
+    wc_ecc_sm2_pub_key_cache_clear();
+#endif
+    XMEMCPY(bad, sm2TestPub, sizeof(bad));
+    bad[sizeof(bad) - 1] ^= 1;
+
+    /* Second time public key found in cache when caching. */
+    for (i = 0; (ret == 0) && (i < 2); i++) {
+        ret = sm2_test_key(&key, 0);
+        if (ret != 0)
+            break;
+        if (wc_ecc_sm2_check_pub_key(&key) != 0)
+            ret = SM_TEST_FAIL();
+        if ((ret == 0) && (wc_ecc_sm2_check_pub_key(&key) != 0))
+            ret = SM_TEST_FAIL();
+        /* Point not on curve imported into the checked key - not valid. */
+        if ((ret == 0) && (wc_ecc_import_x963_ex(bad, sizeof(bad), &key,
+                ECC_SM2P256V1) == 0) && (wc_ecc_sm2_check_pub_key(&key) == 0))
+            ret = SM_TEST_FAIL();
+        /* Valid point imported again - valid. */
+        if ((ret == 0) && (wc_ecc_import_x963_ex(sm2TestPub,
+                sizeof(sm2TestPub), &key, ECC_SM2P256V1) != 0))
+            ret = SM_TEST_FAIL();
+        if ((ret == 0) && (wc_ecc_sm2_check_pub_key(&key) != 0))
+            ret = SM_TEST_FAIL();
+        wc_ecc_free(&key);
+    }
+
+    /* Point not on curve - not valid and not cached. */
+    for (i = 0; (ret == 0) && (i < 2); i++) {
+        if (wc_ecc_init_ex(&key, NULL, INVALID_DEVID) != 0)
+            return SM_TEST_FAIL();
+        if ((wc_ecc_import_x963_ex(bad, sizeof(bad), &key,
+                ECC_SM2P256V1) == 0) && (wc_ecc_sm2_check_pub_key(&key) == 0))
+            ret = SM_TEST_FAIL();
+        wc_ecc_free(&key);
+    }
+    if ((ret == 0) && (wc_ecc_sm2_check_pub_key(NULL) != BAD_FUNC_ARG))
+        ret = SM_TEST_FAIL();
+
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM2) && defined(HAVE_ECC) && defined(HAVE_COMP_KEY) && \
+    defined(HAVE_ECC_KEY_IMPORT) && defined(HAVE_ECC_KEY_EXPORT)
+/* Number of points in field reduction test. */
+#define SM2_RED_CNT     11
+/* x ordinates of points whose decompression starts with squaring x, in
+ * Montgomery form (x.2^256 mod p), to a product that is an edge case of the
+ * reduction modulo p. The Montgomery reduction's result, before the final
+ * subtraction, and the case are:
+ *   2^256 - 8         Largest below 2^256 - not subtracted, not below p.
+ *   2^256 + 2         Smallest above 2^256 - subtracted.
+ *   p - 13            Just below p.
+ *   p + 2             Just above p - not subtracted.
+ * x in Montgomery form and the case are:
+ *   4, 2^26, 2^29 + 1, 2^52, 2^58, 2^128 - 1
+ *                     Top words of the product are zero and go negative
+ *                     while the multiples of p are subtracted.
+ *   p - 3             Product close to the largest.
+ */
+static const byte sm2RedX[SM2_RED_CNT][SM2_KEY_SIZE] = {
+    {
+        0x0d, 0x9e, 0x78, 0x49, 0xe2, 0x32, 0xbd, 0xd2,
+        0x6e, 0x65, 0x4e, 0x84, 0xec, 0x6a, 0x02, 0x56,
+        0x67, 0x38, 0x6d, 0x27, 0x91, 0x06, 0x52, 0x7b,
+        0x34, 0x77, 0x8a, 0x7d, 0x0e, 0xc2, 0xe9, 0x6f
+    },
+    {
+        0xfa, 0xe1, 0x2d, 0x97, 0x1d, 0x6e, 0x14, 0x65,
+        0xbc, 0x83, 0xcd, 0x17, 0x60, 0x17, 0x7a, 0xe9,
+        0xc8, 0xa7, 0x61, 0x0f, 0x4b, 0x95, 0xf3, 0x13,
+        0x8c, 0xfa, 0x40, 0x85, 0x30, 0xf9, 0xf2, 0xeb
+    },
+    {
+        0x1c, 0x6c, 0xa0, 0x93, 0x3b, 0x95, 0x1e, 0x03,
+        0xaa, 0x5f, 0xfb, 0x43, 0x28, 0x89, 0x2f, 0x11,
+        0x3f, 0xd9, 0x28, 0xea, 0xe8, 0xee, 0x6e, 0x3f,
+        0x02, 0xfe, 0x06, 0xd1, 0x65, 0x3b, 0xa1, 0xe2
+    },
+    {
+        0x12, 0x58, 0xb8, 0x08, 0x14, 0xf7, 0xe6, 0x87,
+        0x69, 0xeb, 0x62, 0x1c, 0x5b, 0xbb, 0x3f, 0x0e,
+        0x54, 0xf6, 0x5a, 0xf8, 0x22, 0x84, 0xbb, 0x9e,
+        0xe0, 0xff, 0xaf, 0x80, 0xac, 0xc5, 0xf8, 0x91
+    },
+    {
+        0xff, 0xff, 0xff, 0xef, 0x00, 0x00, 0x00, 0x17,
+        0xff, 0xff, 0xff, 0xf0, 0x00, 0x00, 0x00, 0x0b,
+        0xff, 0xff, 0xff, 0xf7, 0x00, 0x00, 0x00, 0x18,
+        0xff, 0xff, 0xff, 0xe4, 0x00, 0x00, 0x00, 0x13
+    },
+    {
+        0xef, 0xff, 0xff, 0xff, 0x17, 0xff, 0xff, 0xff,
+        0xf0, 0x00, 0x00, 0x00, 0x0b, 0xff, 0xff, 0xff,
+        0xf7, 0xff, 0xff, 0xff, 0x18, 0x00, 0x00, 0x00,
+        0xe4, 0x00, 0x00, 0x00, 0x13, 0xff, 0xff, 0xff
+    },
+    {
+        0x7f, 0xff, 0xff, 0xfb, 0xc0, 0x00, 0x00, 0x05,
+        0x7f, 0xff, 0xff, 0xfc, 0x60, 0x00, 0x00, 0x02,
+        0xbf, 0xff, 0xff, 0xfd, 0xc0, 0x00, 0x00, 0x06,
+        0x1f, 0xff, 0xff, 0xf9, 0xa0, 0x00, 0x00, 0x04
+    },
+    {
+        0x00, 0x1f, 0xff, 0xff, 0xff, 0xc0, 0x00, 0x00,
+        0x00, 0x2f, 0xff, 0xff, 0xff, 0xe0, 0x00, 0x00,
+        0x00, 0x1f, 0xff, 0xff, 0xff, 0xd0, 0x00, 0x00,
+        0x00, 0x4f, 0xff, 0xff, 0xff, 0xc0, 0x00, 0x00
+    },
+    {
+        0x07, 0xff, 0xff, 0xff, 0xf0, 0x00, 0x00, 0x00,
+        0x0b, 0xff, 0xff, 0xff, 0xf8, 0x00, 0x00, 0x00,
+        0x07, 0xff, 0xff, 0xff, 0xf4, 0x00, 0x00, 0x00,
+        0x13, 0xff, 0xff, 0xff, 0xf0, 0x00, 0x00, 0x00
+    },
+    {
+        0x00, 0x00, 0x00, 0x02, 0xff, 0xff, 0xff, 0xfc,
+        0x00, 0x00, 0x00, 0x02, 0xff, 0xff, 0xff, 0xfe,
+        0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xfb,
+        0x00, 0x00, 0x00, 0x04, 0xff, 0xff, 0xff, 0xfc
+    },
+    {
+        0x00, 0x00, 0x00, 0x0b, 0xff, 0xff, 0xff, 0xee,
+        0x00, 0x00, 0x00, 0x0b, 0xff, 0xff, 0xff, 0xf7,
+        0x00, 0x00, 0x00, 0x05, 0xff, 0xff, 0xff, 0xee,
+        0x00, 0x00, 0x00, 0x14, 0xff, 0xff, 0xff, 0xf1
+    }
+};
+/* Even y ordinates of the points - calculated independently. */
+static const byte sm2RedY[SM2_RED_CNT][SM2_KEY_SIZE] = {
+    {
+        0x03, 0x75, 0x64, 0x77, 0x55, 0x01, 0x37, 0xb1,
+        0x10, 0x26, 0x58, 0x24, 0x9f, 0x2e, 0x3c, 0x73,
+        0xd7, 0x99, 0xd8, 0xbe, 0x9d, 0x4c, 0x14, 0x14,
+        0x23, 0xda, 0x3f, 0xd9, 0x02, 0x23, 0xe4, 0x14
+    },
+    {
+        0x4b, 0xc0, 0x0d, 0x04, 0x4e, 0x11, 0x86, 0x3d,
+        0x2e, 0x46, 0xf7, 0xd4, 0xac, 0xd3, 0x82, 0x67,
+        0x2d, 0xd3, 0xab, 0xa3, 0x9a, 0x5a, 0xdc, 0xa5,
+        0x90, 0x2f, 0xd8, 0x7a, 0x38, 0xaf, 0x2a, 0x54
+    },
+    {
+        0x75, 0xfc, 0xe5, 0x5f, 0xa7, 0xac, 0x6f, 0x5f,
+        0xe2, 0x38, 0x4f, 0xb0, 0xcd, 0x45, 0xa6, 0xd2,
+        0x13, 0x52, 0xcc, 0x48, 0x21, 0xac, 0x17, 0xa2,
+        0xbb, 0xf8, 0x11, 0x2c, 0x9a, 0x10, 0xb1, 0xe0
+    },
+    {
+        0x24, 0x5c, 0x17, 0x30, 0x9c, 0x04, 0x9d, 0x7c,
+        0x86, 0xf7, 0x4c, 0x34, 0x2a, 0x7f, 0x8d, 0xa6,
+        0xcf, 0xd5, 0x3d, 0x69, 0xd4, 0x08, 0xdf, 0xab,
+        0x88, 0xb2, 0xa8, 0x03, 0x62, 0x60, 0xa9, 0xf4
+    },
+    {
+        0xd8, 0x06, 0xe9, 0x90, 0x94, 0xff, 0xe0, 0x43,
+        0x28, 0x5f, 0x37, 0x42, 0xf9, 0x55, 0x1e, 0x05,
+        0xef, 0x98, 0x62, 0x5f, 0x9b, 0x5f, 0x12, 0xce,
+        0x24, 0xb4, 0xf8, 0xb6, 0xaf, 0x46, 0xf4, 0xa0
+    },
+    {
+        0x50, 0xe7, 0x63, 0xbb, 0x3a, 0x03, 0x6a, 0x2a,
+        0x61, 0x96, 0xd2, 0x88, 0x4e, 0xcb, 0xf4, 0xe5,
+        0xf6, 0x95, 0x18, 0x3e, 0x27, 0x24, 0x2d, 0xc7,
+        0x1a, 0xe3, 0xa6, 0x3b, 0x0d, 0x24, 0x9b, 0x7a
+    },
+    {
+        0x2e, 0x61, 0x02, 0x3c, 0x7b, 0xff, 0xaa, 0xcb,
+        0x17, 0xa3, 0xda, 0x88, 0x54, 0x82, 0x6a, 0xf4,
+        0x3a, 0x83, 0x50, 0x2f, 0x8f, 0x06, 0x85, 0xbf,
+        0x1a, 0x6d, 0xb7, 0x2a, 0x68, 0xc0, 0x41, 0xc2
+    },
+    {
+        0x74, 0x24, 0xdb, 0x0a, 0xf3, 0xc8, 0x23, 0x1e,
+        0xca, 0xba, 0xe6, 0x5b, 0x31, 0x08, 0xb5, 0x6b,
+        0xde, 0xa9, 0x51, 0x50, 0x97, 0xa3, 0x49, 0x4b,
+        0xdc, 0x7b, 0x10, 0x8e, 0x46, 0xf7, 0xce, 0xd0
+    },
+    {
+        0xd4, 0x1b, 0x1d, 0xae, 0x36, 0xc6, 0x69, 0x15,
+        0x78, 0x31, 0xde, 0x32, 0x87, 0x38, 0xcd, 0x1e,
+        0x15, 0xe6, 0x63, 0x3e, 0x9b, 0x15, 0x6f, 0xf4,
+        0xe6, 0x9a, 0x7e, 0x25, 0x18, 0x14, 0x94, 0x6e
+    },
+    {
+        0xbc, 0x6e, 0x65, 0x17, 0x5f, 0xe2, 0xb6, 0x28,
+        0x2d, 0x9e, 0x91, 0x5f, 0x02, 0x80, 0x8d, 0x8a,
+        0x60, 0x80, 0xbb, 0x0f, 0x45, 0xc9, 0x01, 0x56,
+        0x34, 0xef, 0xaa, 0x82, 0x16, 0x08, 0x62, 0xe4
+    },
+    {
+        0x47, 0xfa, 0x0b, 0xde, 0x9f, 0x5b, 0x3c, 0x26,
+        0x69, 0xd6, 0xfa, 0x89, 0xc8, 0x0e, 0xc0, 0xe1,
+        0xf3, 0x2a, 0x00, 0xa7, 0xaf, 0x07, 0x87, 0x54,
+        0x4e, 0xcf, 0x3b, 0xdf, 0x9a, 0x95, 0x00, 0xc2
+    }
+};
+
+/* Test edge cases of the reduction modulo the SM2 prime.
+ *
+ * Points are decompressed and exported to check the y ordinate.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm2_field_reduce_test(void)
+{
+    ecc_key key;
+    byte comp[1 + SM2_KEY_SIZE];
+    byte point[1 + 2 * SM2_KEY_SIZE];
+    word32 pointSz;
+    int i;
+    int ret = 0;
+
+    for (i = 0; (ret == 0) && (i < SM2_RED_CNT); i++) {
+        comp[0] = ECC_POINT_COMP_EVEN;
+        XMEMCPY(comp + 1, sm2RedX[i], SM2_KEY_SIZE);
+        if (wc_ecc_init_ex(&key, NULL, INVALID_DEVID) != 0)
+            return SM_TEST_FAIL();
+        if (wc_ecc_import_x963_ex(comp, sizeof(comp), &key,
+                ECC_SM2P256V1) != 0)
+            ret = SM_TEST_FAIL();
+        pointSz = (word32)sizeof(point);
+        if ((ret == 0) && ((wc_ecc_export_x963(&key, point, &pointSz) != 0) ||
+                (pointSz != sizeof(point)) ||
+                (XMEMCMP(point + 1, sm2RedX[i], SM2_KEY_SIZE) != 0) ||
+                (XMEMCMP(point + 1 + SM2_KEY_SIZE, sm2RedY[i],
+                    SM2_KEY_SIZE) != 0)))
+            ret = SM_TEST_FAIL();
+    #ifdef HAVE_ECC_CHECK_KEY
+        /* Squares y and calculates x^3 - 3.x + b. */
+        if ((ret == 0) && (wc_ecc_sm2_check_pub_key(&key) != 0))
+            ret = SM_TEST_FAIL();
+    #endif
+        wc_ecc_free(&key);
+    }
+
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM2) && defined(HAVE_ECC) && defined(HAVE_ECC_DHE) && \
+    defined(HAVE_ECC_KEY_IMPORT)
+/* Private keys that are special cases of the co-Z ladder:
+ * 1, 2, (n - 1) / 2, n - 2 and n - 1. */
+static const byte sm2SecretPriv[5][SM2_KEY_SIZE] = {
+    {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01
+    },
+    {
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02
+    },
+    {
+        0x7f, 0xff, 0xff, 0xff, 0x7f, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xb9, 0x01, 0xef, 0xb5, 0x90, 0xe3, 0x02, 0x95,
+        0xa9, 0xdd, 0xfa, 0x04, 0x9c, 0xea, 0xa0, 0x91
+    },
+    {
+        0xff, 0xff, 0xff, 0xfe, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0x72, 0x03, 0xdf, 0x6b, 0x21, 0xc6, 0x05, 0x2b,
+        0x53, 0xbb, 0xf4, 0x09, 0x39, 0xd5, 0x41, 0x21
+    },
+    {
+        0xff, 0xff, 0xff, 0xfe, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0x72, 0x03, 0xdf, 0x6b, 0x21, 0xc6, 0x05, 0x2b,
+        0x53, 0xbb, 0xf4, 0x09, 0x39, 0xd5, 0x41, 0x22
+    }
+};
+/* x ordinates of Q, 2.Q and ((n - 1) / 2).Q where Q is sm2TestPub. */
+static const byte sm2SecretX[3][SM2_KEY_SIZE] = {
+    {
+        0x09, 0xf9, 0xdf, 0x31, 0x1e, 0x54, 0x21, 0xa1,
+        0x50, 0xdd, 0x7d, 0x16, 0x1e, 0x4b, 0xc5, 0xc6,
+        0x72, 0x17, 0x9f, 0xad, 0x18, 0x33, 0xfc, 0x07,
+        0x6b, 0xb0, 0x8f, 0xf3, 0x56, 0xf3, 0x50, 0x20
+    },
+    {
+        0x63, 0xce, 0xed, 0x55, 0x7b, 0x9e, 0x86, 0x1e,
+        0xa3, 0x6f, 0x9e, 0xa2, 0x7f, 0x55, 0x0c, 0x1d,
+        0x58, 0x85, 0x5a, 0x33, 0x1c, 0x8d, 0xdd, 0x3c,
+        0x2c, 0x8e, 0x89, 0x83, 0x25, 0xb7, 0x49, 0xee
+    },
+    {
+        0x55, 0x13, 0x75, 0x3b, 0xc1, 0x7e, 0xbd, 0x04,
+        0xeb, 0xcf, 0xb8, 0xc3, 0xab, 0xde, 0x09, 0xce,
+        0xe8, 0x88, 0x96, 0xe8, 0xb3, 0xc5, 0xc6, 0x48,
+        0xd8, 0x95, 0xda, 0x49, 0x52, 0xf0, 0x2b, 0xc7
+    }
+};
+/* Index into sm2SecretX of the secret with each of sm2SecretPriv. */
+static const byte sm2SecretIdx[5] = { 0, 1, 2, 1, 0 };
+/* sm2TestPub in Jacobian coordinates with Z not 1: X.Z^2, Y.Z^3, Z. */
+static const byte sm2SecretProj[3][SM2_KEY_SIZE] = {
+    {
+        0x61, 0xf3, 0x92, 0x9b, 0x1e, 0x08, 0x70, 0x51,
+        0x41, 0x0f, 0x2f, 0x70, 0xea, 0x75, 0xd7, 0x49,
+        0x60, 0x21, 0xd1, 0xba, 0x58, 0x06, 0x9c, 0x21,
+        0x33, 0xc6, 0x3a, 0xad, 0x04, 0xf1, 0x59, 0xc5
+    },
+    {
+        0xc8, 0xf9, 0x5f, 0xdf, 0x1b, 0x6d, 0x42, 0xba,
+        0x43, 0x5c, 0xd6, 0x25, 0xcf, 0xa7, 0xef, 0x0f,
+        0x12, 0x1e, 0x51, 0x0a, 0x49, 0xca, 0x61, 0x0f,
+        0x07, 0x6d, 0x90, 0x69, 0xda, 0xd1, 0xd1, 0xa8
+    },
+    {
+        0x1f, 0x2e, 0x3d, 0x4c, 0x5b, 0x6a, 0x79, 0x88,
+        0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+        0xa1, 0xb2, 0xc3, 0xd4, 0xe5, 0xf6, 0x07, 0x18,
+        0x29, 0x3a, 0x4b, 0x5c, 0x6d, 0x7e, 0x8f, 0x90
+    }
+};
+
+/* Test SM2 shared secrets with the private keys that are special cases of
+ * the co-Z ladder (WOLFSSL_SP_SM2_COZ_LADDER).
+ *
+ * The peer's point with Z not 1 isn't calculated with the ladder, so the
+ * ladder is checked against the existing scalar multiplication as well as
+ * known answers calculated independently.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm2_shared_secret_test(void)
+{
+    ecc_key priv;
+    ecc_key pub;
+    ecc_key proj;
+    byte secret[SM2_KEY_SIZE];
+    byte projSecret[SM2_KEY_SIZE];
+    word32 secretSz;
+    word32 projSecretSz;
+    int i;
+    int ret;
+
+    ret = sm2_test_key(&pub, 0);
+    if (ret != 0)
+        return ret;
+    ret = sm2_test_key(&proj, 0);
+    if (ret != 0) {
+        wc_ecc_free(&pub);
+        return ret;
+    }
+    if ((mp_read_unsigned_bin(proj.pubkey.x, sm2SecretProj[0],
+            SM2_KEY_SIZE) != 0) ||
+            (mp_read_unsigned_bin(proj.pubkey.y, sm2SecretProj[1],
+                SM2_KEY_SIZE) != 0) ||
+            (mp_read_unsigned_bin(proj.pubkey.z, sm2SecretProj[2],
+                SM2_KEY_SIZE) != 0))
+        ret = SM_TEST_FAIL();
+
+    for (i = 0; (ret == 0) && (i < 5); i++) {
+        if (wc_ecc_init_ex(&priv, NULL, INVALID_DEVID) != 0) {
+            ret = SM_TEST_FAIL();
+            break;
+        }
+        if (wc_ecc_import_private_key_ex(sm2SecretPriv[i], SM2_KEY_SIZE,
+                NULL, 0, &priv, ECC_SM2P256V1) != 0)
+            ret = SM_TEST_FAIL();
+        secretSz = (word32)sizeof(secret);
+        if ((ret == 0) && ((wc_ecc_sm2_shared_secret(&priv, &pub, secret,
+                &secretSz) != 0) || (secretSz != SM2_KEY_SIZE) ||
+                (XMEMCMP(secret, sm2SecretX[sm2SecretIdx[i]],
+                    SM2_KEY_SIZE) != 0)))
+            ret = SM_TEST_FAIL();
+        projSecretSz = (word32)sizeof(projSecret);
+        if ((ret == 0) && ((wc_ecc_sm2_shared_secret(&priv, &proj,
+                projSecret, &projSecretSz) != 0) ||
+                (projSecretSz != secretSz) ||
+                (XMEMCMP(projSecret, secret, secretSz) != 0)))
+            ret = SM_TEST_FAIL();
+        wc_ecc_free(&priv);
+    }
+
+    wc_ecc_free(&proj);
+    wc_ecc_free(&pub);
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM2) && defined(HAVE_ECC) && \
+    defined(WOLFSSL_SM2_DETERMINISTIC_K)
+/* Test SM2 signing with k generated deterministically with HMAC-SM3.
+ *
+ * With WOLFSSL_SM2_DET_K_TEST, values of k are rejected to force the retry
+ * path. Known answers calculated independently.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm2_det_sign_test(void)
+{
+    /* Signature of sm2TestHash, without and with additional data. */
+    static const byte expR[2][SM2_KEY_SIZE] = {
+        {
+            0x24, 0x85, 0x8e, 0xe7, 0x1d, 0x63, 0xe6, 0x87,
+            0xfe, 0xef, 0xe4, 0x1f, 0x5a, 0xf8, 0x0a, 0x59,
+            0xf0, 0x79, 0x1e, 0xb1, 0xda, 0xbc, 0x2b, 0xbe,
+            0x71, 0xda, 0xf0, 0xe5, 0x7f, 0x06, 0xc3, 0x67
+        },
+        {
+            0x57, 0x39, 0xeb, 0xd8, 0x5e, 0x65, 0x62, 0xa2,
+            0x45, 0x1d, 0xd8, 0x7f, 0xab, 0x5e, 0xe7, 0x90,
+            0x1e, 0x8a, 0x85, 0xc0, 0x71, 0xd0, 0x39, 0x7a,
+            0x64, 0xbd, 0xb5, 0x3f, 0x8f, 0x36, 0xa6, 0x6e
+        }
+    };
+    static const byte expS[2][SM2_KEY_SIZE] = {
+        {
+            0x3d, 0x15, 0x55, 0x0d, 0xe5, 0x27, 0x85, 0xa4,
+            0x35, 0x00, 0x4c, 0x93, 0x72, 0x56, 0xac, 0x71,
+            0x5c, 0x0e, 0x04, 0x17, 0x6a, 0xc5, 0x70, 0x62,
+            0xc6, 0x72, 0x2f, 0xa6, 0x92, 0xf7, 0xa4, 0x91
+        },
+        {
+            0x2f, 0xd8, 0xd6, 0x81, 0xeb, 0x0e, 0x37, 0x9b,
+            0x02, 0x0b, 0xfb, 0xdf, 0xae, 0x11, 0xec, 0xbb,
+            0x41, 0x65, 0x4d, 0xc5, 0xf8, 0x65, 0x82, 0xc7,
+            0x07, 0x88, 0xe3, 0x4c, 0xa3, 0x5f, 0xe5, 0x0e
+        }
+    };
+#ifdef WOLFSSL_SM2_DET_K_TEST
+    /* Signature of sm2TestHash with the second value of k. */
+    static const byte expR2[SM2_KEY_SIZE] = {
+        0x8e, 0x95, 0x22, 0xbe, 0x61, 0x4e, 0xfc, 0xda,
+        0x8d, 0x51, 0x4d, 0xd9, 0x55, 0x2b, 0x45, 0x95,
+        0xe2, 0x39, 0xab, 0x7e, 0xb2, 0x60, 0x4c, 0x08,
+        0x6d, 0xb0, 0xa8, 0x5e, 0x0d, 0x02, 0x98, 0xff
+    };
+    static const byte expS2[SM2_KEY_SIZE] = {
+        0x3b, 0xa9, 0xcf, 0xbf, 0x4f, 0x99, 0x98, 0xc0,
+        0xbb, 0x88, 0xf7, 0xe7, 0x4a, 0xd6, 0x9a, 0x00,
+        0xf8, 0x7d, 0xc6, 0xde, 0x0d, 0x39, 0x1c, 0xd0,
+        0x69, 0x76, 0x42, 0x82, 0x80, 0x46, 0x52, 0x75
+    };
+#endif
+    static const byte extra[] = { 'w', 'o', 'l', 'f', 's', 'm' };
+    ecc_key key;
+    mp_int r;
+    mp_int s;
+    mp_int e;
+    byte out[SM2_KEY_SIZE];
+    int i;
+    int res = 0;
+    int ret;
+
+    ret = sm2_test_key(&key, 1);
+    if (ret != 0)
+        return ret;
+    if (mp_init_multi(&r, &s, &e, NULL, NULL, NULL) != MP_OKAY)
+        ret = SM_TEST_FAIL();
+
+    for (i = 0; (ret == 0) && (i < 2); i++) {
+        /* Known answer - same signature every time. */
+        if (wc_ecc_sm2_sign_hash_det_ex(sm2TestHash, sizeof(sm2TestHash),
+                (i == 0) ? NULL : extra, (i == 0) ? 0 : sizeof(extra), &key,
+                &r, &s) != 0)
+            ret = SM_TEST_FAIL();
+        if ((ret == 0) && ((mp_to_unsigned_bin_len(&r, out,
+                sizeof(out)) != MP_OKAY) ||
+                (XMEMCMP(out, expR[i], sizeof(out)) != 0)))
+            ret = SM_TEST_FAIL();
+        if ((ret == 0) && ((mp_to_unsigned_bin_len(&s, out,
+                sizeof(out)) != MP_OKAY) ||
+                (XMEMCMP(out, expS[i], sizeof(out)) != 0)))
+            ret = SM_TEST_FAIL();
+        /* Round trip - signature verifies. */
+        res = 0;
+        if ((ret == 0) && ((wc_ecc_sm2_verify_hash_ex(&r, &s, sm2TestHash,
+                sizeof(sm2TestHash), &res, &key) != 0) || (res != 1)))
+            ret = SM_TEST_FAIL();
+    }
+    /* Different digest gives a different signature. */
+    if ((ret == 0) && ((mp_read_unsigned_bin(&e, expR[0],
+            SM2_KEY_SIZE) != MP_OKAY) ||
+            (wc_ecc_sm2_sign_hash_det_ex(sm2TestPriv, sizeof(sm2TestPriv),
+                NULL, 0, &key, &r, &s) != 0) ||
+            (mp_cmp(&r, &e) == MP_EQ)))
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && (wc_ecc_sm2_sign_hash_det_ex(sm2TestHash,
+            sizeof(sm2TestHash), NULL, 1, &key, &r, &s) != BAD_FUNC_ARG))
+        ret = SM_TEST_FAIL();
+#ifdef WOLFSSL_SM2_DET_K_TEST
+    /* First k not usable - next k generated as in RFC 6979, 3.2.h. */
+    wc_ecc_sm2_det_k_test_reject(1);
+    if ((ret == 0) && (wc_ecc_sm2_sign_hash_det_ex(sm2TestHash,
+            sizeof(sm2TestHash), NULL, 0, &key, &r, &s) != 0))
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && ((mp_to_unsigned_bin_len(&r, out,
+            sizeof(out)) != MP_OKAY) ||
+            (XMEMCMP(out, expR2, sizeof(out)) != 0)))
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && ((mp_to_unsigned_bin_len(&s, out,
+            sizeof(out)) != MP_OKAY) ||
+            (XMEMCMP(out, expS2, sizeof(out)) != 0)))
+        ret = SM_TEST_FAIL();
+    res = 0;
+    if ((ret == 0) && ((wc_ecc_sm2_verify_hash_ex(&r, &s, sm2TestHash,
+            sizeof(sm2TestHash), &res, &key) != 0) || (res != 1)))
+        ret = SM_TEST_FAIL();
+    /* No usable k - gives up rather than looping forever. */
+    wc_ecc_sm2_det_k_test_reject(1000);
+    if ((ret == 0) && (wc_ecc_sm2_sign_hash_det_ex(sm2TestHash,
+            sizeof(sm2TestHash), NULL, 0, &key, &r, &s) != RNG_FAILURE_E))
+        ret = SM_TEST_FAIL();
+    wc_ecc_sm2_det_k_test_reject(0);
+#endif
+
+    mp_free(&e);
+    mp_free(&s);
+    mp_free(&r);
+    wc_ecc_free(&key);
+    return ret;
+}
+#endif
+
+#if defined(WOLFSSL_SM2) && defined(HAVE_ECC) && \
+    defined(WOLFSSL_SM2_WORKSPACE) && defined(HAVE_ECC_SIGN) && \
+    defined(HAVE_ECC_VERIFY) && !defined(NO_ASN)
+/* Test SM2 operations with temporaries allocated from a workspace.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm2_workspace_test(void)
+{
+    wc_Sm2Workspace ws;
+    WC_RNG rng;
+    ecc_key key;
+    ecc_key keyA;
+    ecc_key keyB;
+    byte* buf = NULL;
+    byte sig[80];
+    byte secretA[SM2_KEY_SIZE];
+    byte secretB[SM2_KEY_SIZE];
+    word32 sigSz;
+    word32 secretASz;
+    word32 secretBSz;
+    int size;
+    int res;
+    int i;
+    int ret;
+
+    ret = sm2_test_key(&key, 1);
+    if (ret != 0)
+        return ret;
+    if (wc_InitRng(&rng) != 0) {
+        wc_ecc_free(&key);
+        return SM_TEST_FAIL();
+    }
+    if ((wc_ecc_init_ex(&keyA, NULL, INVALID_DEVID) != 0) ||
+            (wc_ecc_init_ex(&keyB, NULL, INVALID_DEVID) != 0))
+        ret = SM_TEST_FAIL();
+
+    size = wc_ecc_sm2_workspace_size();
+    if ((ret == 0) && (size <= 0))
+        ret = SM_TEST_FAIL();
+    if (ret == 0) {
+        /* Extra byte to test an unaligned buffer. */
+        buf = (byte*)XMALLOC((size_t)size + 1, NULL, DYNAMIC_TYPE_TMP_BUFFER);
+        if (buf == NULL)
+            ret = SM_TEST_FAIL();
+    }
+    /* Buffer must be at least the size returned. */
+    if ((ret == 0) && (wc_ecc_sm2_workspace_init(&ws, buf + 1,
+            (word32)size - 1) != BUFFER_E))
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && (wc_ecc_sm2_workspace_init(NULL, buf + 1,
+            (word32)size) != BAD_FUNC_ARG))
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && (wc_ecc_sm2_workspace_init(&ws, buf + 1,
+            (word32)size) != 0))
+        ret = SM_TEST_FAIL();
+
+    /* Workspace is reused by each operation. */
+    for (i = 0; (ret == 0) && (i < 3); i++) {
+        sigSz = (word32)sizeof(sig);
+        if (wc_ecc_sm2_sign_hash_ws(sm2TestHash, sizeof(sm2TestHash), sig,
+                &sigSz, &rng, &key, &ws) != 0)
+            ret = SM_TEST_FAIL();
+        res = 0;
+        if ((ret == 0) && ((wc_ecc_sm2_verify_hash_ws(sig, sigSz,
+                sm2TestHash, sizeof(sm2TestHash), &res, &key, &ws) != 0) ||
+                (res != 1)))
+            ret = SM_TEST_FAIL();
+        /* Signature verifies without workspace too. */
+        res = 0;
+        if ((ret == 0) && ((wc_ecc_sm2_verify_hash(sig, sigSz, sm2TestHash,
+                sizeof(sm2TestHash), &res, &key) != 0) || (res != 1)))
+            ret = SM_TEST_FAIL();
+        /* Changed signature doesn't verify. */
+        sig[sigSz - 1] ^= 1;
+        res = 1;
+        if ((ret == 0) && ((wc_ecc_sm2_verify_hash_ws(sig, sigSz,
+                sm2TestHash, sizeof(sm2TestHash), &res, &key, &ws) != 0) ||
+                (res != 0)))
+            ret = SM_TEST_FAIL();
+    }
+
+    /* Shared secret with keys made using workspace is the same both ways. */
+    if ((ret == 0) && ((wc_ecc_sm2_make_key_ws(&rng, &keyA,
+            WC_ECC_FLAG_NONE, &ws) != 0) ||
+            (wc_ecc_sm2_make_key_ws(&rng, &keyB, WC_ECC_FLAG_NONE,
+                &ws) != 0)))
+        ret = SM_TEST_FAIL();
+    secretASz = (word32)sizeof(secretA);
+    secretBSz = (word32)sizeof(secretB);
+    if ((ret == 0) && ((wc_ecc_sm2_shared_secret_ws(&keyA, &keyB, secretA,
+            &secretASz, &ws) != 0) ||
+            (wc_ecc_sm2_shared_secret_ws(&keyB, &keyA, secretB, &secretBSz,
+                &ws) != 0)))
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && ((secretASz != secretBSz) ||
+            (XMEMCMP(secretA, secretB, secretASz) != 0)))
+        ret = SM_TEST_FAIL();
+
+    XFREE(buf, NULL, DYNAMIC_TYPE_TMP_BUFFER);
+    wc_ecc_free(&keyB);
+    wc_ecc_free(&keyA);
+    wc_FreeRng(&rng);
+    wc_ecc_free(&key);
+    return ret;
+}
+#endif
+
+#ifdef WOLFSSL_SM_BATCH_DEV
+/* Device id the batching device is registered against. */
+#define SM_BATCH_TEST_DEVID     0x534d42
+/* Number of threads using the batching device at once. */
+#define SM_BATCH_TEST_THREADS   8
+/* Number of packets each thread has performed. */
+#define SM_BATCH_TEST_PKTS      64
+
+/* Batching device of test. */
+static wc_SmBatchDev smBatchTestDev;
+
+#ifdef WOLF_CRYPTO_CB
+/* Thread that encrypts and decrypts packets with the batching device.
+ *
+ * @param [in, out] arg  Result of thread - 0 on success.
+ */
+static THREAD_RETURN WOLFSSL_THREAD sm_batch_test_thread(void* arg)
+{
+    int* res = (int*)arg;
+    wc_Sm4 dev;
+    wc_Sm4 sw;
+    byte msg[200];
+    byte ct[200];
+    byte exp[200];
+    byte tag[SM4_BLOCK_SIZE];
+    byte expTag[SM4_BLOCK_SIZE];
+    byte nonce[GCM_NONCE_MID_SZ];
+    word32 i;
+    int ret = 0;
+
+    if ((wc_Sm4Init(&dev, NULL, SM_BATCH_TEST_DEVID) != 0) ||
+            (wc_Sm4Init(&sw, NULL, INVALID_DEVID) != 0))
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && ((wc_Sm4GcmSetKey(&dev, sm4GcmKatKey,
+            SM4_KEY_SIZE) != 0) ||
+            (wc_Sm4GcmSetKey(&sw, sm4GcmKatKey, SM4_KEY_SIZE) != 0)))
+        ret = SM_TEST_FAIL();
+    for (i = 0; (ret == 0) && (i < SM_BATCH_TEST_PKTS); i++) {
+        word32 sz = (i * 37) % sizeof(msg);
+
+        sm_test_fill(msg, sz, (word32)(size_t)res + i);
+        sm_test_fill(nonce, sizeof(nonce), i);
+        if (wc_Sm4GcmEncrypt(&sw, exp, msg, sz, nonce, sizeof(nonce), expTag,
+                sizeof(expTag), sm4GcmKatAad, sizeof(sm4GcmKatAad)) != 0)
+            ret = SM_TEST_FAIL();
+        if ((ret == 0) && (wc_Sm4GcmEncrypt(&dev, ct, msg, sz, nonce,
+                sizeof(nonce), tag, sizeof(tag), sm4GcmKatAad,
+                sizeof(sm4GcmKatAad)) != 0))
+            ret = SM_TEST_FAIL();
+        if ((ret == 0) && ((XMEMCMP(ct, exp, sz) != 0) ||
+                (XMEMCMP(tag, expTag, sizeof(tag)) != 0)))
+            ret = SM_TEST_FAIL();
+        if ((ret == 0) && ((wc_Sm4GcmDecrypt(&dev, exp, ct, sz, nonce,
+                sizeof(nonce), tag, sizeof(tag), sm4GcmKatAad,
+                sizeof(sm4GcmKatAad)) != 0) ||
+                (XMEMCMP(exp, msg, sz) != 0)))
+            ret = SM_TEST_FAIL();
+        tag[i % sizeof(tag)] ^= 0x01;
+        if ((ret == 0) && (wc_Sm4GcmDecrypt(&dev, exp, ct, sz, nonce,
+                sizeof(nonce), tag, sizeof(tag), sm4GcmKatAad,
+                sizeof(sm4GcmKatAad)) != SM4_GCM_AUTH_E))
+            ret = SM_TEST_FAIL();
+    }
+
+    wc_Sm4Free(&sw);
+    wc_Sm4Free(&dev);
+    *res = ret;
+    WOLFSSL_RETURN_FROM_THREAD(0);
+}
+#endif
+
+/* State of requests submitted from done functions. */
+typedef struct SmBatchTestChain {
+    /* Signalled when a request is done. */
+    COND_TYPE cond;
+    /* Number of requests done. */
+    int done;
+    /* Result of request run from done function. */
+    int runRet;
+    /* Request run from done function. */
+    wc_SmBatchReq run;
+    /* Request submitted from done function. */
+    wc_SmBatchReq next;
+    /* Output of requests. */
+    byte out[3][sizeof(sm4GcmKatPt)];
+    byte tag[3][SM4_BLOCK_SIZE];
+} SmBatchTestChain;
+
+/* Done function of the last request - wakes the test.
+ *
+ * @param [in] req  Request that is done.
+ * @param [in] ctx  Chain of requests.
+ */
+static void sm_batch_test_last(wc_SmBatchReq* req, void* ctx)
+{
+    SmBatchTestChain* chain = (SmBatchTestChain*)ctx;
+
+    (void)req;
+
+    (void)wolfSSL_CondStart(&chain->cond);
+    chain->done++;
+    (void)wolfSSL_CondSignal(&chain->cond);
+    (void)wolfSSL_CondEnd(&chain->cond);
+}
+
+/* Done function of the first request - re-enters the device.
+ *
+ * @param [in] req  Request that is done.
+ * @param [in] ctx  Chain of requests.
+ */
+static void sm_batch_test_first(wc_SmBatchReq* req, void* ctx)
+{
+    SmBatchTestChain* chain = (SmBatchTestChain*)ctx;
+
+    (void)req;
+
+#ifdef HAVE_THREAD_LS
+    /* Waiting on device from its own thread must not deadlock. */
+    chain->runRet = wc_SmBatchDevRun(&smBatchTestDev, &chain->run);
+#endif
+    chain->next.done = sm_batch_test_last;
+    chain->next.ctx = chain;
+    if (wc_SmBatchDevSubmit(&smBatchTestDev, &chain->next) != 0) {
+        chain->runRet = -1;
+        sm_batch_test_last(req, ctx);
+    }
+
+    (void)wolfSSL_CondStart(&chain->cond);
+    chain->done++;
+    (void)wolfSSL_CondSignal(&chain->cond);
+    (void)wolfSSL_CondEnd(&chain->cond);
+}
+
+/* Set up a request to encrypt the RFC 8998 test vector.
+ *
+ * @param [out] req  Request.
+ * @param [in]  sm4  SM4 object with key set.
+ * @param [out] out  Buffer to hold cipher text.
+ * @param [out] tag  Buffer to hold tag.
+ */
+static void sm_batch_test_req(wc_SmBatchReq* req, wc_Sm4* sm4, byte* out,
+    byte* tag)
+{
+    XMEMSET(req, 0, sizeof(*req));
+    req->type = WC_SM_BATCH_SM4_GCM_ENC;
+    req->gcm.sm4 = sm4;
+    req->gcm.nonce = sm4GcmKatIv;
+    req->gcm.nonceSz = sizeof(sm4GcmKatIv);
+    req->gcm.aad = sm4GcmKatAad;
+    req->gcm.aadSz = sizeof(sm4GcmKatAad);
+    req->gcm.in = sm4GcmKatPt;
+    req->gcm.out = out;
+    req->gcm.sz = sizeof(sm4GcmKatPt);
+    req->gcm.tag = tag;
+    req->gcm.tagSz = SM4_BLOCK_SIZE;
+}
+
+#ifdef WOLF_CRYPTO_CB
+/* Request that holds the device's thread and an operation queued behind
+ * it. */
+typedef struct SmBatchTestBlock {
+    /* Protects fields and signals release. */
+    COND_TYPE cond;
+    /* Set when done function of blocking request is entered. */
+    int entered;
+    /* Set to let done function of blocking request return. */
+    int release;
+    /* Set when operation is done and its result. */
+    int done;
+    int ret;
+    /* Object initialized with device id before device was registered. */
+    wc_Sm4* sm4;
+    byte out[sizeof(sm4GcmKatPt)];
+    byte tag[SM4_BLOCK_SIZE];
+} SmBatchTestBlock;
+
+/* Done function that holds the thread performing the batch until released.
+ *
+ * @param [in] req  Request that is done.
+ * @param [in] ctx  Blocking state.
+ */
+static void sm_batch_test_block(wc_SmBatchReq* req, void* ctx)
+{
+    SmBatchTestBlock* block = (SmBatchTestBlock*)ctx;
+
+    (void)req;
+
+    (void)wolfSSL_CondStart(&block->cond);
+    block->entered = 1;
+    while (!block->release) {
+        (void)wolfSSL_CondWait(&block->cond);
+    }
+    (void)wolfSSL_CondEnd(&block->cond);
+}
+
+/* Thread that encrypts with the object initialized with the device id.
+ *
+ * @param [in, out] arg  Blocking state.
+ */
+static THREAD_RETURN WOLFSSL_THREAD sm_batch_test_early(void* arg)
+{
+    SmBatchTestBlock* block = (SmBatchTestBlock*)arg;
+    int ret;
+
+    ret = wc_Sm4GcmEncrypt(block->sm4, block->out, sm4GcmKatPt,
+        sizeof(sm4GcmKatPt), sm4GcmKatIv, sizeof(sm4GcmKatIv), block->tag,
+        sizeof(block->tag), sm4GcmKatAad, sizeof(sm4GcmKatAad));
+
+    (void)wolfSSL_CondStart(&block->cond);
+    block->ret = ret;
+    block->done = 1;
+    (void)wolfSSL_CondEnd(&block->cond);
+    WOLFSSL_RETURN_FROM_THREAD(0);
+}
+
+/* Encrypt the RFC 8998 test vector with an SM4 object and check result.
+ *
+ * @param [in] sm4  SM4 object with key set.
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm_batch_test_kat(wc_Sm4* sm4)
+{
+    byte out[sizeof(sm4GcmKatPt)];
+    byte tag[SM4_BLOCK_SIZE];
+    int ret = 0;
+
+    if (wc_Sm4GcmEncrypt(sm4, out, sm4GcmKatPt, sizeof(sm4GcmKatPt),
+            sm4GcmKatIv, sizeof(sm4GcmKatIv), tag, sizeof(tag), sm4GcmKatAad,
+            sizeof(sm4GcmKatAad)) != 0)
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && ((XMEMCMP(out, sm4GcmKatCt, sizeof(out)) != 0) ||
+            (XMEMCMP(tag, sm4GcmKatTag, sizeof(tag)) != 0)))
+        ret = SM_TEST_FAIL();
+
+    return ret;
+}
+
+/* Test an object initialized with the device id before the device was
+ * registered has its operations queued on the device.
+ *
+ * The device's thread is held in a done function so that the operation
+ * stays queued.
+ *
+ * @param [in] sm4    SM4 object with key set to make blocking request with.
+ * @param [in] early  SM4 object initialized with device id.
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm_batch_test_queued(wc_Sm4* sm4, wc_Sm4* early)
+{
+    SmBatchTestBlock block;
+    wc_SmBatchReq req;
+    THREAD_TYPE tid;
+    byte out[sizeof(sm4GcmKatPt)];
+    byte tag[SM4_BLOCK_SIZE];
+    int started = 0;
+    int queued = 0;
+    int done = 0;
+    int ret = 0;
+
+    XMEMSET(&block, 0, sizeof(block));
+    block.sm4 = early;
+    if (wolfSSL_CondInit(&block.cond) != 0)
+        return SM_TEST_FAIL();
+
+    sm_batch_test_req(&req, sm4, out, tag);
+    req.done = sm_batch_test_block;
+    req.ctx = &block;
+    if (wc_SmBatchDevSubmit(&smBatchTestDev, &req) != 0)
+        ret = SM_TEST_FAIL();
+    /* Wait for device's thread to be held. */
+    while ((ret == 0) && (!done)) {
+        (void)wolfSSL_CondStart(&block.cond);
+        done = block.entered;
+        (void)wolfSSL_CondEnd(&block.cond);
+    }
+    if ((ret == 0) && (wolfSSL_NewThread(&tid, sm_batch_test_early,
+            &block) != 0))
+        ret = SM_TEST_FAIL();
+    started = (ret == 0);
+    /* Operation must be queued on device rather than done in software. */
+    done = 0;
+    while ((ret == 0) && (!queued) && (!done)) {
+        (void)wolfSSL_CondStart(&smBatchTestDev.cond);
+        queued = (smBatchTestDev.head != NULL);
+        (void)wolfSSL_CondEnd(&smBatchTestDev.cond);
+        (void)wolfSSL_CondStart(&block.cond);
+        done = block.done;
+        (void)wolfSSL_CondEnd(&block.cond);
+    }
+    if ((ret == 0) && (!queued))
+        ret = SM_TEST_FAIL();
+
+    /* Let device's thread go. */
+    (void)wolfSSL_CondStart(&block.cond);
+    block.release = 1;
+    (void)wolfSSL_CondSignal(&block.cond);
+    (void)wolfSSL_CondEnd(&block.cond);
+    if (started)
+        (void)wolfSSL_JoinThread(tid);
+    if ((ret == 0) && ((block.ret != 0) ||
+            (XMEMCMP(block.out, sm4GcmKatCt, sizeof(block.out)) != 0) ||
+            (XMEMCMP(block.tag, sm4GcmKatTag, sizeof(block.tag)) != 0)))
+        ret = SM_TEST_FAIL();
+
+    (void)wolfSSL_CondFree(&block.cond);
+    return ret;
+}
+#endif
+
+/* Test the SM4-GCM batching device.
+ *
+ * @return  0 on success.
+ * @return  Negative line number of failed check.
+ */
+static int sm_batch_test(void)
+{
+    THREAD_TYPE tid[SM_BATCH_TEST_THREADS];
+    int res[SM_BATCH_TEST_THREADS];
+    SmBatchTestChain chain;
+    wc_SmBatchReq first;
+    wc_Sm4 sm4;
+#ifdef WOLF_CRYPTO_CB
+    wc_Sm4 early;
+#endif
+    int i;
+    int ret = 0;
+
+    /* Device that wasn't started. */
+    XMEMSET(&smBatchTestDev, 0, sizeof(smBatchTestDev));
+    wc_SmBatchDevFree(&smBatchTestDev);
+    XMEMSET(&first, 0, sizeof(first));
+    first.type = WC_SM_BATCH_SM4_GCM_ENC;
+    first.done = sm_batch_test_last;
+    if (wc_SmBatchDevSubmit(&smBatchTestDev, &first) != BAD_STATE_E)
+        return SM_TEST_FAIL();
+    if (wc_SmBatchDevRun(&smBatchTestDev, &first) != BAD_STATE_E)
+        return SM_TEST_FAIL();
+#ifdef WOLF_CRYPTO_CB
+    if (wc_SmBatchDevRegister(&smBatchTestDev, SM_BATCH_TEST_DEVID) !=
+            BAD_STATE_E)
+        return SM_TEST_FAIL();
+#endif
+
+    if (wc_SmBatchDevInit(&smBatchTestDev, NULL) != 0)
+        return SM_TEST_FAIL();
+    if ((wc_Sm4Init(&sm4, NULL, INVALID_DEVID) != 0) ||
+            (wc_Sm4GcmSetKey(&sm4, sm4GcmKatKey, SM4_KEY_SIZE) != 0))
+        ret = SM_TEST_FAIL();
+#ifdef WOLF_CRYPTO_CB
+    /* Initialized before device is registered against device id. */
+    if ((wc_Sm4Init(&early, NULL, SM_BATCH_TEST_DEVID) != 0) ||
+            (wc_Sm4GcmSetKey(&early, sm4GcmKatKey, SM4_KEY_SIZE) != 0))
+        ret = SM_TEST_FAIL();
+    /* No device registered - software. */
+    if (ret == 0)
+        ret = sm_batch_test_kat(&early);
+#endif
+
+    /* Known answer through the device. */
+    XMEMSET(&chain, 0, sizeof(chain));
+    sm_batch_test_req(&first, &sm4, chain.out[0], chain.tag[0]);
+    if ((ret == 0) && (wc_SmBatchDevRun(&smBatchTestDev, &first) != 0))
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && ((XMEMCMP(chain.out[0], sm4GcmKatCt,
+            sizeof(sm4GcmKatCt)) != 0) ||
+            (XMEMCMP(chain.tag[0], sm4GcmKatTag, SM4_BLOCK_SIZE) != 0)))
+        ret = SM_TEST_FAIL();
+    /* Unsupported type of request. */
+    first.type = 0;
+    first.done = sm_batch_test_last;
+    if ((ret == 0) && (wc_SmBatchDevSubmit(&smBatchTestDev, &first) !=
+            BAD_FUNC_ARG))
+        ret = SM_TEST_FAIL();
+    first.done = NULL;
+    first.type = WC_SM_BATCH_SM4_GCM_ENC;
+    if ((ret == 0) && (wc_SmBatchDevSubmit(&smBatchTestDev, &first) !=
+            BAD_FUNC_ARG))
+        ret = SM_TEST_FAIL();
+
+    /* Done function that runs and submits requests on the device. */
+    if ((ret == 0) && (wolfSSL_CondInit(&chain.cond) != 0))
+        ret = SM_TEST_FAIL();
+    if (ret == 0) {
+        XMEMSET(chain.out, 0, sizeof(chain.out));
+        sm_batch_test_req(&first, &sm4, chain.out[0], chain.tag[0]);
+        sm_batch_test_req(&chain.run, &sm4, chain.out[1], chain.tag[1]);
+        sm_batch_test_req(&chain.next, &sm4, chain.out[2], chain.tag[2]);
+        first.done = sm_batch_test_first;
+        first.ctx = &chain;
+        if (wc_SmBatchDevSubmit(&smBatchTestDev, &first) != 0)
+            ret = SM_TEST_FAIL();
+        if (ret == 0) {
+            (void)wolfSSL_CondStart(&chain.cond);
+            while (chain.done < 2) {
+                (void)wolfSSL_CondWait(&chain.cond);
+            }
+            (void)wolfSSL_CondEnd(&chain.cond);
+        }
+        (void)wolfSSL_CondFree(&chain.cond);
+    }
+    if ((ret == 0) && ((chain.runRet != 0) || (first.ret != 0) ||
+            (chain.next.ret != 0)))
+        ret = SM_TEST_FAIL();
+    for (i = 0; (ret == 0) && (i < 3); i++) {
+    #ifndef HAVE_THREAD_LS
+        if (i == 1)
+            continue;
+    #endif
+        if ((XMEMCMP(chain.out[i], sm4GcmKatCt, sizeof(sm4GcmKatCt)) != 0) ||
+                (XMEMCMP(chain.tag[i], sm4GcmKatTag, SM4_BLOCK_SIZE) != 0))
+            ret = SM_TEST_FAIL();
+    }
+
+#ifdef WOLF_CRYPTO_CB
+    /* SM4 objects with device id use device from many threads. */
+    if ((ret == 0) && (wc_SmBatchDevRegister(&smBatchTestDev,
+            SM_BATCH_TEST_DEVID) != 0))
+        ret = SM_TEST_FAIL();
+    if ((ret == 0) && (wc_SmBatchDevRegister(&smBatchTestDev,
+            SM_BATCH_TEST_DEVID + 1) != BAD_STATE_E))
+        ret = SM_TEST_FAIL();
+    if (ret == 0)
+        ret = sm_batch_test_queued(&sm4, &early);
+    for (i = 0; (ret == 0) && (i < SM_BATCH_TEST_THREADS); i++) {
+        res[i] = SM_TEST_FAIL();
+        if (wolfSSL_NewThread(&tid[i], sm_batch_test_thread, &res[i]) != 0) {
+            ret = SM_TEST_FAIL();
+            break;
+        }
+    }
+    while (i-- > 0) {
+        (void)wolfSSL_JoinThread(tid[i]);
+        if ((ret == 0) && (res[i] != 0))
+            ret = res[i];
+    }
+    wc_SmBatchDevUnRegister(SM_BATCH_TEST_DEVID);
+    /* Software once unregistered. */
+    if (ret == 0)
+        ret = sm_batch_test_kat(&early);
+#else
+    (void)tid;
+    (void)res;
+#endif
+
+    wc_Sm4Free(&sm4);
+#ifdef WOLF_CRYPTO_CB
+    if ((ret == 0) && (wc_SmBatchDevRegister(&smBatchTestDev,
+            SM_BATCH_TEST_DEVID) != 0))
+        ret = SM_TEST_FAIL();
+#endif
+    wc_SmBatchDevFree(&smBatchTestDev);
+    /* Freeing device a second time does nothing. */
+    wc_SmBatchDevFree(&smBatchTestDev);
+#ifdef WOLF_CRYPTO_CB
+    /* Software once device is freed while registered. */
+    if (ret == 0)
+        ret = sm_batch_test_kat(&early);
+    wc_Sm4Free(&early);
+#endif
+    return ret;
+}
+#endif
+
+int main(void)
+{
+#ifdef WOLFSSL_SM3_DRBG
+    sm_test_report("SM3 Hash_DRBG", sm3_drbg_test());
+#endif
+#ifdef WOLFSSL_SM3_DRBG_THREAD
+    sm_test_report("SM3 Hash_DRBG thread", sm3_drbg_thread_test());
+#endif
+#ifdef WOLFSSL_SM3
+    sm_test_report("SM3", sm3_kat_test());
+#endif
+#ifdef WOLFSSL_SM3
+    sm_test_report("SM3 KDF blocks", sm3_kdf_blocks_test());
+#endif
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_THREADS) && \
+    defined(WOLFSSL_SM4_CTR)
+    sm_test_report("SM4-CTR parallel", sm4_ctr_parallel_test());
+#endif
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_THREADS) && \
+    defined(WOLFSSL_SM4_GCM)
+    sm_test_report("SM4-GCM parallel", sm4_gcm_parallel_test());
+#endif
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_ECB)
+    sm_test_report("SM4-ECB", sm4_ecb_test());
+#endif
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_ECB) && \
+    defined(WOLFSSL_SM4_CBC) && defined(WOLFSSL_SM4_CTR)
+    sm_test_report("SM4-CBC/CTR multi-block", sm4_multi_block_test());
+#endif
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_CTR)
+    sm_test_report("SM4-CTR seek", sm4_ctr_seek_test());
+#endif
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_CFB)
+    sm_test_report("SM4-CFB", sm4_cfb_test());
+#endif
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_OFB)
+    sm_test_report("SM4-OFB", sm4_ofb_test());
+#endif
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_GCM)
+    sm_test_report("SM4-GMAC", sm4_gmac_test());
+#endif
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_CMAC)
+    sm_test_report("SM4-CMAC", sm4_cmac_test());
+#endif
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_GCM) && \
+    defined(WOLFSSL_SM4_SHARED_KEY)
+    sm_test_report("SM4 shared key", sm4_shared_key_test());
+#endif
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_GCM)
+    sm_test_report("SM4-GCM burst", sm4_gcm_burst_test());
+#endif
+#if defined(WOLFSSL_SM4) && defined(WOLFSSL_SM4_ECB)
+    sm_test_report("SM4-ECB burst", sm4_ecb_burst_test());
+#endif
+#if defined(WOLFSSL_SM_IOV) && defined(WOLFSSL_SM3)
+    sm_test_report("SM3 scatter/gather", sm3_iov_test());
+#endif
+#if defined(WOLFSSL_SM_IOV) && defined(WOLFSSL_SM4)
+    sm_test_report("SM4 scatter/gather", sm4_iov_test());
+#endif
+#ifdef WOLFSSL_SM_BATCH_DEV
+    sm_test_report("SM batching device", sm_batch_test());
+#endif
+#if defined(WOLFSSL_SM2) && defined(HAVE_ECC) && defined(HAVE_ECC_SIGN) && \
+    defined(HAVE_ECC_VERIFY) && !defined(NO_ASN) && \
+    defined(HAVE_ECC_KEY_EXPORT) && defined(HAVE_ECC_KEY_IMPORT)
+    sm_test_report("SM2 make key batch", sm2_make_key_batch_test());
+#endif
+#if defined(WOLFSSL_SM2) && defined(HAVE_ECC) && defined(WOLFSSL_SM2_ENCRYPT)
+    sm_test_report("SM2 encrypt", sm2_encrypt_test());
+#endif
+#if defined(WOLFSSL_SM2) && defined(HAVE_ECC) && defined(WOLFSSL_SM2_KAP)
+    sm_test_report("SM2 key exchange", sm2_kap_test());
+#endif
+#if defined(WOLFSSL_SM2) && defined(HAVE_ECC) && \
+    defined(HAVE_ECC_KEY_IMPORT) && defined(HAVE_COMP_KEY) && \
+    defined(HAVE_ECC_KEY_EXPORT)
+    sm_test_report("SM2 import point batch", sm2_import_point_batch_test());
+#endif
+#if defined(WOLFSSL_SM2) && defined(HAVE_ECC) && defined(HAVE_ECC_CHECK_KEY)
+    sm_test_report("SM2 check public key", sm2_check_pub_key_test());
+#endif
+#if defined(WOLFSSL_SM2) && defined(HAVE_ECC) && defined(HAVE_COMP_KEY) && \
+    defined(HAVE_ECC_KEY_IMPORT) && defined(HAVE_ECC_KEY_EXPORT)
+    sm_test_report("SM2 field reduction", sm2_field_reduce_test());
+#endif
+#if defined(WOLFSSL_SM2) && defined(HAVE_ECC) && defined(HAVE_ECC_DHE) && \
+    defined(HAVE_ECC_KEY_IMPORT)
+    sm_test_report("SM2 shared secret", sm2_shared_secret_test());
+#endif
+#if defined(WOLFSSL_SM2) && defined(HAVE_ECC) && \
+    defined(WOLFSSL_SM2_DETERMINISTIC_K)
+    sm_test_report("SM2 deterministic sign", sm2_det_sign_test());
+#endif
+#if defined(WOLFSSL_SM2) && defined(HAVE_ECC) && \
+    defined(WOLFSSL_SM2_WORKSPACE) && defined(HAVE_ECC_SIGN) && \
+    defined(HAVE_ECC_VERIFY) && !defined(NO_ASN)
+    sm_test_report("SM2 workspace", sm2_workspace_test());
+#endif
+
+    return (failures == 0) ? 0 : 1;
+}